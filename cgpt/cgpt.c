@@ -38,6 +38,7 @@ struct {
   {"prioritize", cmd_prioritize,
    "Reorder the priority of all kernel partitions"},
   {"legacy", cmd_legacy, "Switch between GPT and Legacy GPT"},
+  {"batch", cmd_batch, "Run commands from stdin, writing the drive once"},
 };
 
 static void Usage(void) {
@@ -53,10 +54,43 @@ static void Usage(void) {
   printf("\nFor more detailed usage, use %s COMMAND -h\n\n", progname);
 }
 
-int main(int argc, char *argv[]) {
+// Returns the index in cmds[] of 'command' or a unique prefix of it, or -1 if
+// there isn't exactly one match.
+static int find_command(const char *command) {
   int i;
   int match_count = 0;
   int match_index = 0;
+
+  for (i = 0; command && i < sizeof(cmds)/sizeof(cmds[0]); ++i) {
+    // exact match?
+    if (0 == strcmp(cmds[i].name, command)) {
+      match_index = i;
+      match_count = 1;
+      break;
+    }
+    // unique match?
+    else if (0 == strncmp(cmds[i].name, command, strlen(command))) {
+      match_index = i;
+      match_count++;
+    }
+  }
+
+  return match_count == 1 ? match_index : -1;
+}
+
+int run_command(const char *name, int argc, char *argv[]) {
+  int i = find_command(name);
+
+  if (i < 0) {
+    Error("unknown command: %s\n", name);
+    return CGPT_FAILED;
+  }
+
+  return cmds[i].fp(argc, argv);
+}
+
+int main(int argc, char *argv[]) {
+  int i;
   char* command;
 
   progname = strrchr(argv[0], '/');
@@ -74,22 +108,9 @@ int main(int argc, char *argv[]) {
   command = argv[optind++];
 
   // Find the command to invoke.
-  for (i = 0; command && i < sizeof(cmds)/sizeof(cmds[0]); ++i) {
-    // exact match?
-    if (0 == strcmp(cmds[i].name, command)) {
-      match_index = i;
-      match_count = 1;
-      break;
-    }
-    // unique match?
-    else if (0 == strncmp(cmds[i].name, command, strlen(command))) {
-      match_index = i;
-      match_count++;
-    }
-  }
-
-  if (match_count == 1)
-    return cmds[match_index].fp(argc, argv);
+  i = find_command(command);
+  if (i >= 0)
+    return cmds[i].fp(argc, argv);
 
   // Couldn't find a single matching command.
   Usage();
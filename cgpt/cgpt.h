@@ -48,8 +48,17 @@ struct drive {
   GptData gpt;
   struct pmbr pmbr;
   int fd;       /* file descriptor */
+  uint8_t *map;       /* mapping of a regular file, or NULL */
+  uint64_t map_size;  /* size of the mapping (in bytes) */
+  int map_writable;   /* mapping was made with PROT_WRITE */
+  /* LBA each entries array was loaded from, or 0 if it wasn't */
+  uint64_t loaded_entries_lba[2];
 };
 
+// Returns a pointer to 'count' bytes at 'offset' in the drive's mapping, or
+// NULL if the drive isn't mapped or the range falls outside the mapping.
+uint8_t *DriveMapRange(struct drive *drive, uint64_t offset, uint64_t count);
+
 // Opens a block device or file, loads raw GPT data from it.
 // 'mode' should be O_RDONLY or O_RDWR.
 // If 'drive_size' is 0, both the partitions and GPT structs reside on the same
@@ -62,6 +71,16 @@ struct drive {
 int DriveOpen(const char *drive_path, struct drive *drive, int mode,
               uint64_t drive_size);
 int DriveClose(struct drive *drive, int update_as_needed);
+
+// Keeps 'drive_path' open and its GPT loaded until DriveRelease(). In between,
+// DriveOpen() on the same path returns a copy of the loaded drive, and
+// DriveClose() saves changes back into it instead of writing them, so several
+// commands can edit the drive with a single write at the end.
+//
+// Returns CGPT_FAILED if the drive can't be opened or one is already held.
+int DriveHold(const char *drive_path, uint64_t drive_size);
+// Closes the held drive, writing any changes if 'update_as_needed' is set.
+int DriveRelease(int update_as_needed);
 int CheckValid(const struct drive *drive);
 
 /* Loads sectors from 'drive'.
@@ -190,6 +209,10 @@ int cmd_find(int argc, char *argv[]);
 int cmd_edit(int argc, char *argv[]);
 int cmd_prioritize(int argc, char *argv[]);
 int cmd_legacy(int argc, char *argv[]);
+int cmd_batch(int argc, char *argv[]);
+
+// Runs the command 'name', or a unique prefix of it, as main() would.
+int run_command(const char *name, int argc, char *argv[]);
 
 #define ARRAY_COUNT(array) (sizeof(array)/sizeof((array)[0]))
 const char *GptError(int errnum);
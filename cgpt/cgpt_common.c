@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -76,12 +77,96 @@ int CheckValid(const struct drive *drive) {
   return CGPT_OK;
 }
 
+uint8_t *DriveMapRange(struct drive *drive, uint64_t offset, uint64_t count) {
+  if (!drive->map || offset > drive->map_size ||
+      count > drive->map_size - offset)
+    return NULL;
+  return drive->map + offset;
+}
+
+/* Writes to the mapping, if there is one covering the range, and flushes just
+ * the pages touched. Returns CGPT_FAILED if that isn't possible, so the caller
+ * can fall back to write(). */
+static int MapSave(struct drive *drive, const uint8_t *buf, uint64_t offset,
+                   uint64_t count) {
+  uint8_t *dest = DriveMapRange(drive, offset, count);
+  long page_size = sysconf(_SC_PAGESIZE);
+  uint64_t start;
+
+  if (!dest || !drive->map_writable || page_size <= 0)
+    return CGPT_FAILED;
+
+  memcpy(dest, buf, count);
+  start = offset - offset % page_size;
+  if (-1 == msync(drive->map + start, offset + count - start, MS_SYNC))
+    return CGPT_FAILED;
+
+  return CGPT_OK;
+}
+
+/* Every read and write of the drive goes through these two, so they are the
+ * one place to change how cgpt does I/O. They use the mapping when it covers
+ * the range, and positional pread()/pwrite() otherwise, finishing short
+ * transfers. */
+static int DriveRead(struct drive *drive, void *buf, uint64_t offset,
+                     uint64_t count) {
+  uint8_t *src = DriveMapRange(drive, offset, count);
+  uint8_t *dest = buf;
+
+  if (src) {
+    memcpy(buf, src, count);
+    return CGPT_OK;
+  }
+
+  while (count) {
+    ssize_t n = pread(drive->fd, dest, count, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return CGPT_FAILED;
+    dest += n;
+    offset += n;
+    count -= n;
+  }
+  return CGPT_OK;
+}
+
+static int DriveWrite(struct drive *drive, const void *buf, uint64_t offset,
+                      uint64_t count) {
+  const uint8_t *src = buf;
+
+  if (CGPT_OK == MapSave(drive, buf, offset, count))
+    return CGPT_OK;
+
+  while (count) {
+    ssize_t n = pwrite(drive->fd, src, count, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return CGPT_FAILED;
+    src += n;
+    offset += n;
+    count -= n;
+  }
+  return CGPT_OK;
+}
+
+/* Tells the kernel a range is about to be read, so that several ranges can be
+ * fetched from the device together rather than one read at a time. Only a
+ * hint; there is nothing to do for a mapped drive. */
+static void DriveReadAhead(struct drive *drive, uint64_t offset,
+                           uint64_t count) {
+#ifndef HAVE_MACOS
+  if (!DriveMapRange(drive, offset, count))
+    posix_fadvise(drive->fd, offset, count, POSIX_FADV_WILLNEED);
+#endif
+}
+
 int Load(struct drive *drive, uint8_t *buf,
                 const uint64_t sector,
                 const uint64_t sector_bytes,
                 const uint64_t sector_count) {
-  int count;  /* byte count to read */
-  int nread;
+  uint64_t count;  /* byte count to read */
 
   require(buf);
   if (!sector_count || !sector_bytes) {
@@ -97,14 +182,9 @@ int Load(struct drive *drive, uint8_t *buf,
   }
   count = sector_bytes * sector_count;
 
-  if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET)) {
-    Error("Can't seek: %s\n", strerror(errno));
-    return CGPT_FAILED;
-  }
-
-  nread = read(drive->fd, buf, count);
-  if (nread < count) {
-    Error("Can't read enough: %d, not %d\n", nread, count);
+  if (CGPT_OK != DriveRead(drive, buf, sector * sector_bytes, count)) {
+    Error("Can't read %" PRIu64 " bytes at sector %" PRIu64 "\n",
+          count, sector);
     return CGPT_FAILED;
   }
 
@@ -112,49 +192,89 @@ int Load(struct drive *drive, uint8_t *buf,
 }
 
 
-int ReadPMBR(struct drive *drive) {
-  if (-1 == lseek(drive->fd, 0, SEEK_SET))
-    return CGPT_FAILED;
+/* Drive kept open by DriveHold(), and the path it was opened with */
+static struct drive held_drive;
+static char *held_path;
+/* The held drive's PMBR has changes for DriveRelease() to write */
+static int held_pmbr_modified;
 
-  int nread = read(drive->fd, &drive->pmbr, sizeof(struct pmbr));
-  if (nread != sizeof(struct pmbr))
-    return CGPT_FAILED;
+static int IsHeldDrive(const struct drive *drive) {
+  return held_path && drive != &held_drive && drive->fd == held_drive.fd;
+}
 
-  return CGPT_OK;
+int ReadPMBR(struct drive *drive) {
+  // DriveHold() already read it, and it may have unwritten changes.
+  if (IsHeldDrive(drive)) {
+    drive->pmbr = held_drive.pmbr;
+    return CGPT_OK;
+  }
+  return DriveRead(drive, &drive->pmbr, 0, sizeof(struct pmbr));
 }
 
 int WritePMBR(struct drive *drive) {
-  if (-1 == lseek(drive->fd, 0, SEEK_SET))
-    return CGPT_FAILED;
-
-  int nwrote = write(drive->fd, &drive->pmbr, sizeof(struct pmbr));
-  if (nwrote != sizeof(struct pmbr))
-    return CGPT_FAILED;
-
-  return CGPT_OK;
+  // Like the GPT, a held drive's PMBR is only written by DriveRelease().
+  if (IsHeldDrive(drive)) {
+    held_drive.pmbr = drive->pmbr;
+    held_pmbr_modified = 1;
+    return CGPT_OK;
+  }
+  return DriveWrite(drive, &drive->pmbr, 0, sizeof(struct pmbr));
 }
 
 int Save(struct drive *drive, const uint8_t *buf,
                 const uint64_t sector,
                 const uint64_t sector_bytes,
                 const uint64_t sector_count) {
-  int count;  /* byte count to write */
-  int nwrote;
-
   require(buf);
-  count = sector_bytes * sector_count;
+  return DriveWrite(drive, buf, sector * sector_bytes,
+                    sector_bytes * sector_count);
+}
 
-  if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET))
-    return CGPT_FAILED;
+/*
+ * Size of the block holding both GPT headers and entry arrays, and a copy of
+ * each entry array as it was loaded.
+ */
+static size_t GptBuffersSize(uint32_t sector_bytes) {
+  return 2 * (sector_bytes + GPT_ENTRIES_ALLOC_SIZE) +
+      2 * GPT_ENTRIES_ALLOC_SIZE;
+}
 
-  nwrote = write(drive->fd, buf, count);
-  if (nwrote < count)
-    return CGPT_FAILED;
+/*
+ * Allocate both headers and entry arrays together, laid out the way they
+ * usually are on disk: primary header then entries, and secondary entries then
+ * header.  That way GptLoad() can read each copy in a single go.  The loaded
+ * copies of the entries follow.  DriveClose() frees the whole block through
+ * primary_header.
+ */
+static int AllocGptBuffers(GptData *gpt) {
+  uint8_t *buf = malloc(GptBuffersSize(gpt->sector_bytes));
+  if (!buf)
+    return -1;
+  gpt->primary_header = buf;
+  gpt->primary_entries = buf + gpt->sector_bytes;
+  gpt->secondary_entries = gpt->primary_entries + GPT_ENTRIES_ALLOC_SIZE;
+  gpt->secondary_header = gpt->secondary_entries + GPT_ENTRIES_ALLOC_SIZE;
+  return 0;
+}
 
-  return CGPT_OK;
+/* Entries array 0 (primary) or 1 (secondary) as it was last loaded or saved */
+static uint8_t *LoadedEntries(GptData *gpt, int which) {
+  return gpt->secondary_header + gpt->sector_bytes +
+      which * GPT_ENTRIES_ALLOC_SIZE;
+}
+
+/* Remember what an entries array on disk holds, for SaveEntries() */
+static void SetLoadedEntries(struct drive *drive, int which,
+                             const uint8_t *entries, uint64_t lba) {
+  memcpy(LoadedEntries(&drive->gpt, which), entries, GPT_ENTRIES_ALLOC_SIZE);
+  drive->loaded_entries_lba[which] = lba;
 }
 
 static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
+  uint64_t entries_sectors = GPT_ENTRIES_ALLOC_SIZE / sector_bytes;
+  uint64_t last_lba;
+  int coalesce;
+
   drive->gpt.sector_bytes = sector_bytes;
   if (drive->size % drive->gpt.sector_bytes) {
     Error("Media size (%llu) is not a multiple of sector size(%d)\n",
@@ -163,29 +283,47 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
   }
   drive->gpt.streaming_drive_sectors = drive->size / drive->gpt.sector_bytes;
 
-  drive->gpt.primary_header = malloc(drive->gpt.sector_bytes);
-  drive->gpt.secondary_header = malloc(drive->gpt.sector_bytes);
-  drive->gpt.primary_entries = malloc(GPT_ENTRIES_ALLOC_SIZE);
-  drive->gpt.secondary_entries = malloc(GPT_ENTRIES_ALLOC_SIZE);
-  if (!drive->gpt.primary_header || !drive->gpt.secondary_header ||
-      !drive->gpt.primary_entries || !drive->gpt.secondary_entries)
+  if (AllocGptBuffers(&drive->gpt))
     return -1;
 
   /* TODO(namnguyen): Remove this and totally trust gpt_drive_sectors. */
   if (!(drive->gpt.flags & GPT_FLAG_EXTERNAL)) {
     drive->gpt.gpt_drive_sectors = drive->gpt.streaming_drive_sectors;
   } /* Else, we trust gpt.gpt_drive_sectors. */
+  last_lba = drive->gpt.gpt_drive_sectors - GPT_PMBR_SECTORS;
+
+  /* Only read past the headers if the drive is big enough to hold both
+   * full copies. */
+  coalesce = entries_sectors &&
+      drive->gpt.gpt_drive_sectors >=
+          GPT_PMBR_SECTORS + 2 * (GPT_HEADER_SECTORS + entries_sectors);
+
+  // Start both ends of the drive coming in before waiting on either.
+  DriveReadAhead(drive, GPT_PMBR_SECTORS * sector_bytes,
+                 (GPT_HEADER_SECTORS + (coalesce ? entries_sectors : 0)) *
+                     sector_bytes);
+  DriveReadAhead(drive,
+                 (last_lba - (coalesce ? entries_sectors : 0)) * sector_bytes,
+                 (GPT_HEADER_SECTORS + (coalesce ? entries_sectors : 0)) *
+                     sector_bytes);
 
   // Read the data.
   if (CGPT_OK != Load(drive, drive->gpt.primary_header,
-                      GPT_PMBR_SECTORS,
-                      drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
+                      GPT_PMBR_SECTORS, drive->gpt.sector_bytes,
+                      GPT_HEADER_SECTORS + (coalesce ? entries_sectors : 0))) {
     Error("Cannot read primary GPT header\n");
     return -1;
   }
-  if (CGPT_OK != Load(drive, drive->gpt.secondary_header,
-                      drive->gpt.gpt_drive_sectors - GPT_PMBR_SECTORS,
-                      drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
+  if (coalesce) {
+    if (CGPT_OK != Load(drive, drive->gpt.secondary_entries,
+                        last_lba - entries_sectors, drive->gpt.sector_bytes,
+                        entries_sectors + GPT_HEADER_SECTORS)) {
+      Error("Cannot read secondary GPT header\n");
+      return -1;
+    }
+  } else if (CGPT_OK != Load(drive, drive->gpt.secondary_header,
+                             last_lba, drive->gpt.sector_bytes,
+                             GPT_HEADER_SECTORS)) {
     Error("Cannot read secondary GPT header\n");
     return -1;
   }
@@ -194,7 +332,10 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
                   drive->gpt.gpt_drive_sectors,
                   drive->gpt.flags,
                   drive->gpt.sector_bytes) == 0) {
-    if (CGPT_OK != Load(drive, drive->gpt.primary_entries,
+    /* Entries right after the header were read along with it. */
+    if ((!coalesce ||
+         primary_header->entries_lba != GPT_PMBR_SECTORS + GPT_HEADER_SECTORS) &&
+        CGPT_OK != Load(drive, drive->gpt.primary_entries,
                         primary_header->entries_lba,
                         drive->gpt.sector_bytes,
                         CalculateEntriesSectors(primary_header,
@@ -202,6 +343,8 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
       Error("Cannot read primary partition entry array\n");
       return -1;
     }
+    SetLoadedEntries(drive, 0, drive->gpt.primary_entries,
+                     primary_header->entries_lba);
   } else {
     Warning("Primary GPT header is %s\n",
       memcmp(primary_header->signature, GPT_HEADER_SIGNATURE_IGNORED,
@@ -212,7 +355,10 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
                   drive->gpt.gpt_drive_sectors,
                   drive->gpt.flags,
                   drive->gpt.sector_bytes) == 0) {
-    if (CGPT_OK != Load(drive, drive->gpt.secondary_entries,
+    /* Likewise for a full-size entry array right before the header. */
+    if ((!coalesce ||
+         secondary_header->entries_lba != last_lba - entries_sectors) &&
+        CGPT_OK != Load(drive, drive->gpt.secondary_entries,
                         secondary_header->entries_lba,
                         drive->gpt.sector_bytes,
                         CalculateEntriesSectors(secondary_header,
@@ -220,6 +366,8 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
       Error("Cannot read secondary partition entry array\n");
       return -1;
     }
+    SetLoadedEntries(drive, 1, drive->gpt.secondary_entries,
+                     secondary_header->entries_lba);
   } else {
     Warning("Secondary GPT header is %s\n",
       memcmp(primary_header->signature, GPT_HEADER_SIGNATURE_IGNORED,
@@ -228,29 +376,143 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
   return 0;
 }
 
-static int GptSave(struct drive *drive) {
+/*
+ * Write entries array 0 (primary) or 1 (secondary).  If it goes where it was
+ * loaded from, only the runs of sectors that changed are written; changing one
+ * entry touches a single sector rather than the whole array.
+ */
+static int SaveEntries(struct drive *drive, int which, uint8_t *entries,
+                       GptHeader *header) {
+  uint32_t sector_bytes = drive->gpt.sector_bytes;
+  uint64_t sectors = CalculateEntriesSectors(header, sector_bytes);
+  const uint8_t *loaded = LoadedEntries(&drive->gpt, which);
+  uint64_t start, end;
+
+  if (drive->loaded_entries_lba[which] != header->entries_lba ||
+      sectors * sector_bytes > GPT_ENTRIES_ALLOC_SIZE) {
+    if (CGPT_OK != Save(drive, entries, header->entries_lba, sector_bytes,
+                        sectors))
+      return CGPT_FAILED;
+  } else {
+    for (start = 0; start < sectors; start = end + 1) {
+      for (end = start; end < sectors &&
+           memcmp(entries + end * sector_bytes, loaded + end * sector_bytes,
+                  sector_bytes); end++)
+        ;
+      if (end > start &&
+          CGPT_OK != Save(drive, entries + start * sector_bytes,
+                          header->entries_lba + start, sector_bytes,
+                          end - start))
+        return CGPT_FAILED;
+    }
+  }
+
+  if (sectors * sector_bytes <= GPT_ENTRIES_ALLOC_SIZE)
+    SetLoadedEntries(drive, which, entries, header->entries_lba);
+  return CGPT_OK;
+}
+
+/*
+ * Write header and entries array 0 (primary) or 1 (secondary) with a single
+ * write when the entries sit right next to the header on disk just as they do
+ * in memory, which is the usual layout.  Only the span from the header to the
+ * furthest changed entries sector is written.  Returns CGPT_FAILED if the
+ * layout doesn't allow it or the write fails.
+ */
+static int SaveCoalesced(struct drive *drive, int which, uint8_t *header_buf,
+                         uint64_t header_lba, uint8_t *entries) {
+  uint32_t sector_bytes = drive->gpt.sector_bytes;
+  GptHeader *header = (GptHeader *)header_buf;
+  uint64_t sectors = CalculateEntriesSectors(header, sector_bytes);
+  const uint8_t *loaded = LoadedEntries(&drive->gpt, which);
+  uint64_t entries_at, first, last, i;
+  uint8_t *base;
+
+  if (drive->loaded_entries_lba[which] != header->entries_lba ||
+      sectors * sector_bytes > GPT_ENTRIES_ALLOC_SIZE)
+    return CGPT_FAILED;
+
+  if (!which && header->entries_lba == header_lba + GPT_HEADER_SECTORS &&
+      entries == header_buf + GPT_HEADER_SECTORS * sector_bytes) {
+    /* Primary: header, then entries */
+    base = header_buf;
+    entries_at = GPT_HEADER_SECTORS;
+    first = 0;
+  } else if (which && header->entries_lba + sectors == header_lba &&
+             entries + sectors * sector_bytes == header_buf) {
+    /* Secondary: entries, then header */
+    base = entries;
+    entries_at = 0;
+    first = sectors;
+  } else {
+    return CGPT_FAILED;
+  }
+
+  last = first + GPT_HEADER_SECTORS - 1;
+  for (i = 0; i < sectors; i++) {
+    if (!memcmp(entries + i * sector_bytes, loaded + i * sector_bytes,
+                sector_bytes))
+      continue;
+    if (entries_at + i < first)
+      first = entries_at + i;
+    if (entries_at + i > last)
+      last = entries_at + i;
+  }
+
+  if (CGPT_OK != Save(drive, base + first * sector_bytes,
+                      header->entries_lba - entries_at + first, sector_bytes,
+                      last - first + 1))
+    return CGPT_FAILED;
+
+  SetLoadedEntries(drive, which, entries, header->entries_lba);
+  return CGPT_OK;
+}
+
+/*
+ * Write whatever changed in GPT copy 0 (primary) or 1 (secondary).  Returns
+ * the number of errors.
+ */
+static int SaveGptCopy(struct drive *drive, int which) {
+  const char *name = which ? "secondary" : "primary";
+  uint8_t *header_buf = which ? drive->gpt.secondary_header :
+      drive->gpt.primary_header;
+  uint8_t *entries = which ? drive->gpt.secondary_entries :
+      drive->gpt.primary_entries;
+  uint64_t header_lba = which ?
+      drive->gpt.gpt_drive_sectors - GPT_PMBR_SECTORS : GPT_PMBR_SECTORS;
+  uint8_t header_bit = which ? GPT_MODIFIED_HEADER2 : GPT_MODIFIED_HEADER1;
+  uint8_t entries_bit = which ? GPT_MODIFIED_ENTRIES2 : GPT_MODIFIED_ENTRIES1;
   int errors = 0;
 
-  if (!(drive->gpt.ignored & MASK_PRIMARY)) {
-    if (drive->gpt.modified & GPT_MODIFIED_HEADER1) {
-      if (CGPT_OK != Save(drive, drive->gpt.primary_header,
-                          GPT_PMBR_SECTORS,
-                          drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
-        errors++;
-        Error("Cannot write primary header: %s\n", strerror(errno));
-      }
+  /* Usually both changed.  If the single write fails, the separate writes
+   * below get another go and report what went wrong. */
+  if ((drive->gpt.modified & header_bit) &&
+      (drive->gpt.modified & entries_bit) &&
+      CGPT_OK == SaveCoalesced(drive, which, header_buf, header_lba, entries))
+    return 0;
+
+  if (drive->gpt.modified & header_bit) {
+    if (CGPT_OK != Save(drive, header_buf, header_lba,
+                        drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
+      errors++;
+      Error("Cannot write %s header: %s\n", name, strerror(errno));
     }
-    GptHeader* primary_header = (GptHeader*)drive->gpt.primary_header;
-    if (drive->gpt.modified & GPT_MODIFIED_ENTRIES1) {
-      if (CGPT_OK != Save(drive, drive->gpt.primary_entries,
-                          primary_header->entries_lba,
-                          drive->gpt.sector_bytes,
-                          CalculateEntriesSectors(primary_header,
-                            drive->gpt.sector_bytes))) {
-        errors++;
-        Error("Cannot write primary entries: %s\n", strerror(errno));
-      }
+  }
+  if (drive->gpt.modified & entries_bit) {
+    if (CGPT_OK != SaveEntries(drive, which, entries,
+                               (GptHeader *)header_buf)) {
+      errors++;
+      Error("Cannot write %s entries: %s\n", name, strerror(errno));
     }
+  }
+  return errors;
+}
+
+static int GptSave(struct drive *drive) {
+  int errors = 0;
+
+  if (!(drive->gpt.ignored & MASK_PRIMARY)) {
+    errors += SaveGptCopy(drive, 0);
 
     // Sync primary GPT before touching secondary so one is always valid.
     if (drive->gpt.modified & (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1))
@@ -261,27 +523,8 @@ static int GptSave(struct drive *drive) {
   }
 
   // Only start writing secondary GPT if primary was written correctly.
-  if (!errors && !(drive->gpt.ignored & MASK_SECONDARY)) {
-    if (drive->gpt.modified & GPT_MODIFIED_HEADER2) {
-      if(CGPT_OK != Save(drive, drive->gpt.secondary_header,
-                         drive->gpt.gpt_drive_sectors - GPT_PMBR_SECTORS,
-                         drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
-        errors++;
-        Error("Cannot write secondary header: %s\n", strerror(errno));
-      }
-    }
-    GptHeader* secondary_header = (GptHeader*)drive->gpt.secondary_header;
-    if (drive->gpt.modified & GPT_MODIFIED_ENTRIES2) {
-      if (CGPT_OK != Save(drive, drive->gpt.secondary_entries,
-                          secondary_header->entries_lba,
-                          drive->gpt.sector_bytes,
-                          CalculateEntriesSectors(secondary_header,
-                            drive->gpt.sector_bytes))) {
-        errors++;
-        Error("Cannot write secondary entries: %s\n", strerror(errno));
-      }
-    }
-  }
+  if (!errors && !(drive->gpt.ignored & MASK_SECONDARY))
+    errors += SaveGptCopy(drive, 1);
 
   return errors ? -1 : 0;
 }
@@ -314,6 +557,80 @@ static int ObtainDriveSize(int fd, uint64_t* size, uint32_t* sector_bytes) {
   return 0;
 }
 
+/*
+ * Map a regular file, so image files are accessed without a system call per
+ * read or write.  If that isn't possible, the drive is left unmapped and
+ * read() and write() are used as for block devices.
+ */
+static void MapDrive(struct drive *drive, int mode) {
+  struct stat stat;
+  int prot = PROT_READ;
+  void *map;
+
+  if (fstat(drive->fd, &stat) == -1 || (stat.st_mode & S_IFMT) != S_IFREG ||
+      stat.st_size <= 0 || (uint64_t)stat.st_size > SIZE_MAX)
+    return;
+
+  if ((mode & O_ACCMODE) != O_RDONLY)
+    prot |= PROT_WRITE;
+
+  map = mmap(NULL, stat.st_size, prot, MAP_SHARED, drive->fd, 0);
+  if (map == MAP_FAILED)
+    return;
+
+  drive->map = map;
+  drive->map_size = stat.st_size;
+  drive->map_writable = !!(prot & PROT_WRITE);
+}
+
+int DriveHold(const char *drive_path, uint64_t drive_size) {
+  require(drive_path);
+
+  if (held_path) {
+    Error("A drive is already held\n");
+    return CGPT_FAILED;
+  }
+
+  if (CGPT_OK != DriveOpen(drive_path, &held_drive, O_RDWR, drive_size))
+    return CGPT_FAILED;
+
+  if (CGPT_OK != ReadPMBR(&held_drive)) {
+    Error("Unable to read PMBR\n");
+    (void) DriveClose(&held_drive, 0);
+    return CGPT_FAILED;
+  }
+
+  held_path = strdup(drive_path);
+  if (!held_path) {
+    (void) DriveClose(&held_drive, 0);
+    return CGPT_FAILED;
+  }
+  held_pmbr_modified = 0;
+
+  return CGPT_OK;
+}
+
+int DriveRelease(int update_as_needed) {
+  int errors = 0;
+
+  if (!held_path)
+    return CGPT_FAILED;
+
+  free(held_path);
+  held_path = NULL;
+
+  if (update_as_needed && held_pmbr_modified &&
+      CGPT_OK != WritePMBR(&held_drive)) {
+    Error("Unable to write PMBR\n");
+    errors++;
+  }
+  held_pmbr_modified = 0;
+
+  if (CGPT_OK != DriveClose(&held_drive, update_as_needed))
+    errors++;
+  return errors ? CGPT_FAILED : CGPT_OK;
+}
+
 int DriveOpen(const char *drive_path, struct drive *drive, int mode,
               uint64_t drive_size) {
   uint32_t sector_bytes;
@@ -321,6 +638,17 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
   require(drive_path);
   require(drive);
 
+  // Hand out a copy of the held drive, so changes only reach it if the
+  // caller asks DriveClose() to save them.
+  if (held_path && !strcmp(drive_path, held_path)) {
+    *drive = held_drive;
+    if (AllocGptBuffers(&drive->gpt))
+      return CGPT_FAILED;
+    memcpy(drive->gpt.primary_header, held_drive.gpt.primary_header,
+           GptBuffersSize(held_drive.gpt.sector_bytes));
+    return CGPT_OK;
+  }
+
   // Clear struct for proper error handling.
   memset(drive, 0, sizeof(struct drive));
 
@@ -350,6 +678,7 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
     drive->gpt.flags = GPT_FLAG_EXTERNAL;
   }
 
+  MapDrive(drive, mode);
 
   if (GptLoad(drive, sector_bytes)) {
     goto error_close;
@@ -367,21 +696,43 @@ error_close:
 int DriveClose(struct drive *drive, int update_as_needed) {
   int errors = 0;
 
+  // A copy of the held drive only updates it; DriveRelease() does the writing.
+  if (IsHeldDrive(drive)) {
+    if (update_as_needed) {
+      GptData held_gpt = held_drive.gpt;
+
+      memcpy(held_gpt.primary_header, drive->gpt.primary_header,
+             GptBuffersSize(held_gpt.sector_bytes));
+      held_drive = *drive;
+      held_drive.gpt.primary_header = held_gpt.primary_header;
+      held_drive.gpt.primary_entries = held_gpt.primary_entries;
+      held_drive.gpt.secondary_header = held_gpt.secondary_header;
+      held_drive.gpt.secondary_entries = held_gpt.secondary_entries;
+      held_drive.gpt.modified |= held_gpt.modified;
+    }
+    free(drive->gpt.primary_header);
+    memset(drive, 0, sizeof(*drive));
+    return CGPT_OK;
+  }
+
   if (update_as_needed) {
     if (GptSave(drive)) {
         errors++;
     }
   }
 
+  /* GptLoad() allocated all four buffers in one block */
   free(drive->gpt.primary_header);
   drive->gpt.primary_header = NULL;
-  free(drive->gpt.primary_entries);
   drive->gpt.primary_entries = NULL;
-  free(drive->gpt.secondary_header);
   drive->gpt.secondary_header = NULL;
-  free(drive->gpt.secondary_entries);
   drive->gpt.secondary_entries = NULL;
 
+  if (drive->map) {
+    munmap(drive->map, drive->map_size);
+    drive->map = NULL;
+  }
+
   // Sync early! Only sync file descriptor here, and leave the whole system sync
   // outside cgpt because whole system sync would trigger tons of disk accesses
   // and timeout tests.
@@ -886,19 +1237,28 @@ void UpdateCrc(GptData *gpt) {
   primary_header = (GptHeader*)gpt->primary_header;
   secondary_header = (GptHeader*)gpt->secondary_header;
 
+  size_t entries1_size = primary_header->size_of_entry *
+      primary_header->number_of_entries;
+  size_t entries2_size = secondary_header->size_of_entry *
+      secondary_header->number_of_entries;
+  int entries1_done = 0;
+
   if (gpt->modified & GPT_MODIFIED_ENTRIES1 &&
       memcmp(primary_header, GPT_HEADER_SIGNATURE2,
              GPT_HEADER_SIGNATURE_SIZE)) {
-    size_t entries_size = primary_header->size_of_entry *
-        primary_header->number_of_entries;
     primary_header->entries_crc32 =
-        Crc32(gpt->primary_entries, entries_size);
+        Crc32(gpt->primary_entries, entries1_size);
+    entries1_done = 1;
   }
   if (gpt->modified & GPT_MODIFIED_ENTRIES2) {
-    size_t entries_size = secondary_header->size_of_entry *
-        secondary_header->number_of_entries;
-    secondary_header->entries_crc32 =
-        Crc32(gpt->secondary_entries, entries_size);
+    /* After a repair the two arrays match, and comparing them is much
+     * cheaper than another CRC over a large table. */
+    if (entries1_done && entries1_size == entries2_size &&
+        !memcmp(gpt->primary_entries, gpt->secondary_entries, entries2_size))
+      secondary_header->entries_crc32 = primary_header->entries_crc32;
+    else
+      secondary_header->entries_crc32 =
+          Crc32(gpt->secondary_entries, entries2_size);
   }
   if (gpt->modified & GPT_MODIFIED_HEADER1) {
     primary_header->header_crc32 = 0;
@@ -4,6 +4,8 @@
  */
 
 #include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -15,58 +17,105 @@
 #include "vboot_host.h"
 
 #define BUFSIZE 1024
+#define MAX_SCAN_THREADS 8
+
+// The label being searched for, converted to UTF-16 once per CgptFind() so
+// entry names can be compared without converting each of them.
+static struct {
+  uint16_t name[GPT_PARTNAME_LEN + 1];
+  size_t len;   // in UTF-16 units
+  int valid;
+} find_label;
+
+static void set_find_label(const char *label) {
+  find_label.valid = label &&
+      CGPT_OK == UTF8ToUTF16((const uint8_t *)label, find_label.name,
+                             GPT_PARTNAME_LEN + 1);
+  for (find_label.len = 0; find_label.valid &&
+       find_label.name[find_label.len]; find_label.len++)
+    ;
+}
 
-// fill comparebuf with the data to be examined, returning true on success.
-static int FillBuffer(CgptFindParams *params, int fd, uint64_t pos,
-                       uint64_t count) {
-  uint8_t *bufptr = params->comparebuf;
+// Returns true if the entry name, which is only terminated if it's shorter
+// than the field, is exactly the label being searched for.
+static int match_label(const GptEntry *entry) {
+  const size_t max_len = sizeof(entry->name) / sizeof(entry->name[0]);
+  size_t len;
 
-  if (-1 == lseek(fd, pos, SEEK_SET))
+  if (!find_label.valid || find_label.len > max_len)
     return 0;
+  for (len = 0; len < max_len && entry->name[len]; len++)
+    ;
+  return len == find_label.len &&
+      !memcmp(entry->name, find_label.name, len * sizeof(entry->name[0]));
+}
+
+// Compare the match data with the drive contents at pos, reading them into
+// comparebuf a piece at a time and stopping at the first piece that differs.
+// Returns 1 for a match, 0 if they differ or -1 if the read fails.
+static int match_region(CgptFindParams *params, int fd, uint64_t pos) {
+  uint64_t done = 0;
 
-  // keep reading until done or error
-  while (count) {
-    ssize_t bytes_read = read(fd, bufptr, count);
+  while (done < params->matchlen) {
+    uint64_t count = params->matchlen - done;
+    ssize_t bytes_read;
+
+    if (count > CGPT_FIND_COMPARE_SIZE)
+      count = CGPT_FIND_COMPARE_SIZE;
     // negative means error, 0 means (unexpected) EOF
+    bytes_read = pread(fd, params->comparebuf, count, pos + done);
     if (bytes_read <= 0)
+      return -1;
+    if (memcmp(params->matchbuf + done, params->comparebuf, bytes_read))
       return 0;
-    count -= bytes_read;
-    bufptr += bytes_read;
+    done += bytes_read;
   }
 
   return 1;
 }
 
+// Offset on the drive of the data to match for this entry, or -1 if the
+// region doesn't fit inside the partition.
+static int64_t match_offset(CgptFindParams *params, struct drive *drive,
+                            GptEntry *entry) {
+  uint64_t part_size = drive->gpt.sector_bytes *
+    (entry->ending_lba - entry->starting_lba + 1);
+
+  if (params->matchoffset + params->matchlen > part_size)
+    return -1;
+  return (drive->gpt.sector_bytes * entry->starting_lba) + params->matchoffset;
+}
+
 // check partition data content. return true for match, 0 for no match or error
 static int match_content(CgptFindParams *params, struct drive *drive,
-                             GptEntry *entry) {
-  uint64_t part_size;
-
-  if (!params->matchlen)
-    return 1;
+                         uint64_t offset) {
+  int ret;
 
-  // Ensure that the region we want to match against is inside the partition.
-  part_size = drive->gpt.sector_bytes *
-    (entry->ending_lba - entry->starting_lba + 1);
-  if (params->matchoffset + params->matchlen > part_size) {
-    return 0;
-  }
+  // Compare in place if the drive is mapped.
+  const uint8_t *data = DriveMapRange(drive, offset, params->matchlen);
+  if (data)
+    return 0 == memcmp(params->matchbuf, data, params->matchlen);
 
-  // Read the partition data.
-  if (!FillBuffer(params, drive->fd,
-    (drive->gpt.sector_bytes * entry->starting_lba) + params->matchoffset,
-                  params->matchlen)) {
+  ret = match_region(params, drive->fd, offset);
+  if (ret < 0) {
     Error("unable to read partition data\n");
     return 0;
   }
+  return ret;
+}
 
-  // Compare it
-  if (0 == memcmp(params->matchbuf, params->comparebuf, params->matchlen)) {
-    return 1;
-  }
+// A partition which matches the search criteria, if its content does too.
+struct find_candidate {
+  int64_t offset;
+  int index;
+};
 
-  // Nope.
-  return 0;
+static int compare_candidates(const void *a, const void *b) {
+  const struct find_candidate *ca = a, *cb = b;
+
+  if (ca->offset != cb->offset)
+    return ca->offset < cb->offset ? -1 : 1;
+  return ca->index - cb->index;
 }
 
 // This needs to handle /dev/mmcblk0 -> /dev/mmcblk0p3, /dev/sda -> /dev/sda3
@@ -115,16 +164,20 @@ static void chromeos_mtd_show(CgptFindParams *params, const char *filename,
 // could have multiple hits.
 static int gpt_search(CgptFindParams *params, struct drive *drive,
                       const char *filename) {
+  struct find_candidate candidates[MAX_NUMBER_OF_ENTRIES];
+  uint8_t matched[MAX_NUMBER_OF_ENTRIES];
+  int count = 0;
   int i;
   GptEntry *entry;
   int retval = 0;
-  char partlabel[GPT_PARTNAME_LEN];
 
   if (GPT_SUCCESS != GptSanityCheck(&drive->gpt)) {
     return 0;
   }
 
-  for (i = 0; i < GetNumberOfEntries(drive); ++i) {
+  memset(matched, 0, sizeof(matched));
+  for (i = 0; i < GetNumberOfEntries(drive) && i < MAX_NUMBER_OF_ENTRIES;
+       ++i) {
     entry = GetEntry(&drive->gpt, ANY_VALID, i);
 
     if (GuidIsZero(&entry->type))
@@ -134,25 +187,40 @@ static int gpt_search(CgptFindParams *params, struct drive *drive,
     if ((params->set_unique && GuidEqual(&params->unique_guid, &entry->unique))
         || (params->set_type && GuidEqual(&params->type_guid, &entry->type))) {
       found = 1;
-    } else if (params->set_label) {
-      if (CGPT_OK != UTF16ToUTF8(entry->name,
-                                 sizeof(entry->name) / sizeof(entry->name[0]),
-                                 (uint8_t *)partlabel, sizeof(partlabel))) {
-        Error("The label cannot be converted from UTF16, so abort.\n");
-        return 0;
-      }
-      if (!strncmp(params->label, partlabel, sizeof(partlabel)))
-        found = 1;
+    } else if (params->set_label && match_label(entry)) {
+      found = 1;
     }
-    if (found && match_content(params, drive, entry)) {
-      params->hits++;
-      retval++;
-      showmatch(params, filename, i+1, entry);
-      if (!params->match_partnum)
-        params->match_partnum = i+1;
+    if (!found)
+      continue;
+
+    if (!params->matchlen) {
+      matched[i] = 1;
+    } else {
+      candidates[count].offset = match_offset(params, drive, entry);
+      candidates[count].index = i;
+      if (candidates[count].offset >= 0)
+        count++;
     }
   }
 
+  // Check content in drive order, so the reads only ever move forward.
+  qsort(candidates, count, sizeof(candidates[0]), compare_candidates);
+  for (i = 0; i < count; i++)
+    matched[candidates[i].index] =
+        match_content(params, drive, candidates[i].offset);
+
+  for (i = 0; i < GetNumberOfEntries(drive) && i < MAX_NUMBER_OF_ENTRIES;
+       ++i) {
+    if (!matched[i])
+      continue;
+    entry = GetEntry(&drive->gpt, ANY_VALID, i);
+    params->hits++;
+    retval++;
+    showmatch(params, filename, i+1, entry);
+    if (!params->match_partnum)
+      params->match_partnum = i+1;
+  }
+
   return retval;
 }
 
@@ -214,6 +282,71 @@ static char *is_wholedev(const char *basename) {
   return 0;
 }
 
+// A whole device found by scan_real_devs(), and its GPT once loaded.
+struct scan_dev {
+  char *pathname;
+  struct drive drive;
+  int opened;
+};
+
+// Devices shared by the scan_worker() threads. Each worker claims the next
+// unopened device until there are none left.
+struct scan_pool {
+  CgptFindParams *params;
+  struct scan_dev *devs;
+  int count;
+  int next;
+  pthread_mutex_t lock;
+};
+
+static void *scan_worker(void *arg) {
+  struct scan_pool *pool = arg;
+
+  while (1) {
+    struct scan_dev *dev;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->next >= pool->count) {
+      pthread_mutex_unlock(&pool->lock);
+      break;
+    }
+    dev = pool->devs + pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+
+    dev->opened = (CGPT_OK == DriveOpen(dev->pathname, &dev->drive, O_RDONLY,
+                                        pool->params->drive_size));
+  }
+
+  return NULL;
+}
+
+// Open the devices and read their GPTs in parallel, since each one can block
+// for a long time on slow media. Searching and printing matches is left to the
+// caller, so the output is in the same order as the device list.
+static void open_devs(CgptFindParams *params, struct scan_dev *devs,
+                      int count) {
+  pthread_t threads[MAX_SCAN_THREADS];
+  struct scan_pool pool = {
+    .params = params,
+    .devs = devs,
+    .count = count,
+  };
+  int nthreads = 0;
+  int i;
+
+  pthread_mutex_init(&pool.lock, NULL);
+
+  // This thread works too, so it's fine if no others could be started.
+  while (nthreads < MAX_SCAN_THREADS && nthreads < count - 1 &&
+         !pthread_create(&threads[nthreads], NULL, scan_worker, &pool))
+    nthreads++;
+  scan_worker(&pool);
+
+  for (i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&pool.lock);
+}
+
 // This scans all the physical devices it can find, looking for a match. It
 // returns true if any matches were found, false otherwise.
 static int scan_real_devs(CgptFindParams *params) {
@@ -222,6 +355,9 @@ static int scan_real_devs(CgptFindParams *params) {
   char partname_prev[MAX_PARTITION_NAME_LEN];
   FILE *fp;
   char *pathname;
+  struct scan_dev *devs = NULL;
+  int dev_count = 0;
+  int i;
 
   fp = fopen(PROC_PARTITIONS, "re");
   if (!fp) {
@@ -245,8 +381,14 @@ static int scan_real_devs(CgptFindParams *params) {
     if (!strncmp(partname_prev, partname, strlen(partname_prev)) &&
         strlen(partname_prev)) {
       if ((pathname = is_wholedev(partname_prev))) {
-        if (do_search(params, pathname)) {
-          found++;
+        struct scan_dev *new_devs = realloc(devs,
+                                            (dev_count + 1) * sizeof(*devs));
+        if (new_devs) {
+          devs = new_devs;
+          memset(devs + dev_count, 0, sizeof(*devs));
+          devs[dev_count].pathname = strdup(pathname);
+          if (devs[dev_count].pathname)
+            dev_count++;
         }
       }
     }
@@ -256,6 +398,17 @@ static int scan_real_devs(CgptFindParams *params) {
 
   fclose(fp);
 
+  open_devs(params, devs, dev_count);
+  for (i = 0; i < dev_count; i++) {
+    if (devs[i].opened) {
+      if (gpt_search(params, &devs[i].drive, devs[i].pathname))
+        found++;
+      (void) DriveClose(&devs[i].drive, 0);
+    }
+    free(devs[i].pathname);
+  }
+  free(devs);
+
   fp = fopen(PROC_MTD, "re");
   if (!fp) {
     free(line);
@@ -305,6 +458,8 @@ void CgptFind(CgptFindParams *params) {
   if (params == NULL)
     return;
 
+  set_find_label(params->set_label ? params->label : NULL);
+
   if (params->drive_name != NULL)
     do_search(params, params->drive_name);
   else
@@ -15,15 +15,31 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <mtd/mtd-user.h>
+
 #include "cgpt.h"
 #include "cgpt_nor.h"
+#include "fmap.h"
 
 static const char FLASHROM_PATH[] = "/usr/sbin/flashrom";
+static const char PROC_MTD[] = "/proc/mtd";
+#define NOR_FMAP_ALIGN 4096
+
+// The RW_GPT sections of the firmware flash, when the kernel exposes the
+// flash as a NOR MTD device. Offsets are from the start of the flash.
+struct nor_gpt {
+  int fd;
+  uint32_t erase_size;
+  FmapAreaHeader gpt;
+  FmapAreaHeader primary;
+  FmapAreaHeader secondary;
+};
 
 // Obtain the MTD size from its sysfs node.
 int GetMtdSize(const char *mtd_device, uint64_t *size) {
@@ -195,10 +211,248 @@ int RemoveDir(const char *dir) {
   return nftw(dir, remove_file_or_dir, 20, FTW_DEPTH | FTW_PHYS);
 }
 
+static int full_pread(int fd, void *buf, size_t count, uint64_t offset) {
+  uint8_t *ptr = buf;
+  while (count) {
+    ssize_t n = pread(fd, ptr, count, offset);
+    if (n <= 0)
+      return 1;
+    ptr += n;
+    offset += n;
+    count -= n;
+  }
+  return 0;
+}
+
+static int full_pwrite(int fd, const void *buf, size_t count,
+                       uint64_t offset) {
+  const uint8_t *ptr = buf;
+  while (count) {
+    ssize_t n = pwrite(fd, ptr, count, offset);
+    if (n <= 0)
+      return 1;
+    ptr += n;
+    offset += n;
+    count -= n;
+  }
+  return 0;
+}
+
+// Read the FMAP header at |offset| into |fmap|, returning 1 if it is one.
+static int probe_fmap(int fd, uint64_t offset, FmapHeader *fmap) {
+  return full_pread(fd, fmap, sizeof(*fmap), offset) == 0 &&
+      !memcmp(fmap->fmap_signature, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE) &&
+      fmap->fmap_ver_major == FMAP_VER_MAJOR;
+}
+
+// Find the FMAP on a flash of |size| bytes, probing offsets in the same order
+// as fmap_find() so that only headers are read, not the whole flash. Each
+// probe is a read, so offsets finer than NOR_FMAP_ALIGN aren't tried; the FMAP
+// starts its own flash section, and those are erase block aligned.
+static int find_fmap(int fd, uint64_t size, FmapHeader *fmap,
+                     uint64_t *fmap_offset) {
+  uint64_t offset, align;
+
+  if (size < sizeof(*fmap))
+    return 1;
+  uint64_t lim = size - sizeof(*fmap);
+
+  *fmap_offset = 0;
+  if (probe_fmap(fd, 0, fmap))
+    return 0;
+  for (align = NOR_FMAP_ALIGN; align <= lim; align *= 2);
+  for (; align >= NOR_FMAP_ALIGN; align /= 2) {
+    for (offset = align; offset <= lim; offset += align * 2) {
+      if (probe_fmap(fd, offset, fmap)) {
+        *fmap_offset = offset;
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// Look up the RW_GPT areas in the FMAP of an open NOR MTD device.
+static int find_gpt_areas(struct nor_gpt *nor, uint64_t flash_size) {
+  FmapHeader fmap;
+  FmapAreaHeader area;
+  uint64_t offset;
+  int found = 0;
+  int i;
+
+  if (find_fmap(nor->fd, flash_size, &fmap, &offset) != 0)
+    return 1;
+  offset += sizeof(fmap);
+  for (i = 0; i < fmap.fmap_nareas; i++, offset += sizeof(area)) {
+    if (full_pread(nor->fd, &area, sizeof(area), offset) != 0)
+      return 1;
+    if (area.area_offset + (uint64_t)area.area_size > flash_size)
+      continue;
+    if (!strncmp(area.area_name, "RW_GPT", FMAP_NAMELEN)) {
+      nor->gpt = area;
+      found |= 1;
+    } else if (!strncmp(area.area_name, "RW_GPT_PRIMARY", FMAP_NAMELEN)) {
+      nor->primary = area;
+      found |= 2;
+    } else if (!strncmp(area.area_name, "RW_GPT_SECONDARY", FMAP_NAMELEN)) {
+      nor->secondary = area;
+      found |= 4;
+    }
+  }
+  if (found != 7)
+    return 1;
+
+  // The halves are what WriteNorFlash() writes rw_gpt back to.
+  if (nor->primary.area_size != nor->gpt.area_size / 2 ||
+      nor->secondary.area_size != nor->gpt.area_size / 2 ||
+      nor->primary.area_offset != nor->gpt.area_offset ||
+      nor->secondary.area_offset != nor->gpt.area_offset +
+                                    nor->primary.area_size)
+    return 1;
+  return 0;
+}
+
+// Open the NOR MTD device holding the firmware flash's FMAP. Returns 0 on
+// success, or non-zero if there is no such device, in which case flashrom
+// must be used instead.
+static int open_nor_gpt(struct nor_gpt *nor, int flags) {
+  char *line = NULL;
+  size_t line_length = 0;
+  int ret = 1;
+
+  FILE *fp = fopen(PROC_MTD, "re");
+  if (fp == NULL)
+    return ret;
+
+  while (ret && getline(&line, &line_length, fp) != -1) {
+    struct mtd_info_user info;
+    char dev[64];
+    int num;
+
+    if (sscanf(line, "mtd%d:", &num) != 1)
+      continue;
+    snprintf(dev, sizeof(dev), "/dev/mtd%d", num);
+    nor->fd = open(dev, flags | O_CLOEXEC);
+    if (nor->fd < 0)
+      continue;
+    if (ioctl(nor->fd, MEMGETINFO, &info) == 0 &&
+        info.type == MTD_NORFLASH && info.erasesize &&
+        find_gpt_areas(nor, info.size) == 0) {
+      nor->erase_size = info.erasesize;
+      ret = 0;
+    } else {
+      close(nor->fd);
+    }
+  }
+
+  fclose(fp);
+  free(line);
+  return ret;
+}
+
+// Write |size| bytes to the flash at |offset|. Only the erase blocks whose
+// contents change are erased and rewritten, and those are read back to check.
+static int write_nor_region(struct nor_gpt *nor, uint64_t offset,
+                            const uint8_t *data, uint64_t size) {
+  uint64_t end = offset + size;
+  uint64_t pos = offset - offset % nor->erase_size;
+  int ret = 1;
+
+  uint8_t *block = malloc(nor->erase_size);
+  uint8_t *verify = malloc(nor->erase_size);
+  if (block == NULL || verify == NULL)
+    goto clean_exit;
+
+  for (; pos < end; pos += nor->erase_size) {
+    uint64_t lo = pos > offset ? pos : offset;
+    uint64_t hi = pos + nor->erase_size < end ? pos + nor->erase_size : end;
+    struct erase_info_user erase = {
+      .start = pos,
+      .length = nor->erase_size,
+    };
+
+    if (full_pread(nor->fd, block, nor->erase_size, pos) != 0)
+      goto clean_exit;
+    if (!memcmp(block + (lo - pos), data + (lo - offset), hi - lo))
+      continue;
+    memcpy(block + (lo - pos), data + (lo - offset), hi - lo);
+
+    if (ioctl(nor->fd, MEMERASE, &erase) != 0 ||
+        full_pwrite(nor->fd, block, nor->erase_size, pos) != 0 ||
+        full_pread(nor->fd, verify, nor->erase_size, pos) != 0 ||
+        memcmp(block, verify, nor->erase_size))
+      goto clean_exit;
+  }
+  ret = 0;
+
+clean_exit:
+  free(verify);
+  free(block);
+  return ret;
+}
+
+// Copy RW_GPT from the MTD device to |dir|/rw_gpt.
+static int read_nor_mtd(struct nor_gpt *nor, const char *dir) {
+  int ret = 1;
+  char *dest;
+  if (asprintf(&dest, "%s/rw_gpt", dir) == -1)
+    return ret;
+
+  uint8_t *buf = malloc(nor->gpt.area_size);
+  int dest_fd = open(dest, O_WRONLY | O_CLOEXEC | O_CREAT, 0600);
+  if (buf != NULL && dest_fd >= 0 &&
+      full_pread(nor->fd, buf, nor->gpt.area_size,
+                 nor->gpt.area_offset) == 0 &&
+      full_pwrite(dest_fd, buf, nor->gpt.area_size, 0) == 0)
+    ret = 0;
+
+  if (dest_fd >= 0)
+    close(dest_fd);
+  free(buf);
+  free(dest);
+  return ret;
+}
+
+// Write |dir|/rw_gpt back to the MTD device, in two parts as with flashrom.
+static int write_nor_mtd(struct nor_gpt *nor, const char *dir) {
+  int nr_fails = 0;
+  char *source;
+  if (asprintf(&source, "%s/rw_gpt", dir) == -1)
+    return 2;
+
+  uint8_t *buf = malloc(nor->gpt.area_size);
+  int fd = open(source, O_RDONLY | O_CLOEXEC);
+  if (buf == NULL || fd < 0 ||
+      full_pread(fd, buf, nor->gpt.area_size, 0) != 0) {
+    nr_fails = 2;
+    goto clean_exit;
+  }
+
+  if (write_nor_region(nor, nor->primary.area_offset, buf,
+                       nor->primary.area_size) != 0) {
+    Warning("Cannot write the 1st half of rw_gpt back to the MTD device.\n");
+    nr_fails++;
+  }
+  if (write_nor_region(nor, nor->secondary.area_offset,
+                       buf + nor->primary.area_size,
+                       nor->secondary.area_size) != 0) {
+    Warning("Cannot write the 2nd half of rw_gpt back to the MTD device.\n");
+    nr_fails++;
+  }
+
+clean_exit:
+  if (fd >= 0)
+    close(fd);
+  free(buf);
+  free(source);
+  return nr_fails;
+}
+
 // Read RW_GPT from NOR flash to "rw_gpt" in a temp dir |temp_dir_template|.
 // |temp_dir_template| is passed to mkdtemp() so it must satisfy all
 // requirements by mkdtemp.
 int ReadNorFlash(char *temp_dir_template) {
+  struct nor_gpt nor;
   int ret = 0;
 
   // Create a temp dir to work in.
@@ -208,8 +462,20 @@ int ReadNorFlash(char *temp_dir_template) {
     return ret;
   }
 
-  // Read RW_GPT section from NOR flash to "rw_gpt".
+  // Read it straight from the MTD device if there is one.
   ret++;
+  if (open_nor_gpt(&nor, O_RDONLY) == 0) {
+    if (read_nor_mtd(&nor, temp_dir_template) != 0) {
+      Error("Cannot read RW_GPT section from the MTD device.\n");
+      RemoveDir(temp_dir_template);
+    } else {
+      ret = 0;
+    }
+    close(nor.fd);
+    return ret;
+  }
+
+  // Read RW_GPT section from NOR flash to "rw_gpt".
   int fd_flags = fcntl(1, F_GETFD);
   // Close stdout on exec so that flashrom does not muck up cgpt's output.
   if (0 != fcntl(1, F_SETFD, FD_CLOEXEC))
@@ -228,15 +494,9 @@ int ReadNorFlash(char *temp_dir_template) {
   return ret;
 }
 
-// Write "rw_gpt" back to NOR flash. We write the file in two parts for safety.
-int WriteNorFlash(const char *dir) {
-  int ret = 0;
-  ret++;
-  if (split_gpt(dir, "rw_gpt") != 0) {
-    Error("Cannot split rw_gpt in two.\n");
-    return ret;
-  }
-  ret++;
+// Write the two halves of "rw_gpt" in |dir| with flashrom. Returns the number
+// of halves which failed.
+static int write_with_flashrom(const char *dir) {
   int nr_fails = 0;
   int fd_flags = fcntl(1, F_GETFD);
   // Close stdout on exec so that flashrom does not muck up cgpt's output.
@@ -254,10 +514,30 @@ int WriteNorFlash(const char *dir) {
   }
   if (0 != fcntl(1, F_SETFD, fd_flags))
     Warning("Can't restore stdout flags\n");
+  return nr_fails;
+}
+
+// Write "rw_gpt" back to NOR flash. We write the file in two parts for safety.
+int WriteNorFlash(const char *dir) {
+  struct nor_gpt nor;
+  int nr_fails;
+  int ret = 0;
+  ret++;
+  if (open_nor_gpt(&nor, O_RDWR) == 0) {
+    nr_fails = write_nor_mtd(&nor, dir);
+    close(nor.fd);
+  } else {
+    if (split_gpt(dir, "rw_gpt") != 0) {
+      Error("Cannot split rw_gpt in two.\n");
+      return ret;
+    }
+    nr_fails = write_with_flashrom(dir);
+  }
+  ret++;
   switch (nr_fails) {
     case 0: ret = 0; break;
     case 1: Warning("It might still be okay.\n"); break;
-    case 2: Error("Cannot write both parts back with flashrom.\n"); break;
+    case 2: Error("Cannot write both parts back.\n"); break;
   }
   return ret;
 }
@@ -2,8 +2,9 @@
  * Use of this source code is governed by a BSD-style license that can be
  * found in the LICENSE file.
  *
- * This module provides some utility functions to use "flashrom" to read from
- * and write to NOR flash.
+ * This module provides some utility functions to read from and write to NOR
+ * flash, directly through its MTD device if the kernel exposes one, or else
+ * with "flashrom".
  */
 
 #ifndef VBOOT_REFERENCE_CGPT_NOR_H_
@@ -98,10 +98,27 @@ static void HeaderDetails(GptHeader *header, GptEntry *entries,
          );
 }
 
+/* Return the name to show for a partition type.  Partitions of the same type
+ * tend to come together, so the last type shown is remembered rather than
+ * being looked up and formatted again. */
+static const char *TypeToStr(const Guid *type, int raw) {
+  static Guid last_type;
+  static int last_raw = -1;
+  static char buf[GUID_STRLEN];
+
+  if (raw != last_raw || !GuidEqual(type, &last_type)) {
+    if (raw || CGPT_OK != ResolveType(type, buf))
+      GuidToStr(type, buf, sizeof(buf));
+    memcpy(&last_type, type, sizeof(last_type));
+    last_raw = raw;
+  }
+  return buf;
+}
+
 void EntryDetails(GptEntry *entry, uint32_t index, int raw) {
   char contents[256];                   // scratch buffer for formatting output
   uint8_t label[GPT_PARTNAME_LEN];
-  char type[GUID_STRLEN], unique[GUID_STRLEN];
+  char unique[GUID_STRLEN];
   int clen;
 
   UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
@@ -112,12 +129,7 @@ void EntryDetails(GptEntry *entry, uint32_t index, int raw) {
          (uint64_t)(entry->ending_lba - entry->starting_lba + 1),
          index+1, contents);
 
-  if (!raw && CGPT_OK == ResolveType(&entry->type, type)) {
-    printf(PARTITION_MORE, "Type: ", type);
-  } else {
-    GuidToStr(&entry->type, type, GUID_STRLEN);
-    printf(PARTITION_MORE, "Type: ", type);
-  }
+  printf(PARTITION_MORE, "Type: ", TypeToStr(&entry->type, raw));
   GuidToStr(&entry->unique, unique, GUID_STRLEN);
   printf(PARTITION_MORE, "UUID: ", unique);
 
@@ -178,6 +190,31 @@ static void EntriesDetails(struct drive *drive, const int secondary, int raw) {
   }
 }
 
+/* One line of tab-separated fields per partition, for scripts:
+ *
+ *   DRIVE PART START SIZE TYPE-GUID UNIQUE-GUID ATTRIBUTES LABEL
+ *
+ * The label comes last, since it may contain spaces.  Control characters in
+ * it are shown as '?', so a tab or newline can't split the line. */
+static void EntryMachine(const char *drive_name, GptEntry *entry,
+                         uint32_t index) {
+  uint8_t label[GPT_PARTNAME_LEN];
+  char unique[GUID_STRLEN];
+  uint8_t *c;
+
+  UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
+              label, sizeof(label));
+  for (c = label; *c; c++)
+    if (*c < 0x20 || *c == 0x7f)
+      *c = '?';
+  GuidToStr(&entry->unique, unique, sizeof(unique));
+  printf("%s\t%u\t%" PRIu64 "\t%" PRIu64 "\t%s\t%s\t0x%016" PRIx64 "\t%s\n",
+         drive_name, index + 1, (uint64_t)entry->starting_lba,
+         (uint64_t)(entry->ending_lba - entry->starting_lba + 1),
+         TypeToStr(&entry->type, 1), unique, (uint64_t)entry->attrs.whole,
+         label);
+}
+
 static int GptShow(struct drive *drive, CgptShowParams *params) {
   int gpt_retval;
   if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive->gpt))) {
@@ -186,12 +223,26 @@ static int GptShow(struct drive *drive, CgptShowParams *params) {
     return CGPT_FAILED;
   }
 
-  if (params->partition) {                      // show single partition
+  if (params->partition > GetNumberOfEntries(drive)) {
+    Error("invalid partition number: %d\n", params->partition);
+    return CGPT_FAILED;
+  }
 
-    if (params->partition > GetNumberOfEntries(drive)) {
-      Error("invalid partition number: %d\n", params->partition);
-      return CGPT_FAILED;
+  if (params->machine) {                        // show for scripts
+    uint32_t i;
+    GptEntry *entry;
+
+    for (i = 0; i < GetNumberOfEntries(drive); ++i) {
+      if (params->partition && i != params->partition - 1)
+        continue;
+
+      entry = GetEntry(&drive->gpt, ANY_VALID, i);
+      if (GuidIsZero(&entry->type))
+        continue;
+
+      EntryMachine(params->drive_name, entry, i);
     }
+  } else if (params->partition) {               // show single partition
 
     uint32_t index = params->partition - 1;
     GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, index);
@@ -250,7 +301,6 @@ static int GptShow(struct drive *drive, CgptShowParams *params) {
   } else if (params->quick) {                   // show all partitions, quickly
     uint32_t i;
     GptEntry *entry;
-    char type[GUID_STRLEN];
 
     for (i = 0; i < GetNumberOfEntries(drive); ++i) {
       entry = GetEntry(&drive->gpt, ANY_VALID, i);
@@ -258,13 +308,9 @@ static int GptShow(struct drive *drive, CgptShowParams *params) {
       if (GuidIsZero(&entry->type))
         continue;
 
-      if (!params->numeric && CGPT_OK == ResolveType(&entry->type, type)) {
-      } else {
-        GuidToStr(&entry->type, type, GUID_STRLEN);
-      }
       printf(PARTITION_FMT, (uint64_t)entry->starting_lba,
              (uint64_t)(entry->ending_lba - entry->starting_lba + 1),
-             i+1, type);
+             i+1, TypeToStr(&entry->type, params->numeric));
     }
   } else {                              // show all partitions
     GptEntry *entries;
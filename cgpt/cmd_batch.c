@@ -0,0 +1,154 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <ctype.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+extern const char* progname;
+
+#define MAX_BATCH_ARGS 64
+
+static void Usage(void)
+{
+  printf("\nUsage: %s batch [OPTIONS] DRIVE\n\n"
+         "Run cgpt commands read from stdin on DRIVE, loading its GPT once\n"
+         "and writing it once at the end. Each line is a COMMAND and its\n"
+         "OPTIONS, without DRIVE. Arguments containing spaces may be put in\n"
+         "double quotes. Blank lines and lines starting with '#' are\n"
+         "ignored. If any command fails, nothing is written.\n\n"
+         "Options:\n"
+         "  -D NUM       Size (in bytes) of the disk where partitions reside;\n"
+         "                 default 0, meaning partitions and GPT structs are\n"
+         "                 both on DRIVE. Applies to every command.\n"
+         "\n", progname);
+}
+
+// Split 'line' in place into at most 'max' arguments. Returns the number of
+// arguments, or -1 if there are too many or a quote isn't closed.
+static int SplitLine(char *line, char **args, int max) {
+  int count = 0;
+  char *c = line;
+
+  while (1) {
+    while (isspace(*c))
+      c++;
+    if (!*c || (!count && *c == '#'))
+      return count;
+    if (count == max)
+      return -1;
+
+    if (*c == '"') {
+      args[count++] = ++c;
+      c = strchr(c, '"');
+      if (!c)
+        return -1;
+    } else {
+      args[count++] = c;
+      while (*c && !isspace(*c))
+        c++;
+      if (!*c)
+        return count;
+    }
+    *c++ = '\0';
+  }
+}
+
+int cmd_batch(int argc, char *argv[]) {
+  uint64_t drive_size = 0;
+  char *drive_name;
+  char *args[MAX_BATCH_ARGS + 2];
+  char *line = NULL;
+  size_t line_size = 0;
+  int line_num = 0;
+
+  int c;
+  int errorcnt = 0;
+  char *e = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hD:")) != -1)
+  {
+    switch (c)
+    {
+    case 'D':
+      drive_size = strtoull(optarg, &e, 0);
+      errorcnt += check_int_parse(c, e);
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc) {
+    Error("missing drive argument\n");
+    return CGPT_FAILED;
+  }
+
+  drive_name = argv[optind];
+
+  if (CGPT_OK != DriveHold(drive_name, drive_size))
+    return CGPT_FAILED;
+
+  while (!errorcnt && getline(&line, &line_size, stdin) != -1) {
+    int count;
+
+    line_num++;
+    count = SplitLine(line, args, MAX_BATCH_ARGS);
+    if (count < 0) {
+      Error("line %d: can't parse arguments\n", line_num);
+      errorcnt++;
+      break;
+    }
+    if (!count)
+      continue;
+
+    if (!strncmp("batch", args[0], strlen(args[0]))) {
+      Error("line %d: batch can't be nested\n", line_num);
+      errorcnt++;
+      break;
+    }
+
+    // Commands parse their options from argv[1], as for main().
+    args[count++] = drive_name;
+    args[count] = NULL;
+    optind = 0;
+    if (CGPT_OK != run_command(args[0], count, args)) {
+      Error("line %d: %s failed\n", line_num, args[0]);
+      errorcnt++;
+    }
+  }
+  free(line);
+
+  if (errorcnt) {
+    (void) DriveRelease(0);
+    return CGPT_FAILED;
+  }
+
+  return DriveRelease(1);
+}
@@ -123,8 +123,11 @@ int cmd_find(int argc, char *argv[]) {
         Error("Unable to read from %s\n", optarg);
         errorcnt++;
       }
-      // Go ahead and allocate space for the comparison too
-      params.comparebuf = (uint8_t *)malloc(params.matchlen);
+      // Go ahead and allocate space for the comparison too. The partition
+      // data is read and compared a piece at a time.
+      params.comparebuf = (uint8_t *)malloc(
+          params.matchlen < CGPT_FIND_COMPARE_SIZE ?
+          params.matchlen : CGPT_FIND_COMPARE_SIZE);
       if (!params.comparebuf) {
         Error("Unable to allocate %" PRIu64 "bytes for comparison buffer\n",
               params.matchlen);
@@ -16,7 +16,7 @@ extern const char* progname;
 
 static void Usage(void)
 {
-  printf("\nUsage: %s show [OPTIONS] DRIVE\n\n"
+  printf("\nUsage: %s show [OPTIONS] DRIVE [DRIVE ...]\n\n"
          "Display the GPT table.\n\n"
          "Units are blocks by default.\n\n"
          "Options:\n"
@@ -26,6 +26,10 @@ static void Usage(void)
          "  -n           Numeric output only\n"
          "  -v           Verbose output\n"
          "  -q           Quick output\n"
+         "  -m           Machine-readable output; one line of tab-separated\n"
+         "                 drive, partition, start, size, type guid, unique\n"
+         "                 guid, attributes and label per partition, with\n"
+         "                 control characters in the label shown as '?'\n"
          "  -i NUM       Show specified partition only\n"
          "  -d           Debug output (including invalid headers)\n"
          "\n"
@@ -53,7 +57,7 @@ int cmd_show(int argc, char *argv[]) {
   char *e = 0;
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hnvqi:bstulSTPRBAdD:")) != -1)
+  while ((c=getopt(argc, argv, ":hnvqmi:bstulSTPRBAdD:")) != -1)
   {
     switch (c)
     {
@@ -70,6 +74,9 @@ int cmd_show(int argc, char *argv[]) {
     case 'q':
       params.quick = 1;
       break;
+    case 'm':
+      params.machine = 1;
+      break;
     case 'i':
       params.partition = (uint32_t)strtoul(optarg, &e, 0);
       errorcnt += check_int_parse(c, e);
@@ -122,6 +129,10 @@ int cmd_show(int argc, char *argv[]) {
     Error("-i required when displaying a single item\n");
     errorcnt++;
   }
+  if (params.machine && params.single_item) {
+    Error("-m can't be used when displaying a single item\n");
+    errorcnt++;
+  }
   if (errorcnt)
   {
     Usage();
@@ -134,7 +145,16 @@ int cmd_show(int argc, char *argv[]) {
     return CGPT_FAILED;
   }
 
-  params.drive_name = argv[optind];
+  // Show each drive in turn, carrying on past any which fail.
+  int ret = CGPT_OK;
+  int first = optind, many = argc - optind > 1;
+  for (; optind < argc; optind++) {
+    params.drive_name = argv[optind];
+    if (many && !params.machine)
+      printf("%s%s:\n", optind == first ? "" : "\n", params.drive_name);
+    if (CGPT_OK != CgptShow(&params))
+      ret = CGPT_FAILED;
+  }
 
-  return CgptShow(&params);
+  return ret;
 }
@@ -22,6 +22,8 @@ vb2_error_t vb2api_fw_phase1(struct vb2_context *ctx)
 	vb2_error_t rv;
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 
+	vb2_record_timestamp(ctx, VB2_TS_FW_PHASE1_START);
+
 	/* Initialize NV context */
 	vb2_nv_init(ctx);
 
@@ -109,6 +111,8 @@ vb2_error_t vb2api_fw_phase2(struct vb2_context *ctx)
 {
 	vb2_error_t rv;
 
+	vb2_record_timestamp(ctx, VB2_TS_FW_PHASE2_START);
+
 	/*
 	 * Use the slot from the last boot if this is a resume.  Do not set
 	 * VB2_SD_STATUS_CHOSE_SLOT so the try counter is not decremented on
@@ -148,6 +152,158 @@ vb2_error_t vb2api_fw_phase2(struct vb2_context *ctx)
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2api_fw_prepare_other_slot(struct vb2_context *ctx,
+					 void *workbuf, uint32_t size,
+					 struct vb2_context **other_ctxptr)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_shared_data *other_sd;
+	struct vb2_context *other;
+	uint32_t slot = sd->fw_slot;
+	vb2_error_t rv;
+
+	/*
+	 * Only useful once a slot has been chosen for a normal boot.  If the
+	 * other slot failed last boot, failing this one goes to recovery,
+	 * so there's nothing to fall back to.
+	 */
+	if (!(sd->status & VB2_SD_STATUS_CHOSE_SLOT) ||
+	    (ctx->flags & VB2_CONTEXT_RECOVERY_MODE) ||
+	    (sd->last_fw_slot == 1 - slot &&
+	     sd->last_fw_result == VB2_FW_RESULT_FAILURE))
+		return VB2_ERROR_API_PREPARE_OTHER_SLOT;
+
+	/* Copy the context as it stands after phase 2 */
+	rv = vb2api_relocate(workbuf, sd, size, &other);
+	if (rv)
+		return rv;
+	other_sd = vb2_get_sd(other);
+
+	/*
+	 * Leave the copy as the next boot would have found it if this slot
+	 * failed: vb2api_fail() marks this slot failed and tries the other
+	 * one next, then vb2_select_fw_slot() picks it.
+	 */
+	other_sd->last_fw_slot = slot;
+	other_sd->last_fw_result = VB2_FW_RESULT_FAILURE;
+	vb2_nv_set(other, VB2_NV_FW_PREV_TRIED, slot);
+	vb2_nv_set(other, VB2_NV_FW_PREV_RESULT, VB2_FW_RESULT_FAILURE);
+	vb2_nv_set(other, VB2_NV_FW_RESULT, VB2_FW_RESULT_UNKNOWN);
+	vb2_nv_set(other, VB2_NV_TRY_COUNT, 0);
+	vb2_nv_set(other, VB2_NV_TRY_NEXT, 1 - slot);
+	vb2_nv_set(other, VB2_NV_FW_TRIED, 1 - slot);
+
+	other_sd->fw_slot = 1 - slot;
+	if (other_sd->fw_slot)
+		other->flags |= VB2_CONTEXT_FW_SLOT_B;
+	else
+		other->flags &= ~VB2_CONTEXT_FW_SLOT_B;
+
+	*other_ctxptr = other;
+	return VB2_SUCCESS;
+}
+
+/*
+ * Hash state for a tree hashed firmware body when vboot splits the body into
+ * chunks itself.  Lives in the work buffer hash area.
+ */
+struct vb2_tree_hash_context {
+	/* Root digest over the chunk digests; must be first */
+	struct vb2_digest_context root;
+
+	/* Digest of the current chunk */
+	struct vb2_digest_context chunk;
+
+	/* Bytes left to hash in the current chunk */
+	uint32_t chunk_remaining;
+
+	/* Scratch for each finished chunk's digest */
+	uint8_t chunk_digest[VB2_MAX_DIGEST_SIZE];
+};
+
+/**
+ * Return non-zero if vboot is tree hashing the body data passed to
+ * vb2api_extend_hash() itself.
+ */
+static int vb2_hash_is_tree(struct vb2_shared_data *sd)
+{
+	const struct vb2_fw_preamble *pre = (const struct vb2_fw_preamble *)
+		vb2_member_of(sd, sd->preamble_offset);
+
+	return sd->hash_tag == VB2_HASH_TAG_FW_BODY &&
+		(pre->flags & VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH);
+}
+
+/**
+ * Start the next tree hash chunk, if any data remains.
+ *
+ * @param tc		Tree hash context
+ * @param remaining	Bytes of body data not yet hashed
+ * @return VB2_SUCCESS, or error code on error.
+ */
+static vb2_error_t vb2_tree_hash_next_chunk(struct vb2_tree_hash_context *tc,
+					    uint32_t remaining)
+{
+	tc->chunk_remaining = VB2_MIN(remaining, VB2_TREE_HASH_CHUNK_SIZE);
+	if (!tc->chunk_remaining)
+		return VB2_SUCCESS;
+
+	return vb2_digest_init(&tc->chunk, tc->root.hash_alg);
+}
+
+static vb2_error_t vb2_tree_hash_extend(struct vb2_shared_data *sd,
+					const uint8_t *buf, uint32_t size)
+{
+	struct vb2_tree_hash_context *tc = (struct vb2_tree_hash_context *)
+		vb2_member_of(sd, sd->hash_offset);
+	uint32_t chunk_digest_size = vb2_digest_size(tc->root.hash_alg);
+	uint32_t len;
+	vb2_error_t rv;
+
+	while (size) {
+		len = VB2_MIN(size, tc->chunk_remaining);
+		rv = vb2_digest_extend(&tc->chunk, buf, len);
+		if (rv)
+			return rv;
+		buf += len;
+		size -= len;
+		tc->chunk_remaining -= len;
+
+		if (tc->chunk_remaining)
+			continue;
+
+		/* Chunk is complete; fold its digest into the root */
+		rv = vb2_digest_finalize(&tc->chunk, tc->chunk_digest,
+					 chunk_digest_size);
+		if (rv)
+			return rv;
+		rv = vb2_digest_extend(&tc->root, tc->chunk_digest,
+				       chunk_digest_size);
+		if (rv)
+			return rv;
+
+		/* The caller's remaining size has already been reduced */
+		rv = vb2_tree_hash_next_chunk(tc,
+					      sd->hash_remaining_size + size);
+		if (rv)
+			return rv;
+	}
+
+	return VB2_SUCCESS;
+}
+
+/**
+ * Wait for any outstanding async hardware crypto extend to finish.
+ */
+static vb2_error_t vb2_hwcrypto_wait(struct vb2_digest_context *dc)
+{
+	if (!dc->hwcrypto_pending)
+		return VB2_SUCCESS;
+
+	dc->hwcrypto_pending = 0;
+	return vb2ex_hwcrypto_digest_wait();
+}
+
 vb2_error_t vb2api_extend_hash(struct vb2_context *ctx,
 		       const void *buf,
 		       uint32_t size)
@@ -155,21 +311,159 @@ vb2_error_t vb2api_extend_hash(struct vb2_context *ctx,
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	struct vb2_digest_context *dc = (struct vb2_digest_context *)
 		vb2_member_of(sd, sd->hash_offset);
+	vb2_error_t rv;
 
 	/* Must have initialized hash digest work area */
 	if (!sd->hash_size)
 		return VB2_ERROR_API_EXTEND_HASH_WORKBUF;
 
+	/* Chunk digests must be passed to vb2api_extend_hash_chunk_digest() */
+	if (sd->hash_tag == VB2_HASH_TAG_FW_BODY_TREE)
+		return VB2_ERROR_API_EXTEND_HASH_TAG;
+
 	/* Don't extend past the data we expect to hash */
 	if (!size || size > sd->hash_remaining_size)
 		return VB2_ERROR_API_EXTEND_HASH_SIZE;
 
 	sd->hash_remaining_size -= size;
 
-	if (dc->using_hwcrypto)
-		return vb2ex_hwcrypto_digest_extend(buf, size);
-	else
-		return vb2_digest_extend(dc, buf, size);
+	if (vb2_hash_is_tree(sd)) {
+		rv = vb2_tree_hash_extend(sd, buf, size);
+	} else if (dc->using_hwcrypto) {
+		rv = vb2_hwcrypto_wait(dc);
+		if (rv)
+			return rv;
+		rv = vb2ex_hwcrypto_digest_extend(buf, size);
+	} else {
+		rv = vb2_digest_extend(dc, buf, size);
+	}
+	if (rv)
+		return rv;
+
+	vb2_record_timestamp(ctx, VB2_TS_HASH_EXTEND);
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2api_extend_hash_async(struct vb2_context *ctx,
+				     const void *buf,
+				     uint32_t size)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_digest_context *dc = (struct vb2_digest_context *)
+		vb2_member_of(sd, sd->hash_offset);
+	vb2_error_t rv;
+
+	/* Must have initialized hash digest work area */
+	if (!sd->hash_size)
+		return VB2_ERROR_API_EXTEND_HASH_WORKBUF;
+
+	/* Software hashing is synchronous anyway */
+	if (!dc->using_hwcrypto)
+		return vb2api_extend_hash(ctx, buf, size);
+
+	/* Don't extend past the data we expect to hash */
+	if (!size || size > sd->hash_remaining_size)
+		return VB2_ERROR_API_EXTEND_HASH_SIZE;
+
+	/* Engine must be done with the previous buffer first */
+	rv = vb2_hwcrypto_wait(dc);
+	if (rv)
+		return rv;
+
+	sd->hash_remaining_size -= size;
+
+	rv = vb2ex_hwcrypto_digest_extend_async(buf, size);
+	if (rv)
+		return rv;
+
+	/* Timed at submission; the wait shows up in the next record */
+	vb2_record_timestamp(ctx, VB2_TS_HASH_EXTEND);
+
+	dc->hwcrypto_pending = 1;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2api_extend_hash_mapped(struct vb2_context *ctx,
+				      const struct vb2_mapped_region *region)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	const uint8_t *buf = region->base;
+	uint32_t size = region->size;
+	uint32_t len, next_len;
+	vb2_error_t rv;
+
+	/* Check the whole region up front, so a bad size hashes nothing */
+	if (!sd->hash_size)
+		return VB2_ERROR_API_EXTEND_HASH_WORKBUF;
+	if (!size || size > sd->hash_remaining_size)
+		return VB2_ERROR_API_EXTEND_HASH_SIZE;
+
+	/* End the first stride on a stride boundary */
+	len = VB2_MAPPED_HASH_STRIDE -
+		((uintptr_t)buf & (VB2_MAPPED_HASH_STRIDE - 1));
+
+	while (size) {
+		len = VB2_MIN(len, size);
+
+		next_len = VB2_MIN(size - len, VB2_MAPPED_HASH_STRIDE);
+		if (next_len && (region->flags & VB2_MAPPED_REGION_CACHED))
+			vb2ex_prefetch_mapped(buf + len, next_len);
+
+		rv = vb2api_extend_hash(ctx, buf, len);
+		if (rv)
+			return rv;
+
+		buf += len;
+		size -= len;
+		len = VB2_MAPPED_HASH_STRIDE;
+	}
+
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2api_extend_hash_chunk_digest(struct vb2_context *ctx,
+					    const void *digest,
+					    uint32_t digest_size)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_digest_context *dc = (struct vb2_digest_context *)
+		vb2_member_of(sd, sd->hash_offset);
+	vb2_error_t rv;
+
+	/* Must have initialized hash digest work area */
+	if (!sd->hash_size)
+		return VB2_ERROR_API_EXTEND_HASH_WORKBUF;
+
+	if (sd->hash_tag != VB2_HASH_TAG_FW_BODY_TREE)
+		return VB2_ERROR_API_EXTEND_HASH_TAG;
+
+	if (digest_size != vb2_digest_size(dc->hash_alg))
+		return VB2_ERROR_API_EXTEND_HASH_DIGEST_SIZE;
+
+	/* Don't extend past the number of chunks we expect */
+	if (digest_size > sd->hash_remaining_size)
+		return VB2_ERROR_API_EXTEND_HASH_SIZE;
+
+	sd->hash_remaining_size -= digest_size;
+
+	rv = vb2_digest_extend(dc, digest, digest_size);
+	if (rv)
+		return rv;
+
+	vb2_record_timestamp(ctx, VB2_TS_HASH_EXTEND);
+	return VB2_SUCCESS;
+}
+
+enum vb2_hash_algorithm vb2api_get_hash_alg(struct vb2_context *ctx)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_digest_context *dc = (struct vb2_digest_context *)
+		vb2_member_of(sd, sd->hash_offset);
+
+	if (!sd->hash_size)
+		return VB2_HASH_INVALID;
+
+	return dc->hash_alg;
 }
 
 vb2_error_t vb2api_get_pcr_digest(struct vb2_context *ctx,
@@ -205,16 +499,42 @@ vb2_error_t vb2api_get_pcr_digest(struct vb2_context *ctx,
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2api_get_pcr_events(struct vb2_context *ctx,
+				  struct vb2_pcr_event *events,
+				  uint32_t *count)
+{
+	vb2_error_t rv;
+	int i;
+
+	if (*count < VB2_PCR_DIGEST_COUNT)
+		return VB2_ERROR_API_PCR_DIGEST_BUF;
+
+	for (i = 0; i < VB2_PCR_DIGEST_COUNT; i++) {
+		events[i].pcr = i;
+		events[i].digest_size = sizeof(events[i].digest);
+		rv = vb2api_get_pcr_digest(ctx, i, events[i].digest,
+					   &events[i].digest_size);
+		if (rv)
+			return rv;
+	}
+
+	*count = VB2_PCR_DIGEST_COUNT;
+	return VB2_SUCCESS;
+}
+
 vb2_error_t vb2api_fw_phase3(struct vb2_context *ctx)
 {
 	vb2_error_t rv;
 
+	vb2_record_timestamp(ctx, VB2_TS_FW_PHASE3_START);
+
 	/* Verify firmware keyblock */
 	rv = vb2_load_fw_keyblock(ctx);
 	if (rv) {
 		vb2api_fail(ctx, VB2_RECOVERY_RO_INVALID_RW, rv);
 		return rv;
 	}
+	vb2_record_timestamp(ctx, VB2_TS_FW_KEYBLOCK_VERIFIED);
 
 	/* Verify firmware preamble */
 	rv = vb2_load_fw_preamble(ctx);
@@ -222,6 +542,7 @@ vb2_error_t vb2api_fw_phase3(struct vb2_context *ctx)
 		vb2api_fail(ctx, VB2_RECOVERY_RO_INVALID_RW, rv);
 		return rv;
 	}
+	vb2_record_timestamp(ctx, VB2_TS_FW_PREAMBLE_VERIFIED);
 
 	return VB2_SUCCESS;
 }
@@ -233,6 +554,8 @@ vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag)
 	struct vb2_digest_context *dc;
 	struct vb2_public_key key;
 	struct vb2_workbuf wb;
+	uint32_t dig_size;
+	uint32_t tree;
 	vb2_error_t rv;
 
 	vb2_workbuf_from_ctx(ctx, &wb);
@@ -246,17 +569,25 @@ vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag)
 	pre = (const struct vb2_fw_preamble *)
 		vb2_member_of(sd, sd->preamble_offset);
 
-	/* For now, we only support the firmware body tag */
-	if (tag != VB2_HASH_TAG_FW_BODY)
+	/* For now, we only support the firmware body tags */
+	if (tag != VB2_HASH_TAG_FW_BODY && tag != VB2_HASH_TAG_FW_BODY_TREE)
 		return VB2_ERROR_API_INIT_HASH_TAG;
 
+	/* The caller can only supply chunk digests if the body is a tree */
+	tree = pre->flags & VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH;
+	if (tag == VB2_HASH_TAG_FW_BODY_TREE && !tree)
+		return VB2_ERROR_API_INIT_HASH_TAG;
+
+	/* Chunking the body ourselves needs room for a second digest */
+	dig_size = sizeof(*dc);
+	if (tree && tag == VB2_HASH_TAG_FW_BODY)
+		dig_size = sizeof(struct vb2_tree_hash_context);
+
 	/* Allocate workbuf space for the hash */
-	if (sd->hash_size) {
+	if (sd->hash_size >= dig_size) {
 		dc = (struct vb2_digest_context *)
 			vb2_member_of(sd, sd->hash_offset);
 	} else {
-		uint32_t dig_size = sizeof(*dc);
-
 		dc = vb2_workbuf_alloc(&wb, dig_size);
 		if (!dc)
 			return VB2_ERROR_API_INIT_HASH_WORKBUF;
@@ -294,6 +625,25 @@ vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag)
 
 	sd->hash_tag = tag;
 	sd->hash_remaining_size = pre->body_signature.data_size;
+	vb2_record_timestamp(ctx, VB2_TS_HASH_INIT);
+
+	/*
+	 * Tree hashing is done in software.  The caller is free to use
+	 * hardware to produce the chunk digests it passes in.
+	 */
+	if (tag == VB2_HASH_TAG_FW_BODY_TREE) {
+		sd->hash_remaining_size = vb2_digest_size(key.hash_alg) *
+			VB2_TREE_HASH_CHUNKS(pre->body_signature.data_size);
+		return vb2_digest_init(dc, key.hash_alg);
+	} else if (tree) {
+		struct vb2_tree_hash_context *tc =
+			(struct vb2_tree_hash_context *)dc;
+
+		rv = vb2_digest_init(&tc->root, key.hash_alg);
+		if (rv)
+			return rv;
+		return vb2_tree_hash_next_chunk(tc, sd->hash_remaining_size);
+	}
 
 	if (!(pre->flags & VB2_FIRMWARE_PREAMBLE_DISALLOW_HWCRYPTO)) {
 		rv = vb2ex_hwcrypto_digest_init(key.hash_alg,
@@ -303,6 +653,7 @@ vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag)
 				  key.hash_alg);
 			dc->hash_alg = key.hash_alg;
 			dc->using_hwcrypto = 1;
+			dc->hwcrypto_pending = 0;
 			return VB2_SUCCESS;
 		}
 		if (rv != VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED)
@@ -353,15 +704,21 @@ vb2_error_t vb2api_check_hash_get_digest(struct vb2_context *ctx,
 		return VB2_ERROR_API_CHECK_HASH_WORKBUF_DIGEST;
 
 	/* Finalize the digest */
-	if (dc->using_hwcrypto)
+	if (dc->using_hwcrypto) {
+		rv = vb2_hwcrypto_wait(dc);
+		if (rv)
+			return rv;
 		rv = vb2ex_hwcrypto_digest_finalize(digest, digest_size);
-	else
+	} else {
 		rv = vb2_digest_finalize(dc, digest, digest_size);
+	}
 	if (rv)
 		return rv;
+	vb2_record_timestamp(ctx, VB2_TS_HASH_FINALIZE);
 
 	/* The code below is specific to the body signature */
-	if (sd->hash_tag != VB2_HASH_TAG_FW_BODY)
+	if (sd->hash_tag != VB2_HASH_TAG_FW_BODY &&
+	    sd->hash_tag != VB2_HASH_TAG_FW_BODY_TREE)
 		return VB2_ERROR_API_CHECK_HASH_TAG;
 
 	/*
@@ -41,6 +41,108 @@ static int auxfw_sync_allowed(struct vb2_context *ctx)
 	return 1;
 }
 
+enum auxfw_device_state {
+	AUXFW_DEVICE_WAITING,
+	AUXFW_DEVICE_UPDATING,
+	AUXFW_DEVICE_DONE,
+};
+
+/**
+ * Check whether a device on a bus is being updated
+ */
+static int auxfw_bus_busy(const struct vb2_auxfw_device *devices,
+			  const uint8_t *state, uint32_t count, uint32_t bus)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		if (state[i] == AUXFW_DEVICE_UPDATING && devices[i].bus == bus)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Update each Aux FW device which needs it, one per bus at a time
+ *
+ * Once a device fails, no more updates are started, but the ones in progress
+ * are left to finish.
+ *
+ * @param ctx		Vboot2 context
+ * @return VB2_SUCCESS, VB2_ERROR_EX_UNIMPLEMENTED if the platform can't
+ * update devices on their own, or the first device's error.
+ */
+static vb2_error_t update_auxfw_devices(struct vb2_context *ctx)
+{
+	struct vb2_auxfw_device devices[VB2_AUXFW_MAX_DEVICES];
+	uint8_t state[VB2_AUXFW_MAX_DEVICES];
+	uint32_t count = ARRAY_SIZE(devices);
+	uint32_t left = 0;
+	uint32_t i;
+	vb2_error_t first_rv = VB2_SUCCESS;
+	vb2_error_t rv;
+
+	rv = vb2ex_auxfw_get_devices(devices, &count);
+	if (rv)
+		return rv;
+	count = VB2_MIN(count, ARRAY_SIZE(devices));
+
+	for (i = 0; i < count; i++) {
+		if (devices[i].severity > VB_AUX_FW_NO_UPDATE) {
+			state[i] = AUXFW_DEVICE_WAITING;
+			left++;
+		} else {
+			state[i] = AUXFW_DEVICE_DONE;
+		}
+	}
+
+	while (left) {
+		for (i = 0; i < count; i++) {
+			if (state[i] != AUXFW_DEVICE_WAITING)
+				continue;
+			if (first_rv) {
+				state[i] = AUXFW_DEVICE_DONE;
+				left--;
+				continue;
+			}
+			if (auxfw_bus_busy(devices, state, count,
+					   devices[i].bus))
+				continue;
+
+			VB2_DEBUG("Updating auxfw device %u on bus %u\n", i,
+				  devices[i].bus);
+			rv = vb2ex_auxfw_update_start(i);
+			if (rv) {
+				VB2_DEBUG("Device %u failed to start: %#x\n",
+					  i, rv);
+				first_rv = rv;
+				state[i] = AUXFW_DEVICE_DONE;
+				left--;
+				continue;
+			}
+			state[i] = AUXFW_DEVICE_UPDATING;
+		}
+
+		for (i = 0; i < count; i++) {
+			if (state[i] != AUXFW_DEVICE_UPDATING)
+				continue;
+
+			rv = vb2ex_auxfw_update_poll(i);
+			if (rv == VB2_ERROR_EX_AUXFW_BUSY)
+				continue;
+			if (rv) {
+				VB2_DEBUG("Device %u failed: %#x\n", i, rv);
+				if (!first_rv)
+					first_rv = rv;
+			}
+			state[i] = AUXFW_DEVICE_DONE;
+			left--;
+		}
+	}
+
+	return first_rv;
+}
+
 /**
  * Update the specified Aux FW and verify the update succeeded
  *
@@ -55,9 +157,12 @@ static vb2_error_t update_auxfw(struct vb2_context *ctx)
 
 	/*
 	 * The underlying platform is expected to know how and where to find the
-	 * firmware image for all auxfw devices.
+	 * firmware image for all auxfw devices.  Update them separately if it
+	 * knows how, so the slow ones can flash at the same time.
 	 */
-	rv = vb2ex_auxfw_update();
+	rv = update_auxfw_devices(ctx);
+	if (rv == VB2_ERROR_EX_UNIMPLEMENTED)
+		rv = vb2ex_auxfw_update();
 	if (rv != VB2_SUCCESS) {
 		VB2_DEBUG("vb2ex_auxfw_update() returned %d\n", rv);
 
@@ -10,22 +10,36 @@
 #include "2rsa.h"
 #include "2sha.h"
 #include "2sysincludes.h"
+#include "2trace.h"
 
 vb2_error_t vb2_safe_memcmp(const void *s1, const void *s2, size_t size)
 {
 	const unsigned char *us1 = s1;
 	const unsigned char *us2 = s2;
-	int result = 0;
+	uint64_t result = 0;
 
 	if (0 == size)
 		return 0;
 
+	VB2_TRACE_BEGIN(SAFE_MEMCMP);
 	/*
 	 * Code snippet without data-dependent branch due to Nate Lawson
-	 * (nate@root.org) of Root Labs.
+	 * (nate@root.org) of Root Labs.  Compare a word at a time, with the
+	 * odd bytes at the end done singly; the loops only depend on size.
+	 * memcpy() keeps the word loads safe for unaligned buffers.
 	 */
+	while (size >= sizeof(uint64_t)) {
+		uint64_t w1, w2;
+		memcpy(&w1, us1, sizeof(w1));
+		memcpy(&w2, us2, sizeof(w2));
+		result |= w1 ^ w2;
+		us1 += sizeof(w1);
+		us2 += sizeof(w2);
+		size -= sizeof(w1);
+	}
 	while (size--)
 		result |= *us1++ ^ *us2++;
+	VB2_TRACE_END(SAFE_MEMCMP);
 
 	return result != 0;
 }
@@ -56,6 +70,7 @@ void vb2_workbuf_init(struct vb2_workbuf *wb, uint8_t *buf, uint32_t size)
 {
 	wb->buf = buf;
 	wb->size = size;
+	wb->min_size = NULL;
 
 	/* Align the buffer so allocations will be aligned */
 	if (vb2_align(&wb->buf, &wb->size, VB2_WORKBUF_ALIGN, 0))
@@ -75,6 +90,9 @@ void *vb2_workbuf_alloc(struct vb2_workbuf *wb, uint32_t size)
 	wb->buf += size;
 	wb->size -= size;
 
+	if (wb->min_size && wb->size < *wb->min_size)
+		*wb->min_size = wb->size;
+
 	return ptr;
 }
 
@@ -214,6 +232,37 @@ vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
 	return vb2_verify_digest(key, sig, digest, &wblocal);
 }
 
+vb2_error_t vb2_verify_tree_data(const uint8_t *data, uint32_t size,
+				 struct vb2_signature *sig,
+				 const struct vb2_public_key *key,
+				 const struct vb2_workbuf *wb)
+{
+	struct vb2_workbuf wblocal = *wb;
+	uint8_t *digest;
+	uint32_t digest_size;
+	vb2_error_t rv;
+
+	if (sig->data_size > size) {
+		VB2_DEBUG("Data buffer smaller than length of signed data.\n");
+		return VB2_ERROR_VDATA_NOT_ENOUGH_DATA;
+	}
+
+	digest_size = vb2_digest_size(key->hash_alg);
+	if (!digest_size)
+		return VB2_ERROR_VDATA_DIGEST_SIZE;
+
+	digest = vb2_workbuf_alloc(&wblocal, digest_size);
+	if (!digest)
+		return VB2_ERROR_VDATA_WORKBUF_DIGEST;
+
+	rv = vb2_digest_tree_buffer(data, sig->data_size, key->hash_alg,
+				    digest, digest_size);
+	if (rv)
+		return rv;
+
+	return vb2_verify_digest(key, sig, digest, &wblocal);
+}
+
 vb2_error_t vb2_check_keyblock(const struct vb2_keyblock *block, uint32_t size,
 			       const struct vb2_signature *sig)
 {
@@ -292,14 +341,10 @@ vb2_error_t vb2_verify_keyblock(struct vb2_keyblock *block, uint32_t size,
 	return VB2_SUCCESS;
 }
 
-vb2_error_t vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
-				   uint32_t size,
-				   const struct vb2_public_key *key,
-				   const struct vb2_workbuf *wb)
+vb2_error_t vb2_check_fw_preamble(const struct vb2_fw_preamble *preamble,
+				  uint32_t size)
 {
-	struct vb2_signature *sig = &preamble->preamble_signature;
-
-	VB2_DEBUG("Verifying preamble.\n");
+	const struct vb2_signature *sig = &preamble->preamble_signature;
 
 	/* Sanity checks before attempting signature of data */
 	if(size < sizeof(*preamble)) {
@@ -335,11 +380,6 @@ vb2_error_t vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
 		return VB2_ERROR_PREAMBLE_SIGNED_TOO_MUCH;
 	}
 
-	if (vb2_verify_data((const uint8_t *)preamble, size, sig, key, wb)) {
-		VB2_DEBUG("Preamble signature validation failed\n");
-		return VB2_ERROR_PREAMBLE_SIG_INVALID;
-	}
-
 	/* Verify we signed enough data */
 	if (sig->data_size < sizeof(struct vb2_fw_preamble)) {
 		VB2_DEBUG("Didn't sign enough data\n");
@@ -360,6 +400,28 @@ vb2_error_t vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
 		return VB2_ERROR_PREAMBLE_KERNEL_SUBKEY_OUTSIDE;
 	}
 
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
+				   uint32_t size,
+				   const struct vb2_public_key *key,
+				   const struct vb2_workbuf *wb)
+{
+	struct vb2_signature *sig = &preamble->preamble_signature;
+	vb2_error_t rv;
+
+	VB2_DEBUG("Verifying preamble.\n");
+
+	rv = vb2_check_fw_preamble(preamble, size);
+	if (rv)
+		return rv;
+
+	if (vb2_verify_data((const uint8_t *)preamble, size, sig, key, wb)) {
+		VB2_DEBUG("Preamble signature validation failed\n");
+		return VB2_ERROR_PREAMBLE_SIG_INVALID;
+	}
+
 	/* Success */
 	return VB2_SUCCESS;
 }
@@ -15,12 +15,27 @@ void vb2_workbuf_from_ctx(struct vb2_context *ctx, struct vb2_workbuf *wb)
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	vb2_workbuf_init(wb, (void *)sd + sd->workbuf_used,
 			 sd->workbuf_size - sd->workbuf_used);
+	wb->min_size = &sd->workbuf_min_free;
 }
 
 void vb2_set_workbuf_used(struct vb2_context *ctx, uint32_t used)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	sd->workbuf_used = vb2_wb_round_up(used);
+	if (sd->workbuf_size - sd->workbuf_used < sd->workbuf_min_free)
+		sd->workbuf_min_free = sd->workbuf_size - sd->workbuf_used;
+}
+
+uint32_t vb2api_get_workbuf_peak(struct vb2_context *ctx)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	return sd->workbuf_size - sd->workbuf_min_free;
+}
+
+void vb2api_reset_workbuf_peak(struct vb2_context *ctx)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	sd->workbuf_min_free = sd->workbuf_size - sd->workbuf_used;
 }
 
 vb2_error_t vb2api_init(void *workbuf, uint32_t size,
@@ -44,11 +59,28 @@ vb2_error_t vb2api_init(void *workbuf, uint32_t size,
 	sd->struct_version_minor = VB2_SHARED_DATA_VERSION_MINOR;
 	sd->workbuf_size = size;
 	sd->workbuf_used = vb2_wb_round_up(sizeof(*sd));
+	sd->workbuf_min_free = size - sd->workbuf_used;
 
 	*ctxptr = &sd->ctx;
 	return VB2_SUCCESS;
 }
 
+/*
+ * Check that a region the shared data points at lies in the used part of the
+ * work buffer, past the shared data itself.  Anything outside it would not
+ * survive vb2api_relocate().  Regions with zero size aren't stored.
+ */
+static int vb2_sd_region_valid(const struct vb2_shared_data *sd,
+			       uint32_t offset, uint32_t size)
+{
+	if (!size)
+		return 1;
+
+	return offset >= vb2_wb_round_up(sizeof(*sd)) &&
+		offset <= sd->workbuf_used &&
+		size <= sd->workbuf_used - offset;
+}
+
 #pragma GCC diagnostic push
 /* Don't warn for the version_minor check even if the checked version is 0. */
 #pragma GCC diagnostic ignored "-Wtype-limits"
@@ -57,6 +89,7 @@ vb2_error_t vb2api_relocate(void *new_workbuf, const void *cur_workbuf,
 {
 	const struct vb2_shared_data *cur_sd = cur_workbuf;
 	struct vb2_shared_data *new_sd;
+	uint32_t peak;
 
 	if (!vb2_aligned(new_workbuf, VB2_WORKBUF_ALIGN))
 		return VB2_ERROR_WORKBUF_ALIGN;
@@ -76,9 +109,29 @@ vb2_error_t vb2api_relocate(void *new_workbuf, const void *cur_workbuf,
 	if (cur_sd->workbuf_size < cur_sd->workbuf_used)
 		return VB2_ERROR_WORKBUF_INVALID;
 
+	/*
+	 * Verified state handed over by an earlier stage is adopted as is,
+	 * so make sure everything it points at came along with it.
+	 */
+	if (!vb2_sd_region_valid(cur_sd, cur_sd->gbb_offset,
+				 cur_sd->gbb_offset ?
+				 sizeof(struct vb2_gbb_header) : 0) ||
+	    !vb2_sd_region_valid(cur_sd, cur_sd->data_key_offset,
+				 cur_sd->data_key_size) ||
+	    !vb2_sd_region_valid(cur_sd, cur_sd->preamble_offset,
+				 cur_sd->preamble_size) ||
+	    !vb2_sd_region_valid(cur_sd, cur_sd->hash_offset,
+				 cur_sd->hash_size) ||
+	    !vb2_sd_region_valid(cur_sd, cur_sd->kernel_key_offset,
+				 cur_sd->kernel_key_size))
+		return VB2_ERROR_WORKBUF_INVALID;
+
 	if (cur_sd->workbuf_used > size)
 		return VB2_ERROR_WORKBUF_SMALL;
 
+	/* The peak is kept as free space, so remember it across resizing */
+	peak = VB2_MIN(cur_sd->workbuf_size - cur_sd->workbuf_min_free, size);
+
 	/* Relocate if necessary. */
 	if (cur_workbuf != new_workbuf)
 		memmove(new_workbuf, cur_workbuf, cur_sd->workbuf_used);
@@ -86,6 +139,7 @@ vb2_error_t vb2api_relocate(void *new_workbuf, const void *cur_workbuf,
 	/* Set the new size, and return the context pointer. */
 	new_sd = new_workbuf;
 	new_sd->workbuf_size = size;
+	new_sd->workbuf_min_free = size - peak;
 	*ctxptr = &new_sd->ctx;
 
 	return VB2_SUCCESS;
@@ -18,6 +18,36 @@
 	((select) == VB_SELECT_FIRMWARE_READONLY ?		\
 	 VB2_SD_FLAG_ECSYNC_EC_RO : VB2_SD_FLAG_ECSYNC_EC_RW)
 
+/* ECs which can't hash in the background do it all in vb2ex_ec_hash_image() */
+__attribute__((weak))
+vb2_error_t vb2ex_ec_hash_image_start(enum vb2_firmware_selection select)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+/* ECs which can't update block by block rewrite the whole image */
+__attribute__((weak))
+vb2_error_t vb2ex_ec_get_expected_block_hashes(
+	enum vb2_firmware_selection select, const uint8_t **hashes,
+	uint32_t *count)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+vb2_error_t vb2ex_ec_hash_blocks(enum vb2_firmware_selection select,
+				 uint8_t *hashes, uint32_t count)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+vb2_error_t vb2ex_ec_update_blocks(enum vb2_firmware_selection select,
+				   uint32_t first, uint32_t count)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
 /**
  * Display the WAIT screen
  */
@@ -133,6 +163,75 @@ static vb2_error_t check_ec_hash(struct vb2_context *ctx,
 	return VB2_SUCCESS;
 }
 
+static int block_differs(const uint8_t *have, const uint8_t *want,
+			 uint32_t block)
+{
+	return memcmp(have + block * VB2_SHA256_DIGEST_SIZE,
+		      want + block * VB2_SHA256_DIGEST_SIZE,
+		      VB2_SHA256_DIGEST_SIZE);
+}
+
+/**
+ * Rewrite only the blocks of the EC image whose hashes have changed
+ *
+ * @param ctx		Vboot2 context
+ * @param select	Which firmware image to update
+ * @return VB2_SUCCESS, VB2_ERROR_EX_UNIMPLEMENTED if the whole image must be
+ * rewritten instead, or error code from vb2ex_ec_update_blocks().
+ */
+static vb2_error_t update_ec_blocks(struct vb2_context *ctx,
+				    enum vb2_firmware_selection select)
+{
+	const uint8_t *want;
+	uint8_t *have;
+	struct vb2_workbuf wb;
+	uint32_t count, first, end, written = 0;
+	vb2_error_t rv;
+
+	rv = vb2ex_ec_get_expected_block_hashes(select, &want, &count);
+	if (rv || !count)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+
+	vb2_workbuf_from_ctx(ctx, &wb);
+	have = vb2_workbuf_alloc(&wb, count * VB2_SHA256_DIGEST_SIZE);
+	if (!have)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+
+	rv = vb2ex_ec_hash_blocks(select, have, count);
+	if (rv) {
+		if (rv != VB2_ERROR_EX_UNIMPLEMENTED)
+			VB2_DEBUG("vb2ex_ec_hash_blocks() returned %#x\n", rv);
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+	}
+
+	/* Write each run of changed blocks */
+	for (first = 0; first < count; first = end) {
+		if (!block_differs(have, want, first)) {
+			end = first + 1;
+			continue;
+		}
+		for (end = first + 1;
+		     end < count && block_differs(have, want, end); end++)
+			;
+
+		VB2_DEBUG("Updating blocks %u-%u of %u\n", first, end - 1,
+			  count);
+		/* VB2_ERROR_EX_UNIMPLEMENTED rewrites the whole image */
+		rv = vb2ex_ec_update_blocks(select, first, end - first);
+		if (rv)
+			return rv;
+		written += end - first;
+	}
+
+	/* The image hash differed, so the block hashes should have too */
+	if (!written) {
+		VB2_DEBUG("No blocks differ; rewriting the whole image\n");
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+	}
+
+	return VB2_SUCCESS;
+}
+
 /**
  * Update the specified EC and verify the update succeeded
  *
@@ -144,11 +243,16 @@ static vb2_error_t update_ec(struct vb2_context *ctx,
 			     enum vb2_firmware_selection select)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	int whole_image = 0;
 	vb2_error_t rv;
 
 	VB2_DEBUG("Updating %s...\n", image_name_to_string(select));
 
-	rv = vb2ex_ec_update_image(select);
+	rv = update_ec_blocks(ctx, select);
+	if (rv == VB2_ERROR_EX_UNIMPLEMENTED) {
+		whole_image = 1;
+		rv = vb2ex_ec_update_image(select);
+	}
 	if (rv != VB2_SUCCESS) {
 		VB2_DEBUG("vb2ex_ec_update_image() returned %#x\n", rv);
 
@@ -167,8 +271,15 @@ static vb2_error_t update_ec(struct vb2_context *ctx,
 		return rv;
 	}
 
-	/* Verify the EC was updated properly */
+	/*
+	 * Verify the EC was updated properly, unless it checked the whole
+	 * image as it wrote it; hashing the whole image again is slow.
+	 */
 	sd->flags &= ~SYNC_FLAG(select);
+	if (EC_VERIFIED_UPDATE && whole_image) {
+		VB2_DEBUG("EC verified the update\n");
+		return VB2_SUCCESS;
+	}
 	if (check_ec_hash(ctx, select) != VB2_SUCCESS)
 		return VBERROR_EC_REBOOT_TO_RO_REQUIRED;
 	if (sd->flags & SYNC_FLAG(select)) {
@@ -431,6 +542,22 @@ static vb2_error_t ec_sync_phase2(struct vb2_context *ctx)
 	return sync_ec(ctx);
 }
 
+void vb2api_ec_sync_start(struct vb2_context *ctx)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	vb2_error_t rv;
+
+	if (sd->flags & VB2_SD_STATUS_EC_SYNC_COMPLETE)
+		return;
+	if ((ctx->flags & VB2_CONTEXT_RECOVERY_MODE) || !ec_sync_allowed(ctx))
+		return;
+
+	/* Phase 1 always checks the active RW image first */
+	rv = vb2ex_ec_hash_image_start(VB_SELECT_FIRMWARE_EC_ACTIVE);
+	if (rv && rv != VB2_ERROR_EX_UNIMPLEMENTED)
+		VB2_DEBUG("vb2ex_ec_hash_image_start() returned %#x\n", rv);
+}
+
 vb2_error_t vb2api_ec_sync(struct vb2_context *ctx)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
@@ -0,0 +1,507 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * ECDSA signature verification on the NIST P-256 curve.
+ *
+ * Numbers are 256-bit little endian arrays of 32-bit words.  Field and scalar
+ * arithmetic use Montgomery multiplication with R = 2^256, and are written
+ * without data dependent branches or memory accesses.  Points are held in
+ * Jacobian coordinates, with Z = 0 for the point at infinity.
+ *
+ * Verification only ever handles public values (key, signature and digest),
+ * so the point arithmetic and the double scalar multiplication are free to
+ * branch on them.
+ */
+
+#include "2common.h"
+#include "2ecdsa.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "2sysincludes.h"
+
+#define WORDS VB2_P256_WORDS
+
+/* Modulus for Montgomery arithmetic */
+struct p256_mod {
+	uint32_t m[WORDS];	/* Modulus */
+	uint32_t m0inv;		/* -1 / m[0] mod 2^32 */
+	uint32_t rr[WORDS];	/* R^2 mod m */
+};
+
+/* Point in Jacobian coordinates, each in Montgomery form */
+struct p256_point {
+	uint32_t x[WORDS];
+	uint32_t y[WORDS];
+	uint32_t z[WORDS];
+};
+
+/* Field prime p = 2^256 - 2^224 + 2^192 + 2^96 - 1 */
+static const struct p256_mod p256_p = {
+	.m = {0xffffffff, 0xffffffff, 0xffffffff, 0x00000000,
+	      0x00000000, 0x00000000, 0x00000001, 0xffffffff},
+	.m0inv = 0x00000001,
+	.rr = {0x00000003, 0x00000000, 0xffffffff, 0xfffffffb,
+	       0xfffffffe, 0xffffffff, 0xfffffffd, 0x00000004},
+};
+
+/* Group order n */
+static const struct p256_mod p256_n = {
+	.m = {0xfc632551, 0xf3b9cac2, 0xa7179e84, 0xbce6faad,
+	      0xffffffff, 0xffffffff, 0x00000000, 0xffffffff},
+	.m0inv = 0xee00bc4f,
+	.rr = {0xbe79eea2, 0x83244c95, 0x49bd6fa6, 0x4699799c,
+	       0x2b6bec59, 0x2845b239, 0xf3d95620, 0x66e12d94},
+};
+
+/* Curve constant b, in Montgomery form */
+static const uint32_t p256_b[WORDS] = {
+	0x29c4bddf, 0xd89cdf62, 0x78843090, 0xacf005cd,
+	0xf7212ed6, 0xe5a220ab, 0x04874834, 0xdc30061d,
+};
+
+/* Base point G, in Montgomery form */
+static const struct p256_point p256_g = {
+	.x = {0x18a9143c, 0x79e730d4, 0x5fedb601, 0x75ba95fc,
+	      0x77622510, 0x79fb732b, 0xa53755c6, 0x18905f76},
+	.y = {0xce95560a, 0xddf25357, 0xba19e45c, 0x8b4ab8e4,
+	      0xdd21f325, 0xd2e88688, 0x25885d85, 0x8571ff18},
+	/* R mod p */
+	.z = {0x00000001, 0x00000000, 0x00000000, 0xffffffff,
+	      0xffffffff, 0xffffffff, 0xfffffffe, 0x00000000},
+};
+
+uint32_t vb2_ecdsa_sig_size(enum vb2_signature_algorithm sig_alg)
+{
+	switch (sig_alg) {
+#if VB2_SUPPORT_ECDSA_P256
+	case VB2_SIG_ECDSA_P256:
+		return 2 * VB2_P256_BYTES;
+#endif
+	default:
+		return 0;
+	}
+}
+
+/**
+ * r = a + b, returning the carry out.
+ */
+static uint32_t add_words(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	uint64_t carry = 0;
+	int i;
+
+	for (i = 0; i < WORDS; i++) {
+		carry += (uint64_t)a[i] + b[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	return (uint32_t)carry;
+}
+
+/**
+ * r = a - b, returning the borrow out.
+ */
+static uint32_t sub_words(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	int64_t borrow = 0;
+	int i;
+
+	for (i = 0; i < WORDS; i++) {
+		borrow += (int64_t)a[i] - b[i];
+		r[i] = (uint32_t)borrow;
+		borrow >>= 32;
+	}
+	return (uint32_t)borrow & 1;
+}
+
+/**
+ * Return non-zero if a < m.
+ */
+static int less_than(const uint32_t *a, const uint32_t *m)
+{
+	uint32_t t[WORDS];
+
+	return sub_words(t, a, m);
+}
+
+static int is_zero(const uint32_t *a)
+{
+	uint32_t bits = 0;
+	int i;
+
+	for (i = 0; i < WORDS; i++)
+		bits |= a[i];
+	return !bits;
+}
+
+/**
+ * Subtract the modulus from carry:r[] once, if that doesn't go negative.
+ *
+ * Brings values below 2m back below m.
+ */
+static void reduce_once(const struct p256_mod *mod, uint32_t *r,
+			uint32_t carry)
+{
+	uint32_t t[WORDS];
+	uint32_t borrow = sub_words(t, r, mod->m);
+	uint32_t mask = 0 - (carry | (borrow ^ 1));
+	int i;
+
+	for (i = 0; i < WORDS; i++)
+		r[i] = (t[i] & mask) | (r[i] & ~mask);
+}
+
+/**
+ * r = a + b mod m, for a, b < m.
+ */
+static void mod_add(const struct p256_mod *mod, uint32_t *r,
+		    const uint32_t *a, const uint32_t *b)
+{
+	reduce_once(mod, r, add_words(r, a, b));
+}
+
+/**
+ * r = a - b mod m, for a, b < m.
+ */
+static void mod_sub(const struct p256_mod *mod, uint32_t *r,
+		    const uint32_t *a, const uint32_t *b)
+{
+	uint32_t t[WORDS];
+	uint32_t mask = 0 - sub_words(r, a, b);
+	int i;
+
+	for (i = 0; i < WORDS; i++)
+		t[i] = mod->m[i] & mask;
+	add_words(r, r, t);
+}
+
+/**
+ * Montgomery multiplication r = a * b / R mod m, for a, b < m.
+ *
+ * r may alias a or b.
+ */
+static void mont_mul(const struct p256_mod *mod, uint32_t *r,
+		     const uint32_t *a, const uint32_t *b)
+{
+	uint32_t t[WORDS + 2] = {0};
+	uint64_t c;
+	uint32_t d;
+	int i, j;
+
+	for (i = 0; i < WORDS; i++) {
+		c = 0;
+		for (j = 0; j < WORDS; j++) {
+			c += t[j] + (uint64_t)a[j] * b[i];
+			t[j] = (uint32_t)c;
+			c >>= 32;
+		}
+		c += t[WORDS];
+		t[WORDS] = (uint32_t)c;
+		t[WORDS + 1] = (uint32_t)(c >> 32);
+
+		/* Add d * m to clear the low word, then shift it out */
+		d = t[0] * mod->m0inv;
+		c = (t[0] + (uint64_t)d * mod->m[0]) >> 32;
+		for (j = 1; j < WORDS; j++) {
+			c += t[j] + (uint64_t)d * mod->m[j];
+			t[j - 1] = (uint32_t)c;
+			c >>= 32;
+		}
+		c += t[WORDS];
+		t[WORDS - 1] = (uint32_t)c;
+		t[WORDS] = t[WORDS + 1] + (uint32_t)(c >> 32);
+	}
+
+	/* t < 2m, so one subtraction is enough */
+	reduce_once(mod, t, t[WORDS]);
+	memcpy(r, t, WORDS * sizeof(uint32_t));
+}
+
+/**
+ * Convert to Montgomery form: r = a * R mod m.
+ */
+static void to_mont(const struct p256_mod *mod, uint32_t *r,
+		    const uint32_t *a)
+{
+	mont_mul(mod, r, a, mod->rr);
+}
+
+/**
+ * Convert from Montgomery form: r = a / R mod m.
+ */
+static void from_mont(const struct p256_mod *mod, uint32_t *r,
+		      const uint32_t *a)
+{
+	static const uint32_t one[WORDS] = {1};
+
+	mont_mul(mod, r, a, one);
+}
+
+/**
+ * Montgomery inverse r = 1 / a, as a^(m - 2) since m is prime.
+ *
+ * The exponent is a public constant, so scanning its bits is fine.
+ */
+static void mont_inv(const struct p256_mod *mod, uint32_t *r,
+		     const uint32_t *a)
+{
+	uint32_t e[WORDS];
+	uint32_t x[WORDS];
+	int i;
+
+	memcpy(e, mod->m, sizeof(e));
+	e[0] -= 2;  /* Low word of both moduli is well above 2 */
+
+	/* Top bit of m - 2 is always set */
+	memcpy(x, a, sizeof(x));
+	for (i = 254; i >= 0; i--) {
+		mont_mul(mod, x, x, x);
+		if ((e[i / 32] >> (i % 32)) & 1)
+			mont_mul(mod, x, x, a);
+	}
+	memcpy(r, x, sizeof(x));
+}
+
+/**
+ * Read a big endian number.
+ */
+static void from_bytes(uint32_t *r, const uint8_t *buf)
+{
+	int i;
+
+	for (i = 0; i < WORDS; i++) {
+		const uint8_t *p = buf + (WORDS - 1 - i) * sizeof(uint32_t);
+
+		r[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+			((uint32_t)p[2] << 8) | p[3];
+	}
+}
+
+/**
+ * r = 2 * a.
+ *
+ * "dbl-2001-b" from the Explicit-Formulas Database, for a = -3.  Infinity
+ * doubles to infinity, since Z3 comes out as zero.
+ */
+static void p256_double(struct p256_point *r, const struct p256_point *a)
+{
+	const struct p256_mod *p = &p256_p;
+	uint32_t delta[WORDS], gamma[WORDS], beta[WORDS], alpha[WORDS];
+	uint32_t t[WORDS], u[WORDS];
+
+	mont_mul(p, delta, a->z, a->z);
+	mont_mul(p, gamma, a->y, a->y);
+	mont_mul(p, beta, a->x, gamma);
+
+	/* alpha = 3 * (X1 - delta) * (X1 + delta) */
+	mod_sub(p, t, a->x, delta);
+	mod_add(p, u, a->x, delta);
+	mont_mul(p, alpha, t, u);
+	mod_add(p, t, alpha, alpha);
+	mod_add(p, alpha, alpha, t);
+
+	/* Z3 = (Y1 + Z1)^2 - gamma - delta */
+	mod_add(p, t, a->y, a->z);
+	mont_mul(p, t, t, t);
+	mod_sub(p, t, t, gamma);
+	mod_sub(p, r->z, t, delta);
+
+	/* X3 = alpha^2 - 8 * beta */
+	mod_add(p, beta, beta, beta);
+	mod_add(p, beta, beta, beta);
+	mont_mul(p, t, alpha, alpha);
+	mod_sub(p, t, t, beta);
+	mod_sub(p, r->x, t, beta);
+
+	/* Y3 = alpha * (4 * beta - X3) - 8 * gamma^2 */
+	mod_sub(p, t, beta, r->x);
+	mont_mul(p, t, alpha, t);
+	mont_mul(p, gamma, gamma, gamma);
+	mod_add(p, gamma, gamma, gamma);
+	mod_add(p, gamma, gamma, gamma);
+	mod_add(p, gamma, gamma, gamma);
+	mod_sub(p, r->y, t, gamma);
+}
+
+/**
+ * r = a + b.
+ *
+ * "add-2007-bl" from the Explicit-Formulas Database, plus the cases it
+ * doesn't cover: either input at infinity, a == b and a == -b.
+ */
+static void p256_add(struct p256_point *r, const struct p256_point *a,
+		     const struct p256_point *b)
+{
+	const struct p256_mod *p = &p256_p;
+	uint32_t z1z1[WORDS], z2z2[WORDS], u1[WORDS], u2[WORDS];
+	uint32_t s1[WORDS], s2[WORDS], h[WORDS], rr[WORDS];
+	uint32_t i[WORDS], j[WORDS], v[WORDS], t[WORDS];
+
+	if (is_zero(a->z)) {
+		*r = *b;
+		return;
+	}
+	if (is_zero(b->z)) {
+		*r = *a;
+		return;
+	}
+
+	mont_mul(p, z1z1, a->z, a->z);
+	mont_mul(p, z2z2, b->z, b->z);
+	mont_mul(p, u1, a->x, z2z2);
+	mont_mul(p, u2, b->x, z1z1);
+	mont_mul(p, s1, a->y, b->z);
+	mont_mul(p, s1, s1, z2z2);
+	mont_mul(p, s2, b->y, a->z);
+	mont_mul(p, s2, s2, z1z1);
+	mod_sub(p, h, u2, u1);
+	mod_sub(p, rr, s2, s1);
+
+	if (is_zero(h)) {
+		if (is_zero(rr))
+			p256_double(r, a);
+		else
+			memset(r, 0, sizeof(*r));
+		return;
+	}
+
+	/* I = (2 * H)^2, J = H * I, r = 2 * (S2 - S1), V = U1 * I */
+	mod_add(p, i, h, h);
+	mont_mul(p, i, i, i);
+	mont_mul(p, j, h, i);
+	mod_add(p, rr, rr, rr);
+	mont_mul(p, v, u1, i);
+
+	/* Z3 = ((Z1 + Z2)^2 - Z1Z1 - Z2Z2) * H */
+	mod_add(p, t, a->z, b->z);
+	mont_mul(p, t, t, t);
+	mod_sub(p, t, t, z1z1);
+	mod_sub(p, t, t, z2z2);
+	mont_mul(p, r->z, t, h);
+
+	/* X3 = r^2 - J - 2 * V */
+	mont_mul(p, t, rr, rr);
+	mod_sub(p, t, t, j);
+	mod_sub(p, t, t, v);
+	mod_sub(p, r->x, t, v);
+
+	/* Y3 = r * (V - X3) - 2 * S1 * J */
+	mod_sub(p, t, v, r->x);
+	mont_mul(p, t, rr, t);
+	mont_mul(p, s1, s1, j);
+	mod_add(p, s1, s1, s1);
+	mod_sub(p, r->y, t, s1);
+}
+
+/**
+ * Return non-zero if the affine point (x, y), in Montgomery form, satisfies
+ * y^2 = x^3 - 3 * x + b.
+ */
+static int p256_on_curve(const uint32_t *x, const uint32_t *y)
+{
+	const struct p256_mod *p = &p256_p;
+	uint32_t lhs[WORDS], rhs[WORDS], t[WORDS];
+
+	mont_mul(p, lhs, y, y);
+
+	mont_mul(p, rhs, x, x);
+	mont_mul(p, rhs, rhs, x);
+	mod_add(p, t, x, x);
+	mod_add(p, t, t, x);
+	mod_sub(p, rhs, rhs, t);
+	mod_add(p, rhs, rhs, p256_b);
+
+	return !vb2_safe_memcmp(lhs, rhs, sizeof(lhs));
+}
+
+vb2_error_t vb2_ecdsa_verify_digest(const struct vb2_public_key *key,
+				    const uint8_t *sig, const uint8_t *digest)
+{
+	const struct p256_mod *n = &p256_n;
+	struct p256_point table[3], acc;
+	uint32_t r[WORDS], s[WORDS], e[WORDS], w[WORDS];
+	uint32_t u1[WORDS], u2[WORDS];
+	uint8_t e_bytes[VB2_P256_BYTES];
+	uint32_t digest_size;
+	int bit, i;
+
+	if (!key || !sig || !digest)
+		return VB2_ERROR_ECDSA_VERIFY_PARAM;
+
+	digest_size = vb2_digest_size(key->hash_alg);
+	if (!VB2_SUPPORT_ECDSA_P256 || key->sig_alg != VB2_SIG_ECDSA_P256 ||
+	    key->arrsize != WORDS || !digest_size) {
+		VB2_DEBUG("Invalid signature type!\n");
+		return VB2_ERROR_ECDSA_VERIFY_ALGORITHM;
+	}
+
+	/* r and s must both be in [1, n - 1] */
+	from_bytes(r, sig);
+	from_bytes(s, sig + VB2_P256_BYTES);
+	if (is_zero(r) || !less_than(r, n->m) ||
+	    is_zero(s) || !less_than(s, n->m)) {
+		VB2_DEBUG("Signature out of range!\n");
+		return VB2_ERROR_ECDSA_VERIFY_SIG;
+	}
+
+	/* The public key must be a point on the curve */
+	if (!less_than(key->n, p256_p.m) || !less_than(key->rr, p256_p.m)) {
+		VB2_DEBUG("Public key out of range!\n");
+		return VB2_ERROR_ECDSA_VERIFY_KEY;
+	}
+	to_mont(&p256_p, table[1].x, key->n);
+	to_mont(&p256_p, table[1].y, key->rr);
+	memcpy(table[1].z, p256_g.z, sizeof(table[1].z));
+	if (!p256_on_curve(table[1].x, table[1].y)) {
+		VB2_DEBUG("Public key not on curve!\n");
+		return VB2_ERROR_ECDSA_VERIFY_KEY;
+	}
+
+	/* e is the leftmost 256 bits of the digest, reduced mod n */
+	memset(e_bytes, 0, sizeof(e_bytes));
+	if (digest_size >= sizeof(e_bytes))
+		memcpy(e_bytes, digest, sizeof(e_bytes));
+	else
+		memcpy(e_bytes + sizeof(e_bytes) - digest_size, digest,
+		       digest_size);
+	from_bytes(e, e_bytes);
+	reduce_once(n, e, 0);
+
+	/* u1 = e / s, u2 = r / s */
+	to_mont(n, w, s);
+	mont_inv(n, w, w);
+	mont_mul(n, u1, e, w);
+	mont_mul(n, u2, r, w);
+
+	/* u1 * G + u2 * Q, scanning both scalars at once */
+	table[0] = p256_g;
+	p256_add(&table[2], &table[0], &table[1]);
+	memset(&acc, 0, sizeof(acc));
+	for (i = 255; i >= 0; i--) {
+		p256_double(&acc, &acc);
+		bit = ((u1[i / 32] >> (i % 32)) & 1) |
+			(((u2[i / 32] >> (i % 32)) & 1) << 1);
+		if (bit)
+			p256_add(&acc, &acc, &table[bit - 1]);
+	}
+
+	if (is_zero(acc.z)) {
+		VB2_DEBUG("Digest check failed!\n");
+		return VB2_ERROR_ECDSA_VERIFY_DIGEST;
+	}
+
+	/* Affine x = X / Z^2, then reduce mod n and compare against r */
+	mont_inv(&p256_p, w, acc.z);
+	mont_mul(&p256_p, w, w, w);
+	mont_mul(&p256_p, w, acc.x, w);
+	from_mont(&p256_p, w, w);
+	reduce_once(n, w, 0);
+
+	if (vb2_safe_memcmp(w, r, sizeof(r))) {
+		VB2_DEBUG("Digest check failed!\n");
+		return VB2_ERROR_ECDSA_VERIFY_DIGEST;
+	}
+
+	return VB2_SUCCESS;
+}
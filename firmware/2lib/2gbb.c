@@ -14,6 +14,7 @@ static vb2_error_t vb2_gbb_read_key(struct vb2_context *ctx, uint32_t offset,
 				    struct vb2_workbuf *wb)
 {
 	struct vb2_workbuf wblocal = *wb;
+	uint32_t area_size;
 	vb2_error_t rv;
 
 	/* Check offset and size. */
@@ -22,6 +23,33 @@ static vb2_error_t vb2_gbb_read_key(struct vb2_context *ctx, uint32_t offset,
 	if (*size < sizeof(**keyp))
 		return VB2_ERROR_GBB_INVALID;
 
+	/*
+	 * If the whole GBB area fits in the workbuf, fetch it with a single
+	 * read and trim off any padding afterwards.  Each read can be a
+	 * separate SPI transaction, so this saves one per key.
+	 */
+	*keyp = vb2_workbuf_alloc(&wblocal, *size);
+	if (*keyp) {
+		rv = vb2ex_read_resource(ctx, VB2_RES_GBB, offset, *keyp,
+					 *size);
+		if (rv)
+			return rv;
+
+		rv = vb2_verify_packed_key_inside(*keyp, *size, *keyp);
+		if (rv)
+			return rv;
+
+		/* Deal with a zero-size key (used in testing). */
+		area_size = *size;
+		*size = (*keyp)->key_offset + (*keyp)->key_size;
+		*size = VB2_MAX(*size, sizeof(**keyp));
+
+		/* Shrinking keeps the key where it is */
+		*keyp = vb2_workbuf_realloc(&wblocal, area_size, *size);
+		*wb = wblocal;
+		return VB2_SUCCESS;
+	}
+
 	/* GBB header might be padded.  Retrieve the vb2_packed_key
 	   header so we can find out what the real size is. */
 	*keyp = vb2_workbuf_alloc(&wblocal, sizeof(**keyp));
@@ -7,21 +7,17 @@
 #include "2sha.h"
 #include "2sysincludes.h"
 
-int hmac(enum vb2_hash_algorithm alg,
-	 const void *key, uint32_t key_size,
-	 const void *msg, uint32_t msg_size,
-	 uint8_t *mac, uint32_t mac_size)
+int vb2_hmac_init_key(struct vb2_hmac_context *ctx,
+		      enum vb2_hash_algorithm alg,
+		      const void *key, uint32_t key_size)
 {
 	uint32_t block_size;
 	uint32_t digest_size;
 	uint8_t k[VB2_MAX_BLOCK_SIZE];
-	uint8_t o_pad[VB2_MAX_BLOCK_SIZE];
-	uint8_t i_pad[VB2_MAX_BLOCK_SIZE];
-	uint8_t b[VB2_MAX_DIGEST_SIZE];
-	struct vb2_digest_context dc;
+	uint8_t pad[VB2_MAX_BLOCK_SIZE];
 	int i;
 
-	if (!key | !msg | !mac)
+	if (!ctx || !key)
 		return -1;
 
 	digest_size = vb2_digest_size(alg);
@@ -29,11 +25,10 @@ int hmac(enum vb2_hash_algorithm alg,
 	if (!digest_size || !block_size)
 		return -1;
 
-	if (mac_size < digest_size)
-		return -1;
-
 	if (key_size > block_size) {
-		vb2_digest_buffer((uint8_t *)key, key_size, alg, k, block_size);
+		if (vb2_digest_buffer((uint8_t *)key, key_size, alg, k,
+				      block_size))
+			return -1;
 		key_size = digest_size;
 	} else {
 		memcpy(k, key, key_size);
@@ -41,20 +36,74 @@ int hmac(enum vb2_hash_algorithm alg,
 	if (key_size < block_size)
 		memset(k + key_size, 0, block_size - key_size);
 
-	for (i = 0; i < block_size; i++) {
-		o_pad[i] = 0x5c ^ k[i];
-		i_pad[i] = 0x36 ^ k[i];
-	}
+	for (i = 0; i < block_size; i++)
+		pad[i] = 0x36 ^ k[i];
+	if (vb2_digest_init(&ctx->inner, alg) ||
+	    vb2_digest_extend(&ctx->inner, pad, block_size))
+		return -1;
+
+	for (i = 0; i < block_size; i++)
+		pad[i] = 0x5c ^ k[i];
+	if (vb2_digest_init(&ctx->outer, alg) ||
+	    vb2_digest_extend(&ctx->outer, pad, block_size))
+		return -1;
 
-	vb2_digest_init(&dc, alg);
-	vb2_digest_extend(&dc, i_pad, block_size);
-	vb2_digest_extend(&dc, msg, msg_size);
-	vb2_digest_finalize(&dc, b, digest_size);
+	ctx->dc = ctx->inner;
+	return 0;
+}
+
+int vb2_hmac_update(struct vb2_hmac_context *ctx,
+		    const void *msg, uint32_t msg_size)
+{
+	if (!ctx || !msg)
+		return -1;
+
+	if (vb2_digest_extend(&ctx->dc, msg, msg_size))
+		return -1;
+
+	return 0;
+}
 
-	vb2_digest_init(&dc, alg);
-	vb2_digest_extend(&dc, o_pad, block_size);
-	vb2_digest_extend(&dc, b, digest_size);
-	vb2_digest_finalize(&dc, mac, mac_size);
+int vb2_hmac_final(struct vb2_hmac_context *ctx,
+		   uint8_t *mac, uint32_t mac_size)
+{
+	uint8_t b[VB2_MAX_DIGEST_SIZE];
+	uint32_t digest_size;
+
+	if (!ctx || !mac)
+		return -1;
+
+	digest_size = vb2_digest_size(ctx->dc.hash_alg);
+	if (!digest_size || mac_size < digest_size)
+		return -1;
+
+	if (vb2_digest_finalize(&ctx->dc, b, digest_size))
+		return -1;
+
+	ctx->dc = ctx->outer;
+	if (vb2_digest_extend(&ctx->dc, b, digest_size) ||
+	    vb2_digest_finalize(&ctx->dc, mac, mac_size))
+		return -1;
+
+	/* Ready for the next message */
+	ctx->dc = ctx->inner;
+	return 0;
+}
+
+int hmac(enum vb2_hash_algorithm alg,
+	 const void *key, uint32_t key_size,
+	 const void *msg, uint32_t msg_size,
+	 uint8_t *mac, uint32_t mac_size)
+{
+	struct vb2_hmac_context ctx;
+
+	if (!key | !msg | !mac)
+		return -1;
+
+	if (vb2_hmac_init_key(&ctx, alg, key, key_size) ||
+	    vb2_hmac_update(&ctx, msg, msg_size) ||
+	    vb2_hmac_final(&ctx, mac, mac_size))
+		return -1;
 
 	return 0;
 }
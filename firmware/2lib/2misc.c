@@ -425,3 +425,103 @@ int vb2api_need_reboot_for_display(struct vb2_context *ctx)
 	}
 	return 0;
 }
+
+void vb2_record_timestamp(struct vb2_context *ctx,
+			  enum vb2_timestamp_event event)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_timestamp *ts;
+
+	if (event == VB2_TS_HASH_EXTEND && sd->timestamp_count) {
+		ts = &sd->timestamps[(sd->timestamp_count - 1) %
+				     VB2_TIMESTAMP_COUNT];
+		if (ts->event == VB2_TS_HASH_EXTEND) {
+			ts->time_us = vb2ex_utime();
+			return;
+		}
+	}
+
+	ts = &sd->timestamps[sd->timestamp_count % VB2_TIMESTAMP_COUNT];
+	ts->event = event;
+	ts->time_us = vb2ex_utime();
+	sd->timestamp_count++;
+}
+
+/* Data spaces tracked by vb2_drop_unchanged_data() */
+enum commit_space {
+	COMMIT_NV,
+	COMMIT_SECDATA_FIRMWARE,
+	COMMIT_SECDATA_KERNEL,
+	COMMIT_SPACE_COUNT,
+};
+
+struct commit_info {
+	uint32_t context_flag;
+	uint32_t status_flag;
+	uint8_t *data;
+	uint8_t *committed;
+	uint32_t size;
+};
+
+static void get_commit_info(struct vb2_context *ctx, enum commit_space space,
+			    struct commit_info *info)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+
+	switch (space) {
+	case COMMIT_NV:
+		info->context_flag = VB2_CONTEXT_NVDATA_CHANGED;
+		info->status_flag = VB2_SD_STATUS_NV_SNAPSHOT;
+		info->data = ctx->nvdata;
+		info->committed = sd->committed_nvdata;
+		info->size = vb2_nv_get_size(ctx);
+		break;
+	case COMMIT_SECDATA_FIRMWARE:
+		info->context_flag = VB2_CONTEXT_SECDATA_FIRMWARE_CHANGED;
+		info->status_flag = VB2_SD_STATUS_SECDATA_FIRMWARE_SNAPSHOT;
+		info->data = ctx->secdata_firmware;
+		info->committed = sd->committed_secdata_firmware;
+		info->size = sizeof(sd->committed_secdata_firmware);
+		break;
+	default:
+		info->context_flag = VB2_CONTEXT_SECDATA_KERNEL_CHANGED;
+		info->status_flag = VB2_SD_STATUS_SECDATA_KERNEL_SNAPSHOT;
+		info->data = ctx->secdata_kernel;
+		info->committed = sd->committed_secdata_kernel;
+		info->size = sizeof(sd->committed_secdata_kernel);
+		break;
+	}
+}
+
+void vb2_drop_unchanged_data(struct vb2_context *ctx)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct commit_info info;
+	int i;
+
+	for (i = 0; i < COMMIT_SPACE_COUNT; i++) {
+		get_commit_info(ctx, i, &info);
+		if ((ctx->flags & info.context_flag) &&
+		    (sd->status & info.status_flag) &&
+		    !memcmp(info.data, info.committed, info.size)) {
+			VB2_DEBUG("skipping unchanged space %d\n", i);
+			ctx->flags &= ~info.context_flag;
+		}
+	}
+}
+
+void vb2_mark_data_committed(struct vb2_context *ctx, uint32_t changed)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct commit_info info;
+	int i;
+
+	for (i = 0; i < COMMIT_SPACE_COUNT; i++) {
+		get_commit_info(ctx, i, &info);
+		if (!(changed & info.context_flag) ||
+		    (ctx->flags & info.context_flag))
+			continue;
+		memcpy(info.committed, info.data, info.size);
+		sd->status |= info.status_flag;
+	}
+}
@@ -64,6 +64,11 @@ void vb2_nv_init(struct vb2_context *ctx)
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	uint8_t *p = ctx->nvdata;
 
+	/* Remember what storage holds, unless the caller already changed it */
+	if (!(ctx->flags & VB2_CONTEXT_NVDATA_CHANGED)) {
+		memcpy(sd->committed_nvdata, p, vb2_nv_get_size(ctx));
+		sd->status |= VB2_SD_STATUS_NV_SNAPSHOT;
+	}
 
 	/* Check data for consistency */
 	if (vb2_nv_check_crc(ctx) != VB2_SUCCESS) {
@@ -85,109 +90,123 @@ void vb2_nv_init(struct vb2_context *ctx)
 	sd->status |= VB2_SD_STATUS_NV_INIT;
 }
 
-/* Macro for vb2_nv_get() single-bit settings to reduce duplicate code. */
-#define GETBIT(offs, mask) (p[offs] & mask ? 1 : 0)
-
-uint32_t vb2_nv_get(struct vb2_context *ctx, enum vb2_nv_param param)
+/*
+ * Where each param lives in the nvdata.  Params which fit in a single byte
+ * are described by the byte offset and mask of their bits; vb2_nv_get() and
+ * vb2_nv_set() index this table rather than switching on the param.  Params
+ * with a zero mask span several bytes (or are deprecated), and are handled by
+ * vb2_nv_get_wide() / vb2_nv_set_wide().
+ *
+ * New params must be added here; a missing entry reads as 0 and ignores
+ * writes, like a deprecated param.
+ */
+struct vb2_nv_field {
+	uint8_t offs;		/* Byte offset in nvdata */
+	uint8_t mask;		/* Mask of field bits in byte, 0 if wide */
+	uint8_t shift;		/* Shift of lowest field bit */
+	uint8_t over;		/* How to map out of range values on set */
+	uint8_t invalid;	/* Replacement value for VB2_NV_OVER_INVALID */
+};
+
+enum vb2_nv_over {
+	/* Clip to the largest value (single bits: any non-zero sets) */
+	VB2_NV_OVER_CLIP = 0,
+	/* Keep only the bits which fit */
+	VB2_NV_OVER_TRUNCATE,
+	/* Replace with vb2_nv_field.invalid */
+	VB2_NV_OVER_INVALID,
+};
+
+#define FIELD(offs, mask) FIELD_OVER(offs, mask, VB2_NV_OVER_CLIP, 0)
+#define FIELD_OVER(offs, mask, over, invalid) \
+	{ offs, mask, __builtin_ctz(mask), over, invalid }
+
+static const struct vb2_nv_field nv_fields[VB2_NV_PARAM_COUNT] = {
+	[VB2_NV_FIRMWARE_SETTINGS_RESET] =
+		FIELD(VB2_NV_OFFS_HEADER, VB2_NV_HEADER_FW_SETTINGS_RESET),
+	[VB2_NV_KERNEL_SETTINGS_RESET] =
+		FIELD(VB2_NV_OFFS_HEADER, VB2_NV_HEADER_KERNEL_SETTINGS_RESET),
+	[VB2_NV_DEBUG_RESET_MODE] =
+		FIELD(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DEBUG_RESET),
+	[VB2_NV_TRY_NEXT] =
+		FIELD(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRY_NEXT),
+	[VB2_NV_TRY_COUNT] =
+		FIELD(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_TRY_COUNT_MASK),
+	/*
+	 * Map values outside the valid range to the legacy reason, since we
+	 * can't determine if we're called from kernel or user mode.
+	 */
+	[VB2_NV_RECOVERY_REQUEST] =
+		FIELD_OVER(VB2_NV_OFFS_RECOVERY, 0xff,
+			   VB2_NV_OVER_INVALID, VB2_RECOVERY_LEGACY),
+	/* Map values outside the valid range to the default index */
+	[VB2_NV_LOCALIZATION_INDEX] =
+		FIELD_OVER(VB2_NV_OFFS_LOCALIZATION, 0xff,
+			   VB2_NV_OVER_INVALID, 0),
+	[VB2_NV_DEV_BOOT_USB] =
+		FIELD(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_USB),
+	[VB2_NV_DEV_BOOT_LEGACY] =
+		FIELD(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_LEGACY),
+	[VB2_NV_DEV_BOOT_SIGNED_ONLY] =
+		FIELD(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_SIGNED_ONLY),
+	/* Map out of range values to disk */
+	[VB2_NV_DEV_DEFAULT_BOOT] =
+		FIELD_OVER(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_DEFAULT_BOOT,
+			   VB2_NV_OVER_INVALID, VB2_DEV_DEFAULT_BOOT_DISK),
+	[VB2_NV_DEV_ENABLE_UDC] =
+		FIELD(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_UDC),
+	[VB2_NV_DISABLE_DEV_REQUEST] =
+		FIELD(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISABLE_DEV),
+	[VB2_NV_DISPLAY_REQUEST] =
+		FIELD(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISPLAY_REQUEST),
+	[VB2_NV_CLEAR_TPM_OWNER_REQUEST] =
+		FIELD(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_REQUEST),
+	[VB2_NV_CLEAR_TPM_OWNER_DONE] =
+		FIELD(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_DONE),
+	[VB2_NV_TPM_REQUESTED_REBOOT] =
+		FIELD(VB2_NV_OFFS_TPM, VB2_NV_TPM_REBOOTED),
+	[VB2_NV_RECOVERY_SUBCODE] =
+		FIELD_OVER(VB2_NV_OFFS_RECOVERY_SUBCODE, 0xff,
+			   VB2_NV_OVER_TRUNCATE, 0),
+	[VB2_NV_BACKUP_NVRAM_REQUEST] =
+		FIELD(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_BACKUP_NVRAM),
+	[VB2_NV_FW_TRIED] =
+		FIELD(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRIED),
+	/* Map out of range values to unknown */
+	[VB2_NV_FW_RESULT] =
+		FIELD_OVER(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_RESULT_MASK,
+			   VB2_NV_OVER_INVALID, VB2_FW_RESULT_UNKNOWN),
+	[VB2_NV_FW_PREV_TRIED] =
+		FIELD(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_PREV_TRIED),
+	[VB2_NV_FW_PREV_RESULT] =
+		FIELD_OVER(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_PREV_RESULT_MASK,
+			   VB2_NV_OVER_INVALID, VB2_FW_RESULT_UNKNOWN),
+	[VB2_NV_REQ_WIPEOUT] =
+		FIELD(VB2_NV_OFFS_HEADER, VB2_NV_HEADER_WIPEOUT),
+	[VB2_NV_BOOT_ON_AC_DETECT] =
+		FIELD(VB2_NV_OFFS_MISC, VB2_NV_MISC_BOOT_ON_AC_DETECT),
+	[VB2_NV_TRY_RO_SYNC] =
+		FIELD(VB2_NV_OFFS_MISC, VB2_NV_MISC_TRY_RO_SYNC),
+	[VB2_NV_BATTERY_CUTOFF_REQUEST] =
+		FIELD(VB2_NV_OFFS_MISC, VB2_NV_MISC_BATTERY_CUTOFF),
+	[VB2_NV_POST_EC_SYNC_DELAY] =
+		FIELD(VB2_NV_OFFS_MISC, VB2_NV_MISC_POST_EC_SYNC_DELAY),
+	[VB2_NV_DIAG_REQUEST] =
+		FIELD(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_REQ_DIAG),
+};
+
+#undef FIELD
+#undef FIELD_OVER
+
+static uint32_t vb2_nv_get_wide(struct vb2_context *ctx,
+				enum vb2_nv_param param)
 {
 	const uint8_t *p = ctx->nvdata;
 
-	/*
-	 * TODO: We could reduce the binary size for this code by #ifdef'ing
-	 * out the params not used by firmware verification.
-	 */
 	switch (param) {
-	case VB2_NV_FIRMWARE_SETTINGS_RESET:
-		return GETBIT(VB2_NV_OFFS_HEADER,
-			      VB2_NV_HEADER_FW_SETTINGS_RESET);
-
-	case VB2_NV_KERNEL_SETTINGS_RESET:
-		return GETBIT(VB2_NV_OFFS_HEADER,
-			      VB2_NV_HEADER_KERNEL_SETTINGS_RESET);
-
-	case VB2_NV_DEBUG_RESET_MODE:
-		return GETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DEBUG_RESET);
-
-	case VB2_NV_TRY_NEXT:
-		return GETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRY_NEXT);
-
-	case VB2_NV_TRY_COUNT:
-		return p[VB2_NV_OFFS_BOOT] & VB2_NV_BOOT_TRY_COUNT_MASK;
-
-	case VB2_NV_FW_TRIED:
-		return GETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRIED);
-
-	case VB2_NV_FW_RESULT:
-		return p[VB2_NV_OFFS_BOOT2] & VB2_NV_BOOT2_RESULT_MASK;
-
-	case VB2_NV_FW_PREV_TRIED:
-		return GETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_PREV_TRIED);
-
-	case VB2_NV_FW_PREV_RESULT:
-		return (p[VB2_NV_OFFS_BOOT2] & VB2_NV_BOOT2_PREV_RESULT_MASK)
-			>> VB2_NV_BOOT2_PREV_RESULT_SHIFT;
-
-	case VB2_NV_RECOVERY_REQUEST:
-		return p[VB2_NV_OFFS_RECOVERY];
-
-	case VB2_NV_DIAG_REQUEST:
-		return GETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_REQ_DIAG);
-
-	case VB2_NV_RECOVERY_SUBCODE:
-		return p[VB2_NV_OFFS_RECOVERY_SUBCODE];
-
-	case VB2_NV_LOCALIZATION_INDEX:
-		return p[VB2_NV_OFFS_LOCALIZATION];
-
 	case VB2_NV_KERNEL_FIELD:
 		return p[VB2_NV_OFFS_KERNEL1] | (p[VB2_NV_OFFS_KERNEL2] << 8);
 
-	case VB2_NV_DEV_BOOT_USB:
-		return GETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_USB);
-
-	case VB2_NV_DEV_BOOT_LEGACY:
-		return GETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_LEGACY);
-
-	case VB2_NV_DEV_BOOT_SIGNED_ONLY:
-		return GETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_SIGNED_ONLY);
-
-	case VB2_NV_DEV_DEFAULT_BOOT:
-		return (p[VB2_NV_OFFS_DEV] & VB2_NV_DEV_FLAG_DEFAULT_BOOT)
-			>> VB2_NV_DEV_DEFAULT_BOOT_SHIFT;
-
-	case VB2_NV_DEV_ENABLE_UDC:
-		return GETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_UDC);
-
-	case VB2_NV_DISABLE_DEV_REQUEST:
-		return GETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISABLE_DEV);
-
-	case VB2_NV_DISPLAY_REQUEST:
-		return GETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISPLAY_REQUEST);
-
-	case VB2_NV_BACKUP_NVRAM_REQUEST:
-		return GETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_BACKUP_NVRAM);
-
-	case VB2_NV_CLEAR_TPM_OWNER_REQUEST:
-		return GETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_REQUEST);
-
-	case VB2_NV_CLEAR_TPM_OWNER_DONE:
-		return GETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_DONE);
-
-	case VB2_NV_TPM_REQUESTED_REBOOT:
-		return GETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_REBOOTED);
-
-	case VB2_NV_REQ_WIPEOUT:
-		return GETBIT(VB2_NV_OFFS_HEADER , VB2_NV_HEADER_WIPEOUT);
-
-	case VB2_NV_BOOT_ON_AC_DETECT:
-		return GETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BOOT_ON_AC_DETECT);
-
-	case VB2_NV_TRY_RO_SYNC:
-		return GETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_TRY_RO_SYNC);
-
-	case VB2_NV_BATTERY_CUTOFF_REQUEST:
-		return GETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BATTERY_CUTOFF);
-
 	case VB2_NV_KERNEL_MAX_ROLLFORWARD:
 		return (p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD1]
 			| (p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD2] << 8)
@@ -205,231 +224,120 @@ uint32_t vb2_nv_get(struct vb2_context *ctx, enum vb2_nv_param param)
 			| (p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD3] << 16)
 			| ((uint32_t)p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD4] << 24));
 
-	case VB2_NV_POST_EC_SYNC_DELAY:
-		return GETBIT(VB2_NV_OFFS_MISC,
-			      VB2_NV_MISC_POST_EC_SYNC_DELAY);
-
-	case VB2_NV_DEPRECATED_DEV_BOOT_FASTBOOT_FULL_CAP:
-	case VB2_NV_DEPRECATED_FASTBOOT_UNLOCK_IN_FW:
-	case VB2_NV_DEPRECATED_ENABLE_ALT_OS_REQUEST:
-	case VB2_NV_DEPRECATED_DISABLE_ALT_OS_REQUEST:
+	default:
+		/* Deprecated params read as 0 */
 		return 0;
 	}
-
-	/*
-	 * Put default return outside the switch() instead of in default:, so
-	 * that adding a new param will cause a compiler warning.
-	 */
-	return 0;
 }
 
-#undef GETBIT
+uint32_t vb2_nv_get(struct vb2_context *ctx, enum vb2_nv_param param)
+{
+	const struct vb2_nv_field *f;
+
+	if ((unsigned)param >= VB2_NV_PARAM_COUNT)
+		return 0;
 
-/* Macro for vb2_nv_set() single-bit settings to reduce duplicate code. */
-#define SETBIT(offs, mask)					\
-	{ if (value) p[offs] |= mask; else p[offs] &= ~mask; }
+	f = nv_fields + param;
+	if (!f->mask)
+		return vb2_nv_get_wide(ctx, param);
 
-void vb2_nv_set(struct vb2_context *ctx,
-		enum vb2_nv_param param,
-		uint32_t value)
+	return (ctx->nvdata[f->offs] & f->mask) >> f->shift;
+}
+
+void vb2_nv_get_all(struct vb2_context *ctx, uint32_t *values)
 {
-	uint8_t *p = ctx->nvdata;
+	const uint8_t *p = ctx->nvdata;
+	const struct vb2_nv_field *f = nv_fields;
+	int i;
+
+	for (i = 0; i < VB2_NV_PARAM_COUNT; i++, f++)
+		values[i] = (p[f->offs] & f->mask) >> f->shift;
+
+	values[VB2_NV_KERNEL_FIELD] =
+		vb2_nv_get_wide(ctx, VB2_NV_KERNEL_FIELD);
+	values[VB2_NV_KERNEL_MAX_ROLLFORWARD] =
+		vb2_nv_get_wide(ctx, VB2_NV_KERNEL_MAX_ROLLFORWARD);
+	values[VB2_NV_FW_MAX_ROLLFORWARD] =
+		vb2_nv_get_wide(ctx, VB2_NV_FW_MAX_ROLLFORWARD);
+}
 
-	/* If not changing the value, don't regenerate the CRC. */
-	if (vb2_nv_get(ctx, param) == value)
-		return;
+/* Returns 1 if the nvdata changed, 0 if not. */
+static int vb2_nv_set_wide(struct vb2_context *ctx,
+			   enum vb2_nv_param param,
+			   uint32_t value)
+{
+	uint8_t *p = ctx->nvdata;
 
-	/*
-	 * TODO: We could reduce the binary size for this code by #ifdef'ing
-	 * out the params not used by firmware verification.
-	 */
 	switch (param) {
-	case VB2_NV_FIRMWARE_SETTINGS_RESET:
-		SETBIT(VB2_NV_OFFS_HEADER, VB2_NV_HEADER_FW_SETTINGS_RESET);
-		break;
-
-	case VB2_NV_KERNEL_SETTINGS_RESET:
-		SETBIT(VB2_NV_OFFS_HEADER, VB2_NV_HEADER_KERNEL_SETTINGS_RESET);
-		break;
-
-	case VB2_NV_DEBUG_RESET_MODE:
-		SETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DEBUG_RESET);
-		break;
-
-	case VB2_NV_TRY_NEXT:
-		SETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRY_NEXT);
-		break;
-
-	case VB2_NV_TRY_COUNT:
-		/* Clip to valid range. */
-		if (value > VB2_NV_BOOT_TRY_COUNT_MASK)
-			value = VB2_NV_BOOT_TRY_COUNT_MASK;
-
-		p[VB2_NV_OFFS_BOOT] &= ~VB2_NV_BOOT_TRY_COUNT_MASK;
-		p[VB2_NV_OFFS_BOOT] |= (uint8_t)value;
-		break;
-
-	case VB2_NV_FW_TRIED:
-		SETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_TRIED);
-		break;
-
-	case VB2_NV_FW_RESULT:
-		/* Map out of range values to unknown */
-		if (value > VB2_NV_BOOT2_RESULT_MASK)
-			value = VB2_FW_RESULT_UNKNOWN;
-
-		p[VB2_NV_OFFS_BOOT2] &= ~VB2_NV_BOOT2_RESULT_MASK;
-		p[VB2_NV_OFFS_BOOT2] |= (uint8_t)value;
-		break;
-
-	case VB2_NV_FW_PREV_TRIED:
-		SETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_PREV_TRIED);
-		break;
-
-	case VB2_NV_FW_PREV_RESULT:
-		/* Map out of range values to unknown */
-		if (value > VB2_NV_BOOT2_RESULT_MASK)
-			value = VB2_FW_RESULT_UNKNOWN;
-
-		p[VB2_NV_OFFS_BOOT2] &= ~VB2_NV_BOOT2_PREV_RESULT_MASK;
-		p[VB2_NV_OFFS_BOOT2] |=
-			(uint8_t)(value << VB2_NV_BOOT2_PREV_RESULT_SHIFT);
-		break;
-
-	case VB2_NV_RECOVERY_REQUEST:
-		/*
-		 * Map values outside the valid range to the legacy reason,
-		 * since we can't determine if we're called from kernel or user
-		 * mode.
-		 */
-		if (value > 0xff)
-			value = VB2_RECOVERY_LEGACY;
-		p[VB2_NV_OFFS_RECOVERY] = (uint8_t)value;
-		break;
-
-	case VB2_NV_DIAG_REQUEST:
-		SETBIT(VB2_NV_OFFS_BOOT2, VB2_NV_BOOT2_REQ_DIAG);
-		break;
-
-	case VB2_NV_RECOVERY_SUBCODE:
-		p[VB2_NV_OFFS_RECOVERY_SUBCODE] = (uint8_t)value;
-		break;
-
-	case VB2_NV_LOCALIZATION_INDEX:
-		/* Map values outside the valid range to the default index. */
-		if (value > 0xFF)
-			value = 0;
-		p[VB2_NV_OFFS_LOCALIZATION] = (uint8_t)value;
-		break;
-
 	case VB2_NV_KERNEL_FIELD:
 		p[VB2_NV_OFFS_KERNEL1] = (uint8_t)(value);
 		p[VB2_NV_OFFS_KERNEL2] = (uint8_t)(value >> 8);
-		break;
-
-	case VB2_NV_DEV_BOOT_USB:
-		SETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_USB);
-		break;
-
-	case VB2_NV_DEV_BOOT_LEGACY:
-		SETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_LEGACY);
-		break;
-
-	case VB2_NV_DEV_BOOT_SIGNED_ONLY:
-		SETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_SIGNED_ONLY);
-		break;
-
-	case VB2_NV_DEV_DEFAULT_BOOT:
-		/* Map out of range values to disk */
-		if (value > (VB2_NV_DEV_FLAG_DEFAULT_BOOT >>
-			     VB2_NV_DEV_DEFAULT_BOOT_SHIFT))
-			value = VB2_DEV_DEFAULT_BOOT_DISK;
-
-		p[VB2_NV_OFFS_DEV] &= ~VB2_NV_DEV_FLAG_DEFAULT_BOOT;
-		p[VB2_NV_OFFS_DEV] |=
-			(uint8_t)(value << VB2_NV_DEV_DEFAULT_BOOT_SHIFT);
-		break;
-
-	case VB2_NV_DEV_ENABLE_UDC:
-		SETBIT(VB2_NV_OFFS_DEV, VB2_NV_DEV_FLAG_UDC);
-		break;
-
-	case VB2_NV_DISABLE_DEV_REQUEST:
-		SETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISABLE_DEV);
-		break;
-
-	case VB2_NV_DISPLAY_REQUEST:
-		SETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_DISPLAY_REQUEST);
-		break;
-
-	case VB2_NV_BACKUP_NVRAM_REQUEST:
-		SETBIT(VB2_NV_OFFS_BOOT, VB2_NV_BOOT_BACKUP_NVRAM);
-		break;
-
-	case VB2_NV_CLEAR_TPM_OWNER_REQUEST:
-		SETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_REQUEST);
-		break;
-
-	case VB2_NV_CLEAR_TPM_OWNER_DONE:
-		SETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_CLEAR_OWNER_DONE);
-		break;
-
-	case VB2_NV_TPM_REQUESTED_REBOOT:
-		SETBIT(VB2_NV_OFFS_TPM, VB2_NV_TPM_REBOOTED);
-		break;
-
-	case VB2_NV_REQ_WIPEOUT:
-		SETBIT(VB2_NV_OFFS_HEADER , VB2_NV_HEADER_WIPEOUT);
-		break;
-
-	case VB2_NV_BOOT_ON_AC_DETECT:
-		SETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BOOT_ON_AC_DETECT);
-		break;
-
-	case VB2_NV_TRY_RO_SYNC:
-		SETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_TRY_RO_SYNC);
-		break;
-
-	case VB2_NV_BATTERY_CUTOFF_REQUEST:
-		SETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_BATTERY_CUTOFF);
-		break;
+		return 1;
 
 	case VB2_NV_KERNEL_MAX_ROLLFORWARD:
 		p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD1] = (uint8_t)(value);
 		p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD2] = (uint8_t)(value >> 8);
 		p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD3] = (uint8_t)(value >> 16);
 		p[VB2_NV_OFFS_KERNEL_MAX_ROLLFORWARD4] = (uint8_t)(value >> 24);
-		break;
+		return 1;
 
 	case VB2_NV_FW_MAX_ROLLFORWARD:
 		/* Field only present in V2 */
 		if (!(ctx->flags & VB2_CONTEXT_NVDATA_V2))
-			return;
+			return 0;
 
 		p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD1] = (uint8_t)(value);
 		p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD2] = (uint8_t)(value >> 8);
 		p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD3] = (uint8_t)(value >> 16);
 		p[VB2_NV_OFFS_FW_MAX_ROLLFORWARD4] = (uint8_t)(value >> 24);
-		break;
+		return 1;
+
+	default:
+		/* Writes to deprecated params are ignored */
+		return 0;
+	}
+}
+
+void vb2_nv_set(struct vb2_context *ctx,
+		enum vb2_nv_param param,
+		uint32_t value)
+{
+	const struct vb2_nv_field *f;
+	uint32_t max;
+	uint8_t *p;
+
+	if ((unsigned)param >= VB2_NV_PARAM_COUNT)
+		return;
 
-	case VB2_NV_POST_EC_SYNC_DELAY:
-		SETBIT(VB2_NV_OFFS_MISC, VB2_NV_MISC_POST_EC_SYNC_DELAY);
-		break;
+	/* If not changing the value, don't regenerate the CRC. */
+	if (vb2_nv_get(ctx, param) == value)
+		return;
 
-	case VB2_NV_DEPRECATED_DEV_BOOT_FASTBOOT_FULL_CAP:
-	case VB2_NV_DEPRECATED_FASTBOOT_UNLOCK_IN_FW:
-	case VB2_NV_DEPRECATED_ENABLE_ALT_OS_REQUEST:
-	case VB2_NV_DEPRECATED_DISABLE_ALT_OS_REQUEST:
+	f = nv_fields + param;
+	if (!f->mask) {
+		if (vb2_nv_set_wide(ctx, param, value))
+			vb2_nv_regen_crc(ctx);
 		return;
 	}
 
-	/*
-	 * Note there is no default case.  This causes a compiler warning if
-	 * a new param is added to the enum without adding support here.
-	 */
+	max = f->mask >> f->shift;
+	if (value > max) {
+		switch (f->over) {
+		case VB2_NV_OVER_CLIP:
+			value = max;
+			break;
+		case VB2_NV_OVER_TRUNCATE:
+			value &= max;
+			break;
+		case VB2_NV_OVER_INVALID:
+			value = f->invalid;
+			break;
+		}
+	}
+
+	p = ctx->nvdata + f->offs;
+	*p = (*p & ~f->mask) | ((value << f->shift) & f->mask);
 
 	/* Need to regenerate CRC, since the value changed. */
 	vb2_nv_regen_crc(ctx);
 }
-
-#undef SETBIT
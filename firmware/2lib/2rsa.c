@@ -10,9 +10,12 @@
  */
 
 #include "2common.h"
+#include "2ecdsa.h"
 #include "2rsa.h"
+#include "2rsa_private.h"
 #include "2sha.h"
 #include "2sysincludes.h"
+#include "2trace.h"
 #include "vboot_test.h"
 
 /**
@@ -47,18 +50,23 @@ int vb2_mont_ge(const struct vb2_public_key *key, uint32_t *a)
 
 /**
  * Montgomery c[] += a * b[] / R % mod
+ *
+ * len is key->arrsize; passing it separately lets callers with a constant
+ * size get a copy of the loop specialized for it.
  */
-static void montMulAdd(const struct vb2_public_key *key,
-		       uint32_t *c,
-		       const uint32_t a,
-		       const uint32_t *b)
+static inline __attribute__((always_inline))
+void montMulAdd(const struct vb2_public_key *key,
+		uint32_t *c,
+		const uint32_t a,
+		const uint32_t *b,
+		const uint32_t len)
 {
 	uint64_t A = (uint64_t)a * b[0] + c[0];
 	uint32_t d0 = (uint32_t)A * key->n0inv;
 	uint64_t B = (uint64_t)d0 * key->n[0] + (uint32_t)A;
 	uint32_t i;
 
-	for (i = 1; i < key->arrsize; ++i) {
+	for (i = 1; i < len; ++i) {
 		A = (A >> 32) + (uint64_t)a * b[i] + c[i];
 		B = (B >> 32) + (uint64_t)d0 * key->n[i] + (uint32_t)A;
 		c[i - 1] = (uint32_t)B;
@@ -95,18 +103,76 @@ static void montMulAdd0(const struct vb2_public_key *key,
 /**
  * Montgomery c[] = a[] * b[] / R % mod
  */
+static inline __attribute__((always_inline))
+void montMulLen(const struct vb2_public_key *key,
+		uint32_t *c,
+		const uint32_t *a,
+		const uint32_t *b,
+		const uint32_t len)
+{
+	uint32_t i;
+	VB2_TRACE_BEGIN(MONTMUL);
+	for (i = 0; i < len; ++i) {
+		c[i] = 0;
+	}
+	for (i = 0; i < len; ++i) {
+		montMulAdd(key, c, a[i], b, len);
+	}
+	VB2_TRACE_END(MONTMUL);
+}
+
+typedef void (*vb2_mont_mul_fn)(const struct vb2_public_key *key,
+				uint32_t *c,
+				const uint32_t *a,
+				const uint32_t *b);
+
 static void montMul(const struct vb2_public_key *key,
 		    uint32_t *c,
 		    const uint32_t *a,
 		    const uint32_t *b)
 {
-	uint32_t i;
-	for (i = 0; i < key->arrsize; ++i) {
-		c[i] = 0;
+	montMulLen(key, c, a, b, key->arrsize);
+}
+
+#ifdef UNROLL_LOOPS
+/*
+ * Copies of montMul() for each supported key size, so the compiler knows the
+ * trip counts and can unroll and schedule the inner loop for them.
+ */
+#define MONT_MUL_SIZED(bits)						\
+	static void montMul##bits(const struct vb2_public_key *key,	\
+				  uint32_t *c,				\
+				  const uint32_t *a,			\
+				  const uint32_t *b)			\
+	{								\
+		montMulLen(key, c, a, b, (bits) / 32);			\
 	}
-	for (i = 0; i < key->arrsize; ++i) {
-		montMulAdd(key, c, a[i], b);
+
+MONT_MUL_SIZED(1024)
+MONT_MUL_SIZED(2048)
+MONT_MUL_SIZED(3072)
+MONT_MUL_SIZED(4096)
+MONT_MUL_SIZED(8192)
+#endif
+
+/* Return the Montgomery multiply to use for the key */
+static vb2_mont_mul_fn montMulFor(const struct vb2_public_key *key)
+{
+#ifdef UNROLL_LOOPS
+	switch (key->arrsize * 32) {
+	case 1024:
+		return montMul1024;
+	case 2048:
+		return montMul2048;
+	case 3072:
+		return montMul3072;
+	case 4096:
+		return montMul4096;
+	case 8192:
+		return montMul8192;
 	}
+#endif
+	return montMul;
 }
 
 /* Montgomery c[] = a[] * 1 / R % key. */
@@ -119,11 +185,486 @@ static void montMul1(const struct vb2_public_key *key,
 	for (i = 0; i < key->arrsize; ++i)
 		c[i] = 0;
 
-	montMulAdd(key, c, 1, a);
+	montMulAdd(key, c, 1, a, key->arrsize);
 	for (i = 1; i < key->arrsize; ++i)
 		montMulAdd0(key, c, a);
 }
 
+/*
+ * PKCS 1.5 padding (from the RSA PKCS#1 v2.1 standard)
+ *
+ * Depending on the RSA key size and hash function, the padding is calculated
+ * as follows:
+ *
+ * 0x00 || 0x01 || PS || 0x00 || T
+ *
+ * T: DER Encoded DigestInfo value which depends on the hash function used.
+ *
+ * SHA-1:   (0x)30 21 30 09 06 05 2b 0e 03 02 1a 05 00 04 14 || H.
+ * SHA-256: (0x)30 31 30 0d 06 09 60 86 48 01 65 03 04 02 01 05 00 04 20 || H.
+ * SHA-512: (0x)30 51 30 0d 06 09 60 86 48 01 65 03 04 02 03 05 00 04 40 || H.
+ *
+ * Length(T) = 35 octets for SHA-1
+ * Length(T) = 51 octets for SHA-256
+ * Length(T) = 83 octets for SHA-512
+ *
+ * PS: octet string consisting of {Length(RSA Key) - Length(T) - 3} 0xFF
+ */
+#if VB2_SUPPORT_SHA1
+static const uint8_t sha1_tail[] = {
+	0x00,0x30,0x21,0x30,0x09,0x06,0x05,0x2b,
+	0x0e,0x03,0x02,0x1a,0x05,0x00,0x04,0x14
+};
+#endif
+
+#if VB2_SUPPORT_SHA256
+static const uint8_t sha256_tail[] = {
+	0x00,0x30,0x31,0x30,0x0d,0x06,0x09,0x60,
+	0x86,0x48,0x01,0x65,0x03,0x04,0x02,0x01,
+	0x05,0x00,0x04,0x20
+};
+#endif
+
+#if VB2_SUPPORT_SHA512
+static const uint8_t sha512_tail[] = {
+	0x00,0x30,0x51,0x30,0x0d,0x06,0x09,0x60,
+	0x86,0x48,0x01,0x65,0x03,0x04,0x02,0x03,
+	0x05,0x00,0x04,0x40
+};
+#endif
+
+/*
+ * Running check of a decoded signature block against its expected padding
+ * and digest, fed one byte at a time as the block is converted out of
+ * Montgomery form.  Which byte is expected depends only on its position,
+ * never on the data, so the check takes the same time however many bytes
+ * match.
+ */
+struct pad_check {
+	uint32_t pos;		/* Index of the next byte */
+	uint32_t ff_end;	/* 0xff bytes run from 2 to here */
+	uint32_t tail_end;	/* Then the tail, then the digest */
+	const uint8_t *tail;
+	const uint8_t *digest;	/* NULL to check the padding only */
+	uint32_t pad_diff;	/* Non-zero if padding or tail mismatched */
+	uint32_t digest_diff;	/* Non-zero if digest mismatched */
+};
+
+/**
+ * Set up a padding check for a key's signature and hash algorithms.
+ *
+ * @param pc		Check to initialize
+ * @param key		Key to take signature and hash algorithms from
+ * @param digest	Expected digest, or NULL to skip it
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+static vb2_error_t pad_check_init(struct pad_check *pc,
+				  const struct vb2_public_key *key,
+				  const uint8_t *digest)
+{
+	uint32_t sig_size = vb2_rsa_sig_size(key->sig_alg);
+	uint32_t hash_size = vb2_digest_size(key->hash_alg);
+	uint32_t tail_size;
+
+	if (!sig_size || !hash_size || hash_size > sig_size)
+		return VB2_ERROR_RSA_PADDING_SIZE;
+
+	switch (key->hash_alg) {
+#if VB2_SUPPORT_SHA1
+	case VB2_HASH_SHA1:
+		pc->tail = sha1_tail;
+		tail_size = sizeof(sha1_tail);
+		break;
+#endif
+#if VB2_SUPPORT_SHA256
+	case VB2_HASH_SHA256:
+		pc->tail = sha256_tail;
+		tail_size = sizeof(sha256_tail);
+		break;
+#endif
+#if VB2_SUPPORT_SHA512
+	case VB2_HASH_SHA512:
+		pc->tail = sha512_tail;
+		tail_size = sizeof(sha512_tail);
+		break;
+#endif
+	default:
+		return VB2_ERROR_RSA_PADDING_ALGORITHM;
+	}
+
+	pc->pos = 0;
+	pc->tail_end = sig_size - hash_size;
+	pc->ff_end = pc->tail_end - tail_size;
+	pc->digest = digest;
+	pc->pad_diff = 0;
+	pc->digest_diff = 0;
+	return VB2_SUCCESS;
+}
+
+static inline __attribute__((always_inline))
+void pad_check_byte(struct pad_check *pc, uint8_t b)
+{
+	uint32_t i = pc->pos++;
+
+	/* First 2 bytes are always 0x00 0x01, then 0xff bytes until the tail */
+	if (i < 2)
+		pc->pad_diff |= b ^ i;
+	else if (i < pc->ff_end)
+		pc->pad_diff |= b ^ 0xff;
+	else if (i < pc->tail_end)
+		pc->pad_diff |= b ^ pc->tail[i - pc->ff_end];
+	else if (pc->digest)
+		pc->digest_diff |= b ^ pc->digest[i - pc->tail_end];
+}
+
+/**
+ * Return the result of a padding check once every byte has been fed in.
+ */
+static vb2_error_t pad_check_result(const struct pad_check *pc)
+{
+	if (pc->pad_diff)
+		return VB2_ERROR_RSA_PADDING;
+	if (pc->digest_diff) {
+		VB2_DEBUG("Digest check failed!\n");
+		return VB2_ERROR_RSA_VERIFY_DIGEST;
+	}
+	return VB2_SUCCESS;
+}
+
+/**
+ * Compute R^2 mod n for a key packed without its rr[] array.
+ *
+ * Starts from R mod n, doubles it up to the odd part of the key size, then
+ * Montgomery squares it; each squaring doubles the exponent of 2, so this
+ * costs about log2(bits) multiplies rather than 2 * bits shifts.
+ *
+ * @param key		Key to use; only arrsize, n0inv and n are read
+ * @param rr		Destination, key->arrsize elements
+ * @param tmp		Scratch, key->arrsize elements
+ * @return VB2_SUCCESS, or non-zero if the modulus doesn't fill its top word.
+ */
+static vb2_error_t derive_rr(const struct vb2_public_key *key,
+			     uint32_t *rr, uint32_t *tmp)
+{
+	uint32_t len = key->arrsize;
+	uint32_t k = len * 32;
+	uint32_t squares = 0;
+	uint32_t *a = rr, *b = tmp, *t;
+	int64_t A = 0;
+	uint32_t i;
+
+	/* R - n is only R mod n if n > R / 2 */
+	if (!(key->n[len - 1] >> 31))
+		return VB2_ERROR_RSA_VERIFY_KEY;
+
+	/* Split the key size into k * 2^squares, with k odd */
+	while (!(k & 1)) {
+		k >>= 1;
+		squares++;
+	}
+
+	/* a = R - n = 1 * R mod n */
+	for (i = 0; i < len; i++) {
+		A -= key->n[i];
+		a[i] = (uint32_t)A;
+		A >>= 32;
+	}
+
+	/* a = 2^k * R mod n */
+	while (k--) {
+		uint32_t carry = a[len - 1] >> 31;
+
+		for (i = len - 1; i > 0; i--)
+			a[i] = (a[i] << 1) | (a[i - 1] >> 31);
+		a[0] <<= 1;
+		if (carry || vb2_mont_ge(key, a))
+			subM(key, a);
+	}
+
+	/* a = 2^(k * 2^squares) * R = R * R mod n */
+	for (i = 0; i < squares; i++) {
+		montMul(key, b, a, a);
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	if (vb2_mont_ge(key, a))
+		subM(key, a);
+	if (a != rr)
+		memcpy(rr, a, len * sizeof(uint32_t));
+
+	return VB2_SUCCESS;
+}
+
+#ifdef __SIZEOF_INT128__
+/*
+ * 64-bit targets have a 64x64->128 bit multiply (mul/umulh, or mul/mulq), so
+ * the Montgomery multiplication there works on 64-bit limbs.  Half as many
+ * limbs means a quarter as many inner loop iterations.  The key still stores
+ * n[] and rr[] as 32-bit words, so those are combined as they are read.
+ */
+#define VB2_RSA_LIMB64
+
+typedef unsigned __int128 vb2_uint128_t;
+
+/* Key material in 64-bit limb form */
+struct vb2_mont64 {
+	const uint32_t *n;	/* Modulus as little endian 32-bit words */
+	uint32_t len;		/* Length of n[] in 64-bit limbs */
+	uint64_t n0inv;		/* -1 / n[0] mod 2^64 */
+};
+
+static inline uint64_t limb64(const uint32_t *a, uint32_t i)
+{
+	return a[2 * i] | (uint64_t)a[2 * i + 1] << 32;
+}
+
+/**
+ * a[] -= mod
+ */
+static void subM64(const struct vb2_mont64 *m, uint64_t *a)
+{
+	uint64_t borrow = 0;
+	uint64_t n, t;
+	uint32_t i;
+
+	for (i = 0; i < m->len; ++i) {
+		n = limb64(m->n, i);
+		t = a[i] - n - borrow;
+		borrow = (a[i] < n) | ((a[i] == n) & borrow);
+		a[i] = t;
+	}
+}
+
+/**
+ * Return a[] >= mod
+ */
+static int mont_ge64(const struct vb2_mont64 *m, const uint64_t *a)
+{
+	uint64_t n;
+	uint32_t i;
+
+	for (i = m->len; i;) {
+		--i;
+		n = limb64(m->n, i);
+		if (a[i] < n)
+			return 0;
+		if (a[i] > n)
+			return 1;
+	}
+	return 1;  /* equal */
+}
+
+/**
+ * Montgomery c[] += a * b[] / R % mod
+ */
+static inline __attribute__((always_inline))
+void montMulAdd64(const struct vb2_mont64 *m,
+		  uint64_t *c,
+		  const uint64_t a,
+		  const uint64_t *b,
+		  const uint32_t len)
+{
+	vb2_uint128_t A = (vb2_uint128_t)a * b[0] + c[0];
+	uint64_t d0 = (uint64_t)A * m->n0inv;
+	vb2_uint128_t B = (vb2_uint128_t)d0 * limb64(m->n, 0) + (uint64_t)A;
+	uint32_t i;
+
+	for (i = 1; i < len; ++i) {
+		A = (A >> 64) + (vb2_uint128_t)a * b[i] + c[i];
+		B = (B >> 64) + (vb2_uint128_t)d0 * limb64(m->n, i) +
+			(uint64_t)A;
+		c[i - 1] = (uint64_t)B;
+	}
+
+	A = (A >> 64) + (B >> 64);
+
+	c[i - 1] = (uint64_t)A;
+
+	if (A >> 64)
+		subM64(m, c);
+}
+
+/**
+ * Montgomery c[] += 0 * b[] / R % mod
+ */
+static void montMulAdd064(const struct vb2_mont64 *m, uint64_t *c)
+{
+	uint64_t d0 = c[0] * m->n0inv;
+	vb2_uint128_t B = (vb2_uint128_t)d0 * limb64(m->n, 0) + c[0];
+	uint32_t i;
+
+	for (i = 1; i < m->len; ++i) {
+		B = (B >> 64) + (vb2_uint128_t)d0 * limb64(m->n, i) + c[i];
+		c[i - 1] = (uint64_t)B;
+	}
+
+	c[i - 1] = (uint64_t)(B >> 64);
+}
+
+/**
+ * Montgomery c[] = a[] * b[] / R % mod
+ */
+static inline __attribute__((always_inline))
+void montMul64Len(const struct vb2_mont64 *m,
+		  uint64_t *c,
+		  const uint64_t *a,
+		  const uint64_t *b,
+		  const uint32_t len)
+{
+	uint32_t i;
+	VB2_TRACE_BEGIN(MONTMUL);
+
+	for (i = 0; i < len; ++i)
+		c[i] = 0;
+	for (i = 0; i < len; ++i)
+		montMulAdd64(m, c, a[i], b, len);
+	VB2_TRACE_END(MONTMUL);
+}
+
+typedef void (*vb2_mont_mul64_fn)(const struct vb2_mont64 *m,
+				  uint64_t *c,
+				  const uint64_t *a,
+				  const uint64_t *b);
+
+static void montMul64(const struct vb2_mont64 *m,
+		      uint64_t *c,
+		      const uint64_t *a,
+		      const uint64_t *b)
+{
+	montMul64Len(m, c, a, b, m->len);
+}
+
+#ifdef UNROLL_LOOPS
+/* Size-specialized copies of montMul64(), as for montMul() */
+#define MONT_MUL64_SIZED(bits)						\
+	static void montMul64_##bits(const struct vb2_mont64 *m,	\
+				     uint64_t *c,			\
+				     const uint64_t *a,			\
+				     const uint64_t *b)			\
+	{								\
+		montMul64Len(m, c, a, b, (bits) / 64);			\
+	}
+
+MONT_MUL64_SIZED(1024)
+MONT_MUL64_SIZED(2048)
+MONT_MUL64_SIZED(3072)
+MONT_MUL64_SIZED(4096)
+MONT_MUL64_SIZED(8192)
+#endif
+
+/* Return the Montgomery multiply to use for the key */
+static vb2_mont_mul64_fn montMul64For(const struct vb2_mont64 *m)
+{
+#ifdef UNROLL_LOOPS
+	switch (m->len * 64) {
+	case 1024:
+		return montMul64_1024;
+	case 2048:
+		return montMul64_2048;
+	case 3072:
+		return montMul64_3072;
+	case 4096:
+		return montMul64_4096;
+	case 8192:
+		return montMul64_8192;
+	}
+#endif
+	return montMul64;
+}
+
+/* Montgomery c[] = a[] * 1 / R % key. */
+static void montMul164(const struct vb2_mont64 *m,
+		       uint64_t *c,
+		       const uint64_t *a)
+{
+	uint32_t i;
+
+	for (i = 0; i < m->len; ++i)
+		c[i] = 0;
+
+	montMulAdd64(m, c, 1, a, m->len);
+	for (i = 1; i < m->len; ++i)
+		montMulAdd064(m, c);
+}
+
+/**
+ * In-place public exponentiation on 64-bit limbs.
+ *
+ * Same as modpow(), which see.  key->arrsize must be even.
+ */
+static void modpow64(const struct vb2_public_key *key, uint8_t *inout,
+		     uint32_t *workbuf32, int exp, struct pad_check *pc)
+{
+	struct vb2_mont64 m;
+	vb2_mont_mul64_fn mul;
+	uint64_t *a = (uint64_t *)workbuf32;
+	uint64_t *aR, *aaR, *aaa;
+	uint64_t inv;
+	uint32_t i, j;
+
+	m.n = key->n;
+	m.len = key->arrsize / 2;
+	aR = a + m.len;
+	aaR = aR + m.len;
+	aaa = aaR;  /* Re-use location. */
+
+	/*
+	 * key->n0inv is -1 / n mod 2^32.  One Newton step doubles the number
+	 * of correct low bits of 1 / n, which gets us to 64.
+	 */
+	inv = (uint32_t)-key->n0inv;
+	inv *= 2 - limb64(key->n, 0) * inv;
+	m.n0inv = -inv;
+	mul = montMul64For(&m);
+
+	/* Convert from big endian byte array to little endian limb array. */
+	for (i = 0; i < m.len; ++i) {
+		const uint8_t *p = inout + (m.len - 1 - i) * 8;
+		uint64_t tmp = 0;
+
+		for (j = 0; j < 8; j++)
+			tmp = (tmp << 8) | p[j];
+		a[i] = tmp;
+	}
+
+	/* aaR is free until the first square, so stage RR there. */
+	for (i = 0; i < m.len; ++i)
+		aaR[i] = limb64(key->rr, i);
+
+	mul(&m, aR, a, aaR);  /* aR = a * RR / R mod M   */
+	if (exp == 3) {
+		mul(&m, aaR, aR, aR); /* aaR = aR * aR / R mod M */
+		mul(&m, a, aaR, aR); /* a = aaR * aR / R mod M */
+		montMul164(&m, aaa, a); /* aaa = a * 1 / R mod M */
+	} else {
+		/* Exponent 65537 */
+		for (i = 0; i < 16; i += 2) {
+			mul(&m, aaR, aR, aR);  /* aaR = aR * aR / R */
+			mul(&m, aR, aaR, aaR);  /* aR = aaR * aaR / R */
+		}
+		mul(&m, aaa, aR, a);  /* aaa = aR * a / R mod M */
+	}
+
+	/* Make sure aaa < mod; aaa is at most 1x mod too large. */
+	if (mont_ge64(&m, aaa))
+		subM64(&m, aaa);
+
+	/* Convert to bigendian byte array, checking it on the way */
+	for (i = m.len; i > 0; --i) {
+		uint64_t tmp = aaa[i - 1];
+
+		for (j = 0; j < 8; j++) {
+			uint8_t b = (uint8_t)(tmp >> (56 - 8 * j));
+
+			*inout++ = b;
+			pad_check_byte(pc, b);
+		}
+	}
+}
+#endif  /* __SIZEOF_INT128__ */
+
 /**
  * In-place public exponentiation.
  *
@@ -132,16 +673,25 @@ static void montMul1(const struct vb2_public_key *key,
  * @param workbuf32	Work buffer; caller must verify this is
  *			(3 * key->arrsize) elements long.
  * @param exp		RSA public exponent: either 65537 (F4) or 3
+ * @param pc		Padding check fed each output byte as it's written
  */
 static void modpow(const struct vb2_public_key *key, uint8_t *inout,
-		uint32_t *workbuf32, int exp)
+		uint32_t *workbuf32, int exp, struct pad_check *pc)
 {
 	uint32_t *a = workbuf32;
 	uint32_t *aR = a + key->arrsize;
 	uint32_t *aaR = aR + key->arrsize;
 	uint32_t *aaa = aaR;  /* Re-use location. */
+	vb2_mont_mul_fn mul = montMulFor(key);
 	int i;
 
+#ifdef VB2_RSA_LIMB64
+	if (!(key->arrsize & 1)) {
+		modpow64(key, inout, workbuf32, exp, pc);
+		return;
+	}
+#endif
+
 	/* Convert from big endian byte array to little endian word array. */
 	for (i = 0; i < (int)key->arrsize; ++i) {
 		uint32_t tmp =
@@ -153,18 +703,18 @@ static void modpow(const struct vb2_public_key *key, uint8_t *inout,
 		a[i] = tmp;
 	}
 
-	montMul(key, aR, a, key->rr);  /* aR = a * RR / R mod M   */
+	mul(key, aR, a, key->rr);  /* aR = a * RR / R mod M   */
 	if (exp == 3) {
-		montMul(key, aaR, aR, aR); /* aaR = aR * aR / R mod M */
-		montMul(key, a, aaR, aR); /* a = aaR * aR / R mod M */
+		mul(key, aaR, aR, aR); /* aaR = aR * aR / R mod M */
+		mul(key, a, aaR, aR); /* a = aaR * aR / R mod M */
 		montMul1(key, aaa, a); /* aaa = a * 1 / R mod M */
 	} else {
 		/* Exponent 65537 */
 		for (i = 0; i < 16; i+=2) {
-			montMul(key, aaR, aR, aR);  /* aaR = aR * aR / R mod M */
-			montMul(key, aR, aaR, aaR);  /* aR = aaR * aaR / R mod M */
+			mul(key, aaR, aR, aR);  /* aaR = aR * aR / R mod M */
+			mul(key, aR, aaR, aaR);  /* aR = aaR * aaR / R mod M */
 		}
-		montMul(key, aaa, aR, a);  /* aaa = aR * a / R mod M */
+		mul(key, aaa, aR, a);  /* aaa = aR * a / R mod M */
 	}
 
 	/* Make sure aaa < mod; aaa is at most 1x mod too large. */
@@ -172,36 +722,73 @@ static void modpow(const struct vb2_public_key *key, uint8_t *inout,
 		subM(key, aaa);
 	}
 
-	/* Convert to bigendian byte array */
+	/* Convert to bigendian byte array, checking it on the way */
 	for (i = (int)key->arrsize - 1; i >= 0; --i) {
 		uint32_t tmp = aaa[i];
-		*inout++ = (uint8_t)(tmp >> 24);
-		*inout++ = (uint8_t)(tmp >> 16);
-		*inout++ = (uint8_t)(tmp >>  8);
-		*inout++ = (uint8_t)(tmp >>  0);
+		int j;
+
+		for (j = 24; j >= 0; j -= 8) {
+			*inout = (uint8_t)(tmp >> j);
+			pad_check_byte(pc, *inout++);
+		}
 	}
 }
 
+#if VB2_SUPPORT_RSA1024
+#define CTS_RSA1024 VB2_SIG_RSA1024
+#else
+#define CTS_RSA1024 VB2_SIG_INVALID
+#endif
+
+#if VB2_SUPPORT_RSA2048
+#define CTS_RSA2048 VB2_SIG_RSA2048
+#else
+#define CTS_RSA2048 VB2_SIG_INVALID
+#endif
+
+#if VB2_SUPPORT_RSA4096
+#define CTS_RSA4096 VB2_SIG_RSA4096
+#else
+#define CTS_RSA4096 VB2_SIG_INVALID
+#endif
+
+#if VB2_SUPPORT_RSA8192
+#define CTS_RSA8192 VB2_SIG_RSA8192
+#else
+#define CTS_RSA8192 VB2_SIG_INVALID
+#endif
+
+#if VB2_SUPPORT_RSA2048_EXP3
+#define CTS_RSA2048_EXP3 VB2_SIG_RSA2048_EXP3
+#else
+#define CTS_RSA2048_EXP3 VB2_SIG_INVALID
+#endif
+
+#if VB2_SUPPORT_RSA3072_EXP3
+#define CTS_RSA3072_EXP3 VB2_SIG_RSA3072_EXP3
+#else
+#define CTS_RSA3072_EXP3 VB2_SIG_INVALID
+#endif
 
 static const uint8_t crypto_to_sig[] = {
-	VB2_SIG_RSA1024,
-	VB2_SIG_RSA1024,
-	VB2_SIG_RSA1024,
-	VB2_SIG_RSA2048,
-	VB2_SIG_RSA2048,
-	VB2_SIG_RSA2048,
-	VB2_SIG_RSA4096,
-	VB2_SIG_RSA4096,
-	VB2_SIG_RSA4096,
-	VB2_SIG_RSA8192,
-	VB2_SIG_RSA8192,
-	VB2_SIG_RSA8192,
-	VB2_SIG_RSA2048_EXP3,
-	VB2_SIG_RSA2048_EXP3,
-	VB2_SIG_RSA2048_EXP3,
-	VB2_SIG_RSA3072_EXP3,
-	VB2_SIG_RSA3072_EXP3,
-	VB2_SIG_RSA3072_EXP3,
+	CTS_RSA1024,
+	CTS_RSA1024,
+	CTS_RSA1024,
+	CTS_RSA2048,
+	CTS_RSA2048,
+	CTS_RSA2048,
+	CTS_RSA4096,
+	CTS_RSA4096,
+	CTS_RSA4096,
+	CTS_RSA8192,
+	CTS_RSA8192,
+	CTS_RSA8192,
+	CTS_RSA2048_EXP3,
+	CTS_RSA2048_EXP3,
+	CTS_RSA2048_EXP3,
+	CTS_RSA3072_EXP3,
+	CTS_RSA3072_EXP3,
+	CTS_RSA3072_EXP3,
 };
 
 /**
@@ -224,17 +811,30 @@ enum vb2_signature_algorithm vb2_crypto_to_signature(uint32_t algorithm)
 uint32_t vb2_rsa_sig_size(enum vb2_signature_algorithm sig_alg)
 {
 	switch (sig_alg) {
+#if VB2_SUPPORT_RSA1024
 	case VB2_SIG_RSA1024:
 		return 1024 / 8;
+#endif
+#if VB2_SUPPORT_RSA2048
 	case VB2_SIG_RSA2048:
+		return 2048 / 8;
+#endif
+#if VB2_SUPPORT_RSA2048_EXP3
 	case VB2_SIG_RSA2048_EXP3:
 		return 2048 / 8;
+#endif
+#if VB2_SUPPORT_RSA3072_EXP3
 	case VB2_SIG_RSA3072_EXP3:
 		return 3072 / 8;
+#endif
+#if VB2_SUPPORT_RSA4096
 	case VB2_SIG_RSA4096:
 		return 4096 / 8;
+#endif
+#if VB2_SUPPORT_RSA8192
 	case VB2_SIG_RSA8192:
 		return 8192 / 8;
+#endif
 	default:
 		return 0;
 	}
@@ -266,6 +866,10 @@ uint32_t vb2_packed_key_size(enum vb2_signature_algorithm sig_alg)
 {
 	uint32_t sig_size = vb2_rsa_sig_size(sig_alg);
 
+	/* ECDSA keys pack the X and Y coordinates in place of n and rr */
+	if (VB2_SUPPORT_ECDSA_P256 && sig_alg == VB2_SIG_ECDSA_P256)
+		sig_size = VB2_P256_BYTES;
+
 	if (!sig_size)
 		return 0;
 
@@ -277,42 +881,16 @@ uint32_t vb2_packed_key_size(enum vb2_signature_algorithm sig_alg)
 	return 2 * sig_size + 2 * sizeof(uint32_t);
 }
 
-/*
- * PKCS 1.5 padding (from the RSA PKCS#1 v2.1 standard)
- *
- * Depending on the RSA key size and hash function, the padding is calculated
- * as follows:
- *
- * 0x00 || 0x01 || PS || 0x00 || T
- *
- * T: DER Encoded DigestInfo value which depends on the hash function used.
- *
- * SHA-1:   (0x)30 21 30 09 06 05 2b 0e 03 02 1a 05 00 04 14 || H.
- * SHA-256: (0x)30 31 30 0d 06 09 60 86 48 01 65 03 04 02 01 05 00 04 20 || H.
- * SHA-512: (0x)30 51 30 0d 06 09 60 86 48 01 65 03 04 02 03 05 00 04 40 || H.
- *
- * Length(T) = 35 octets for SHA-1
- * Length(T) = 51 octets for SHA-256
- * Length(T) = 83 octets for SHA-512
- *
- * PS: octet string consisting of {Length(RSA Key) - Length(T) - 3} 0xFF
- */
-static const uint8_t sha1_tail[] = {
-	0x00,0x30,0x21,0x30,0x09,0x06,0x05,0x2b,
-	0x0e,0x03,0x02,0x1a,0x05,0x00,0x04,0x14
-};
+uint32_t vb2_packed_key_compact_size(enum vb2_signature_algorithm sig_alg)
+{
+	uint32_t sig_size = vb2_rsa_sig_size(sig_alg);
 
-static const uint8_t sha256_tail[] = {
-	0x00,0x30,0x31,0x30,0x0d,0x06,0x09,0x60,
-	0x86,0x48,0x01,0x65,0x03,0x04,0x02,0x01,
-	0x05,0x00,0x04,0x20
-};
+	if (!sig_size)
+		return 0;
 
-static const uint8_t sha512_tail[] = {
-	0x00,0x30,0x51,0x30,0x0d,0x06,0x09,0x60,
-	0x86,0x48,0x01,0x65,0x03,0x04,0x02,0x03,
-	0x05,0x00,0x04,0x40
-};
+	/* Same as vb2_packed_key_size(), without the rr array */
+	return sig_size + 2 * sizeof(uint32_t);
+}
 
 /**
  * Check pkcs 1.5 padding bytes
@@ -324,61 +902,28 @@ static const uint8_t sha512_tail[] = {
 vb2_error_t vb2_check_padding(const uint8_t *sig,
 			      const struct vb2_public_key *key)
 {
-	/* Determine padding to use depending on the signature type */
-	uint32_t sig_size = vb2_rsa_sig_size(key->sig_alg);
-	uint32_t hash_size = vb2_digest_size(key->hash_alg);
-	uint32_t pad_size = sig_size - hash_size;
-	const uint8_t *tail;
-	uint32_t tail_size;
-	int result = 0;
-	int i;
-
-	if (!sig_size || !hash_size || hash_size > sig_size)
-		return VB2_ERROR_RSA_PADDING_SIZE;
-
-	switch (key->hash_alg) {
-	case VB2_HASH_SHA1:
-		tail = sha1_tail;
-		tail_size = sizeof(sha1_tail);
-		break;
-	case VB2_HASH_SHA256:
-		tail = sha256_tail;
-		tail_size = sizeof(sha256_tail);
-		break;
-	case VB2_HASH_SHA512:
-		tail = sha512_tail;
-		tail_size = sizeof(sha512_tail);
-		break;
-	default:
-		return VB2_ERROR_RSA_PADDING_ALGORITHM;
-	}
-
-	/* First 2 bytes are always 0x00 0x01 */
-	result |= *sig++ ^ 0x00;
-	result |= *sig++ ^ 0x01;
+	struct pad_check pc;
+	uint32_t i;
+	vb2_error_t rv;
 
-	/* Then 0xff bytes until the tail */
-	for (i = 0; i < pad_size - tail_size - 2; i++)
-		result |= *sig++ ^ 0xff;
+	rv = pad_check_init(&pc, key, NULL);
+	if (rv)
+		return rv;
 
-	/*
-	 * Then the tail.  Even though there are probably no timing issues
-	 * here, we use vb2_safe_memcmp() just to be on the safe side.
-	 */
-	result |= vb2_safe_memcmp(sig, tail, tail_size);
+	for (i = 0; i < pc.tail_end; i++)
+		pad_check_byte(&pc, sig[i]);
 
-	return result ? VB2_ERROR_RSA_PADDING : VB2_SUCCESS;
+	return pad_check_result(&pc);
 }
 
-vb2_error_t vb2_rsa_verify_digest(const struct vb2_public_key *key,
-				  uint8_t *sig, const uint8_t *digest,
-				  const struct vb2_workbuf *wb)
+vb2_error_t vb2_rsa_verify_digest_scratch(const struct vb2_public_key *key,
+					  uint8_t *sig, const uint8_t *digest,
+					  void *scratch, uint32_t scratch_size)
 {
-	struct vb2_workbuf wblocal = *wb;
-	uint32_t *workbuf32;
+	struct vb2_public_key full_key;
+	struct pad_check pc;
 	uint32_t key_bytes;
 	int sig_size;
-	int pad_size;
 	int exp;
 	vb2_error_t rv;
 
@@ -399,36 +944,80 @@ vb2_error_t vb2_rsa_verify_digest(const struct vb2_public_key *key,
 		return VB2_ERROR_RSA_VERIFY_SIG_LEN;
 	}
 
-	workbuf32 = vb2_workbuf_alloc(&wblocal, 3 * key_bytes);
-	if (!workbuf32) {
-		VB2_DEBUG("ERROR - vboot2 work buffer too small!\n");
+	/* The exponentiation works on 64-bit words where it can */
+	if (!scratch || !vb2_aligned(scratch, VB2_WORKBUF_ALIGN)) {
+		VB2_DEBUG("ERROR - RSA scratch buffer misaligned!\n");
 		return VB2_ERROR_RSA_VERIFY_WORKBUF;
 	}
 
-	modpow(key, sig, workbuf32, exp);
+	/*
+	 * Compact keys carry no rr[], so rebuild it at the front of the
+	 * scratch buffer and hand the rest to the exponentiation.
+	 */
+	if (!key->rr) {
+		uint32_t *rr = scratch;
+
+		if (scratch_size < VB2_RSA_VERIFY_COMPACT_SCRATCH_BYTES(
+				key_bytes)) {
+			VB2_DEBUG("ERROR - vboot2 work buffer too small!\n");
+			return VB2_ERROR_RSA_VERIFY_WORKBUF;
+		}
 
-	vb2_workbuf_free(&wblocal, 3 * key_bytes);
+		rv = derive_rr(key, rr, rr + key->arrsize);
+		if (rv)
+			return rv;
+
+		full_key = *key;
+		full_key.rr = rr;
+		key = &full_key;
+		scratch = rr + key->arrsize;
+		scratch_size -= key_bytes;
+	}
 
 	/*
-	 * Check padding.  Only fail immediately if the padding size is bad.
-	 * Otherwise, continue on to check the digest to reduce the risk of
-	 * timing based attacks.
+	 * The padding and digest are checked as the exponentiation writes out
+	 * its result.  Only fail early if the padding can't be checked at all;
+	 * otherwise every byte is compared, to reduce the risk of timing based
+	 * attacks.
 	 */
-	rv = vb2_check_padding(sig, key);
-	if (rv == VB2_ERROR_RSA_PADDING_SIZE)
+	rv = pad_check_init(&pc, key, digest);
+	if (rv)
 		return rv;
 
+#ifdef RSA_SIMD
 	/*
-	 * Check digest.  Even though there are probably no timing issues here,
-	 * use vb2_safe_memcmp() just to be on the safe side.  (That's also why
-	 * we don't return before this check if the padding check failed.)
+	 * The vector code needs a bigger scratch buffer; if there isn't room,
+	 * fall back to the scalar code.  It writes its result in one go, so
+	 * check that afterwards.
 	 */
-	pad_size = sig_size - vb2_digest_size(key->hash_alg);
-	if (vb2_safe_memcmp(sig + pad_size, digest, key_bytes - pad_size)) {
-		VB2_DEBUG("Digest check failed!\n");
-		if (!rv)
-			rv = VB2_ERROR_RSA_VERIFY_DIGEST;
+	if (scratch_size >= vb2_modpow_simd_workbuf_size(key)) {
+		uint32_t i;
+
+		vb2_modpow_simd(key, sig, scratch, exp);
+		for (i = 0; i < key_bytes; i++)
+			pad_check_byte(&pc, sig[i]);
+	} else
+#endif
+	{
+		if (scratch_size < VB2_RSA_VERIFY_SCRATCH_BYTES(key_bytes)) {
+			VB2_DEBUG("ERROR - vboot2 work buffer too small!\n");
+			return VB2_ERROR_RSA_VERIFY_WORKBUF;
+		}
+
+		modpow(key, sig, scratch, exp, &pc);
 	}
 
-	return rv;
+	return pad_check_result(&pc);
+}
+
+vb2_error_t vb2_rsa_verify_digest(const struct vb2_public_key *key,
+				  uint8_t *sig, const uint8_t *digest,
+				  const struct vb2_workbuf *wb)
+{
+	/*
+	 * Nothing allocated here outlives the call, so the free part of the
+	 * work buffer can be handed over whole.
+	 */
+	return vb2_rsa_verify_digest_scratch(key, sig, digest,
+					     wb->buf, wb->size);
 }
@@ -0,0 +1,281 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Modular exponentiation for RSA verification on general purpose vector
+ * units (AVX2 on x86, NEON on ARM).
+ *
+ * The scalar code in 2rsa.c needs a full carry chain through every limb,
+ * which doesn't vectorize.  Here numbers are held in radix 2^26, one limb per
+ * 32-bit word, and each row of a Montgomery multiplication adds a[i] * b[] and
+ * d * n[] into 64-bit accumulators without propagating carries.  The multiply
+ * and reduce steps share one pass over the operands, which also shifts the
+ * accumulator down a limb (the CIOS ordering), and carries are only resolved
+ * once per multiplication.  At most 2 * L products below 2^52 land in any
+ * accumulator, so this is exact up to RSA-16384.
+ *
+ * With R = 2^(26 * L) >= 4N, a product of two inputs below 2N is itself below
+ * 2N, so intermediate values are never fully reduced; a single conditional
+ * subtraction at the end is enough.
+ *
+ * As with the other SIMD code, firmware builds use -nostdinc, so this relies
+ * on GCC/clang generic vectors rather than the intrinsics headers.
+ */
+
+#include "2common.h"
+#include "2rsa.h"
+#include "2rsa_private.h"
+#include "2sysincludes.h"
+
+#define LIMB_BITS 26
+#define LIMB_MASK ((1U << LIMB_BITS) - 1)
+#define LANES 4
+
+typedef uint32_t vb2_u32x4_u __attribute__((vector_size(16), aligned(4),
+					    __may_alias__));
+typedef uint64_t vb2_u64x4 __attribute__((vector_size(32)));
+typedef uint64_t vb2_u64x4_u __attribute__((vector_size(32), aligned(8),
+					    __may_alias__));
+
+/* Key and scratch space for one exponentiation */
+struct vb2_mont26 {
+	uint32_t limbs;		/* L, the number of significant limbs */
+	uint32_t len;		/* L rounded up to a multiple of LANES */
+	uint32_t n0inv;		/* -1 / n[0] mod 2^26 */
+	uint32_t *n;		/* Modulus, len + 1 limbs */
+	uint64_t *c;		/* Accumulator, len + 1 words */
+};
+
+/* Number of limbs for a modulus of the given size, leaving R >= 4N */
+static uint32_t mont26_limbs(uint32_t bits)
+{
+	return (bits + 2 + LIMB_BITS - 1) / LIMB_BITS;
+}
+
+static uint32_t mont26_len(uint32_t limbs)
+{
+	return (limbs + LANES - 1) & ~(LANES - 1);
+}
+
+uint32_t vb2_modpow_simd_workbuf_size(const struct vb2_public_key *key)
+{
+	uint32_t words = mont26_len(mont26_limbs(key->arrsize * 32)) + 1;
+
+	/* n, a, aR and aaR in 32-bit limbs, plus the 64-bit accumulator */
+	return words * (4 * sizeof(uint32_t) + sizeof(uint64_t));
+}
+
+/* Multiply each lane of a by the low 32 bits of each lane of b */
+static inline vb2_u64x4 vmul32(vb2_u64x4 a, vb2_u64x4 b)
+{
+#if defined(__AVX2__)
+	__asm__("vpmuludq %2, %1, %0" : "=x"(a) : "x"(a), "x"(b));
+	return a;
+#else
+	return a * b;
+#endif
+}
+
+static inline vb2_u64x4 vload32(const uint32_t *p)
+{
+	return __builtin_convertvector(*(const vb2_u32x4_u *)p, vb2_u64x4);
+}
+
+/**
+ * Convert little endian words of the given width to len + 1 limbs.
+ */
+static void to_limbs(const struct vb2_mont26 *m, uint32_t *r,
+		     const uint32_t *a, uint32_t count)
+{
+	uint64_t acc = 0;
+	uint32_t bits = 0;
+	uint32_t i, k = 0;
+
+	for (i = 0; i < count; i++) {
+		acc |= (uint64_t)a[i] << bits;
+		for (bits += 32; bits >= LIMB_BITS; bits -= LIMB_BITS) {
+			r[k++] = acc & LIMB_MASK;
+			acc >>= LIMB_BITS;
+		}
+	}
+	while (k <= m->len) {
+		r[k++] = acc & LIMB_MASK;
+		acc >>= LIMB_BITS;
+	}
+}
+
+/**
+ * Return a[] >= mod
+ */
+static int mont26_ge(const struct vb2_mont26 *m, const uint32_t *a)
+{
+	uint32_t i;
+
+	for (i = m->len; i;) {
+		--i;
+		if (a[i] < m->n[i])
+			return 0;
+		if (a[i] > m->n[i])
+			return 1;
+	}
+	return 1;  /* equal */
+}
+
+/**
+ * a[] -= mod
+ */
+static void mont26_sub(const struct vb2_mont26 *m, uint32_t *a)
+{
+	int32_t borrow = 0;
+	uint32_t i;
+
+	for (i = 0; i < m->len; i++) {
+		borrow += (int32_t)a[i] - (int32_t)m->n[i];
+		a[i] = borrow & LIMB_MASK;
+		borrow >>= LIMB_BITS;
+	}
+}
+
+/**
+ * Almost-Montgomery r[] = a[] * b[] / R, with r < 2N if a, b < 2N.
+ *
+ * r may not alias a or b.
+ */
+static void mont26_mul(const struct vb2_mont26 *m, uint32_t *r,
+		       const uint32_t *a, const uint32_t *b)
+{
+	uint64_t *c = m->c;
+	const uint32_t *n = m->n;
+	vb2_u64x4 av, dv, cv;
+	uint64_t t0, carry;
+	uint32_t d, i, j;
+
+	for (j = 0; j <= m->len; j++)
+		c[j] = 0;
+
+	for (i = 0; i < m->limbs; i++) {
+		/* Pick d so the low limb cancels, then drop that limb */
+		t0 = c[0] + (uint64_t)a[i] * b[0];
+		d = ((uint32_t)t0 * m->n0inv) & LIMB_MASK;
+		t0 += (uint64_t)d * n[0];
+		carry = t0 >> LIMB_BITS;
+
+		av = (vb2_u64x4){a[i], a[i], a[i], a[i]};
+		dv = (vb2_u64x4){d, d, d, d};
+
+		/* c[len] and the operand padding stay zero */
+		for (j = 1; j < m->len; j += LANES) {
+			cv = *(const vb2_u64x4_u *)(c + j);
+			cv += vmul32(vload32(b + j), av);
+			cv += vmul32(vload32(n + j), dv);
+			*(vb2_u64x4_u *)(c + j - 1) = cv;
+		}
+
+		c[0] += carry;
+	}
+
+	/* The result is below 2N < R, so nothing carries out of the top */
+	carry = 0;
+	for (j = 0; j < m->len; j++) {
+		carry += c[j];
+		r[j] = carry & LIMB_MASK;
+		carry >>= LIMB_BITS;
+	}
+	r[m->len] = 0;
+}
+
+void vb2_modpow_simd(const struct vb2_public_key *key, uint8_t *inout,
+		     void *workbuf, int exp)
+{
+	const uint32_t sig_size = key->arrsize * sizeof(uint32_t);
+	struct vb2_mont26 m;
+	uint32_t *a, *aR, *aaR, *aaa;
+	uint64_t acc;
+	uint32_t words, bits, i, k;
+
+	m.limbs = mont26_limbs(key->arrsize * 32);
+	m.len = mont26_len(m.limbs);
+	m.n0inv = key->n0inv & LIMB_MASK;
+	words = m.len + 1;
+
+	m.c = workbuf;
+	m.n = (uint32_t *)(m.c + words);
+	a = m.n + words;
+	aR = a + words;
+	aaR = aR + words;
+	aaa = aaR;  /* Re-use location. */
+
+	to_limbs(&m, m.n, key->n, key->arrsize);
+
+	/* Convert from big endian byte array to limbs. */
+	acc = 0;
+	bits = 0;
+	k = 0;
+	for (i = sig_size; i > 0; i--) {
+		acc |= (uint64_t)inout[i - 1] << bits;
+		bits += 8;
+		if (bits >= LIMB_BITS) {
+			a[k++] = acc & LIMB_MASK;
+			acc >>= LIMB_BITS;
+			bits -= LIMB_BITS;
+		}
+	}
+	while (k < words) {
+		a[k++] = acc & LIMB_MASK;
+		acc >>= LIMB_BITS;
+	}
+
+	/*
+	 * key->rr is 2^(2 * keybits) mod N, but our R is 2^(26 * L).  Double
+	 * it the rest of the way; it stays below N, so never needs more than
+	 * one subtraction per step.
+	 */
+	to_limbs(&m, aaR, key->rr, key->arrsize);
+	for (i = 0; i < 2 * (LIMB_BITS * m.limbs - key->arrsize * 32); i++) {
+		uint32_t carry = 0;
+
+		for (k = 0; k < m.len; k++) {
+			carry += aaR[k] << 1;
+			aaR[k] = carry & LIMB_MASK;
+			carry >>= LIMB_BITS;
+		}
+		if (mont26_ge(&m, aaR))
+			mont26_sub(&m, aaR);
+	}
+
+	mont26_mul(&m, aR, a, aaR);  /* aR = a * RR / R mod M   */
+	if (exp == 3) {
+		mont26_mul(&m, aaR, aR, aR); /* aaR = aR * aR / R mod M */
+		mont26_mul(&m, a, aaR, aR); /* a = aaR * aR / R mod M */
+		/* aR is free now; use it to hold 1 */
+		for (k = 0; k < words; k++)
+			aR[k] = 0;
+		aR[0] = 1;
+		mont26_mul(&m, aaa, a, aR); /* aaa = a * 1 / R mod M */
+	} else {
+		/* Exponent 65537 */
+		for (i = 0; i < 16; i += 2) {
+			mont26_mul(&m, aaR, aR, aR);  /* aaR = aR * aR / R */
+			mont26_mul(&m, aR, aaR, aaR);  /* aR = aaR * aaR / R */
+		}
+		mont26_mul(&m, aaa, aR, a);  /* aaa = aR * a / R mod M */
+	}
+
+	/* Make sure aaa < mod; aaa is at most 1x mod too large. */
+	if (mont26_ge(&m, aaa))
+		mont26_sub(&m, aaa);
+
+	/* Convert to bigendian byte array */
+	acc = 0;
+	bits = 0;
+	k = 0;
+	for (i = sig_size; i > 0; i--) {
+		if (bits < 8) {
+			acc |= (uint64_t)aaa[k++] << bits;
+			bits += LIMB_BITS;
+		}
+		inout[i - 1] = (uint8_t)acc;
+		acc >>= 8;
+		bits -= 8;
+	}
+}
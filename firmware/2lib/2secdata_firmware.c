@@ -65,6 +65,13 @@ vb2_error_t vb2_secdata_firmware_init(struct vb2_context *ctx)
 	/* Set status flag */
 	sd->status |= VB2_SD_STATUS_SECDATA_FIRMWARE_INIT;
 
+	/* Remember what storage holds, unless it was just created */
+	if (!(ctx->flags & VB2_CONTEXT_SECDATA_FIRMWARE_CHANGED)) {
+		memcpy(sd->committed_secdata_firmware, ctx->secdata_firmware,
+		       sizeof(sd->committed_secdata_firmware));
+		sd->status |= VB2_SD_STATUS_SECDATA_FIRMWARE_SNAPSHOT;
+	}
+
 	/* Read this now to make sure crossystem has it even in rec mode */
 	sd->fw_version_secdata =
 		vb2_secdata_firmware_get(ctx, VB2_SECDATA_FIRMWARE_VERSIONS);
@@ -74,6 +74,13 @@ vb2_error_t vb2_secdata_kernel_init(struct vb2_context *ctx)
 	/* Set status flag */
 	sd->status |= VB2_SD_STATUS_SECDATA_KERNEL_INIT;
 
+	/* Remember what storage holds, unless it was just created */
+	if (!(ctx->flags & VB2_CONTEXT_SECDATA_KERNEL_CHANGED)) {
+		memcpy(sd->committed_secdata_kernel, ctx->secdata_kernel,
+		       sizeof(sd->committed_secdata_kernel));
+		sd->status |= VB2_SD_STATUS_SECDATA_KERNEL_SNAPSHOT;
+	}
+
 	return VB2_SUCCESS;
 }
 
@@ -37,7 +37,9 @@
 
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 #include "2sysincludes.h"
+#include "2trace.h"
 
 #define SHFR(x, n)    (x >> n)
 #define ROTR(x, n)   ((x >> n) | (x << ((sizeof(x) << 3) - n)))
@@ -77,7 +79,7 @@
 #define SHA256_EXP(a, b, c, d, e, f, g, h, j)				\
 	{								\
 		t1 = wv[h] + SHA256_F2(wv[e]) + CH(wv[e], wv[f], wv[g]) \
-			+ sha256_k[j] + w[j];				\
+			+ vb2_sha256_k[j] + w[j];			\
 		t2 = SHA256_F1(wv[a]) + MAJ(wv[a], wv[b], wv[c]);       \
 		wv[d] += t1;                                            \
 		wv[h] = t1 + t2;                                        \
@@ -88,7 +90,7 @@ static const uint32_t sha256_h0[8] = {
 	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
 };
 
-static const uint32_t sha256_k[64] = {
+const uint32_t vb2_sha256_k[64] = {
 	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
 	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
 	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
@@ -126,9 +128,9 @@ void vb2_sha256_init(struct vb2_sha256_context *ctx)
 	ctx->total_size = 0;
 }
 
-static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
-				 const uint8_t *message,
-				 unsigned int block_nb)
+#if !defined(X86_SHA_EXT) && !defined(ARMV8_CRYPTO_EXT)
+void vb2_sha256_transform_c(uint32_t *h, const uint8_t *message,
+			    unsigned int block_nb)
 {
 	/* Note that these arrays use 72*4=288 bytes of stack */
 	uint32_t w[64];
@@ -154,12 +156,12 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 		}
 
 		for (j = 0; j < 8; j++) {
-			wv[j] = ctx->h[j];
+			wv[j] = h[j];
 		}
 
 		for (j = 0; j < 64; j++) {
 			t1 = wv[7] + SHA256_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
-				+ sha256_k[j] + w[j];
+				+ vb2_sha256_k[j] + w[j];
 			t2 = SHA256_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
 			wv[7] = wv[6];
 			wv[6] = wv[5];
@@ -172,7 +174,7 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 		}
 
 		for (j = 0; j < 8; j++) {
-			ctx->h[j] += wv[j];
+			h[j] += wv[j];
 		}
 #else
 		PACK32(&sub_block[ 0], &w[ 0]); PACK32(&sub_block[ 4], &w[ 1]);
@@ -197,10 +199,10 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 		SHA256_SCR(56); SHA256_SCR(57); SHA256_SCR(58); SHA256_SCR(59);
 		SHA256_SCR(60); SHA256_SCR(61); SHA256_SCR(62); SHA256_SCR(63);
 
-		wv[0] = ctx->h[0]; wv[1] = ctx->h[1];
-		wv[2] = ctx->h[2]; wv[3] = ctx->h[3];
-		wv[4] = ctx->h[4]; wv[5] = ctx->h[5];
-		wv[6] = ctx->h[6]; wv[7] = ctx->h[7];
+		wv[0] = h[0]; wv[1] = h[1];
+		wv[2] = h[2]; wv[3] = h[3];
+		wv[4] = h[4]; wv[5] = h[5];
+		wv[6] = h[6]; wv[7] = h[7];
 
 		SHA256_EXP(0,1,2,3,4,5,6,7, 0); SHA256_EXP(7,0,1,2,3,4,5,6, 1);
 		SHA256_EXP(6,7,0,1,2,3,4,5, 2); SHA256_EXP(5,6,7,0,1,2,3,4, 3);
@@ -235,13 +237,79 @@ static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
 		SHA256_EXP(4,5,6,7,0,1,2,3,60); SHA256_EXP(3,4,5,6,7,0,1,2,61);
 		SHA256_EXP(2,3,4,5,6,7,0,1,62); SHA256_EXP(1,2,3,4,5,6,7,0,63);
 
-		ctx->h[0] += wv[0]; ctx->h[1] += wv[1];
-		ctx->h[2] += wv[2]; ctx->h[3] += wv[3];
-		ctx->h[4] += wv[4]; ctx->h[5] += wv[5];
-		ctx->h[6] += wv[6]; ctx->h[7] += wv[7];
+		h[0] += wv[0]; h[1] += wv[1];
+		h[2] += wv[2]; h[3] += wv[3];
+		h[4] += wv[4]; h[5] += wv[5];
+		h[6] += wv[6]; h[7] += wv[7];
 #endif /* !UNROLL_LOOPS */
 	}
 }
+#endif /* !X86_SHA_EXT && !ARMV8_CRYPTO_EXT */
+
+static void vb2_sha256_transform(struct vb2_sha256_context *ctx,
+				 const uint8_t *message,
+				 unsigned int block_nb)
+{
+	VB2_TRACE_BEGIN(SHA256_TRANSFORM);
+	VB2_SHA256_TRANSFORM(ctx->h, message, block_nb);
+	VB2_TRACE_END(SHA256_TRANSFORM);
+}
+
+/* Lane-parallel versions of the SHA-256 helpers, for generic vectors */
+#define VROTR(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+#define VSHA256_F1(x) (VROTR(x,  2) ^ VROTR(x, 13) ^ VROTR(x, 22))
+#define VSHA256_F2(x) (VROTR(x,  6) ^ VROTR(x, 11) ^ VROTR(x, 25))
+#define VSHA256_F3(x) (VROTR(x,  7) ^ VROTR(x, 18) ^ ((x) >>  3))
+#define VSHA256_F4(x) (VROTR(x, 17) ^ VROTR(x, 19) ^ ((x) >> 10))
+
+typedef uint32_t vb2_u32x4 __attribute__((vector_size(16)));
+
+void vb2_sha256_transform_x4(uint32_t *const h[VB2_SHA256_LANES],
+			     const uint8_t *const message[VB2_SHA256_LANES],
+			     unsigned int block_nb)
+{
+	/* 16-entry rolling message schedule; 24*16=384 bytes of stack */
+	vb2_u32x4 w[16];
+	vb2_u32x4 wv[8];
+	vb2_u32x4 t1, t2;
+	uint32_t word[VB2_SHA256_LANES];
+	unsigned int i, j, l;
+
+	for (i = 0; i < block_nb; i++) {
+		for (j = 0; j < 16; j++) {
+			for (l = 0; l < VB2_SHA256_LANES; l++)
+				PACK32(&message[l][(i << 6) + (j << 2)],
+				       &word[l]);
+			w[j] = (vb2_u32x4){word[0], word[1], word[2], word[3]};
+		}
+
+		for (j = 0; j < 8; j++)
+			wv[j] = (vb2_u32x4){h[0][j], h[1][j], h[2][j], h[3][j]};
+
+		for (j = 0; j < 64; j++) {
+			if (j >= 16)
+				w[j & 15] += VSHA256_F4(w[(j - 2) & 15])
+					+ w[(j - 7) & 15]
+					+ VSHA256_F3(w[(j - 15) & 15]);
+
+			t1 = wv[7] + VSHA256_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
+				+ vb2_sha256_k[j] + w[j & 15];
+			t2 = VSHA256_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
+			wv[7] = wv[6];
+			wv[6] = wv[5];
+			wv[5] = wv[4];
+			wv[4] = wv[3] + t1;
+			wv[3] = wv[2];
+			wv[2] = wv[1];
+			wv[1] = wv[0];
+			wv[0] = t1 + t2;
+		}
+
+		for (j = 0; j < 8; j++)
+			for (l = 0; l < VB2_SHA256_LANES; l++)
+				h[l][j] += wv[j][l];
+	}
+}
 
 void vb2_sha256_update(struct vb2_sha256_context *ctx,
 		       const uint8_t *data,
@@ -0,0 +1,112 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * SHA-256 block transform using the ARMv8 cryptography extensions.
+ *
+ * As with the x86 variant, firmware builds cannot include arm_neon.h, so the
+ * SHA256H/SHA256H2/SHA256SU0/SHA256SU1 instructions are wrapped in inline asm.
+ * Each SHA256H/SHA256H2 pair performs four rounds.  Only AArch64 is supported.
+ */
+
+#include "2sha.h"
+#include "2sha_private.h"
+#include "2sysincludes.h"
+
+#ifndef __aarch64__
+#error "ARMV8_CRYPTO_EXT is only supported on AArch64"
+#endif
+
+typedef uint32_t vb2_u32x4 __attribute__((vector_size(16)));
+typedef uint32_t vb2_u32x4_u __attribute__((vector_size(16), aligned(1),
+					    __may_alias__));
+
+static inline vb2_u32x4 vb2_loadu(const void *p)
+{
+	return *(const vb2_u32x4_u *)p;
+}
+
+static inline void vb2_storeu(void *p, vb2_u32x4 a)
+{
+	*(vb2_u32x4_u *)p = a;
+}
+
+static inline vb2_u32x4 vb2_rev32(vb2_u32x4 a)
+{
+	vb2_u32x4 r;
+	__asm__("rev32 %0.16b, %1.16b" : "=w"(r) : "w"(a));
+	return r;
+}
+
+static inline vb2_u32x4 vb2_sha256h(vb2_u32x4 abcd, vb2_u32x4 efgh,
+				    vb2_u32x4 wk)
+{
+	__asm__("sha256h %q0, %q1, %2.4s" : "+w"(abcd) : "w"(efgh), "w"(wk));
+	return abcd;
+}
+
+static inline vb2_u32x4 vb2_sha256h2(vb2_u32x4 efgh, vb2_u32x4 abcd,
+				     vb2_u32x4 wk)
+{
+	__asm__("sha256h2 %q0, %q1, %2.4s" : "+w"(efgh) : "w"(abcd), "w"(wk));
+	return efgh;
+}
+
+static inline vb2_u32x4 vb2_sha256su0(vb2_u32x4 w0, vb2_u32x4 w1)
+{
+	__asm__("sha256su0 %0.4s, %1.4s" : "+w"(w0) : "w"(w1));
+	return w0;
+}
+
+static inline vb2_u32x4 vb2_sha256su1(vb2_u32x4 w0, vb2_u32x4 w2,
+				      vb2_u32x4 w3)
+{
+	__asm__("sha256su1 %0.4s, %1.4s, %2.4s" : "+w"(w0) : "w"(w2), "w"(w3));
+	return w0;
+}
+
+void vb2_sha256_transform_ext(uint32_t *h, const uint8_t *message,
+			      unsigned int block_nb)
+{
+	vb2_u32x4 state0, state1, abcd_save, efgh_save;
+	vb2_u32x4 wk, tmp;
+	vb2_u32x4 w[4];
+	int i;
+
+	state0 = vb2_loadu(&h[0]);
+	state1 = vb2_loadu(&h[4]);
+
+	for (; block_nb > 0; block_nb--, message += VB2_SHA256_BLOCK_SIZE) {
+		abcd_save = state0;
+		efgh_save = state1;
+
+		for (i = 0; i < 4; i++)
+			w[i] = vb2_rev32(vb2_loadu(message + 16 * i));
+
+		/*
+		 * Sixteen groups of four rounds.  After consuming w[i & 3],
+		 * replace it with schedule vector i+4 for the first 12 groups.
+		 */
+		for (i = 0; i < 16; i++) {
+			wk = w[i & 3] + vb2_loadu(&vb2_sha256_k[4 * i]);
+			if (i < 12)
+				w[i & 3] = vb2_sha256su0(w[i & 3],
+							 w[(i + 1) & 3]);
+
+			tmp = state0;
+			state0 = vb2_sha256h(state0, state1, wk);
+			state1 = vb2_sha256h2(state1, tmp, wk);
+
+			if (i < 12)
+				w[i & 3] = vb2_sha256su1(w[i & 3],
+							 w[(i + 2) & 3],
+							 w[(i + 3) & 3]);
+		}
+
+		state0 += abcd_save;
+		state1 += efgh_save;
+	}
+
+	vb2_storeu(&h[0], state0);
+	vb2_storeu(&h[4], state1);
+}
@@ -0,0 +1,145 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * SHA-256 block transform using the x86 SHA extensions (SHA-NI).
+ *
+ * Firmware builds use -nostdinc, so the compiler's intrinsics headers are not
+ * available; the few instructions needed are wrapped in inline asm instead.
+ * The round structure follows Intel's reference implementation: the state is
+ * kept as ABEF / CDGH in two xmm registers, each SHA256RNDS2 performs two
+ * rounds, and SHA256MSG1/SHA256MSG2 compute the message schedule four words
+ * at a time.
+ */
+
+#include "2sha.h"
+#include "2sha_private.h"
+#include "2sysincludes.h"
+
+typedef int vb2_m128i __attribute__((vector_size(16)));
+typedef int vb2_m128i_u __attribute__((vector_size(16), aligned(1),
+				       __may_alias__));
+
+static inline vb2_m128i vb2_loadu(const void *p)
+{
+	return *(const vb2_m128i_u *)p;
+}
+
+static inline void vb2_storeu(void *p, vb2_m128i a)
+{
+	*(vb2_m128i_u *)p = a;
+}
+
+static inline vb2_m128i vb2_sha256rnds2(vb2_m128i cdgh, vb2_m128i abef,
+					vb2_m128i wk)
+{
+	__asm__("sha256rnds2 %1, %0" : "+x"(cdgh) : "x"(abef), "Yz"(wk));
+	return cdgh;
+}
+
+static inline vb2_m128i vb2_sha256msg1(vb2_m128i a, vb2_m128i b)
+{
+	__asm__("sha256msg1 %1, %0" : "+x"(a) : "x"(b));
+	return a;
+}
+
+static inline vb2_m128i vb2_sha256msg2(vb2_m128i a, vb2_m128i b)
+{
+	__asm__("sha256msg2 %1, %0" : "+x"(a) : "x"(b));
+	return a;
+}
+
+static inline vb2_m128i vb2_pshufb(vb2_m128i a, vb2_m128i mask)
+{
+	__asm__("pshufb %1, %0" : "+x"(a) : "x"(mask));
+	return a;
+}
+
+/* Concatenate hi:lo and shift right by 4 bytes */
+static inline vb2_m128i vb2_palignr4(vb2_m128i hi, vb2_m128i lo)
+{
+	__asm__("palignr $4, %1, %0" : "+x"(hi) : "x"(lo));
+	return hi;
+}
+
+/* Concatenate hi:lo and shift right by 8 bytes */
+static inline vb2_m128i vb2_palignr8(vb2_m128i hi, vb2_m128i lo)
+{
+	__asm__("palignr $8, %1, %0" : "+x"(hi) : "x"(lo));
+	return hi;
+}
+
+/* Take the upper 64 bits from b and the lower 64 bits from a */
+static inline vb2_m128i vb2_pblendw_hi(vb2_m128i a, vb2_m128i b)
+{
+	__asm__("pblendw $0xf0, %1, %0" : "+x"(a) : "x"(b));
+	return a;
+}
+
+#define VB2_PSHUFD(a, imm) ({ \
+	vb2_m128i __r; \
+	__asm__("pshufd $" #imm ", %1, %0" : "=x"(__r) : "x"(a)); \
+	__r; \
+})
+
+void vb2_sha256_transform_ext(uint32_t *h, const uint8_t *message,
+			      unsigned int block_nb)
+{
+	/* Byte-swap each 32-bit word of a block from big-endian */
+	const vb2_m128i bswap_mask = {
+		0x00010203, 0x04050607, 0x08090a0b, 0x0c0d0e0f
+	};
+	vb2_m128i state0, state1, abef_save, cdgh_save;
+	vb2_m128i msg, tmp;
+	vb2_m128i w[4];
+	int i;
+
+	/* Rearrange h[0..7] = ABCD EFGH into ABEF / CDGH */
+	tmp = VB2_PSHUFD(vb2_loadu(&h[0]), 0xb1);	/* CDAB */
+	state1 = VB2_PSHUFD(vb2_loadu(&h[4]), 0x1b);	/* EFGH */
+	state0 = vb2_palignr8(tmp, state1);		/* ABEF */
+	state1 = vb2_pblendw_hi(state1, tmp);		/* CDGH */
+
+	for (; block_nb > 0; block_nb--, message += VB2_SHA256_BLOCK_SIZE) {
+		abef_save = state0;
+		cdgh_save = state1;
+
+		/*
+		 * Sixteen groups of four rounds.  w[] holds a sliding window
+		 * of the last four schedule vectors; vector i+4 is finished
+		 * (msg2) one group before it is consumed and started (msg1)
+		 * two groups before that.
+		 */
+		for (i = 0; i < 16; i++) {
+			if (i < 4)
+				w[i] = vb2_pshufb(vb2_loadu(message + 16 * i),
+						  bswap_mask);
+
+			msg = w[i & 3] + vb2_loadu(&vb2_sha256_k[4 * i]);
+			state1 = vb2_sha256rnds2(state1, state0, msg);
+
+			if (i >= 3 && i < 15) {
+				tmp = vb2_palignr4(w[i & 3], w[(i - 1) & 3]);
+				w[(i + 1) & 3] += tmp;
+				w[(i + 1) & 3] = vb2_sha256msg2(w[(i + 1) & 3],
+								w[i & 3]);
+			}
+
+			msg = VB2_PSHUFD(msg, 0x0e);
+			state0 = vb2_sha256rnds2(state0, state1, msg);
+
+			if (i >= 1 && i < 13)
+				w[(i - 1) & 3] = vb2_sha256msg1(w[(i - 1) & 3],
+								w[i & 3]);
+		}
+
+		state0 += abef_save;
+		state1 += cdgh_save;
+	}
+
+	/* Back from ABEF / CDGH to ABCD EFGH */
+	tmp = VB2_PSHUFD(state0, 0x1b);			/* FEBA */
+	state1 = VB2_PSHUFD(state1, 0xb1);		/* DCHG */
+	vb2_storeu(&h[0], vb2_pblendw_hi(tmp, state1));	/* DCBA */
+	vb2_storeu(&h[4], vb2_palignr8(state1, tmp));	/* HGFE */
+}
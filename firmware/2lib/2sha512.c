@@ -37,6 +37,7 @@
 
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 #include "2sysincludes.h"
 
 #define SHFR(x, n)    (x >> n)
@@ -93,7 +94,7 @@
 #define SHA512_EXP(a, b, c, d, e, f, g ,h, j)				\
 	{								\
 		t1 = wv[h] + SHA512_F2(wv[e]) + CH(wv[e], wv[f], wv[g]) \
-			+ sha512_k[j] + w[j];				\
+			+ vb2_sha512_k[j] + w[j];			\
 		t2 = SHA512_F1(wv[a]) + MAJ(wv[a], wv[b], wv[c]);       \
 		wv[d] += t1;                                            \
 		wv[h] = t1 + t2;                                        \
@@ -106,7 +107,7 @@ static const uint64_t sha512_h0[8] = {
 	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
 };
 
-static const uint64_t sha512_k[80] = {
+const uint64_t vb2_sha512_k[80] = {
 	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
 	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
 	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
@@ -173,6 +174,9 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 				 const uint8_t *message,
 				 unsigned int block_nb)
 {
+#ifdef SHA512_SIMD
+	vb2_sha512_transform_ext(ctx->h, message, block_nb);
+#else
 	/* Note that these arrays use 88*8=704 bytes of stack */
 	uint64_t w[80];
 	uint64_t wv[8];
@@ -255,7 +259,7 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 
 		for (j = 0; j < 80; j++) {
 			t1 = wv[7] + SHA512_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
-				+ sha512_k[j] + w[j];
+				+ vb2_sha512_k[j] + w[j];
 			t2 = SHA512_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
 			wv[7] = wv[6];
 			wv[6] = wv[5];
@@ -271,6 +275,7 @@ static void vb2_sha512_transform(struct vb2_sha512_context *ctx,
 			ctx->h[j] += wv[j];
 #endif /* UNROLL_LOOPS_SHA512 */
 	}
+#endif /* SHA512_SIMD */
 }
 
 void vb2_sha512_update(struct vb2_sha512_context *ctx,
@@ -0,0 +1,95 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Runtime selection of the SHA transforms, for host builds.
+ *
+ * Host tools are built once and run on whatever machine they land on, so
+ * instead of requiring X86_SHA_EXT / ARMV8_CRYPTO_EXT at build time they probe
+ * the CPU (cpuid on x86, HWCAP on AArch64) the first time a digest is
+ * computed and cache the result.  Firmware never uses this file.
+ */
+
+#include "2sha.h"
+#include "2sha_private.h"
+#include "2sysincludes.h"
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
+static const struct vb2_sha_dispatch vb2_sha_dispatch_c = {
+	.sha256_transform = vb2_sha256_transform_c,
+	.sha256_name = "portable C",
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+static const struct vb2_sha_dispatch vb2_sha_dispatch_ext = {
+	.sha256_transform = vb2_sha256_transform_ext,
+	.sha256_name = "x86 SHA extensions",
+};
+
+static void vb2_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+	__asm__("cpuid"
+		: "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+		: "a"(leaf), "c"(subleaf));
+}
+
+static int vb2_cpu_has_sha_ext(void)
+{
+	uint32_t regs[4];
+
+	vb2_cpuid(0, 0, regs);
+	if (regs[0] < 7)
+		return 0;
+
+	/* The transform also uses pshufb/palignr (SSSE3) and pblendw (SSE4.1) */
+	vb2_cpuid(1, 0, regs);
+	if (!(regs[2] & (1 << 9)) || !(regs[2] & (1 << 19)))
+		return 0;
+
+	vb2_cpuid(7, 0, regs);
+	return !!(regs[1] & (1 << 29));
+}
+
+#elif defined(__aarch64__)
+
+static const struct vb2_sha_dispatch vb2_sha_dispatch_ext = {
+	.sha256_transform = vb2_sha256_transform_ext,
+	.sha256_name = "ARMv8 crypto extensions",
+};
+
+static int vb2_cpu_has_sha_ext(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_SHA2);
+}
+
+#endif
+
+const struct vb2_sha_dispatch *vb2_sha_get_dispatch(void)
+{
+	/*
+	 * Racing callers all probe the same CPU and store the same pointer,
+	 * so this needs no locking.
+	 */
+	static const struct vb2_sha_dispatch *dispatch;
+
+	if (dispatch)
+		return dispatch;
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+	if (vb2_cpu_has_sha_ext()) {
+		dispatch = &vb2_sha_dispatch_ext;
+		return dispatch;
+	}
+#endif
+
+	dispatch = &vb2_sha_dispatch_c;
+	return dispatch;
+}
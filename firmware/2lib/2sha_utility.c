@@ -7,6 +7,7 @@
 
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 #include "2sysincludes.h"
 
 #if VB2_SUPPORT_SHA1
@@ -121,6 +122,7 @@ vb2_error_t vb2_digest_init(struct vb2_digest_context *dc,
 {
 	dc->hash_alg = hash_alg;
 	dc->using_hwcrypto = 0;
+	dc->hwcrypto_pending = 0;
 
 	switch (dc->hash_alg) {
 #if VB2_SUPPORT_SHA1
@@ -212,6 +214,146 @@ vb2_error_t vb2_digest_buffer(const uint8_t *buf, uint32_t size,
 	return vb2_digest_finalize(&dc, digest, digest_size);
 }
 
+vb2_error_t vb2_digest_buffers_multi(const struct vb2_digest_job *jobs,
+				     uint32_t count)
+{
+#if VB2_SUPPORT_SHA256
+	struct vb2_sha256_context ctx[VB2_SHA256_LANES];
+	const struct vb2_digest_job *lane[VB2_SHA256_LANES] = {NULL};
+	const uint8_t *pos[VB2_SHA256_LANES];
+	uint32_t *h[VB2_SHA256_LANES];
+	uint32_t unused_h[8];
+	uint32_t left[VB2_SHA256_LANES];
+	uint32_t next = 0;
+	uint32_t blocks;
+	int busy, l;
+#endif
+	vb2_error_t rv;
+	uint32_t i;
+
+	/*
+	 * Everything except SHA-256 is hashed serially.  The same goes for
+	 * SHA-256 if the single-stream transform uses CPU SHA instructions,
+	 * since that beats interleaving lanes in general-purpose vectors.
+	 */
+	for (i = 0; i < count; i++) {
+		if (VB2_SUPPORT_SHA256 && !VB2_SHA256_TRANSFORM_EXT &&
+		    jobs[i].hash_alg == VB2_HASH_SHA256) {
+			if (jobs[i].digest_size < VB2_SHA256_DIGEST_SIZE)
+				return VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE;
+			continue;
+		}
+		rv = vb2_digest_buffer(jobs[i].buf, jobs[i].size,
+				       jobs[i].hash_alg, jobs[i].digest,
+				       jobs[i].digest_size);
+		if (rv)
+			return rv;
+	}
+
+#if VB2_SUPPORT_SHA256
+	if (VB2_SHA256_TRANSFORM_EXT)
+		return VB2_SUCCESS;
+
+	for (;;) {
+		/* Refill idle lanes */
+		busy = -1;
+		for (l = 0; l < VB2_SHA256_LANES; l++) {
+			while (!lane[l] && next < count) {
+				if (jobs[next].hash_alg == VB2_HASH_SHA256) {
+					lane[l] = &jobs[next];
+					pos[l] = lane[l]->buf;
+					left[l] = lane[l]->size;
+					vb2_sha256_init(&ctx[l]);
+				}
+				next++;
+			}
+			if (lane[l])
+				busy = l;
+		}
+		if (busy < 0)
+			return VB2_SUCCESS;
+
+		/* Hash as many whole blocks as every busy lane has left */
+		blocks = UINT32_MAX;
+		for (l = 0; l < VB2_SHA256_LANES; l++) {
+			if (lane[l] && left[l] / VB2_SHA256_BLOCK_SIZE < blocks)
+				blocks = left[l] / VB2_SHA256_BLOCK_SIZE;
+		}
+		if (blocks) {
+			/* Idle lanes shadow a busy one into a scratch state */
+			for (l = 0; l < VB2_SHA256_LANES; l++) {
+				h[l] = lane[l] ? ctx[l].h : unused_h;
+				if (!lane[l])
+					pos[l] = pos[busy];
+			}
+			vb2_sha256_transform_x4(h, pos, blocks);
+			for (l = 0; l < VB2_SHA256_LANES; l++) {
+				if (!lane[l])
+					continue;
+				pos[l] += blocks * VB2_SHA256_BLOCK_SIZE;
+				left[l] -= blocks * VB2_SHA256_BLOCK_SIZE;
+				ctx[l].total_size +=
+					blocks * VB2_SHA256_BLOCK_SIZE;
+			}
+		}
+
+		/* Finish lanes with less than a block left */
+		for (l = 0; l < VB2_SHA256_LANES; l++) {
+			if (!lane[l] || left[l] >= VB2_SHA256_BLOCK_SIZE)
+				continue;
+			vb2_sha256_update(&ctx[l], pos[l], left[l]);
+			vb2_sha256_finalize(&ctx[l], lane[l]->digest);
+			lane[l] = NULL;
+		}
+	}
+#else
+	return VB2_SUCCESS;
+#endif
+}
+
+vb2_error_t vb2_digest_tree_buffer(const uint8_t *buf, uint32_t size,
+				   enum vb2_hash_algorithm hash_alg,
+				   uint8_t *digest, uint32_t digest_size)
+{
+	struct vb2_digest_context dc;
+	struct vb2_digest_job jobs[VB2_SHA256_LANES];
+	uint8_t chunk_digest[VB2_SHA256_LANES][VB2_MAX_DIGEST_SIZE];
+	uint32_t chunk_digest_size = vb2_digest_size(hash_alg);
+	uint32_t count, i;
+	vb2_error_t rv;
+
+	rv = vb2_digest_init(&dc, hash_alg);
+	if (rv)
+		return rv;
+
+	/* Hash a batch of chunks at a time, then fold them into the root */
+	while (size) {
+		for (count = 0; count < VB2_SHA256_LANES && size; count++) {
+			jobs[count].buf = buf;
+			jobs[count].size = VB2_MIN(size,
+						   VB2_TREE_HASH_CHUNK_SIZE);
+			jobs[count].hash_alg = hash_alg;
+			jobs[count].digest = chunk_digest[count];
+			jobs[count].digest_size = sizeof(chunk_digest[count]);
+			buf += jobs[count].size;
+			size -= jobs[count].size;
+		}
+
+		rv = vb2_digest_buffers_multi(jobs, count);
+		if (rv)
+			return rv;
+
+		for (i = 0; i < count; i++) {
+			rv = vb2_digest_extend(&dc, chunk_digest[i],
+					       chunk_digest_size);
+			if (rv)
+				return rv;
+		}
+	}
+
+	return vb2_digest_finalize(&dc, digest, digest_size);
+}
+
 vb2_error_t vb2_hash_verify(const void *buf, uint32_t size,
 			    const struct vb2_hash *hash)
 {
@@ -40,6 +40,20 @@ vb2_error_t vb2ex_read_resource(struct vb2_context *ctx,
 	return VB2_ERROR_EX_UNIMPLEMENTED;
 }
 
+__attribute__((weak))
+vb2_error_t vb2ex_prefetch_resource(struct vb2_context *ctx,
+				    enum vb2_resource_index index,
+				    uint32_t offset, uint32_t size)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+vb2_error_t vb2ex_prefetch_mapped(const void *buf, uint32_t size)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
 __attribute__((weak))
 vb2_error_t vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
 				       uint32_t data_size)
@@ -53,6 +67,20 @@ vb2_error_t vb2ex_hwcrypto_digest_extend(const uint8_t *buf, uint32_t size)
 	return VB2_ERROR_SHA_EXTEND_ALGORITHM;  /* Should not be called. */
 }
 
+__attribute__((weak))
+vb2_error_t vb2ex_hwcrypto_digest_extend_async(const uint8_t *buf,
+					       uint32_t size)
+{
+	/* Engines which can't run in the background just hash it now */
+	return vb2ex_hwcrypto_digest_extend(buf, size);
+}
+
+__attribute__((weak))
+vb2_error_t vb2ex_hwcrypto_digest_wait(void)
+{
+	return VB2_SUCCESS;
+}
+
 __attribute__((weak))
 vb2_error_t vb2ex_hwcrypto_digest_finalize(uint8_t *digest,
 					   uint32_t digest_size)
@@ -80,12 +108,57 @@ vb2_error_t vb2ex_auxfw_update(void)
         return VB2_SUCCESS;
 }
 
+__attribute__((weak))
+vb2_error_t vb2ex_auxfw_get_devices(struct vb2_auxfw_device *devices,
+				    uint32_t *count)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+vb2_error_t vb2ex_auxfw_update_start(uint32_t device)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+vb2_error_t vb2ex_auxfw_update_poll(uint32_t device)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
 __attribute__((weak))
 vb2_error_t vb2ex_auxfw_finalize(struct vb2_context *ctx)
 {
         return VB2_SUCCESS;
 }
 
+__attribute__((weak))
+vb2_error_t vb2ex_read_vblock_cache(struct vb2_context *ctx, uint8_t *digest,
+				    uint32_t size)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+vb2_error_t vb2ex_write_vblock_cache(struct vb2_context *ctx,
+				     const uint8_t *digest, uint32_t size)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+uint32_t vb2ex_utime(void)
+{
+	return 0;
+}
+
+__attribute__((weak))
+uint64_t vb2ex_cycle_counter(void)
+{
+	return 0;
+}
+
 __attribute__((weak))
 void vb2ex_abort(void)
 {
@@ -0,0 +1,60 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Call and cycle counts for hot paths, when built with VB2_TRACE=1.
+ */
+
+#include "2common.h"
+#include "2trace.h"
+
+#if VB2_TRACE
+
+static struct vb2_trace_counter trace_counters[VB2_TRACE_POINT_COUNT] = {
+	[VB2_TRACE_SHA256_TRANSFORM] = {.name = "vb2_sha256_transform"},
+	[VB2_TRACE_MONTMUL] = {.name = "montMul"},
+	[VB2_TRACE_CRC32] = {.name = "Crc32"},
+	[VB2_TRACE_SAFE_MEMCMP] = {.name = "vb2_safe_memcmp"},
+};
+
+void vb2_trace_record(enum vb2_trace_point point, uint64_t start)
+{
+	if (point >= VB2_TRACE_POINT_COUNT)
+		return;
+
+	trace_counters[point].calls++;
+	trace_counters[point].cycles += vb2ex_cycle_counter() - start;
+}
+
+const struct vb2_trace_counter *vb2_trace_get(enum vb2_trace_point point)
+{
+	if (point >= VB2_TRACE_POINT_COUNT)
+		return NULL;
+
+	return &trace_counters[point];
+}
+
+void vb2_trace_reset(void)
+{
+	int i;
+
+	for (i = 0; i < VB2_TRACE_POINT_COUNT; i++) {
+		trace_counters[i].calls = 0;
+		trace_counters[i].cycles = 0;
+	}
+}
+
+void vb2_trace_dump(void)
+{
+	const struct vb2_trace_counter *t;
+	int i;
+
+	VB2_DEBUG_RAW("%-22s %8s %12s\n", "Trace point", "calls", "cycles");
+	for (i = 0; i < VB2_TRACE_POINT_COUNT; i++) {
+		t = &trace_counters[i];
+		VB2_DEBUG_RAW("%-22s %8u %12" PRIu64 "\n", t->name,
+			      t->calls, t->cycles);
+	}
+}
+
+#endif  /* VB2_TRACE */
@@ -299,6 +299,21 @@ enum vb2_pcr_digest {
 
 	/* SHA-256 hash digest of HWID, from GBB */
 	HWID_DIGEST_PCR,
+
+	/* Number of digests; must be last */
+	VB2_PCR_DIGEST_COUNT
+};
+
+/* One measurement returned by vb2api_get_pcr_events() */
+struct vb2_pcr_event {
+	/* Which digest this is */
+	enum vb2_pcr_digest pcr;
+
+	/* Size of the digest; the rest of digest[] is zero */
+	uint32_t digest_size;
+
+	/* Digest, zero-padded so it can be extended into a SHA-256 bank */
+	uint8_t digest[VB2_PCR_DIGEST_RECOMMENDED_SIZE];
 };
 
 /******************************************************************************
@@ -333,6 +348,9 @@ enum vb2_pcr_digest {
  *	Call vb2api_fw_phase2().  At present, this nominally decides which
  *	firmware slot will be attempted (A or B).
  *
+ *	Optionally, call vb2api_fw_prepare_other_slot() and verify the other
+ *	slot on a second core, so a failure doesn't need a reboot to fall back.
+ *
  *	Call vb2api_fw_phase3().  At present, this nominally verifies the
  *	firmware keyblock and preamble.
  *
@@ -437,7 +455,12 @@ vb2_error_t vb2api_init(void *workbuf, uint32_t size,
  * After transitioning between different firmware applications, or any time the
  * context pointer is lost, this function should be called to restore access to
  * the workbuf.  A pointer to the context object is written to ctxptr.  Returns
- * an error if the vboot work buffer is inconsistent.
+ * an error if the vboot work buffer is inconsistent, including if any GBB
+ * header, key, preamble or hash state it refers to lies outside the used
+ * part of the workbuf.
+ *
+ * The verified state is adopted in place, so the later stage doesn't need to
+ * read and check the GBB, preamble or nvdata again.
  *
  * If the workbuf needs to be relocated, call vb2api_relocate() instead
  * of copying memory manually.
@@ -469,6 +492,28 @@ vb2_error_t vb2api_reinit(void *workbuf, struct vb2_context **ctxptr);
 vb2_error_t vb2api_relocate(void *new_workbuf, const void *cur_workbuf,
 			    uint32_t size, struct vb2_context **ctxptr);
 
+/**
+ * Return the most workbuf vboot has used at once.
+ *
+ * Covers every allocation made from the context work buffer since
+ * vb2api_init() or the last vb2api_reset_workbuf_peak(), including the space
+ * kept between calls.  Useful for sizing the work buffer for a particular
+ * set of keys.
+ *
+ * @param ctx		Vboot context
+ * @return The peak workbuf usage in bytes.
+ */
+uint32_t vb2api_get_workbuf_peak(struct vb2_context *ctx);
+
+/**
+ * Restart workbuf peak tracking from the current usage.
+ *
+ * Call this before an API call to measure the peak of that call alone.
+ *
+ * @param ctx		Vboot context
+ */
+void vb2api_reset_workbuf_peak(struct vb2_context *ctx);
+
 /**
  * Check the validity of firmware secure storage context.
  *
@@ -572,6 +617,34 @@ vb2_error_t vb2api_fw_phase1(struct vb2_context *ctx);
  */
 vb2_error_t vb2api_fw_phase2(struct vb2_context *ctx);
 
+/**
+ * Set up the other firmware slot for verification alongside the chosen one.
+ *
+ * Optional, for platforms which can run verstage work on a second core.  Call
+ * this after vb2api_fw_phase2() succeeds, before anything else uses ctx.  It
+ * copies the context into a second work buffer and points the copy at the
+ * other slot, with nvdata set up as if the chosen slot had failed and the
+ * system had rebooted.  The copy is independent of ctx, so vb2api_fw_phase3()
+ * can run on it in parallel with phase 3 and the body hash of the chosen
+ * slot; vb2ex_read_resource() must then be safe to call from both at once.
+ *
+ * If the chosen slot fails after that, and phase 3 succeeded on the copy,
+ * the calling firmware can drop ctx and continue the boot with the copy
+ * (hashing its body as usual) instead of rebooting.  Otherwise it should
+ * ignore the copy.
+ *
+ * @param ctx		Vboot context, after phase 2
+ * @param workbuf	Work buffer for the copy; must be aligned to
+ *			VB2_WORKBUF_ALIGN
+ * @param size		Size of the work buffer for the copy
+ * @param other_ctxptr	Destination for the copied context
+ * @return VB2_SUCCESS, or error code if the other slot is not worth
+ *	   preparing or the copy failed.
+ */
+vb2_error_t vb2api_fw_prepare_other_slot(struct vb2_context *ctx,
+					 void *workbuf, uint32_t size,
+					 struct vb2_context **other_ctxptr);
+
 /**
  * Firmware selection, phase 3.
  *
@@ -589,6 +662,14 @@ vb2_error_t vb2api_fw_phase3(struct vb2_context *ctx);
 /**
  * Initialize hashing data for the specified tag.
  *
+ * If the firmware preamble has VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH set, the
+ * body can be checked in one of two ways.  With VB2_HASH_TAG_FW_BODY, the body
+ * data is passed to vb2api_extend_hash() as usual and vboot splits it into
+ * chunks itself.  With VB2_HASH_TAG_FW_BODY_TREE, the caller hashes each
+ * VB2_TREE_HASH_CHUNK_SIZE chunk with vb2api_get_hash_alg() however it likes
+ * (in parallel, or while the next chunk is being read) and passes the chunk
+ * digests to vb2api_extend_hash_chunk_digest() in order.
+ *
  * @param ctx		Vboot context
  * @param tag		Tag to start hashing (enum vb2_hash_tag)
  * @return VB2_SUCCESS, or error code on error.
@@ -608,6 +689,90 @@ vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag);
 vb2_error_t vb2api_extend_hash(struct vb2_context *ctx, const void *buf,
 			       uint32_t size);
 
+/**
+ * Extend the hash started by vb2api_init_hash() with additional data, without
+ * waiting for the hardware crypto engine to finish with it.
+ *
+ * This lets the caller double-buffer the body: while the engine hashes one
+ * buffer, the caller reads the next part of the body into a second buffer,
+ * then passes that in here.  buf must not be changed until the next call to
+ * vb2api_extend_hash_async(), vb2api_extend_hash() or vb2api_check_hash*();
+ * any of those first waits for the engine.  Without hardware crypto this is
+ * the same as vb2api_extend_hash().
+ *
+ * @param ctx		Vboot context
+ * @param buf		Data to hash
+ * @param size		Size of data in bytes
+ * @return VB2_SUCCESS, or error code on error.  An error from the engine
+ * hashing buf may instead be returned by the next call which waits for it.
+ */
+vb2_error_t vb2api_extend_hash_async(struct vb2_context *ctx, const void *buf,
+				     uint32_t size);
+
+/* Bytes hashed at a time by vb2api_extend_hash_mapped() */
+#define VB2_MAPPED_HASH_STRIDE (64 * 1024)
+
+/* Flags for struct vb2_mapped_region */
+enum vb2_mapped_region_flags {
+	/*
+	 * The mapping is cached, so vb2ex_prefetch_mapped() can pull in the
+	 * next stride while the current one is hashed.
+	 */
+	VB2_MAPPED_REGION_CACHED = (1 << 0),
+};
+
+/* Memory-mapped body data for vb2api_extend_hash_mapped() */
+struct vb2_mapped_region {
+	/* Start of the data in the mapping */
+	const void *base;
+
+	/* Size of the data in bytes */
+	uint32_t size;
+
+	/* Flags; see enum vb2_mapped_region_flags */
+	uint32_t flags;
+};
+
+/**
+ * Extend the hash started by vb2api_init_hash() with memory-mapped data.
+ *
+ * For flash which the platform maps into memory (such as SPI flash on x86),
+ * this hashes straight from the mapping instead of copying it into a buffer
+ * first.  The data is hashed in VB2_MAPPED_HASH_STRIDE strides aligned to
+ * the stride size.  If the region is VB2_MAPPED_REGION_CACHED, each stride
+ * is handed to vb2ex_prefetch_mapped() before the one ahead of it is hashed.
+ *
+ * @param ctx		Vboot context
+ * @param region	Mapped data to hash
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2api_extend_hash_mapped(struct vb2_context *ctx,
+				      const struct vb2_mapped_region *region);
+
+/**
+ * Extend the tree hash started by vb2api_init_hash() with the digest of the
+ * next body chunk.
+ *
+ * Only valid for VB2_HASH_TAG_FW_BODY_TREE.  Every chunk except the last is
+ * VB2_TREE_HASH_CHUNK_SIZE bytes of the body; the last holds whatever is left.
+ *
+ * @param ctx		Vboot context
+ * @param digest	Digest of the chunk
+ * @param digest_size	Size of digest in bytes; must match the hash algorithm
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2api_extend_hash_chunk_digest(struct vb2_context *ctx,
+					    const void *digest,
+					    uint32_t digest_size);
+
+/**
+ * Get the hash algorithm of the hash started by vb2api_init_hash().
+ *
+ * @param ctx		Vboot context
+ * @return The hash algorithm, or VB2_HASH_INVALID if no hash was started.
+ */
+enum vb2_hash_algorithm vb2api_get_hash_alg(struct vb2_context *ctx);
+
 /**
  * Check the hash value started by vb2api_init_hash().
  *
@@ -644,6 +809,23 @@ vb2_error_t vb2api_get_pcr_digest(struct vb2_context *ctx,
 				  enum vb2_pcr_digest which_digest,
 				  uint8_t *dest, uint32_t *dest_size);
 
+/**
+ * Get every PCR digest at once.
+ *
+ * Fills one event per enum vb2_pcr_digest, so the caller can extend them all
+ * at a single point in verstage and keep the list for later attestation
+ * without asking vboot again.
+ *
+ * @param ctx		Vboot context
+ * @param events	Destination for the events
+ * @param count		IN: number of entries in events
+ *			OUT: number of events filled in (VB2_PCR_DIGEST_COUNT)
+ * @return VB2_SUCCESS, or error code on error
+ */
+vb2_error_t vb2api_get_pcr_events(struct vb2_context *ctx,
+				  struct vb2_pcr_event *events,
+				  uint32_t *count);
+
 /**
  * Prepare for kernel verification stage.
  *
@@ -776,6 +958,39 @@ vb2_error_t vb2ex_read_resource(struct vb2_context *ctx,
 				enum vb2_resource_index index, uint32_t offset,
 				void *buf, uint32_t size);
 
+/**
+ * Hint that vboot is about to read part of a verified boot resource.
+ *
+ * vboot reads a vblock in several small pieces, since it only learns how big
+ * each piece is from the one before.  A platform can use this to fetch the
+ * whole range in one flash or DMA burst and serve the vb2ex_read_resource()
+ * calls which follow from memory.  This is only a hint: vboot ignores the
+ * return value, and still reads everything it uses.  The default
+ * implementation does nothing.
+ *
+ * @param ctx		Vboot context
+ * @param index		Resource index about to be read
+ * @param offset	Byte offset within resource to start at
+ * @param size		Amount of data, or 0 for the rest of the resource
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2ex_prefetch_resource(struct vb2_context *ctx,
+				    enum vb2_resource_index index,
+				    uint32_t offset, uint32_t size);
+
+/**
+ * Hint that vboot is about to hash part of a cached memory mapping.
+ *
+ * Called by vb2api_extend_hash_mapped() one stride ahead of the hash, so the
+ * platform can issue cache prefetches or start a read-ahead.  vboot ignores
+ * the return value.  The default implementation does nothing.
+ *
+ * @param buf		Start of the data about to be hashed
+ * @param size		Size of the data in bytes
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2ex_prefetch_mapped(const void *buf, uint32_t size);
+
 /**
  * Print debug output.
  *
@@ -810,6 +1025,31 @@ vb2_error_t vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
  */
 vb2_error_t vb2ex_hwcrypto_digest_extend(const uint8_t *buf, uint32_t size);
 
+/**
+ * Start extending the hash in the hardware crypto engine with another block
+ * of data, without waiting for the engine to finish.
+ *
+ * The engine may keep reading buf until vb2ex_hwcrypto_digest_wait() returns.
+ * vboot never has more than one async extend outstanding, and always waits
+ * for it before the next extend or finalize.  The default implementation
+ * calls vb2ex_hwcrypto_digest_extend(), so engines without async support need
+ * not provide this.
+ *
+ * @param buf		Next data block to hash
+ * @param size		Length of data block in bytes
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+vb2_error_t vb2ex_hwcrypto_digest_extend_async(const uint8_t *buf,
+					       uint32_t size);
+
+/**
+ * Wait for the outstanding vb2ex_hwcrypto_digest_extend_async() to finish.
+ *
+ * @return VB2_SUCCESS, or non-zero error code if the engine failed to hash
+ * the block.
+ */
+vb2_error_t vb2ex_hwcrypto_digest_wait(void);
+
 /**
  * Finalize the digest in the hardware crypto engine and extract the result.
  *
@@ -835,6 +1075,68 @@ vb2_error_t vb2ex_hwcrypto_digest_finalize(uint8_t *digest,
  */
 vb2_error_t vb2ex_tpm_set_mode(enum vb2_tpm_mode mode_val);
 
+/**
+ * Read the digest of the last firmware vblock verified by signature.
+ *
+ * Implementing this and vb2ex_write_vblock_cache() opts in to skipping the
+ * keyblock and preamble signature checks when the firmware slot, root key and
+ * vblock are unchanged since they were last verified.  The digest must be
+ * kept somewhere only read-only firmware can write, such as a TPM NV space
+ * locked before RW firmware runs; anything that can write it can make vboot
+ * accept an unsigned vblock.  The default implementation returns
+ * VB2_ERROR_EX_UNIMPLEMENTED, which disables the cache.
+ *
+ * @param ctx		Vboot context
+ * @param digest	Destination for the digest
+ * @param size		Size of digest (VB2_VBLOCK_CACHE_DIGEST_SIZE)
+ * @return VB2_SUCCESS, VB2_ERROR_EX_UNIMPLEMENTED if there is no cache, or
+ * another non-zero error if the cache is empty or unreadable.
+ */
+vb2_error_t vb2ex_read_vblock_cache(struct vb2_context *ctx, uint8_t *digest,
+				    uint32_t size);
+
+/**
+ * Store the digest of a firmware vblock which was verified by signature.
+ *
+ * Called from vb2_load_fw_preamble(), during vb2api_fw_phase3(), once the
+ * keyblock and preamble have both passed their signature checks and the
+ * rollback check, unless the vblock already matched the cached digest.  Only
+ * called if vb2ex_read_vblock_cache() returned something other than
+ * VB2_ERROR_EX_UNIMPLEMENTED.  The digest covers the firmware slot, packed
+ * root key, keyblock and preamble, and is the value vb2ex_read_vblock_cache()
+ * should return next boot.  Errors are logged and otherwise ignored, since
+ * the cache only affects boot time.
+ *
+ * @param ctx		Vboot context
+ * @param digest	Digest to store
+ * @param size		Size of digest (VB2_VBLOCK_CACHE_DIGEST_SIZE)
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+vb2_error_t vb2ex_write_vblock_cache(struct vb2_context *ctx,
+				     const uint8_t *digest, uint32_t size);
+
+/**
+ * Read a microsecond timer for boot-phase timestamps.
+ *
+ * Only differences between readings are meaningful, so the zero point doesn't
+ * matter, and 32 bits is enough for any one boot.  The default implementation
+ * returns 0, which leaves every timestamp at 0.
+ *
+ * @return The current time in microseconds.
+ */
+uint32_t vb2ex_utime(void);
+
+/**
+ * Read a cycle counter for VB2_TRACE builds.
+ *
+ * As with vb2ex_utime(), only differences between readings matter.  The
+ * counter should be cheap to read, since trace points read it on every call
+ * to some hot functions.  The default implementation returns 0.
+ *
+ * @return The current cycle count.
+ */
+uint64_t vb2ex_cycle_counter(void);
+
 /*
  * Abort vboot flow due to a failed assertion or broken assumption.
  *
@@ -915,6 +1217,54 @@ vb2_error_t vb2ex_auxfw_check(enum vb2_auxfw_update_severity *severity);
  */
 vb2_error_t vb2ex_auxfw_update(void);
 
+/* Most auxfw devices vb2ex_auxfw_get_devices() may report */
+#define VB2_AUXFW_MAX_DEVICES 16
+
+/* An auxfw device which can be updated on its own */
+struct vb2_auxfw_device {
+	/* Devices on the same bus are updated one at a time */
+	uint32_t bus;
+	/* Whether this device needs updating, and how long it will take */
+	enum vb2_auxfw_update_severity severity;
+};
+
+/*
+ * Get the auxfw devices which can be updated on their own.
+ *
+ * If this is implemented, vboot updates the devices which need it with
+ * vb2ex_auxfw_update_start() and vb2ex_auxfw_update_poll() instead of
+ * calling vb2ex_auxfw_update().  Devices on different buses are updated at
+ * the same time.
+ *
+ * @param devices	Devices to fill in
+ * @param count		On entry, the size of devices; on exit, how many
+ *			were filled in
+ * @return VB2_SUCCESS, VB2_ERROR_EX_UNIMPLEMENTED to update all the devices
+ * with vb2ex_auxfw_update(), or another error.
+ */
+vb2_error_t vb2ex_auxfw_get_devices(struct vb2_auxfw_device *devices,
+				    uint32_t *count);
+
+/*
+ * Start updating an auxfw device, and return without waiting for it.
+ *
+ * @param device	Index into the devices from vb2ex_auxfw_get_devices()
+ * @return VBERROR_... error, VB2_SUCCESS on success.
+ */
+vb2_error_t vb2ex_auxfw_update_start(uint32_t device);
+
+/*
+ * Check on an update started by vb2ex_auxfw_update_start().
+ *
+ * This is called in turn for every device being updated until they are all
+ * done, so it should only wait a short time for the update to progress.
+ *
+ * @param device	Index into the devices from vb2ex_auxfw_get_devices()
+ * @return VB2_SUCCESS if the update is done, VB2_ERROR_EX_AUXFW_BUSY if it
+ * is still in progress, or another error if it failed.
+ */
+vb2_error_t vb2ex_auxfw_update_poll(uint32_t device);
+
 /*
  * Notify client that vboot is done with Aux FW.
  *
@@ -960,6 +1310,19 @@ enum vb2_firmware_selection {
  */
 vb2_error_t vb2api_ec_sync(struct vb2_context *ctx);
 
+/**
+ * Ask the EC to start hashing its active RW image, if EC sync will need it.
+ *
+ * Hashing the image can take the EC tens or hundreds of ms.  Calling this
+ * early in the kernel stage lets that overlap the AP's own work, and
+ * vb2api_ec_sync() collects the hash later.  VbSelectAndLoadKernel() calls
+ * this before kernel phase 1.  It does nothing if EC sync is skipped this
+ * boot, and is only a hint: EC sync works the same without it.
+ *
+ * @param ctx		Vboot context
+ */
+void vb2api_ec_sync_start(struct vb2_context *ctx);
+
 /**
  * This is called only if the system implements a keyboard-based (virtual)
  * developer switch. It must return true only if the system has an embedded
@@ -989,9 +1352,26 @@ vb2_error_t vb2ex_ec_jump_to_rw(void);
  */
 vb2_error_t vb2ex_ec_disable_jump(void);
 
+/**
+ * Start hashing the selected EC image, without waiting for the result.
+ *
+ * The next vb2ex_ec_hash_image() call for the same image returns the result,
+ * waiting for it if need be.  The hash is of the image as it is now, so
+ * vb2ex_ec_update_image() must discard one which is still pending.  The
+ * default implementation returns VB2_ERROR_EX_UNIMPLEMENTED, and
+ * vb2ex_ec_hash_image() then does all the work itself.
+ *
+ * @param select	Image to hash
+ * @return VB2_SUCCESS, or error code if the hash wasn't started.
+ */
+vb2_error_t vb2ex_ec_hash_image_start(enum vb2_firmware_selection select);
+
 /**
  * Read the SHA-256 hash of the selected EC image.
  *
+ * If vb2ex_ec_hash_image_start() started hashing this image, this collects
+ * the result.
+ *
  * @param select    Image to get hash of. RO or RW.
  * @param hash      Pointer to the hash.
  * @param hash_size Pointer to the hash size.
@@ -1016,11 +1396,63 @@ vb2_error_t vb2ex_ec_get_expected_image_hash(enum vb2_firmware_selection select,
 /**
  * Update the selected EC image to the expected version.
  *
+ * If vboot is built with EC_VERIFIED_UPDATE=1, this must only succeed if the
+ * EC checked the hash of the image as written against the expected hash.
+ * vboot then trusts the update instead of asking for a fresh hash of the
+ * whole image.
+ *
  * @param select	Image to get expected hash for (RO or RW).
  * @return VB2_SUCCESS, or error code on error.
  */
 vb2_error_t vb2ex_ec_update_image(enum vb2_firmware_selection select);
 
+/**
+ * Read the hashes of the blocks of the expected EC image.
+ *
+ * An EC image can be updated block by block, rewriting only the blocks which
+ * have changed.  The platform chooses the block size (typically the EC's 4 KB
+ * erase size); vboot only compares hashes.  Optional: the default returns
+ * VB2_ERROR_EX_UNIMPLEMENTED, and vboot then updates with
+ * vb2ex_ec_update_image().
+ *
+ * @param select	Image to get expected block hashes for (RO or RW).
+ * @param hashes	Pointer to the SHA-256 hashes, one per block, in order.
+ * @param count		Pointer to the number of blocks.
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2ex_ec_get_expected_block_hashes(
+	enum vb2_firmware_selection select, const uint8_t **hashes,
+	uint32_t *count);
+
+/**
+ * Hash each block of the selected EC image as it is now.
+ *
+ * Blocks are the same as for vb2ex_ec_get_expected_block_hashes().  The
+ * default returns VB2_ERROR_EX_UNIMPLEMENTED.
+ *
+ * @param select	Image to hash (RO or RW).
+ * @param hashes	Destination for count SHA-256 hashes.
+ * @param count		Number of blocks.
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2ex_ec_hash_blocks(enum vb2_firmware_selection select,
+				 uint8_t *hashes, uint32_t count);
+
+/**
+ * Write some blocks of the selected EC image from the expected image.
+ *
+ * Used instead of vb2ex_ec_update_image() when only some blocks differ, and
+ * may return VBERROR_EC_REBOOT_TO_RO_REQUIRED as that can.  The default
+ * returns VB2_ERROR_EX_UNIMPLEMENTED.
+ *
+ * @param select	Image to update (RO or RW).
+ * @param first		First block to write.
+ * @param count		Number of blocks to write.
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2ex_ec_update_blocks(enum vb2_firmware_selection select,
+				   uint32_t first, uint32_t count);
+
 /**
  * Lock the EC code to prevent updates until the EC is rebooted.
  * Subsequent calls to vb2ex_ec_update_image() with the same region this
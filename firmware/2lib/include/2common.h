@@ -95,6 +95,8 @@ static inline uint32_t vb2_wb_round_up(uint32_t v)
 struct vb2_workbuf {
 	uint8_t *buf;
 	uint32_t size;
+	/* If non-NULL, lowered to the smallest size this has shrunk to */
+	uint32_t *min_size;
 };
 
 /**
@@ -366,6 +368,26 @@ vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
 			    const struct vb2_public_key *key,
 			    const struct vb2_workbuf *wb);
 
+/**
+ * Verify data matches a signature of its tree hash root digest.
+ *
+ * Like vb2_verify_data(), but for data signed with tree hashing (see
+ * VB2_TREE_HASH_CHUNK_SIZE).  The hash contexts are on the stack, so this is
+ * meant for callers with a comfortable stack such as host tools.
+ *
+ * @param data		Data to verify
+ * @param size		Size of data buffer.  Note that amount of data to
+ *			actually validate is contained in sig->data_size.
+ * @param sig		Signature of data (destroyed in process)
+ * @param key		Key to use to validate signature
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+vb2_error_t vb2_verify_tree_data(const uint8_t *data, uint32_t size,
+				 struct vb2_signature *sig,
+				 const struct vb2_public_key *key,
+				 const struct vb2_workbuf *wb);
+
 /**
  * Check the sanity of a keyblock structure.
  *
@@ -397,6 +419,19 @@ vb2_error_t vb2_verify_keyblock(struct vb2_keyblock *block, uint32_t size,
 				const struct vb2_public_key *key,
 				const struct vb2_workbuf *wb);
 
+/**
+ * Check the sanity of a firmware preamble structure.
+ *
+ * Verifies all the header fields, and that the body signature and kernel
+ * subkey are inside the signed data.  Does not verify the signature itself.
+ *
+ * @param preamble     	Preamble to check
+ * @param size		Size of preamble buffer
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+vb2_error_t vb2_check_fw_preamble(const struct vb2_fw_preamble *preamble,
+				  uint32_t size);
+
 /**
  * Check the sanity of a firmware preamble using a public key.
  *
@@ -10,6 +10,40 @@
 
 #include <stdint.h>
 
+/*
+ * Signature algorithms may be disabled individually to save code space, like
+ * the hash algorithms in 2sha.h.  A disabled algorithm reports a signature
+ * size of 0, so keys using it fail to unpack.
+ */
+
+#ifndef VB2_SUPPORT_RSA1024
+#define VB2_SUPPORT_RSA1024 1
+#endif
+
+#ifndef VB2_SUPPORT_RSA2048
+#define VB2_SUPPORT_RSA2048 1
+#endif
+
+#ifndef VB2_SUPPORT_RSA4096
+#define VB2_SUPPORT_RSA4096 1
+#endif
+
+#ifndef VB2_SUPPORT_RSA8192
+#define VB2_SUPPORT_RSA8192 1
+#endif
+
+#ifndef VB2_SUPPORT_RSA2048_EXP3
+#define VB2_SUPPORT_RSA2048_EXP3 1
+#endif
+
+#ifndef VB2_SUPPORT_RSA3072_EXP3
+#define VB2_SUPPORT_RSA3072_EXP3 1
+#endif
+
+#ifndef VB2_SUPPORT_ECDSA_P256
+#define VB2_SUPPORT_ECDSA_P256 1
+#endif
+
 /* Verified boot crypto algorithms */
 enum vb2_crypto_algorithm {
 	VB2_ALG_RSA1024_SHA1   = 0,
@@ -53,6 +87,9 @@ enum vb2_signature_algorithm {
 	VB2_SIG_RSA2048_EXP3 = 6,
 	VB2_SIG_RSA3072_EXP3 = 7,
 
+	/* ECDSA on the NIST P-256 curve */
+	VB2_SIG_ECDSA_P256 = 8,
+
 	/* Last index. Don't add anything below. */
 	VB2_SIG_ALG_COUNT,
 };
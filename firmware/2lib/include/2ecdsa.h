@@ -0,0 +1,50 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef VBOOT_REFERENCE_2ECDSA_H_
+#define VBOOT_REFERENCE_2ECDSA_H_
+
+#include "2crypto.h"
+#include "2return_codes.h"
+
+struct vb2_public_key;
+
+/* Size of a P-256 coordinate or scalar */
+#define VB2_P256_BYTES 32
+#define VB2_P256_WORDS 8
+
+/*
+ * ECDSA keys reuse struct vb2_public_key: arrsize is VB2_P256_WORDS, n points
+ * to the X coordinate of the public point and rr to the Y coordinate, both as
+ * little endian arrays.  n0inv is unused and zero.  The packed key data has
+ * the same layout as an RSA key, so vb2_unpack_key_data() handles both.
+ */
+
+/**
+ * Return the size of an ECDSA signature.
+ *
+ * Signatures are the big endian r and s values, each VB2_P256_BYTES long.
+ *
+ * @param sig_alg	Signature algorithm
+ * @return The size of the signature in bytes, or 0 if not an ECDSA algorithm.
+ */
+uint32_t vb2_ecdsa_sig_size(enum vb2_signature_algorithm sig_alg);
+
+/**
+ * Verify an ECDSA signature against an expected hash digest.
+ *
+ * Digests longer than the curve order are truncated to their leftmost bits,
+ * as ECDSA requires.  Unlike RSA verification this needs no work buffer, and
+ * doesn't modify the signature.
+ *
+ * @param key		Key to use in signature verification
+ * @param sig		Signature to verify
+ * @param digest	Digest of signed data
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+vb2_error_t vb2_ecdsa_verify_digest(const struct vb2_public_key *key,
+				    const uint8_t *sig, const uint8_t *digest);
+
+#endif  /* VBOOT_REFERENCE_2ECDSA_H_ */
@@ -30,6 +30,13 @@ enum vb2_hash_tag {
 	/* Kernel data key */
 	VB2_HASH_TAG_KERNEL_DATA_KEY = 2,
 
+	/*
+	 * Firmware body, tree hashed, with the caller supplying the chunk
+	 * digests via vb2api_extend_hash_chunk_digest().  Only valid if the
+	 * preamble has VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH set.
+	 */
+	VB2_HASH_TAG_FW_BODY_TREE = 3,
+
 	/*
 	 * Tags over 0x40000000 are reserved for use by the calling firmware,
 	 * which may associate them with arbitrary types of RW firmware data
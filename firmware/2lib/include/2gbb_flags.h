@@ -88,6 +88,12 @@ enum vb2_gbb_flag {
 
 	/* Enable USB Device Controller */
 	VB2_GBB_FLAG_ENABLE_UDC = 1 << 16,
+
+	/*
+	 * Launch the diagnostics rom without showing the confirmation
+	 * screen or waiting for the power button.
+	 */
+	VB2_GBB_FLAG_HEADLESS_DIAGNOSTICS = 1 << 17,
 };
 
 #endif  /* VBOOT_REFERENCE_2GBB_FLAGS_H_ */
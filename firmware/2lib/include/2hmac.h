@@ -8,6 +8,61 @@
 
 #include <stdint.h>
 #include "2crypto.h"
+#include "2sha.h"
+
+/*
+ * Keyed HMAC context.  Holds the hash states after absorbing the inner and
+ * outer key pads, so many messages can be MACed under the same key without
+ * redoing the key schedule.
+ */
+struct vb2_hmac_context {
+	/* State after hashing (key ^ ipad) and (key ^ opad) */
+	struct vb2_digest_context inner;
+	struct vb2_digest_context outer;
+
+	/* Inner hash of the message in progress */
+	struct vb2_digest_context dc;
+};
+
+/**
+ * Initialize an HMAC context with a key.
+ *
+ * On success, the context is ready for vb2_hmac_update() of the first
+ * message.
+ *
+ * @param ctx		HMAC context to initialize
+ * @param alg		Hash algorithm ID
+ * @param key		HMAC key
+ * @param key_size	HMAC key size
+ * @return 0 on success, -1 on error.
+ */
+int vb2_hmac_init_key(struct vb2_hmac_context *ctx,
+		      enum vb2_hash_algorithm alg,
+		      const void *key, uint32_t key_size);
+
+/**
+ * Add data to the message being MACed.
+ *
+ * @param ctx		HMAC context
+ * @param msg		Message data; hashed in place
+ * @param msg_size	Size of message data
+ * @return 0 on success, -1 on error.
+ */
+int vb2_hmac_update(struct vb2_hmac_context *ctx,
+		    const void *msg, uint32_t msg_size);
+
+/**
+ * Finish the message and compute its HMAC.
+ *
+ * Afterwards the context is ready for the next message under the same key.
+ *
+ * @param ctx		HMAC context
+ * @param mac		Computed message authentication code
+ * @param mac_size	Size of the buffer pointed by <mac>
+ * @return 0 on success, -1 on error.
+ */
+int vb2_hmac_final(struct vb2_hmac_context *ctx,
+		   uint8_t *mac, uint32_t mac_size);
 
 /**
  * Compute HMAC
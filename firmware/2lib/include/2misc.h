@@ -188,4 +188,37 @@ vb2_error_t vb2_enable_developer_mode(struct vb2_context *ctx);
  */
 int vb2_allow_recovery(struct vb2_context *ctx);
 
+/**
+ * Record a boot-phase timestamp in the shared data.
+ *
+ * Keeps the last VB2_TIMESTAMP_COUNT records; see vb2_shared_data.timestamps.
+ * A VB2_TS_HASH_EXTEND straight after another one updates it in place, so
+ * hashing a body in many pieces doesn't push everything else out.
+ *
+ * @param ctx		Vboot context
+ * @param event		Event to record (enum vb2_timestamp_event)
+ */
+void vb2_record_timestamp(struct vb2_context *ctx,
+			  enum vb2_timestamp_event event);
+
+/**
+ * Drop change flags for spaces which match what storage already holds.
+ *
+ * Clears each VB2_CONTEXT_*_CHANGED flag for nvdata and secdata whose
+ * contents are back to their last committed value, so settings changed in
+ * several steps, or changed and restored, cost at most one write.
+ *
+ * @param ctx		Vboot context
+ */
+void vb2_drop_unchanged_data(struct vb2_context *ctx);
+
+/**
+ * Record spaces as committed after vb2ex_commit_data().
+ *
+ * @param ctx		Vboot context
+ * @param changed	Context flags which were set before the commit; spaces
+ *			whose flag has since been cleared are now in storage.
+ */
+void vb2_mark_data_committed(struct vb2_context *ctx, uint32_t changed);
+
 #endif  /* VBOOT_REFERENCE_2MISC_H_ */
@@ -128,6 +128,9 @@ enum vb2_nv_param {
 	VB2_NV_POST_EC_SYNC_DELAY,
 	/* Request booting of diagnostic rom.  0=no, 1=yes. */
 	VB2_NV_DIAG_REQUEST,
+
+	/* Number of params; must be last */
+	VB2_NV_PARAM_COUNT
 };
 
 /* Set default boot in developer mode */
@@ -218,6 +221,18 @@ void vb2_nv_init(struct vb2_context *ctx);
  */
 uint32_t vb2_nv_get(struct vb2_context *ctx, enum vb2_nv_param param);
 
+/**
+ * Read all non-volatile values at once.
+ *
+ * Equivalent to calling vb2_nv_get() for every param, but decodes the nvdata
+ * in a single pass.  Valid only after calling vb2_nv_init().
+ *
+ * @param ctx		Context pointer
+ * @param values	Destination for VB2_NV_PARAM_COUNT values, indexed by
+ *			enum vb2_nv_param.
+ */
+void vb2_nv_get_all(struct vb2_context *ctx, uint32_t *values);
+
 /**
  * Write a non-volatile value.
  *
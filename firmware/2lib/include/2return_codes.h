@@ -110,7 +110,7 @@ enum vb2_return_code {
 	VB2_ERROR_SHA_MISMATCH,
 
 	/**********************************************************************
-	 * RSA errors
+	 * RSA and ECDSA errors
 	 */
 	VB2_ERROR_RSA = VB2_ERROR_BASE + 0x020000,
 
@@ -138,6 +138,24 @@ enum vb2_return_code {
 	/* Bad size calculation in vb2_check_padding() */
 	VB2_ERROR_RSA_PADDING_SIZE,
 
+	/* Null param passed to vb2_ecdsa_verify_digest() */
+	VB2_ERROR_ECDSA_VERIFY_PARAM,
+
+	/* Bad algorithm in vb2_ecdsa_verify_digest() */
+	VB2_ERROR_ECDSA_VERIFY_ALGORITHM,
+
+	/* Public key not on the curve in vb2_ecdsa_verify_digest() */
+	VB2_ERROR_ECDSA_VERIFY_KEY,
+
+	/* Signature r or s out of range in vb2_ecdsa_verify_digest() */
+	VB2_ERROR_ECDSA_VERIFY_SIG,
+
+	/* Digest mismatch in vb2_ecdsa_verify_digest() */
+	VB2_ERROR_ECDSA_VERIFY_DIGEST,
+
+	/* Can't derive rr for a compact key in vb2_rsa_verify_digest() */
+	VB2_ERROR_RSA_VERIFY_KEY,
+
 	/**********************************************************************
 	 * NV storage errors
 	 */
@@ -375,6 +393,9 @@ enum vb2_return_code {
 	/* Null public key buffer passed to vb2_unpack_key_buffer() */
 	VB2_ERROR_UNPACK_KEY_BUFFER,
 
+	/* No hash to check in vb21_verify_hashes() */
+	VB2_ERROR_VDATA_NO_HASHES,
+
 	/**********************************************************************
 	 * Keyblock verification errors (all in vb2_verify_keyblock())
 	 */
@@ -625,6 +646,15 @@ enum vb2_return_code {
 	/* Problem with workbuf validity (see vb2api_init and vb2api_reinit) */
 	VB2_ERROR_WORKBUF_INVALID,
 
+	/* Work buffer too small for hash context in vb2_hash_vblock() */
+	VB2_ERROR_FW_VBLOCK_CACHE_WORKBUF,
+
+	/* Work buffer too small for GPT and subkey in LoadKernel() */
+	VB2_ERROR_LOAD_KERNEL_WORKBUF,
+
+	/* Work buffer too small for key hash in vb2_verify_kernel_vblock() */
+	VB2_ERROR_VBLOCK_WORKBUF,
+
 	/**********************************************************************
 	 * API-level errors
 	 */
@@ -709,6 +739,15 @@ enum vb2_return_code {
 	/* Digest buffer passed into vb2api_check_hash incorrect. */
 	VB2_ERROR_API_CHECK_DIGEST_SIZE,
 
+	/* Bad tag for the data passed to vb2api_extend_hash*() */
+	VB2_ERROR_API_EXTEND_HASH_TAG,
+
+	/* Chunk digest of the wrong size in vb2api_extend_hash_chunk_digest() */
+	VB2_ERROR_API_EXTEND_HASH_DIGEST_SIZE,
+
+	/* No other slot to fall back to in vb2api_fw_prepare_other_slot() */
+	VB2_ERROR_API_PREPARE_OTHER_SLOT,
+
 	/**********************************************************************
 	 * Errors which may be generated by implementations of vb2ex functions.
 	 * Implementation may also return its own specific errors, which should
@@ -743,6 +782,9 @@ enum vb2_return_code {
 	/* vb2ex function is unimplemented (stubbed in 2lib/2stub.c) */
 	VB2_ERROR_EX_UNIMPLEMENTED,
 
+	/* Auxiliary firmware update still in progress (non-fatal) */
+	VB2_ERROR_EX_AUXFW_BUSY,
+
 	/**********************************************************************
 	 * LoadKernel errors
 	 *
@@ -906,6 +948,21 @@ enum vb2_return_code {
 	/* Packed key with invalid version */
 	VB2_ERROR_PACKED_KEY_VERSION,
 
+	/* Unable to unpack EC key in vb2_private_key_unpack() */
+	VB2_ERROR_UNPACK_PRIVATE_KEY_EC,
+
+	/* Unable to create EC data in vb2_private_key_write() */
+	VB2_ERROR_PRIVATE_KEY_WRITE_EC,
+
+	/* Unable to reopen the PKCS#11 session in pkcs11_sign() */
+	VB2_ERROR_PKCS11_SESSION,
+
+	/* Bad signature buffer size in pkcs11_sign() */
+	VB2_ERROR_PKCS11_SIG_SIZE,
+
+	/* The PKCS#11 module failed to sign in pkcs11_sign() */
+	VB2_ERROR_PKCS11_SIGN,
+
 	/**********************************************************************
 	 * Errors generated by host library signature functions
 	 */
@@ -947,6 +1004,9 @@ enum vb2_return_code {
 	/* Not enough buffer space to hold signature in vb2_sign_object() */
 	VB2_SIGN_OBJECT_OVERFLOW,
 
+	/* ECDSA signing failed in vb2_sign_data() */
+	VB2_SIGN_DATA_ECDSA_SIGN,
+
 	/**********************************************************************
 	 * Errors generated by host library keyblock functions
 	 */
@@ -964,6 +1024,12 @@ enum vb2_return_code {
 	/* Unable to sign keyblock in vb2_create_keyblock() */
 	VB2_KEYBLOCK_CREATE_SIGN,
 
+	/* Buffer too small in vb2_create_keyblock_in() */
+	VB2_KEYBLOCK_CREATE_BUF_SIZE,
+
+	/* Unable to hash keyblock in vb2_create_keyblock_in() */
+	VB2_KEYBLOCK_CREATE_HASH,
+
 	/**********************************************************************
 	 * Errors generated by host library firmware preamble functions
 	 */
@@ -978,6 +1044,24 @@ enum vb2_return_code {
 	/* Unable to sign preamble in vb2_create_fw_preamble() */
 	VB2_FW_PREAMBLE_CREATE_SIGN,
 
+	/* Buffer too small in vb2_create_fw_preamble_in() */
+	VB2_FW_PREAMBLE_CREATE_BUF_SIZE,
+
+	/* Unable to copy kernel subkey in vb2_create_fw_preamble_in() */
+	VB2_FW_PREAMBLE_CREATE_SUBKEY,
+
+	/* Unable to copy body signature in vb2_create_fw_preamble_in() */
+	VB2_FW_PREAMBLE_CREATE_BODY_SIG,
+
+	/* Buffer too small in vb2_create_kernel_preamble_in() */
+	VB2_KERNEL_PREAMBLE_CREATE_BUF_SIZE,
+
+	/* Unable to copy body signature in vb2_create_kernel_preamble_in() */
+	VB2_KERNEL_PREAMBLE_CREATE_BODY_SIG,
+
+	/* Unable to sign preamble in vb2_create_kernel_preamble_in() */
+	VB2_KERNEL_PREAMBLE_CREATE_SIGN,
+
 	/**********************************************************************
 	 * Errors generated by unit test functions
 	 */
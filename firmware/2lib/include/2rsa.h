@@ -17,7 +17,7 @@ struct vb2_public_key {
 	uint32_t arrsize;    /* Length of n[] and rr[] in number of uint32_t */
 	uint32_t n0inv;      /* -1 / n[0] mod 2^32 */
 	const uint32_t *n;   /* Modulus as little endian array */
-	const uint32_t *rr;  /* R^2 as little endian array */
+	const uint32_t *rr;  /* R^2 as little endian array, NULL if compact */
 	enum vb2_signature_algorithm sig_alg;	/* Signature algorithm */
 	enum vb2_hash_algorithm hash_alg;	/* Hash algorithm */
 	const char *desc;			/* Description */
@@ -52,8 +52,22 @@ uint32_t vb2_rsa_sig_size(enum vb2_signature_algorithm sig_alg);
  */
 uint32_t vb2_packed_key_size(enum vb2_signature_algorithm sig_alg);
 
-/* Size of work buffer sufficient for vb2_rsa_verify_digest() worst case */
-#define VB2_VERIFY_RSA_DIGEST_WORKBUF_BYTES (3 * 1024)
+/**
+ * Return the size of a compact pre-processed RSA public key.
+ *
+ * Compact keys hold only n and n0inv; rr is left out to halve the key and is
+ * derived from n at verification time.  Unpacking such a key leaves rr NULL.
+ *
+ * @param sig_alg	Signature algorithm
+ * @return The size of the compact key in bytes, or 0 if error.
+ */
+uint32_t vb2_packed_key_compact_size(enum vb2_signature_algorithm sig_alg);
+
+/*
+ * Size of work buffer sufficient for vb2_rsa_verify_digest() worst case,
+ * which is an 8192-bit compact key.
+ */
+#define VB2_VERIFY_RSA_DIGEST_WORKBUF_BYTES (4 * 1024)
 
 /**
  * Verify a RSA PKCS1.5 signature against an expected hash digest.
@@ -68,4 +82,33 @@ vb2_error_t vb2_rsa_verify_digest(const struct vb2_public_key *key,
 				  uint8_t *sig, const uint8_t *digest,
 				  const struct vb2_workbuf *wb);
 
+/*
+ * Size of scratch buffer sufficient for vb2_rsa_verify_digest_scratch() with
+ * a signature of sig_size bytes, as returned by vb2_rsa_sig_size().
+ */
+#define VB2_RSA_VERIFY_SCRATCH_BYTES(sig_size) (3 * (sig_size))
+
+/* Same, for a compact key, which also needs room to rebuild rr[] */
+#define VB2_RSA_VERIFY_COMPACT_SCRATCH_BYTES(sig_size) (4 * (sig_size))
+
+/**
+ * Verify a RSA PKCS1.5 signature using a caller-provided scratch buffer.
+ *
+ * Same as vb2_rsa_verify_digest(), for callers which don't keep a work
+ * buffer and would rather use a fixed-size static or stack buffer.
+ *
+ * @param key		Key to use in signature verification
+ * @param sig		Signature to verify (destroyed in process)
+ * @param digest	Digest of signed data
+ * @param scratch	Scratch buffer, aligned to VB2_WORKBUF_ALIGN and at
+ *			least VB2_RSA_VERIFY_SCRATCH_BYTES() long, or
+ *			VB2_RSA_VERIFY_COMPACT_SCRATCH_BYTES() if key->rr
+ *			is NULL
+ * @param scratch_size	Size of scratch buffer in bytes
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+vb2_error_t vb2_rsa_verify_digest_scratch(const struct vb2_public_key *key,
+					  uint8_t *sig, const uint8_t *digest,
+					  void *scratch, uint32_t scratch_size);
+
 #endif  /* VBOOT_REFERENCE_2RSA_H_ */
@@ -0,0 +1,40 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Private declarations shared between the RSA verification code and the
+ * vectorized modular exponentiation.  Not for use outside 2lib.
+ */
+
+#ifndef VBOOT_REFERENCE_2RSA_PRIVATE_H_
+#define VBOOT_REFERENCE_2RSA_PRIVATE_H_
+
+#include "2sysincludes.h"
+
+struct vb2_public_key;
+
+/**
+ * Return the work buffer size needed by vb2_modpow_simd().
+ *
+ * This is larger than the 3 * key size needed by the scalar code, since the
+ * operands are stored in radix 2^26 and the accumulator uses 64-bit words.
+ *
+ * @param key		Key to use in signing
+ * @return The size in bytes.
+ */
+uint32_t vb2_modpow_simd_workbuf_size(const struct vb2_public_key *key);
+
+/**
+ * In-place public exponentiation using general purpose vector instructions.
+ * Only built when RSA_SIMD is set.
+ *
+ * @param key		Key to use in signing
+ * @param inout		Input and output big-endian byte array
+ * @param workbuf	Work buffer; caller must verify this is at least
+ *			vb2_modpow_simd_workbuf_size() bytes, 8-byte aligned
+ * @param exp		RSA public exponent: either 65537 (F4) or 3
+ */
+void vb2_modpow_simd(const struct vb2_public_key *key, uint8_t *inout,
+		     void *workbuf, int exp);
+
+#endif  /* VBOOT_REFERENCE_2RSA_PRIVATE_H_ */
@@ -95,6 +95,9 @@ struct vb2_digest_context {
 
 	/* 1 if digest is computed with vb2ex_hwcrypto routines, else 0 */
 	int using_hwcrypto;
+
+	/* 1 if a vb2ex_hwcrypto_digest_extend_async() call is outstanding */
+	int hwcrypto_pending;
 };
 
 /*
@@ -258,6 +261,61 @@ vb2_error_t vb2_digest_buffer(const uint8_t *buf, uint32_t size,
 			      enum vb2_hash_algorithm hash_alg, uint8_t *digest,
 			      uint32_t digest_size);
 
+/* One buffer to hash with vb2_digest_buffers_multi() */
+struct vb2_digest_job {
+	/* Data to hash */
+	const uint8_t *buf;
+	uint32_t size;
+	enum vb2_hash_algorithm hash_alg;
+
+	/* Destination for digest; at least vb2_digest_size(hash_alg) bytes */
+	uint8_t *digest;
+	uint32_t digest_size;
+};
+
+/**
+ * Calculate the digests of several independent buffers.
+ *
+ * Produces the same results as calling vb2_digest_buffer() on each job, but
+ * SHA-256 jobs are hashed several at a time in interleaved vector lanes.
+ * Other algorithms are hashed one after another.
+ *
+ * @param jobs		Buffers to hash and where to store their digests
+ * @param count		Number of entries in jobs
+ * @return VB2_SUCCESS, or the first error encountered.  On error, digests for
+ * some of the jobs may not have been stored.
+ */
+vb2_error_t vb2_digest_buffers_multi(const struct vb2_digest_job *jobs,
+				     uint32_t count);
+
+/*
+ * Tree hashing.  Data is split into VB2_TREE_HASH_CHUNK_SIZE chunks (the last
+ * may be shorter), each chunk is hashed on its own, and the root digest is the
+ * hash of all of the chunk digests concatenated in order.  The chunks may be
+ * hashed in any order or in parallel.  Empty data has no chunks, so its root
+ * digest is the hash of nothing.
+ */
+#define VB2_TREE_HASH_CHUNK_SIZE 0x10000
+
+/* Number of tree hash chunks covering size bytes of data */
+#define VB2_TREE_HASH_CHUNKS(size) \
+	(((uint64_t)(size) + VB2_TREE_HASH_CHUNK_SIZE - 1) / \
+	 VB2_TREE_HASH_CHUNK_SIZE)
+
+/**
+ * Calculate the tree hash root digest of a buffer.
+ *
+ * @param buf		Data to hash
+ * @param size		Length of data in bytes
+ * @param hash_alg	Hash algorithm, used for both chunks and root
+ * @param digest	Destination for root digest
+ * @param digest_size	Length of digest buffer in bytes.
+ * @return VB2_SUCCESS, or non-zero on error.
+ */
+vb2_error_t vb2_digest_tree_buffer(const uint8_t *buf, uint32_t size,
+				   enum vb2_hash_algorithm hash_alg,
+				   uint8_t *digest, uint32_t digest_size);
+
 /**
  * Fill a vb2_hash structure with the hash of a buffer.
  *
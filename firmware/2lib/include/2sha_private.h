@@ -0,0 +1,124 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Private declarations shared between the portable SHA code and the
+ * architecture-specific transform backends.  Not for use outside 2lib.
+ */
+
+#ifndef VBOOT_REFERENCE_2SHA_PRIVATE_H_
+#define VBOOT_REFERENCE_2SHA_PRIVATE_H_
+
+#include "2sysincludes.h"
+
+/* Round constants, defined in 2sha256.c and 2sha512.c */
+extern const uint32_t vb2_sha256_k[64];
+extern const uint64_t vb2_sha512_k[80];
+
+/*
+ * At most one accelerated SHA-256 backend may be selected at build time.  The
+ * target CPU must implement the instructions; there is no runtime check.
+ *
+ * Host builds without either flag use SHA_RUNTIME_DISPATCH instead, which
+ * compiles in every backend the architecture has and picks one from the CPU
+ * features on first use.
+ */
+#if defined(X86_SHA_EXT) && defined(ARMV8_CRYPTO_EXT)
+#error "X86_SHA_EXT and ARMV8_CRYPTO_EXT are mutually exclusive"
+#endif
+
+#if defined(X86_SHA_EXT)
+#define VB2_SHA256_TRANSFORM vb2_sha256_transform_ext
+#define VB2_SHA256_TRANSFORM_EXT 1
+#define VB2_SHA256_BACKEND_NAME "x86 SHA extensions"
+#elif defined(ARMV8_CRYPTO_EXT)
+#define VB2_SHA256_TRANSFORM vb2_sha256_transform_ext
+#define VB2_SHA256_TRANSFORM_EXT 1
+#define VB2_SHA256_BACKEND_NAME "ARMv8 crypto extensions"
+#elif defined(SHA_RUNTIME_DISPATCH)
+#define VB2_SHA256_TRANSFORM (vb2_sha_get_dispatch()->sha256_transform)
+#define VB2_SHA256_TRANSFORM_EXT \
+	(VB2_SHA256_TRANSFORM != vb2_sha256_transform_c)
+#define VB2_SHA256_BACKEND_NAME (vb2_sha_get_dispatch()->sha256_name)
+#else
+#define VB2_SHA256_TRANSFORM vb2_sha256_transform_c
+#define VB2_SHA256_TRANSFORM_EXT 0
+#define VB2_SHA256_BACKEND_NAME "portable C"
+#endif
+
+/**
+ * Run the SHA-256 compression function over whole blocks in portable C.
+ * Not built when X86_SHA_EXT or ARMV8_CRYPTO_EXT is set.
+ *
+ * @param h		Hash state (8 words), updated in place
+ * @param message	Data to hash; need not be aligned
+ * @param block_nb	Number of VB2_SHA256_BLOCK_SIZE blocks in message
+ */
+void vb2_sha256_transform_c(uint32_t *h, const uint8_t *message,
+			    unsigned int block_nb);
+
+/**
+ * Run the SHA-256 compression function over whole blocks using CPU SHA
+ * instructions.  Only built when X86_SHA_EXT or ARMV8_CRYPTO_EXT is set, or
+ * for SHA_RUNTIME_DISPATCH on a supported architecture.
+ *
+ * @param h		Hash state (8 words), updated in place
+ * @param message	Data to hash; need not be aligned
+ * @param block_nb	Number of VB2_SHA256_BLOCK_SIZE blocks in message
+ */
+void vb2_sha256_transform_ext(uint32_t *h, const uint8_t *message,
+			      unsigned int block_nb);
+
+/*
+ * Transforms chosen at runtime.  SHA-1 has a single implementation and the
+ * SHA-512 vector schedule only needs the architecture baseline, so for now
+ * only SHA-256 has an entry.
+ */
+struct vb2_sha_dispatch {
+	void (*sha256_transform)(uint32_t *h, const uint8_t *message,
+				 unsigned int block_nb);
+	const char *sha256_name;
+};
+
+/**
+ * Return the transforms to use on this CPU.  The CPU is only probed on the
+ * first call; later calls return the cached table.  Only built for
+ * SHA_RUNTIME_DISPATCH.
+ */
+const struct vb2_sha_dispatch *vb2_sha_get_dispatch(void);
+
+/* Number of independent messages hashed by vb2_sha256_transform_x4() */
+#define VB2_SHA256_LANES 4
+
+/**
+ * Run the SHA-256 compression function over VB2_SHA256_LANES independent
+ * messages at once, one per vector lane.
+ *
+ * @param h		Hash states (8 words each), updated in place
+ * @param message	Data to hash for each lane
+ * @param block_nb	Number of VB2_SHA256_BLOCK_SIZE blocks to hash from
+ *			every lane
+ */
+void vb2_sha256_transform_x4(uint32_t *const h[VB2_SHA256_LANES],
+			     const uint8_t *const message[VB2_SHA256_LANES],
+			     unsigned int block_nb);
+
+#ifdef SHA512_SIMD
+#define VB2_SHA512_BACKEND_NAME "multi-block SIMD schedule"
+#else
+#define VB2_SHA512_BACKEND_NAME "portable C"
+#endif
+
+/**
+ * Run the SHA-512 compression function over whole blocks, keeping the state
+ * in registers between blocks and computing the message schedule with vector
+ * instructions.  Only built when SHA512_SIMD is set.
+ *
+ * @param h		Hash state (8 words), updated in place
+ * @param message	Data to hash; need not be aligned
+ * @param block_nb	Number of VB2_SHA512_BLOCK_SIZE blocks in message
+ */
+void vb2_sha512_transform_ext(uint64_t *h, const uint8_t *message,
+			      unsigned int block_nb);
+
+#endif  /* VBOOT_REFERENCE_2SHA_PRIVATE_H_ */
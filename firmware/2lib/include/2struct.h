@@ -57,6 +57,12 @@ enum vb2_shared_data_flags {
 
 	/* Display is available on this boot */
 	VB2_SD_FLAG_DISPLAY_AVAILABLE = (1 << 8),
+
+	/* Firmware vblock matched vb2ex_read_vblock_cache() */
+	VB2_SD_FLAG_VBLOCK_CACHED = (1 << 9),
+
+	/* Vblock cache is implemented; vblock_keyblock_digest is valid */
+	VB2_SD_FLAG_VBLOCK_CACHE_ENABLED = (1 << 10),
 };
 
 /* Flags for vb2_shared_data.status */
@@ -82,14 +88,55 @@ enum vb2_shared_data_status {
 	/* EC Sync completed successfully */
 	VB2_SD_STATUS_EC_SYNC_COMPLETE = (1 << 6),
 
+	/*
+	 * vb2_shared_data.committed_* holds what is in storage for the
+	 * matching space, so vb2_commit_data() can skip rewriting it.
+	 */
+	VB2_SD_STATUS_NV_SNAPSHOT = (1 << 7),
+	VB2_SD_STATUS_SECDATA_FIRMWARE_SNAPSHOT = (1 << 8),
+	VB2_SD_STATUS_SECDATA_KERNEL_SNAPSHOT = (1 << 9),
 };
 
+/*
+ * Events for vb2_shared_data.timestamps.  Each is recorded as the step
+ * finishes, except the *_START events, so the time spent in a step is the
+ * difference from the previous record.  Values are exported to the OS, so
+ * don't renumber them.
+ */
+enum vb2_timestamp_event {
+	VB2_TS_NONE = 0,
+	VB2_TS_FW_PHASE1_START = 1,
+	VB2_TS_FW_PHASE2_START = 2,
+	VB2_TS_FW_PHASE3_START = 3,
+	VB2_TS_FW_KEYBLOCK_VERIFIED = 4,
+	VB2_TS_FW_PREAMBLE_VERIFIED = 5,
+	VB2_TS_HASH_INIT = 6,
+	/* Consecutive extends share one record, timed at the last of them */
+	VB2_TS_HASH_EXTEND = 7,
+	VB2_TS_HASH_FINALIZE = 8,
+	VB2_TS_KERNEL_VBLOCK_VERIFIED = 9,
+	VB2_TS_KERNEL_BODY_READ = 10,
+	VB2_TS_KERNEL_BODY_VERIFIED = 11,
+	VB2_TS_KERNEL_GPT_READ = 12,
+};
+
+/* Size of the digest kept by vb2ex_read/write_vblock_cache() (SHA-256) */
+#define VB2_VBLOCK_CACHE_DIGEST_SIZE 32
+
+/* Number of records in the vb2_shared_data.timestamps ring */
+#define VB2_TIMESTAMP_COUNT 16
+
+struct vb2_timestamp {
+	uint32_t event;		/* enum vb2_timestamp_event */
+	uint32_t time_us;	/* From vb2ex_utime() */
+} __attribute__((packed));
+
 /* "V2SD" = vb2_shared_data.magic */
 #define VB2_SHARED_DATA_MAGIC 0x44533256
 
 /* Current version of vb2_shared_data struct */
 #define VB2_SHARED_DATA_VERSION_MAJOR 2
-#define VB2_SHARED_DATA_VERSION_MINOR 0
+#define VB2_SHARED_DATA_VERSION_MINOR 4
 
 #define VB2_CONTEXT_MAX_SIZE 192
 
@@ -244,6 +291,54 @@ struct vb2_shared_data {
 	 */
 	uint32_t kernel_key_offset;
 	uint32_t kernel_key_size;
+
+	/**********************************************************************
+	 * Fields added in version 2.1.
+	 */
+
+	/*
+	 * Boot-phase timestamps, as a ring of the last VB2_TIMESTAMP_COUNT
+	 * records.  timestamp_count is the number recorded so far, so once
+	 * the ring wraps the oldest is at timestamp_count % VB2_TIMESTAMP_COUNT.
+	 */
+	uint32_t timestamp_count;
+	struct vb2_timestamp timestamps[VB2_TIMESTAMP_COUNT];
+
+	/**********************************************************************
+	 * Fields added in version 2.2.
+	 */
+
+	/*
+	 * Verified-vblock cache.  keyblock_digest covers the firmware slot,
+	 * root key and keyblock; the cached digest extends that with the
+	 * preamble.  vblock_cached_digest is only valid if
+	 * VB2_SD_FLAG_VBLOCK_CACHED is set.
+	 */
+	uint8_t vblock_keyblock_digest[VB2_VBLOCK_CACHE_DIGEST_SIZE];
+	uint8_t vblock_cached_digest[VB2_VBLOCK_CACHE_DIGEST_SIZE];
+
+	/**********************************************************************
+	 * Fields added in version 2.3.
+	 */
+
+	/*
+	 * Least free workbuf space seen since vb2api_init() or the last
+	 * vb2api_reset_workbuf_peak(); see vb2api_get_workbuf_peak().
+	 */
+	uint32_t workbuf_min_free;
+
+	/**********************************************************************
+	 * Fields added in version 2.4.
+	 */
+
+	/*
+	 * Contents last read from or written to storage, valid when the
+	 * matching VB2_SD_STATUS_*_SNAPSHOT flag is set.  A space changed and
+	 * then changed back compares equal and isn't written again.
+	 */
+	uint8_t committed_nvdata[VB2_NVDATA_SIZE_V2];
+	uint8_t committed_secdata_firmware[VB2_SECDATA_FIRMWARE_SIZE];
+	uint8_t committed_secdata_kernel[VB2_SECDATA_KERNEL_SIZE];
 } __attribute__((packed));
 
 /****************************************************************************/
@@ -258,6 +353,7 @@ struct vb2_shared_data {
 #define VB2_GBB_XOR_SIGNATURE { 0x0e, 0x6d, 0x68, 0x68 }
 
 #define VB2_GBB_HWID_DIGEST_SIZE 32
+#define VB2_GBB_KEY_DIGEST_SIZE 20
 
 /* VB2 GBB struct version */
 #define VB2_GBB_MAJOR_VER 1
@@ -287,8 +383,18 @@ struct vb2_gbb_header {
 	/* Added in version 1.2 */
 	uint8_t  hwid_digest[VB2_GBB_HWID_DIGEST_SIZE];	/* SHA-256 of HWID */
 
+	/*
+	 * SHA-1 of the root and recovery key data, recorded by host tools
+	 * when they set the keys so key identity can be read instead of
+	 * computed.  All zeros if not recorded.  Other tools may replace the
+	 * keys without updating these, so check them against the keys before
+	 * relying on them for anything but display.  Firmware ignores them.
+	 */
+	uint8_t  rootkey_sha1[VB2_GBB_KEY_DIGEST_SIZE];
+	uint8_t  recovery_key_sha1[VB2_GBB_KEY_DIGEST_SIZE];
+
 	/* Pad to match EXPECTED_VB2_GBB_HEADER_SIZE.  Initialize to 0. */
-	uint8_t  pad[48];
+	uint8_t  pad[8];
 } __attribute__((packed));
 
 #define EXPECTED_VB2_GBB_HEADER_SIZE 128
@@ -468,6 +574,11 @@ struct vb2_keyblock {
 #define VB2_FIRMWARE_PREAMBLE_USE_RO_NORMAL 0x00000001
 /* Do not allow use of any hardware crypto accelerators. */
 #define VB2_FIRMWARE_PREAMBLE_DISALLOW_HWCRYPTO 0x00000002
+/*
+ * Body signature covers the tree hash root digest of the body rather than the
+ * digest of the body itself.  See VB2_TREE_HASH_CHUNK_SIZE in 2sha.h.
+ */
+#define VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH 0x00000004
 
 /* Premable block for rewritable firmware, vboot1 version 2.1.
  *
@@ -536,6 +647,8 @@ _Static_assert(EXPECTED_VB2_FW_PREAMBLE_SIZE == sizeof(struct vb2_fw_preamble),
 #define VB2_KERNEL_PREAMBLE_KERNEL_TYPE_BOOTIMG   1
 #define VB2_KERNEL_PREAMBLE_KERNEL_TYPE_MULTIBOOT 2
 /* Kernel type 3 is reserved for future use */
+/* Kernel body must be hashed in software, not with vb2ex_hwcrypto_*() */
+#define VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO     0x00000004
 
 /*
  * Preamble block for kernel, version 2.2
@@ -0,0 +1,89 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Optional call and cycle counts for hot paths.
+ */
+
+#ifndef VBOOT_REFERENCE_2TRACE_H_
+#define VBOOT_REFERENCE_2TRACE_H_
+
+#include "2api.h"
+#include "2sysincludes.h"
+
+/*
+ * Build with VB2_TRACE=1 to count the calls to each trace point below, and
+ * the cycles spent in them as read by vb2ex_cycle_counter().  Otherwise the
+ * trace macros compile to nothing.
+ */
+#ifndef VB2_TRACE
+#define VB2_TRACE 0
+#endif
+
+enum vb2_trace_point {
+	VB2_TRACE_SHA256_TRANSFORM = 0,
+	VB2_TRACE_MONTMUL,
+	VB2_TRACE_CRC32,
+	VB2_TRACE_SAFE_MEMCMP,
+	VB2_TRACE_POINT_COUNT
+};
+
+struct vb2_trace_counter {
+	const char *name;
+	uint32_t calls;
+	uint64_t cycles;
+};
+
+#if VB2_TRACE
+
+/*
+ * Time the code between VB2_TRACE_BEGIN(point) and VB2_TRACE_END(point), where
+ * point is a vb2_trace_point without its VB2_TRACE_ prefix.  BEGIN declares a
+ * variable, so it must go where a declaration may, and at most once per point
+ * in a block.
+ */
+#define VB2_TRACE_BEGIN(point) \
+	const uint64_t vb2_trace_start_##point = vb2ex_cycle_counter()
+#define VB2_TRACE_END(point) \
+	vb2_trace_record(VB2_TRACE_##point, vb2_trace_start_##point)
+
+/**
+ * Add one call, from start until now, to a trace point.
+ *
+ * @param point		Trace point
+ * @param start		vb2ex_cycle_counter() at the start of the call
+ */
+void vb2_trace_record(enum vb2_trace_point point, uint64_t start);
+
+/**
+ * Return the counts for a trace point, or NULL if it isn't one.
+ */
+const struct vb2_trace_counter *vb2_trace_get(enum vb2_trace_point point);
+
+/**
+ * Zero the counts for all the trace points.
+ */
+void vb2_trace_reset(void);
+
+/**
+ * Print the counts for all the trace points through vb2ex_printf().
+ */
+void vb2_trace_dump(void);
+
+#else
+
+#define VB2_TRACE_BEGIN(point) do {} while (0)
+#define VB2_TRACE_END(point) do {} while (0)
+
+static inline const struct vb2_trace_counter *vb2_trace_get(
+		enum vb2_trace_point point)
+{
+	return NULL;
+}
+
+static inline void vb2_trace_reset(void) {}
+static inline void vb2_trace_dump(void) {}
+
+#endif  /* VB2_TRACE */
+
+#endif  /* VBOOT_REFERENCE_2TRACE_H_ */
@@ -69,6 +69,9 @@ enum {
 /* If this bit is 1, the GPT is stored in another from the streaming data */
 #define GPT_FLAG_EXTERNAL	0x1
 
+/* Most kernel entries GptNextKernelEntry() can walk; MAX_NUMBER_OF_ENTRIES */
+#define GPT_MAX_KERNEL_ENTRIES	128
+
 /*
  * A note about stored_on_device and gpt_drive_sectors:
  *
@@ -114,6 +117,12 @@ typedef struct {
 	/* Internal variables */
 	uint8_t valid_headers, valid_entries, ignored;
 	int current_priority;
+	/*
+	 * Bootable kernel entries not yet returned by GptNextKernelEntry(),
+	 * in boot order.  kernel_order[kernel_order_next] is the next one.
+	 */
+	uint8_t kernel_order[GPT_MAX_KERNEL_ENTRIES];
+	uint8_t kernel_order_count, kernel_order_next;
 } GptData;
 
 /**
@@ -159,8 +168,34 @@ GptEntry *GptFindNthEntry(GptData *gpt, const Guid *guid, unsigned int n);
  */
 int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata);
 
+/**
+ * Allocate GPT data buffers and fill them from the copy cached for the drive.
+ *
+ * The sector_bytes, drive_sectors and flags fields should be filled on input,
+ * and must match those the data was cached with.  The copy is only used if
+ * both headers on the drive still match it.  On success, gptdata is as if
+ * AllocAndReadGptData() and GptInit() had both succeeded.
+ *
+ * Returns 0 if successful, 1 if there is no usable cached copy.
+ */
+int GptCacheLookup(VbExDiskHandle_t disk_handle, GptData *gptdata);
+
+/**
+ * Cache a copy of GPT data which has passed GptInit(), for GptCacheLookup().
+ *
+ * Data with unwritten modifications isn't cached.
+ */
+void GptCacheStore(VbExDiskHandle_t disk_handle, const GptData *gptdata);
+
+/**
+ * Drop the cached GPT data for a drive, or for all drives if NULL.
+ */
+void GptCacheInvalidate(VbExDiskHandle_t disk_handle);
+
 /**
  * Write any changes for the GPT data back to the drive, then free the buffers.
+ *
+ * Writing changes invalidates any cached copy of the drive's GPT data.
  */
 int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata);
 
@@ -45,6 +45,25 @@ uint32_t TlclSendReceive(const uint8_t *request, uint8_t *response,
  */
 int TlclPacketSize(const uint8_t *packet);
 
+/* Latency of one TPM command code, since TlclLibInit() */
+struct tlcl_command_stats {
+	uint32_t command;	/* TPM command code */
+	uint32_t count;		/* Times sent */
+	uint32_t total_us;	/* Total time in VbExTpmSendReceive() */
+	uint32_t max_us;	/* Longest single send/receive */
+};
+
+/* Number of distinct command codes TlclGetCommandStats() tracks */
+#define TLCL_MAX_COMMAND_STATS 16
+
+/**
+ * Return latency stats for each command code sent since TlclLibInit(), in the
+ * order first sent, and set [count] to the number of entries.  Codes beyond
+ * the first TLCL_MAX_COMMAND_STATS aren't tracked.  Builds with
+ * TPM_NO_COMMAND_STATS return no entries.
+ */
+const struct tlcl_command_stats *TlclGetCommandStats(int *count);
+
 /* Commands */
 
 /**
@@ -74,7 +93,11 @@ uint32_t TlclResume(void);
 uint32_t TlclSelfTestFull(void);
 
 /**
- * Run the self test in the background.
+ * Run the self test in the background.  Call this as early as possible, such
+ * as right after TlclStartup(), so the self test runs while firmware is being
+ * verified; a later command that finds it still running then only waits for
+ * the rest of it, rather than starting it again.  The TPM error code is
+ * returned.
  */
 uint32_t TlclContinueSelfTest(void);
 
@@ -119,6 +142,24 @@ uint32_t TlclWrite(uint32_t index, const void *data, uint32_t length);
  */
 uint32_t TlclRead(uint32_t index, void *data, uint32_t length);
 
+/* One space for TlclReadSpaces() to read */
+struct tlcl_nv_read {
+	uint32_t index;		/* Space to read */
+	void *data;		/* Where to put [length] bytes of it */
+	uint32_t length;
+	uint32_t *permissions;	/* If not NULL, gets the space's permissions */
+	uint32_t result;	/* Set to the TPM error code for this space */
+};
+
+/**
+ * Read each of [count] spaces in [reads], and their permissions if asked.  The
+ * reads are issued back to back, for callers such as early firmware which load
+ * several spaces together; the TPM still takes one command at a time.  Each
+ * entry's result is set, and the first TPM error code is returned (0 if all
+ * reads succeed).
+ */
+uint32_t TlclReadSpaces(struct tlcl_nv_read *reads, int count);
+
 /**
  * Read PCR at [index] into [data].  [length] must be TPM_PCR_DIGEST or
  * larger. The TPM error code is returned.
@@ -203,7 +244,8 @@ uint32_t TlclGetFlags(uint8_t *disable, uint8_t *deactivated,
 uint32_t TlclSetGlobalLock(void);
 
 /**
- * Perform a TPM_Extend.
+ * Perform a TPM_Extend.  On TPM2 this extends the SHA-256 bank with a 32-byte
+ * |in_digest|, and |out_digest| is not filled in.
  */
 uint32_t TlclExtend(int pcr_num, const uint8_t *in_digest, uint8_t *out_digest);
 
@@ -225,6 +267,12 @@ uint32_t TlclGetSpaceInfo(uint32_t index, uint32_t *attributes, uint32_t *size,
 
 /**
  * Get the entire set of permanent flags.
+ *
+ * This and the other flag and ownership queries below remember what they
+ * read, and answer again without a round trip until a command other than a
+ * read or query is sent, or TlclLibInit() is called.  Firmware is the only
+ * user of the TPM while it runs, so that command is the only way the answer
+ * can change.
  */
 uint32_t TlclGetPermanentFlags(TPM_PERMANENT_FLAGS *pflags);
 
@@ -34,6 +34,7 @@ extern "C" {
 #define TPM2_NV_ReadPublic     ((TPM_CC)0x00000169)
 #define TPM2_GetCapability     ((TPM_CC)0x0000017A)
 #define TPM2_GetRandom         ((TPM_CC)0x0000017B)
+#define TPM2_PCR_Extend        ((TPM_CC)0x00000182)
 
 #define HR_SHIFT               24
 #define TPM_HT_NV_INDEX        0x01
@@ -68,6 +69,9 @@ extern "C" {
 #define TPM_ALG_SHA256			((TPM_ALG_ID)0x000B)
 #define TPM_ALG_NULL			((TPM_ALG_ID)0x0010)
 
+/* Digest size for TPM_ALG_SHA256. */
+#define TPM_SHA256_DIGEST_SIZE		32
+
 /* NV index attributes. */
 #define TPMA_NV_PPWRITE			((TPMA_NV)(1UL << 0))
 #define TPMA_NV_OWNERWRITE		((TPMA_NV)(1UL << 1))
@@ -211,6 +215,11 @@ struct tpm2_get_random_cmd {
 	uint16_t bytes_requested;
 };
 
+struct tpm2_pcr_extend_cmd {
+	TPM_HANDLE pcrHandle;
+	const uint8_t *digest;  /* TPM_SHA256_DIGEST_SIZE bytes */
+};
+
 struct tpm2_self_test_cmd {
 	TPMI_YES_NO full_test;
 };
@@ -141,6 +141,16 @@ void VbExSleepMs(uint32_t msec);
  */
 vb2_error_t VbExBeep(uint32_t msec, uint32_t frequency);
 
+/**
+ * Start a beep tone of the specified frequency in Hz, which the platform
+ * stops by itself after msec, and return without waiting for it.  Starting a
+ * new tone replaces any still playing.  Implementing this is optional.
+ *
+ * @return VB2_SUCCESS, or VB2_ERROR_EX_UNIMPLEMENTED if the platform can't
+ * play tones in the background, in which case VbExBeep() is used instead.
+ */
+vb2_error_t VbExBeepAsync(uint32_t msec, uint32_t frequency);
+
 /*****************************************************************************/
 /* TPM (from tlcl_stub.h) */
 
@@ -257,6 +267,18 @@ typedef struct VbDiskInfo {
 	 * not available.
 	 */
 	const char *name;
+	/*
+	 * Preferred size of a single read in bytes, for example the NVMe
+	 * maximum transfer size, or 0 if none.  Must be a multiple of
+	 * bytes_per_lba to be used.
+	 */
+	uint32_t io_size;
+	/*
+	 * Byte alignment from the start of the disk that reads shouldn't cross,
+	 * for example the eMMC erase group or UFS page size, or 0 if none.
+	 * Must be a multiple of bytes_per_lba to be used.
+	 */
+	uint32_t io_align;
 } VbDiskInfo;
 
 /**
@@ -287,6 +309,23 @@ vb2_error_t VbExDiskGetInfo(VbDiskInfo **infos_ptr, uint32_t *count,
 vb2_error_t VbExDiskFreeInfo(VbDiskInfo *infos,
 			     VbExDiskHandle_t preserve_handle);
 
+/**
+ * Hint that lba_count LBA sectors, starting at sector lba_start, will soon be
+ * read from the disk.
+ *
+ * vboot calls this for every candidate disk before it starts reading any of
+ * them, so a platform with asynchronous storage can start the reads on all
+ * the disks at once.  It is also called for the kernel partition which will
+ * be tried first while the developer screen counts down, which may be well
+ * before the partition is read, or not read at all.  The data is still read
+ * with VbExDiskRead() or VbExStreamRead() afterwards; this is only a hint,
+ * and may do nothing.
+ *
+ * Returns VB2_SUCCESS, or VB2_ERROR_EX_UNIMPLEMENTED if not supported.
+ */
+vb2_error_t VbExDiskPrefetch(VbExDiskHandle_t handle, uint64_t lba_start,
+			     uint64_t lba_count);
+
 /**
  * Read lba_count LBA sectors, starting at sector lba_start, from the disk,
  * into the buffer.
@@ -350,9 +389,60 @@ vb2_error_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
  */
 vb2_error_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer);
 
+/**
+ * Skip forward in a stream without reading
+ *
+ * @param stream	Stream to skip forward in
+ * @param bytes		Number of bytes to skip
+ *
+ * @return Error code, or VB2_SUCCESS.  Skipping past the end of the stream is
+ * an error.  Returns VB2_ERROR_EX_UNIMPLEMENTED if the stream can't skip, in
+ * which case the caller should read and discard the data instead.
+ *
+ * Must not be called while queued reads are outstanding.
+ */
+vb2_error_t VbExStreamSkip(VbExStream_t stream, uint32_t bytes);
+
+/* Maximum number of asynchronous reads outstanding on a stream at once */
+#define VB_STREAM_MAX_READS 4
+
+/**
+ * Queue an asynchronous read from a stream
+ *
+ * @param stream	Stream to read from
+ * @param bytes		Number of bytes to read
+ * @param buffer	Destination to read into; must stay valid until the
+ *			read has completed
+ *
+ * @return Error code, or VB2_SUCCESS if the read was queued.  Returns
+ * VB2_ERROR_EX_UNIMPLEMENTED if the stream only supports VbExStreamRead(),
+ * in which case the caller should fall back to that.
+ *
+ * Reads continue from where the previously queued read left off, and
+ * complete in the order they were queued.  Up to VB_STREAM_MAX_READS may be
+ * outstanding at once, which lets the device work on several requests while
+ * the caller processes earlier data.  A stream must not be used for both
+ * queued and blocking reads.
+ */
+vb2_error_t VbExStreamSubmitRead(VbExStream_t stream, uint32_t bytes,
+				 void *buffer);
+
+/**
+ * Wait for the oldest queued read on a stream to complete
+ *
+ * @param stream	Stream to wait on
+ *
+ * @return Error code from the read, or VB2_SUCCESS.  Failure to read as much
+ * data as requested is an error.
+ */
+vb2_error_t VbExStreamWaitRead(VbExStream_t stream);
+
 /**
  * Close a stream
  *
+ * Any queued reads which have not completed are cancelled or waited for, so
+ * their buffers may be reused once this returns.
+ *
  * @param stream	Stream to close
  */
 void VbExStreamClose(VbExStream_t stream);
@@ -483,6 +573,28 @@ vb2_error_t VbExDisplayMenu(uint32_t screen_type, uint32_t locale,
 			  uint32_t selected_index, uint32_t disabled_idx_mask,
 			  uint32_t redraw_base);
 
+/**
+ * Move the selection highlight of the menu screen already on display.
+ *
+ * Called instead of VbExDisplayMenu() when only the selected item of the
+ * current menu changed, so a display backend which caches the rendered screen
+ * can redraw just the two items involved.  Implementing this is optional.
+ *
+ * @param screen_type       ID of screen on display
+ * @param locale            language on display
+ * @param prev_index        Index of menu item that was selected.
+ * @param selected_index    Index of menu item that is now selected.
+ * @param disabled_idx_mask Bitmap of disabled menu items, unchanged since the
+ *                          menu was last drawn.
+ *
+ * @return VB2_SUCCESS, VB2_ERROR_EX_UNIMPLEMENTED to have the whole menu
+ * redrawn by VbExDisplayMenu() instead, or other error code on error.
+ */
+vb2_error_t VbExDisplayMenuSelection(uint32_t screen_type, uint32_t locale,
+				     uint32_t prev_index,
+				     uint32_t selected_index,
+				     uint32_t disabled_idx_mask);
+
 /**
  * Display a string containing debug information on the screen, rendered in a
  * platform-dependent font.  Should be able to handle newlines '\n' in the
@@ -590,6 +702,29 @@ uint32_t VbExKeyboardReadWithFlags(uint32_t *flags_ptr);
  */
 uint32_t VbExGetSwitches(uint32_t request_mask);
 
+/* Events reported by VbExWaitForEvent() */
+#define VB_EVENT_KEY		(1 << 0)  /* Key or button press pending */
+#define VB_EVENT_DISK		(1 << 1)  /* Removable disk inserted/removed */
+#define VB_EVENT_SHUTDOWN	(1 << 2)  /* Shutdown request pending */
+#define VB_EVENT_ALL		(VB_EVENT_KEY | VB_EVENT_DISK | \
+				 VB_EVENT_SHUTDOWN)
+
+/**
+ * Sleep until a UI event arrives or the timeout passes.
+ *
+ * Wake up early on a key or button press (anything VbExKeyboardRead() would
+ * report), on a removable disk being inserted or removed, or on a condition
+ * VbExIsShutdownRequested() would report.  Implementing this is optional.
+ *
+ * @param timeout_ms	Longest time to sleep
+ * @param events	Destination for VB_EVENT_* flags of the events which
+ *			arrived; 0 if the timeout passed.
+ *
+ * @return VB2_SUCCESS, VB2_ERROR_EX_UNIMPLEMENTED if the platform can't wait
+ * for events (callers then poll at a fixed interval), or other error code.
+ */
+vb2_error_t VbExWaitForEvent(uint32_t timeout_ms, uint32_t *events);
+
 /*****************************************************************************/
 /* Misc */
 
@@ -98,6 +98,8 @@ extern "C" {
 #define VBSD_DEPRECATED_EC_EFS           0x00080000
 /* NvStorage uses 64-byte record, not 16-byte */
 #define VBSD_NVDATA_V2                   0x00100000
+/* Diagnostics rom was launched without user confirmation */
+#define VBSD_HEADLESS_DIAGNOSTICS        0x00200000
 
 /* Result codes for VbSharedDataHeader.check_fw_a_result (and b_result) */
 #define VBSD_LF_CHECK_NOT_DONE          0
@@ -205,6 +207,35 @@ typedef struct VbSharedDataKernelCall {
 /* Number of kernel calls to track.  Must be power of 2. */
 #define VBSD_MAX_KERNEL_CALLS 4
 
+/* Throughput of loading one kernel partition, parallel to
+ * VbSharedDataKernelCall.parts[] */
+typedef struct VbSharedDataKernelPartStats {
+	uint32_t bytes_read;       /* Vblock and body bytes read */
+	uint32_t read_us;          /* Time waiting on reads */
+	uint32_t hash_us;          /* Time hashing the body */
+	uint32_t verify_us;        /* Time checking vblock and body signatures */
+} VbSharedDataKernelPartStats;
+
+/* Boot-phase timestamp, copied from vb2_shared_data.timestamps */
+typedef struct VbSharedDataTimestamp {
+	uint32_t event;            /* enum vb2_timestamp_event */
+	uint32_t time_us;          /* From vb2ex_utime() */
+} VbSharedDataTimestamp;
+
+/* Number of timestamps to track */
+#define VBSD_MAX_TIMESTAMPS 16
+
+/* Latency of one TPM command code, copied from TlclGetCommandStats() */
+typedef struct VbSharedDataTpmStats {
+	uint32_t command;          /* TPM command code */
+	uint32_t count;            /* Times sent */
+	uint32_t total_us;         /* Total send/receive time */
+	uint32_t max_us;           /* Longest single send/receive */
+} VbSharedDataTpmStats;
+
+/* Number of TPM command codes to track */
+#define VBSD_MAX_TPM_STATS 16
+
 /*
  * Data shared between LoadFirmware(), LoadKernel(), and OS.
  *
@@ -307,10 +338,42 @@ typedef struct VbSharedDataHeader {
 	uint32_t kernel_version_lowest;
 
 	/*
-	 * After read-only firmware which uses version 2 is released, any
+	 * Fields added in version 3.  Before accessing, make sure that
+	 * struct_version >= 3
+	 */
+	/* Number of timestamps in timestamps[], oldest first */
+	uint32_t timestamp_count;
+	/* Reserved for padding */
+	uint32_t reserved3;
+	/* Boot-phase timestamps from vb2_shared_data */
+	VbSharedDataTimestamp timestamps[VBSD_MAX_TIMESTAMPS];
+
+	/*
+	 * Fields added in version 4.  Before accessing, make sure that
+	 * struct_version >= 4
+	 */
+	/* Load throughput for each entry in lk_calls[].parts[] */
+	VbSharedDataKernelPartStats
+		lk_part_stats[VBSD_MAX_KERNEL_CALLS][VBSD_MAX_KERNEL_PARTS];
+
+	/*
+	 * Fields added in version 5.  Before accessing, make sure that
+	 * struct_version >= 5
+	 */
+	/*
+	 * TPM command latency, filled in by the firmware which owns the TPM
+	 * from TlclGetCommandStats() before handing this struct to the OS.
+	 */
+	uint32_t tpm_stats_count;
+	/* Reserved for padding */
+	uint32_t reserved5;
+	VbSharedDataTpmStats tpm_stats[VBSD_MAX_TPM_STATS];
+
+	/*
+	 * After read-only firmware which uses version 5 is released, any
 	 * additional fields must be added below, and the struct version must
 	 * be increased.  Before reading/writing those fields, make sure that
-	 * the struct being accessed is at least version 3.
+	 * the struct being accessed is at least version 6.
 	 *
 	 * It's always ok for an older firmware to access a newer struct, since
 	 * all the fields it knows about are present.  Newer firmware needs to
@@ -321,15 +384,30 @@ typedef struct VbSharedDataHeader {
 /* Size of VbSharedDataheader for each version */
 #define VB_SHARED_DATA_HEADER_SIZE_V1 1072
 #define VB_SHARED_DATA_HEADER_SIZE_V2 1096
+#define VB_SHARED_DATA_HEADER_SIZE_V3 1232
+#define VB_SHARED_DATA_HEADER_SIZE_V4 1744
+#define VB_SHARED_DATA_HEADER_SIZE_V5 2008
 
 _Static_assert(VB_SHARED_DATA_HEADER_SIZE_V1
 	       == offsetof(VbSharedDataHeader, recovery_reason),
 	       "VB_SHARED_DATA_HEADER_SIZE_V1 incorrect");
 
-_Static_assert(VB_SHARED_DATA_HEADER_SIZE_V2 == sizeof(VbSharedDataHeader),
+_Static_assert(VB_SHARED_DATA_HEADER_SIZE_V2
+	       == offsetof(VbSharedDataHeader, timestamp_count),
 	       "VB_SHARED_DATA_HEADER_SIZE_V2 incorrect");
 
-#define VB_SHARED_DATA_VERSION 2  /* Version for struct_version */
+_Static_assert(VB_SHARED_DATA_HEADER_SIZE_V3
+	       == offsetof(VbSharedDataHeader, lk_part_stats),
+	       "VB_SHARED_DATA_HEADER_SIZE_V3 incorrect");
+
+_Static_assert(VB_SHARED_DATA_HEADER_SIZE_V4
+	       == offsetof(VbSharedDataHeader, tpm_stats_count),
+	       "VB_SHARED_DATA_HEADER_SIZE_V4 incorrect");
+
+_Static_assert(VB_SHARED_DATA_HEADER_SIZE_V5 == sizeof(VbSharedDataHeader),
+	       "VB_SHARED_DATA_HEADER_SIZE_V5 incorrect");
+
+#define VB_SHARED_DATA_VERSION 5  /* Version for struct_version */
 
 #ifdef __cplusplus
 }
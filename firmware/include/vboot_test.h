@@ -28,5 +28,6 @@ vb2_error_t vb2_check_padding(const uint8_t *sig,
 
 struct LoadKernelParams;
 struct LoadKernelParams *VbApiKernelGetParams(void);
+void VbApiKernelResetRejectedDisks(void);
 
 #endif  /* VBOOT_REFERENCE_TEST_API_H_ */
@@ -12,6 +12,69 @@
 #include "utility.h"
 #include "vboot_api.h"
 
+_Static_assert(GPT_MAX_KERNEL_ENTRIES >= MAX_NUMBER_OF_ENTRIES,
+	       "kernel_order[] too small for the entries array");
+
+/*
+ * Build the list of kernels GptNextKernelEntry() still has to return: every
+ * kernel entry with the successful bit or tries left, highest priority first
+ * and ties in entry order.  Kernels at or before the current one in that
+ * order have already been returned and are left out.
+ */
+static void BuildKernelOrder(GptData *gpt)
+{
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+	GptEntry *entries = (GptEntry *)gpt->primary_entries;
+	GptEntry *e;
+	uint32_t kernel[GPT_ENTRY_MASK_WORDS];
+	uint32_t count = header->number_of_entries;
+	uint32_t slot[CGPT_ATTRIBUTE_MAX_PRIORITY + 1];
+	uint32_t total = 0;
+	uint32_t i;
+	int prio;
+
+	if (count > MAX_NUMBER_OF_ENTRIES)
+		count = MAX_NUMBER_OF_ENTRIES;
+	ClassifyEntries(entries, count, NULL, kernel);
+
+	/* Count candidates per priority, dropping the ones already tried */
+	memset(slot, 0, sizeof(slot));
+	for (i = NextEntryInMask(kernel, count, 0); i < count;
+	     i = NextEntryInMask(kernel, count, i + 1)) {
+		e = entries + i;
+		prio = GetEntryPriority(e);
+		if (!(GetEntrySuccessful(e) || GetEntryTries(e)) || !prio)
+			continue;
+		if (prio > gpt->current_priority ||
+		    (prio == gpt->current_priority &&
+		     (int)i <= gpt->current_kernel)) {
+			/* Mask it out so the second pass skips it too */
+			kernel[i / 32] &= ~(1U << (i % 32));
+			continue;
+		}
+		slot[prio]++;
+	}
+
+	/* Turn the counts into starting positions, highest priority first */
+	for (prio = CGPT_ATTRIBUTE_MAX_PRIORITY; prio > 0; prio--) {
+		uint32_t n = slot[prio];
+		slot[prio] = total;
+		total += n;
+	}
+
+	for (i = NextEntryInMask(kernel, count, 0); i < count;
+	     i = NextEntryInMask(kernel, count, i + 1)) {
+		e = entries + i;
+		prio = GetEntryPriority(e);
+		if (!(GetEntrySuccessful(e) || GetEntryTries(e)) || !prio)
+			continue;
+		gpt->kernel_order[slot[prio]++] = i;
+	}
+
+	gpt->kernel_order_count = total;
+	gpt->kernel_order_next = 0;
+}
+
 int GptInit(GptData *gpt)
 {
 	int retval;
@@ -19,6 +82,8 @@ int GptInit(GptData *gpt)
 	gpt->modified = 0;
 	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
 	gpt->current_priority = 999;
+	gpt->kernel_order_count = 0;
+	gpt->kernel_order_next = 0;
 
 	retval = GptSanityCheck(gpt);
 	if (GPT_SUCCESS != retval) {
@@ -27,86 +92,36 @@ int GptInit(GptData *gpt)
 	}
 
 	GptRepair(gpt);
+	BuildKernelOrder(gpt);
 	return GPT_SUCCESS;
 }
 
 int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
 {
-	GptHeader *header = (GptHeader *)gpt->primary_header;
 	GptEntry *entries = (GptEntry *)gpt->primary_entries;
 	GptEntry *e;
-	int new_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
-	int new_prio = 0;
-	uint32_t i;
-
-	/*
-	 * If we already found a kernel, continue the scan at the current
-	 * kernel's priority, in case there is another kernel with the same
-	 * priority.
-	 */
-	if (gpt->current_kernel != CGPT_KERNEL_ENTRY_NOT_FOUND) {
-		for (i = gpt->current_kernel + 1;
-		     i < header->number_of_entries; i++) {
-			e = entries + i;
-			if (!IsKernelEntry(e))
-				continue;
-			VB2_DEBUG("GptNextKernelEntry looking at same prio "
-				  "partition %d\n", i+1);
-			VB2_DEBUG("GptNextKernelEntry s%d t%d p%d\n",
-				  GetEntrySuccessful(e), GetEntryTries(e),
-				  GetEntryPriority(e));
-			if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
-				continue;
-			if (GetEntryPriority(e) == gpt->current_priority) {
-				gpt->current_kernel = i;
-				*start_sector = e->starting_lba;
-				*size = e->ending_lba - e->starting_lba + 1;
-				VB2_DEBUG("GptNextKernelEntry likes it\n");
-				return GPT_SUCCESS;
-			}
-		}
-	}
-
-	/*
-	 * We're still here, so scan for the remaining kernel with the highest
-	 * priority less than the previous attempt.
-	 */
-	for (i = 0, e = entries; i < header->number_of_entries; i++, e++) {
-		int current_prio = GetEntryPriority(e);
-		if (!IsKernelEntry(e))
-			continue;
-		VB2_DEBUG("GptNextKernelEntry looking at new prio "
-			  "partition %d\n", i+1);
-		VB2_DEBUG("GptNextKernelEntry s%d t%d p%d\n",
-			  GetEntrySuccessful(e), GetEntryTries(e),
-			  GetEntryPriority(e));
-		if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
-			continue;
-		if (current_prio >= gpt->current_priority) {
-			/* Already returned this kernel in a previous call */
-			continue;
-		}
-		if (current_prio > new_prio) {
-			new_kernel = i;
-			new_prio = current_prio;
-		}
-	}
+	int new_kernel;
 
-	/*
-	 * Save what we found.  Note that if we didn't find a new kernel,
-	 * new_prio will still be -1, so future calls to this function will
-	 * also fail.
-	 */
-	gpt->current_kernel = new_kernel;
-	gpt->current_priority = new_prio;
-
-	if (CGPT_KERNEL_ENTRY_NOT_FOUND == new_kernel) {
+	if (gpt->kernel_order_next >= gpt->kernel_order_count) {
+		/*
+		 * Leave the priority at 0 so a rebuild after an update
+		 * doesn't bring back kernels we've already walked past.
+		 */
+		gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+		gpt->current_priority = 0;
 		VB2_DEBUG("GptNextKernelEntry no more kernels\n");
 		return GPT_ERROR_NO_VALID_KERNEL;
 	}
 
-	VB2_DEBUG("GptNextKernelEntry likes partition %d\n", new_kernel + 1);
+	new_kernel = gpt->kernel_order[gpt->kernel_order_next++];
 	e = entries + new_kernel;
+	gpt->current_kernel = new_kernel;
+	gpt->current_priority = GetEntryPriority(e);
+
+	VB2_DEBUG("GptNextKernelEntry likes partition %d\n", new_kernel + 1);
+	VB2_DEBUG("GptNextKernelEntry s%d t%d p%d\n",
+		  GetEntrySuccessful(e), GetEntryTries(e),
+		  GetEntryPriority(e));
 	*start_sector = e->starting_lba;
 	*size = e->ending_lba - e->starting_lba + 1;
 	return GPT_SUCCESS;
@@ -119,6 +134,7 @@ int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
  */
 int GptUpdateKernelWithEntry(GptData *gpt, GptEntry *e, uint32_t update_type)
 {
+	GptEntry previous = *e;
 	int modified = 0;
 
 	if (!IsKernelEntry(e))
@@ -185,7 +201,9 @@ int GptUpdateKernelWithEntry(GptData *gpt, GptEntry *e, uint32_t update_type)
 	}
 
 	if (modified) {
-		GptModified(gpt);
+		GptModifiedEntry(gpt, e, &previous);
+		/* Priority or tries changed, so the boot order may have too */
+		BuildKernelOrder(gpt);
 	}
 
 	return GPT_SUCCESS;
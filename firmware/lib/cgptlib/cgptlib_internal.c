@@ -16,7 +16,10 @@ const static int MIN_SECTOR_SIZE = 512;
 size_t CalculateEntriesSectors(GptHeader* h, uint32_t sector_bytes)
 {
 	size_t bytes = h->number_of_entries * h->size_of_entry;
-	size_t ret = (bytes + sector_bytes - 1) / sector_bytes;
+	size_t ret;
+
+	sector_bytes = GptSectorBytes(sector_bytes);
+	ret = (bytes + sector_bytes - 1) / sector_bytes;
 	return ret;
 }
 
@@ -27,13 +30,19 @@ int CheckParameters(GptData *gpt)
 			(gpt->sector_bytes  & (gpt->sector_bytes  - 1)) != 0)
 		return GPT_ERROR_INVALID_SECTOR_SIZE;
 
+	/* A build pinned to one sector size can't handle any other */
+	if (gpt->sector_bytes != GptSectorBytes(gpt->sector_bytes))
+		return GPT_ERROR_INVALID_SECTOR_SIZE;
+	if ((gpt->flags & GPT_FLAG_EXTERNAL) && !GptIsExternal(gpt->flags))
+		return GPT_ERROR_INVALID_FLASH_GEOMETRY;
+
 	/*
 	 * gpt_drive_sectors should be reasonable. It cannot be unset, and it
 	 * cannot differ from streaming_drive_sectors if the GPT structs are
 	 * stored on same device.
 	 */
 	if (gpt->gpt_drive_sectors == 0 ||
-		(!(gpt->flags & GPT_FLAG_EXTERNAL) &&
+		(!GptIsExternal(gpt->flags) &&
 		 gpt->gpt_drive_sectors != gpt->streaming_drive_sectors)) {
 		return GPT_ERROR_INVALID_SECTOR_NUMBER;
 	}
@@ -45,7 +54,8 @@ int CheckParameters(GptData *gpt)
 	 */
 	if (gpt->gpt_drive_sectors <
 		(1 + 2 * (1 + MIN_NUMBER_OF_ENTRIES /
-				(gpt->sector_bytes / sizeof(GptEntry)))))
+				(GptSectorBytes(gpt->sector_bytes) /
+				 sizeof(GptEntry)))))
 		return GPT_ERROR_INVALID_SECTOR_NUMBER;
 
 	return GPT_SUCCESS;
@@ -104,7 +114,7 @@ int CheckHeader(GptHeader *h, int is_secondary,
 		return 1;
 	if ((h->number_of_entries < MIN_NUMBER_OF_ENTRIES) ||
 	    (h->number_of_entries > MAX_NUMBER_OF_ENTRIES) ||
-	    (!(flags & GPT_FLAG_EXTERNAL) &&
+	    (!GptIsExternal(flags) &&
 	    h->number_of_entries != MAX_NUMBER_OF_ENTRIES))
 		return 1;
 
@@ -130,7 +140,7 @@ int CheckHeader(GptHeader *h, int is_secondary,
 	if (h->first_usable_lba > h->last_usable_lba)
 		return 1;
 
-	if (flags & GPT_FLAG_EXTERNAL) {
+	if (GptIsExternal(flags)) {
 		if (h->last_usable_lba >= streaming_drive_sectors) {
 			return 1;
 		}
@@ -160,27 +170,181 @@ int IsKernelEntry(const GptEntry *e)
 	return !memcmp(&e->type, &chromeos_kernel, sizeof(Guid));
 }
 
+/*
+ * Load a GUID as two words.  Comparing those is much cheaper than memcmp(),
+ * and leaves the loop below free of branches.
+ */
+static inline void LoadGuid(const Guid *g, uint64_t *w)
+{
+	memcpy(w, g, sizeof(Guid));
+}
+
+void ClassifyEntries(const GptEntry *entries, uint32_t count,
+		     uint32_t *used, uint32_t *kernel)
+{
+	static const Guid chromeos_kernel = GPT_ENT_TYPE_CHROMEOS_KERNEL;
+	uint64_t k[2], t[2];
+	uint32_t i;
+
+	LoadGuid(&chromeos_kernel, k);
+	if (used)
+		memset(used, 0, GPT_ENTRY_MASK_WORDS * sizeof(uint32_t));
+	if (kernel)
+		memset(kernel, 0, GPT_ENTRY_MASK_WORDS * sizeof(uint32_t));
+
+	for (i = 0; i < count; i++) {
+		uint32_t bit = 1U << (i % 32);
+
+		LoadGuid(&entries[i].type, t);
+		if (used)
+			used[i / 32] |= bit & -(uint32_t)((t[0] | t[1]) != 0);
+		if (kernel)
+			kernel[i / 32] |= bit & -(uint32_t)
+				(((t[0] ^ k[0]) | (t[1] ^ k[1])) == 0);
+	}
+}
+
+uint32_t NextEntryInMask(const uint32_t *mask, uint32_t count,
+			 uint32_t start)
+{
+	uint32_t i = start;
+
+	while (i < count) {
+		uint32_t bits = mask[i / 32] >> (i % 32);
+
+		if (bits) {
+			i += __builtin_ctz(bits);
+			return i < count ? i : count;
+		}
+		i = (i | 31) + 1;
+	}
+	return count;
+}
+
+/* Sift order[root] down the heap of n entries, keyed by starting LBA */
+static void SiftDown(const GptEntry *entries, uint8_t *order, uint32_t root,
+		     uint32_t n)
+{
+	uint32_t child;
+
+	while ((child = 2 * root + 1) < n) {
+		uint8_t tmp;
+
+		if (child + 1 < n &&
+		    entries[order[child + 1]].starting_lba >
+		    entries[order[child]].starting_lba)
+			child++;
+		if (entries[order[root]].starting_lba >=
+		    entries[order[child]].starting_lba)
+			return;
+		tmp = order[root];
+		order[root] = order[child];
+		order[child] = tmp;
+		root = child;
+	}
+}
+
+/*
+ * Bits of GUID hash in EntriesDisjoint().  The hash set has twice as many
+ * slots as there are entries, and uint8_t indices.
+ */
+#define GUID_HASH_BITS 8
+_Static_assert((1 << GUID_HASH_BITS) == 2 * MAX_NUMBER_OF_ENTRIES,
+	       "GUID_HASH_BITS doesn't match MAX_NUMBER_OF_ENTRIES");
+
+/*
+ * Return 1 if the used entries are all in the usable region, don't overlap
+ * and have distinct unique GUIDs, else 0.  Overlaps are found by sorting the
+ * entries by starting LBA and checking each one starts after the one before
+ * it ends; duplicate GUIDs with a hash set.
+ */
+static int EntriesDisjoint(const GptEntry *entries, const GptHeader *h,
+			   const uint32_t *used, uint32_t count)
+{
+	uint8_t order[MAX_NUMBER_OF_ENTRIES];
+	/* Entry index + 1 in each slot, or 0 if the slot is empty */
+	uint8_t slots[1 << GUID_HASH_BITS];
+	uint32_t n = 0;
+	uint32_t i;
+
+	memset(slots, 0, sizeof(slots));
+	for (i = NextEntryInMask(used, count, 0); i < count;
+	     i = NextEntryInMask(used, count, i + 1)) {
+		const GptEntry *e = entries + i;
+		uint32_t hash;
+
+		if ((e->starting_lba < h->first_usable_lba) ||
+		    (e->ending_lba > h->last_usable_lba) ||
+		    (e->ending_lba < e->starting_lba))
+			return 0;
+
+		memcpy(&hash, &e->unique, sizeof(hash));
+		hash = (hash * 0x9e3779b1U) >> (32 - GUID_HASH_BITS);
+		while (slots[hash]) {
+			if (!memcmp(&e->unique,
+				    &entries[slots[hash] - 1].unique,
+				    sizeof(Guid)))
+				return 0;
+			hash = (hash + 1) % sizeof(slots);
+		}
+		slots[hash] = i + 1;
+
+		order[n++] = i;
+	}
+
+	/* Heap sort, so the worst case is still O(n log n) */
+	for (i = n / 2; i > 0; i--)
+		SiftDown(entries, order, i - 1, n);
+	for (i = n; i > 1; i--) {
+		uint8_t tmp = order[0];
+		order[0] = order[i - 1];
+		order[i - 1] = tmp;
+		SiftDown(entries, order, 0, i - 1);
+	}
+
+	for (i = 1; i < n; i++) {
+		if (entries[order[i]].starting_lba <=
+		    entries[order[i - 1]].ending_lba)
+			return 0;
+	}
+
+	return 1;
+}
+
 int CheckEntries(GptEntry *entries, GptHeader *h)
 {
 	if (!entries)
 		return GPT_ERROR_INVALID_ENTRIES;
+	uint32_t used[GPT_ENTRY_MASK_WORDS];
+	uint32_t count = h->number_of_entries;
 	GptEntry *entry;
 	uint32_t crc32;
 	uint32_t i;
 
+	if (count > MAX_NUMBER_OF_ENTRIES)
+		return GPT_ERROR_INVALID_ENTRIES;
+
 	/* Check CRC before examining entries. */
 	crc32 = Crc32((const uint8_t *)entries,
 		      h->size_of_entry * h->number_of_entries);
 	if (crc32 != h->entries_crc32)
 		return GPT_ERROR_CRC_CORRUPTED;
 
-	/* Check all entries. */
-	for (i = 0, entry = entries; i < h->number_of_entries; i++, entry++) {
+	ClassifyEntries(entries, count, used, NULL);
+	if (EntriesDisjoint(entries, h, used, count))
+		return 0;
+
+	/*
+	 * Something is wrong.  Check all used entries against all other used
+	 * entries to find which error to report, so it doesn't depend on how
+	 * the entries sort.
+	 */
+	for (i = NextEntryInMask(used, count, 0); i < count;
+	     i = NextEntryInMask(used, count, i + 1)) {
 		GptEntry *e2;
 		uint32_t i2;
 
-		if (IsUnusedEntry(entry))
-			continue;
+		entry = entries + i;
 
 		/* Entry must be in valid region. */
 		if ((entry->starting_lba < h->first_usable_lba) ||
@@ -189,10 +353,11 @@ int CheckEntries(GptEntry *entries, GptHeader *h)
 			return GPT_ERROR_OUT_OF_REGION;
 
 		/* Entry must not overlap other entries. */
-		for (i2 = 0, e2 = entries; i2 < h->number_of_entries;
-		     i2++, e2++) {
-			if (i2 == i || IsUnusedEntry(e2))
+		for (i2 = NextEntryInMask(used, count, 0); i2 < count;
+		     i2 = NextEntryInMask(used, count, i2 + 1)) {
+			if (i2 == i)
 				continue;
+			e2 = entries + i2;
 
 			if ((entry->starting_lba >= e2->starting_lba) &&
 			    (entry->starting_lba <= e2->ending_lba))
@@ -446,13 +611,14 @@ void GetCurrentKernelUniqueGuid(GptData *gpt, void *dest)
 	memcpy(dest, &e->unique, sizeof(Guid));
 }
 
-void GptModified(GptData *gpt) {
+/**
+ * Finish updating the primary header after its entries CRC has been updated,
+ * and propagate the changes to the secondary header and entries.
+ */
+static void GptModifiedHeader(GptData *gpt)
+{
 	GptHeader *header = (GptHeader *)gpt->primary_header;
 
-	/* Update the CRCs */
-	header->entries_crc32 = Crc32(gpt->primary_entries,
-				      header->size_of_entry *
-				      header->number_of_entries);
 	header->header_crc32 = HeaderCrc(header);
 	gpt->modified |= GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1;
 
@@ -466,6 +632,36 @@ void GptModified(GptData *gpt) {
 	GptRepair(gpt);
 }
 
+void GptModified(GptData *gpt) {
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+
+	/* Update the CRCs */
+	header->entries_crc32 = Crc32(gpt->primary_entries,
+				      header->size_of_entry *
+				      header->number_of_entries);
+	GptModifiedHeader(gpt);
+}
+
+void GptModifiedEntry(GptData *gpt, const GptEntry *e, const GptEntry *old)
+{
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+	uint32_t entries_size = header->size_of_entry *
+		header->number_of_entries;
+	uintptr_t offset = (uintptr_t)e - (uintptr_t)gpt->primary_entries;
+
+	/* Entry must be in the primary table, else recalculate everything */
+	if ((uintptr_t)e < (uintptr_t)gpt->primary_entries ||
+	    offset + sizeof(GptEntry) > entries_size) {
+		GptModified(gpt);
+		return;
+	}
+
+	header->entries_crc32 = Crc32Update(header->entries_crc32,
+					    entries_size, offset, old, e,
+					    sizeof(GptEntry));
+	GptModifiedHeader(gpt);
+}
+
 
 const char *GptErrorText(int error_code)
 {
@@ -0,0 +1,34 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * CRC32 using the ARMv8 CRC32 instructions.
+ *
+ * CRC32X computes exactly this CRC (bit-reflected polynomial 0xedb88320) over
+ * eight bytes at a time, so no folding is needed.  Only AArch64 is supported.
+ */
+
+#include "2sysincludes.h"
+#include "crc32.h"
+
+#ifndef __aarch64__
+#error "ARMV8_CRC32 is only supported on AArch64"
+#endif
+
+typedef uint64_t vb2_u64_u __attribute__((aligned(1), __may_alias__));
+
+uint32_t Crc32HwUpdate(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+	uint64_t data;
+
+	for (; len >= 8; buf += 8, len -= 8) {
+		/* CRC32X consumes the low byte first, as stored little-endian */
+		data = *(const vb2_u64_u *)buf;
+#ifdef __AARCH64EB__
+		data = __builtin_bswap64(data);
+#endif
+		__asm__("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(data));
+	}
+
+	return crc;
+}
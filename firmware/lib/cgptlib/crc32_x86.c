@@ -0,0 +1,94 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * CRC32 using the x86 carry-less multiply instruction (PCLMULQDQ).
+ *
+ * This is the folding method from Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" white paper, for the bit-reflected
+ * polynomial 0xedb88320.  Four 128-bit accumulators are folded forward 64
+ * bytes at a time, merged into one, folded over the remaining 16-byte blocks,
+ * then reduced to 32 bits with a Barrett reduction.  As with the SHA code,
+ * firmware builds cannot include the intrinsics headers, so the instructions
+ * are wrapped in inline asm.
+ */
+
+#include "2sysincludes.h"
+#include "crc32.h"
+
+typedef uint64_t vb2_u64x2 __attribute__((vector_size(16)));
+typedef uint64_t vb2_u64x2_u __attribute__((vector_size(16), aligned(1),
+					    __may_alias__));
+
+/* Folding constants: x^(k) mod P(x), bit-reflected */
+static const vb2_u64x2 k1k2 = {0x0154442bd4ULL, 0x01c6e41596ULL};
+static const vb2_u64x2 k3k4 = {0x01751997d0ULL, 0x00ccaa009eULL};
+static const vb2_u64x2 k5 = {0x0163cd6124ULL, 0};
+/* Barrett reduction: P(x) and floor(x^64 / P(x)), bit-reflected */
+static const vb2_u64x2 poly_mu = {0x01db710641ULL, 0x01f7011641ULL};
+static const vb2_u64x2 mask32 = {0xffffffffULL, 0};
+
+static inline vb2_u64x2 vb2_loadu(const uint8_t *p)
+{
+	return *(const vb2_u64x2_u *)p;
+}
+
+#define VB2_PCLMUL(a, b, imm) ({ \
+	vb2_u64x2 __r = (a); \
+	__asm__("pclmulqdq $" #imm ", %1, %0" : "+x"(__r) : "x"(b)); \
+	__r; \
+})
+
+/* Multiply the low and high halves of x by the matching halves of k */
+static inline vb2_u64x2 vb2_fold(vb2_u64x2 x, vb2_u64x2 k)
+{
+	return VB2_PCLMUL(x, k, 0x00) ^ VB2_PCLMUL(x, k, 0x11);
+}
+
+/* Shift right by 4 bytes across the whole 128-bit value */
+static inline vb2_u64x2 vb2_srl4(vb2_u64x2 x)
+{
+	__asm__("psrldq $4, %0" : "+x"(x));
+	return x;
+}
+
+uint32_t Crc32HwUpdate(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+	vb2_u64x2 x0, x1, x2, x3, t;
+
+	x0 = vb2_loadu(buf) ^ (vb2_u64x2){crc, 0};
+	x1 = vb2_loadu(buf + 16);
+	x2 = vb2_loadu(buf + 32);
+	x3 = vb2_loadu(buf + 48);
+	buf += 64;
+	len -= 64;
+
+	for (; len >= 64; buf += 64, len -= 64) {
+		x0 = vb2_fold(x0, k1k2) ^ vb2_loadu(buf);
+		x1 = vb2_fold(x1, k1k2) ^ vb2_loadu(buf + 16);
+		x2 = vb2_fold(x2, k1k2) ^ vb2_loadu(buf + 32);
+		x3 = vb2_fold(x3, k1k2) ^ vb2_loadu(buf + 48);
+	}
+
+	/* Merge the four accumulators, then fold in any 16-byte blocks left */
+	x0 = vb2_fold(x0, k3k4) ^ x1;
+	x0 = vb2_fold(x0, k3k4) ^ x2;
+	x0 = vb2_fold(x0, k3k4) ^ x3;
+	for (; len >= 16; buf += 16, len -= 16)
+		x0 = vb2_fold(x0, k3k4) ^ vb2_loadu(buf);
+
+	/* 128 to 64 bits: fold the low half into the high (appends 32 zeros) */
+	t = VB2_PCLMUL(x0, k3k4, 0x10);
+	x0 = (vb2_u64x2){x0[1], 0} ^ t;
+
+	/* 64 to 32 bits */
+	t = VB2_PCLMUL(x0 & mask32, k5, 0x00);
+	x0 = vb2_srl4(x0) ^ t;
+
+	/* Barrett reduction */
+	t = VB2_PCLMUL(x0 & mask32, poly_mu, 0x10);
+	t = VB2_PCLMUL(t & mask32, poly_mu, 0x00);
+	x0 ^= t;
+
+	return (uint32_t)(x0[0] >> 32);
+}
@@ -148,11 +148,41 @@ void GptRepair(GptData *gpt);
  */
 void GptModified(GptData *gpt);
 
+/**
+ * Like GptModified(), but when only one primary entry has changed since the
+ * CRCs were last valid.  The entries CRC is updated from the old and new
+ * contents of that entry instead of being recalculated over every entry.
+ *
+ * @param gpt		GPT data
+ * @param e		Modified entry, in gpt->primary_entries
+ * @param old		Contents of the entry before it was modified
+ */
+void GptModifiedEntry(GptData *gpt, const GptEntry *e, const GptEntry *old);
+
 /**
  * Return 1 if the entry is a Chrome OS kernel partition, else 0.
  */
 int IsKernelEntry(const GptEntry *e);
 
+/* Number of 32-bit words in a mask with one bit per entry */
+#define GPT_ENTRY_MASK_WORDS ((MAX_NUMBER_OF_ENTRIES + 31) / 32)
+
+/**
+ * Classify an entries array in a single pass.  Bit i of used is set if entry
+ * i is in use, and bit i of kernel is set if entry i is a Chrome OS kernel
+ * partition.  Either mask may be NULL; otherwise it must hold
+ * GPT_ENTRY_MASK_WORDS words.  count must be at most MAX_NUMBER_OF_ENTRIES.
+ */
+void ClassifyEntries(const GptEntry *entries, uint32_t count,
+		     uint32_t *used, uint32_t *kernel);
+
+/**
+ * Return the index of the first bit at or after start set in mask, or count
+ * if there are none before count.
+ */
+uint32_t NextEntryInMask(const uint32_t *mask, uint32_t count,
+			 uint32_t start);
+
 /**
  * Copy the current kernel partition's UniquePartitionGuid to the dest.
  */
@@ -163,6 +193,35 @@ void GetCurrentKernelUniqueGuid(GptData *gpt, void *dest);
  */
 const char *GptErrorText(int error_code);
 
+/*
+ * Firmware that only ever boots from one kind of disk can pin the sector size
+ * at build time with GPT_SECTOR_BYTES (e.g. 512), so sector math becomes
+ * shifts; 0 takes it from GptData at runtime.  Likewise, GPT_NOR_SUPPORT=0
+ * drops the GPT_FLAG_EXTERNAL paths for firmware without a NOR GPT.
+ */
+#ifndef GPT_SECTOR_BYTES
+#define GPT_SECTOR_BYTES 0
+#endif
+#ifndef GPT_NOR_SUPPORT
+#define GPT_NOR_SUPPORT 1
+#endif
+
+/**
+ * Return the sector size to use, given the runtime one.
+ */
+static inline uint32_t GptSectorBytes(uint32_t sector_bytes)
+{
+	return GPT_SECTOR_BYTES ? GPT_SECTOR_BYTES : sector_bytes;
+}
+
+/**
+ * Return non-zero if the flags say the GPT is stored off the drive.
+ */
+static inline int GptIsExternal(uint32_t flags)
+{
+	return GPT_NOR_SUPPORT && (flags & GPT_FLAG_EXTERNAL);
+}
+
 /**
  * Return number of sectors required to store the entries table. Where
  * a sector has size sector_bytes.
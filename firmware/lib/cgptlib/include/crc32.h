@@ -10,4 +10,64 @@
 
 uint32_t Crc32(const void *buffer, uint32_t len);
 
+/**
+ * Combine the CRCs of two adjacent buffers.
+ *
+ * @param crc_a		Crc32() of the first buffer
+ * @param crc_b		Crc32() of the second buffer
+ * @param len_b		Length of the second buffer
+ * @return Crc32() of the first buffer followed by the second.
+ */
+uint32_t Crc32Combine(uint32_t crc_a, uint32_t crc_b, uint32_t len_b);
+
+/**
+ * Update the CRC of a buffer after part of it has been rewritten.
+ *
+ * Only needs to read the changed region, so it is much cheaper than calling
+ * Crc32() on the whole buffer again when the region is small.
+ *
+ * @param crc		Crc32() of the buffer before the change
+ * @param len		Length of the whole buffer
+ * @param offset	Offset of the changed region in the buffer
+ * @param old_data	Previous contents of the changed region
+ * @param new_data	New contents of the changed region
+ * @param size		Length of the changed region; offset + size <= len
+ * @return Crc32() of the buffer after the change.
+ */
+uint32_t Crc32Update(uint32_t crc, uint32_t len, uint32_t offset,
+		     const void *old_data, const void *new_data, uint32_t size);
+
+/*
+ * Optional CPU-accelerated CRC backend, selected at build time.  As with the
+ * SHA backends, there is no runtime check that the CPU supports it.
+ */
+#if defined(X86_PCLMUL) && defined(ARMV8_CRC32)
+#error "X86_PCLMUL and ARMV8_CRC32 are mutually exclusive"
+#endif
+
+#if defined(X86_PCLMUL)
+#define CRC32_HW 1
+/* Folds 64 bytes per iteration, then the rest 16 bytes at a time */
+#define CRC32_HW_MIN_LEN 64
+#define CRC32_HW_BLOCK_SIZE 16
+#elif defined(ARMV8_CRC32)
+#define CRC32_HW 1
+#define CRC32_HW_MIN_LEN 8
+#define CRC32_HW_BLOCK_SIZE 8
+#else
+#define CRC32_HW 0
+#endif
+
+/**
+ * Update a CRC32 register value using CPU instructions.  Only built when
+ * CRC32_HW is set.
+ *
+ * @param crc		Current CRC register (not inverted)
+ * @param buf		Data to add; need not be aligned
+ * @param len		Length of data; at least CRC32_HW_MIN_LEN and a
+ *			multiple of CRC32_HW_BLOCK_SIZE
+ * @return The updated CRC register.
+ */
+uint32_t Crc32HwUpdate(uint32_t crc, const uint8_t *buf, uint32_t len);
+
 #endif  /* VBOOT_REFERENCE_CRC32_H_ */
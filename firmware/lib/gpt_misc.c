@@ -12,6 +12,171 @@
 #include "utility.h"
 #include "vboot_api.h"
 
+/* Number of disks whose validated GPT data is kept between reads */
+#define GPT_CACHE_DISKS 2
+
+/* Validated GPT data for one disk */
+struct gpt_cache_entry {
+	/* Disk the data was read from, or NULL if the entry is unused */
+	VbExDiskHandle_t handle;
+	/* Copy of the data after GptInit(), with its own buffers */
+	GptData gpt;
+};
+
+static struct gpt_cache_entry gpt_cache[GPT_CACHE_DISKS];
+static uint32_t gpt_cache_next;
+
+/**
+ * Allocate the header and entry buffers for GPT data.
+ *
+ * Returns 0 if successful, 1 if error.
+ */
+static int AllocGptBuffers(GptData *gptdata)
+{
+	gptdata->primary_header = (uint8_t *)malloc(gptdata->sector_bytes);
+	gptdata->secondary_header =
+		(uint8_t *)malloc(gptdata->sector_bytes);
+	gptdata->primary_entries = (uint8_t *)malloc(GPT_ENTRIES_ALLOC_SIZE);
+	gptdata->secondary_entries = (uint8_t *)malloc(GPT_ENTRIES_ALLOC_SIZE);
+
+	if (gptdata->primary_header == NULL ||
+	    gptdata->secondary_header == NULL ||
+	    gptdata->primary_entries == NULL ||
+	    gptdata->secondary_entries == NULL)
+		return 1;
+
+	return 0;
+}
+
+static void FreeGptBuffers(GptData *gptdata)
+{
+	if (gptdata->primary_header)
+		free(gptdata->primary_header);
+	if (gptdata->primary_entries)
+		free(gptdata->primary_entries);
+	if (gptdata->secondary_entries)
+		free(gptdata->secondary_entries);
+	if (gptdata->secondary_header)
+		free(gptdata->secondary_header);
+
+	gptdata->primary_header = NULL;
+	gptdata->primary_entries = NULL;
+	gptdata->secondary_entries = NULL;
+	gptdata->secondary_header = NULL;
+}
+
+/* Copy the buffers and validation state of one GPT into another. */
+static void CopyGptData(GptData *dest, const GptData *src)
+{
+	memcpy(dest->primary_header, src->primary_header, src->sector_bytes);
+	memcpy(dest->secondary_header, src->secondary_header,
+	       src->sector_bytes);
+	memcpy(dest->primary_entries, src->primary_entries,
+	       GPT_ENTRIES_ALLOC_SIZE);
+	memcpy(dest->secondary_entries, src->secondary_entries,
+	       GPT_ENTRIES_ALLOC_SIZE);
+	dest->valid_headers = src->valid_headers;
+	dest->valid_entries = src->valid_entries;
+	dest->ignored = src->ignored;
+	memcpy(dest->kernel_order, src->kernel_order,
+	       sizeof(src->kernel_order));
+	dest->kernel_order_count = src->kernel_order_count;
+}
+
+static struct gpt_cache_entry *FindGptCacheEntry(VbExDiskHandle_t handle,
+						 const GptData *gptdata)
+{
+	int i;
+
+	for (i = 0; i < GPT_CACHE_DISKS; i++) {
+		const GptData *g = &gpt_cache[i].gpt;
+
+		if (gpt_cache[i].handle == handle &&
+		    g->sector_bytes == gptdata->sector_bytes &&
+		    g->streaming_drive_sectors ==
+		    gptdata->streaming_drive_sectors &&
+		    g->gpt_drive_sectors == gptdata->gpt_drive_sectors &&
+		    g->flags == gptdata->flags)
+			return gpt_cache + i;
+	}
+
+	return NULL;
+}
+
+int GptCacheLookup(VbExDiskHandle_t disk_handle, GptData *gptdata)
+{
+	struct gpt_cache_entry *c = FindGptCacheEntry(disk_handle, gptdata);
+
+	if (!c)
+		return 1;
+
+	if (AllocGptBuffers(gptdata)) {
+		FreeGptBuffers(gptdata);
+		return 1;
+	}
+
+	/*
+	 * The headers carry the CRCs of the whole GPT, so if both still match
+	 * what's on the drive, so do the entries.
+	 */
+	if (VbExDiskRead(disk_handle, 1, 1, gptdata->primary_header) ||
+	    memcmp(gptdata->primary_header, c->gpt.primary_header,
+		   gptdata->sector_bytes) ||
+	    VbExDiskRead(disk_handle, gptdata->gpt_drive_sectors - 1, 1,
+			 gptdata->secondary_header) ||
+	    memcmp(gptdata->secondary_header, c->gpt.secondary_header,
+		   gptdata->sector_bytes)) {
+		VB2_DEBUG("GPT changed since it was cached\n");
+		FreeGptBuffers(gptdata);
+		GptCacheInvalidate(disk_handle);
+		return 1;
+	}
+
+	CopyGptData(gptdata, &c->gpt);
+	gptdata->modified = 0;
+	gptdata->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+	gptdata->current_priority = 999;
+	gptdata->kernel_order_next = 0;
+	return 0;
+}
+
+void GptCacheStore(VbExDiskHandle_t disk_handle, const GptData *gptdata)
+{
+	struct gpt_cache_entry *c;
+
+	/* Data which still needs writing back doesn't match the drive */
+	if (!disk_handle || gptdata->modified)
+		return;
+
+	GptCacheInvalidate(disk_handle);
+	c = gpt_cache + gpt_cache_next;
+	gpt_cache_next = (gpt_cache_next + 1) % GPT_CACHE_DISKS;
+	if (c->handle)
+		GptCacheInvalidate(c->handle);
+
+	c->gpt = *gptdata;
+	if (AllocGptBuffers(&c->gpt)) {
+		FreeGptBuffers(&c->gpt);
+		memset(c, 0, sizeof(*c));
+		return;
+	}
+	CopyGptData(&c->gpt, gptdata);
+	c->handle = disk_handle;
+}
+
+void GptCacheInvalidate(VbExDiskHandle_t disk_handle)
+{
+	int i;
+
+	for (i = 0; i < GPT_CACHE_DISKS; i++) {
+		if (!gpt_cache[i].handle ||
+		    (disk_handle && gpt_cache[i].handle != disk_handle))
+			continue;
+		FreeGptBuffers(&gpt_cache[i].gpt);
+		memset(gpt_cache + i, 0, sizeof(gpt_cache[i]));
+	}
+}
+
 /**
  * Allocate and read GPT data from the drive.
  *
@@ -30,16 +195,7 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	gptdata->ignored = 0;
 
 	/* Allocate all buffers */
-	gptdata->primary_header = (uint8_t *)malloc(gptdata->sector_bytes);
-	gptdata->secondary_header =
-		(uint8_t *)malloc(gptdata->sector_bytes);
-	gptdata->primary_entries = (uint8_t *)malloc(GPT_ENTRIES_ALLOC_SIZE);
-	gptdata->secondary_entries = (uint8_t *)malloc(GPT_ENTRIES_ALLOC_SIZE);
-
-	if (gptdata->primary_header == NULL ||
-	    gptdata->secondary_header == NULL ||
-	    gptdata->primary_entries == NULL ||
-	    gptdata->secondary_entries == NULL)
+	if (AllocGptBuffers(gptdata))
 		return 1;
 
 	/* Read primary header from the drive, skipping the protective MBR */
@@ -56,12 +212,9 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 			gptdata->flags,
 			gptdata->sector_bytes)) {
 		primary_valid = 1;
-		uint64_t entries_bytes =
-				(uint64_t)primary_header->number_of_entries
-				* primary_header->size_of_entry;
 		uint64_t entries_sectors =
-				(entries_bytes + gptdata->sector_bytes - 1)
-				/ gptdata->sector_bytes;
+				CalculateEntriesSectors(primary_header,
+							gptdata->sector_bytes);
 		if (0 != VbExDiskRead(disk_handle,
 				      primary_header->entries_lba,
 				      entries_sectors,
@@ -92,12 +245,9 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 			gptdata->flags,
 			gptdata->sector_bytes)) {
 		secondary_valid = 1;
-		uint64_t entries_bytes =
-				(uint64_t)secondary_header->number_of_entries
-				* secondary_header->size_of_entry;
 		uint64_t entries_sectors =
-				(entries_bytes + gptdata->sector_bytes - 1)
-				/ gptdata->sector_bytes;
+				CalculateEntriesSectors(secondary_header,
+							gptdata->sector_bytes);
 		if (0 != VbExDiskRead(disk_handle,
 				      secondary_header->entries_lba,
 				      entries_sectors,
@@ -135,6 +285,10 @@ int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	if (!header)
 		return 1;  /* No headers at all, so nothing to write */
 
+	/* Any cached copy is out of date once the drive is written */
+	if (gptdata->modified)
+		GptCacheInvalidate(disk_handle);
+
 	entries_bytes = (uint64_t)header->number_of_entries
 			* header->size_of_entry;
 	entries_sectors = entries_bytes / gptdata->sector_bytes;
@@ -205,14 +359,7 @@ int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 
 fail:
 	/* Avoid leaking memory on disk write failure */
-	if (gptdata->primary_header)
-		free(gptdata->primary_header);
-	if (gptdata->primary_entries)
-		free(gptdata->primary_entries);
-	if (gptdata->secondary_entries)
-		free(gptdata->secondary_entries);
-	if (gptdata->secondary_header)
-		free(gptdata->secondary_header);
+	FreeGptBuffers(gptdata);
 
 	/* Success */
 	return ret;
@@ -18,6 +18,8 @@ struct vb2_context;
 /* Boot flags for LoadKernel().boot_flags */
 /* GPT is external */
 #define BOOT_FLAG_EXTERNAL_GPT (0x04ULL)
+/* Verify all kernel vblocks before reading any kernel body */
+#define BOOT_FLAG_PROBE_VBLOCKS (0x08ULL)
 
 typedef struct LoadKernelParams {
 	/* Inputs to LoadKernel() */
@@ -35,6 +37,10 @@ typedef struct LoadKernelParams {
 	uint64_t kernel_buffer_size;
 	/* Boot flags */
 	uint64_t boot_flags;
+	/* Preferred read size in bytes, or 0 for the default */
+	uint32_t io_size;
+	/* Alignment in bytes that reads shouldn't cross, or 0 for none */
+	uint32_t io_align;
 
 	/*
 	 * Outputs from LoadKernel(); valid only if LoadKernel() returns
@@ -62,4 +68,18 @@ typedef struct LoadKernelParams {
  */
 vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params);
 
+/**
+ * Get ready for a later LoadKernel() from the current device.
+ *
+ * Reads and caches the GPT, and hints to the platform that the first kernel
+ * partition LoadKernel() will try is about to be read.  Doesn't write the
+ * disk or change any vboot state, so it is safe to call for a device which
+ * may not end up being booted.
+ *
+ * @param ctx		Vboot context
+ * @param params	Params for the LoadKernel() to get ready for; only the
+ *			inputs describing the disk are used
+ */
+void LoadKernelPrewarm(struct vb2_context *ctx, LoadKernelParams *params);
+
 #endif  /* VBOOT_REFERENCE_LOAD_KERNEL_FW_H_ */
@@ -20,4 +20,31 @@ void vb2_audio_start(struct vb2_context *ctx);
  */
 int vb2_audio_looping(void);
 
+/**
+ * Queue a tone, or a silence if frequency is 0, after those already queued.
+ * If the queue is full, this first waits for room.
+ *
+ * Tones play in the background if the platform implements VbExBeepAsync().
+ * Otherwise vb2_audio_poll() plays them with VbExBeep(), which blocks.
+ */
+void vb2_audio_queue(uint32_t msec, uint32_t frequency);
+
+/**
+ * Start the queued tone whose turn has come, if any.  UI loops call this (or
+ * vb2_audio_looping(), which calls it) on each pass.
+ *
+ * @return Milliseconds until the next queued tone is due, or 0 if the queue
+ * is empty.
+ */
+uint32_t vb2_audio_poll(void);
+
+/**
+ * Sleep, starting queued tones as they come due.  UI loops sleep with this
+ * rather than VbExSleepMs(), so a tone queued on one pass isn't held up until
+ * the next.
+ *
+ * @param msec		Milliseconds to sleep
+ */
+void vb2_audio_sleep(uint32_t msec);
+
 #endif  /* VBOOT_REFERENCE_VBOOT_AUDIO_H_ */
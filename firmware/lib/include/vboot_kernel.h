@@ -28,6 +28,20 @@ struct vb2_context;
  */
 vb2_error_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags);
 
+/**
+ * Get ready for a later VbTryLoadKernel() with the same flags.
+ *
+ * Reads the GPT of each candidate disk and starts reading its first kernel,
+ * so the VbTryLoadKernel() takes less time, for example if called while
+ * waiting for the user.  Nothing is written, so the disks can still go
+ * unbooted.  Platforms which return different disk handles each time
+ * VbExDiskGetInfo() is called won't see any benefit.
+ *
+ * @param ctx			Vboot context
+ * @param get_info_flags	Flags to pass to VbExDiskGetInfo()
+ */
+void VbPrewarmLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags);
+
 /* Flags for VbUserConfirms() */
 #define VB_CONFIRM_MUST_TRUST_KEYBOARD (1 << 0)
 #define VB_CONFIRM_SPACE_MEANS_NO      (1 << 1)
@@ -9,6 +9,7 @@
 #define VBOOT_REFERENCE_VBOOT_UI_COMMON_H_
 
 #define KEY_DELAY_MS	20	/* Delay between key scans in UI loops */
+#define EVENT_WAIT_MS	1000	/* Longest sleep waiting for UI events */
 
 enum vb2_beep_type {
 	VB_BEEP_FAILED,		/* Permitted but the operation failed */
@@ -21,6 +22,18 @@ enum vb2_beep_type {
  */
 void vb2_reset_power_button(void);
 
+/**
+ * Wait for the next UI event.
+ *
+ * Sleeps until VbExWaitForEvent() reports an event or timeout_ms passes.  If
+ * the platform can't wait for events, sleeps for KEY_DELAY_MS and reports
+ * every event, so the caller polls everything as before.
+ *
+ * @param timeout_ms	Longest time to wait
+ * @return VB_EVENT_* flags of the events which may have arrived.
+ */
+uint32_t vb2_wait_for_event(uint32_t timeout_ms);
+
 /**
  * Emit beeps to indicate an error
  */
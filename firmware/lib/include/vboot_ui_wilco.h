@@ -23,7 +23,9 @@ vb2_error_t vb2_check_diagnostic_key(struct vb2_context *ctx, uint32_t key);
  *
  * This asks the user to confirm the launch of the diagnostics rom. The user
  * can press the power button to confirm or press escape. There is a 30-second
- * timeout which acts the same as escape.
+ * timeout which acts the same as escape.  If VB2_GBB_FLAG_HEADLESS_DIAGNOSTICS
+ * is set, the rom is launched right away without any screens, and
+ * VBSD_HEADLESS_DIAGNOSTICS is recorded in the shared data.
  */
 vb2_error_t vb2_diagnostics_ui(struct vb2_context *ctx);
 
@@ -284,7 +284,7 @@ static void marshal_blob(void **buffer, void *blob,
 	}
 
 	memcpy(*buffer, blob, blob_size);
-	buffer_space -= blob_size;
+	*buffer_space -= blob_size;
 	*buffer = (void *)((uintptr_t)(*buffer) + blob_size);
 }
 
@@ -632,6 +632,25 @@ static void marshal_get_random(void **buffer, struct tpm2_get_random_cmd
 	marshal_u16(buffer, command_body->bytes_requested, buffer_space);
 }
 
+static void marshal_pcr_extend(void **buffer,
+			       struct tpm2_pcr_extend_cmd *command_body,
+			       int *buffer_space)
+{
+	struct tpm2_session_header session_header;
+
+	tpm_tag = TPM_ST_SESSIONS;
+	marshal_TPM_HANDLE(buffer, command_body->pcrHandle, buffer_space);
+	memset(&session_header, 0, sizeof(session_header));
+	session_header.session_handle = TPM_RS_PW;
+	marshal_session_header(buffer, &session_header, buffer_space);
+
+	/* TPML_DIGEST_VALUES with only the SHA-256 bank */
+	marshal_u32(buffer, 1, buffer_space);
+	marshal_u16(buffer, TPM_ALG_SHA256, buffer_space);
+	marshal_blob(buffer, (void *)command_body->digest,
+		     TPM_SHA256_DIGEST_SIZE, buffer_space);
+}
+
 static void marshal_clear(void **buffer,
 			  void *command_body,
 			  int *buffer_space)
@@ -725,6 +744,10 @@ int tpm_marshal_command(TPM_CC command, void *tpm_command_body,
 		marshal_get_random(&cmd_body, tpm_command_body, &body_size);
 		break;
 
+	case TPM2_PCR_Extend:
+		marshal_pcr_extend(&cmd_body, tpm_command_body, &body_size);
+		break;
+
 	case TPM2_Clear:
 		marshal_clear(&cmd_body, tpm_command_body, &body_size);
 		break;
@@ -807,6 +830,7 @@ int tpm_unmarshal_response(TPM_CC command,
 	case TPM2_NV_WriteLock:
 	case TPM2_NV_ReadLock:
 	case TPM2_Clear:
+	case TPM2_PCR_Extend:
 	case TPM2_SelfTest:
 	case TPM2_Startup:
 	case TPM2_Shutdown:
@@ -9,8 +9,10 @@
 #include "2common.h"
 #include "2sysincludes.h"
 #include "tlcl.h"
+#include "tlcl_internal.h"
 #include "tpm2_marshaling.h"
 #include "utility.h"
+#include "vboot_api.h"
 
 /*
  * TODO(chromium:1032930): Originally accessed by including secdata_tpm.h.
@@ -21,8 +23,39 @@
  */
 #define FIRMWARE_NV_INDEX 0x1007
 
-/* Global buffer for deserialized responses. */
-struct tpm2_response tpm2_resp;
+/*
+ * Buffer for deserialized responses.  Payloads such as NV read data aren't
+ * copied into it; they point into the command/response buffer.
+ */
+static struct tpm2_response tpm2_resp;
+
+/*
+ * TPM properties read by tlcl_get_tpm_property(), kept until a command which
+ * may change them is sent, or TlclLibInit().
+ */
+#define PROPERTY_CACHE_SIZE 8
+
+static struct {
+	int count;
+	struct {
+		TPM_PT property;
+		uint32_t value;
+	} entries[PROPERTY_CACHE_SIZE];
+} property_cache;
+
+/* Commands which only read TPM state, and so leave property_cache valid. */
+static int is_query_command(TPM_CC command)
+{
+	switch (command) {
+	case TPM2_GetCapability:
+	case TPM2_GetRandom:
+	case TPM2_NV_Read:
+	case TPM2_NV_ReadPublic:
+		return 1;
+	default:
+		return 0;
+	}
+}
 
 /*
  * Serializes and sends the command, gets back the response and
@@ -32,6 +65,10 @@ struct tpm2_response tpm2_resp;
  * @command_body: command-specific payload.
  * @response: pointer to the buffer to place the parsed response to.
  *
+ * The command is marshaled straight into the buffer handed to the transport,
+ * and the response is parsed in place, so any payload pointers in @response
+ * stay valid only until the next command.
+ *
  * Returns the result of processing the command:
  *   - if an error happened at marshaling, sending, receiving or unmarshaling
  *     stages, returns the error code;
@@ -45,6 +82,7 @@ static uint32_t tpm_get_response(TPM_CC command,
 	/* Command/response buffer. */
 	static uint8_t cr_buffer[TPM_BUFFER_SIZE];
 	int out_size;
+	uint64_t start;
 	uint32_t res;
 	uint32_t in_size;
 
@@ -55,8 +93,13 @@ static uint32_t tpm_get_response(TPM_CC command,
 		return TPM_E_WRITE_FAILURE;
 	}
 
+	if (!is_query_command(command))
+		property_cache.count = 0;
+
 	in_size = sizeof(cr_buffer);
+	start = VbExGetTimer();
 	res = VbExTpmSendReceive(cr_buffer, out_size, cr_buffer, &in_size);
+	TlclRecordCommandTime(command, VbExGetTimer() - start);
 	if (res != TPM_SUCCESS) {
 		VB2_DEBUG("tpm transaction failed for %#x with error %#x\n",
 			  command, res);
@@ -118,6 +161,8 @@ uint32_t TlclLibInit(void)
 {
 	uint32_t rv;
 
+	property_cache.count = 0;
+	TlclResetCommandStats();
 	rv = VbExTpmInit();
 	if (rv != TPM_SUCCESS)
 		return rv;
@@ -313,10 +358,19 @@ int TlclIsOwned(void)
 	return 0;
 }
 
+/**
+ * Extend the SHA-256 bank of PCR |pcr_num| with the TPM_SHA256_DIGEST_SIZE
+ * bytes at |in_digest|.  TPM2_PCR_Extend doesn't return the new PCR value, so
+ * |out_digest| is left untouched.
+ */
 uint32_t TlclExtend(int pcr_num, const uint8_t *in_digest, uint8_t *out_digest)
 {
-	VB2_DEBUG("NOT YET IMPLEMENTED\n");
-	return TPM_SUCCESS;
+	struct tpm2_pcr_extend_cmd extend;
+
+	extend.pcrHandle = pcr_num;
+	extend.digest = in_digest;
+
+	return tpm_get_response_code(TPM2_PCR_Extend, &extend);
 }
 
 
@@ -398,6 +452,14 @@ static uint32_t tlcl_get_tpm_property(TPM_PT property, uint32_t *pvalue)
 	uint32_t rv;
 	struct get_capability_response *resp;
 	TPML_TAGGED_TPM_PROPERTY *tpm_prop;
+	int i;
+
+	for (i = 0; i < property_cache.count; i++) {
+		if (property_cache.entries[i].property == property) {
+			*pvalue = property_cache.entries[i].value;
+			return TPM_SUCCESS;
+		}
+	}
 
 	rv = tlcl_get_capability(TPM_CAP_TPM_PROPERTIES, property, &resp);
 	if (rv != TPM_SUCCESS)
@@ -413,6 +475,11 @@ static uint32_t tlcl_get_tpm_property(TPM_PT property, uint32_t *pvalue)
 		return TPM_E_IOERROR;
 
 	*pvalue = tpm_prop->tpm_property[0].value;
+	if (property_cache.count < PROPERTY_CACHE_SIZE) {
+		i = property_cache.count++;
+		property_cache.entries[i].property = property;
+		property_cache.entries[i].value = *pvalue;
+	}
 	return TPM_SUCCESS;
 }
 
@@ -537,6 +604,25 @@ uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
 	return TPM_SUCCESS;
 }
 
+uint32_t TlclReadSpaces(struct tlcl_nv_read *reads, int count)
+{
+	uint32_t result = TPM_SUCCESS;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		struct tlcl_nv_read *r = reads + i;
+
+		r->result = TlclRead(r->index, r->data, r->length);
+		if (r->result == TPM_SUCCESS && r->permissions)
+			r->result = TlclGetPermissions(r->index,
+						       r->permissions);
+		if (result == TPM_SUCCESS)
+			result = r->result;
+	}
+
+	return result;
+}
+
 uint32_t TlclWrite(uint32_t index, const void *data, uint32_t length)
 {
 	struct tpm2_nv_write_cmd nv_writec;
@@ -19,6 +19,48 @@
 	(sizeof(uint32_t) + sizeof(TPM_NONCE) + 1 + TPM_AUTH_DATA_LEN)
 #define kTpmResponseAuthBlockLength (sizeof(TPM_NONCE) + 1 + TPM_AUTH_DATA_LEN)
 
+/*
+ * How long TlclSendReceive() keeps retrying a command while the TPM reports
+ * the self test is still running, in milliseconds.  The delay between tries
+ * starts at TPM_SELFTEST_POLL_MIN_MS and doubles up to TPM_SELFTEST_POLL_MAX_MS.
+ */
+#ifndef TPM_SELFTEST_TIMEOUT_MS
+#define TPM_SELFTEST_TIMEOUT_MS 5000
+#endif
+#define TPM_SELFTEST_POLL_MIN_MS 1
+#define TPM_SELFTEST_POLL_MAX_MS 64
+
+/* Self test state and time spent waiting for it, since TlclLibInit() */
+struct tlcl_selftest_wait {
+	uint32_t started;	/* TlclContinueSelfTest() has succeeded */
+	uint32_t retries;	/* Commands sent again after a delay */
+	uint32_t sleep_ms;	/* Total delay between them */
+};
+
+/**
+ * Send a TPM command, and while the TPM reports it is doing its self test,
+ * send it again with increasing delays, for up to TPM_SELFTEST_TIMEOUT_MS.
+ * Returns the result of the last try.
+ */
+uint32_t TlclSendReceiveDuringSelfTest(const uint8_t *request,
+				       uint8_t *response, int max_length);
+
+/**
+ * Return the self test state and time spent waiting for it so far.
+ */
+const struct tlcl_selftest_wait *TlclGetSelfTestWait(void);
+
+/**
+ * Add one send/receive of [command] taking [us] microseconds to the stats
+ * returned by TlclGetCommandStats().
+ */
+void TlclRecordCommandTime(uint32_t command, uint32_t us);
+
+/**
+ * Clear the stats returned by TlclGetCommandStats().
+ */
+void TlclResetCommandStats(void);
+
 
 /*
  * Conversion functions.  ToTpmTYPE puts a value of type TYPE into a TPM
@@ -178,4 +178,62 @@ const struct s_tpm_nv_definespace_cmd{
 } tpm_nv_definespace_cmd = {{0x0, 0xc1, 0x0, 0x0, 0x0, 0x65, 0x0, 0x0, 0x0, 0xcc, 0x0, 0x18, 0, 0, 0, 0, 0x0, 0x3, 0, 0, 0, 0x1f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x0, 0x3, 0, 0, 0, 0x1f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x0, 0x17, },
 12, 16, 42, 70, 77, };
 
+/* Writes a tpm_nv_write_cmd into [buffer], which must be large enough for it.
+ * Returns the size of the command. */
+__attribute__((unused))
+static inline uint32_t TpmBuildNvWrite(uint8_t *buffer,
+		uint32_t index,
+		uint32_t length,
+		const void *data)
+{
+	const uint32_t size = 22 + length;
+
+	buffer[0] = 0x0;
+	buffer[1] = 0xc1;
+	ToTpmUint32(buffer + 2, size);
+	ToTpmUint32(buffer + 6, 0xcd);
+	ToTpmUint32(buffer + 10, index);
+	memset(buffer + 14, 0, 4);
+	ToTpmUint32(buffer + 18, length);
+	memcpy(buffer + 22, data, length);
+	return size;
+}
+
+/* Writes a tpm_nv_read_cmd into [buffer], which must be large enough for it.
+ * Returns the size of the command. */
+__attribute__((unused))
+static inline uint32_t TpmBuildNvRead(uint8_t *buffer,
+		uint32_t index,
+		uint32_t length)
+{
+	const uint32_t size = 22;
+
+	buffer[0] = 0x0;
+	buffer[1] = 0xc1;
+	ToTpmUint32(buffer + 2, 0x16);
+	ToTpmUint32(buffer + 6, 0xcf);
+	ToTpmUint32(buffer + 10, index);
+	memset(buffer + 14, 0, 4);
+	ToTpmUint32(buffer + 18, length);
+	return size;
+}
+
+/* Writes a tpm_extend_cmd into [buffer], which must be large enough for it.
+ * Returns the size of the command. */
+__attribute__((unused))
+static inline uint32_t TpmBuildExtend(uint8_t *buffer,
+		uint32_t pcrNum,
+		const uint8_t *inDigest)
+{
+	const uint32_t size = 34;
+
+	buffer[0] = 0x0;
+	buffer[1] = 0xc1;
+	ToTpmUint32(buffer + 2, 0x22);
+	ToTpmUint32(buffer + 6, 0x14);
+	ToTpmUint32(buffer + 10, pcrNum);
+	memcpy(buffer + 14, inDigest, 20);
+	return size;
+}
+
 const int kWriteInfoLength = 12;
@@ -59,6 +59,36 @@ static inline int TpmReturnCode(const uint8_t* buffer)
 	return TpmCommandCode(buffer);
 }
 
+/*
+ * Capability query results, kept until a command which may change them is
+ * sent, or TlclLibInit().  Bits in valid say which fields are filled in.
+ */
+#define CAP_CACHE_PFLAGS (1 << 0)
+#define CAP_CACHE_VFLAGS (1 << 1)
+#define CAP_CACHE_OWNED (1 << 2)
+
+static struct {
+	uint32_t valid;
+	TPM_PERMANENT_FLAGS pflags;
+	TPM_STCLEAR_FLAGS vflags;
+	uint8_t owned;
+} cap_cache;
+
+/* Commands which only read TPM state, and so leave cap_cache valid. */
+static int IsQueryCommand(uint32_t code)
+{
+	switch (code) {
+	case TPM_ORD_GetCapability:
+	case TPM_ORD_GetRandom:
+	case TPM_ORD_NV_ReadValue:
+	case TPM_ORD_PcrRead:
+	case TPM_ORD_ReadPubek:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
 /* Like TlclSendReceive below, but do not retry if NEEDS_SELFTEST or
  * DOING_SELFTEST errors are returned.
  */
@@ -67,6 +97,7 @@ static uint32_t TlclSendReceiveNoRetry(const uint8_t* request,
 {
 
 	uint32_t response_length = max_length;
+	uint64_t start;
 	uint32_t result;
 
 #ifdef EXTRA_LOGGING
@@ -76,8 +107,14 @@ static uint32_t TlclSendReceiveNoRetry(const uint8_t* request,
 		  request[6], request[7], request[8], request[9]);
 #endif
 
+	if (!IsQueryCommand(TpmCommandCode(request)))
+		cap_cache.valid = 0;
+
+	start = VbExGetTimer();
 	result = VbExTpmSendReceive(request, TpmCommandSize(request),
 				    response, &response_length);
+	TlclRecordCommandTime(TpmCommandCode(request),
+			      VbExGetTimer() - start);
 	if (TPM_SUCCESS != result) {
 		/* Communication with TPM failed, so response is garbage */
 		VB2_DEBUG("TPM: command %#x send/receive failed: %#x\n",
@@ -104,6 +141,43 @@ static uint32_t TlclSendReceiveNoRetry(const uint8_t* request,
 	return result;
 }
 
+static struct tlcl_selftest_wait selftest_wait;
+
+const struct tlcl_selftest_wait *TlclGetSelfTestWait(void)
+{
+	return &selftest_wait;
+}
+
+uint32_t TlclSendReceiveDuringSelfTest(const uint8_t *request,
+				       uint8_t *response, int max_length)
+{
+	uint64_t start = VbExGetTimer();
+	uint32_t delay_ms = TPM_SELFTEST_POLL_MIN_MS;
+	uint32_t result;
+
+	while ((result = TlclSendReceiveNoRetry(request, response, max_length))
+	       == TPM_E_DOING_SELFTEST) {
+		uint64_t waited_ms = (VbExGetTimer() - start) /
+			VB_USEC_PER_MSEC;
+
+		if (waited_ms >= TPM_SELFTEST_TIMEOUT_MS) {
+			VB2_DEBUG("TPM: self test still running after %d ms\n",
+				  (int)waited_ms);
+			break;
+		}
+		if (delay_ms > TPM_SELFTEST_TIMEOUT_MS - waited_ms)
+			delay_ms = TPM_SELFTEST_TIMEOUT_MS - waited_ms;
+
+		VbExSleepMs(delay_ms);
+		selftest_wait.retries++;
+		selftest_wait.sleep_ms += delay_ms;
+
+		delay_ms = VB2_MIN(2 * delay_ms, TPM_SELFTEST_POLL_MAX_MS);
+	}
+
+	return result;
+}
+
 /* Sends a TPM command and gets a response.  Returns 0 if success or the TPM
  * error code if error. In the firmware, waits for the self test to complete
  * if needed. In the host, reports the first error without retries. */
@@ -117,6 +191,13 @@ uint32_t TlclSendReceive(const uint8_t* request, uint8_t* response,
 	/* If the command fails because the self test has not completed, try it
 	 * again after attempting to ensure that the self test has completed. */
 	if (result == TPM_E_NEEDS_SELFTEST || result == TPM_E_DOING_SELFTEST) {
+#if !defined(TPM_BLOCKING_CONTINUESELFTEST) && !defined(VB_RECOVERY_MODE)
+		/* If the self test was started early, it has been running in
+		 * the background; only wait for what is left of it. */
+		if (result == TPM_E_DOING_SELFTEST && selftest_wait.started)
+			return TlclSendReceiveDuringSelfTest(request, response,
+							     max_length);
+#endif
 		result = TlclContinueSelfTest();
 		if (result != TPM_SUCCESS) {
 			return result;
@@ -125,16 +206,13 @@ uint32_t TlclSendReceive(const uint8_t* request, uint8_t* response,
 		/* Retry only once */
 		result = TlclSendReceiveNoRetry(request, response, max_length);
 #else
-		/* This needs serious testing.  The TPM specification says:
-		 * "iii. The caller MUST wait for the actions of
-		 * TPM_ContinueSelfTest to complete before reissuing the
-		 * command C1."  But, if ContinueSelfTest is non-blocking, how
-		 * do we know that the actions have completed other than trying
-		 * again? */
-		do {
-			result = TlclSendReceiveNoRetry(request, response,
-							max_length);
-		} while (result == TPM_E_DOING_SELFTEST);
+		/* The TPM specification says: "iii. The caller MUST wait for
+		 * the actions of TPM_ContinueSelfTest to complete before
+		 * reissuing the command C1."  But, if ContinueSelfTest is
+		 * non-blocking, how do we know that the actions have completed
+		 * other than trying again?  So keep trying, backing off. */
+		result = TlclSendReceiveDuringSelfTest(request, response,
+						       max_length);
 #endif
 	}
 #endif  /* ! defined(CHROMEOS_ENVIRONMENT) */
@@ -390,6 +468,9 @@ static uint32_t CheckResponseAuthBlock(struct auth_session* auth_session,
 
 uint32_t TlclLibInit(void)
 {
+	memset(&selftest_wait, 0, sizeof(selftest_wait));
+	cap_cache.valid = 0;
+	TlclResetCommandStats();
 	return VbExTpmInit();
 }
 
@@ -425,10 +506,14 @@ uint32_t TlclSelfTestFull(void)
 uint32_t TlclContinueSelfTest(void)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
+	uint32_t result;
 	VB2_DEBUG("TPM: Continue self test\n");
 	/* Call the No Retry version of SendReceive to avoid recursion. */
-	return TlclSendReceiveNoRetry(tpm_continueselftest_cmd.buffer,
-				      response, sizeof(response));
+	result = TlclSendReceiveNoRetry(tpm_continueselftest_cmd.buffer,
+					response, sizeof(response));
+	if (result == TPM_SUCCESS)
+		selftest_wait.started = 1;
+	return result;
 }
 
 uint32_t TlclDefineSpace(uint32_t index, uint32_t perm, uint32_t size)
@@ -616,35 +701,28 @@ uint32_t TlclInitNvAuthPolicy(uint32_t pcr_selection_bitmap,
 
 uint32_t TlclWrite(uint32_t index, const void* data, uint32_t length)
 {
-	struct s_tpm_nv_write_cmd cmd;
+	uint8_t cmd[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	const int total_length =
 			kTpmRequestHeaderLength + kWriteInfoLength + length;
 
 	VB2_DEBUG("TPM: TlclWrite(%#x, %d)\n", index, length);
-	memcpy(&cmd, &tpm_nv_write_cmd, sizeof(cmd));
 	VB2_ASSERT(total_length <= TPM_LARGE_ENOUGH_COMMAND_SIZE);
-	SetTpmCommandSize(cmd.buffer, total_length);
-
-	ToTpmUint32(cmd.buffer + tpm_nv_write_cmd.index, index);
-	ToTpmUint32(cmd.buffer + tpm_nv_write_cmd.length, length);
-	memcpy(cmd.buffer + tpm_nv_write_cmd.data, data, length);
+	TpmBuildNvWrite(cmd, index, length, data);
 
-	return TlclSendReceive(cmd.buffer, response, sizeof(response));
+	return TlclSendReceive(cmd, response, sizeof(response));
 }
 
 uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
 {
-	struct s_tpm_nv_read_cmd cmd;
+	uint8_t cmd[sizeof(tpm_nv_read_cmd.buffer)];
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint32_t result;
 
 	VB2_DEBUG("TPM: TlclRead(%#x, %d)\n", index, length);
-	memcpy(&cmd, &tpm_nv_read_cmd, sizeof(cmd));
-	ToTpmUint32(cmd.buffer + tpm_nv_read_cmd.index, index);
-	ToTpmUint32(cmd.buffer + tpm_nv_read_cmd.length, length);
+	TpmBuildNvRead(cmd, index, length);
 
-	result = TlclSendReceive(cmd.buffer, response, sizeof(response));
+	result = TlclSendReceive(cmd, response, sizeof(response));
 	if (result == TPM_SUCCESS && length > 0) {
 		const uint8_t* nv_read_cursor =
 				response + kTpmResponseHeaderLength;
@@ -657,6 +735,25 @@ uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
 	return result;
 }
 
+uint32_t TlclReadSpaces(struct tlcl_nv_read *reads, int count)
+{
+	uint32_t result = TPM_SUCCESS;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		struct tlcl_nv_read *r = reads + i;
+
+		r->result = TlclRead(r->index, r->data, r->length);
+		if (r->result == TPM_SUCCESS && r->permissions)
+			r->result = TlclGetPermissions(r->index,
+						       r->permissions);
+		if (result == TPM_SUCCESS)
+			result = r->result;
+	}
+
+	return result;
+}
+
 uint32_t TlclPCRRead(uint32_t index, void* data, uint32_t length)
 {
 	struct s_tpm_pcr_read_cmd cmd;
@@ -769,8 +866,15 @@ uint32_t TlclGetPermanentFlags(TPM_PERMANENT_FLAGS* pflags)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint32_t size;
-	uint32_t result = TlclSendReceive(tpm_getflags_cmd.buffer, response,
-					  sizeof(response));
+	uint32_t result;
+
+	if (cap_cache.valid & CAP_CACHE_PFLAGS) {
+		memcpy(pflags, &cap_cache.pflags, sizeof(TPM_PERMANENT_FLAGS));
+		return TPM_SUCCESS;
+	}
+
+	result = TlclSendReceive(tpm_getflags_cmd.buffer, response,
+				 sizeof(response));
 	if (result != TPM_SUCCESS)
 		return result;
 	FromTpmUint32(response + kTpmResponseHeaderLength, &size);
@@ -780,6 +884,8 @@ uint32_t TlclGetPermanentFlags(TPM_PERMANENT_FLAGS* pflags)
 	memcpy(pflags,
 	       response + kTpmResponseHeaderLength + sizeof(size),
 	       sizeof(TPM_PERMANENT_FLAGS));
+	memcpy(&cap_cache.pflags, pflags, sizeof(TPM_PERMANENT_FLAGS));
+	cap_cache.valid |= CAP_CACHE_PFLAGS;
 	return result;
 }
 
@@ -787,8 +893,15 @@ uint32_t TlclGetSTClearFlags(TPM_STCLEAR_FLAGS* vflags)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint32_t size;
-	uint32_t result = TlclSendReceive(tpm_getstclearflags_cmd.buffer,
-					  response, sizeof(response));
+	uint32_t result;
+
+	if (cap_cache.valid & CAP_CACHE_VFLAGS) {
+		memcpy(vflags, &cap_cache.vflags, sizeof(TPM_STCLEAR_FLAGS));
+		return TPM_SUCCESS;
+	}
+
+	result = TlclSendReceive(tpm_getstclearflags_cmd.buffer,
+				 response, sizeof(response));
 	if (result != TPM_SUCCESS)
 		return result;
 	FromTpmUint32(response + kTpmResponseHeaderLength, &size);
@@ -799,6 +912,8 @@ uint32_t TlclGetSTClearFlags(TPM_STCLEAR_FLAGS* vflags)
 	memcpy(vflags,
 	       response + kTpmResponseHeaderLength + sizeof(size),
 	       sizeof(TPM_STCLEAR_FLAGS));
+	memcpy(&cap_cache.vflags, vflags, sizeof(TPM_STCLEAR_FLAGS));
+	cap_cache.valid |= CAP_CACHE_VFLAGS;
 	return result;
 }
 
@@ -832,15 +947,13 @@ uint32_t TlclSetGlobalLock(void)
 uint32_t TlclExtend(int pcr_num, const uint8_t* in_digest,
 		    uint8_t* out_digest)
 {
-	struct s_tpm_extend_cmd cmd;
+	uint8_t cmd[sizeof(tpm_extend_cmd.buffer)];
 	uint8_t response[kTpmResponseHeaderLength + kPcrDigestLength];
 	uint32_t result;
 
-	memcpy(&cmd, &tpm_extend_cmd, sizeof(cmd));
-	ToTpmUint32(cmd.buffer + tpm_extend_cmd.pcrNum, pcr_num);
-	memcpy(cmd.buffer + cmd.inDigest, in_digest, kPcrDigestLength);
+	TpmBuildExtend(cmd, pcr_num, in_digest);
 
-	result = TlclSendReceive(cmd.buffer, response, sizeof(response));
+	result = TlclSendReceive(cmd, response, sizeof(response));
 	if (result != TPM_SUCCESS)
 		return result;
 
@@ -961,8 +1074,15 @@ uint32_t TlclGetOwnership(uint8_t* owned)
 {
 	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
 	uint32_t size;
-	uint32_t result = TlclSendReceive(tpm_getownership_cmd.buffer,
-					  response, sizeof(response));
+	uint32_t result;
+
+	if (cap_cache.valid & CAP_CACHE_OWNED) {
+		*owned = cap_cache.owned;
+		return TPM_SUCCESS;
+	}
+
+	result = TlclSendReceive(tpm_getownership_cmd.buffer,
+				 response, sizeof(response));
 	if (result != TPM_SUCCESS)
 		return result;
 	FromTpmUint32(response + kTpmResponseHeaderLength, &size);
@@ -972,6 +1092,8 @@ uint32_t TlclGetOwnership(uint8_t* owned)
 	memcpy(owned,
 	       response + kTpmResponseHeaderLength + sizeof(size),
 	       sizeof(*owned));
+	cap_cache.owned = *owned;
+	cap_cache.valid |= CAP_CACHE_OWNED;
 	return result;
 }
 
@@ -0,0 +1,68 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Per-command TPM latency, shared by the TPM 1.2 and TPM 2.0 libraries.
+ */
+
+#include "2sysincludes.h"
+#include "tlcl.h"
+#include "tlcl_internal.h"
+
+#ifndef TPM_NO_COMMAND_STATS
+
+static struct tlcl_command_stats stats[TLCL_MAX_COMMAND_STATS];
+static int stats_count;
+
+void TlclRecordCommandTime(uint32_t command, uint32_t us)
+{
+	struct tlcl_command_stats *st;
+	int i;
+
+	for (i = 0; i < stats_count; i++)
+		if (stats[i].command == command)
+			break;
+
+	if (i == stats_count) {
+		if (stats_count == TLCL_MAX_COMMAND_STATS)
+			return;
+		stats_count++;
+	}
+
+	st = stats + i;
+	st->command = command;
+	st->count++;
+	st->total_us += us;
+	if (us > st->max_us)
+		st->max_us = us;
+}
+
+void TlclResetCommandStats(void)
+{
+	memset(stats, 0, sizeof(stats));
+	stats_count = 0;
+}
+
+const struct tlcl_command_stats *TlclGetCommandStats(int *count)
+{
+	*count = stats_count;
+	return stats;
+}
+
+#else  /* TPM_NO_COMMAND_STATS */
+
+void TlclRecordCommandTime(uint32_t command, uint32_t us)
+{
+}
+
+void TlclResetCommandStats(void)
+{
+}
+
+const struct tlcl_command_stats *TlclGetCommandStats(int *count)
+{
+	*count = 0;
+	return NULL;
+}
+
+#endif  /* TPM_NO_COMMAND_STATS */
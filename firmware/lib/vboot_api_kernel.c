@@ -12,6 +12,7 @@
 #include "2rsa.h"
 #include "2secdata.h"
 #include "2sysincludes.h"
+#include "cgptlib_internal.h"
 #include "load_kernel_fw.h"
 #include "utility.h"
 #include "vb2_common.h"
@@ -23,12 +24,32 @@
 /* Global variables */
 static LoadKernelParams lkp;
 
+/*
+ * Removable disks LoadKernel() already rejected, so the recovery UI doesn't
+ * read them again each time it looks for a recovery image.  An entry is
+ * dropped as soon as a scan no longer finds its disk, so a stick which is
+ * pulled out and rewritten gets another look.
+ */
+#define REJECTED_DISKS_MAX 8
+static struct rejected_disk {
+	VbExDiskHandle_t handle;
+	uint64_t bytes_per_lba;
+	uint64_t lba_count;
+	vb2_error_t rv;
+} rejected_disks[REJECTED_DISKS_MAX];
+static uint32_t rejected_disk_count;
+
 #ifdef CHROMEOS_ENVIRONMENT
 /* Global variable accessor for unit tests */
 struct LoadKernelParams *VbApiKernelGetParams(void)
 {
 	return &lkp;
 }
+
+void VbApiKernelResetRejectedDisks(void)
+{
+	rejected_disk_count = 0;
+}
 #endif
 
 static vb2_error_t handle_battery_cutoff(struct vb2_context *ctx)
@@ -57,11 +78,157 @@ static vb2_error_t handle_battery_cutoff(struct vb2_context *ctx)
 	return VB2_SUCCESS;
 }
 
+/**
+ * Check whether a disk is one LoadKernel() should try.
+ *
+ * Sanity-check what we can. FWIW, VbTryLoadKernel() is always called with
+ * only a single bit set in get_info_flags.
+ *
+ * Ensure that we got a partition with only the flags we asked for.
+ */
+static int is_candidate_disk(const VbDiskInfo *info, uint32_t get_info_flags)
+{
+	return info->bytes_per_lba >= 512 &&
+		(info->bytes_per_lba & (info->bytes_per_lba - 1)) == 0 &&
+		info->lba_count >= 16 &&
+		get_info_flags == (info->flags & ~VB_DISK_FLAG_EXTERNAL_GPT);
+}
+
+static int is_same_disk(const struct rejected_disk *r, const VbDiskInfo *info)
+{
+	return r->handle == info->handle &&
+		r->bytes_per_lba == info->bytes_per_lba &&
+		r->lba_count == info->lba_count;
+}
+
+static struct rejected_disk *find_rejected_disk(const VbDiskInfo *info)
+{
+	uint32_t i;
+
+	for (i = 0; i < rejected_disk_count; i++) {
+		if (is_same_disk(rejected_disks + i, info))
+			return rejected_disks + i;
+	}
+
+	return NULL;
+}
+
+/* Forget rejected disks which are no longer in the list. */
+static void prune_rejected_disks(const VbDiskInfo *disk_info,
+				 uint32_t disk_count)
+{
+	uint32_t kept = 0;
+	uint32_t i, j;
+
+	for (i = 0; i < rejected_disk_count; i++) {
+		for (j = 0; j < disk_count; j++) {
+			if (is_same_disk(rejected_disks + i, disk_info + j))
+				break;
+		}
+		if (j < disk_count)
+			rejected_disks[kept++] = rejected_disks[i];
+	}
+	rejected_disk_count = kept;
+}
+
+/*
+ * Check whether the last LoadKernel() call rejected its disk for what's on
+ * it: the GPT was read, and every kernel partition was read and failed
+ * verification.  A failed read might work next time, so isn't a verdict.
+ */
+static int is_rejected_for_contents(struct vb2_context *ctx)
+{
+	VbSharedDataHeader *shared = vb2_get_sd(ctx)->vbsd;
+	const VbSharedDataKernelCall *shcall;
+	uint32_t i;
+
+	if (!shared || !shared->lk_call_count)
+		return 0;
+	shcall = shared->lk_calls +
+		((shared->lk_call_count - 1) & (VBSD_MAX_KERNEL_CALLS - 1));
+
+	if (shcall->check_result != VBSD_LKC_CHECK_GPT_PARSE_ERROR &&
+	    shcall->check_result != VBSD_LKC_CHECK_INVALID_PARTITIONS &&
+	    shcall->check_result != VBSD_LKC_CHECK_NO_PARTITIONS)
+		return 0;
+
+	/* Results past the last partition tracked have been overwritten */
+	if (shcall->kernel_parts_found > VBSD_MAX_KERNEL_PARTS)
+		return 0;
+
+	for (i = 0; i < shcall->kernel_parts_found; i++) {
+		switch (shcall->parts[i].check_result) {
+		case VBSD_LKP_CHECK_NOT_DONE:
+		case VBSD_LKP_CHECK_TOO_SMALL:	/* Or a stream failed to open */
+		case VBSD_LKP_CHECK_READ_START:
+		case VBSD_LKP_CHECK_READ_DATA:
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Remember a removable disk LoadKernel() rejected.  Only verdicts on what's
+ * on the disk are kept; errors which might be transient aren't.
+ */
+static void add_rejected_disk(struct vb2_context *ctx,
+			      const VbDiskInfo *info, vb2_error_t rv)
+{
+	struct rejected_disk *r;
+
+	if (!info->handle || rejected_disk_count >= REJECTED_DISKS_MAX ||
+	    (rv != VB2_ERROR_LK_INVALID_KERNEL_FOUND &&
+	     rv != VB2_ERROR_LK_NO_KERNEL_FOUND) ||
+	    !is_rejected_for_contents(ctx))
+		return;
+
+	r = rejected_disks + rejected_disk_count++;
+	r->handle = info->handle;
+	r->bytes_per_lba = info->bytes_per_lba;
+	r->lba_count = info->lba_count;
+	r->rv = rv;
+}
+
+void VbPrewarmLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
+{
+	VbDiskInfo *disk_info = NULL;
+	uint32_t disk_count = 0;
+	uint32_t i;
+
+	if (VB2_SUCCESS != VbExDiskGetInfo(&disk_info, &disk_count,
+					   get_info_flags))
+		return;
+
+	for (i = 0; i < disk_count; i++) {
+		if (!is_candidate_disk(&disk_info[i], get_info_flags))
+			continue;
+
+		LoadKernelParams params = {
+			.disk_handle = disk_info[i].handle,
+			.bytes_per_lba = disk_info[i].bytes_per_lba,
+			.gpt_lba_count = disk_info[i].lba_count,
+			.streaming_lba_count =
+				disk_info[i].streaming_lba_count ?:
+				disk_info[i].lba_count,
+			.boot_flags = disk_info[i].flags &
+				VB_DISK_FLAG_EXTERNAL_GPT ?
+				BOOT_FLAG_EXTERNAL_GPT : 0,
+		};
+		LoadKernelPrewarm(ctx, &params);
+	}
+
+	VbExDiskFreeInfo(disk_info, NULL);
+}
+
 vb2_error_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 {
 	vb2_error_t rv = VB2_ERROR_LK_NO_DISK_FOUND;
 	VbDiskInfo* disk_info = NULL;
 	uint32_t disk_count = 0;
+	int removable = !!(get_info_flags & VB_DISK_FLAG_REMOVABLE);
+	struct rejected_disk *rejected;
 	uint32_t i;
 
 	lkp.disk_handle = NULL;
@@ -71,22 +238,28 @@ vb2_error_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 					   get_info_flags))
 		disk_count = 0;
 
+	if (removable)
+		prune_rejected_disks(disk_info, disk_count);
+
+	/*
+	 * Let the platform start reading the primary GPT of every candidate
+	 * disk, so a slow disk early in the list doesn't hold up the reads
+	 * from the others.
+	 */
+	for (i = 0; i < disk_count; i++) {
+		if (!is_candidate_disk(&disk_info[i], get_info_flags) ||
+		    (removable && find_rejected_disk(&disk_info[i])))
+			continue;
+		VbExDiskPrefetch(disk_info[i].handle, 0,
+				 GPT_PMBR_SECTORS + GPT_HEADER_SECTORS +
+				 GPT_ENTRIES_ALLOC_SIZE /
+				 disk_info[i].bytes_per_lba);
+	}
+
 	/* Loop over disks */
 	for (i = 0; i < disk_count; i++) {
 		VB2_DEBUG("trying disk %d\n", (int)i);
-		/*
-		 * Sanity-check what we can. FWIW, VbTryLoadKernel() is always
-		 * called with only a single bit set in get_info_flags.
-		 *
-		 * Ensure that we got a partition with only the flags we asked
-		 * for.
-		 */
-		if (disk_info[i].bytes_per_lba < 512 ||
-			(disk_info[i].bytes_per_lba &
-				(disk_info[i].bytes_per_lba  - 1)) != 0 ||
-					16 > disk_info[i].lba_count ||
-					get_info_flags != (disk_info[i].flags &
-					~VB_DISK_FLAG_EXTERNAL_GPT)) {
+		if (!is_candidate_disk(&disk_info[i], get_info_flags)) {
 			VB2_DEBUG("  skipping: bytes_per_lba=%" PRIu64
 				  " lba_count=%" PRIu64 " flags=%#x\n",
 				  disk_info[i].bytes_per_lba,
@@ -94,6 +267,16 @@ vb2_error_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 				  disk_info[i].flags);
 			continue;
 		}
+
+		rejected = removable ? find_rejected_disk(&disk_info[i]) : NULL;
+		if (rejected) {
+			VB2_DEBUG("  skipping: already rejected (%#x)\n",
+				  rejected->rv);
+			if (VB2_ERROR_LK_INVALID_KERNEL_FOUND != rv)
+				rv = rejected->rv;
+			continue;
+		}
+
 		lkp.disk_handle = disk_info[i].handle;
 		lkp.bytes_per_lba = disk_info[i].bytes_per_lba;
 		lkp.gpt_lba_count = disk_info[i].lba_count;
@@ -101,6 +284,8 @@ vb2_error_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 						?: lkp.gpt_lba_count;
 		lkp.boot_flags |= disk_info[i].flags & VB_DISK_FLAG_EXTERNAL_GPT
 				? BOOT_FLAG_EXTERNAL_GPT : 0;
+		lkp.io_size = disk_info[i].io_size;
+		lkp.io_align = disk_info[i].io_align;
 
 		vb2_error_t new_rv = LoadKernel(ctx, &lkp);
 		VB2_DEBUG("LoadKernel() = %#x\n", new_rv);
@@ -111,6 +296,9 @@ vb2_error_t VbTryLoadKernel(struct vb2_context *ctx, uint32_t get_info_flags)
 			return VB2_SUCCESS;
 		}
 
+		if (removable)
+			add_rejected_disk(ctx, &disk_info[i], new_rv);
+
 		/* Don't update error if we already have a more specific one. */
 		if (VB2_ERROR_LK_INVALID_KERNEL_FOUND != rv)
 			rv = new_rv;
@@ -290,9 +478,42 @@ static void vb2_kernel_fill_kparams(struct vb2_context *ctx,
 	       sizeof(kparams->partition_guid));
 }
 
+_Static_assert(VBSD_MAX_TIMESTAMPS >= VB2_TIMESTAMP_COUNT,
+	       "VBSD_MAX_TIMESTAMPS too small");
+
+static void vb2_kernel_export_timestamps(struct vb2_context *ctx,
+					 VbSharedDataHeader *shared)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	uint32_t first = 0;
+	uint32_t i;
+
+	if (shared->struct_version < 3)
+		return;
+
+	/* Unroll the ring so the OS sees the oldest record first */
+	if (sd->timestamp_count > VB2_TIMESTAMP_COUNT)
+		first = sd->timestamp_count - VB2_TIMESTAMP_COUNT;
+
+	shared->timestamp_count = sd->timestamp_count - first;
+	for (i = 0; i < shared->timestamp_count; i++) {
+		const struct vb2_timestamp *ts = &sd->timestamps[
+			(first + i) % VB2_TIMESTAMP_COUNT];
+		shared->timestamps[i].event = ts->event;
+		shared->timestamps[i].time_us = ts->time_us;
+	}
+}
+
 vb2_error_t vb2_commit_data(struct vb2_context *ctx)
 {
-	vb2_error_t rv = vb2ex_commit_data(ctx);
+	uint32_t changed;
+	vb2_error_t rv;
+
+	/* Only write spaces which differ from what storage holds */
+	vb2_drop_unchanged_data(ctx);
+	changed = ctx->flags;
+	rv = vb2ex_commit_data(ctx);
+	vb2_mark_data_committed(ctx, changed);
 
 	switch (rv) {
 	case VB2_SUCCESS:
@@ -340,14 +561,21 @@ vb2_error_t VbSelectAndLoadKernel(struct vb2_context *ctx,
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	vb2_error_t rv, call_rv;
 
-	/* Init nvstorage space. TODO(kitching): Remove once we add assertions
-	   to vb2_nv_get and vb2_nv_set. */
-	vb2_nv_init(ctx);
+	/*
+	 * Init nvstorage space, unless the shared data was handed over by
+	 * firmware verification which already did.  TODO(kitching): Remove
+	 * once we add assertions to vb2_nv_get and vb2_nv_set.
+	 */
+	if (!(sd->status & VB2_SD_STATUS_NV_INIT))
+		vb2_nv_init(ctx);
 
 	rv = vb2_kernel_setup(ctx, shared, kparams);
 	if (rv)
 		goto VbSelectAndLoadKernel_exit;
 
+	/* Let the EC hash its RW image while kernel phase 1 runs */
+	vb2api_ec_sync_start(ctx);
+
 	rv = vb2api_kernel_phase1(ctx);
 	if (rv)
 		goto VbSelectAndLoadKernel_exit;
@@ -433,6 +661,8 @@ vb2_error_t VbSelectAndLoadKernel(struct vb2_context *ctx,
 	if (rv == VB2_SUCCESS)
 		vb2_kernel_fill_kparams(ctx, kparams);
 
+	vb2_kernel_export_timestamps(ctx, shared);
+
 	/* Commit data, but retain any previous errors */
 	call_rv = vb2_commit_data(ctx);
 	if (rv == VB2_SUCCESS)
@@ -17,6 +17,23 @@ static int audio_use_short;	/* Use short delay? */
 static uint64_t open_time;	/* Time of last open */
 static int beep_count;		/* Number of beeps so far */
 
+#define AUDIO_QUEUE_SIZE 8
+
+static struct audio_tone {
+	uint32_t msec;
+	uint32_t frequency;
+} audio_queue[AUDIO_QUEUE_SIZE];
+static uint32_t queue_head;	/* Index of the next tone to play */
+static uint32_t queue_count;	/* Number of tones waiting to play */
+static uint64_t tone_end;	/* Time the current tone or silence ends */
+static int no_background;	/* Last tone couldn't play in background */
+
+__attribute__((weak))
+vb2_error_t VbExBeepAsync(uint32_t msec, uint32_t frequency)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
 /**
  * Initialization function.
  */
@@ -27,6 +44,12 @@ void vb2_audio_start(struct vb2_context *ctx)
 	open_time = VbExGetTimer(); /* "zero" starts now */
 	beep_count = 0;
 
+	/* Forget tones left over from the last screen */
+	queue_head = 0;
+	queue_count = 0;
+	tone_end = 0;
+	no_background = 0;
+
 	/*
 	 * Use a short developer screen delay on the first audio if indicated
 	 * by GBB flags.
@@ -54,10 +77,72 @@ int vb2_audio_looping(void)
 	/* Otherwise, beep at 20 and 20.5 seconds */
 	if ((beep_count == 0 && now > 20000 * VB_MSEC_PER_SEC) ||
 	    (beep_count == 1 && now > 20500 * VB_MSEC_PER_SEC)) {
-		VbExBeep(250, 400);
+		vb2_audio_queue(250, 400);
 		beep_count++;
 	}
+	vb2_audio_poll();
 
 	/* Stop after 30 seconds */
 	return (now < 30 * VB_USEC_PER_SEC);
 }
+
+void vb2_audio_queue(uint32_t msec, uint32_t frequency)
+{
+	struct audio_tone *t;
+
+	/* Rather than drop a tone, wait for the oldest one to start */
+	while (queue_count >= AUDIO_QUEUE_SIZE)
+		VbExSleepMs(vb2_audio_poll());
+
+	t = audio_queue + (queue_head + queue_count++) % AUDIO_QUEUE_SIZE;
+	t->msec = msec;
+	t->frequency = frequency;
+}
+
+uint32_t vb2_audio_poll(void)
+{
+	struct audio_tone *t;
+	uint64_t now;
+
+	while (queue_count) {
+		now = VbExGetTimer();
+		if (now < tone_end)
+			return (tone_end - now + VB_USEC_PER_MSEC - 1) /
+				VB_USEC_PER_MSEC;
+
+		t = audio_queue + queue_head;
+		queue_head = (queue_head + 1) % AUDIO_QUEUE_SIZE;
+		queue_count--;
+
+		if (t->frequency)
+			no_background = VbExBeepAsync(t->msec, t->frequency) ==
+				VB2_ERROR_EX_UNIMPLEMENTED;
+
+		/* Without background sound, play the tone here and now */
+		if (no_background) {
+			if (t->frequency)
+				VbExBeep(t->msec, t->frequency);
+			else
+				VbExSleepMs(t->msec);
+			continue;
+		}
+
+		tone_end = now + t->msec * VB_USEC_PER_MSEC;
+	}
+
+	return 0;
+}
+
+void vb2_audio_sleep(uint32_t msec)
+{
+	uint32_t audio_ms;
+	uint32_t sleep_ms;
+
+	while (msec) {
+		audio_ms = vb2_audio_poll();
+		sleep_ms = audio_ms && audio_ms < msec ? audio_ms : msec;
+		VbExSleepMs(sleep_ms);
+		msec -= sleep_ms;
+	}
+	vb2_audio_poll();
+}
@@ -31,6 +31,14 @@ vb2_error_t VbExGetAltFwIdxMask(void) {
 	return 0;
 }
 
+__attribute__((weak))
+vb2_error_t VbExDisplayMenuSelection(uint32_t screen_type, uint32_t locale,
+				     uint32_t prev_index,
+				     uint32_t selected_index,
+				     uint32_t disabled_idx_mask) {
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
 vb2_error_t VbDisplayScreen(struct vb2_context *ctx, uint32_t screen, int force,
 			    const VbScreenData *data)
 {
@@ -53,7 +61,10 @@ vb2_error_t VbDisplayMenu(struct vb2_context *ctx, uint32_t screen, int force,
 			  uint32_t selected_index, uint32_t disabled_idx_mask)
 {
 	uint32_t locale;
+	uint32_t prev_index = disp_current_index;
 	uint32_t redraw_base_screen = 0;
+	int selection_only;
+	vb2_error_t rv;
 
 	/*
 	 * If requested screen/selected_index is the same as the current one,
@@ -71,6 +82,13 @@ vb2_error_t VbDisplayMenu(struct vb2_context *ctx, uint32_t screen, int force,
 	if (disp_current_screen != screen || force)
 		redraw_base_screen = 1;
 
+	/*
+	 * If only the selection moved, the backend may be able to redraw just
+	 * the highlight over the screen it already has.
+	 */
+	selection_only = !redraw_base_screen &&
+		disp_disabled_idx_mask == disabled_idx_mask;
+
 	/*
 	 * Keep track of the currently displayed screen and
 	 * selected_index
@@ -82,6 +100,14 @@ vb2_error_t VbDisplayMenu(struct vb2_context *ctx, uint32_t screen, int force,
 	/* Read the locale last saved */
 	locale = vb2_nv_get(ctx, VB2_NV_LOCALIZATION_INDEX);
 
+	if (selection_only) {
+		rv = VbExDisplayMenuSelection(screen, locale, prev_index,
+					      selected_index,
+					      disabled_idx_mask);
+		if (rv != VB2_ERROR_EX_UNIMPLEMENTED)
+			return rv;
+	}
+
 	return VbExDisplayMenu(screen, locale, selected_index,
 			       disabled_idx_mask, redraw_base_screen);
 }
@@ -214,19 +240,46 @@ const char *RecoveryReasonString(uint8_t code)
 
 #define DEBUG_INFO_SIZE 512
 
+/*
+ * The keys don't change during a boot, so they're only read and hashed the
+ * first time the debug info is shown.  An empty string means the key isn't
+ * available.
+ */
+static int debug_keys_hashed;
+static char rootkey_sha1sum[VB2_SHA1_DIGEST_SIZE * 2 + 1];
+static char recovery_key_sha1sum[VB2_SHA1_DIGEST_SIZE * 2 + 1];
+static char kernel_subkey_sha1sum[VB2_SHA1_DIGEST_SIZE * 2 + 1];
+
+static void HashDebugInfoKeys(struct vb2_context *ctx)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_packed_key *key;
+	struct vb2_workbuf wb;
+
+	vb2_workbuf_from_ctx(ctx, &wb);
+	if (!vb2_gbb_read_root_key(ctx, &key, NULL, &wb))
+		FillInSha1Sum(rootkey_sha1sum, key);
+
+	vb2_workbuf_from_ctx(ctx, &wb);
+	if (!vb2_gbb_read_recovery_key(ctx, &key, NULL, &wb))
+		FillInSha1Sum(recovery_key_sha1sum, key);
+
+	if (sd->vbsd)
+		FillInSha1Sum(kernel_subkey_sha1sum,
+			      &sd->vbsd->kernel_subkey);
+
+	debug_keys_hashed = 1;
+}
+
 vb2_error_t VbDisplayDebugInfo(struct vb2_context *ctx)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	struct vb2_gbb_header *gbb = vb2_get_gbb(ctx);
-	struct vb2_workbuf wb;
 	char buf[DEBUG_INFO_SIZE] = "";
-	char sha1sum[VB2_SHA1_DIGEST_SIZE * 2 + 1];
 	uint32_t used = 0;
 	vb2_error_t ret;
 	uint32_t i;
 
-	vb2_workbuf_from_ctx(ctx, &wb);
-
 	/* Add hardware ID */
 	{
 		char hwid[VB2_GBB_HWID_MAX_SIZE];
@@ -306,39 +359,36 @@ vb2_error_t VbDisplayDebugInfo(struct vb2_context *ctx)
 	used += Uint64ToString(buf + used, DEBUG_INFO_SIZE - used,
 			       gbb->flags, 16, 8);
 
+	/*
+	 * Reading the keys from flash takes a while, so the first time round
+	 * show what we have while they're hashed.
+	 */
+	if (!debug_keys_hashed) {
+		VbExDisplayDebugInfo(buf, 0);
+		HashDebugInfoKeys(ctx);
+	}
+
 	/* Add sha1sum for Root & Recovery keys */
-	{
-		struct vb2_packed_key *key;
-		struct vb2_workbuf wblocal = wb;
-		ret = vb2_gbb_read_root_key(ctx, &key, NULL, &wblocal);
-		if (!ret) {
-			FillInSha1Sum(sha1sum, key);
-			used += StrnAppend(buf + used, "\ngbb.rootkey: ",
-					   DEBUG_INFO_SIZE - used);
-			used += StrnAppend(buf + used, sha1sum,
-					   DEBUG_INFO_SIZE - used);
-		}
+	if (*rootkey_sha1sum) {
+		used += StrnAppend(buf + used, "\ngbb.rootkey: ",
+				   DEBUG_INFO_SIZE - used);
+		used += StrnAppend(buf + used, rootkey_sha1sum,
+				   DEBUG_INFO_SIZE - used);
 	}
 
-	{
-		struct vb2_packed_key *key;
-		struct vb2_workbuf wblocal = wb;
-		ret = vb2_gbb_read_recovery_key(ctx, &key, NULL, &wblocal);
-		if (!ret) {
-			FillInSha1Sum(sha1sum, key);
-			used += StrnAppend(buf + used, "\ngbb.recovery_key: ",
-					   DEBUG_INFO_SIZE - used);
-			used += StrnAppend(buf + used, sha1sum,
-					   DEBUG_INFO_SIZE - used);
-		}
+	if (*recovery_key_sha1sum) {
+		used += StrnAppend(buf + used, "\ngbb.recovery_key: ",
+				   DEBUG_INFO_SIZE - used);
+		used += StrnAppend(buf + used, recovery_key_sha1sum,
+				   DEBUG_INFO_SIZE - used);
 	}
 
 	/* If we're in dev-mode, show the kernel subkey that we expect, too. */
-	if (0 == sd->recovery_reason && sd->vbsd) {
-		FillInSha1Sum(sha1sum, &sd->vbsd->kernel_subkey);
+	if (0 == sd->recovery_reason && *kernel_subkey_sha1sum) {
 		used += StrnAppend(buf + used,
 				"\nkernel_subkey: ", DEBUG_INFO_SIZE - used);
-		used += StrnAppend(buf + used, sha1sum, DEBUG_INFO_SIZE - used);
+		used += StrnAppend(buf + used, kernel_subkey_sha1sum,
+				   DEBUG_INFO_SIZE - used);
 	}
 
 	/* Make sure we finish with a newline */
@@ -31,6 +31,59 @@ enum vboot_mode {
 	kBootDev = 2        /* Developer boot - self-signed kernel ok */
 };
 
+/* Streams which can't queue reads fall back to VbExStreamRead() */
+__attribute__((weak))
+vb2_error_t VbExStreamSubmitRead(VbExStream_t stream, uint32_t bytes,
+				 void *buffer)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+vb2_error_t VbExStreamWaitRead(VbExStream_t stream)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+vb2_error_t VbExStreamSkip(VbExStream_t stream, uint32_t bytes)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+/**
+ * Skip forward in a stream.
+ *
+ * If the stream can't skip, read and discard the data instead.
+ *
+ * @param stream	Stream to skip forward in
+ * @param bytes		Number of bytes to skip
+ * @param scratch	Buffer to read discarded data into
+ * @param scratch_size	Size of scratch buffer in bytes
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+static vb2_error_t vb2_stream_skip(VbExStream_t stream, uint32_t bytes,
+				   uint8_t *scratch, uint32_t scratch_size)
+{
+	vb2_error_t rv = VbExStreamSkip(stream, bytes);
+	if (rv != VB2_ERROR_EX_UNIMPLEMENTED)
+		return rv;
+
+	if (!scratch_size)
+		return VB2_ERROR_UNKNOWN;
+
+	while (bytes) {
+		uint32_t chunk = VB2_MIN(bytes, scratch_size);
+
+		rv = VbExStreamRead(stream, chunk, scratch);
+		if (rv)
+			return rv;
+		bytes -= chunk;
+	}
+
+	return VB2_SUCCESS;
+}
+
 /**
  * Return the boot mode based on the parameters.
  *
@@ -97,51 +150,49 @@ static struct vb2_kernel_preamble *get_preamble(uint8_t *kbuf)
 			(kbuf + get_keyblock(kbuf)->keyblock_size);
 }
 
-/**
- * Return the offset of the kernel body from the start of the vblock.
- *
- * Must only be called during or after vb2_verify_kernel_vblock().
- *
- * @param kbuf		Buffer containing vblock
- * @return The offset of the kernel body from the vblock start, in bytes.
+/*
+ * Where the pieces of a kernel vblock live.  Filled in once by
+ * vb2_verify_kernel_vblock(), so loading the body doesn't have to walk the
+ * headers again.
  */
-static uint32_t get_body_offset(uint8_t *kbuf)
-{
-	return (get_keyblock(kbuf)->keyblock_size +
-		get_preamble(kbuf)->preamble_size);
-}
+struct vb2_kernel_layout {
+	struct vb2_keyblock *keyblock;
+	struct vb2_kernel_preamble *preamble;
+	/* Offset of the kernel body from the vblock start, in bytes */
+	uint32_t body_offset;
+};
 
 /**
  * Verify a kernel vblock.
  *
  * @param kbuf		Buffer containing the vblock
  * @param kbuf_size	Size of the buffer in bytes
- * @param kernel_subkey	Packed kernel subkey to use in validating keyblock
+ * @param kernel_subkey	Unpacked kernel subkey to use in validating keyblock,
+ *			or NULL if it could not be unpacked
  * @param params	Load kernel parameters
  * @param min_version	Minimum kernel version
  * @param shpart	Destination for verification results
+ * @param data_key	Destination for the unpacked kernel data key
+ * @param layout	Destination for the vblock layout
  * @param wb		Work buffer.  Must be at least
  *			VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES bytes.
  * @return VB2_SUCCESS, or non-zero error code.
  */
 static vb2_error_t vb2_verify_kernel_vblock(
 	struct vb2_context *ctx, uint8_t *kbuf, uint32_t kbuf_size,
-	const struct vb2_packed_key *kernel_subkey,
+	const struct vb2_public_key *kernel_subkey,
 	const LoadKernelParams *params, uint32_t min_version,
-	VbSharedDataKernelPart *shpart, struct vb2_workbuf *wb)
+	VbSharedDataKernelPart *shpart, struct vb2_public_key *data_key,
+	struct vb2_kernel_layout *layout, struct vb2_workbuf *wb)
 {
-	/* Unpack kernel subkey */
-	struct vb2_public_key kernel_subkey2;
-	if (VB2_SUCCESS != vb2_unpack_key(&kernel_subkey2, kernel_subkey)) {
-		VB2_DEBUG("Unable to unpack kernel subkey\n");
+	if (!kernel_subkey)
 		return VB2_ERROR_VBLOCK_KERNEL_SUBKEY;
-	}
 
 	/* Verify the keyblock. */
 	int keyblock_valid = 1;  /* Assume valid */
 	struct vb2_keyblock *keyblock = get_keyblock(kbuf);
 	if (VB2_SUCCESS != vb2_verify_keyblock(keyblock, kbuf_size,
-					       &kernel_subkey2, wb)) {
+					       kernel_subkey, wb)) {
 		VB2_DEBUG("Verifying keyblock signature failed.\n");
 		shpart->check_result = VBSD_LKP_CHECK_KEYBLOCK_SIG;
 		keyblock_valid = 0;
@@ -213,11 +264,15 @@ static vb2_error_t vb2_verify_kernel_vblock(
 		struct vb2_packed_key *key = &keyblock->data_key;
 		uint8_t *buf = ((uint8_t *)key) + key->key_offset;
 		uint32_t buflen = key->key_size;
-		uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+		struct vb2_workbuf wblocal = *wb;
+		uint8_t *digest = vb2_workbuf_alloc(&wblocal,
+						    VB2_SHA256_DIGEST_SIZE);
+		if (!digest)
+			return VB2_ERROR_VBLOCK_WORKBUF;
 
 		VB2_DEBUG("Checking developer key hash.\n");
 		vb2_digest_buffer(buf, buflen, VB2_HASH_SHA256,
-				  digest, sizeof(digest));
+				  digest, VB2_SHA256_DIGEST_SIZE);
 
 		uint8_t *fwmp_dev_key_hash =
 			vb2_secdata_fwmp_get_dev_key_hash(ctx);
@@ -243,9 +298,11 @@ static vb2_error_t vb2_verify_kernel_vblock(
 		}
 	}
 
-	/* Get key for preamble verification from the keyblock. */
-	struct vb2_public_key data_key;
-	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key)) {
+	/*
+	 * Get key for preamble verification from the keyblock.  The caller
+	 * reuses it to verify the kernel data.
+	 */
+	if (VB2_SUCCESS != vb2_unpack_key(data_key, &keyblock->data_key)) {
 		VB2_DEBUG("Unable to unpack kernel data key\n");
 		shpart->check_result = VBSD_LKP_CHECK_DATA_KEY_PARSE;
 		return VB2_ERROR_UNKNOWN;
@@ -256,7 +313,7 @@ static vb2_error_t vb2_verify_kernel_vblock(
 	if (VB2_SUCCESS !=
 	    vb2_verify_kernel_preamble(preamble,
 				       kbuf_size - keyblock->keyblock_size,
-				       &data_key,
+				       data_key,
 				       wb)) {
 		VB2_DEBUG("Preamble verification failed.\n");
 		shpart->check_result = VBSD_LKP_CHECK_VERIFY_PREAMBLE;
@@ -288,6 +345,14 @@ static vb2_error_t vb2_verify_kernel_vblock(
 	if (keyblock_valid)
 		shpart->flags |= VBSD_LKP_FLAG_KEYBLOCK_VALID;
 
+	/*
+	 * Preamble verification checked preamble_size against what's left of
+	 * kbuf after the keyblock, so this can't overflow.
+	 */
+	layout->keyblock = keyblock;
+	layout->preamble = preamble;
+	layout->body_offset = keyblock->keyblock_size + preamble->preamble_size;
+
 	return VB2_SUCCESS;
 }
 
@@ -296,18 +361,160 @@ enum vb2_load_partition_flags {
 	VB2_LOAD_PARTITION_VBLOCK_ONLY = (1 << 0),
 };
 
-#define KBUF_SIZE 65536  /* Bytes to read at start of kernel partition */
+#define KBUF_SIZE 65536  /* Max bytes of vblock at start of kernel partition */
+#define BODY_CHUNK_SIZE 65536  /* Bytes of kernel body to read per hash step */
 
 /* Minimum context work buffer size needed for vb2_load_partition() */
 #define VB2_LOAD_PARTITION_WORKBUF_BYTES	\
-	(VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES + KBUF_SIZE)
+	(VB2_VERIFY_KERNEL_PREAMBLE_WORKBUF_BYTES + KBUF_SIZE + \
+	 sizeof(struct vb2_digest_context) + VB2_MAX_DIGEST_SIZE)
+
+/**
+ * Read the vblock at the start of a kernel partition into kbuf.
+ *
+ * The vblock size isn't known until its headers have been read, so read the
+ * headers first and then the rest of the vblock, in whole sectors.  This
+ * keeps kernel body data out of kbuf, so the body can be read straight into
+ * the kernel buffer.  The header fields are only used to size the reads;
+ * they are verified along with the rest of the vblock afterwards.
+ *
+ * @param stream	Stream to read from
+ * @param kbuf		Destination buffer, KBUF_SIZE bytes
+ * @param sector_bytes	Sector size of the stream
+ * @return The number of bytes read into kbuf, or 0 if error.
+ */
+static uint32_t vb2_read_vblock(VbExStream_t stream, uint8_t *kbuf,
+				uint32_t sector_bytes)
+{
+	uint32_t have = 0;
+	uint32_t want = sector_bytes;
+
+	/* Odd sector sizes just read the whole buffer */
+	if (!sector_bytes || KBUF_SIZE % sector_bytes)
+		want = sector_bytes = KBUF_SIZE;
+
+	while (have < want) {
+		if (VbExStreamRead(stream, want - have, kbuf + have))
+			return 0;
+		have = want;
+
+		/* Work out how much of the vblock the headers so far cover */
+		uint64_t need = sizeof(struct vb2_keyblock);
+		if (have >= need)
+			need = (uint64_t)get_keyblock(kbuf)->keyblock_size +
+				sizeof(struct vb2_kernel_preamble);
+		if (have >= need)
+			need = (uint64_t)get_keyblock(kbuf)->keyblock_size +
+				get_preamble(kbuf)->preamble_size;
+		if (need > KBUF_SIZE)
+			need = KBUF_SIZE;
+		want = ((uint32_t)need + sector_bytes - 1) /
+			sector_bytes * sector_bytes;
+	}
+
+	return have;
+}
+
+/**
+ * Return the size of the next kernel body read.
+ *
+ * Reads are the disk's preferred size, shortened where needed so none of them
+ * crosses a boundary of the disk's preferred alignment.  Hints which aren't
+ * whole sectors are ignored.
+ *
+ * @param params	Load-kernel parameters
+ * @param disk_offset	Byte offset on the disk where the read starts
+ * @param left		Number of body bytes left to read
+ * @return The number of bytes to read.
+ */
+static uint32_t body_read_size(const LoadKernelParams *params,
+			       uint64_t disk_offset, uint32_t left)
+{
+	uint64_t lba = params->bytes_per_lba ? params->bytes_per_lba : 1;
+	uint32_t size = BODY_CHUNK_SIZE;
+
+	if (params->io_size && !(params->io_size % lba))
+		size = params->io_size;
+
+	if (params->io_align && !(params->io_align % lba)) {
+		uint32_t past = (disk_offset + size) % params->io_align;
+		if (past < size)
+			size -= past;
+	}
+
+	return VB2_MIN(size, left);
+}
+
+/**
+ * Return the throughput stats for a partition tracked in this LoadKernel()
+ * call, or NULL if the shared data is too old to hold them.
+ */
+static VbSharedDataKernelPartStats *vb2_kernel_part_stats(
+	struct vb2_context *ctx, const VbSharedDataKernelPart *shpart)
+{
+	VbSharedDataHeader *shared = vb2_get_sd(ctx)->vbsd;
+	uint32_t call = (shared->lk_call_count - 1) &
+			(VBSD_MAX_KERNEL_CALLS - 1);
+
+	if (shared->struct_version < 4)
+		return NULL;
+
+	return &shared->lk_part_stats[call]
+		[shpart - shared->lk_calls[call].parts];
+}
+
+/**
+ * Start hashing the kernel body, on the hardware crypto engine if there is
+ * one that supports the algorithm and the preamble doesn't forbid it.
+ */
+static vb2_error_t vb2_kernel_digest_init(
+	struct vb2_digest_context *dc, const struct vb2_public_key *data_key,
+	const struct vb2_kernel_preamble *preamble)
+{
+	vb2_error_t rv;
+
+	if (vb2_kernel_get_flags(preamble) &
+	    VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO) {
+		VB2_DEBUG("HW crypto forbidden by kernel preamble, using SW\n");
+		return vb2_digest_init(dc, data_key->hash_alg);
+	}
+
+	rv = vb2ex_hwcrypto_digest_init(data_key->hash_alg,
+					preamble->body_signature.data_size);
+	if (!rv) {
+		VB2_DEBUG("Using HW crypto engine for hash_alg %d\n",
+			  data_key->hash_alg);
+		dc->hash_alg = data_key->hash_alg;
+		dc->using_hwcrypto = 1;
+		dc->hwcrypto_pending = 0;
+		return VB2_SUCCESS;
+	}
+	if (rv != VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED)
+		return rv;
+
+	VB2_DEBUG("HW crypto for hash_alg %d not supported, using SW\n",
+		  data_key->hash_alg);
+	return vb2_digest_init(dc, data_key->hash_alg);
+}
+
+static vb2_error_t vb2_kernel_digest_extend(struct vb2_digest_context *dc,
+					    const uint8_t *buf, uint32_t size)
+{
+	if (!size)
+		return VB2_SUCCESS;
+	if (dc->using_hwcrypto)
+		return vb2ex_hwcrypto_digest_extend(buf, size);
+	return vb2_digest_extend(dc, buf, size);
+}
 
 /**
  * Load and verify a partition from the stream.
  *
  * @param ctx		Vboot context
  * @param stream	Stream to load kernel from
- * @param kernel_subkey	Key to use to verify vblock
+ * @param part_start	Start of the partition on the disk, in sectors
+ * @param kernel_subkey	Unpacked key to use to verify vblock, or NULL if
+ *			it could not be unpacked
  * @param flags		Flags (one or more of vb2_load_partition_flags)
  * @param params	Load-kernel parameters
  * @param min_version	Minimum kernel version from TPM
@@ -316,13 +523,22 @@ enum vb2_load_partition_flags {
  * @return VB2_SUCCESS, or non-zero error code.
  */
 static vb2_error_t vb2_load_partition(
-	struct vb2_context *ctx, VbExStream_t stream,
-	const struct vb2_packed_key *kernel_subkey, uint32_t flags,
+	struct vb2_context *ctx, VbExStream_t stream, uint64_t part_start,
+	const struct vb2_public_key *kernel_subkey, uint32_t flags,
 	LoadKernelParams *params, uint32_t min_version,
 	VbSharedDataKernelPart *shpart, struct vb2_workbuf *wb)
 {
-	uint64_t read_us = 0, start_ts;
+	uint64_t read_us = 0, start_ts, elapsed;
 	struct vb2_workbuf wblocal = *wb;
+	struct vb2_public_key data_key;
+	struct vb2_kernel_layout layout;
+
+	/* Accumulate into the shared data, if it has room for stats */
+	VbSharedDataKernelPartStats scratch = {0};
+	VbSharedDataKernelPartStats *stats = vb2_kernel_part_stats(ctx,
+								   shpart);
+	if (!stats)
+		stats = &scratch;
 
 	/* Allocate kernel header buffer in workbuf */
 	uint8_t *kbuf = vb2_workbuf_alloc(&wblocal, KBUF_SIZE);
@@ -330,38 +546,33 @@ static vb2_error_t vb2_load_partition(
 		return VB2_ERROR_LOAD_PARTITION_WORKBUF;
 
 	start_ts = VbExGetTimer();
-	if (VbExStreamRead(stream, KBUF_SIZE, kbuf)) {
+	uint32_t vblock_size = vb2_read_vblock(stream, kbuf,
+					       (uint32_t)params->bytes_per_lba);
+	if (!vblock_size) {
 		VB2_DEBUG("Unable to read start of partition.\n");
 		shpart->check_result = VBSD_LKP_CHECK_READ_START;
 		return VB2_ERROR_LOAD_PARTITION_READ_VBLOCK;
 	}
-	read_us += VbExGetTimer() - start_ts;
+	elapsed = VbExGetTimer() - start_ts;
+	read_us += elapsed;
+	stats->read_us += elapsed;
+	stats->bytes_read += vblock_size;
 
-	if (VB2_SUCCESS !=
-	    vb2_verify_kernel_vblock(ctx, kbuf, KBUF_SIZE, kernel_subkey,
-				     params, min_version, shpart, &wblocal)) {
+	start_ts = VbExGetTimer();
+	vb2_error_t vblock_rv =
+		vb2_verify_kernel_vblock(ctx, kbuf, vblock_size, kernel_subkey,
+					 params, min_version, shpart, &data_key,
+					 &layout, &wblocal);
+	stats->verify_us += VbExGetTimer() - start_ts;
+	if (VB2_SUCCESS != vblock_rv)
 		return VB2_ERROR_LOAD_PARTITION_VERIFY_VBLOCK;
-	}
+	vb2_record_timestamp(ctx, VB2_TS_KERNEL_VBLOCK_VERIFIED);
 
 	if (flags & VB2_LOAD_PARTITION_VBLOCK_ONLY)
 		return VB2_SUCCESS;
 
-	struct vb2_keyblock *keyblock = get_keyblock(kbuf);
-	struct vb2_kernel_preamble *preamble = get_preamble(kbuf);
-
-	/*
-	 * Make sure the kernel starts at or before what we already read into
-	 * kbuf.
-	 *
-	 * We could deal with a larger offset by reading and discarding the
-	 * data in between the vblock and the kernel data.
-	 */
-	uint32_t body_offset = get_body_offset(kbuf);
-	if (body_offset > KBUF_SIZE) {
-		shpart->check_result = VBSD_LKP_CHECK_BODY_OFFSET;
-		VB2_DEBUG("Kernel body offset is %u > 64KB.\n", body_offset);
-		return VB2_ERROR_LOAD_PARTITION_BODY_OFFSET;
-	}
+	struct vb2_kernel_preamble *preamble = layout.preamble;
+	uint32_t body_offset = layout.body_offset;
 
 	uint8_t *kernbuf = params->kernel_buffer;
 	uint32_t kernbuf_size = params->kernel_buffer_size;
@@ -379,45 +590,134 @@ static vb2_error_t vb2_load_partition(
 	uint8_t *body_readptr = kernbuf;
 
 	/*
-	 * If we've already read part of the kernel, copy that to the beginning
-	 * of the kernel buffer.
+	 * Hash the body as it comes in, so each chunk is hashed while it is
+	 * still in cache instead of being read back from memory afterwards.
 	 */
-	uint32_t body_copied = KBUF_SIZE - body_offset;
-	if (body_copied > body_toread)
-		body_copied = body_toread;  /* Don't over-copy tiny kernel */
-	memcpy(body_readptr, kbuf + body_offset, body_copied);
-	body_toread -= body_copied;
-	body_readptr += body_copied;
+	uint32_t digest_size = vb2_digest_size(data_key.hash_alg);
+	struct vb2_digest_context *dc =
+		vb2_workbuf_alloc(&wblocal, sizeof(*dc));
+	uint8_t *digest = vb2_workbuf_alloc(&wblocal, digest_size);
+	if (!dc || !digest)
+		return VB2_ERROR_LOAD_PARTITION_WORKBUF;
 
-	/* Read the kernel data */
+	if (vb2_kernel_digest_init(dc, &data_key, preamble)) {
+		shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
+		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+	}
+
+	/*
+	 * If the kernel starts past what we already read into kbuf, skip the
+	 * gap.  Otherwise, copy the part we've already read (at most the tail
+	 * of the last vblock sector) to the beginning of the kernel buffer.
+	 */
+	uint32_t body_copied = 0;
+	if (body_offset > vblock_size) {
+		VB2_DEBUG("Skipping to kernel body at offset %u.\n",
+			  body_offset);
+		if (vb2_stream_skip(stream, body_offset - vblock_size,
+				    kernbuf, kernbuf_size)) {
+			shpart->check_result = VBSD_LKP_CHECK_BODY_OFFSET;
+			VB2_DEBUG("Unable to skip to kernel body.\n");
+			return VB2_ERROR_LOAD_PARTITION_BODY_OFFSET;
+		}
+	} else {
+		/* Don't over-copy tiny kernel */
+		body_copied = VB2_MIN(vblock_size - body_offset, body_toread);
+		memcpy(body_readptr, kbuf + body_offset, body_copied);
+	}
 	start_ts = VbExGetTimer();
-	if (body_toread && VbExStreamRead(stream, body_toread, body_readptr)) {
-		VB2_DEBUG("Unable to read kernel data.\n");
-		shpart->check_result = VBSD_LKP_CHECK_READ_DATA;
-		return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+	if (vb2_kernel_digest_extend(dc, body_readptr, body_copied)) {
+		shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
+		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
 	}
-	read_us += VbExGetTimer() - start_ts;
-	VB2_DEBUG("read %" PRIu32 " KB in %" PRIu64 " ms at %" PRIu64 " KB/s.\n",
-		  (body_toread + KBUF_SIZE) / 1024, read_us / 1000,
-		  ((uint64_t)(body_toread + KBUF_SIZE) * 1000 * 1000) /
-			  (read_us * 1024));
+	stats->hash_us += VbExGetTimer() - start_ts;
+	body_toread -= body_copied;
+	body_readptr += body_copied;
 
-	/* Get key for preamble/data verification from the keyblock. */
-	struct vb2_public_key data_key;
-	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key)) {
-		VB2_DEBUG("Unable to unpack kernel data key\n");
-		shpart->check_result = VBSD_LKP_CHECK_DATA_KEY_PARSE;
-		return VB2_ERROR_LOAD_PARTITION_DATA_KEY;
+	/*
+	 * Read and hash the rest of the kernel data.  If the stream can queue
+	 * reads, keep several chunks in flight so the device stays busy while
+	 * earlier chunks are hashed.
+	 */
+	uint64_t read_offset = part_start * params->bytes_per_lba +
+		body_offset + body_copied;
+	uint64_t submit_offset = read_offset;
+	uint8_t *submit_ptr = body_readptr;
+	uint32_t submit_left = body_toread;
+	uint32_t in_flight = 0;
+	int queued = 1;
+	uint32_t body_left = body_toread;
+	while (body_left) {
+		uint32_t chunk = body_read_size(params, read_offset, body_left);
+		vb2_error_t rv = VB2_SUCCESS;
+
+		start_ts = VbExGetTimer();
+		while (queued && submit_left &&
+		       in_flight < VB_STREAM_MAX_READS) {
+			uint32_t size = body_read_size(params, submit_offset,
+						       submit_left);
+
+			rv = VbExStreamSubmitRead(stream, size, submit_ptr);
+			if (rv == VB2_ERROR_EX_UNIMPLEMENTED &&
+			    submit_left == body_toread) {
+				queued = 0;
+				rv = VB2_SUCCESS;
+				break;
+			}
+			if (rv)
+				break;
+			in_flight++;
+			submit_left -= size;
+			submit_ptr += size;
+			submit_offset += size;
+		}
+		if (rv == VB2_SUCCESS)
+			rv = queued ? VbExStreamWaitRead(stream) :
+				VbExStreamRead(stream, chunk, body_readptr);
+		if (rv) {
+			VB2_DEBUG("Unable to read kernel data.\n");
+			shpart->check_result = VBSD_LKP_CHECK_READ_DATA;
+			return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+		}
+		elapsed = VbExGetTimer() - start_ts;
+		read_us += elapsed;
+		stats->read_us += elapsed;
+		stats->bytes_read += chunk;
+		if (queued)
+			in_flight--;
+
+		start_ts = VbExGetTimer();
+		if (vb2_kernel_digest_extend(dc, body_readptr, chunk)) {
+			shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
+			return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+		}
+		stats->hash_us += VbExGetTimer() - start_ts;
+		body_left -= chunk;
+		body_readptr += chunk;
+		read_offset += chunk;
 	}
+	vb2_record_timestamp(ctx, VB2_TS_KERNEL_BODY_READ);
+	VB2_DEBUG("read %" PRIu32 " KB in %" PRIu64 " ms at %" PRIu64 " KB/s.\n",
+		  (body_toread + vblock_size) / 1024, read_us / 1000,
+		  ((uint64_t)(body_toread + vblock_size) * 1000 * 1000) /
+			  (VB2_MAX(read_us, 1) * 1024));
 
-	/* Verify kernel data */
-	if (VB2_SUCCESS != vb2_verify_data(kernbuf, kernbuf_size,
-					   &preamble->body_signature,
-					   &data_key, &wblocal)) {
+	/* Verify kernel data against the accumulated digest */
+	start_ts = VbExGetTimer();
+	vb2_error_t body_rv = dc->using_hwcrypto ?
+		vb2ex_hwcrypto_digest_finalize(digest, digest_size) :
+		vb2_digest_finalize(dc, digest, digest_size);
+	if (VB2_SUCCESS == body_rv)
+		body_rv = vb2_verify_digest(&data_key,
+					    &preamble->body_signature,
+					    digest, &wblocal);
+	stats->verify_us += VbExGetTimer() - start_ts;
+	if (VB2_SUCCESS != body_rv) {
 		VB2_DEBUG("Kernel data verification failed.\n");
 		shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
 		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
 	}
+	vb2_record_timestamp(ctx, VB2_TS_KERNEL_BODY_VERIFIED);
 
 	/* If we're still here, the kernel is valid */
 	VB2_DEBUG("Partition is good.\n");
@@ -435,6 +735,188 @@ static vb2_error_t vb2_load_partition(
 	return VB2_SUCCESS;
 }
 
+/**
+ * Start tracking a kernel partition in the shared data for this call.
+ *
+ * This wraps around if called many times, so the partition entry is
+ * initialized each time.
+ */
+static VbSharedDataKernelPart *vb2_track_kernel_part(
+	struct vb2_context *ctx, VbSharedDataKernelCall *shcall,
+	GptData *gpt, uint64_t part_start, uint64_t part_size)
+{
+	VbSharedDataKernelPart *shpart =
+			shcall->parts + (shcall->kernel_parts_found
+			& (VBSD_MAX_KERNEL_PARTS - 1));
+	VbSharedDataKernelPartStats *stats;
+
+	memset(shpart, 0, sizeof(VbSharedDataKernelPart));
+	stats = vb2_kernel_part_stats(ctx, shpart);
+	if (stats)
+		memset(stats, 0, sizeof(*stats));
+	shpart->sector_start = part_start;
+	shpart->sector_count = part_size;
+	/*
+	 * TODO: GPT partitions start at 1, but cgptlib starts them at
+	 * 0.  Adjust here, until cgptlib is fixed.
+	 */
+	shpart->gpt_index = (uint8_t)(gpt->current_kernel + 1);
+	shcall->kernel_parts_found++;
+
+	return shpart;
+}
+
+/**
+ * Open a stream on the current GPT kernel entry and load it.
+ *
+ * Marks the entry bad in the GPT if it fails to load.  Parameters are as for
+ * vb2_load_partition().
+ */
+static vb2_error_t vb2_load_kernel_entry(
+	struct vb2_context *ctx, GptData *gpt,
+	uint64_t part_start, uint64_t part_size,
+	const struct vb2_public_key *kernel_subkey, uint32_t flags,
+	LoadKernelParams *params, uint32_t min_version,
+	VbSharedDataKernelPart *shpart, struct vb2_workbuf *wb)
+{
+	VbExStream_t stream = NULL;
+	vb2_error_t rv;
+
+	if (VbExStreamOpen(params->disk_handle,
+			   part_start, part_size, &stream)) {
+		VB2_DEBUG("Partition error getting stream.\n");
+		shpart->check_result = VBSD_LKP_CHECK_TOO_SMALL;
+		rv = VB2_ERROR_LOAD_PARTITION_READ_VBLOCK;
+	} else {
+		rv = vb2_load_partition(ctx, stream, part_start,
+					kernel_subkey, flags, params,
+					min_version, shpart, wb);
+		VbExStreamClose(stream);
+	}
+
+	if (rv != VB2_SUCCESS) {
+		VB2_DEBUG("Marking kernel as invalid.\n");
+		GptUpdateKernelEntry(gpt, GPT_UPDATE_ENTRY_BAD);
+	}
+
+	return rv;
+}
+
+/* Kernel partition whose vblock passed vb2_probe_vblocks() */
+struct vb2_kernel_candidate {
+	uint64_t part_start;
+	uint64_t part_size;
+	int gpt_entry;			/* cgptlib entry index */
+	VbSharedDataKernelPart *shpart;
+};
+
+/**
+ * Verify the vblocks of the next batch of GPT kernel entries.
+ *
+ * Entries with bad vblocks are marked bad in the GPT, so only the bodies of
+ * entries which can actually boot are read later.  At most
+ * VBSD_MAX_KERNEL_PARTS entries are probed, since that is how many results
+ * the shared data can hold; any further entries are left for the caller to
+ * iterate over.
+ *
+ * @param cands		Destination for candidates with good vblocks
+ * @param probed	Destination for the number of entries probed
+ * @return The number of candidates stored in cands.
+ */
+static uint32_t vb2_probe_vblocks(
+	struct vb2_context *ctx, GptData *gpt,
+	const struct vb2_public_key *kernel_subkey,
+	LoadKernelParams *params, uint32_t min_version,
+	VbSharedDataKernelCall *shcall, struct vb2_kernel_candidate *cands,
+	uint32_t *probed, struct vb2_workbuf *wb)
+{
+	uint64_t part_start, part_size;
+	uint32_t count = 0;
+
+	*probed = 0;
+	while (*probed < VBSD_MAX_KERNEL_PARTS &&
+	       GPT_SUCCESS == GptNextKernelEntry(gpt, &part_start,
+						 &part_size)) {
+		VbSharedDataKernelPart *shpart = vb2_track_kernel_part(
+				ctx, shcall, gpt, part_start, part_size);
+		(*probed)++;
+
+		VB2_DEBUG("Probing kernel entry at %" PRIu64 "\n", part_start);
+		if (vb2_load_kernel_entry(ctx, gpt, part_start, part_size,
+					  kernel_subkey,
+					  VB2_LOAD_PARTITION_VBLOCK_ONLY,
+					  params, min_version, shpart, wb))
+			continue;
+
+		cands[count].part_start = part_start;
+		cands[count].part_size = part_size;
+		cands[count].gpt_entry = gpt->current_kernel;
+		cands[count].shpart = shpart;
+		count++;
+	}
+
+	return count;
+}
+
+/**
+ * Read and parse the GPT of the disk in params.
+ *
+ * GPT data already read and validated by an earlier call is reused, if it
+ * still matches the disk.  The caller must free gpt with
+ * WriteAndFreeGptData() either way.
+ *
+ * @return 0 if successful, or a VBSD_LKC_CHECK_GPT_* error.
+ */
+static uint8_t vb2_read_gpt(const LoadKernelParams *params, GptData *gpt)
+{
+	gpt->sector_bytes = (uint32_t)params->bytes_per_lba;
+	gpt->streaming_drive_sectors = params->streaming_lba_count;
+	gpt->gpt_drive_sectors = params->gpt_lba_count;
+	gpt->flags = params->boot_flags & BOOT_FLAG_EXTERNAL_GPT
+			? GPT_FLAG_EXTERNAL : 0;
+	if (0 == GptCacheLookup(params->disk_handle, gpt)) {
+		/* Already read and validated by an earlier call */
+		VB2_DEBUG("Using cached GPT data\n");
+		return 0;
+	}
+
+	if (0 != AllocAndReadGptData(params->disk_handle, gpt)) {
+		VB2_DEBUG("Unable to read GPT data\n");
+		return VBSD_LKC_CHECK_GPT_READ_ERROR;
+	}
+
+	/* Initialize GPT library */
+	if (GPT_SUCCESS != GptInit(gpt)) {
+		VB2_DEBUG("Error parsing GPT\n");
+		return VBSD_LKC_CHECK_GPT_PARSE_ERROR;
+	}
+
+	GptCacheStore(params->disk_handle, gpt);
+	return 0;
+}
+
+void LoadKernelPrewarm(struct vb2_context *ctx, LoadKernelParams *params)
+{
+	struct vb2_workbuf wb;
+	uint64_t part_start, part_size;
+
+	vb2_workbuf_from_ctx(ctx, &wb);
+	GptData *gpt = vb2_workbuf_alloc(&wb, sizeof(*gpt));
+	if (!gpt)
+		return;
+
+	if (0 == vb2_read_gpt(params, gpt) &&
+	    GPT_SUCCESS == GptNextKernelEntry(gpt, &part_start, &part_size)) {
+		VB2_DEBUG("Prefetching kernel entry at %" PRIu64 "\n",
+			  part_start);
+		VbExDiskPrefetch(params->disk_handle, part_start, part_size);
+	}
+
+	/* Leave writing any GPT repairs to LoadKernel() */
+	gpt->modified = 0;
+	WriteAndFreeGptData(params->disk_handle, gpt);
+}
+
 vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
@@ -453,6 +935,13 @@ vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 	params->bootloader_size = 0;
 	params->flags = 0;
 
+	/* Keep the GPT state and unpacked subkey off the stack */
+	GptData *gpt = vb2_workbuf_alloc(&wb, sizeof(*gpt));
+	struct vb2_public_key *kernel_subkey2 =
+		vb2_workbuf_alloc(&wb, sizeof(*kernel_subkey2));
+	if (!gpt || !kernel_subkey2)
+		return VB2_ERROR_LOAD_KERNEL_WORKBUF;
+
 	/*
 	 * Set up tracking for this call.  This wraps around if called many
 	 * times, so we need to initialize the call entry each time.
@@ -471,68 +960,90 @@ vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 	struct vb2_packed_key *kernel_subkey =
 		vb2_member_of(sd, sd->kernel_key_offset);
 
-	/* Read GPT data */
-	GptData gpt;
-	gpt.sector_bytes = (uint32_t)params->bytes_per_lba;
-	gpt.streaming_drive_sectors = params->streaming_lba_count;
-	gpt.gpt_drive_sectors = params->gpt_lba_count;
-	gpt.flags = params->boot_flags & BOOT_FLAG_EXTERNAL_GPT
-			? GPT_FLAG_EXTERNAL : 0;
-	if (0 != AllocAndReadGptData(params->disk_handle, &gpt)) {
-		VB2_DEBUG("Unable to read GPT data\n");
-		shcall->check_result = VBSD_LKC_CHECK_GPT_READ_ERROR;
-		goto gpt_done;
+	/*
+	 * Every candidate partition is verified against the same subkey, so
+	 * only unpack it once.  If that fails, each partition is still
+	 * tracked and rejected as before.
+	 */
+	const struct vb2_public_key *kernel_subkey_unpacked = kernel_subkey2;
+	if (VB2_SUCCESS != vb2_unpack_key(kernel_subkey2, kernel_subkey)) {
+		VB2_DEBUG("Unable to unpack kernel subkey\n");
+		kernel_subkey_unpacked = NULL;
 	}
 
-	/* Initialize GPT library */
-	if (GPT_SUCCESS != GptInit(&gpt)) {
-		VB2_DEBUG("Error parsing GPT\n");
-		shcall->check_result = VBSD_LKC_CHECK_GPT_PARSE_ERROR;
+	/* Read GPT data */
+	shcall->check_result = vb2_read_gpt(params, gpt);
+	if (shcall->check_result)
 		goto gpt_done;
+	vb2_record_timestamp(ctx, VB2_TS_KERNEL_GPT_READ);
+
+	/*
+	 * With BOOT_FLAG_PROBE_VBLOCKS, verify the vblocks of the candidate
+	 * partitions before reading any kernel body.  A partition which fails
+	 * its vblock check then never costs a body read, and later
+	 * partitions only needed for their versions aren't read again.
+	 */
+	struct vb2_kernel_candidate *cands = NULL;
+	uint32_t cand_count = 0, cand_next = 0, probed = 0;
+	int probe_resume = CGPT_KERNEL_ENTRY_NOT_FOUND;
+	if (params->boot_flags & BOOT_FLAG_PROBE_VBLOCKS) {
+		cands = vb2_workbuf_alloc(&wb, VBSD_MAX_KERNEL_PARTS *
+					  sizeof(*cands));
+		if (!cands)
+			VB2_DEBUG("No room to probe vblocks; loading serially\n");
+	}
+	if (cands) {
+		cand_count = vb2_probe_vblocks(ctx, gpt, kernel_subkey_unpacked,
+					       params,
+					       shared->kernel_version_tpm,
+					       shcall, cands, &probed, &wb);
+		found_partitions += probed;
+		probe_resume = gpt->current_kernel;
 	}
 
 	/* Loop over candidate kernel partitions */
 	uint64_t part_start, part_size;
-	while (GPT_SUCCESS ==
-	       GptNextKernelEntry(&gpt, &part_start, &part_size)) {
+	while (1) {
+		VbSharedDataKernelPart *shpart;
+		uint32_t lpflags = 0;
+		int vblock_probed = 0;
+
+		if (cand_next < cand_count) {
+			struct vb2_kernel_candidate *c = cands + cand_next++;
+
+			/* Point cgptlib back at the probed entry */
+			gpt->current_kernel = c->gpt_entry;
+			part_start = c->part_start;
+			part_size = c->part_size;
+			shpart = c->shpart;
+			vblock_probed = 1;
+		} else {
+			/*
+			 * Carry on past the probed entries, unless the probe
+			 * already ran out of them.
+			 */
+			if (cands) {
+				if (probed < VBSD_MAX_KERNEL_PARTS)
+					break;
+				gpt->current_kernel = probe_resume;
+				cands = NULL;
+			}
+
+			if (GPT_SUCCESS !=
+			    GptNextKernelEntry(gpt, &part_start, &part_size))
+				break;
+
+			shpart = vb2_track_kernel_part(ctx, shcall, gpt,
+						       part_start, part_size);
+
+			/* Found at least one kernel partition. */
+			found_partitions++;
+		}
 
 		VB2_DEBUG("Found kernel entry at %"
 			  PRIu64 " size %" PRIu64 "\n",
 			  part_start, part_size);
 
-		/*
-		 * Set up tracking for this partition.  This wraps around if
-		 * called many times, so initialize the partition entry each
-		 * time.
-		 */
-		VbSharedDataKernelPart *shpart =
-				shcall->parts + (shcall->kernel_parts_found
-				& (VBSD_MAX_KERNEL_PARTS - 1));
-		memset(shpart, 0, sizeof(VbSharedDataKernelPart));
-		shpart->sector_start = part_start;
-		shpart->sector_count = part_size;
-		/*
-		 * TODO: GPT partitions start at 1, but cgptlib starts them at
-		 * 0.  Adjust here, until cgptlib is fixed.
-		 */
-		shpart->gpt_index = (uint8_t)(gpt.current_kernel + 1);
-		shcall->kernel_parts_found++;
-
-		/* Found at least one kernel partition. */
-		found_partitions++;
-
-		/* Set up the stream */
-		VbExStream_t stream = NULL;
-		if (VbExStreamOpen(params->disk_handle,
-				   part_start, part_size, &stream)) {
-			VB2_DEBUG("Partition error getting stream.\n");
-			shpart->check_result = VBSD_LKP_CHECK_TOO_SMALL;
-			VB2_DEBUG("Marking kernel as invalid.\n");
-			GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_BAD);
-			continue;
-		}
-
-		uint32_t lpflags = 0;
 		if (params->partition_number > 0) {
 			/*
 			 * If we already have a good kernel, we only needed to
@@ -541,21 +1052,14 @@ vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 			lpflags |= VB2_LOAD_PARTITION_VBLOCK_ONLY;
 		}
 
-		rv = vb2_load_partition(ctx,
-					stream,
-					kernel_subkey,
-					lpflags,
-					params,
-					shared->kernel_version_tpm,
-					shpart,
-					&wb);
-		VbExStreamClose(stream);
-
-		if (rv != VB2_SUCCESS) {
-			VB2_DEBUG("Marking kernel as invalid.\n");
-			GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_BAD);
+		/* A probed vblock doesn't need checking again on its own */
+		int skip_load = vblock_probed &&
+			(lpflags & VB2_LOAD_PARTITION_VBLOCK_ONLY);
+		if (!skip_load && VB2_SUCCESS != vb2_load_kernel_entry(
+				ctx, gpt, part_start, part_size,
+				kernel_subkey_unpacked, lpflags, params,
+				shared->kernel_version_tpm, shpart, &wb))
 			continue;
-		}
 
 		int keyblock_valid = (shpart->flags &
 				      VBSD_LKP_FLAG_KEYBLOCK_VALID);
@@ -581,21 +1085,21 @@ vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 		 * TODO: GPT partitions start at 1, but cgptlib starts them at
 		 * 0.  Adjust here, until cgptlib is fixed.
 		 */
-		params->partition_number = gpt.current_kernel + 1;
+		params->partition_number = gpt->current_kernel + 1;
 
 		/*
 		 * TODO: GetCurrentKernelUniqueGuid() should take a destination
 		 * size, or the dest should be a struct, so we know it's big
 		 * enough.
 		 */
-		GetCurrentKernelUniqueGuid(&gpt, &params->partition_guid);
+		GetCurrentKernelUniqueGuid(gpt, &params->partition_guid);
 
 		/* Update GPT to note this is the kernel we're trying.
 		 * But not when we assume that the boot process may
 		 * not complete for valid reasons (eg. early shutdown).
 		 */
 		if (!(ctx->flags & VB2_CONTEXT_NOFAIL_BOOT))
-			GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_TRY);
+			GptUpdateKernelEntry(gpt, GPT_UPDATE_ENTRY_TRY);
 
 		/*
 		 * If we're in recovery mode or we're about to boot a
@@ -622,7 +1126,7 @@ vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 
 gpt_done:
 	/* Write and free GPT data */
-	WriteAndFreeGptData(params->disk_handle, &gpt);
+	WriteAndFreeGptData(params->disk_handle, gpt);
 
 	/* Handle finding a good partition */
 	if (params->partition_number > 0) {
@@ -645,7 +1149,9 @@ gpt_done:
 		shcall->check_result = VBSD_LKC_CHECK_INVALID_PARTITIONS;
 		rv = VB2_ERROR_LK_INVALID_KERNEL_FOUND;
 	} else {
-		shcall->check_result = VBSD_LKC_CHECK_NO_PARTITIONS;
+		/* Keep the reason if the GPT couldn't be read */
+		if (!shcall->check_result)
+			shcall->check_result = VBSD_LKC_CHECK_NO_PARTITIONS;
 		rv = VB2_ERROR_LK_NO_KERNEL_FOUND;
 	}
 
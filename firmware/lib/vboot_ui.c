@@ -111,7 +111,7 @@ int VbUserConfirms(struct vb2_context *ctx, uint32_t confirm_flags)
 			}
 			VbCheckDisplayKey(ctx, key, NULL);
 		}
-		VbExSleepMs(KEY_DELAY_MS);
+		vb2_audio_sleep(KEY_DELAY_MS);
 	} while (!shutdown_requested);
 
 	return -1;
@@ -164,7 +164,7 @@ static vb2_error_t vb2_altfw_ui(struct vb2_context *ctx)
 			VbCheckDisplayKey(ctx, key, NULL);
 			break;
 		}
-		VbExSleepMs(KEY_DELAY_MS);
+		vb2_audio_sleep(KEY_DELAY_MS);
 	} while (active);
 
 	/* Back to developer screen */
@@ -187,6 +187,7 @@ static vb2_error_t vb2_developer_ui(struct vb2_context *ctx)
 	uint32_t use_usb = 0;
 	uint32_t use_legacy = 0;
 	uint32_t ctrl_d_pressed = 0;
+	int prewarm;
 
 	VB2_DEBUG("Entering\n");
 
@@ -240,7 +241,7 @@ static vb2_error_t vb2_developer_ui(struct vb2_context *ctx)
 			vb2_nv_set(ctx, VB2_NV_DISABLE_DEV_REQUEST, 1);
 			VbDisplayScreen(ctx,
 				VB_SCREEN_TO_NORM_CONFIRMED, 0, NULL);
-			VbExSleepMs(5000);
+			vb2_audio_sleep(5000);
 			return VBERROR_REBOOT_REQUIRED;
 		case -1:
 			VB2_DEBUG("shutdown requested\n");
@@ -266,6 +267,12 @@ static vb2_error_t vb2_developer_ui(struct vb2_context *ctx)
 	/* Initialize audio/delay context */
 	vb2_audio_start(ctx);
 
+	/*
+	 * If the timeout will boot from the fixed disk, get it ready while
+	 * the user reads the warning.
+	 */
+	prewarm = !use_legacy && !(use_usb && allow_usb);
+
 	/* We'll loop until we finish the delay or are interrupted */
 	do {
 		uint32_t key = VbExKeyboardRead();
@@ -277,6 +284,10 @@ static vb2_error_t vb2_developer_ui(struct vb2_context *ctx)
 		switch (key) {
 		case 0:
 			/* nothing pressed */
+			if (prewarm) {
+				VbPrewarmLoadKernel(ctx, VB_DISK_FLAG_FIXED);
+				prewarm = 0;
+			}
 			break;
 		case VB_KEY_ENTER:
 			/* Only disable virtual dev switch if allowed by GBB */
@@ -311,7 +322,7 @@ static vb2_error_t vb2_developer_ui(struct vb2_context *ctx)
 				vb2_nv_set(ctx, VB2_NV_DISABLE_DEV_REQUEST, 1);
 				VbDisplayScreen(ctx,
 					VB_SCREEN_TO_NORM_CONFIRMED, 0, NULL);
-				VbExSleepMs(5000);
+				vb2_audio_sleep(5000);
 				return VBERROR_REBOOT_REQUIRED;
 			case -1:
 				VB2_DEBUG("shutdown requested\n");
@@ -391,7 +402,7 @@ static vb2_error_t vb2_developer_ui(struct vb2_context *ctx)
 			break;
 		}
 
-		VbExSleepMs(KEY_DELAY_MS);
+		vb2_audio_sleep(KEY_DELAY_MS);
 	} while(vb2_audio_looping());
 
  fallout:
@@ -434,6 +445,7 @@ static vb2_error_t recovery_ui(struct vb2_context *ctx)
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	uint32_t retval;
 	uint32_t key;
+	uint32_t events = VB_EVENT_ALL;
 	const char release_button_msg[] =
 		"Release the recovery button and try again\n";
 	const char recovery_pressed_msg[] =
@@ -472,22 +484,26 @@ static vb2_error_t recovery_ui(struct vb2_context *ctx)
 				  vb2_check_diagnostic_key(ctx, key)) !=
 				  VB2_SUCCESS)
 				return retval;
-			VbExSleepMs(KEY_DELAY_MS);
+			vb2_wait_for_event(EVENT_WAIT_MS);
 		}
 	}
 
 	/* Loop and wait for a recovery image */
 	VB2_DEBUG("VbBootRecovery() waiting for a recovery image\n");
 	while (1) {
-		retval = VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
-
-		if (VB2_SUCCESS == retval)
-			break; /* Found a recovery kernel */
-
-		enum VbScreenType_t next_screen =
-			retval == VB2_ERROR_LK_NO_DISK_FOUND ?
-			VB_SCREEN_RECOVERY_INSERT : VB_SCREEN_RECOVERY_NO_GOOD;
-		VbDisplayScreen(ctx, next_screen, 0, NULL);
+		/* Only look at the disks again if they may have changed */
+		if (events & VB_EVENT_DISK) {
+			retval = VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
+
+			if (VB2_SUCCESS == retval)
+				break; /* Found a recovery kernel */
+
+			enum VbScreenType_t next_screen =
+				retval == VB2_ERROR_LK_NO_DISK_FOUND ?
+				VB_SCREEN_RECOVERY_INSERT :
+				VB_SCREEN_RECOVERY_NO_GOOD;
+			VbDisplayScreen(ctx, next_screen, 0, NULL);
+		}
 
 		key = VbExKeyboardRead();
 		/*
@@ -544,7 +560,7 @@ static vb2_error_t recovery_ui(struct vb2_context *ctx)
 		}
 		if (vb2_want_shutdown(ctx, key))
 			return VBERROR_SHUTDOWN_REQUESTED;
-		VbExSleepMs(KEY_DELAY_MS);
+		events = vb2_wait_for_event(EVENT_WAIT_MS);
 	}
 
 	return VB2_SUCCESS;
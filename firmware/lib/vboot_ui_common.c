@@ -9,6 +9,7 @@
 #include "2misc.h"
 #include "2sysincludes.h"
 #include "vboot_api.h"
+#include "vboot_audio.h"
 #include "vboot_kernel.h"
 #include "vboot_test.h"
 #include "vboot_ui_common.h"
@@ -23,19 +24,43 @@ void vb2_reset_power_button(void) {
 	power_button_state = POWER_BUTTON_HELD_SINCE_BOOT;
 }
 
+__attribute__((weak))
+vb2_error_t VbExWaitForEvent(uint32_t timeout_ms, uint32_t *events)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+uint32_t vb2_wait_for_event(uint32_t timeout_ms)
+{
+	uint32_t events = 0;
+	uint32_t audio_ms;
+
+	/* Wake up in time to start the next queued tone */
+	audio_ms = vb2_audio_poll();
+	if (audio_ms && audio_ms < timeout_ms)
+		timeout_ms = audio_ms;
+
+	if (VbExWaitForEvent(timeout_ms, &events) == VB2_SUCCESS)
+		return events;
+
+	vb2_audio_sleep(KEY_DELAY_MS);
+	return VB_EVENT_ALL;
+}
+
 void vb2_error_beep(enum vb2_beep_type beep)
 {
 	switch (beep) {
 	case VB_BEEP_FAILED:
-		VbExBeep(250, 200);
+		vb2_audio_queue(250, 200);
 		break;
 	default:
 	case VB_BEEP_NOT_ALLOWED:
-		VbExBeep(120, 400);
-		VbExSleepMs(120);
-		VbExBeep(120, 400);
+		vb2_audio_queue(120, 400);
+		vb2_audio_queue(120, 0);
+		vb2_audio_queue(120, 400);
 		break;
 	}
+	vb2_audio_poll();
 }
 
 void vb2_error_notify(const char *print_msg,
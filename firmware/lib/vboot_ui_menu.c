@@ -71,7 +71,7 @@ static vb2_error_t vb2_draw_current_screen(struct vb2_context *ctx) {
 static void vb2_flash_screen(struct vb2_context *ctx)
 {
 	VbDisplayScreen(ctx, VB_SCREEN_BLANK, 0, NULL);
-	VbExSleepMs(50);
+	vb2_audio_sleep(50);
 	vb2_draw_current_screen(ctx);
 }
 
@@ -386,7 +386,7 @@ static vb2_error_t to_norm_action(struct vb2_context *ctx)
 	vb2_nv_set(ctx, VB2_NV_DISABLE_DEV_REQUEST, 1);
 	vb2_change_menu(VB_MENU_TO_NORM_CONFIRMED, 0);
 	vb2_draw_current_screen(ctx);
-	VbExSleepMs(5000);
+	vb2_audio_sleep(5000);
 	return VBERROR_REBOOT_REQUIRED;
 }
 
@@ -808,7 +808,7 @@ static vb2_error_t vb2_developer_menu(struct vb2_context *ctx)
 		if (key != 0)
 			vb2_audio_start(ctx);
 
-		VbExSleepMs(KEY_DELAY_MS);
+		vb2_audio_sleep(KEY_DELAY_MS);
 
 		/* If dev mode was disabled, loop forever (never timeout) */
 	} while (disable_dev_boot ? 1 : vb2_audio_looping());
@@ -859,6 +859,7 @@ static vb2_error_t broken_ui(struct vb2_context *ctx)
 		vb2_error_t ret = vb2_handle_menu_input(ctx, key, 0);
 		if (ret != VBERROR_KEEP_LOOPING)
 			return ret;
+		vb2_wait_for_event(EVENT_WAIT_MS);
 	}
 }
 
@@ -872,21 +873,25 @@ static vb2_error_t recovery_ui(struct vb2_context *ctx)
 {
 	uint32_t key;
 	uint32_t key_flags;
+	uint32_t events = VB_EVENT_ALL;
 	vb2_error_t ret;
 
 	/* Loop and wait for a recovery image */
 	VB2_DEBUG("waiting for a recovery image\n");
 	usb_nogood = -1;
 	while (1) {
-		ret = VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
-
-		if (VB2_SUCCESS == ret)
-			return ret; /* Found a recovery kernel */
-
-		if (usb_nogood != (ret != VB2_ERROR_LK_NO_DISK_FOUND)) {
-			/* USB state changed, force back to base screen */
-			usb_nogood = ret != VB2_ERROR_LK_NO_DISK_FOUND;
-			enter_recovery_base_screen(ctx);
+		/* Only look at the disks again if they may have changed */
+		if (events & VB_EVENT_DISK) {
+			ret = VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
+
+			if (VB2_SUCCESS == ret)
+				return ret; /* Found a recovery kernel */
+
+			if (usb_nogood != (ret != VB2_ERROR_LK_NO_DISK_FOUND)) {
+				/* USB state changed, back to base screen */
+				usb_nogood = ret != VB2_ERROR_LK_NO_DISK_FOUND;
+				enter_recovery_base_screen(ctx);
+			}
 		}
 
 		key = VbExKeyboardReadWithFlags(&key_flags);
@@ -900,7 +905,7 @@ static vb2_error_t recovery_ui(struct vb2_context *ctx)
 			if (ret != VBERROR_KEEP_LOOPING)
 				return ret;
 		}
-		VbExSleepMs(KEY_DELAY_MS);
+		events = vb2_wait_for_event(EVENT_WAIT_MS);
 	}
 }
 
@@ -7,10 +7,13 @@
  */
 
 #include "2common.h"
+#include "2misc.h"
 #include "2nvstorage.h"
 #include "2sysincludes.h"
 #include "vboot_api.h"
+#include "vboot_audio.h"
 #include "vboot_display.h"
+#include "vboot_struct.h"
 #include "vboot_ui_common.h"
 #include "vboot_ui_wilco.h"
 
@@ -102,7 +105,7 @@ static vb2_error_t vb2_enter_vendor_data_ui(struct vb2_context *ctx,
 			VbCheckDisplayKey(ctx, key, &data);
 			break;
 		}
-		VbExSleepMs(KEY_DELAY_MS);
+		vb2_audio_sleep(KEY_DELAY_MS);
 	} while (1);
 
 	return VB2_SUCCESS;
@@ -162,7 +165,7 @@ static vb2_error_t vb2_confirm_vendor_data_ui(struct vb2_context *ctx,
 						"set.\n"
 						"System will now shutdown\n",
 						NULL, VB_BEEP_FAILED);
-					VbExSleepMs(5000);
+					vb2_audio_sleep(5000);
 					return VBERROR_SHUTDOWN_REQUESTED;
 				}
 			} else {
@@ -177,7 +180,7 @@ static vb2_error_t vb2_confirm_vendor_data_ui(struct vb2_context *ctx,
 			VbCheckDisplayKey(ctx, key_confirm, data);
 			break;
 		}
-		VbExSleepMs(KEY_DELAY_MS);
+		vb2_audio_sleep(KEY_DELAY_MS);
 	} while (1);
 	return VB2_SUCCESS;
 }
@@ -257,8 +260,27 @@ vb2_error_t vb2_check_diagnostic_key(struct vb2_context *ctx,
 	return VB2_SUCCESS;
 }
 
+static void run_diagnostics(struct vb2_context *ctx)
+{
+	VB2_DEBUG("Diagnostic requested, running\n");
+
+	if (vb2ex_tpm_set_mode(VB2_TPM_MODE_DISABLED) != VB2_SUCCESS) {
+		VB2_DEBUG("Failed to disable TPM\n");
+		vb2api_fail(ctx, VB2_RECOVERY_TPM_DISABLE_FAILED, 0);
+	} else {
+		vb2_try_altfw(ctx, 1, VB_ALTFW_DIAGNOSTIC);
+		VB2_DEBUG("Diagnostic failed to run\n");
+		/*
+		 * Assuming failure was due to bad hash, though
+		 * the rom could just be missing or invalid.
+		 */
+		vb2api_fail(ctx, VB2_RECOVERY_ALTFW_HASH_FAILED, 0);
+	}
+}
+
 vb2_error_t vb2_diagnostics_ui(struct vb2_context *ctx)
 {
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	int active = 1;
 	int power_button_was_released = 0;
 	int power_button_was_pressed = 0;
@@ -266,6 +288,20 @@ vb2_error_t vb2_diagnostics_ui(struct vb2_context *ctx)
 	int action_confirmed = 0;
 	uint64_t start_time_us;
 
+	/*
+	 * Unattended boots (factory and repair fixtures) have nobody to
+	 * press the power button, so the GBB flag stands in for the
+	 * confirmation.  Since the GBB is only writable with write protect
+	 * off, this is no weaker than physical presence.
+	 */
+	if (vb2_get_gbb(ctx)->flags & VB2_GBB_FLAG_HEADLESS_DIAGNOSTICS) {
+		VB2_DEBUG("vb2_diagnostics_ui() - headless, confirmed\n");
+		if (sd->vbsd)
+			sd->vbsd->flags |= VBSD_HEADLESS_DIAGNOSTICS;
+		run_diagnostics(ctx);
+		return result;
+	}
+
 	VbDisplayScreen(ctx, VB_SCREEN_CONFIRM_DIAG, 0, NULL);
 
 	start_time_us = VbExGetTimer();
@@ -322,29 +358,14 @@ vb2_error_t vb2_diagnostics_ui(struct vb2_context *ctx)
 			break;
 		}
 		if (active) {
-			VbExSleepMs(KEY_DELAY_MS);
+			vb2_audio_sleep(KEY_DELAY_MS);
 		}
 	} while (active);
 
 	VbDisplayScreen(ctx, VB_SCREEN_BLANK, 0, NULL);
 
-	if (action_confirmed) {
-		VB2_DEBUG("Diagnostic requested, running\n");
-
-		if (vb2ex_tpm_set_mode(VB2_TPM_MODE_DISABLED) !=
-			   VB2_SUCCESS) {
-			VB2_DEBUG("Failed to disable TPM\n");
-			vb2api_fail(ctx, VB2_RECOVERY_TPM_DISABLE_FAILED, 0);
-		} else {
-			vb2_try_altfw(ctx, 1, VB_ALTFW_DIAGNOSTIC);
-			VB2_DEBUG("Diagnostic failed to run\n");
-			/*
-			 * Assuming failure was due to bad hash, though
-			 * the rom could just be missing or invalid.
-			 */
-			vb2api_fail(ctx, VB2_RECOVERY_ALTFW_HASH_FAILED, 0);
-		}
-	}
+	if (action_confirmed)
+		run_diagnostics(ctx);
 
 	return result;
 }
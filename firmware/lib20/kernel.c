@@ -104,6 +104,16 @@ vb2_error_t vb2_load_kernel_keyblock(struct vb2_context *ctx)
 	int need_keyblock_valid = vb2_need_signed_kernel(ctx);
 	int keyblock_is_valid = 1;
 
+	/*
+	 * A valid signature only matters if it's required, or if it lets the
+	 * kernel version roll forward.  Otherwise the keyblock hash is enough,
+	 * and the RSA check can be skipped entirely.
+	 */
+	int hash_only = !need_keyblock_valid &&
+		!(ctx->flags & VB2_CONTEXT_ALLOW_KERNEL_ROLL_FORWARD);
+	int hash_checked = 0;
+	vb2_error_t hash_rv = VB2_SUCCESS;
+
 	vb2_error_t rv;
 
 	vb2_workbuf_from_ctx(ctx, &wb);
@@ -115,12 +125,8 @@ vb2_error_t vb2_load_kernel_keyblock(struct vb2_context *ctx)
 	 */
 	sd->flags &= ~VB2_SD_FLAG_KERNEL_SIGNED;
 
-	/* Unpack the kernel key */
-	key_data = vb2_member_of(sd, sd->kernel_key_offset);
-	key_size = sd->kernel_key_size;
-	rv = vb2_unpack_key_buffer(&kernel_key, key_data, key_size);
-	if (rv)
-		return rv;
+	/* As for firmware, the vblock is read in pieces from here on */
+	vb2ex_prefetch_resource(ctx, VB2_RES_KERNEL_VBLOCK, 0, 0);
 
 	/* Load the kernel keyblock header after the root key */
 	kb = vb2_workbuf_alloc(&wb, sizeof(*kb));
@@ -148,17 +154,40 @@ vb2_error_t vb2_load_kernel_keyblock(struct vb2_context *ctx)
 	if (rv)
 		return rv;
 
-	/* Verify the keyblock */
-	rv = vb2_verify_keyblock(kb, block_size, &kernel_key, &wb);
-	if (rv) {
+	/*
+	 * Verify the keyblock.  The SHA-512 keyblock hash is computed at most
+	 * once; if the signature check below fails, the earlier result is
+	 * reused rather than hashing the same bytes again.
+	 */
+	if (hash_only) {
+		hash_rv = vb2_verify_keyblock_hash(kb, block_size, &wb);
+		hash_checked = 1;
+	}
+	if (hash_checked && !hash_rv) {
+		/* Don't know or care whether it's signed */
 		keyblock_is_valid = 0;
-		if (need_keyblock_valid)
-			return rv;
-
-		/* Signature is invalid, but hash may be fine */
-		rv = vb2_verify_keyblock_hash(kb, block_size, &wb);
+	} else {
+		/* Unpack the kernel key */
+		key_data = vb2_member_of(sd, sd->kernel_key_offset);
+		key_size = sd->kernel_key_size;
+		rv = vb2_unpack_key_buffer(&kernel_key, key_data, key_size);
 		if (rv)
 			return rv;
+
+		rv = vb2_verify_keyblock(kb, block_size, &kernel_key, &wb);
+		if (rv) {
+			keyblock_is_valid = 0;
+			if (need_keyblock_valid)
+				return rv;
+
+			/* Signature is invalid, but hash may be fine */
+			if (!hash_checked)
+				hash_rv = vb2_verify_keyblock_hash(kb,
+								   block_size,
+								   &wb);
+			if (hash_rv)
+				return hash_rv;
+		}
 	}
 
 	/* Check the keyblock flags against the current boot mode */
@@ -6,6 +6,7 @@
  */
 
 #include "2api.h"
+#include "2gbb.h"
 #include "2misc.h"
 #include "2nvstorage.h"
 #include "2rsa.h"
@@ -31,46 +32,180 @@ static const uint8_t dev_key_digest[] = {
  * debug console.
  *
  * @param root		Root key
+ * @param wb		Work buffer, for the hash context
  */
-static void vb2_report_dev_firmware(struct vb2_public_key *root)
+static void vb2_report_dev_firmware(struct vb2_public_key *root,
+				    const struct vb2_workbuf *wb)
 {
-	struct vb2_digest_context dc;
-	uint8_t digest[sizeof(dev_key_digest)];
+	struct vb2_workbuf wblocal = *wb;
+	struct vb2_digest_context *dc;
+	uint8_t *digest;
 	int size = root->arrsize * 4;
 
 	if (!root->arrsize)
 		return; /* Must be a test run. */
 
-	if (vb2_digest_init(&dc, VB2_HASH_SHA1) != VB2_SUCCESS)
+	if (!root->rr)
+		return; /* Compact keys can't match the full dev key. */
+
+	digest = vb2_workbuf_alloc(&wblocal, sizeof(dev_key_digest));
+	dc = vb2_workbuf_alloc(&wblocal, sizeof(*dc));
+	if (!digest || !dc)
+		return;
+
+	if (vb2_digest_init(dc, VB2_HASH_SHA1) != VB2_SUCCESS)
 		return;
 
-	if (vb2_digest_extend(&dc, (uint8_t *)&root->arrsize,
+	if (vb2_digest_extend(dc, (uint8_t *)&root->arrsize,
 			      sizeof(root->arrsize)) != VB2_SUCCESS)
 		return;
 
-	if (vb2_digest_extend(&dc, (uint8_t *)&root->n0inv,
+	if (vb2_digest_extend(dc, (uint8_t *)&root->n0inv,
 			      sizeof(root->n0inv)) != VB2_SUCCESS)
 		return;
 
-	if (vb2_digest_extend(&dc, (uint8_t *)root->n, size) != VB2_SUCCESS)
+	if (vb2_digest_extend(dc, (uint8_t *)root->n, size) != VB2_SUCCESS)
 		return;
 
-	if (vb2_digest_extend(&dc, (uint8_t *)root->rr, size) != VB2_SUCCESS)
+	if (vb2_digest_extend(dc, (uint8_t *)root->rr, size) != VB2_SUCCESS)
 		return;
 
-	if (vb2_digest_finalize(&dc, digest, sizeof(digest)) != VB2_SUCCESS)
+	if (vb2_digest_finalize(dc, digest, sizeof(dev_key_digest)) !=
+	    VB2_SUCCESS)
 		return;
 
 	if (!memcmp(digest, dev_key_digest, sizeof(dev_key_digest)))
 		VB2_DEBUG("This is developer signed firmware\n");
 }
 
+/**
+ * Hash a piece of the firmware vblock for the verified-vblock cache.
+ *
+ * @param prefix	Data to hash first
+ * @param prefix_size	Size of prefix in bytes
+ * @param buf		Data to hash after the prefix
+ * @param size		Size of buf in bytes
+ * @param digest	Destination for VB2_VBLOCK_CACHE_DIGEST_SIZE bytes
+ * @param wb		Work buffer, for the hash context
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+static vb2_error_t vb2_hash_vblock(const void *prefix, uint32_t prefix_size,
+				   const void *buf, uint32_t size,
+				   uint8_t *digest,
+				   const struct vb2_workbuf *wb)
+{
+	struct vb2_workbuf wblocal = *wb;
+	struct vb2_digest_context *dc;
+	vb2_error_t rv;
+
+	dc = vb2_workbuf_alloc(&wblocal, sizeof(*dc));
+	if (!dc)
+		return VB2_ERROR_FW_VBLOCK_CACHE_WORKBUF;
+
+	rv = vb2_digest_init(dc, VB2_HASH_SHA256);
+	if (rv)
+		return rv;
+
+	rv = vb2_digest_extend(dc, prefix, prefix_size);
+	if (rv)
+		return rv;
+
+	rv = vb2_digest_extend(dc, buf, size);
+	if (rv)
+		return rv;
+
+	return vb2_digest_finalize(dc, digest, VB2_VBLOCK_CACHE_DIGEST_SIZE);
+}
+
+/**
+ * Check the firmware keyblock and preamble against the vblock cache.
+ *
+ * Does nothing if vb2ex_read_vblock_cache() is unimplemented.  Otherwise
+ * hashes the slot, root key and keyblock into sd->vblock_keyblock_digest for
+ * vb2_load_fw_preamble() and sets VB2_SD_FLAG_VBLOCK_CACHE_ENABLED, then reads
+ * the preamble into scratch space and sets VB2_SD_FLAG_VBLOCK_CACHED if the
+ * whole vblock matches the cached digest.  Must be called before the keyblock
+ * signature is checked, since that destroys the signature.
+ *
+ * @param ctx		Vboot context
+ * @param root_key	Packed root key data
+ * @param root_size	Size of root key data in bytes
+ * @param kb		Keyblock, not yet verified
+ * @param block_size	Size of keyblock buffer in bytes
+ * @param wb		Work buffer, for scratch space
+ */
+static void vb2_check_vblock_cache(struct vb2_context *ctx,
+				   const uint8_t *root_key, uint32_t root_size,
+				   const struct vb2_keyblock *kb,
+				   uint32_t block_size,
+				   const struct vb2_workbuf *wb)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_workbuf wblocal = *wb;
+	struct vb2_fw_preamble *pre;
+	uint8_t *digest;
+	uint32_t pre_size;
+	uint8_t slot = sd->fw_slot;
+	vb2_error_t rv;
+
+	sd->flags &= ~(VB2_SD_FLAG_VBLOCK_CACHED |
+		       VB2_SD_FLAG_VBLOCK_CACHE_ENABLED);
+
+	/* Don't spend time hashing the vblock if there's nowhere to keep it */
+	rv = vb2ex_read_vblock_cache(ctx, sd->vblock_cached_digest,
+				     VB2_VBLOCK_CACHE_DIGEST_SIZE);
+	if (rv == VB2_ERROR_EX_UNIMPLEMENTED)
+		return;
+
+	digest = vb2_workbuf_alloc(&wblocal, VB2_VBLOCK_CACHE_DIGEST_SIZE);
+	if (!digest)
+		return;
+
+	/* Fold the slot and root key together, then add the keyblock */
+	if (vb2_hash_vblock(&slot, sizeof(slot), root_key, root_size, digest,
+			    &wblocal) ||
+	    vb2_hash_vblock(digest, VB2_VBLOCK_CACHE_DIGEST_SIZE,
+			    kb, block_size, sd->vblock_keyblock_digest,
+			    &wblocal))
+		return;
+	sd->flags |= VB2_SD_FLAG_VBLOCK_CACHE_ENABLED;
+
+	/* Nothing cached yet; vb2_load_fw_preamble() will fill it */
+	if (rv)
+		return;
+
+	/* The preamble follows the keyblock; peek at it without keeping it */
+	pre = vb2_workbuf_alloc(&wblocal, sizeof(*pre));
+	if (!pre || vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK,
+					block_size, pre, sizeof(*pre)))
+		return;
+
+	pre_size = pre->preamble_size;
+	pre = vb2_workbuf_realloc(&wblocal, sizeof(*pre), pre_size);
+	if (!pre || vb2ex_read_resource(ctx, VB2_RES_FW_VBLOCK,
+					block_size, pre, pre_size))
+		return;
+
+	if (vb2_hash_vblock(sd->vblock_keyblock_digest,
+			    VB2_VBLOCK_CACHE_DIGEST_SIZE, pre, pre_size,
+			    digest, &wblocal))
+		return;
+
+	if (vb2_safe_memcmp(digest, sd->vblock_cached_digest,
+			    VB2_VBLOCK_CACHE_DIGEST_SIZE))
+		return;
+
+	VB2_DEBUG("Firmware vblock matches vblock cache\n");
+	sd->flags |= VB2_SD_FLAG_VBLOCK_CACHED;
+}
+
 vb2_error_t vb2_load_fw_keyblock(struct vb2_context *ctx)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	struct vb2_gbb_header *gbb = vb2_get_gbb(ctx);
 	struct vb2_workbuf wb;
 
+	struct vb2_packed_key *packed_root;
 	uint8_t *key_data;
 	uint32_t key_size;
 	struct vb2_public_key root_key;
@@ -83,15 +218,10 @@ vb2_error_t vb2_load_fw_keyblock(struct vb2_context *ctx)
 	vb2_workbuf_from_ctx(ctx, &wb);
 
 	/* Read the root key */
-	key_size = gbb->rootkey_size;
-	key_data = vb2_workbuf_alloc(&wb, key_size);
-	if (!key_data)
-		return VB2_ERROR_FW_KEYBLOCK_WORKBUF_ROOT_KEY;
-
-	rv = vb2ex_read_resource(ctx, VB2_RES_GBB, gbb->rootkey_offset,
-				 key_data, key_size);
+	rv = vb2_gbb_read_root_key(ctx, &packed_root, &key_size, &wb);
 	if (rv)
 		return rv;
+	key_data = (uint8_t *)packed_root;
 
 	/* Unpack the root key */
 	rv = vb2_unpack_key_buffer(&root_key, key_data, key_size);
@@ -99,7 +229,13 @@ vb2_error_t vb2_load_fw_keyblock(struct vb2_context *ctx)
 		return rv;
 
 	/* If that's the checked-in root key, this is dev-signed firmware */
-	vb2_report_dev_firmware(&root_key);
+	vb2_report_dev_firmware(&root_key, &wb);
+
+	/*
+	 * The keyblock and preamble are read piecewise from here through
+	 * vb2_load_fw_preamble(), so let the platform fetch the whole vblock.
+	 */
+	vb2ex_prefetch_resource(ctx, VB2_RES_FW_VBLOCK, 0, 0);
 
 	/* Load the firmware keyblock header after the root key */
 	kb = vb2_workbuf_alloc(&wb, sizeof(*kb));
@@ -126,8 +262,13 @@ vb2_error_t vb2_load_fw_keyblock(struct vb2_context *ctx)
 	if (rv)
 		return rv;
 
-	/* Verify the keyblock */
-	rv = vb2_verify_keyblock(kb, block_size, &root_key, &wb);
+	/* A cached keyblock still gets its header checked */
+	vb2_check_vblock_cache(ctx, key_data, key_size, kb, block_size, &wb);
+	if (sd->flags & VB2_SD_FLAG_VBLOCK_CACHED)
+		rv = vb2_check_keyblock(kb, block_size,
+					&kb->keyblock_signature);
+	else
+		rv = vb2_verify_keyblock(kb, block_size, &root_key, &wb);
 	if (rv) {
 		vb2api_fail(ctx, VB2_RECOVERY_FW_KEYBLOCK, rv);
 		return rv;
@@ -203,6 +344,9 @@ vb2_error_t vb2_load_fw_preamble(struct vb2_context *ctx)
 	struct vb2_fw_preamble *pre;
 	uint32_t pre_size;
 
+	uint8_t digest[VB2_VBLOCK_CACHE_DIGEST_SIZE];
+	int cached = 0;
+
 	vb2_error_t rv;
 
 	vb2_workbuf_from_ctx(ctx, &wb);
@@ -241,8 +385,30 @@ vb2_error_t vb2_load_fw_preamble(struct vb2_context *ctx)
 
 	/* Work buffer now contains the data subkey data and the preamble */
 
+	/*
+	 * Only trust the cache if the preamble we just read is the one
+	 * vb2_load_fw_keyblock() matched, and hash it before the signature
+	 * check destroys the signature.
+	 */
+	if (sd->flags & VB2_SD_FLAG_VBLOCK_CACHE_ENABLED) {
+		rv = vb2_hash_vblock(sd->vblock_keyblock_digest,
+				     VB2_VBLOCK_CACHE_DIGEST_SIZE, pre,
+				     pre_size, digest, &wb);
+		if (rv)
+			return rv;
+		if ((sd->flags & VB2_SD_FLAG_VBLOCK_CACHED) &&
+		    !vb2_safe_memcmp(digest, sd->vblock_cached_digest,
+				     sizeof(digest)))
+			cached = 1;
+	}
+
 	/* Verify the preamble */
-	rv = vb2_verify_fw_preamble(pre, pre_size, &data_key, &wb);
+	if (cached) {
+		VB2_DEBUG("Skipping signature checks for cached vblock\n");
+		rv = vb2_check_fw_preamble(pre, pre_size);
+	} else {
+		rv = vb2_verify_fw_preamble(pre, pre_size, &data_key, &wb);
+	}
 	if (rv) {
 		vb2api_fail(ctx, VB2_RECOVERY_FW_PREAMBLE, rv);
 		return rv;
@@ -286,6 +452,13 @@ vb2_error_t vb2_load_fw_preamble(struct vb2_context *ctx)
 					 sd->fw_version);
 	}
 
+	/* Remember this vblock so the next boot can skip the signatures */
+	if ((sd->flags & VB2_SD_FLAG_VBLOCK_CACHE_ENABLED) && !cached) {
+		rv = vb2ex_write_vblock_cache(ctx, digest, sizeof(digest));
+		if (rv && rv != VB2_ERROR_EX_UNIMPLEMENTED)
+			VB2_DEBUG("Unable to update vblock cache: %#x\n", rv);
+	}
+
 	/* Keep track of where we put the preamble */
 	sd->preamble_offset = vb2_offset_of(sd, pre);
 	sd->preamble_size = pre_size;
@@ -17,6 +17,7 @@ vb2_error_t vb2_unpack_key_buffer(struct vb2_public_key *key,
 		(const struct vb2_packed_key *)buf;
 	const uint32_t *buf32;
 	uint32_t expected_key_size;
+	int compact;
 	vb2_error_t rv;
 
 	/* Make sure passed buffer is big enough for the packed key */
@@ -37,8 +38,12 @@ vb2_error_t vb2_unpack_key_buffer(struct vb2_public_key *key,
 		return VB2_ERROR_UNPACK_KEY_HASH_ALGORITHM;
 	}
 
+	/* Compact keys leave out rr; it's derived when the key is used */
 	expected_key_size = vb2_packed_key_size(key->sig_alg);
-	if (!expected_key_size || expected_key_size != packed_key->key_size) {
+	compact = packed_key->key_size ==
+		vb2_packed_key_compact_size(key->sig_alg);
+	if (!expected_key_size ||
+	    (expected_key_size != packed_key->key_size && !compact)) {
 		VB2_DEBUG("Wrong key size for algorithm\n");
 		return VB2_ERROR_UNPACK_KEY_SIZE;
 	}
@@ -57,7 +62,7 @@ vb2_error_t vb2_unpack_key_buffer(struct vb2_public_key *key,
 
 	/* Arrays point inside the key data */
 	key->n = buf32 + 2;
-	key->rr = buf32 + 2 + key->arrsize;
+	key->rr = compact ? NULL : buf32 + 2 + key->arrsize;
 
 #ifdef __COVERITY__
 	__coverity_tainted_data_sanitize__(key);
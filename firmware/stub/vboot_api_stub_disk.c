@@ -32,6 +32,14 @@ vb2_error_t VbExDiskFreeInfo(VbDiskInfo* infos_ptr,
 }
 
 
+__attribute__((weak))
+vb2_error_t VbExDiskPrefetch(VbExDiskHandle_t handle, uint64_t lba_start,
+			     uint64_t lba_count)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+
 vb2_error_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 			 uint64_t lba_count, void* buffer)
 {
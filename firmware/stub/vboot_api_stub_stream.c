@@ -23,6 +23,11 @@ struct disk_stream {
 
 	/* Number of sectors left in partition */
 	uint64_t sectors_left;
+
+	/* Results of queued reads not yet waited for, oldest first */
+	vb2_error_t queued_rv[VB_STREAM_MAX_READS];
+	uint32_t queued_first;
+	uint32_t queued_count;
 };
 
 vb2_error_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
@@ -39,6 +44,8 @@ vb2_error_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
 	s->handle = handle;
 	s->sector = lba_start;
 	s->sectors_left = lba_count;
+	s->queued_first = 0;
+	s->queued_count = 0;
 
 	*stream = (void *)s;
 
@@ -73,6 +80,62 @@ vb2_error_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer)
 	return VB2_SUCCESS;
 }
 
+vb2_error_t VbExStreamSkip(VbExStream_t stream, uint32_t bytes)
+{
+	struct disk_stream *s = (struct disk_stream *)stream;
+	uint64_t sectors;
+
+	if (!s || s->queued_count)
+		return VB2_ERROR_UNKNOWN;
+
+	/* Same restrictions as VbExStreamRead() */
+	if (bytes % LBA_BYTES)
+		return VB2_ERROR_UNKNOWN;
+
+	sectors = bytes / LBA_BYTES;
+	if (sectors > s->sectors_left)
+		return VB2_ERROR_UNKNOWN;
+
+	s->sector += sectors;
+	s->sectors_left -= sectors;
+
+	return VB2_SUCCESS;
+}
+
+/*
+ * Queued reads are done synchronously here; only their results are held
+ * back until VbExStreamWaitRead().
+ */
+vb2_error_t VbExStreamSubmitRead(VbExStream_t stream, uint32_t bytes,
+				 void *buffer)
+{
+	struct disk_stream *s = (struct disk_stream *)stream;
+
+	if (!s || s->queued_count >= VB_STREAM_MAX_READS)
+		return VB2_ERROR_UNKNOWN;
+
+	s->queued_rv[(s->queued_first + s->queued_count) %
+		     VB_STREAM_MAX_READS] = VbExStreamRead(stream, bytes, buffer);
+	s->queued_count++;
+
+	return VB2_SUCCESS;
+}
+
+vb2_error_t VbExStreamWaitRead(VbExStream_t stream)
+{
+	struct disk_stream *s = (struct disk_stream *)stream;
+	vb2_error_t rv;
+
+	if (!s || !s->queued_count)
+		return VB2_ERROR_UNKNOWN;
+
+	rv = s->queued_rv[s->queued_first];
+	s->queued_first = (s->queued_first + 1) % VB_STREAM_MAX_READS;
+	s->queued_count--;
+
+	return rv;
+}
+
 void VbExStreamClose(VbExStream_t stream)
 {
 	struct disk_stream *s = (struct disk_stream *)stream;
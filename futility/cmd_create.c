@@ -3,7 +3,10 @@
  * found in the LICENSE file.
  */
 
+#include <openssl/bn.h>
+#include <openssl/ec.h>
 #include <openssl/pem.h>
+#include <openssl/rsa.h>
 
 #include <getopt.h>
 #include <stdio.h>
@@ -19,6 +22,7 @@
 #include "host_common21.h"
 #include "host_key.h"
 #include "host_key21.h"
+#include "host_misc.h"
 #include "host_misc21.h"
 #include "openssl_compat.h"
 #include "util_misc.h"
@@ -31,6 +35,7 @@ enum {
 	OPT_DESC,
 	OPT_ID,
 	OPT_HASH_ALG,
+	OPT_GENERATE,
 	OPT_HELP,
 };
 
@@ -43,12 +48,14 @@ enum vb2_hash_algorithm opt_hash_alg = DEFAULT_HASH;
 static char *opt_desc;
 static struct vb2_id opt_id;
 static int force_id;
+static char *opt_generate;
 
 static const struct option long_opts[] = {
 	{"version",  1, 0, OPT_VERSION},
 	{"desc",     1, 0, OPT_DESC},
 	{"id",       1, 0, OPT_ID},
 	{"hash_alg", 1, 0, OPT_HASH_ALG},
+	{"generate", 1, 0, OPT_GENERATE},
 	{"help",     0, 0, OPT_HELP},
 	{NULL, 0, 0, 0}
 };
@@ -58,9 +65,18 @@ static void print_help(int argc, char *argv[])
 	const struct vb2_text_vs_enum *entry;
 
 	printf("\n"
-"Usage:  " MYNAME " %s [options] <INFILE> [<BASENAME>]\n", argv[0]);
+"Usage:  " MYNAME " %s [options] <INFILE> [<BASENAME>]\n"
+"        " MYNAME " %s [options] --generate <KEYTYPE> <BASENAME>\n",
+	       argv[0], argv[0]);
 	printf("\n"
 "Create a keypair from an RSA key (.pem file).\n"
+"With --vb21, the .pem file may also hold an ECDSA P-256 key.\n"
+"\n"
+"With --generate, a new key is generated instead and written to\n"
+"<BASENAME>.pem, along with its pre-processed public key (.keyb) and\n"
+"both the vb1 (.vbpubk, .vbprivk) and vb21 (.vbpubk2, .vbprik2) keypairs.\n"
+"KEYTYPE is one of rsa1024, rsa2048, rsa4096, rsa8192, rsa2048_exp3,\n"
+"rsa3072_exp3 (public exponent 3), or ecp256, which has no vb1 keypair.\n"
 "\n"
 "Options:\n"
 "\n"
@@ -78,30 +94,15 @@ static void print_help(int argc, char *argv[])
 
 }
 
-static int vb1_make_keypair(void)
+/* Write the vb1 keypair for an RSA private key; the caller still owns it */
+static int vb1_write_keypair(struct rsa_st *rsa_key)
 {
 	struct vb2_private_key *privkey = NULL;
 	struct vb2_packed_key *pubkey = NULL;
-	struct rsa_st *rsa_key = NULL;
 	uint8_t *keyb_data = 0;
 	uint32_t keyb_size;
 	int ret = 1;
 
-	FILE *fp = fopen(infile, "rb");
-	if (!fp) {
-		fprintf(stderr, "Unable to open %s\n", infile);
-		goto done;
-	}
-
-	/* TODO: this is very similar to vb2_read_private_key_pem() */
-
-	rsa_key = PEM_read_RSAPrivateKey(fp, NULL, NULL, NULL);
-	fclose(fp);
-	if (!rsa_key) {
-		fprintf(stderr, "Unable to read RSA key from %s\n", infile);
-		goto done;
-	}
-
 	enum vb2_signature_algorithm sig_alg = vb2_rsa_sig_alg(rsa_key);
 	if (sig_alg == VB2_SIG_INVALID) {
 		fprintf(stderr, "Unsupported sig algorithm in RSA key\n");
@@ -155,55 +156,52 @@ done:
 	free(privkey);
 	free(pubkey);
 	free(keyb_data);
-	RSA_free(rsa_key);
 	return ret;
 }
 
-static int vb2_make_keypair(void)
+static int vb1_make_keypair(void)
 {
-	struct vb2_private_key *privkey = 0;
-	struct vb2_public_key *pubkey = 0;
-	RSA *rsa_key = 0;
-	uint8_t *keyb_data = 0;
-	uint32_t keyb_size;
-	enum vb2_signature_algorithm sig_alg;
-	uint8_t *pubkey_buf = 0;
-	int has_priv = 0;
-	const BIGNUM *rsa_d;
+	struct rsa_st *rsa_key;
+	int ret;
 
-	FILE *fp;
-	int ret = 1;
-
-	fp = fopen(infile, "rb");
+	FILE *fp = fopen(infile, "rb");
 	if (!fp) {
 		fprintf(stderr, "Unable to open %s\n", infile);
-		goto done;
+		return 1;
 	}
 
-	rsa_key = PEM_read_RSAPrivateKey(fp, NULL, NULL, NULL);
+	/* TODO: this is very similar to vb2_read_private_key_pem() */
 
-	if (!rsa_key) {
-		/* Check if the PEM contains only a public key */
-		if (0 != fseek(fp, 0, SEEK_SET)) {
-			fprintf(stderr, "Error seeking in %s\n", infile);
-			goto done;
-		}
-		rsa_key = PEM_read_RSA_PUBKEY(fp, NULL, NULL, NULL);
-	}
+	rsa_key = PEM_read_RSAPrivateKey(fp, NULL, NULL, NULL);
 	fclose(fp);
 	if (!rsa_key) {
 		fprintf(stderr, "Unable to read RSA key from %s\n", infile);
-		goto done;
+		return 1;
 	}
-	/* Public keys doesn't have the private exponent */
-	RSA_get0_key(rsa_key, NULL, NULL, &rsa_d);
-	has_priv = !!rsa_d;
-	if (!has_priv)
-		fprintf(stderr, "%s has a public key only.\n", infile);
 
-	sig_alg = vb2_rsa_sig_alg(rsa_key);
+	ret = vb1_write_keypair(rsa_key);
+	RSA_free(rsa_key);
+	return ret;
+}
+
+/*
+ * Write the vb21 keypair for an RSA or EC key, or just the public key if
+ * has_priv is 0.  The caller still owns the key.
+ */
+static int vb2_write_keypair(RSA *rsa_key, EC_KEY *ec_key, int has_priv)
+{
+	struct vb2_private_key *privkey = 0;
+	struct vb2_public_key *pubkey = 0;
+	uint8_t *keyb_data = 0;
+	uint32_t keyb_size;
+	enum vb2_signature_algorithm sig_alg;
+	uint8_t *pubkey_buf = 0;
+	int ret = 1;
+
+	sig_alg = ec_key ? vb2_ec_sig_alg(ec_key) : vb2_rsa_sig_alg(rsa_key);
 	if (sig_alg == VB2_SIG_INVALID) {
-		fprintf(stderr, "Unsupported sig algorithm in RSA key\n");
+		fprintf(stderr, "Unsupported sig algorithm in %s key\n",
+			ec_key ? "EC" : "RSA");
 		goto done;
 	}
 
@@ -216,6 +214,7 @@ static int vb2_make_keypair(void)
 		}
 
 		privkey->rsa_private_key = rsa_key;
+		privkey->ec_private_key = ec_key;
 		privkey->sig_alg = sig_alg;
 		privkey->hash_alg = opt_hash_alg;
 		if (opt_desc && vb2_private_key_set_desc(privkey, opt_desc)) {
@@ -232,7 +231,8 @@ static int vb2_make_keypair(void)
 	}
 
 	/* Extract the keyb blob */
-	if (vb_keyb_from_rsa(rsa_key, &keyb_data, &keyb_size)) {
+	if (ec_key ? vb_keyb_from_ec(ec_key, &keyb_data, &keyb_size) :
+	    vb_keyb_from_rsa(rsa_key, &keyb_data, &keyb_size)) {
 		fprintf(stderr, "Couldn't extract the public key\n");
 		goto done;
 	}
@@ -286,15 +286,172 @@ static int vb2_make_keypair(void)
 	ret = 0;
 
 done:
-	RSA_free(rsa_key);
-	if (privkey)				/* prevent double-free */
+	if (privkey) {				/* prevent double-free */
 		privkey->rsa_private_key = 0;
+		privkey->ec_private_key = 0;
+	}
 	vb2_private_key_free(privkey);
 	vb2_public_key_free(pubkey);
 	free(keyb_data);
 	return ret;
 }
 
+static int vb2_make_keypair(void)
+{
+	RSA *rsa_key = 0;
+	EC_KEY *ec_key = 0;
+	int has_priv = 0;
+	const BIGNUM *rsa_d;
+
+	FILE *fp;
+	int ret = 1;
+
+	fp = fopen(infile, "rb");
+	if (!fp) {
+		fprintf(stderr, "Unable to open %s\n", infile);
+		goto done;
+	}
+
+	rsa_key = PEM_read_RSAPrivateKey(fp, NULL, NULL, NULL);
+
+	if (!rsa_key) {
+		/* Check if the PEM contains only a public key */
+		if (0 != fseek(fp, 0, SEEK_SET)) {
+			fprintf(stderr, "Error seeking in %s\n", infile);
+			goto done;
+		}
+		rsa_key = PEM_read_RSA_PUBKEY(fp, NULL, NULL, NULL);
+	}
+	if (!rsa_key && 0 == fseek(fp, 0, SEEK_SET)) {
+		/* Not RSA, so try an EC key or EC public key */
+		ec_key = PEM_read_ECPrivateKey(fp, NULL, NULL, NULL);
+		if (!ec_key && 0 == fseek(fp, 0, SEEK_SET))
+			ec_key = PEM_read_EC_PUBKEY(fp, NULL, NULL, NULL);
+	}
+	fclose(fp);
+	if (!rsa_key && !ec_key) {
+		fprintf(stderr, "Unable to read RSA or EC key from %s\n",
+			infile);
+		goto done;
+	}
+
+	if (ec_key) {
+		has_priv = !!EC_KEY_get0_private_key(ec_key);
+	} else {
+		/* Public keys doesn't have the private exponent */
+		RSA_get0_key(rsa_key, NULL, NULL, &rsa_d);
+		has_priv = !!rsa_d;
+	}
+	if (!has_priv)
+		fprintf(stderr, "%s has a public key only.\n", infile);
+
+	ret = vb2_write_keypair(rsa_key, ec_key, has_priv);
+
+done:
+	RSA_free(rsa_key);
+	EC_KEY_free(ec_key);
+	return ret;
+}
+
+/* RSA key types --generate accepts; vboot can't use any other size */
+static const struct {
+	const char *name;
+	int bits;
+	unsigned long exponent;
+} rsa_key_types[] = {
+	{"rsa1024", 1024, RSA_F4},
+	{"rsa2048", 2048, RSA_F4},
+	{"rsa4096", 4096, RSA_F4},
+	{"rsa8192", 8192, RSA_F4},
+	{"rsa2048_exp3", 2048, 3},
+	{"rsa3072_exp3", 3072, 3},
+};
+
+/* Generate a new key for --generate, and write it out in every format */
+static int generate_keypair(void)
+{
+	RSA *rsa_key = 0;
+	EC_KEY *ec_key = 0;
+	BIGNUM *exponent = 0;
+	uint8_t *keyb_data = 0;
+	uint32_t keyb_size;
+	FILE *fp;
+	int ret = 1;
+	int i;
+
+	if (!strcmp(opt_generate, "ecp256")) {
+		ec_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+		if (!ec_key || !EC_KEY_generate_key(ec_key)) {
+			fprintf(stderr, "Unable to generate EC key\n");
+			goto done;
+		}
+		EC_KEY_set_asn1_flag(ec_key, OPENSSL_EC_NAMED_CURVE);
+	} else {
+		for (i = 0; i < ARRAY_SIZE(rsa_key_types); i++)
+			if (!strcmp(opt_generate, rsa_key_types[i].name))
+				break;
+		if (i == ARRAY_SIZE(rsa_key_types))
+			goto bad_type;
+
+		rsa_key = RSA_new();
+		exponent = BN_new();
+		if (!rsa_key || !exponent ||
+		    !BN_set_word(exponent, rsa_key_types[i].exponent) ||
+		    !RSA_generate_key_ex(rsa_key, rsa_key_types[i].bits,
+					 exponent, NULL)) {
+			fprintf(stderr, "Unable to generate RSA key\n");
+			goto done;
+		}
+	}
+
+	strcpy(outext, ".pem");
+	fp = fopen(outfile, "wb");
+	if (!fp) {
+		fprintf(stderr, "Unable to open %s\n", outfile);
+		goto done;
+	}
+	if (!(ec_key ?
+	      PEM_write_ECPrivateKey(fp, ec_key, NULL, NULL, 0, NULL, NULL) :
+	      PEM_write_RSAPrivateKey(fp, rsa_key, NULL, NULL, 0, NULL,
+				      NULL))) {
+		fprintf(stderr, "Unable to write %s\n", outfile);
+		fclose(fp);
+		goto done;
+	}
+	if (fclose(fp)) {
+		fprintf(stderr, "Unable to write %s\n", outfile);
+		goto done;
+	}
+	printf("wrote %s\n", outfile);
+
+	if (ec_key ? vb_keyb_from_ec(ec_key, &keyb_data, &keyb_size) :
+	    vb_keyb_from_rsa(rsa_key, &keyb_data, &keyb_size)) {
+		fprintf(stderr, "Couldn't extract the public key\n");
+		goto done;
+	}
+	strcpy(outext, ".keyb");
+	if (VB2_SUCCESS != vb2_write_file(outfile, keyb_data, keyb_size)) {
+		fprintf(stderr, "Unable to write %s\n", outfile);
+		goto done;
+	}
+	printf("wrote %s\n", outfile);
+
+	/* vb1 has no EC keys */
+	if (rsa_key && vb1_write_keypair(rsa_key))
+		goto done;
+	ret = vb2_write_keypair(rsa_key, ec_key, 1);
+	goto done;
+
+bad_type:
+	fprintf(stderr, "Invalid key type \"%s\"\n", opt_generate);
+done:
+	RSA_free(rsa_key);
+	EC_KEY_free(ec_key);
+	BN_free(exponent);
+	free(keyb_data);
+	return ret;
+}
+
 static int do_create(int argc, char *argv[])
 {
 	int errorcnt = 0;
@@ -334,6 +491,10 @@ static int do_create(int argc, char *argv[])
 			}
 			break;
 
+		case OPT_GENERATE:
+			opt_generate = optarg;
+			break;
+
 		case OPT_HELP:
 			print_help(argc, argv);
 			return !!errorcnt;
@@ -357,8 +518,14 @@ static int do_create(int argc, char *argv[])
 		}
 	}
 
-	/* If we don't have an input file already, we need one */
-	if (!infile) {
+	if (opt_generate) {
+		/* Nothing to read, but the output needs a name */
+		if (argc - optind <= 0) {
+			fprintf(stderr, "ERROR: missing basename\n");
+			errorcnt++;
+		}
+	} else if (!infile) {
+		/* If we don't have an input file already, we need one */
 		if (argc - optind <= 0) {
 			fprintf(stderr, "ERROR: missing input filename\n");
 			errorcnt++;
@@ -403,7 +570,9 @@ static int do_create(int argc, char *argv[])
 	outext = outfile + strlen(outfile);
 
 	/* Okay, do it */
-	if (vboot_version == VBOOT_VERSION_1_0)
+	if (opt_generate)
+		r = generate_keypair();
+	else if (vboot_version == VBOOT_VERSION_1_0)
 		r = vb1_make_keypair();
 	else
 		r = vb2_make_keypair();
@@ -413,4 +582,4 @@ static int do_create(int argc, char *argv[])
 }
 
 DECLARE_FUTIL_COMMAND(create, do_create, VBOOT_VERSION_ALL,
-		      "Create a keypair from an RSA .pem file");
+		      "Create a keypair from an RSA or EC .pem file");
@@ -4,6 +4,7 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
 #include <stddef.h>
@@ -201,6 +202,23 @@ static uint8_t *create_gbb(const char *desc, off_t *sizeptr)
 	return buf;
 }
 
+/* Use the FMAP to find the GBB if there is one, else search the image. */
+static struct vb2_gbb_header *find_gbb_header(uint8_t *ptr, size_t size)
+{
+	FmapHeader *fmap = futil_find_fmap(ptr, size);
+	FmapAreaHeader *area;
+	uint8_t *gbb;
+
+	if (fmap) {
+		gbb = fmap_find_by_name(ptr, size, fmap, "GBB", &area);
+		if (gbb && futil_valid_gbb_header((struct vb2_gbb_header *)gbb,
+						  area->area_size, NULL))
+			return (struct vb2_gbb_header *)gbb;
+	}
+
+	return FindGbbHeader(ptr, size);
+}
+
 static uint8_t *read_entire_file(const char *filename, off_t *sizeptr)
 {
 	FILE *fp = NULL;
@@ -373,6 +391,12 @@ static int do_gbb(int argc, char *argv[])
 	uint8_t *outbuf = NULL;
 	struct vb2_gbb_header *gbb;
 	uint8_t *gbb_base;
+	int in_place = 0;
+	int map_fd = -1;
+	uint8_t *map_buf = NULL;
+	uint32_t map_len;
+	struct vb2_gbb_header *map_gbb = NULL;
+	uint32_t gbb_size;
 	int i;
 
 	opterr = 0;		/* quiet, you */
@@ -540,36 +564,83 @@ static int do_gbb(int argc, char *argv[])
 			return 1;
 		}
 
-		/* With no args, we'll either copy it unchanged or do nothing */
-		inbuf = read_entire_file(infile, &filesize);
-		if (!inbuf)
-			break;
+		/*
+		 * Editing a file in place only touches the GBB.  Map the
+		 * image, edit a copy of just the GBB, and put it back only if
+		 * everything worked, so the rest of the image is neither read
+		 * nor rewritten.
+		 */
+		in_place = !strcmp(outfile, infile);
+		if (in_place) {
+			map_fd = open(infile, O_RDWR);
+			if (map_fd < 0) {
+				fprintf(stderr,
+					"ERROR: Unable to open %s: %s\n",
+					infile, strerror(errno));
+				errorcnt++;
+				break;
+			}
+			if (futil_map_file(map_fd, MAP_RW, &map_buf,
+					   &map_len)) {
+				map_buf = NULL;
+				errorcnt++;
+				break;
+			}
 
-		gbb = FindGbbHeader(inbuf, filesize);
-		if (!gbb) {
-			fprintf(stderr, "ERROR: No GBB found in %s\n", infile);
-			break;
-		}
-		gbb_base = (uint8_t *) gbb;
+			map_gbb = find_gbb_header(map_buf, map_len);
+			if (!map_gbb) {
+				fprintf(stderr, "ERROR: No GBB found in %s\n",
+					infile);
+				break;
+			}
+			futil_valid_gbb_header(map_gbb, map_len, &gbb_size);
+			if (gbb_size > map_buf + map_len - (uint8_t *)map_gbb) {
+				fprintf(stderr,
+					"ERROR: GBB in %s is truncated\n",
+					infile);
+				errorcnt++;
+				break;
+			}
 
-		outbuf = (uint8_t *) malloc(filesize);
-		if (!outbuf) {
-			errorcnt++;
-			fprintf(stderr,
-				"ERROR: can't malloc %" PRIi64 " bytes: %s\n",
-				filesize, strerror(errno));
-			break;
-		}
+			outbuf = (uint8_t *) malloc(gbb_size);
+			if (!outbuf) {
+				errorcnt++;
+				fprintf(stderr, "ERROR: can't malloc %u bytes\n",
+					gbb_size);
+				break;
+			}
+			memcpy(outbuf, map_gbb, gbb_size);
+			gbb = (struct vb2_gbb_header *)outbuf;
+			gbb_base = outbuf;
+		} else {
+			/* With no args, we'll just copy it unchanged */
+			inbuf = read_entire_file(infile, &filesize);
+			if (!inbuf)
+				break;
+
+			gbb = find_gbb_header(inbuf, filesize);
+			if (!gbb) {
+				fprintf(stderr, "ERROR: No GBB found in %s\n",
+					infile);
+				break;
+			}
 
-		/* Switch pointers to outbuf */
-		memcpy(outbuf, inbuf, filesize);
-		gbb = FindGbbHeader(outbuf, filesize);
-		if (!gbb) {
-			fprintf(stderr,
-				"INTERNAL ERROR: No GBB found in outbuf\n");
-			exit(1);
+			outbuf = (uint8_t *) malloc(filesize);
+			if (!outbuf) {
+				errorcnt++;
+				fprintf(stderr,
+					"ERROR: can't malloc %" PRIi64
+					" bytes: %s\n",
+					filesize, strerror(errno));
+				break;
+			}
+
+			/* Switch pointers to outbuf */
+			memcpy(outbuf, inbuf, filesize);
+			gbb = (struct vb2_gbb_header *)
+				(outbuf + ((uint8_t *)gbb - inbuf));
+			gbb_base = (uint8_t *) gbb;
 		}
-		gbb_base = (uint8_t *) gbb;
 
 		if (opt_hwid) {
 			if (strlen(opt_hwid) + 1 > gbb->hwid_size) {
@@ -607,7 +678,9 @@ static int do_gbb(int argc, char *argv[])
 				       gbb_base + gbb->rootkey_offset,
 				       gbb->rootkey_size);
 
-			if (fill_ryu_root_header(outbuf, filesize, gbb))
+			/* In place, this waits until the GBB is written */
+			if (!in_place &&
+			    fill_ryu_root_header(outbuf, filesize, gbb))
 				errorcnt++;
 		}
 		if (opt_bmpfv)
@@ -618,12 +691,29 @@ static int do_gbb(int argc, char *argv[])
 			read_from_file("recovery_key", opt_recoverykey,
 				       gbb_base + gbb->recovery_key_offset,
 				       gbb->recovery_key_size);
+		if (opt_rootkey)
+			update_gbb_key_digest(gbb, 0);
+		if (opt_recoverykey)
+			update_gbb_key_digest(gbb, 1);
 
 		/* Write it out if there are no problems. */
-		if (!errorcnt)
+		if (errorcnt)
+			break;
+		if (!in_place) {
 			write_to_file("successfully saved new image to:",
 				      outfile, outbuf, filesize);
+			break;
+		}
 
+		/* Leave pages we didn't change clean */
+		if (memcmp(map_gbb, gbb, gbb_size))
+			memcpy(map_gbb, gbb, gbb_size);
+		if (opt_rootkey && fill_ryu_root_header(map_buf, map_len,
+							map_gbb))
+			errorcnt++;
+		else
+			printf("successfully saved new image to: %s\n",
+			       outfile);
 		break;
 
 	case DO_CREATE:
@@ -651,6 +741,13 @@ static int do_gbb(int argc, char *argv[])
 		break;
 	}
 
+	if (map_buf && futil_unmap_file(map_fd, MAP_RW, map_buf, map_len))
+		errorcnt++;
+	if (map_fd >= 0 && close(map_fd)) {
+		fprintf(stderr, "ERROR: Unable to close %s: %s\n",
+			infile, strerror(errno));
+		errorcnt++;
+	}
 	if (inbuf)
 		free(inbuf);
 	if (outbuf)
@@ -54,34 +54,48 @@ static const struct option long_opts[] = {
 static const char *short_opts = ":o:";
 
 
+/*
+ * Read the file straight into the mapped area, without going through a stdio
+ * buffer. Short files only replace the start of the area; the rest is left
+ * as it was.
+ */
 static int copy_to_area(char *file, uint8_t *buf, uint32_t len, char *area)
 {
-	FILE *fp;
+	int fd;
 	int retval = 0;
-	int n;
+	uint32_t n = 0;
+	ssize_t r = 0;
 
-	fp = fopen(file, "r");
-	if (!fp) {
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
 		fprintf(stderr, "area %s: can't open %s for reading: %s\n",
 			area, file, strerror(errno));
 		return 1;
 	}
 
-	n = fread(buf, 1, len, fp);
-	if (n == 0) {
-		if (feof(fp))
-			fprintf(stderr, "area %s: unexpected EOF on %s\n",
-				area, file);
-		if (ferror(fp))
-			fprintf(stderr, "area %s: can't read from %s: %s\n",
-				area, file, strerror(errno));
+	while (n < len) {
+		r = read(fd, buf + n, len - n);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		n += r;
+	}
+
+	if (r < 0) {
+		fprintf(stderr, "area %s: can't read from %s: %s\n",
+			area, file, strerror(errno));
+		retval = 1;
+	} else if (n == 0) {
+		fprintf(stderr, "area %s: unexpected EOF on %s\n",
+			area, file);
 		retval = 1;
 	} else if (n < len) {
 		fprintf(stderr, "Warning on area %s: only read %d "
 			"(not %d) from %s\n", area, n, len, file);
 	}
 
-	if (0 != fclose(fp)) {
+	if (0 != close(fd)) {
 		fprintf(stderr, "area %s: error closing %s: %s\n",
 			area, file, strerror(errno));
 		retval = 1;
@@ -99,6 +113,12 @@ static int do_load_fmap(int argc, char *argv[])
 	uint32_t len;
 	FmapHeader *fmap;
 	FmapAreaHeader *ah;
+	struct {
+		uint8_t *buf;
+		uint32_t size;
+		char *name;
+		char *file;
+	} *areas;
 	int errorcnt = 0;
 	int fd, i;
 
@@ -167,6 +187,17 @@ static int do_load_fmap(int argc, char *argv[])
 		goto done_map;
 	}
 
+	/*
+	 * Resolve every AREA:file argument before touching the image, so a
+	 * typo in the last argument doesn't leave the earlier areas loaded.
+	 */
+	areas = calloc(argc - optind, sizeof(*areas));
+	if (!areas) {
+		fprintf(stderr, "Out of memory\n");
+		errorcnt++;
+		goto done_map;
+	}
+
 	for (i = optind; i < argc; i++) {
 		char *a = argv[i];
 		char *f = strchr(a, ':');
@@ -174,22 +205,32 @@ static int do_load_fmap(int argc, char *argv[])
 		if (!f || a == f || *(f+1) == '\0') {
 			fprintf(stderr, "argument \"%s\" is bogus\n", a);
 			errorcnt++;
-			break;
+			goto done_areas;
 		}
 		*f++ = '\0';
-		uint8_t *area_buf = fmap_find_by_name(buf, len, fmap, a, &ah);
-		if (!area_buf) {
+		areas[i - optind].buf = fmap_find_by_name(buf, len, fmap, a,
+							  &ah);
+		if (!areas[i - optind].buf) {
 			fprintf(stderr, "Can't find area \"%s\" in FMAP\n", a);
 			errorcnt++;
-			break;
+			goto done_areas;
 		}
+		areas[i - optind].size = ah->area_size;
+		areas[i - optind].name = a;
+		areas[i - optind].file = f;
+	}
 
-		if (0 != copy_to_area(f, area_buf, ah->area_size, a)) {
+	for (i = 0; i < argc - optind; i++) {
+		if (0 != copy_to_area(areas[i].file, areas[i].buf,
+				      areas[i].size, areas[i].name)) {
 			errorcnt++;
 			break;
 		}
 	}
 
+done_areas:
+	free(areas);
+
 done_map:
 	errorcnt |= futil_unmap_file(fd, 1, buf, len);
 
@@ -7,6 +7,7 @@
 #include <getopt.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "2common.h"
@@ -16,6 +17,7 @@
 
 static const char usage[] = "\n"
 	"Usage:  " MYNAME " %s [OPTIONS] DIGEST [...]\n"
+	"        " MYNAME " %s --log < EVENTLOG\n"
 	"\n"
 	"This simulates a TPM PCR extension, to determine the expected output\n"
 	"\n"
@@ -23,10 +25,19 @@ static const char usage[] = "\n"
 	"appropriate length. The PCR is extended with each digest in turn\n"
 	"and the new value displayed.\n"
 	"\n"
+	"With --log, a whole event log is read from stdin and replayed into\n"
+	"every PCR bank it covers, and the final value of each PCR it touches\n"
+	"is displayed. A binary TCG event log (SHA1 or crypto-agile, such as\n"
+	"/sys/kernel/security/tpm0/binary_bios_measurements) is replayed\n"
+	"with the digests it records. A text log has one event per line,\n"
+	"\"PCR HEXDATA\", and the data is hashed for the SHA1 and SHA256\n"
+	"banks. Blank lines and lines starting with # are ignored.\n"
+	"\n"
 	"Options:\n"
 	"  -i      Initialize the PCR with the first DIGEST argument\n"
 	"            (the default is to start with all zeros)\n"
 	"  -2      Use sha256 DIGESTS (the default is sha1)\n"
+	"  --log   Replay an event log from stdin\n"
 	"\n"
 	"Examples:\n"
 	"\n"
@@ -37,7 +48,7 @@ static const char usage[] = "\n"
 
 static void print_help(int argc, char *argv[])
 {
-	printf(usage, argv[0], argv[0], argv[0]);
+	printf(usage, argv[0], argv[0], argv[0], argv[0]);
 }
 
 static int parse_hex(uint8_t *val, const char *str)
@@ -98,11 +109,428 @@ static void print_digest(const uint8_t *buf, int len)
 		printf("%02x", buf[i]);
 }
 
+/* PCRs in a PC Client TPM */
+#define NUM_PCRS 24
+/* Most PCR banks an event log can describe */
+#define MAX_BANKS 8
+/* Text log events hashed together before extending */
+#define TEXT_BATCH 64
+
+/* TCG event types and signatures the replay cares about */
+#define EV_NO_ACTION 3
+static const char spec_id_sig[16] = "Spec ID Event03";
+static const char locality_sig[16] = "StartupLocality";
+
+static const struct {
+	uint16_t tpm_alg;
+	enum vb2_hash_algorithm hash_alg;
+} tpm_algs[] = {
+	{0x0004, VB2_HASH_SHA1},
+	{0x000b, VB2_HASH_SHA256},
+	{0x000d, VB2_HASH_SHA512},
+};
+
+struct pcr_bank {
+	uint16_t tpm_alg;
+	uint16_t digest_size;
+	/* VB2_HASH_INVALID if we can't compute this bank */
+	enum vb2_hash_algorithm hash_alg;
+	uint8_t pcr[NUM_PCRS][VB2_MAX_DIGEST_SIZE];
+};
+
+struct event_log {
+	struct pcr_bank bank[MAX_BANKS];
+	int num_banks;
+	/* Bit n is set once PCR n has changed from zero */
+	uint32_t touched;
+	int num_events;
+};
+
+static int add_bank(struct event_log *log, uint16_t tpm_alg,
+		    uint16_t digest_size)
+{
+	struct pcr_bank *bank;
+	int i;
+
+	if (log->num_banks >= MAX_BANKS) {
+		fprintf(stderr, "Too many PCR banks in event log\n");
+		return 1;
+	}
+
+	bank = &log->bank[log->num_banks++];
+	memset(bank, 0, sizeof(*bank));
+	bank->tpm_alg = tpm_alg;
+	bank->digest_size = digest_size;
+	bank->hash_alg = VB2_HASH_INVALID;
+	for (i = 0; i < ARRAY_SIZE(tpm_algs); i++) {
+		if (tpm_algs[i].tpm_alg == tpm_alg &&
+		    vb2_digest_size(tpm_algs[i].hash_alg) == digest_size)
+			bank->hash_alg = tpm_algs[i].hash_alg;
+	}
+	if (bank->hash_alg == VB2_HASH_INVALID)
+		fprintf(stderr, "Skipping unsupported PCR bank 0x%04x\n",
+			tpm_alg);
+	return 0;
+}
+
+static struct pcr_bank *find_bank(struct event_log *log, uint16_t tpm_alg)
+{
+	int i;
+
+	for (i = 0; i < log->num_banks; i++)
+		if (log->bank[i].tpm_alg == tpm_alg)
+			return &log->bank[i];
+	return NULL;
+}
+
+static int extend_bank(struct event_log *log, struct pcr_bank *bank,
+		       uint32_t pcr, const uint8_t *digest)
+{
+	uint8_t accum[VB2_MAX_DIGEST_SIZE * 2];
+	int size = bank->digest_size;
+
+	if (bank->hash_alg == VB2_HASH_INVALID)
+		return 0;
+
+	memcpy(accum, bank->pcr[pcr], size);
+	memcpy(accum + size, digest, size);
+	if (VB2_SUCCESS != vb2_digest_buffer(accum, size * 2, bank->hash_alg,
+					     bank->pcr[pcr], size)) {
+		fprintf(stderr, "Error computing digest!\n");
+		return 1;
+	}
+	log->touched |= 1U << pcr;
+	return 0;
+}
+
+/* A StartupLocality event sets the initial value of PCR 0 */
+static void no_action_event(struct event_log *log, uint32_t pcr,
+			    const uint8_t *data, uint32_t size)
+{
+	int i;
+
+	if (pcr != 0 || size < sizeof(locality_sig) + 1 ||
+	    memcmp(data, locality_sig, sizeof(locality_sig)))
+		return;
+
+	for (i = 0; i < log->num_banks; i++) {
+		struct pcr_bank *bank = &log->bank[i];
+		bank->pcr[0][bank->digest_size - 1] =
+			data[sizeof(locality_sig)];
+	}
+	log->touched |= 1;
+}
+
+static int read_bytes(FILE *fp, void *buf, size_t size)
+{
+	if (size && fread(buf, size, 1, fp) != 1) {
+		fprintf(stderr, "Truncated event log\n");
+		return 1;
+	}
+	return 0;
+}
+
+/* Read an event's data into *data, growing it as needed */
+static int read_event_data(FILE *fp, uint8_t **data, uint32_t *alloc,
+			   uint32_t *size)
+{
+	if (read_bytes(fp, size, sizeof(*size)))
+		return 1;
+	if (*size > *alloc) {
+		uint8_t *bigger = realloc(*data, *size);
+		if (!bigger) {
+			fprintf(stderr, "Event of %u bytes is too big\n",
+				*size);
+			return 1;
+		}
+		*data = bigger;
+		*alloc = *size;
+	}
+	return read_bytes(fp, *data, *size);
+}
+
+/* Banks listed in the Spec ID event that starts a crypto-agile log */
+static int parse_spec_id(struct event_log *log, const uint8_t *data,
+			 uint32_t size)
+{
+	/* signature, platformClass, version, uintnSize */
+	uint32_t offset = sizeof(spec_id_sig) + 4 + 3 + 1;
+	uint32_t count, i;
+
+	if (size < offset + 4)
+		goto bad;
+	memcpy(&count, data + offset, sizeof(count));
+	offset += 4;
+	if (count > (size - offset) / 4)
+		goto bad;
+
+	for (i = 0; i < count; i++, offset += 4) {
+		uint16_t tpm_alg, digest_size;
+		memcpy(&tpm_alg, data + offset, sizeof(tpm_alg));
+		memcpy(&digest_size, data + offset + 2, sizeof(digest_size));
+		if (digest_size > VB2_MAX_DIGEST_SIZE)
+			goto bad;
+		if (add_bank(log, tpm_alg, digest_size))
+			return 1;
+	}
+	return 0;
+
+bad:
+	fprintf(stderr, "Invalid Spec ID event\n");
+	return 1;
+}
+
+static int replay_binary_log(FILE *fp, struct event_log *log)
+{
+	uint8_t *data = NULL;
+	uint32_t alloc = 0, size;
+	int agile = 0;
+	int rv = 1;
+
+	for (;;) {
+		uint32_t hdr[2];	/* pcrIndex, eventType */
+		uint8_t digest[VB2_MAX_DIGEST_SIZE];
+		uint32_t pcr, type, count, i;
+		size_t got = fread(hdr, 1, sizeof(hdr), fp);
+
+		if (!got && feof(fp))
+			break;
+		if (got != sizeof(hdr)) {
+			fprintf(stderr, "Truncated event log\n");
+			goto out;
+		}
+		pcr = hdr[0];
+		type = hdr[1];
+		if (pcr >= NUM_PCRS) {
+			fprintf(stderr, "Event %d is for invalid PCR %u\n",
+				log->num_events, pcr);
+			goto out;
+		}
+
+		if (!agile) {
+			/* TCG_PCR_EVENT: one SHA1 digest */
+			if (read_bytes(fp, digest, VB2_SHA1_DIGEST_SIZE) ||
+			    read_event_data(fp, &data, &alloc, &size))
+				goto out;
+			if (!log->num_events && type == EV_NO_ACTION &&
+			    size >= sizeof(spec_id_sig) &&
+			    !memcmp(data, spec_id_sig, sizeof(spec_id_sig))) {
+				if (parse_spec_id(log, data, size))
+					goto out;
+				agile = 1;
+				log->num_events++;
+				continue;
+			}
+			if (!log->num_banks &&
+			    add_bank(log, 0x0004, VB2_SHA1_DIGEST_SIZE))
+				goto out;
+			if (type == EV_NO_ACTION)
+				no_action_event(log, pcr, data, size);
+			else if (extend_bank(log, &log->bank[0], pcr, digest))
+				goto out;
+			log->num_events++;
+			continue;
+		}
+
+		/* TCG_PCR_EVENT2: a digest for each bank, then the data */
+		if (read_bytes(fp, &count, sizeof(count)))
+			goto out;
+		for (i = 0; i < count; i++) {
+			uint16_t tpm_alg;
+			struct pcr_bank *bank;
+
+			if (read_bytes(fp, &tpm_alg, sizeof(tpm_alg)))
+				goto out;
+			bank = find_bank(log, tpm_alg);
+			if (!bank) {
+				fprintf(stderr, "Event %d uses unknown "
+					"algorithm 0x%04x\n",
+					log->num_events, tpm_alg);
+				goto out;
+			}
+			if (read_bytes(fp, digest, bank->digest_size))
+				goto out;
+			if (type != EV_NO_ACTION &&
+			    extend_bank(log, bank, pcr, digest))
+				goto out;
+		}
+		if (read_event_data(fp, &data, &alloc, &size))
+			goto out;
+		if (type == EV_NO_ACTION)
+			no_action_event(log, pcr, data, size);
+		log->num_events++;
+	}
+	rv = 0;
+
+out:
+	free(data);
+	return rv;
+}
+
+struct text_event {
+	uint32_t pcr;
+	uint8_t *data;
+	uint32_t size;
+	uint8_t digest[2][VB2_MAX_DIGEST_SIZE];
+};
+
+/*
+ * Hash a batch of text events for both banks at once, so the vector SHA-256
+ * code gets several buffers to work on, then extend them in order.
+ */
+static int replay_text_batch(struct event_log *log, struct text_event *ev,
+			     int count)
+{
+	struct vb2_digest_job jobs[TEXT_BATCH * 2];
+	int i, b;
+
+	for (i = 0; i < count; i++) {
+		for (b = 0; b < 2; b++) {
+			struct vb2_digest_job *job = &jobs[i * 2 + b];
+			job->buf = ev[i].data;
+			job->size = ev[i].size;
+			job->hash_alg = log->bank[b].hash_alg;
+			job->digest = ev[i].digest[b];
+			job->digest_size = log->bank[b].digest_size;
+		}
+	}
+	if (VB2_SUCCESS != vb2_digest_buffers_multi(jobs, count * 2)) {
+		fprintf(stderr, "Error computing digest!\n");
+		return 1;
+	}
+
+	for (i = 0; i < count; i++)
+		for (b = 0; b < 2; b++)
+			if (extend_bank(log, &log->bank[b], ev[i].pcr,
+					ev[i].digest[b]))
+				return 1;
+	return 0;
+}
+
+static int replay_text_log(FILE *fp, struct event_log *log)
+{
+	struct text_event ev[TEXT_BATCH];
+	char *line = NULL;
+	size_t line_alloc = 0;
+	ssize_t len;
+	int lineno = 0;
+	int count = 0;
+	int rv = 1;
+	int i;
+
+	memset(ev, 0, sizeof(ev));
+	if (add_bank(log, 0x0004, VB2_SHA1_DIGEST_SIZE) ||
+	    add_bank(log, 0x000b, VB2_SHA256_DIGEST_SIZE))
+		return 1;
+
+	while ((len = getline(&line, &line_alloc, fp)) >= 0) {
+		struct text_event *e = &ev[count];
+		char *s = line, *end;
+		unsigned long pcr;
+
+		lineno++;
+		while (isspace(*s))
+			s++;
+		if (!*s || *s == '#')
+			continue;
+
+		pcr = strtoul(s, &end, 0);
+		if (end == s || (*end && !isspace(*end)) || pcr >= NUM_PCRS) {
+			fprintf(stderr, "Invalid PCR on line %d\n", lineno);
+			goto out;
+		}
+
+		/* Hex data is at most half the line */
+		free(e->data);
+		e->data = malloc(len / 2 + 1);
+		if (!e->data) {
+			fprintf(stderr, "Line %d is too long\n", lineno);
+			goto out;
+		}
+		e->pcr = pcr;
+		e->size = 0;
+		for (s = end; *s; s += 2) {
+			while (*s && isspace(*s))
+				s++;
+			if (!*s)
+				break;
+			if (!parse_hex(e->data + e->size, s)) {
+				fprintf(stderr, "Invalid data on line %d\n",
+					lineno);
+				goto out;
+			}
+			e->size++;
+		}
+
+		if (++count == TEXT_BATCH) {
+			if (replay_text_batch(log, ev, count))
+				goto out;
+			log->num_events += count;
+			count = 0;
+		}
+	}
+	if (count && replay_text_batch(log, ev, count))
+		goto out;
+	log->num_events += count;
+	rv = 0;
+
+out:
+	for (i = 0; i < TEXT_BATCH; i++)
+		free(ev[i].data);
+	free(line);
+	return rv;
+}
+
+static int do_pcr_log(FILE *fp)
+{
+	struct event_log *log;
+	int c, i, b;
+	int rv;
+
+	log = calloc(1, sizeof(*log));
+	if (!log) {
+		fprintf(stderr, "Couldn't allocate memory\n");
+		return 1;
+	}
+
+	/* Text logs start with a PCR number or a comment */
+	c = getc(fp);
+	if (c != EOF)
+		ungetc(c, fp);
+	if (c == EOF || isprint(c) || isspace(c))
+		rv = replay_text_log(fp, log);
+	else
+		rv = replay_binary_log(fp, log);
+	if (rv)
+		goto out;
+
+	printf("Events: %d\n", log->num_events);
+	for (i = 0; i < NUM_PCRS; i++) {
+		if (!(log->touched & (1U << i)))
+			continue;
+		for (b = 0; b < log->num_banks; b++) {
+			struct pcr_bank *bank = &log->bank[b];
+			if (bank->hash_alg == VB2_HASH_INVALID)
+				continue;
+			printf("PCR %2d %-6s ", i,
+			       vb2_get_hash_algorithm_name(bank->hash_alg));
+			print_digest(bank->pcr[i], bank->digest_size);
+			printf("\n");
+		}
+	}
+
+out:
+	free(log);
+	return rv;
+}
+
 enum {
 	OPT_HELP = 1000,
+	OPT_LOG,
 };
 static const struct option long_opts[] = {
 	{"help",     0, 0, OPT_HELP},
+	{"log",      0, 0, OPT_LOG},
 	{NULL, 0, 0, 0}
 };
 static int do_pcr(int argc, char *argv[])
@@ -112,6 +540,7 @@ static int do_pcr(int argc, char *argv[])
 	int digest_alg = VB2_HASH_SHA1;
 	int digest_size;
 	int opt_init = 0;
+	int opt_log = 0;
 	int errorcnt = 0;
 	int i;
 
@@ -124,6 +553,9 @@ static int do_pcr(int argc, char *argv[])
 		case '2':
 			digest_alg = VB2_HASH_SHA256;
 			break;
+		case OPT_LOG:
+			opt_log = 1;
+			break;
 		case OPT_HELP:
 			print_help(argc, argv);
 			return !!errorcnt;
@@ -149,6 +581,15 @@ static int do_pcr(int argc, char *argv[])
 		return 1;
 	}
 
+	if (opt_log) {
+		if (opt_init || argc > optind) {
+			fprintf(stderr, "--log takes no DIGEST arguments\n");
+			print_help(argc, argv);
+			return 1;
+		}
+		return do_pcr_log(stdin);
+	}
+
 	if (argc - optind < 1 + opt_init) {
 		fprintf(stderr, "You must extend at least one DIGEST\n");
 		print_help(argc, argv);
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "2api.h"
@@ -29,9 +30,11 @@
 #include "futility_options.h"
 #include "host_common.h"
 #include "host_key21.h"
+#include "kernel_blob.h"
 #include "util_misc.h"
 #include "vb1_helper.h"
 #include "vb2_common.h"
+#include "vboot_struct.h"
 
 /* Options */
 struct show_option_s show_option = {
@@ -83,6 +86,52 @@ static void show_keyblock(struct vb2_keyblock *keyblock, const char *name,
 	       packed_key_sha1_string(data_key));
 }
 
+/* Where to report problems, keeping them out of any JSON on stdout */
+static FILE *status_out(void)
+{
+	return show_option.json ? stderr : stdout;
+}
+
+/* Print len chars of str as a JSON string */
+static void json_string(const char *str, size_t len)
+{
+	size_t i;
+
+	putchar('"');
+	for (i = 0; i < len; i++) {
+		unsigned char c = str[i];
+
+		if (c == '"' || c == '\\')
+			printf("\\%c", c);
+		else if (c < 0x20)
+			printf("\\u%04x", c);
+		else
+			putchar(c);
+	}
+	putchar('"');
+}
+
+static void json_packed_key(const char *label,
+			    const struct vb2_packed_key *key)
+{
+	printf("\"%s\": {\"algorithm\": %u, \"algorithm_name\": \"%s\", "
+	       "\"version\": %u, \"sha1sum\": \"%s\"}",
+	       label, key->algorithm,
+	       vb2_get_crypto_algorithm_name(key->algorithm),
+	       key->key_version, packed_key_sha1_string(key));
+}
+
+static void json_keyblock(const struct vb2_keyblock *keyblock,
+			  int sign_key, int good_sig)
+{
+	printf("\"keyblock\": {\"signature\": \"%s\", \"size\": %u, "
+	       "\"flags\": %u, ",
+	       sign_key ? (good_sig ? "valid" : "invalid") : "ignored",
+	       keyblock->keyblock_size, keyblock->keyblock_flags);
+	json_packed_key("data_key", &keyblock->data_key);
+	printf("}");
+}
+
 int ft_show_pubkey(const char *name, uint8_t *buf, uint32_t len, void *data)
 {
 	struct vb2_packed_key *pubkey = (struct vb2_packed_key *)buf;
@@ -102,7 +151,7 @@ int ft_show_privkey(const char *name, uint8_t *buf, uint32_t len, void *data)
 {
 	struct vb2_packed_private_key *pkey =
 		(struct vb2_packed_private_key *)buf;
-	struct vb2_private_key key;
+	struct vb2_private_key key = {0};
 	const unsigned char *start = pkey->key_data;
 
 	if (len <= sizeof(*pkey)) {
@@ -157,12 +206,15 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 	uint8_t *fv_data = show_option.fv;
 	uint64_t fv_size = show_option.fv_size;
 	struct bios_area_s *fw_body_area = 0;
+	const char *body;
 	int good_sig = 0;
 	int retval = 0;
+	vb2_error_t rv;
 
 	/* Check the hash... */
 	if (VB2_SUCCESS != vb2_verify_keyblock_hash(keyblock, len, &wb)) {
-		printf("%s keyblock component is invalid\n", name);
+		fprintf(status_out(), "%s keyblock component is invalid\n",
+			name);
 		return 1;
 	}
 
@@ -195,7 +247,8 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 	    vb2_verify_keyblock(keyblock, len, sign_key, &wb))
 		good_sig = 1;
 
-	show_keyblock(keyblock, name, !!sign_key, good_sig);
+	if (!show_option.json)
+		show_keyblock(keyblock, name, !!sign_key, good_sig);
 
 	if (show_option.strict && (!sign_key || !good_sig))
 		retval = 1;
@@ -210,7 +263,7 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 	struct vb2_fw_preamble *pre2 = (struct vb2_fw_preamble *)(buf + more);
 	if (VB2_SUCCESS != vb2_verify_fw_preamble(pre2, len - more,
 						  &data_key, &wb)) {
-		printf("%s is invalid\n", name);
+		fprintf(status_out(), "%s is invalid\n", name);
 		return 1;
 	}
 
@@ -218,27 +271,40 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 	if (pre2->header_version_minor < 1)
 		flags = 0;  /* Old 2.0 structure didn't have flags */
 
-	printf("Firmware Preamble:\n");
-	printf("  Size:                  %d\n", pre2->preamble_size);
-	printf("  Header version:        %d.%d\n",
-	       pre2->header_version_major, pre2->header_version_minor);
-	printf("  Firmware version:      %d\n", pre2->firmware_version);
-
 	struct vb2_packed_key *kernel_subkey = &pre2->kernel_subkey;
-	printf("  Kernel key algorithm:  %d %s\n",
-	       kernel_subkey->algorithm,
-	       vb2_get_crypto_algorithm_name(kernel_subkey->algorithm));
 	if (kernel_subkey->algorithm >= VB2_ALG_COUNT)
 		retval = 1;
-	printf("  Kernel key version:    %d\n", kernel_subkey->key_version);
-	printf("  Kernel key sha1sum:    %s\n",
-	       packed_key_sha1_string(kernel_subkey));
-	printf("  Firmware body size:    %d\n", pre2->body_signature.data_size);
-	printf("  Preamble flags:        %d\n", flags);
+
+	if (!show_option.json) {
+		printf("Firmware Preamble:\n");
+		printf("  Size:                  %d\n", pre2->preamble_size);
+		printf("  Header version:        %d.%d\n",
+		       pre2->header_version_major, pre2->header_version_minor);
+		printf("  Firmware version:      %d\n", pre2->firmware_version);
+		printf("  Kernel key algorithm:  %d %s\n",
+		       kernel_subkey->algorithm,
+		       vb2_get_crypto_algorithm_name(kernel_subkey->algorithm));
+		printf("  Kernel key version:    %d\n",
+		       kernel_subkey->key_version);
+		printf("  Kernel key sha1sum:    %s\n",
+		       packed_key_sha1_string(kernel_subkey));
+		printf("  Firmware body size:    %d\n",
+		       pre2->body_signature.data_size);
+		printf("  Preamble flags:        %d\n", flags);
+	}
 
 	if (flags & VB2_FIRMWARE_PREAMBLE_USE_RO_NORMAL) {
-		printf("Preamble requests USE_RO_NORMAL;"
-		       " skipping body verification.\n");
+		if (!show_option.json)
+			printf("Preamble requests USE_RO_NORMAL;"
+			       " skipping body verification.\n");
+		body = "ro_normal";
+		goto done;
+	}
+
+	if (show_option.skip_body) {
+		if (!show_option.json)
+			printf("Skipping body verification.\n");
+		body = "skipped";
 		goto done;
 	}
 
@@ -249,33 +315,64 @@ int ft_show_fw_preamble(const char *name, uint8_t *buf, uint32_t len,
 	}
 
 	if (!fv_data) {
-		printf("No firmware body available to verify.\n");
-		if (show_option.strict)
-			return 1;
-		return 0;
+		if (!show_option.json)
+			printf("No firmware body available to verify.\n");
+		body = "unavailable";
+		retval = show_option.strict;
+		goto out;
 	}
 
-	if (VB2_SUCCESS !=
-	    vb2_verify_data(fv_data, fv_size, &pre2->body_signature,
-			    &data_key, &wb)) {
+	if (state && fw_body_area && fw_body_area->is_valid &&
+	    state->body_digest[state->c].done &&
+	    state->body_digest[state->c].data_size ==
+	    pre2->body_signature.data_size)
+		rv = vb2_verify_digest(&data_key, &pre2->body_signature,
+				       state->body_digest[state->c].digest,
+				       &wb);
+	else if (flags & VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH)
+		rv = vb2_verify_tree_data(fv_data, fv_size,
+					  &pre2->body_signature, &data_key,
+					  &wb);
+	else
+		rv = vb2_verify_data(fv_data, fv_size, &pre2->body_signature,
+				     &data_key, &wb);
+	if (VB2_SUCCESS != rv) {
 		fprintf(stderr, "Error verifying firmware body.\n");
 		return 1;
 	}
+	body = "verified";
 
 done:
 	/* Can't trust the BIOS unless everything is signed (in which case
 	 * we've already returned), but standalone files are okay. */
 	if (state || (sign_key && good_sig)) {
-		if (!(flags & VB2_FIRMWARE_PREAMBLE_USE_RO_NORMAL))
+		if (!show_option.json && !strcmp(body, "verified"))
 			printf("Body verification succeeded.\n");
 		if (state)
 			state->area[state->c].is_valid = 1;
 	} else {
-		printf("Seems legit, but the signature is unverified.\n");
+		if (!show_option.json)
+			printf("Seems legit, but the signature is unverified.\n");
 		if (show_option.strict)
 			retval = 1;
 	}
 
+out:
+	if (show_option.json) {
+		printf("{\"file\": ");
+		json_string(name, strlen(name));
+		printf(", ");
+		json_keyblock(keyblock, !!sign_key, good_sig);
+		printf(", \"preamble\": {\"size\": %u, "
+		       "\"header_version\": \"%u.%u\", "
+		       "\"firmware_version\": %u, ",
+		       pre2->preamble_size, pre2->header_version_major,
+		       pre2->header_version_minor, pre2->firmware_version);
+		json_packed_key("kernel_subkey", kernel_subkey);
+		printf(", \"body_size\": %u, \"flags\": %u}, \"body\": \"%s\"}\n",
+		       pre2->body_signature.data_size, flags, body);
+	}
+
 	return retval;
 }
 
@@ -284,11 +381,13 @@ int ft_show_kernel_preamble(const char *name, uint8_t *buf, uint32_t len,
 {
 	struct vb2_keyblock *keyblock = (struct vb2_keyblock *)buf;
 	struct vb2_public_key *sign_key = show_option.k;
+	const char *body;
 	int retval = 0;
 
 	/* Check the hash... */
 	if (VB2_SUCCESS != vb2_verify_keyblock_hash(keyblock, len, &wb)) {
-		printf("%s keyblock component is invalid\n", name);
+		fprintf(status_out(), "%s keyblock component is invalid\n",
+			name);
 		return 1;
 	}
 
@@ -298,8 +397,10 @@ int ft_show_kernel_preamble(const char *name, uint8_t *buf, uint32_t len,
 	    vb2_verify_keyblock(keyblock, len, sign_key, &wb))
 		good_sig = 1;
 
-	printf("Kernel partition:        %s\n", name);
-	show_keyblock(keyblock, NULL, !!sign_key, good_sig);
+	if (!show_option.json) {
+		printf("Kernel partition:        %s\n", name);
+		show_keyblock(keyblock, NULL, !!sign_key, good_sig);
+	}
 
 	if (show_option.strict && (!sign_key || !good_sig))
 		retval = 1;
@@ -316,37 +417,40 @@ int ft_show_kernel_preamble(const char *name, uint8_t *buf, uint32_t len,
 
 	if (VB2_SUCCESS != vb2_verify_kernel_preamble(pre2, len - more,
 						      &data_key, &wb)) {
-		printf("%s is invalid\n", name);
+		fprintf(status_out(), "%s is invalid\n", name);
 		return 1;
 	}
 
-	printf("Kernel Preamble:\n");
-	printf("  Size:                  %#x\n", pre2->preamble_size);
-	printf("  Header version:        %u.%u\n",
-	       pre2->header_version_major,
-	       pre2->header_version_minor);
-	printf("  Kernel version:        %u\n", pre2->kernel_version);
-	printf("  Body load address:     0x%" PRIx64 "\n",
-	       pre2->body_load_address);
-	printf("  Body size:             %#x\n",
-	       pre2->body_signature.data_size);
-	printf("  Bootloader address:    0x%" PRIx64 "\n",
-	       pre2->bootloader_address);
-	printf("  Bootloader size:       %#x\n", pre2->bootloader_size);
-
 	uint64_t vmlinuz_header_address = 0;
 	uint32_t vmlinuz_header_size = 0;
 	vb2_kernel_get_vmlinuz_header(pre2,
 				      &vmlinuz_header_address,
 				      &vmlinuz_header_size);
-	if (vmlinuz_header_size) {
-		printf("  Vmlinuz_header address:    0x%" PRIx64 "\n",
-		       vmlinuz_header_address);
-		printf("  Vmlinuz header size:       %#x\n",
-		       vmlinuz_header_size);
-	}
 
-	printf("  Flags:                 %#x\n", vb2_kernel_get_flags(pre2));
+	if (!show_option.json) {
+		printf("Kernel Preamble:\n");
+		printf("  Size:                  %#x\n", pre2->preamble_size);
+		printf("  Header version:        %u.%u\n",
+		       pre2->header_version_major,
+		       pre2->header_version_minor);
+		printf("  Kernel version:        %u\n", pre2->kernel_version);
+		printf("  Body load address:     0x%" PRIx64 "\n",
+		       pre2->body_load_address);
+		printf("  Body size:             %#x\n",
+		       pre2->body_signature.data_size);
+		printf("  Bootloader address:    0x%" PRIx64 "\n",
+		       pre2->bootloader_address);
+		printf("  Bootloader size:       %#x\n",
+		       pre2->bootloader_size);
+		if (vmlinuz_header_size) {
+			printf("  Vmlinuz_header address:    0x%" PRIx64 "\n",
+			       vmlinuz_header_address);
+			printf("  Vmlinuz header size:       %#x\n",
+			       vmlinuz_header_size);
+		}
+		printf("  Flags:                 %#x\n",
+		       vb2_kernel_get_flags(pre2));
+	}
 
 	/* Verify kernel body */
 	uint8_t *kernel_blob = 0;
@@ -361,30 +465,110 @@ int ft_show_kernel_preamble(const char *name, uint8_t *buf, uint32_t len,
 		kernel_size = len - show_option.padding;
 	}
 
-	if (!kernel_blob) {
-		/* TODO: Is this always a failure? The preamble is okay. */
-		fprintf(stderr, "No kernel blob available to verify.\n");
-		return 1;
-	}
+	if (show_option.skip_body) {
+		if (!show_option.json)
+			printf("Skipping body verification.\n");
+		body = "skipped";
+	} else {
+		if (!kernel_blob) {
+			/* TODO: Is this always a failure? The preamble is
+			 * okay. */
+			fprintf(stderr,
+				"No kernel blob available to verify.\n");
+			return 1;
+		}
 
-	if (VB2_SUCCESS !=
-	    vb2_verify_data(kernel_blob, kernel_size, &pre2->body_signature,
-			    &data_key, &wb)) {
-		fprintf(stderr, "Error verifying kernel body.\n");
-		return 1;
+		if (VB2_SUCCESS !=
+		    vb2_verify_data(kernel_blob, kernel_size,
+				    &pre2->body_signature, &data_key, &wb)) {
+			fprintf(stderr, "Error verifying kernel body.\n");
+			return 1;
+		}
+
+		if (!show_option.json)
+			printf("Body verification succeeded.\n");
+		body = "verified";
 	}
 
-	printf("Body verification succeeded.\n");
+	/* The config is unverified if the body was skipped */
+	const char *config = NULL;
+	uint64_t config_ofs = kernel_cmd_line_offset(pre2);
+	if (kernel_blob && config_ofs < kernel_size)
+		config = (const char *)kernel_blob + config_ofs;
 
-	printf("Config:\n%s\n", kernel_blob + kernel_cmd_line_offset(pre2));
+	if (!show_option.json) {
+		if (config)
+			printf("Config:\n%s\n", config);
+		return retval;
+	}
+
+	printf("{\"file\": ");
+	json_string(name, strlen(name));
+	printf(", ");
+	json_keyblock(keyblock, !!sign_key, good_sig);
+	printf(", \"preamble\": {\"size\": %u, \"header_version\": \"%u.%u\", "
+	       "\"kernel_version\": %u, "
+	       "\"body_load_address\": %" PRIu64 ", \"body_size\": %u, "
+	       "\"bootloader_address\": %" PRIu64 ", "
+	       "\"bootloader_size\": %u, "
+	       "\"vmlinuz_header_address\": %" PRIu64 ", "
+	       "\"vmlinuz_header_size\": %u, \"flags\": %u}, "
+	       "\"body\": \"%s\"",
+	       pre2->preamble_size, pre2->header_version_major,
+	       pre2->header_version_minor, pre2->kernel_version,
+	       pre2->body_load_address, pre2->body_signature.data_size,
+	       pre2->bootloader_address, pre2->bootloader_size,
+	       vmlinuz_header_address, vmlinuz_header_size,
+	       vb2_kernel_get_flags(pre2), body);
+	if (config) {
+		printf(", \"config\": ");
+		json_string(config, strnlen(config, CROS_CONFIG_SIZE));
+	}
+	printf("}\n");
 
 	return retval;
 }
 
+int ft_show_vbsd(const char *name, uint8_t *buf, uint32_t len, void *data)
+{
+	VbSharedDataHeader *sh = (VbSharedDataHeader *)buf;
+	uint32_t count, prev_us, i;
+
+	printf("VbSharedData:            %s\n", name);
+	printf("  Struct version:        %u\n", sh->struct_version);
+	printf("  Flags:                 %#x\n", sh->flags);
+	printf("  Firmware index:        %#x\n", sh->firmware_index);
+
+	if (sh->struct_version < 2 || len < VB_SHARED_DATA_HEADER_SIZE_V2)
+		return 0;
+	printf("  Recovery reason:       %#x\n", sh->recovery_reason);
+
+	if (sh->struct_version < 3 || len < VB_SHARED_DATA_HEADER_SIZE_V3)
+		return 0;
+
+	count = sh->timestamp_count;
+	if (count > VBSD_MAX_TIMESTAMPS)
+		count = VBSD_MAX_TIMESTAMPS;
+	printf("  Timestamps:            %u\n", count);
+	prev_us = count ? sh->timestamps[0].time_us : 0;
+	for (i = 0; i < count; i++) {
+		const VbSharedDataTimestamp *ts = &sh->timestamps[i];
+
+		printf("    %-24s %10u us  (+%u)\n",
+		       vb2_timestamp_event_name(ts->event), ts->time_us,
+		       ts->time_us - prev_us);
+		prev_us = ts->time_us;
+	}
+
+	return 0;
+}
+
 enum no_short_opts {
 	OPT_PADDING = 1000,
 	OPT_TYPE,
 	OPT_PUBKEY,
+	OPT_VERIFY,
+	OPT_FORMAT,
 	OPT_HELP,
 };
 
@@ -405,6 +589,14 @@ static const char usage[] = "\n"
 	"  -t                               Just show the type of each file\n"
 	"  --type           TYPE            Override the detected file type\n"
 	"                                     Use \"--type help\" for a list\n"
+	"  -j|--jobs        NUM             Check (or with -t, identify) up to\n"
+	"                                     NUM files at once\n"
+	"  --verify         LEVEL           \"full\" (default), or \"headers\" to\n"
+	"                                     skip hashing firmware and kernel\n"
+	"                                     bodies\n"
+	"  --format         FORMAT          \"text\" (default), or \"json\" for\n"
+	"                                     firmware vblocks and kernel\n"
+	"                                     partitions\n"
 	"Type-specific options:\n"
 	"  -k|--publickey   FILE.vbpubk     Public key in vb1 format\n"
 	"  --pubkey         FILE.vpubk2     Public key in vb2 format\n"
@@ -433,13 +625,16 @@ static const struct option long_opts[] = {
 	{"type",        1, NULL, OPT_TYPE},
 	{"strict",      0, &show_option.strict, 1},
 	{"pubkey",      1, NULL, OPT_PUBKEY},
+	{"jobs",        1, NULL, 'j'},
+	{"verify",      1, NULL, OPT_VERIFY},
+	{"format",      1, NULL, OPT_FORMAT},
 	{"help",        0, NULL, OPT_HELP},
 	{NULL, 0, NULL, 0},
 };
-static const char *short_opts = ":f:k:t";
+static const char *short_opts = ":f:j:k:t";
 
 
-static int show_type(char *filename)
+static int show_type(const char *filename)
 {
 	enum futil_file_err err;
 	enum futil_file_type type;
@@ -468,18 +663,181 @@ static int show_type(char *filename)
 	return 1;
 }
 
+static int show_file(const char *infile, int type_override)
+{
+	enum futil_file_type type;
+	int errorcnt = 0;
+	uint8_t *buf;
+	uint32_t len;
+	int ifd;
+
+	ifd = open(infile, O_RDONLY);
+	if (ifd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n",
+			infile, strerror(errno));
+		return 1;
+	}
+
+	if (0 != futil_map_file(ifd, MAP_RO, &buf, &len)) {
+		errorcnt++;
+		goto boo;
+	}
+
+	/* Allow the user to override the type */
+	if (type_override)
+		type = show_option.type;
+	else
+		type = futil_file_type_buf(buf, len);
+
+	if (show_option.json && type != FILE_TYPE_FW_PREAMBLE &&
+	    type != FILE_TYPE_KERN_PREAMBLE) {
+		fprintf(stderr, "%s: JSON output isn't available for %s\n",
+			infile, futil_file_type_name(type));
+		errorcnt++;
+	} else {
+		errorcnt += futil_file_type_show(type, infile, buf, len);
+	}
+
+	errorcnt += futil_unmap_file(ifd, MAP_RO, buf, len);
+boo:
+	if (close(ifd)) {
+		errorcnt++;
+		fprintf(stderr, "Error when closing %s: %s\n",
+			infile, strerror(errno));
+	}
+
+	return errorcnt;
+}
+
+/* One file being checked by a child process */
+struct show_job {
+	pid_t pid;
+	FILE *out;
+	FILE *err;
+};
+
+static void copy_output(FILE *from, FILE *to)
+{
+	char buf[4096];
+	size_t n;
+
+	rewind(from);
+	while ((n = fread(buf, 1, sizeof(buf), from)) > 0)
+		fwrite(buf, 1, n, to);
+	fclose(from);
+}
+
+static int start_show_job(struct show_job *job, const char *infile,
+			  int type_override)
+{
+	job->out = tmpfile();
+	job->err = tmpfile();
+	if (!job->out || !job->err) {
+		fprintf(stderr, "Can't create temp file: %s\n",
+			strerror(errno));
+		goto fail;
+	}
+
+	/* Don't let the child inherit anything still buffered */
+	fflush(stdout);
+	fflush(stderr);
+
+	job->pid = fork();
+	if (job->pid < 0) {
+		fprintf(stderr, "Can't fork: %s\n", strerror(errno));
+		goto fail;
+	}
+
+	if (!job->pid) {
+		int errorcnt;
+
+		dup2(fileno(job->out), STDOUT_FILENO);
+		dup2(fileno(job->err), STDERR_FILENO);
+		if (show_option.t_flag)
+			errorcnt = show_type(infile);
+		else
+			errorcnt = show_file(infile, type_override);
+		fflush(stdout);
+		fflush(stderr);
+		_exit(errorcnt ? 1 : 0);
+	}
+
+	return 0;
+
+fail:
+	if (job->out)
+		fclose(job->out);
+	if (job->err)
+		fclose(job->err);
+	job->pid = -1;
+	return 1;
+}
+
+static int finish_show_job(struct show_job *job)
+{
+	int status;
+
+	if (job->pid < 0)
+		return 1;
+
+	if (waitpid(job->pid, &status, 0) < 0) {
+		fprintf(stderr, "Can't wait for child: %s\n",
+			strerror(errno));
+		status = -1;
+	}
+
+	copy_output(job->out, stdout);
+	copy_output(job->err, stderr);
+
+	return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+/*
+ * Check files in up to @jobs child processes at once.  Each file's output is
+ * held back and printed in command line order, so it reads the same as a
+ * serial run.  Processes rather than threads, since the file type handlers
+ * share show_option and the work buffer.
+ */
+static int show_files_parallel(char *files[], int count, int jobs,
+			       int type_override)
+{
+	struct show_job *job;
+	int errorcnt = 0;
+	int next, i;
+
+	job = calloc(count, sizeof(*job));
+	if (!job) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	for (next = 0; next < count && next < jobs; next++)
+		errorcnt += start_show_job(&job[next], files[next],
+					   type_override);
+
+	for (i = 0; i < count; i++) {
+		errorcnt += finish_show_job(&job[i]);
+		if (next < count) {
+			errorcnt += start_show_job(&job[next], files[next],
+						   type_override);
+			next++;
+		}
+	}
+
+	free(job);
+	return errorcnt;
+}
+
 static int do_show(int argc, char *argv[])
 {
 	uint8_t *pubkbuf = NULL;
 	struct vb2_public_key pubk2;
-	char *infile = 0;
-	int ifd, i;
+	int i;
 	int errorcnt = 0;
-	uint8_t *buf;
 	uint32_t len;
 	char *e = 0;
 	int type_override = 0;
-	enum futil_file_type type;
+	int jobs = 1;
 
 	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
 
@@ -512,6 +870,14 @@ static int do_show(int argc, char *argv[])
 
 			show_option.k = &pubk2;
 			break;
+		case 'j':
+			jobs = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e) || jobs < 1) {
+				fprintf(stderr,
+					"Invalid --jobs \"%s\"\n", optarg);
+				errorcnt++;
+			}
+			break;
 		case 't':
 			show_option.t_flag = 1;
 			break;
@@ -540,6 +906,28 @@ static int do_show(int argc, char *argv[])
 				errorcnt++;
 			}
 			break;
+		case OPT_VERIFY:
+			if (!strcasecmp("full", optarg)) {
+				show_option.skip_body = 0;
+			} else if (!strcasecmp("headers", optarg)) {
+				show_option.skip_body = 1;
+			} else {
+				fprintf(stderr,
+					"Invalid --verify \"%s\"\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case OPT_FORMAT:
+			if (!strcasecmp("text", optarg)) {
+				show_option.json = 0;
+			} else if (!strcasecmp("json", optarg)) {
+				show_option.json = 1;
+			} else {
+				fprintf(stderr,
+					"Invalid --format \"%s\"\n", optarg);
+				errorcnt++;
+			}
+			break;
 		case OPT_HELP:
 			print_help(argc, argv);
 			return !!errorcnt;
@@ -574,43 +962,20 @@ static int do_show(int argc, char *argv[])
 		return 1;
 	}
 
+	if (jobs > 1 && argc - optind > 1) {
+		errorcnt += show_files_parallel(argv + optind, argc - optind,
+						jobs, type_override);
+		goto done;
+	}
+
 	if (show_option.t_flag) {
 		for (i = optind; i < argc; i++)
 			errorcnt += show_type(argv[i]);
 		goto done;
 	}
 
-	for (i = optind; i < argc; i++) {
-		infile = argv[i];
-		ifd = open(infile, O_RDONLY);
-		if (ifd < 0) {
-			errorcnt++;
-			fprintf(stderr, "Can't open %s: %s\n",
-				infile, strerror(errno));
-			continue;
-		}
-
-		if (0 != futil_map_file(ifd, MAP_RO, &buf, &len)) {
-			errorcnt++;
-			goto boo;
-		}
-
-		/* Allow the user to override the type */
-		if (type_override)
-			type = show_option.type;
-		else
-			type = futil_file_type_buf(buf, len);
-
-		errorcnt += futil_file_type_show(type, infile, buf, len);
-
-		errorcnt += futil_unmap_file(ifd, MAP_RO, buf, len);
-boo:
-		if (close(ifd)) {
-			errorcnt++;
-			fprintf(stderr, "Error when closing %s: %s\n",
-				infile, strerror(errno));
-		}
-	}
+	for (i = optind; i < argc; i++)
+		errorcnt += show_file(argv[i], type_override);
 
 done:
 	if (pubkbuf)
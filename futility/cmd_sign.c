@@ -8,16 +8,22 @@
 #include <getopt.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <poll.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "2common.h"
+#include "2sha.h"
 #include "file_type.h"
 #include "file_type_bios.h"
 #include "fmap.h"
@@ -96,6 +102,11 @@ int ft_sign_pubkey(const char *name, uint8_t *buf, uint32_t len, void *data)
 					    sign_option.flags);
 	}
 
+	if (!block) {
+		fprintf(stderr, "Unable to create keyblock.\n");
+		return 1;
+	}
+
 	/* Write it out */
 	return WriteSomeParts(sign_option.outfile,
 			      block, block->keyblock_size,
@@ -105,35 +116,39 @@ int ft_sign_pubkey(const char *name, uint8_t *buf, uint32_t len, void *data)
 int ft_sign_raw_kernel(const char *name, uint8_t *buf, uint32_t len,
 		       void *data)
 {
-	uint8_t *vmlinuz_data, *kblob_data, *vblock_data;
-	uint32_t vmlinuz_size, kblob_size, vblock_size;
-	int rv;
-
-	vmlinuz_data = buf;
-	vmlinuz_size = len;
+	struct vb2_digest_context dc;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint8_t *vblock_data;
+	uint32_t kblob_size, vblock_size;
+	FILE *fp;
+	int rv = 0;
 
-	kblob_data = CreateKernelBlob(
-		vmlinuz_data, vmlinuz_size,
-		sign_option.arch, sign_option.kloadaddr,
-		sign_option.config_data, sign_option.config_size,
-		sign_option.bootloader_data, sign_option.bootloader_size,
-		&kblob_size);
-	if (!kblob_data) {
+	/*
+	 * Hash the kernel blob as it's generated, so it's never held in
+	 * memory. It's generated again below if it has to be written out.
+	 */
+	if (VB2_SUCCESS != vb2_digest_init(&dc,
+					   sign_option.signprivate->hash_alg) ||
+	    StreamKernelBlob(NULL, &dc, buf, len,
+			     sign_option.arch, sign_option.kloadaddr,
+			     sign_option.config_data, sign_option.config_size,
+			     sign_option.bootloader_data,
+			     sign_option.bootloader_size, &kblob_size) ||
+	    VB2_SUCCESS != vb2_digest_finalize(&dc, digest, sizeof(digest))) {
 		fprintf(stderr, "Unable to create kernel blob\n");
 		return 1;
 	}
 	VB2_DEBUG("kblob_size = %#x\n", kblob_size);
 
-	vblock_data = SignKernelBlob(kblob_data, kblob_size,
-				     sign_option.padding,
-				     sign_option.version,
-				     sign_option.kloadaddr,
-				     sign_option.keyblock,
-				     sign_option.signprivate,
-				     sign_option.flags, &vblock_size);
+	vblock_data = SignKernelDigest(digest, kblob_size,
+				       sign_option.padding,
+				       sign_option.version,
+				       sign_option.kloadaddr,
+				       sign_option.keyblock,
+				       sign_option.signprivate,
+				       sign_option.flags, &vblock_size);
 	if (!vblock_data) {
 		fprintf(stderr, "Unable to sign kernel blob\n");
-		free(kblob_data);
 		return 1;
 	}
 	VB2_DEBUG("vblock_size = %#x\n", vblock_size);
@@ -143,26 +158,94 @@ int ft_sign_raw_kernel(const char *name, uint8_t *buf, uint32_t len,
 	if (!sign_option.create_new_outfile)
 		FATAL("create_new_outfile should be selected\n");
 
-	if (sign_option.vblockonly)
+	if (sign_option.vblockonly) {
 		rv = WriteSomeParts(sign_option.outfile,
 				    vblock_data, vblock_size,
 				    NULL, 0);
-	else
-		rv = WriteSomeParts(sign_option.outfile,
-				    vblock_data, vblock_size,
-				    kblob_data, kblob_size);
+		free(vblock_data);
+		return rv;
+	}
+
+	VB2_DEBUG("writing %s with %#x, %#x\n",
+		  sign_option.outfile, vblock_size, kblob_size);
+	fp = fopen(sign_option.outfile, "wb");
+	if (!fp) {
+		fprintf(stderr, "Can't open output file %s: %s\n",
+			sign_option.outfile, strerror(errno));
+		free(vblock_data);
+		return 1;
+	}
+
+	if (1 != fwrite(vblock_data, vblock_size, 1, fp) ||
+	    StreamKernelBlob(fp, NULL, buf, len,
+			     sign_option.arch, sign_option.kloadaddr,
+			     sign_option.config_data, sign_option.config_size,
+			     sign_option.bootloader_data,
+			     sign_option.bootloader_size, NULL)) {
+		fprintf(stderr, "Can't write output file %s: %s\n",
+			sign_option.outfile, strerror(errno));
+		rv = 1;
+	}
+
+	if (fclose(fp) && !rv) {
+		fprintf(stderr, "Can't write output file %s: %s\n",
+			sign_option.outfile, strerror(errno));
+		rv = 1;
+	}
+	if (rv)
+		unlink(sign_option.outfile);
 
 	free(vblock_data);
-	free(kblob_data);
 	return rv;
 }
 
+/* Returns 1 if the two packed keys are the same key. */
+static int same_packed_key(const struct vb2_packed_key *a,
+			   const struct vb2_packed_key *b)
+{
+	return a->algorithm == b->algorithm &&
+		a->key_size == b->key_size &&
+		!memcmp(vb2_packed_key_data(a), vb2_packed_key_data(b),
+			a->key_size);
+}
+
+/* Returns 1 if the kernel blob still matches the preamble's body signature. */
+static int kernel_body_ok(const uint8_t *kblob_data, uint32_t kblob_size,
+			  const struct vb2_keyblock *keyblock,
+			  const struct vb2_kernel_preamble *preamble)
+{
+	uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE]
+		__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+	struct vb2_public_key data_key;
+	struct vb2_signature *sig;
+	int ok;
+
+	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key))
+		return 0;
+
+	/* Verifying clobbers the signature, and we still want it */
+	sig = vb2_alloc_signature(preamble->body_signature.sig_size,
+				  preamble->body_signature.data_size);
+	if (!sig ||
+	    VB2_SUCCESS != vb2_copy_signature(sig, &preamble->body_signature)) {
+		free(sig);
+		return 0;
+	}
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	ok = VB2_SUCCESS == vb2_verify_data(kblob_data, kblob_size, sig,
+					    &data_key, &wb);
+	free(sig);
+	return ok;
+}
+
 int ft_sign_kern_preamble(const char *name, uint8_t *buf, uint32_t len,
 			  void *data)
 {
 	uint8_t *kpart_data, *kblob_data, *vblock_data;
 	uint32_t kpart_size, kblob_size, vblock_size;
-	struct vb2_keyblock *keyblock = NULL;
+	struct vb2_keyblock *keyblock = NULL, *orig_keyblock;
 	struct vb2_kernel_preamble *preamble = NULL;
 	int rv = 0;
 
@@ -207,18 +290,40 @@ int ft_sign_kern_preamble(const char *name, uint8_t *buf, uint32_t len,
 		sign_option.flags = kernel_flags;
 
 	/* Replace the keyblock if asked */
+	orig_keyblock = keyblock;
 	if (sign_option.keyblock)
 		keyblock = sign_option.keyblock;
 
-	/* Compute the new signature */
-	vblock_data = SignKernelBlob(kblob_data, kblob_size,
-				     sign_option.padding,
-				     sign_option.version,
-				     sign_option.kloadaddr,
-				     keyblock,
-				     sign_option.signprivate,
-				     sign_option.flags,
-				     &vblock_size);
+	/*
+	 * If the blob is unchanged and the data key is the same, signing the
+	 * blob again would just give the same body signature. Keep the one we
+	 * have, so only the vblock needs to be rewritten.
+	 */
+	if (!sign_option.config_data &&
+	    kblob_size <= kpart_size - (kblob_data - kpart_data) &&
+	    same_packed_key(&keyblock->data_key, &orig_keyblock->data_key) &&
+	    (sign_option.trust_body ||
+	     kernel_body_ok(kblob_data, kblob_size, orig_keyblock, preamble))) {
+		VB2_DEBUG("Keeping the existing body signature\n");
+		vblock_data = SignKernelPreamble(&preamble->body_signature,
+						 sign_option.padding,
+						 sign_option.version,
+						 sign_option.kloadaddr,
+						 keyblock,
+						 sign_option.signprivate,
+						 sign_option.flags,
+						 &vblock_size);
+	} else {
+		/* Compute the new signature */
+		vblock_data = SignKernelBlob(kblob_data, kblob_size,
+					     sign_option.padding,
+					     sign_option.version,
+					     sign_option.kloadaddr,
+					     keyblock,
+					     sign_option.signprivate,
+					     sign_option.flags,
+					     &vblock_size);
+	}
 	if (!vblock_data) {
 		fprintf(stderr, "Unable to sign kernel blob\n");
 		return 1;
@@ -254,7 +359,12 @@ int ft_sign_raw_firmware(const char *name, uint8_t *buf, uint32_t len,
 	struct vb2_fw_preamble *preamble;
 	int rv;
 
-	body_sig = vb2_calculate_signature(buf, len, sign_option.signprivate);
+	if (sign_option.flags & VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH)
+		body_sig = vb2_calculate_tree_signature(
+				buf, len, sign_option.signprivate);
+	else
+		body_sig = vb2_calculate_signature(buf, len,
+						   sign_option.signprivate);
 	if (!body_sig) {
 		fprintf(stderr, "Error calculating body signature\n");
 		return 1;
@@ -304,6 +414,11 @@ static const char usage_pubkey[] = "\n"
 	"  --pem_external   PROGRAM"
 	"         External program to compute the signature\n"
 	"                                     (requires a PEM signing key)\n"
+	"  --pem_persistent"
+	"                 Start PROGRAM once with --persistent\n"
+	"                                     and send it each signature to make\n"
+	"                                     over its stdin, instead of running\n"
+	"                                     it once per signature\n"
 	"\n";
 static void print_help_pubkey(int argc, char *argv[])
 {
@@ -357,6 +472,8 @@ static const char usage_bios[] = "\n"
 	"                                     unchanged, or 0 if unknown)\n"
 	"  -d|--loemdir     DIR             Local OEM output vblock directory\n"
 	"  -l|--loemid      STRING          Local OEM vblock suffix\n"
+	"  --rootkey        FILE.vbpubk     New root key to put in the GBB\n"
+	"  --recoverykey    FILE.vbpubk     New recovery key to put in the GBB\n"
 	"  [--outfile]      OUTFILE         Output firmware image\n"
 	"\n";
 static void print_help_bios_image(int argc, char *argv[])
@@ -415,6 +532,12 @@ static const char usage_old_kpart[] = "\n"
 	"  --vblockonly                     Emit just the vblock (requires a\n"
 	"                                     distinct OUTFILE)\n"
 	"  -f|--flags       NUM             The preamble flags value\n"
+	"  --trust_body                     Keep the existing body signature\n"
+	"                                     without checking the body\n"
+	"\n"
+	"If the config isn't replaced and the keyblock has the same data key,\n"
+	"the existing body signature is checked and kept, and only the vblock\n"
+	"is rewritten.\n"
 	"\n";
 static void print_help_kern_preamble(int argc, char *argv[])
 {
@@ -467,6 +590,9 @@ static void print_help_usbpd1(int argc, char *argv[])
 	       "           Start of the RO section (default 0)\n"
 	       "  --rw_offset      NUM"
 	       "           Start of the RW section (default half)\n"
+	       "\n"
+	       "  --digest_cache   DIR"
+	       "           Reuse digests of RW sections signed before\n"
 	       "\n");
 }
 
@@ -509,6 +635,9 @@ static void print_help_rwsig(int argc, char *argv[])
 	       "                                    the file does not contain an FMAP.\n"
 	       "                                    (default 1024 bytes)\n"
 	       "  --data_size   NUM               Number of bytes of INFILE to sign\n"
+	       "  --digest_cache DIR              Directory of digests of data signed\n"
+	       "                                    before, so images sharing an RW\n"
+	       "                                    body only hash it once\n"
 	       "\n",
 	       argv[0],
 	       futil_file_type_name(FILE_TYPE_RWSIG),
@@ -539,13 +668,30 @@ static const char usage_default[] = "\n"
 	"  usbpd1 firmware image               same, or signed in-place\n"
 	"  RW device image                     same, or signed in-place\n"
 	"\n"
+	"To sign many files with the same keys and options, loading the keys\n"
+	"only once, use\n"
+	"\n"
+	"  " MYNAME " %s [PARAMS] --batch MANIFEST [--jobs N]\n"
+	"\n"
+	"where each line of MANIFEST is INFILE [OUTFILE]. Up to N files (default:\n"
+	"the number of CPUs) are signed at a time.\n"
+	"\n"
+	"To keep the keys loaded and sign files on request, use\n"
+	"\n"
+	"  " MYNAME " %s [PARAMS] --serve SOCKET [--jobs N]\n"
+	"\n"
+	"which listens on the Unix socket SOCKET. Each connection sends one\n"
+	"INFILE [OUTFILE] line, as in a manifest, and gets back \"OK\" or\n"
+	"\"FAIL\" once the file is signed. Paths are relative to the server's\n"
+	"directory. Sending \"quit\" stops the server.\n"
+	"\n"
 	"For more information, use \"" MYNAME " help %s TYPE\", where\n"
 	"TYPE is one of:\n\n";
 static void print_help_default(int argc, char *argv[])
 {
 	enum futil_file_type type;
 
-	printf(usage_default, argv[0], argv[0]);
+	printf(usage_default, argv[0], argv[0], argv[0], argv[0]);
 	for (type = 0; type < NUM_FILE_TYPES; type++)
 		if (help_type[type])
 			printf("  %s", futil_file_type_name(type));
@@ -586,6 +732,12 @@ enum no_short_opts {
 	OPT_DATA_SIZE,
 	OPT_SIG_SIZE,
 	OPT_PRIKEY,
+	OPT_BATCH,
+	OPT_SERVE,
+	OPT_JOBS,
+	OPT_DIGEST_CACHE,
+	OPT_ROOTKEY,
+	OPT_RECOVERYKEY,
 	OPT_HELP,
 };
 
@@ -614,8 +766,10 @@ static const struct option long_opts[] = {
 	{"pem",          1, NULL, OPT_PEM_SIGNPRIV}, /* alias */
 	{"pem_algo",     1, NULL, OPT_PEM_ALGO},
 	{"pem_external", 1, NULL, OPT_PEM_EXTERNAL},
+	{"pem_persistent", 0, &sign_option.pem_persistent, 1},
 	{"type",         1, NULL, OPT_TYPE},
 	{"vblockonly",   0, &sign_option.vblockonly, 1},
+	{"trust_body",   0, &sign_option.trust_body, 1},
 	{"hash_alg",     1, NULL, OPT_HASH_ALG},
 	{"ro_size",      1, NULL, OPT_RO_SIZE},
 	{"rw_size",      1, NULL, OPT_RW_SIZE},
@@ -625,6 +779,12 @@ static const struct option long_opts[] = {
 	{"sig_size",     1, NULL, OPT_SIG_SIZE},
 	{"prikey",       1, NULL, OPT_PRIKEY},
 	{"privkey",      1, NULL, OPT_PRIKEY},	/* alias */
+	{"batch",        1, NULL, OPT_BATCH},
+	{"serve",        1, NULL, OPT_SERVE},
+	{"jobs",         1, NULL, OPT_JOBS},
+	{"digest_cache", 1, NULL, OPT_DIGEST_CACHE},
+	{"rootkey",      1, NULL, OPT_ROOTKEY},
+	{"recoverykey",  1, NULL, OPT_RECOVERYKEY},
 	{"help",         0, NULL, OPT_HELP},
 	{NULL,           0, NULL, 0},
 };
@@ -643,16 +803,521 @@ static int parse_number_opt(const char *arg, const char *name, uint32_t *dest)
 	return 0;
 }
 
-static int do_sign(int argc, char *argv[])
+/*
+ * Sign one file, given the options already in sign_option. Any arguments left
+ * in argv[optind..] are the input and output files. Returns the number of
+ * errors.
+ */
+static int sign_one(char *infile, int argc, char *argv[])
 {
-	char *infile = 0;
-	int i;
 	int ifd = -1;
 	int errorcnt = 0;
 	uint8_t *buf;
 	uint32_t buf_len;
-	char *e = 0;
 	int mapping;
+
+	/* If we don't have an input file already, we need one */
+	if (!infile) {
+		if (argc - optind <= 0) {
+			errorcnt++;
+			fprintf(stderr, "ERROR: missing input filename\n");
+			goto done;
+		} else {
+			sign_option.inout_file_count++;
+			infile = argv[optind++];
+		}
+	}
+
+	/* Look for an output file if we don't have one, just in case. */
+	if (!sign_option.outfile && argc - optind > 0) {
+		sign_option.inout_file_count++;
+		sign_option.outfile = argv[optind++];
+	}
+
+	/* What are we looking at? */
+	if (sign_option.type == FILE_TYPE_UNKNOWN &&
+	    futil_file_type(infile, &sign_option.type)) {
+		errorcnt++;
+		goto done;
+	}
+
+	/* We may be able to infer the type based on the other args */
+	if (sign_option.type == FILE_TYPE_UNKNOWN) {
+		if (sign_option.bootloader_data || sign_option.config_data
+		    || sign_option.arch != ARCH_UNSPECIFIED)
+			sign_option.type = FILE_TYPE_RAW_KERNEL;
+		else if (sign_option.kernel_subkey || sign_option.fv_specified)
+			sign_option.type = FILE_TYPE_RAW_FIRMWARE;
+	}
+
+	VB2_DEBUG("type=%s\n", futil_file_type_name(sign_option.type));
+
+	/* Check the arguments for the type of thing we want to sign */
+	switch (sign_option.type) {
+	case FILE_TYPE_PUBKEY:
+		sign_option.create_new_outfile = 1;
+		if (sign_option.signprivate && sign_option.pem_signpriv) {
+			fprintf(stderr,
+				"Only one of --signprivate and --pem_signpriv"
+				" can be specified\n");
+			errorcnt++;
+		}
+		if ((sign_option.signprivate &&
+		     sign_option.pem_algo_specified) ||
+		    (sign_option.pem_signpriv &&
+		     !sign_option.pem_algo_specified)) {
+			fprintf(stderr, "--pem_algo must be used with"
+				" --pem_signpriv\n");
+			errorcnt++;
+		}
+		if (sign_option.pem_external && !sign_option.pem_signpriv) {
+			fprintf(stderr, "--pem_external must be used with"
+				" --pem_signpriv\n");
+			errorcnt++;
+		}
+		if (sign_option.pem_persistent && !sign_option.pem_external) {
+			fprintf(stderr, "--pem_persistent must be used with"
+				" --pem_external\n");
+			errorcnt++;
+		}
+		vb2_external_signer_persist(sign_option.pem_persistent);
+		/* We'll wait to read the PEM file, since the external signer
+		 * may want to read it instead. */
+		break;
+	case FILE_TYPE_BIOS_IMAGE:
+	case FILE_TYPE_OLD_BIOS_IMAGE:
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
+		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
+		break;
+	case FILE_TYPE_KERN_PREAMBLE:
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		if (sign_option.vblockonly || sign_option.inout_file_count > 1)
+			sign_option.create_new_outfile = 1;
+		break;
+	case FILE_TYPE_RAW_FIRMWARE:
+		sign_option.create_new_outfile = 1;
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
+		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
+		errorcnt += no_opt_if(!sign_option.version_specified,
+				      "version");
+		break;
+	case FILE_TYPE_RAW_KERNEL:
+		sign_option.create_new_outfile = 1;
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
+		errorcnt += no_opt_if(!sign_option.version_specified,
+				      "version");
+		errorcnt += no_opt_if(!sign_option.bootloader_data,
+				      "bootloader");
+		errorcnt += no_opt_if(!sign_option.config_data, "config");
+		errorcnt += no_opt_if(sign_option.arch == ARCH_UNSPECIFIED,
+				      "arch");
+		break;
+	case FILE_TYPE_USBPD1:
+		errorcnt += no_opt_if(!sign_option.pem_signpriv, "pem");
+		errorcnt += no_opt_if(sign_option.hash_alg == VB2_HASH_INVALID,
+				      "hash_alg");
+		break;
+	case FILE_TYPE_RWSIG:
+		if (sign_option.inout_file_count > 1)
+			/* Signing raw data. No signature pre-exists. */
+			errorcnt += no_opt_if(!sign_option.prikey, "prikey");
+		break;
+	default:
+		/* Anything else we don't care */
+		break;
+	}
+
+	VB2_DEBUG("infile=%s\n", infile);
+	VB2_DEBUG("sign_option.inout_file_count=%d\n",
+		  sign_option.inout_file_count);
+	VB2_DEBUG("sign_option.create_new_outfile=%d\n",
+		  sign_option.create_new_outfile);
+
+	/* Make sure we have an output file if one is needed */
+	if (!sign_option.outfile) {
+		if (sign_option.create_new_outfile) {
+			errorcnt++;
+			fprintf(stderr, "Missing output filename\n");
+			goto done;
+		} else {
+			sign_option.outfile = infile;
+		}
+	}
+
+	VB2_DEBUG("sign_option.outfile=%s\n", sign_option.outfile);
+
+	if (argc - optind > 0) {
+		errorcnt++;
+		fprintf(stderr, "ERROR: too many arguments left over\n");
+	}
+
+	if (errorcnt)
+		goto done;
+
+	if (sign_option.create_new_outfile) {
+		/* The input is read-only, the output is write-only. */
+		mapping = MAP_RO;
+		VB2_DEBUG("open RO %s\n", infile);
+		ifd = open(infile, O_RDONLY);
+		if (ifd < 0) {
+			errorcnt++;
+			fprintf(stderr, "Can't open %s for reading: %s\n",
+				infile, strerror(errno));
+			goto done;
+		}
+	} else {
+		/* We'll read-modify-write the output file */
+		mapping = MAP_RW;
+		if (sign_option.inout_file_count > 1)
+			futil_copy_file_or_die(infile, sign_option.outfile);
+		VB2_DEBUG("open RW %s\n", sign_option.outfile);
+		infile = sign_option.outfile;
+		ifd = open(sign_option.outfile, O_RDWR);
+		if (ifd < 0) {
+			errorcnt++;
+			fprintf(stderr, "Can't open %s for writing: %s\n",
+				sign_option.outfile, strerror(errno));
+			goto done;
+		}
+	}
+
+	if (0 != futil_map_file(ifd, mapping, &buf, &buf_len)) {
+		errorcnt++;
+		goto done;
+	}
+
+	errorcnt += futil_file_type_sign(sign_option.type, infile,
+					 buf, buf_len);
+
+	errorcnt += futil_unmap_file(ifd, mapping, buf, buf_len);
+
+done:
+	if (ifd >= 0 && close(ifd)) {
+		errorcnt++;
+		fprintf(stderr, "Error when closing ifd: %s\n",
+			strerror(errno));
+	}
+
+	return errorcnt;
+}
+
+/* A running --batch child, and the manifest line it is signing */
+struct batch_job {
+	pid_t pid;
+	int line_num;
+};
+
+/* Wait for one child to exit. Returns the number of errors. */
+static int batch_wait(const char *manifest, struct batch_job *job, int jobs)
+{
+	int status;
+	pid_t pid;
+	int i;
+
+	pid = wait(&status);
+	if (pid < 0) {
+		fprintf(stderr, "Error waiting for signer: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	for (i = 0; i < jobs; i++) {
+		if (job[i].pid != pid)
+			continue;
+		job[i].pid = 0;
+		if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+			fprintf(stderr, "%s:%d: signing failed\n",
+				manifest, job[i].line_num);
+			return 1;
+		}
+		return 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Split a manifest line into INFILE [OUTFILE] in args, which has room for
+ * two words. Returns the number of words, 0 for a blank or comment line, or
+ * -1 if there are too many.
+ */
+static int parse_manifest_line(char *line, char *args[])
+{
+	char *saveptr;
+	char *word;
+	int count = 0;
+
+	for (word = strtok_r(line, " \t\r", &saveptr); word;
+	     word = strtok_r(NULL, " \t\r", &saveptr)) {
+		if (!count && word[0] == '#')
+			return 0;
+		if (count == 2)
+			return -1;
+		args[count++] = word;
+	}
+	return count;
+}
+
+/*
+ * Sign one parsed manifest entry. This changes sign_option, so it's only run
+ * in a child process. Returns the exit status for the child.
+ */
+static int sign_manifest_entry(char *args[], int count)
+{
+	sign_option.inout_file_count = count;
+	sign_option.outfile = count > 1 ? args[1] : NULL;
+	optind = 0;
+	return !!sign_one(args[0], 0, NULL);
+}
+
+/*
+ * Sign every "INFILE [OUTFILE]" line of the manifest with the keys and
+ * options already in sign_option, so each key is read and parsed only once.
+ * Each file is signed in a child process, which keeps the per-file changes to
+ * sign_option from leaking between files; up to jobs of them run at a time.
+ * Returns the number of errors.
+ */
+static int sign_batch(const char *manifest, int jobs)
+{
+	struct batch_job *job;
+	char *buf, *line, *next;
+	uint64_t len;
+	int line_num = 0;
+	int running = 0;
+	int errorcnt = 0;
+	int i;
+
+	/* Read it all up front; children mustn't share a FILE with us */
+	buf = (char *)ReadFile(manifest, &len);
+	if (!buf)
+		return 1;
+	line = realloc(buf, len + 1);
+	job = calloc(jobs, sizeof(*job));
+	if (!line || !job) {
+		fprintf(stderr, "Out of memory\n");
+		free(line ? line : buf);
+		free(job);
+		return 1;
+	}
+	buf = line;
+	buf[len] = '\0';
+
+	for (line = buf; line && !errorcnt; line = next) {
+		char *args[2];
+		int count;
+		pid_t pid;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		line_num++;
+
+		count = parse_manifest_line(line, args);
+		if (!count)
+			continue;
+		if (count < 0) {
+			fprintf(stderr, "%s:%d: expected INFILE [OUTFILE]\n",
+				manifest, line_num);
+			errorcnt++;
+			break;
+		}
+
+		if (running == jobs) {
+			errorcnt += batch_wait(manifest, job, jobs);
+			running--;
+		}
+
+		fflush(stdout);
+		fflush(stderr);
+		pid = fork();
+		if (pid < 0) {
+			fprintf(stderr, "Can't fork: %s\n", strerror(errno));
+			errorcnt++;
+			break;
+		}
+		if (!pid)
+			exit(sign_manifest_entry(args, count));
+
+		for (i = 0; job[i].pid; i++)
+			;
+		job[i].pid = pid;
+		job[i].line_num = line_num;
+		running++;
+	}
+
+	while (running--)
+		errorcnt += batch_wait(manifest, job, jobs);
+
+	free(job);
+	free(buf);
+	return errorcnt;
+}
+
+/* How long a --serve client has to send its request */
+#define SERVE_TIMEOUT_SEC 5
+
+/*
+ * Read one request line from a --serve connection, without the newline.
+ * Anything after the newline is ignored. Returns 0 on success, or -1 if the
+ * line is too long or the client doesn't send it in time.
+ */
+static int serve_read_line(int conn, char *buf, size_t size)
+{
+	time_t deadline = time(NULL) + SERVE_TIMEOUT_SEC;
+	struct pollfd pfd = { .fd = conn, .events = POLLIN };
+	size_t len = 0;
+	time_t left;
+	char *end;
+	ssize_t n;
+
+	while (len < size - 1) {
+		left = deadline - time(NULL);
+		if (left <= 0)
+			return -1;
+		n = poll(&pfd, 1, left * 1000);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+
+		n = read(conn, buf + len, size - 1 - len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return -1;
+		buf[len + n] = '\0';
+		end = strchr(buf + len, '\n');
+		if (end) {
+			*end = '\0';
+			return 0;
+		}
+		if (!n)
+			return 0;
+		len += n;
+	}
+	return -1;
+}
+
+static void serve_reply(int conn, int failed)
+{
+	const char *reply = failed ? "FAIL\n" : "OK\n";
+
+	/* The client may be gone; that mustn't kill the server with SIGPIPE */
+	if (send(conn, reply, strlen(reply), MSG_NOSIGNAL) < 0)
+		VB2_DEBUG("Client went away: %s\n", strerror(errno));
+}
+
+/*
+ * Listen on a Unix socket and sign one manifest-style line per connection,
+ * with the keys and options already in sign_option, until told to quit. Like
+ * --batch, each file is signed in a child process and up to jobs of them run
+ * at a time. Returns the number of errors setting up the socket; failed
+ * requests are only reported to their client.
+ */
+static int sign_serve(const char *path, int jobs)
+{
+	struct sockaddr_un addr;
+	char line[2 * PATH_MAX + 4];
+	struct stat sb;
+	char *args[2];
+	int running = 0;
+	int sock, conn, count;
+	pid_t pid;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path %s is too long\n", path);
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	/* Clear out the socket left behind by a server which was killed */
+	if (!lstat(path, &sb) && S_ISSOCK(sb.st_mode))
+		unlink(path);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 ||
+	    bind(sock, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(sock, jobs)) {
+		fprintf(stderr, "Can't listen on %s: %s\n", path,
+			strerror(errno));
+		if (sock >= 0)
+			close(sock);
+		return 1;
+	}
+
+	while (1) {
+		conn = accept(sock, NULL, NULL);
+		if (conn < 0) {
+			if (errno != EINTR)
+				fprintf(stderr, "Can't accept on %s: %s\n",
+					path, strerror(errno));
+			continue;
+		}
+
+		if (serve_read_line(conn, line, sizeof(line))) {
+			serve_reply(conn, 1);
+			close(conn);
+			continue;
+		}
+		if (!strcmp(line, "quit")) {
+			serve_reply(conn, 0);
+			close(conn);
+			break;
+		}
+		count = parse_manifest_line(line, args);
+		if (count <= 0) {
+			serve_reply(conn, 1);
+			close(conn);
+			continue;
+		}
+
+		/* Reap whatever has finished, then wait for a free slot */
+		while (running && waitpid(-1, NULL, WNOHANG) > 0)
+			running--;
+		if (running == jobs && wait(NULL) > 0)
+			running--;
+
+		fflush(stdout);
+		fflush(stderr);
+		pid = fork();
+		if (pid < 0) {
+			fprintf(stderr, "Can't fork: %s\n", strerror(errno));
+			serve_reply(conn, 1);
+		} else if (!pid) {
+			int rv;
+
+			close(sock);
+			rv = sign_manifest_entry(args, count);
+			serve_reply(conn, rv);
+			exit(rv);
+		} else {
+			running++;
+		}
+		close(conn);
+	}
+
+	while (running && wait(NULL) > 0)
+		running--;
+
+	close(sock);
+	unlink(path);
+	return 0;
+}
+
+static int do_sign(int argc, char *argv[])
+{
+	char *infile = 0;
+	char *batch_file = 0;
+	char *serve_path = 0;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	int i;
+	int errorcnt = 0;
+	char *e = 0;
 	int helpind = 0;
 	int longindex;
 
@@ -840,6 +1505,37 @@ static int do_sign(int argc, char *argv[])
 				errorcnt++;
 			}
 			break;
+		case OPT_BATCH:
+			batch_file = optarg;
+			break;
+		case OPT_SERVE:
+			serve_path = optarg;
+			break;
+		case OPT_JOBS:
+			jobs = strtol(optarg, &e, 0);
+			if (!*optarg || (e && *e) || jobs < 1) {
+				fprintf(stderr,
+					"Invalid --jobs \"%s\"\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case OPT_DIGEST_CACHE:
+			sign_option.digest_cache = optarg;
+			break;
+		case OPT_ROOTKEY:
+			sign_option.rootkey = vb2_read_packed_key(optarg);
+			if (!sign_option.rootkey) {
+				fprintf(stderr, "Error reading %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case OPT_RECOVERYKEY:
+			sign_option.recoverykey = vb2_read_packed_key(optarg);
+			if (!sign_option.recoverykey) {
+				fprintf(stderr, "Error reading %s\n", optarg);
+				errorcnt++;
+			}
+			break;
 		case OPT_HELP:
 			helpind = optind - 1;
 			break;
@@ -874,183 +1570,29 @@ static int do_sign(int argc, char *argv[])
 		return !!errorcnt;
 	}
 
-	/* If we don't have an input file already, we need one */
-	if (!infile) {
-		if (argc - optind <= 0) {
-			errorcnt++;
-			fprintf(stderr, "ERROR: missing input filename\n");
-			goto done;
-		} else {
-			sign_option.inout_file_count++;
-			infile = argv[optind++];
-		}
-	}
-
-	/* Look for an output file if we don't have one, just in case. */
-	if (!sign_option.outfile && argc - optind > 0) {
-		sign_option.inout_file_count++;
-		sign_option.outfile = argv[optind++];
-	}
-
-	/* What are we looking at? */
-	if (sign_option.type == FILE_TYPE_UNKNOWN &&
-	    futil_file_type(infile, &sign_option.type)) {
+	if (batch_file && serve_path) {
+		fprintf(stderr, "ERROR: --batch and --serve can't be combined\n");
 		errorcnt++;
-		goto done;
-	}
-
-	/* We may be able to infer the type based on the other args */
-	if (sign_option.type == FILE_TYPE_UNKNOWN) {
-		if (sign_option.bootloader_data || sign_option.config_data
-		    || sign_option.arch != ARCH_UNSPECIFIED)
-			sign_option.type = FILE_TYPE_RAW_KERNEL;
-		else if (sign_option.kernel_subkey || sign_option.fv_specified)
-			sign_option.type = FILE_TYPE_RAW_FIRMWARE;
-	}
-
-	VB2_DEBUG("type=%s\n", futil_file_type_name(sign_option.type));
-
-	/* Check the arguments for the type of thing we want to sign */
-	switch (sign_option.type) {
-	case FILE_TYPE_PUBKEY:
-		sign_option.create_new_outfile = 1;
-		if (sign_option.signprivate && sign_option.pem_signpriv) {
+	} else if (batch_file) {
+		if (infile || sign_option.outfile || argc - optind > 0) {
 			fprintf(stderr,
-				"Only one of --signprivate and --pem_signpriv"
-				" can be specified\n");
+				"ERROR: --batch takes files from the manifest\n");
 			errorcnt++;
-		}
-		if ((sign_option.signprivate &&
-		     sign_option.pem_algo_specified) ||
-		    (sign_option.pem_signpriv &&
-		     !sign_option.pem_algo_specified)) {
-			fprintf(stderr, "--pem_algo must be used with"
-				" --pem_signpriv\n");
-			errorcnt++;
-		}
-		if (sign_option.pem_external && !sign_option.pem_signpriv) {
-			fprintf(stderr, "--pem_external must be used with"
-				" --pem_signpriv\n");
-			errorcnt++;
-		}
-		/* We'll wait to read the PEM file, since the external signer
-		 * may want to read it instead. */
-		break;
-	case FILE_TYPE_BIOS_IMAGE:
-	case FILE_TYPE_OLD_BIOS_IMAGE:
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
-		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
-		break;
-	case FILE_TYPE_KERN_PREAMBLE:
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		if (sign_option.vblockonly || sign_option.inout_file_count > 1)
-			sign_option.create_new_outfile = 1;
-		break;
-	case FILE_TYPE_RAW_FIRMWARE:
-		sign_option.create_new_outfile = 1;
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
-		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
-		errorcnt += no_opt_if(!sign_option.version_specified,
-				      "version");
-		break;
-	case FILE_TYPE_RAW_KERNEL:
-		sign_option.create_new_outfile = 1;
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
-		errorcnt += no_opt_if(!sign_option.version_specified,
-				      "version");
-		errorcnt += no_opt_if(!sign_option.bootloader_data,
-				      "bootloader");
-		errorcnt += no_opt_if(!sign_option.config_data, "config");
-		errorcnt += no_opt_if(sign_option.arch == ARCH_UNSPECIFIED,
-				      "arch");
-		break;
-	case FILE_TYPE_USBPD1:
-		errorcnt += no_opt_if(!sign_option.pem_signpriv, "pem");
-		errorcnt += no_opt_if(sign_option.hash_alg == VB2_HASH_INVALID,
-				      "hash_alg");
-		break;
-	case FILE_TYPE_RWSIG:
-		if (sign_option.inout_file_count > 1)
-			/* Signing raw data. No signature pre-exists. */
-			errorcnt += no_opt_if(!sign_option.prikey, "prikey");
-		break;
-	default:
-		/* Anything else we don't care */
-		break;
-	}
-
-	VB2_DEBUG("infile=%s\n", infile);
-	VB2_DEBUG("sign_option.inout_file_count=%d\n",
-		  sign_option.inout_file_count);
-	VB2_DEBUG("sign_option.create_new_outfile=%d\n",
-		  sign_option.create_new_outfile);
-
-	/* Make sure we have an output file if one is needed */
-	if (!sign_option.outfile) {
-		if (sign_option.create_new_outfile) {
-			errorcnt++;
-			fprintf(stderr, "Missing output filename\n");
-			goto done;
 		} else {
-			sign_option.outfile = infile;
+			errorcnt += sign_batch(batch_file,
+					       jobs > 0 ? (int)jobs : 1);
 		}
-	}
-
-	VB2_DEBUG("sign_option.outfile=%s\n", sign_option.outfile);
-
-	if (argc - optind > 0) {
-		errorcnt++;
-		fprintf(stderr, "ERROR: too many arguments left over\n");
-	}
-
-	if (errorcnt)
-		goto done;
-
-	if (sign_option.create_new_outfile) {
-		/* The input is read-only, the output is write-only. */
-		mapping = MAP_RO;
-		VB2_DEBUG("open RO %s\n", infile);
-		ifd = open(infile, O_RDONLY);
-		if (ifd < 0) {
+	} else if (serve_path) {
+		if (infile || sign_option.outfile || argc - optind > 0) {
+			fprintf(stderr,
+				"ERROR: --serve takes files from requests\n");
 			errorcnt++;
-			fprintf(stderr, "Can't open %s for reading: %s\n",
-				infile, strerror(errno));
-			goto done;
+		} else {
+			errorcnt += sign_serve(serve_path,
+					       jobs > 0 ? (int)jobs : 1);
 		}
 	} else {
-		/* We'll read-modify-write the output file */
-		mapping = MAP_RW;
-		if (sign_option.inout_file_count > 1)
-			futil_copy_file_or_die(infile, sign_option.outfile);
-		VB2_DEBUG("open RW %s\n", sign_option.outfile);
-		infile = sign_option.outfile;
-		ifd = open(sign_option.outfile, O_RDWR);
-		if (ifd < 0) {
-			errorcnt++;
-			fprintf(stderr, "Can't open %s for writing: %s\n",
-				sign_option.outfile, strerror(errno));
-			goto done;
-		}
-	}
-
-	if (0 != futil_map_file(ifd, mapping, &buf, &buf_len)) {
-		errorcnt++;
-		goto done;
-	}
-
-	errorcnt += futil_file_type_sign(sign_option.type, infile,
-					 buf, buf_len);
-
-	errorcnt += futil_unmap_file(ifd, mapping, buf, buf_len);
-
-done:
-	if (ifd >= 0 && close(ifd)) {
-		errorcnt++;
-		fprintf(stderr, "Error when closing ifd: %s\n",
-			strerror(errno));
+		errorcnt += sign_one(infile, argc, argv);
 	}
 
 	if (sign_option.signprivate)
@@ -55,26 +55,22 @@ static unsigned long compute_ip_checksum(const void *addr, unsigned long length)
 		uint8_t  byte[2];
 		uint16_t word;
 	} value;
-	unsigned long sum;
+	uint64_t sum;
 	unsigned long i;
-	/* In the most straight forward way possible,
-	 * compute an ip style checksum.
+	/*
+	 * Compute an ip style checksum. Ones' complement addition doesn't
+	 * care when the carries are folded back in, so sum whole
+	 * little-endian 16-bit words into a wide accumulator and fold once
+	 * at the end instead of after every byte.
 	 */
 	sum = 0;
 	ptr = addr;
-	for(i = 0; i < length; i++) {
-		unsigned long v;
-		v = ptr[i];
-		if (i & 1) {
-			v <<= 8;
-		}
-		/* Add the new value */
-		sum += v;
-		/* Wrap around the carry */
-		if (sum > 0xFFFF) {
-			sum = (sum + (sum >> 16)) & 0xFFFF;
-		}
-	}
+	for (i = 0; i + 1 < length; i += 2)
+		sum += ptr[i] | (ptr[i + 1] << 8);
+	if (length & 1)
+		sum += ptr[length - 1];
+	while (sum > 0xFFFF)
+		sum = (sum & 0xFFFF) + (sum >> 16);
 	value.byte[0] = sum & 0xff;
 	value.byte[1] = (sum >> 8) & 0xff;
 	return (~value.word) & 0xFFFF;
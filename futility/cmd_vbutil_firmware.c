@@ -92,7 +92,7 @@ static int do_vblock(const char *outfile, const char *keyblock_file,
 	struct vb2_packed_key *kernel_subkey = NULL;
 	struct vb2_signature *body_sig = NULL;
 	struct vb2_fw_preamble *preamble = NULL;
-	uint8_t *fv_data = NULL;
+	struct vb2_file_view fv = {0};
 	int retval = 1;
 
 	if (!outfile) {
@@ -128,14 +128,18 @@ static int do_vblock(const char *outfile, const char *keyblock_file,
 	}
 
 	/* Read and sign the firmware volume */
-	uint32_t fv_size;
-	if (VB2_SUCCESS != vb2_read_file(fv_file, &fv_data, &fv_size))
+	if (VB2_SUCCESS != vb2_map_file(fv_file, &fv, 0))
 		goto vblock_cleanup;
-	if (!fv_size) {
+	if (!fv.size) {
 		FATAL("Empty firmware volume file\n");
 		goto vblock_cleanup;
 	}
-	body_sig = vb2_calculate_signature(fv_data, fv_size, signing_key);
+	if (preamble_flags & VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH)
+		body_sig = vb2_calculate_tree_signature(fv.data, fv.size,
+							signing_key);
+	else
+		body_sig = vb2_calculate_signature(fv.data, fv.size,
+						   signing_key);
 	if (!body_sig) {
 		FATAL("Error calculating body signature\n");
 		goto vblock_cleanup;
@@ -174,8 +178,7 @@ vblock_cleanup:
 		free(signing_key);
 	if (kernel_subkey)
 		free(kernel_subkey);
-	if (fv_data)
-		free(fv_data);
+	vb2_unmap_file(&fv);
 	if (body_sig)
 		free(body_sig);
 	if (preamble)
@@ -195,8 +198,8 @@ static int do_verify(const char *infile, const char *signpubkey,
 	uint32_t now = 0;
 
 	uint8_t *pubkbuf = NULL;
-	uint8_t *blob = NULL;
-	uint8_t *fv_data = NULL;
+	struct vb2_file_view in = {0}, fv = {0};
+	uint8_t *blob;
 	int retval = 1;
 
 	if (!infile || !signpubkey || !fv_file) {
@@ -217,15 +220,16 @@ static int do_verify(const char *infile, const char *signpubkey,
 	}
 
 	/* Read blob */
-	uint32_t blob_size;
-	if (VB2_SUCCESS != vb2_read_file(infile, &blob, &blob_size)) {
+	/* Verification unpacks keys in place, so it needs a private copy. */
+	if (VB2_SUCCESS != vb2_map_file(infile, &in, 1)) {
 		FATAL("Error reading input file\n");
 		goto verify_cleanup;
 	}
+	blob = in.data;
+	uint32_t blob_size = in.size;
 
 	/* Read firmware volume */
-	uint32_t fv_size;
-	if (VB2_SUCCESS != vb2_read_file(fv_file, &fv_data, &fv_size)) {
+	if (VB2_SUCCESS != vb2_map_file(fv_file, &fv, 0)) {
 		FATAL("Error reading firmware volume\n");
 		goto verify_cleanup;
 	}
@@ -293,8 +297,12 @@ static int do_verify(const char *infile, const char *signpubkey,
 	if (flags & VB2_FIRMWARE_PREAMBLE_USE_RO_NORMAL) {
 		printf("Preamble requests USE_RO_NORMAL;"
 		       " skipping body verification.\n");
-	} else if (VB2_SUCCESS ==
-		   vb2_verify_data(fv_data, fv_size, &pre2->body_signature,
+	} else if (flags & VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH ?
+		   VB2_SUCCESS ==
+		   vb2_verify_tree_data(fv.data, fv.size, &pre2->body_signature,
+					&data_key, &wb) :
+		   VB2_SUCCESS ==
+		   vb2_verify_data(fv.data, fv.size, &pre2->body_signature,
 				   &data_key, &wb)) {
 		printf("Body verification succeeded.\n");
 	} else {
@@ -315,10 +323,8 @@ static int do_verify(const char *infile, const char *signpubkey,
 verify_cleanup:
 	if (pubkbuf)
 		free(pubkbuf);
-	if (blob)
-		free(blob);
-	if (fv_data)
-		free(fv_data);
+	vb2_unmap_file(&in);
+	vb2_unmap_file(&fv);
 
 	return retval;
 }
@@ -27,6 +27,7 @@
 #include "kernel_blob.h"
 #include "vb1_helper.h"
 #include "vb2_common.h"
+#include "vboot_host.h"
 
 /* Global opts */
 static int opt_verbose;
@@ -137,6 +138,12 @@ static const char usage[] =
 	"\n"
 	"  Required parameters:\n"
 	"    --vmlinuz-out <file>      vmlinuz image output file\n"
+	"\n"
+	"  Optional:\n"
+	"    --signpubkey <file>"
+	"       Public key to verify kernel keyblock,\n"
+	"                                in .vbpubk format. The partition is\n"
+	"                                verified while it is extracted.\n"
 	"\n";
 
 
@@ -160,6 +167,34 @@ static const char *error_fread(FILE *fp)
 }
 
 
+/*
+ * Verify a kernel partition and write out its vmlinuz in a single pass, so
+ * the body isn't read once for verification and again for extraction.
+ */
+static int WriteVerifiedVmlinuz(const char *filename,
+				const struct vb2_packed_key *signpub_key,
+				const char *vmlinuz_out_file)
+{
+	void *vmlinuz = NULL;
+	size_t vmlinuz_size = 0;
+	int fd, rv;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		FATAL("Unable to open file %s: %s\n", filename,
+		      strerror(errno));
+	rv = ExtractVmlinuzVerified(fd, signpub_key, &vmlinuz, &vmlinuz_size);
+	close(fd);
+	if (rv)
+		FATAL("Unable to verify kernel partition %s\n", filename);
+
+	rv = vb2_write_file(vmlinuz_out_file, vmlinuz, vmlinuz_size);
+	free(vmlinuz);
+	if (rv)
+		FATAL("Can't write output file %s\n", vmlinuz_out_file);
+	return 0;
+}
+
 /* This reads a complete kernel partition into a buffer */
 static uint8_t *ReadOldKPartFromFileOrDie(const char *filename,
 					 uint32_t *size_ptr)
@@ -205,6 +240,98 @@ static uint8_t *ReadOldKPartFromFileOrDie(const char *filename,
 	return buf;
 }
 
+/*
+ * Copy size bytes at in_ofs in the file named infile to out_ofs in fd. Where
+ * the filesystem can share the blocks or copy them itself, the bytes don't pass
+ * through user space. Otherwise, buf (which holds the same bytes) is written.
+ * Returns zero on success.
+ */
+static int CopyFileBytes(int fd, uint64_t out_ofs, const char *infile,
+			 uint64_t in_ofs, const uint8_t *buf, uint32_t size)
+{
+	uint32_t done = 0;
+	ssize_t n;
+
+#ifndef HAVE_MACOS
+	int in_fd = open(infile, O_RDONLY);
+	if (in_fd >= 0) {
+#ifdef FICLONERANGE
+		struct file_clone_range range = {
+			.src_fd = in_fd,
+			.src_offset = in_ofs,
+			.src_length = size,
+			.dest_offset = out_ofs,
+		};
+		if (0 == ioctl(fd, FICLONERANGE, &range))
+			done = size;
+#endif
+		while (done < size) {
+			loff_t in_pos = in_ofs + done;
+			loff_t out_pos = out_ofs + done;
+			n = copy_file_range(in_fd, &in_pos, fd, &out_pos,
+					    size - done, 0);
+			if (n <= 0)
+				break;
+			done += n;
+		}
+		close(in_fd);
+	}
+	VB2_DEBUG("%#x of %#x bytes copied in the kernel\n", done, size);
+#endif
+
+	while (done < size) {
+		n = pwrite(fd, buf + done, size - done, out_ofs + done);
+		if (n <= 0)
+			return -1;
+		done += n;
+	}
+	return 0;
+}
+
+/*
+ * Write a repacked kernel partition, where the kernel blob is unchanged from
+ * the one at blob_ofs in oldfile. Returns zero on success.
+ */
+static int WriteRepackedKPart(const char *outfile,
+			      const uint8_t *vblock_data, uint32_t vblock_size,
+			      const char *oldfile, uint32_t blob_ofs,
+			      const uint8_t *kblob_data, uint32_t kblob_size)
+{
+	int fd;
+
+	VB2_DEBUG("writing %s with %#x, %#x from %s\n",
+		  outfile, vblock_size, kblob_size, oldfile);
+
+	fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		fprintf(stderr, "Can't open output file %s: %s\n",
+			outfile, strerror(errno));
+		return -1;
+	}
+
+	if (vblock_size != write(fd, vblock_data, vblock_size) ||
+	    0 != CopyFileBytes(fd, vblock_size, oldfile, blob_ofs,
+			       kblob_data, kblob_size) ||
+	    0 != close(fd)) {
+		fprintf(stderr, "Can't write output file %s: %s\n",
+			outfile, strerror(errno));
+		close(fd);
+		unlink(outfile);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Returns true if the two paths are the same file. */
+static int SameFile(const char *a, const char *b)
+{
+	struct stat sa, sb;
+
+	return 0 == stat(a, &sa) && 0 == stat(b, &sb) &&
+		sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
 /****************************************************************************/
 
 static int do_vbutil_kernel(int argc, char *argv[])
@@ -537,6 +664,14 @@ static int do_vbutil_kernel(int argc, char *argv[])
 			rv = WriteSomeParts(filename,
 					    vblock_data, vblock_size,
 					    NULL, 0);
+		else if (!config_file &&
+			 kblob_size <= kpart_size - (kblob_data - kpart_data) &&
+			 !SameFile(oldfile, filename))
+			/* The blob is unchanged, so copy it from the file */
+			rv = WriteRepackedKPart(filename,
+						vblock_data, vblock_size,
+						oldfile, kblob_data - kpart_data,
+						kblob_data, kblob_size);
 		else
 			rv = WriteSomeParts(filename,
 					    vblock_data, vblock_size,
@@ -579,6 +714,14 @@ static int do_vbutil_kernel(int argc, char *argv[])
 			return 1;
 		}
 
+		if (signpubkey_file) {
+			signpub_key = vb2_read_packed_key(signpubkey_file);
+			if (!signpub_key)
+				FATAL("Error reading public key.\n");
+			return WriteVerifiedVmlinuz(filename, signpub_key,
+						    vmlinuz_out_file);
+		}
+
 		kpart_data = ReadOldKPartFromFileOrDie(filename, &kpart_size);
 
 		kblob_data = unpack_kernel_partition(kpart_data, kpart_size,
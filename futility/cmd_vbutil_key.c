@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "2rsa.h"
 #include "futility.h"
 #include "host_common.h"
 #include "host_key21.h"
@@ -27,6 +28,7 @@ enum {
 	OPT_MODE_PACK,
 	OPT_MODE_UNPACK,
 	OPT_COPYTO,
+	OPT_COMPACT,
 	OPT_HELP,
 };
 
@@ -37,6 +39,7 @@ static const struct option long_opts[] = {
 	{"pack", 1, 0, OPT_MODE_PACK},
 	{"unpack", 1, 0, OPT_MODE_UNPACK},
 	{"copyto", 1, 0, OPT_COPYTO},
+	{"compact", 0, 0, OPT_COMPACT},
 	{"help", 0, 0, OPT_HELP},
 	{NULL, 0, 0, 0}
 };
@@ -61,17 +64,28 @@ static void print_help(int argc, char *argv[])
 		       i, vb2_get_crypto_algorithm_name(i));
 	}
 
+	printf("\n"
+	       "  Optional parameters:\n"
+	       "    --compact                   "
+	       "Leave R^2 out of a .vbpubk to halve its\n"
+	       "                                  size; it's rebuilt at "
+	       "verification\n");
+
 	printf("\nOR\n\n"
 	       "Usage:  " MYNAME " %s --unpack <infile>\n"
 	       "\n"
 	       "  Optional parameters:\n"
 	       "    --copyto <file>             "
-	       "Write a copy of the key to this file.\n\n", argv[0]);
+	       "Write a copy of the key to this file. Private\n"
+	       "                                  keys missing CRT parameters "
+	       "get them\n"
+	       "                                  filled in, for faster "
+	       "signing.\n\n", argv[0]);
 }
 
 /* Pack a .keyb file into a .vbpubk, or a .pem into a .vbprivk */
 static int do_pack(const char *infile, const char *outfile, uint32_t algorithm,
-		   uint32_t version)
+		   uint32_t version, int compact)
 {
 	if (!infile || !outfile) {
 		fprintf(stderr, "vbutil_key: Must specify --in and --out\n");
@@ -81,6 +95,10 @@ static int do_pack(const char *infile, const char *outfile, uint32_t algorithm,
 	struct vb2_packed_key *pubkey =
 		vb2_read_packed_keyb(infile, algorithm, version);
 	if (pubkey) {
+		/* rr is the second half of the key data; just drop it */
+		if (compact)
+			pubkey->key_size = vb2_packed_key_compact_size(
+				vb2_crypto_to_signature(algorithm));
 		if (0 != vb2_write_packed_key(outfile, pubkey)) {
 			fprintf(stderr, "vbutil_key: Error writing key.\n");
 			free(pubkey);
@@ -166,6 +184,7 @@ static int do_vbutil_key(int argc, char *argv[])
 	int parse_error = 0;
 	uint32_t version = 1;
 	uint32_t algorithm = VB2_ALG_COUNT;
+	int compact = 0;
 	char *e;
 	int i;
 
@@ -213,6 +232,10 @@ static int do_vbutil_key(int argc, char *argv[])
 		case OPT_COPYTO:
 			outfile = optarg;
 			break;
+
+		case OPT_COMPACT:
+			compact = 1;
+			break;
 		}
 	}
 
@@ -223,7 +246,7 @@ static int do_vbutil_key(int argc, char *argv[])
 
 	switch (mode) {
 	case OPT_MODE_PACK:
-		return do_pack(infile, outfile, algorithm, version);
+		return do_pack(infile, outfile, algorithm, version, compact);
 	case OPT_MODE_UNPACK:
 		return do_unpack(infile, outfile);
 	default:
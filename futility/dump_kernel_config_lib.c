@@ -5,6 +5,7 @@
  * Exports the kernel commandline from a given partition/image.
  */
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
@@ -21,6 +22,7 @@
 #include "vboot_host.h"
 
 typedef ssize_t (*ReadFullyFn)(void *ctx, void *buf, size_t count);
+typedef int (*SkipFn)(void *ctx, ReadFullyFn read_fn, size_t count);
 
 static ssize_t ReadFullyWithRead(void *ctx, void *buf, size_t count)
 {
@@ -57,7 +59,22 @@ static int SkipWithRead(void *ctx, ReadFullyFn read_fn, size_t count)
 	return 0;
 }
 
+/*
+ * Skip by seeking when |ctx| is a seekable fd, so only the vblock and the
+ * config page are actually read. Pipes fall back to SkipWithRead().
+ */
+static int SkipWithSeek(void *ctx, ReadFullyFn read_fn, size_t count)
+{
+	int fd = *((int*)ctx);
+	if (lseek(fd, count, SEEK_CUR) >= 0)
+		return 0;
+	if (errno != ESPIPE)
+		return -1;
+	return SkipWithRead(ctx, read_fn, count);
+}
+
 static char *FindKernelConfigFromStream(void *ctx, ReadFullyFn read_fn,
+					SkipFn skip_fn,
 					uint64_t kernel_body_load_address)
 {
 	struct vb2_keyblock keyblock;
@@ -71,7 +88,7 @@ static char *FindKernelConfigFromStream(void *ctx, ReadFullyFn read_fn,
 		return NULL;
 	}
 	ssize_t to_skip = keyblock.keyblock_size - sizeof(keyblock);
-	if (to_skip < 0 || SkipWithRead(ctx, read_fn, to_skip)) {
+	if (to_skip < 0 || skip_fn(ctx, read_fn, to_skip)) {
 		FATAL("keyblock_size advances past the end of the blob\n");
 		return NULL;
 	}
@@ -83,7 +100,7 @@ static char *FindKernelConfigFromStream(void *ctx, ReadFullyFn read_fn,
 		return NULL;
 	}
 	to_skip = preamble.preamble_size - sizeof(preamble);
-	if (to_skip < 0 || SkipWithRead(ctx, read_fn, to_skip)) {
+	if (to_skip < 0 || skip_fn(ctx, read_fn, to_skip)) {
 		FATAL("preamble_size advances past the end of the blob\n");
 		return NULL;
 	}
@@ -101,7 +118,7 @@ static char *FindKernelConfigFromStream(void *ctx, ReadFullyFn read_fn,
 	    (kernel_body_load_address + CROS_PARAMS_SIZE +
 	     CROS_CONFIG_SIZE) + now;
 	to_skip = offset - now;
-	if (to_skip < 0 || SkipWithRead(ctx, read_fn, to_skip)) {
+	if (to_skip < 0 || skip_fn(ctx, read_fn, to_skip)) {
 		FATAL("params are outside of the memory blob: %x\n", offset);
 		return NULL;
 	}
@@ -130,8 +147,9 @@ char *FindKernelConfig(const char *infile, uint64_t kernel_body_load_address)
 
 	void *ctx = &fd;
 	ReadFullyFn read_fn = ReadFullyWithRead;
+	SkipFn skip_fn = SkipWithSeek;
 
-	newstr = FindKernelConfigFromStream(ctx, read_fn,
+	newstr = FindKernelConfigFromStream(ctx, read_fn, skip_fn,
 					    kernel_body_load_address);
 
 	close(fd);
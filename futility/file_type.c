@@ -82,15 +82,24 @@ void print_file_types_and_exit(int retval)
 /* Try to figure out what we're looking at */
 enum futil_file_type futil_file_type_buf(uint8_t *buf, uint32_t len)
 {
+	enum futil_file_type (*recognize)(uint8_t *buf, uint32_t len);
+	enum futil_file_type (*tried)(uint8_t *buf, uint32_t len) = NULL;
 	enum futil_file_type type;
 	int i;
 
 	for (i = 0; i < NUM_FILE_TYPES; i++) {
-		if (futil_file_types[i].recognize) {
-			type = futil_file_types[i].recognize(buf, len);
-			if (type != FILE_TYPE_UNKNOWN)
-				return type;
-		}
+		/*
+		 * Related types share a recognizer, which tells them apart
+		 * itself, so there's no point calling it again.
+		 */
+		recognize = futil_file_types[i].recognize;
+		if (!recognize || recognize == tried)
+			continue;
+
+		type = recognize(buf, len);
+		if (type != FILE_TYPE_UNKNOWN)
+			return type;
+		tried = recognize;
 	}
 
 	return FILE_TYPE_UNKNOWN;
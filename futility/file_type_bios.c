@@ -5,6 +5,7 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -106,6 +107,8 @@ int ft_show_gbb(const char *name, uint8_t *buf, uint32_t len, void *data)
 		}
 		printf("  Root Key:\n");
 		show_pubkey(pubkey, "    ");
+		print_gbb_key_digest(gbb, 0, "    Recorded sha1sum:    ",
+				     "\n");
 	} else {
 		retval = 1;
 		printf("  Root Key:              <invalid>\n");
@@ -125,6 +128,8 @@ int ft_show_gbb(const char *name, uint8_t *buf, uint32_t len, void *data)
 		}
 		printf("  Recovery Key:\n");
 		show_pubkey(pubkey, "    ");
+		print_gbb_key_digest(gbb, 1, "    Recorded sha1sum:    ",
+				     "\n");
 	} else {
 		retval = 1;
 		printf("  Recovery Key:          <invalid>\n");
@@ -175,8 +180,93 @@ static int (*fmap_show_fn[])(const char *name, uint8_t *buf, uint32_t len,
 _Static_assert(ARRAY_SIZE(fmap_show_fn) == NUM_BIOS_COMPONENTS,
 	       "Size of fmap_show_fn[] should match NUM_BIOS_COMPONENTS");
 
+struct body_digest_job {
+	pthread_t thread;
+	int started;
+	const struct bios_area_s *vblock;
+	const struct bios_area_s *fw_main;
+	struct bios_body_digest_s *result;
+};
+
+/*
+ * Hash the firmware body signed by one VBLOCK. Nothing here is trusted yet:
+ * ft_show_fw_preamble() verifies the keyblock and preamble as usual, and only
+ * then checks the body signature against this digest. Anything that doesn't
+ * look right is left for it to handle (and report) serially.
+ */
+static void *body_digest_thread(void *arg)
+{
+	struct body_digest_job *job = arg;
+	struct vb2_keyblock *keyblock = (struct vb2_keyblock *)job->vblock->buf;
+	uint32_t len = job->vblock->len;
+	struct vb2_fw_preamble *pre2;
+	struct vb2_public_key data_key;
+	uint32_t data_size;
+	vb2_error_t rv;
+
+	if (len < sizeof(*keyblock) ||
+	    keyblock->keyblock_size > len - sizeof(*pre2) ||
+	    VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key))
+		return NULL;
+
+	pre2 = (struct vb2_fw_preamble *)(job->vblock->buf +
+					  keyblock->keyblock_size);
+	data_size = pre2->body_signature.data_size;
+	if (data_size > job->fw_main->len)
+		return NULL;
+
+	/* Old 2.0 structure didn't have flags */
+	if (pre2->header_version_minor >= 1 &&
+	    (pre2->flags & VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH))
+		rv = vb2_digest_tree_buffer(job->fw_main->buf, data_size,
+					    data_key.hash_alg,
+					    job->result->digest,
+					    sizeof(job->result->digest));
+	else
+		rv = vb2_digest_buffer(job->fw_main->buf, data_size,
+				       data_key.hash_alg, job->result->digest,
+				       sizeof(job->result->digest));
+	if (rv == VB2_SUCCESS) {
+		job->result->data_size = data_size;
+		job->result->done = 1;
+	}
+	return NULL;
+}
+
+/* Hash both firmware bodies at once, ahead of showing anything. */
+static void digest_bodies(struct bios_state_s *state,
+			  struct body_digest_job jobs[2])
+{
+	static const enum bios_component vblock_c[2] = {
+		BIOS_FMAP_VBLOCK_A, BIOS_FMAP_VBLOCK_B,
+	};
+	static const enum bios_component fw_main_c[2] = {
+		BIOS_FMAP_FW_MAIN_A, BIOS_FMAP_FW_MAIN_B,
+	};
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		struct body_digest_job *job = &jobs[i];
+
+		job->vblock = &state->area[vblock_c[i]];
+		job->fw_main = &state->area[fw_main_c[i]];
+		job->result = &state->body_digest[vblock_c[i]];
+		job->started = 0;
+		if (show_option.skip_body || !job->vblock->len ||
+		    !job->fw_main->len)
+			continue;
+		job->started = !pthread_create(&job->thread, NULL,
+					       body_digest_thread, job);
+	}
+
+	for (i = 0; i < 2; i++)
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+}
+
 int ft_show_bios(const char *name, uint8_t *buf, uint32_t len, void *data)
 {
+	struct body_digest_job jobs[2];
 	FmapHeader *fmap;
 	FmapAreaHeader *ah = 0;
 	char ah_name[FMAP_NAMELEN + 1];
@@ -189,7 +279,19 @@ int ft_show_bios(const char *name, uint8_t *buf, uint32_t len, void *data)
 	printf("BIOS:                    %s\n", name);
 
 	/* We've already checked, so we know this will work. */
-	fmap = fmap_find(buf, len);
+	fmap = futil_find_fmap(buf, len);
+
+	/* Find all the areas first, so the bodies can be checked up front */
+	for (c = 0; c < NUM_BIOS_COMPONENTS; c++) {
+		if (fmap_find_by_name(buf, len, fmap, fmap_name[c], &ah) ||
+		    fmap_find_by_name(buf, len, fmap, fmap_oldname[c], &ah)) {
+			fmap_limit_area(ah, len);
+			state.area[c].buf = buf + ah->area_offset;
+			state.area[c].len = ah->area_size;
+		}
+	}
+	digest_bodies(&state, jobs);
+
 	for (c = 0; c < NUM_BIOS_COMPONENTS; c++) {
 		/* We know one of these will work, too */
 		if (fmap_find_by_name(buf, len, fmap, fmap_name[c], &ah) ||
@@ -308,18 +410,22 @@ whatever:
 	return 0;
 }
 
-static int write_new_preamble(struct bios_area_s *vblock,
-			      struct bios_area_s *fw_body,
-			      struct vb2_private_key *signkey,
-			      struct vb2_keyblock *keyblock)
+/* Sign the firmware body and make a preamble for it. Caller must free() it. */
+static struct vb2_fw_preamble *create_preamble(struct bios_area_s *fw_body,
+					       struct vb2_private_key *signkey)
 {
 	struct vb2_signature *body_sig;
 	struct vb2_fw_preamble *preamble;
 
-	body_sig = vb2_calculate_signature(fw_body->buf, fw_body->len, signkey);
+	if (sign_option.flags & VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH)
+		body_sig = vb2_calculate_tree_signature(fw_body->buf,
+							fw_body->len, signkey);
+	else
+		body_sig = vb2_calculate_signature(fw_body->buf, fw_body->len,
+						   signkey);
 	if (!body_sig) {
 		fprintf(stderr, "Error calculating body signature\n");
-		return 1;
+		return NULL;
 	}
 
 	preamble = vb2_create_fw_preamble(sign_option.version,
@@ -327,20 +433,36 @@ static int write_new_preamble(struct bios_area_s *vblock,
 			body_sig,
 			signkey,
 			sign_option.flags);
-	if (!preamble) {
+	free(body_sig);
+	if (!preamble)
 		fprintf(stderr, "Error creating firmware preamble.\n");
-		free(body_sig);
-		return 1;
-	}
 
+	return preamble;
+}
+
+static void write_vblock(struct bios_area_s *vblock,
+			 struct vb2_keyblock *keyblock,
+			 struct vb2_fw_preamble *preamble)
+{
 	/* Write the new keyblock */
 	uint32_t more = keyblock->keyblock_size;
 	memcpy(vblock->buf, keyblock, more);
 	/* and the new preamble */
 	memcpy(vblock->buf + more, preamble, preamble->preamble_size);
+}
 
+static int write_new_preamble(struct bios_area_s *vblock,
+			      struct bios_area_s *fw_body,
+			      struct vb2_private_key *signkey,
+			      struct vb2_keyblock *keyblock)
+{
+	struct vb2_fw_preamble *preamble = create_preamble(fw_body, signkey);
+
+	if (!preamble)
+		return 1;
+
+	write_vblock(vblock, keyblock, preamble);
 	free(preamble);
-	free(body_sig);
 
 	return 0;
 }
@@ -406,25 +528,85 @@ static int sign_bios_at_end(struct bios_state_s *state)
 		retval |= write_new_preamble(vblock_a, fw_a,
 					     sign_option.devsignprivate,
 					     sign_option.devkeyblock);
-	} else {
-		retval |= write_new_preamble(vblock_a, fw_a,
+
+		/* FW B is always normal keys */
+		retval |= write_new_preamble(vblock_b, fw_b,
 					     sign_option.signprivate,
 					     sign_option.keyblock);
+	} else {
+		/*
+		 * Same body and same keys, so both preambles are the same.
+		 * Hash and sign the body only once.
+		 */
+		struct vb2_fw_preamble *preamble =
+			create_preamble(fw_a, sign_option.signprivate);
+
+		if (!preamble)
+			return 1;
+
+		write_vblock(vblock_a, sign_option.keyblock, preamble);
+		write_vblock(vblock_b, sign_option.keyblock, preamble);
+		free(preamble);
+	}
+
+	if (sign_option.loemid) {
+		retval |= write_loem("A", vblock_a);
+		retval |= write_loem("B", vblock_b);
 	}
 
-	/* FW B is always normal keys */
-	retval |= write_new_preamble(vblock_b, fw_b,
-				     sign_option.signprivate,
-				     sign_option.keyblock);
+	return retval;
+}
 
+/* Replace one of the keys in the GBB, clearing whatever was there before. */
+static int write_gbb_key(const char *what, uint8_t *gbb_base,
+			 uint32_t offset, uint32_t size,
+			 const struct vb2_packed_key *key)
+{
+	uint32_t key_len = key->key_offset + key->key_size;
 
+	if (key_len > size) {
+		fprintf(stderr, "New %s (%u bytes) doesn't fit in the GBB"
+			" (%u bytes)\n", what, key_len, size);
+		return 1;
+	}
+	memset(gbb_base + offset, 0, size);
+	memcpy(gbb_base + offset, key, key_len);
+	return 0;
+}
+
+/*
+ * Put new root and recovery keys in the GBB. This must come after signing,
+ * so it doesn't change which keys the existing vblocks are checked against.
+ */
+static int update_gbb_keys(struct bios_state_s *state)
+{
+	struct bios_area_s *area = &state->area[BIOS_FMAP_GBB];
+	struct vb2_gbb_header *gbb = (struct vb2_gbb_header *)area->buf;
+	int retval = 0;
 
+	if (!sign_option.rootkey && !sign_option.recoverykey)
+		return 0;
 
-	if (sign_option.loemid) {
-		retval |= write_loem("A", vblock_a);
-		retval |= write_loem("B", vblock_b);
+	if (!area->len || !futil_valid_gbb_header(gbb, area->len, NULL)) {
+		fprintf(stderr, "Can't find a valid GBB to update\n");
+		return 1;
 	}
 
+	/* Record the new digests too, as "gbb -s" does */
+	if (sign_option.rootkey) {
+		retval |= write_gbb_key("root key", area->buf,
+					gbb->rootkey_offset,
+					gbb->rootkey_size,
+					sign_option.rootkey);
+		update_gbb_key_digest(gbb, 0);
+	}
+	if (sign_option.recoverykey) {
+		retval |= write_gbb_key("recovery key", area->buf,
+					gbb->recovery_key_offset,
+					gbb->recovery_key_size,
+					sign_option.recoverykey);
+		update_gbb_key_digest(gbb, 1);
+	}
 	return retval;
 }
 
@@ -452,7 +634,7 @@ int ft_sign_bios(const char *name, uint8_t *buf, uint32_t len, void *data)
 	memset(&state, 0, sizeof(state));
 
 	/* We've already checked, so we know this will work. */
-	fmap = fmap_find(buf, len);
+	fmap = futil_find_fmap(buf, len);
 	for (c = 0; c < NUM_BIOS_COMPONENTS; c++) {
 		/* We know one of these will work, too */
 		if (fmap_find_by_name(buf, len, fmap, fmap_name[c], &ah) ||
@@ -481,6 +663,8 @@ int ft_sign_bios(const char *name, uint8_t *buf, uint32_t len, void *data)
 	}
 
 	retval += sign_bios_at_end(&state);
+	if (!retval)
+		retval += update_gbb_keys(&state);
 
 	return retval;
 }
@@ -490,7 +674,7 @@ enum futil_file_type ft_recognize_bios_image(uint8_t *buf, uint32_t len)
 	FmapHeader *fmap;
 	enum bios_component c;
 
-	fmap = fmap_find(buf, len);
+	fmap = futil_find_fmap(buf, len);
 	if (!fmap)
 		return FILE_TYPE_UNKNOWN;
 
@@ -8,6 +8,8 @@
 
 #include <stdint.h>
 
+#include "2sha.h"
+
 /*
  * The Chrome OS BIOS must contain specific FMAP areas, which we want to look
  * at in a certain order.
@@ -30,6 +32,17 @@ struct bios_area_s {
 	uint32_t is_valid;
 };
 
+/*
+ * Digest of the firmware body signed by a VBLOCK, computed on a worker thread
+ * before the components are shown so FW_MAIN_A and FW_MAIN_B are hashed
+ * concurrently. Only the (destructive) signature check is left for later.
+ */
+struct bios_body_digest_s {
+	uint32_t done;				/* digest is meaningful */
+	uint32_t data_size;			/* bytes of body hashed */
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+};
+
 /* State to track as we visit all components */
 struct bios_state_s {
 	/* Current component */
@@ -38,6 +51,7 @@ struct bios_state_s {
 	struct bios_area_s area[NUM_BIOS_COMPONENTS];
 	struct bios_area_s recovery_key;
 	struct bios_area_s rootkey;
+	struct bios_body_digest_s body_digest[NUM_BIOS_COMPONENTS];
 };
 
 #endif  /* VBOOT_REFERENCE_FILE_TYPE_BIOS_H_ */
@@ -86,7 +86,7 @@ int ft_show_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 		data = show_option.fv;
 		data_size = show_option.fv_size;
 		total_data_size = show_option.fv_size;
-	} else if ((fmap = fmap_find(buf, len))) {
+	} else if ((fmap = futil_find_fmap(buf, len))) {
 		/* This looks like a full image. */
 		FmapAreaHeader *fmaparea;
 
@@ -219,7 +219,7 @@ int ft_sign_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 
 	/* If we don't have a distinct OUTFILE, look for an existing sig */
 	if (sign_option.inout_file_count < 2) {
-		fmap = fmap_find(buf, len);
+		fmap = futil_find_fmap(buf, len);
 
 		if (fmap) {
 			/* This looks like a full image. */
@@ -281,8 +281,8 @@ int ft_sign_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 
 	/* Sign the blob */
 	if (sign_option.prikey) {
-		r = vb21_sign_data(&tmp_sig,
-				   data, data_size, sign_option.prikey, 0);
+		r = vb21_sign_data_cached(&tmp_sig, data, data_size,
+					  sign_option.prikey, 0);
 		if (r) {
 			fprintf(stderr,
 				"Unable to sign data (error 0x%08x)\n", r);
@@ -343,8 +343,8 @@ int ft_sign_rwsig(const char *name, uint8_t *buf, uint32_t len, void *nuthin)
 		}
 
 		/* Extract the keyb blob */
-		if (vb_keyb_from_rsa(sign_option.prikey->rsa_private_key,
-					&keyb_data, &keyb_size)) {
+		if (vb_keyb_from_private_key(sign_option.prikey,
+					     &keyb_data, &keyb_size)) {
 			fprintf(stderr, "Couldn't extract the public key\n");
 			goto done;
 		}
@@ -416,7 +416,7 @@ enum futil_file_type ft_recognize_rwsig(uint8_t *buf, uint32_t len)
 	if (!vb21_verify_signature((const struct vb21_signature *)buf, len))
 		return FILE_TYPE_RWSIG;
 
-	fmap = fmap_find(buf, len);
+	fmap = futil_find_fmap(buf, len);
 	if (fmap) {
 		/* This looks like a full image. */
 		FmapAreaHeader *fmaparea;
@@ -108,6 +108,13 @@ int ft_sign_usbpd1(const char *name, uint8_t *buf, uint32_t len, void *data)
 		goto done;
 	}
 
+	/* USB-PD1 images only carry RSA signatures */
+	if (!key_ptr->rsa_private_key) {
+		fprintf(stderr, "%s is not an RSA key\n",
+			sign_option.pem_signpriv);
+		goto done;
+	}
+
 	/* Set the algs */
 	key_ptr->hash_alg = sign_option.hash_alg;
 	key_ptr->sig_alg = vb2_rsa_sig_alg(key_ptr->rsa_private_key);
@@ -133,7 +140,8 @@ int ft_sign_usbpd1(const char *name, uint8_t *buf, uint32_t len, void *data)
 	VB2_DEBUG("sig_offset   0x%08x\n", sig_offset);
 
 	/* Sign the blob */
-	r = vb21_sign_data(&sig_ptr, buf + rw_offset, rw_size, key_ptr, "Bah");
+	r = vb21_sign_data_cached(&sig_ptr, buf + rw_offset, rw_size, key_ptr,
+				  "Bah");
 	if (r) {
 		fprintf(stderr,
 			"Unable to sign data (error 0x%08x, if that helps)\n",
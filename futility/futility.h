@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 #include "2common.h"
+#include "fmap.h"
 #include "host_key.h"
 
 /* This program */
@@ -113,6 +114,26 @@ void update_hwid_digest(struct vb2_gbb_header *gbb);
 int print_hwid_digest(struct vb2_gbb_header *gbb,
 		      const char *banner, const char *footer);
 
+/*
+ * Returns true if a GBB key digest (rootkey_sha1 or recovery_key_sha1) has
+ * been recorded.
+ */
+int futil_gbb_key_digest_recorded(const uint8_t *digest);
+
+/*
+ * Record the SHA-1 of the root key (or the recovery key, if recovery is set)
+ * in the GBB header.
+ */
+void update_gbb_key_digest(struct vb2_gbb_header *gbb, int recovery);
+
+/*
+ * If the GBB header records a digest for the root key (or the recovery key,
+ * if recovery is set), print it and whether it matches the key.  Returns
+ * false only if a recorded digest doesn't match.
+ */
+int print_gbb_key_digest(const struct vb2_gbb_header *gbb, int recovery,
+			 const char *banner, const char *footer);
+
 /* Copies a file or dies with an error message */
 void futil_copy_file_or_die(const char *infile, const char *outfile);
 
@@ -148,6 +169,12 @@ enum futil_file_err futil_map_file(int fd, int writeable,
 enum futil_file_err futil_unmap_file(int fd, int writeable,
 				     uint8_t *buf, uint32_t len);
 
+/*
+ * Like fmap_find(), but remembers the result for the file currently mapped by
+ * futil_map_file(), so the FMAP is searched for only once per file.
+ */
+FmapHeader *futil_find_fmap(uint8_t *buf, uint32_t len);
+
 /* The CPU architecture is occasionally important */
 enum arch_t {
 	ARCH_UNSPECIFIED,
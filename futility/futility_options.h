@@ -16,6 +16,7 @@
 
 struct vb2_private_key;
 struct vb21_packed_key;
+struct vb21_signature;
 
 struct show_option_s {
 	struct vb2_public_key *k;
@@ -23,6 +24,8 @@ struct show_option_s {
 	uint64_t fv_size;
 	uint32_t padding;
 	int strict;
+	int skip_body;
+	int json;
 	int t_flag;
 	enum futil_file_type type;
 	struct vb21_packed_key *pkey;
@@ -42,6 +45,8 @@ struct sign_option_s {
 	int flags_specified;
 	char *loemdir;
 	char *loemid;
+	struct vb2_packed_key *rootkey;
+	struct vb2_packed_key *recoverykey;
 	uint8_t *bootloader_data;
 	uint64_t bootloader_size;
 	uint8_t *config_data;
@@ -51,6 +56,7 @@ struct sign_option_s {
 	uint32_t kloadaddr;
 	uint32_t padding;
 	int vblockonly;
+	int trust_body;
 	char *outfile;
 	int create_new_outfile;
 	int inout_file_count;
@@ -58,16 +64,29 @@ struct sign_option_s {
 	int pem_algo_specified;
 	uint32_t pem_algo;
 	char *pem_external;
+	int pem_persistent;
 	enum futil_file_type type;
 	enum vb2_hash_algorithm hash_alg;
 	uint32_t ro_size, rw_size;
 	uint32_t ro_offset, rw_offset;
 	uint32_t data_size, sig_size;
 	struct vb2_private_key *prikey;
+	char *digest_cache;
 };
 extern struct sign_option_s sign_option;
 
 /* Return true if hash_alg was identified, either by name or number */
 int vb2_lookup_hash_alg(const char *str, enum vb2_hash_algorithm *alg);
 
+/*
+ * Same as vb21_sign_data(), but if sign_option.digest_cache names a
+ * directory, look there for the digest of identical data signed earlier
+ * (by this or another futility run) before hashing it, and save it there
+ * afterwards.
+ */
+vb2_error_t vb21_sign_data_cached(struct vb21_signature **sig_ptr,
+				  const uint8_t *data, uint32_t size,
+				  const struct vb2_private_key *key,
+				  const char *desc);
+
 #endif  /* VBOOT_REFERENCE_FUTILITY_OPTIONS_H_ */
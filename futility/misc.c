@@ -25,7 +25,10 @@
 #include "2sysincludes.h"
 #include "cgptlib_internal.h"
 #include "file_type.h"
+#include "fmap.h"
 #include "futility.h"
+#include "host_key.h"
+#include "vboot_struct.h"
 
 /* Default is to support everything we can */
 enum vboot_version vboot_version = VBOOT_VERSION_ALL;
@@ -181,6 +184,68 @@ void update_hwid_digest(struct vb2_gbb_header *gbb)
 			  gbb->hwid_digest, sizeof(gbb->hwid_digest));
 }
 
+int futil_gbb_key_digest_recorded(const uint8_t *digest)
+{
+	int i;
+
+	for (i = 0; i < VB2_GBB_KEY_DIGEST_SIZE; i++)
+		if (digest[i])
+			return 1;
+	return 0;
+}
+
+/* Compute the digest of one GBB key, or all zeros if it isn't a valid key. */
+static void gbb_key_digest(const struct vb2_gbb_header *gbb, uint32_t offset,
+			   uint32_t size, uint8_t *digest)
+{
+	const struct vb2_packed_key *key = (const struct vb2_packed_key *)
+		((const uint8_t *)gbb + offset);
+
+	memset(digest, 0, VB2_GBB_KEY_DIGEST_SIZE);
+	if (vb2_packed_key_looks_ok(key, size) != VB2_SUCCESS)
+		return;
+
+	if (vb2_digest_buffer(vb2_packed_key_data(key), key->key_size,
+			      VB2_HASH_SHA1, digest, VB2_GBB_KEY_DIGEST_SIZE))
+		memset(digest, 0, VB2_GBB_KEY_DIGEST_SIZE);
+}
+
+void update_gbb_key_digest(struct vb2_gbb_header *gbb, int recovery)
+{
+	if (recovery)
+		gbb_key_digest(gbb, gbb->recovery_key_offset,
+			       gbb->recovery_key_size, gbb->recovery_key_sha1);
+	else
+		gbb_key_digest(gbb, gbb->rootkey_offset, gbb->rootkey_size,
+			       gbb->rootkey_sha1);
+}
+
+int print_gbb_key_digest(const struct vb2_gbb_header *gbb, int recovery,
+			 const char *banner, const char *footer)
+{
+	const uint8_t *stored = recovery ? gbb->recovery_key_sha1 :
+			gbb->rootkey_sha1;
+	uint8_t digest[VB2_GBB_KEY_DIGEST_SIZE];
+	int i;
+
+	if (!futil_gbb_key_digest_recorded(stored))
+		return 1;
+
+	if (recovery)
+		gbb_key_digest(gbb, gbb->recovery_key_offset,
+			       gbb->recovery_key_size, digest);
+	else
+		gbb_key_digest(gbb, gbb->rootkey_offset, gbb->rootkey_size,
+			       digest);
+
+	printf("%s", banner);
+	for (i = 0; i < VB2_GBB_KEY_DIGEST_SIZE; i++)
+		printf("%02x", stored[i]);
+	i = !memcmp(stored, digest, sizeof(digest));
+	printf("   %s%s", i ? "valid" : "<invalid>", footer);
+	return i;
+}
+
 /* Sets the HWID string field inside a GBB header. */
 int futil_set_gbb_hwid(struct vb2_gbb_header *gbb, const char *hwid)
 {
@@ -259,6 +324,29 @@ void futil_copy_file_or_die(const char *infile, const char *outfile)
 }
 
 
+/*
+ * Where the FMAP is in the file mapped last, so recognizing, showing and
+ * signing it only searches for it once.  Only valid while it's mapped.
+ */
+static struct {
+	uint8_t *buf;
+	uint32_t len;
+	int searched;
+	FmapHeader *fmap;
+} fmap_cache;
+
+FmapHeader *futil_find_fmap(uint8_t *buf, uint32_t len)
+{
+	if (buf != fmap_cache.buf || len != fmap_cache.len)
+		return fmap_find(buf, len);
+
+	if (!fmap_cache.searched) {
+		fmap_cache.fmap = fmap_find(buf, len);
+		fmap_cache.searched = 1;
+	}
+	return fmap_cache.fmap;
+}
+
 enum futil_file_err futil_map_file(int fd, int writeable,
 				   uint8_t **buf, uint32_t *len)
 {
@@ -300,6 +388,11 @@ enum futil_file_err futil_map_file(int fd, int writeable,
 
 	*buf = (uint8_t *)mmap_ptr;
 	*len = reasonable_len;
+
+	memset(&fmap_cache, 0, sizeof(fmap_cache));
+	fmap_cache.buf = *buf;
+	fmap_cache.len = *len;
+
 	return FILE_ERR_NONE;
 }
 
@@ -309,6 +402,9 @@ enum futil_file_err futil_unmap_file(int fd, int writeable,
 	void *mmap_ptr = buf;
 	enum futil_file_err err = FILE_ERR_NONE;
 
+	if (buf == fmap_cache.buf)
+		memset(&fmap_cache, 0, sizeof(fmap_cache));
+
 	if (writeable &&
 	    (0 != msync(mmap_ptr, len, MS_SYNC|MS_INVALIDATE))) {
 		fprintf(stderr, "msync failed: %s\n", strerror(errno));
@@ -352,3 +448,16 @@ enum futil_file_type ft_recognize_gpt(uint8_t *buf, uint32_t len)
 
 	return FILE_TYPE_CHROMIUMOS_DISK;
 }
+
+enum futil_file_type ft_recognize_vbsd(uint8_t *buf, uint32_t len)
+{
+	VbSharedDataHeader *sh = (VbSharedDataHeader *)buf;
+
+	if (len < VB_SHARED_DATA_HEADER_SIZE_V1)
+		return FILE_TYPE_UNKNOWN;
+
+	if (sh->magic != VB_SHARED_DATA_MAGIC)
+		return FILE_TYPE_UNKNOWN;
+
+	return FILE_TYPE_VBSD;
+}
@@ -7,6 +7,11 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "2rsa.h"
 #include "crossystem.h"
@@ -307,25 +312,58 @@ static int set_try_cookies(struct updater_config *cfg, const char *target,
 }
 
 /*
- * Emulates writing to firmware.
+ * Writes data to the emulation file at offset, in place, and updates the
+ * current image (which the emulation file was loaded into) to match.
  * Returns 0 if success, non-zero if error.
  */
-static int emulate_write_firmware(const char *filename,
+static int emulate_write_at(struct updater_config *cfg, const uint8_t *data,
+			    uint32_t offset, uint32_t size)
+{
+	struct firmware_image *current = &cfg->image_current;
+	uint32_t done = 0;
+	ssize_t r;
+	int fd;
+
+	assert(offset <= current->size && size <= current->size - offset);
+	fd = open(cfg->emulation, O_WRONLY);
+	if (fd < 0) {
+		ERROR("Cannot open %s: %s\n", cfg->emulation,
+		      strerror(errno));
+		return -1;
+	}
+	while (done < size) {
+		r = pwrite(fd, data + done, size - done, offset + done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0) {
+			ERROR("Failed writing to file: %s\n", cfg->emulation);
+			close(fd);
+			return -1;
+		}
+		done += r;
+	}
+	if (close(fd)) {
+		ERROR("Failed writing to file: %s\n", cfg->emulation);
+		return -1;
+	}
+	memmove(current->data + offset, data, size);
+	return 0;
+}
+
+/*
+ * Emulates writing to firmware. Only the written part of the emulation file
+ * is changed, at the offset it has in the current image.
+ * Returns 0 if success, non-zero if error.
+ */
+static int emulate_write_firmware(struct updater_config *cfg,
 				  const struct firmware_image *image,
 				  const char *section_name)
 {
-	struct firmware_image to_image = {0};
+	struct firmware_image *current = &cfg->image_current;
 	struct firmware_section from, to;
+	size_t to_write;
 	int errorcnt = 0;
 
-	from.data = image->data;
-	from.size = image->size;
-
-	if (load_firmware_image(&to_image, filename, NULL)) {
-		ERROR("Cannot load image from %s.\n", filename);
-		return -1;
-	}
-
 	if (section_name) {
 		find_firmware_section(&from, image, section_name);
 		if (!from.data) {
@@ -333,67 +371,243 @@ static int emulate_write_firmware(const char *filename,
 			      section_name, image->file_name);
 			errorcnt++;
 		}
-		find_firmware_section(&to, &to_image, section_name);
+		find_firmware_section(&to, current, section_name);
 		if (!to.data) {
 			ERROR("No section %s in destination image %s.\n",
-			      section_name, filename);
+			      section_name, cfg->emulation);
 			errorcnt++;
 		}
-	} else if (image->size != to_image.size) {
+	} else if (image->size != current->size) {
 		ERROR("Image size is different (%s:%d != %s:%d)\n",
-		      image->file_name, image->size, to_image.file_name,
-		      to_image.size);
+		      image->file_name, image->size, current->file_name,
+		      current->size);
 		errorcnt++;
 	} else {
-		to.data = to_image.data;
-		to.size = to_image.size;
+		from.data = image->data;
+		from.size = image->size;
+		to.data = current->data;
+		to.size = current->size;
 	}
+	if (errorcnt)
+		return errorcnt;
 
-	if (!errorcnt) {
-		size_t to_write = VB2_MIN(to.size, from.size);
+	to_write = VB2_MIN(to.size, from.size);
+	VB2_DEBUG("Writing %zu bytes\n", to_write);
+	if (emulate_write_at(cfg, from.data, to.data - current->data,
+			     to_write))
+		return -1;
 
-		assert(from.data && to.data);
-		VB2_DEBUG("Writing %zu bytes\n", to_write);
-		memcpy(to.data, from.data, to_write);
+	/* A new FMAP may have been written. */
+	if (!section_name) {
+		fmap_index_free(&current->fmap_index);
+		current->fmap_header = fmap_find(current->data,
+						 current->size);
+		if (current->fmap_header)
+			fmap_index_init(&current->fmap_index, current->data,
+					current->size, current->fmap_header);
 	}
+	return 0;
+}
 
-	if (!errorcnt && vb2_write_file(
-			filename, to_image.data, to_image.size)) {
-		ERROR("Failed writing to file: %s\n", filename);
-		errorcnt++;
+/*
+ * Emulates writing the given ranges of a firmware image, in place.
+ * Returns 0 if success, non-zero if error.
+ */
+static int emulate_write_ranges(struct updater_config *cfg,
+				const struct firmware_image *image,
+				const struct flash_range *ranges, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		INFO("(emulation) Writing %#x+%#x from %s to %s.\n",
+		     ranges[i].offset, ranges[i].size, image->file_name,
+		     cfg->emulation);
+		if (emulate_write_at(cfg, image->data + ranges[i].offset,
+				     ranges[i].offset, ranges[i].size))
+			return -1;
 	}
+	return 0;
+}
 
-	free_firmware_image(&to_image);
-	return errorcnt;
+/* Writes a section (or whole image if NULL) to the emulation image. */
+static int write_emulated(struct updater_config *cfg,
+			  const struct firmware_image *image,
+			  const char *section_name)
+{
+	INFO("(emulation) Writing %s from %s to %s (emu=%s).\n",
+	     section_name ? section_name : "whole image",
+	     image->file_name, image->programmer, cfg->emulation);
+
+	return emulate_write_firmware(cfg, image, section_name);
 }
 
 /*
- * Writes a section from given firmware image to system firmware.
- * If section_name is NULL, write whole image.
+ * Erase granularity assumed when planning writes. Flashrom may erase larger
+ * blocks, but 4KiB is the smallest erase size of the SPI chips in use.
+ */
+#define FLASH_ERASE_BLOCK_SIZE 0x1000
+
+/* Beyond this many ranges, flashrom's own --diff is just as good. */
+#define FLASH_PLAN_MAX_RANGES 64
+
+/*
+ * Adds to the plan the erase blocks of [offset, offset + size) that differ
+ * between the current and new image, merging adjacent ones. Ranges are
+ * clipped to the area so nothing outside it is written.
+ * Returns 0 if success, or -1 if the plan has too many ranges.
+ */
+static int plan_area(const struct firmware_image *current,
+		     const struct firmware_image *image,
+		     uint32_t offset, uint32_t size,
+		     struct flash_range *plan, int *count)
+{
+	uint32_t end = offset + size, start, next;
+
+	for (start = offset; start < end; start = next) {
+		struct flash_range *last = *count ? &plan[*count - 1] : NULL;
+
+		next = VB2_MIN(end, (start / FLASH_ERASE_BLOCK_SIZE + 1) *
+				    FLASH_ERASE_BLOCK_SIZE);
+		if (!memcmp(current->data + start, image->data + start,
+			    next - start))
+			continue;
+		if (last && last->offset + last->size == start) {
+			last->size += next - start;
+			continue;
+		}
+		if (*count == FLASH_PLAN_MAX_RANGES)
+			return -1;
+		plan[*count].offset = start;
+		plan[*count].size = next - start;
+		(*count)++;
+	}
+	return 0;
+}
+
+/*
+ * Builds a plan to write the listed sections (or whole image if NULL) by
+ * comparing against the current system firmware. That is only safe when the
+ * current image is a full read of the same flash layout.
+ * Returns the number of ranges in plan, or -1 if no plan can be made.
+ */
+static int plan_writes(struct updater_config *cfg,
+		       const struct firmware_image *image,
+		       const char * const *sections,
+		       struct flash_range *plan)
+{
+	const struct firmware_image *current = &cfg->image_current;
+	struct firmware_section from, to;
+	int i, count = 0;
+
+	if (image != &cfg->image || !current->data || current->partial ||
+	    current->size != image->size)
+		return -1;
+
+	if (!sections) {
+		if (plan_area(current, image, 0, image->size, plan, &count))
+			return -1;
+		return count;
+	}
+
+	for (i = 0; sections[i]; i++) {
+		if (find_firmware_section(&to, image, sections[i]) ||
+		    find_firmware_section(&from, current, sections[i]))
+			return -1;
+		if (to.data - image->data != from.data - current->data ||
+		    to.size != from.size)
+			return -1;
+		if (plan_area(current, image, to.data - image->data, to.size,
+			      plan, &count))
+			return -1;
+	}
+	return count;
+}
+
+/*
+ * Writes the ranges in plan from given firmware image, and updates the
+ * current image to match.
  * Returns 0 if success, non-zero if error.
  */
-static int write_firmware(struct updater_config *cfg,
-			  const struct firmware_image *image,
-			  const char *section_name)
+static int write_plan(struct updater_config *cfg,
+		      const struct firmware_image *image,
+		      const struct flash_range *plan, int count)
+{
+	uint32_t total = 0;
+	int i, r;
+
+	for (i = 0; i < count; i++)
+		total += plan[i].size;
+	INFO("Writing %u bytes in %d range(s) that changed.\n", total, count);
+	if (!count)
+		return 0;
+
+	/* Emulation updates the current image as it goes. */
+	if (cfg->emulation)
+		return emulate_write_ranges(cfg, image, plan, count);
+
+	r = write_system_ranges(image, plan, count, &cfg->tempfiles,
+				cfg->verbosity + 1);
+	if (r)
+		return r;
+
+	for (i = 0; i < count; i++)
+		memcpy(cfg->image_current.data + plan[i].offset,
+		       image->data + plan[i].offset, plan[i].size);
+	return 0;
+}
+
+/*
+ * Writes the listed sections from given firmware image to system firmware,
+ * in one flashrom invocation. If sections is NULL, write whole image.
+ * Returns 0 if success, non-zero if error.
+ */
+static int write_firmware_sections(struct updater_config *cfg,
+				   const struct firmware_image *image,
+				   const char * const *sections)
 {
 	struct firmware_image *diff_image = NULL;
+	struct flash_range plan[FLASH_PLAN_MAX_RANGES];
+	int i, count;
 
-	if (cfg->emulation) {
-		INFO("(emulation) Writing %s from %s to %s (emu=%s).\n",
-		     section_name ? section_name : "whole image",
-		     image->file_name, image->programmer, cfg->emulation);
+	count = plan_writes(cfg, image, sections, plan);
+	if (count >= 0)
+		return write_plan(cfg, image, plan, count);
 
-		return emulate_write_firmware(
-				cfg->emulation, image, section_name);
+	if (cfg->emulation) {
+		if (!sections)
+			return write_emulated(cfg, image, NULL);
+		for (i = 0; sections[i]; i++) {
+			if (write_emulated(cfg, image, sections[i]))
+				return -1;
+		}
+		return 0;
 	}
 
-	if (cfg->fast_update && image == &cfg->image && cfg->image_current.data)
+	/* A partial read isn't what's on the flash, so can't be diffed. */
+	if (cfg->fast_update && image == &cfg->image &&
+	    cfg->image_current.data && !cfg->image_current.partial)
 		diff_image = &cfg->image_current;
 
-	return write_system_firmware(image, diff_image, section_name,
+	return write_system_firmware(image, diff_image, sections,
 				     &cfg->tempfiles, cfg->verbosity + 1);
 }
 
+/*
+ * Writes a section from given firmware image to system firmware.
+ * If section_name is NULL, write whole image.
+ * Returns 0 if success, non-zero if error.
+ */
+static int write_firmware(struct updater_config *cfg,
+			  const struct firmware_image *image,
+			  const char *section_name)
+{
+	const char *sections[] = {section_name, NULL};
+
+	return write_firmware_sections(cfg, image,
+				       section_name ? sections : NULL);
+}
+
 /*
  * Returns True if we should start the update process for given image.
  */
@@ -744,6 +958,51 @@ static int verify_keyblock(const struct vb2_keyblock *block,
 	return 0;
 }
 
+/*
+ * Verifies if keyblock in the image is signed with given key, like
+ * verify_keyblock, but remembers the result in the image so the same
+ * keyblock is verified with the same key at most once per run. The results
+ * are looked up by a digest of the key and keyblock, so changes to either
+ * are never served a stale result.
+ * Returns 0 on success, otherwise failure.
+ */
+static int verify_image_keyblock(struct firmware_image *image,
+				 const struct vb2_keyblock *block,
+				 const struct vb2_packed_key *sign_key)
+{
+	struct vb2_digest_context dc;
+	struct keyblock_check *check;
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	int i;
+
+	if (vb2_digest_init(&dc, VB2_HASH_SHA256) ||
+	    vb2_digest_extend(&dc, (const uint8_t *)sign_key,
+			      sign_key->key_offset + sign_key->key_size) ||
+	    vb2_digest_extend(&dc, (const uint8_t *)block,
+			      block->keyblock_size) ||
+	    vb2_digest_finalize(&dc, digest, sizeof(digest)))
+		return verify_keyblock(block, sign_key);
+
+	for (i = 0; i < VB2_MIN(image->num_keyblock_checks,
+				ARRAY_SIZE(image->keyblock_checks)); i++) {
+		check = &image->keyblock_checks[i];
+		if (memcmp(check->digest, digest, sizeof(digest)))
+			continue;
+		VB2_DEBUG("Keyblock in %s was already verified.\n",
+			  image->file_name);
+		if (check->result)
+			ERROR("Failed verifying keyblock.\n");
+		return check->result;
+	}
+
+	/* Keep the most recent results. */
+	i = image->num_keyblock_checks++ % ARRAY_SIZE(image->keyblock_checks);
+	check = &image->keyblock_checks[i];
+	memcpy(check->digest, digest, sizeof(digest));
+	check->result = verify_keyblock(block, sign_key);
+	return check->result;
+}
+
 /*
  * Gets the data key and firmware version from a section on firmware image.
  * The section should contain a vb2_keyblock and a vb2_fw_preamble immediately
@@ -776,7 +1035,7 @@ static int get_key_versions(const struct firmware_image *image,
  */
 static enum rootkey_compat_result check_compatible_root_key(
 		const struct firmware_image *ro_image,
-		const struct firmware_image *rw_image)
+		struct firmware_image *rw_image)
 {
 	const struct vb2_gbb_header *gbb = find_gbb(ro_image);
 	const struct vb2_packed_key *rootkey;
@@ -794,7 +1053,7 @@ static enum rootkey_compat_result check_compatible_root_key(
 	if (!keyblock)
 		return ROOTKEY_COMPAT_ERROR;
 
-	if (verify_keyblock(keyblock, rootkey) != 0) {
+	if (verify_image_keyblock(rw_image, keyblock, rootkey) != 0) {
 		const struct vb2_gbb_header *gbb_rw = find_gbb(rw_image);
 		const struct vb2_packed_key *rootkey_rw = NULL;
 		int is_same_key = 0, to_dev = 0;
@@ -839,16 +1098,11 @@ static int legacy_needs_update(struct updater_config *cfg)
 	int has_from, has_to;
 	const char * const tag = "cros_allow_auto_update";
 	const char *section = FMAP_RW_LEGACY;
-	const char *tmp_path;
 
 	VB2_DEBUG("Checking %s contents...\n", FMAP_RW_LEGACY);
 
-	tmp_path = get_firmware_image_temp_file(&cfg->image, &cfg->tempfiles);
-	if (!tmp_path)
-		return 0;
-
-	has_to = cbfs_file_exists(tmp_path, section, tag);
-	has_from = cbfs_file_exists(tmp_path, section, tag);
+	has_to = cbfs_file_exists(&cfg->image, section, tag);
+	has_from = cbfs_file_exists(&cfg->image_current, section, tag);
 
 	if (!has_from || !has_to) {
 		VB2_DEBUG("Current legacy firmware has%s updater tag (%s) and "
@@ -953,6 +1207,85 @@ static int update_ec_firmware(struct updater_config *cfg)
 	return r;
 }
 
+/*
+ * Update host (AP) firmware, the whole image.
+ * Returns 0 if success, non-zero if error.
+ */
+static int write_host_firmware(struct updater_config *cfg)
+{
+	return write_firmware(cfg, &cfg->image, NULL);
+}
+
+/*
+ * Update PD firmware, the whole image.
+ * Returns 0 if success, non-zero if error.
+ */
+static int update_pd_firmware(struct updater_config *cfg)
+{
+	return write_optional_firmware(cfg, &cfg->pd_image, NULL, 1, 0);
+}
+
+/* A firmware target that can be updated independently of the others. */
+struct update_job {
+	const char *name;
+	int (*run)(struct updater_config *cfg);
+	pid_t pid;
+};
+
+/*
+ * Runs the update jobs at the same time, each in a child process, since the
+ * targets are on different buses and flashing them dominates the update time.
+ * A job that can't be forked is run in this process instead.
+ * Returns the number of jobs that failed.
+ */
+static int run_update_jobs(struct updater_config *cfg,
+			   struct update_job *jobs, int count)
+{
+	int i, status, errorcnt = 0;
+
+	for (i = 0; i < count; i++) {
+		/* Don't let the child inherit anything still buffered. */
+		fflush(stdout);
+		fflush(stderr);
+		jobs[i].pid = fork();
+		if (jobs[i].pid < 0) {
+			WARN("Can't fork for %s: %s\n", jobs[i].name,
+			     strerror(errno));
+			if (jobs[i].run(cfg)) {
+				ERROR("Failed updating %s firmware.\n",
+				      jobs[i].name);
+				errorcnt++;
+			}
+			continue;
+		}
+		if (!jobs[i].pid) {
+			/* Only clean up the temp files made by this job. */
+			int r;
+
+			cfg->tempfiles.next = NULL;
+			r = jobs[i].run(cfg);
+			remove_all_temp_files(&cfg->tempfiles);
+			fflush(stdout);
+			fflush(stderr);
+			_exit(!!r);
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (jobs[i].pid < 0)
+			continue;
+		if (waitpid(jobs[i].pid, &status, 0) < 0) {
+			ERROR("Can't wait for %s: %s\n", jobs[i].name,
+			      strerror(errno));
+			errorcnt++;
+		} else if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+			ERROR("Failed updating %s firmware.\n", jobs[i].name);
+			errorcnt++;
+		}
+	}
+	return errorcnt;
+}
+
 const char * const updater_error_messages[] = {
 	[UPDATE_ERR_DONE] = "Done (no error)",
 	[UPDATE_ERR_NEED_RO_UPDATE] = "RO changed and no WP. Need full update.",
@@ -993,8 +1326,6 @@ static enum updater_error_codes update_try_rw_firmware(
 	INFO("Checking compatibility...\n");
 	if (check_compatible_root_key(image_from, image_to))
 		return UPDATE_ERR_ROOT_KEY;
-	if (check_compatible_tpm_keys(cfg, image_to))
-		return UPDATE_ERR_TPM_ROLLBACK;
 
 	VB2_DEBUG("Firmware %s vboot2.\n", is_vboot2 ?  "is" : "is NOT");
 	target = decide_rw_target(cfg, TARGET_SELF, is_vboot2);
@@ -1050,6 +1381,10 @@ static enum updater_error_codes update_rw_firmware(
 		struct firmware_image *image_from,
 		struct firmware_image *image_to)
 {
+	const char * const rw_sections[] = {
+		FMAP_RW_SECTION_A, FMAP_RW_SECTION_B, FMAP_RW_SHARED, NULL,
+	};
+
 	STATUS("RW UPDATE: Updating RW sections (%s, %s, %s, and %s).\n",
 	       FMAP_RW_SECTION_A, FMAP_RW_SECTION_B, FMAP_RW_SHARED,
 	       FMAP_RW_LEGACY);
@@ -1057,15 +1392,7 @@ static enum updater_error_codes update_rw_firmware(
 	INFO("Checking compatibility...\n");
 	if (check_compatible_root_key(image_from, image_to))
 		return UPDATE_ERR_ROOT_KEY;
-	if (check_compatible_tpm_keys(cfg, image_to))
-		return UPDATE_ERR_TPM_ROLLBACK;
-	/*
-	 * TODO(hungte) Speed up by flashing multiple sections in one
-	 * command, or provide diff file.
-	 */
-	if (write_firmware(cfg, image_to, FMAP_RW_SECTION_A) ||
-	    write_firmware(cfg, image_to, FMAP_RW_SECTION_B) ||
-	    write_firmware(cfg, image_to, FMAP_RW_SHARED) ||
+	if (write_firmware_sections(cfg, image_to, rw_sections) ||
 	    write_optional_firmware(cfg, image_to, FMAP_RW_LEGACY, 0, 1))
 		return UPDATE_ERR_WRITE_FIRMWARE;
 
@@ -1099,6 +1426,12 @@ static enum updater_error_codes update_whole_firmware(
 		struct updater_config *cfg,
 		struct firmware_image *image_to)
 {
+	struct update_job jobs[] = {
+		{ "AP", write_host_firmware },
+		{ "EC", update_ec_firmware },
+		{ "PD", update_pd_firmware },
+	};
+
 	STATUS("FULL UPDATE: Updating whole firmware image(s), RO+RW.\n");
 
 	if (preserve_images(cfg))
@@ -1132,18 +1465,47 @@ static enum updater_error_codes update_whole_firmware(
 			return UPDATE_ERR_ROOT_KEY;
 		}
 	}
-	if (check_compatible_tpm_keys(cfg, image_to))
-		return UPDATE_ERR_TPM_ROLLBACK;
 
 	/* FMAP may be different so we should just update all. */
-	if (write_firmware(cfg, image_to, NULL) ||
-	    update_ec_firmware(cfg) ||
-	    write_optional_firmware(cfg, &cfg->pd_image, NULL, 1, 0))
+	if (run_update_jobs(cfg, jobs, ARRAY_SIZE(jobs)))
 		return UPDATE_ERR_WRITE_FIRMWARE;
 
 	return UPDATE_ERR_DONE;
 }
 
+/*
+ * Returns the FMAP sections of the system firmware that the update will look
+ * at, or NULL if it needs the whole image. With write protection enabled only
+ * RW sections are written, so the current firmware is only needed for its
+ * versions, GBB, legacy section and (to try an update) the running RW slot.
+ */
+static const char * const *sections_to_load(struct updater_config *cfg)
+{
+	static const char *sections[] = {
+		FMAP_RO_FRID,
+		FMAP_RO_GBB,
+		FMAP_RW_FWID,
+		FMAP_RW_FWID_A,
+		FMAP_RW_FWID_B,
+		FMAP_RW_LEGACY,
+		NULL,	/* The running RW slot */
+		NULL,
+	};
+
+	if (cfg->legacy_update || !is_write_protection_enabled(cfg))
+		return NULL;
+
+	if (cfg->try_update) {
+		int is_vboot2 = get_system_property(SYS_PROP_FW_VBOOT2, cfg);
+		const char *target = decide_rw_target(cfg, TARGET_SELF,
+						      is_vboot2);
+		if (!target)
+			return NULL;
+		sections[ARRAY_SIZE(sections) - 2] = target;
+	}
+	return sections;
+}
+
 /*
  * The main updater to update system firmware using the configuration parameter.
  * Returns UPDATE_ERR_DONE if success, otherwise failure.
@@ -1165,14 +1527,19 @@ enum updater_error_codes update_firmware(struct updater_config *cfg)
 	if (try_apply_quirk(QUIRK_MIN_PLATFORM_VERSION, cfg))
 		return UPDATE_ERR_PLATFORM;
 
+	/*
+	 * The TPM check only needs the target's VBLOCK_A, so reject rollbacks
+	 * before spending seconds reading the current system firmware. Every
+	 * mode except legacy would fail this check later anyway.
+	 */
+	if (!cfg->legacy_update && check_compatible_tpm_keys(cfg, image_to))
+		return UPDATE_ERR_TPM_ROLLBACK;
+
 	if (!image_from->data) {
-		/*
-		 * TODO(hungte) Read only RO_SECTION, VBLOCK_A, VBLOCK_B,
-		 * RO_VPD, RW_VPD, RW_NVRAM, RW_LEGACY.
-		 */
 		INFO("Loading current system firmware...\n");
 		if (load_system_firmware(image_from, &cfg->tempfiles,
-					 cfg->verbosity) != 0)
+					 cfg->verbosity,
+					 sections_to_load(cfg)) != 0)
 			return UPDATE_ERR_SYSTEM_IMAGE;
 	}
 	STATUS("Current system: %s (RO:%s, RW/A:%s, RW/B:%s).\n",
@@ -1345,7 +1712,8 @@ static int updater_apply_white_label(struct updater_config *cfg,
 		} else {
 			INFO("Loading system firmware for white label...\n");
 			load_system_firmware(&cfg->image_current,
-					     &cfg->tempfiles, cfg->verbosity);
+					     &cfg->tempfiles, cfg->verbosity,
+					     NULL);
 			tmp_image = cfg->image_current.file_name;
 		}
 		if (!tmp_image) {
@@ -12,7 +12,8 @@
 #include "updater_utils.h"
 
 /* FMAP section names. */
-static const char * const FMAP_RO_FRID = "RO_FRID",
+static const char * const FMAP_FMAP = "FMAP",
+		  * const FMAP_RO_FRID = "RO_FRID",
 		  * const FMAP_RO_SECTION = "RO_SECTION",
 		  * const FMAP_RO_GBB = "GBB",
 		  * const FMAP_RW_VBLOCK_A = "VBLOCK_A",
@@ -96,6 +97,9 @@ struct model_config {
 	struct patch_config patches;
 	char *signature_id;
 	int is_white_label;
+	/* The setvars file, until it is parsed; see manifest_find_model. */
+	char *setvars;
+	int invalid;
 };
 
 struct manifest {
@@ -20,6 +20,7 @@
 #include <zip.h>
 #endif
 
+#include "2sha.h"
 #include "host_misc.h"
 #include "updater.h"
 #include "util_misc.h"
@@ -627,6 +628,12 @@ static int change_gbb_rootkey(struct firmware_image *image,
 	/* See cmd_gbb_utility: root key must be first cleared with zero. */
 	memset(gbb_rootkey, 0, gbb->rootkey_size);
 	memcpy(gbb_rootkey, rootkey, rootkey_len);
+	/*
+	 * Forget any recorded digest rather than recording a new one, so
+	 * patching in the key an image was built with gives back the
+	 * original image.
+	 */
+	memset((uint8_t *)gbb->rootkey_sha1, 0, sizeof(gbb->rootkey_sha1));
 	return 0;
 }
 
@@ -759,14 +766,55 @@ static struct model_config *manifest_add_model(
 	return model;
 }
 
+/*
+ * Loads a model config from its setvars file, if that hasn't been done yet.
+ * Returns 0 on success, otherwise failure.
+ */
+static int model_config_load(struct model_config *model,
+			     struct archive *archive)
+{
+	char *setvars = model->setvars;
+
+	if (!setvars)
+		return model->invalid;
+
+	model->setvars = NULL;
+	VB2_DEBUG("Loading model <%s> setvars: %s\n", model->name, setvars);
+	if (model_config_parse_setvars_file(model, archive, setvars)) {
+		ERROR("Invalid setvars file: %s\n", setvars);
+		model->invalid = 1;
+		free(setvars);
+		return -1;
+	}
+	free(setvars);
+
+	/* In legacy setvars.sh, the ec_image and pd_image may not exist. */
+	if (model->ec_image && !archive_has_entry(archive, model->ec_image)) {
+		VB2_DEBUG("Ignore non-exist EC image: %s\n", model->ec_image);
+		free(model->ec_image);
+		model->ec_image = NULL;
+	}
+	if (model->pd_image && !archive_has_entry(archive, model->pd_image)) {
+		VB2_DEBUG("Ignore non-exist PD image: %s\n", model->pd_image);
+		free(model->pd_image);
+		model->pd_image = NULL;
+	}
+
+	/* Find patch files. */
+	if (model->signature_id)
+		find_patches_for_model(model, archive, model->signature_id);
+	return 0;
+}
+
 /*
  * A callback function for manifest to scan files in archive.
+ * Models are only listed here; each setvars file is parsed when its model is
+ * needed, since universal updaters may have dozens of them.
  * Returns 0 to keep scanning, or non-zero to stop.
  */
 static int manifest_scan_entries(const char *name, void *arg)
 {
 	struct manifest *manifest = (struct manifest *)arg;
-	struct archive *archive = manifest->archive;
 	struct model_config model = {0};
 	char *slash;
 
@@ -782,27 +830,7 @@ static int manifest_scan_entries(const char *name, void *arg)
 		*slash = '\0';
 
 	VB2_DEBUG("Found model <%s> setvars: %s\n", model.name, name);
-	if (model_config_parse_setvars_file(&model, archive, name)) {
-		ERROR("Invalid setvars file: %s\n", name);
-		return 0;
-	}
-
-	/* In legacy setvars.sh, the ec_image and pd_image may not exist. */
-	if (model.ec_image && !archive_has_entry(archive, model.ec_image)) {
-		VB2_DEBUG("Ignore non-exist EC image: %s\n", model.ec_image);
-		free(model.ec_image);
-		model.ec_image = NULL;
-	}
-	if (model.pd_image && !archive_has_entry(archive, model.pd_image)) {
-		VB2_DEBUG("Ignore non-exist PD image: %s\n", model.pd_image);
-		free(model.pd_image);
-		model.pd_image = NULL;
-	}
-
-	/* Find patch files. */
-	if (model.signature_id)
-		find_patches_for_model(&model, archive, model.signature_id);
-
+	model.setvars = strdup(name);
 	return !manifest_add_model(manifest, &model);
 }
 
@@ -815,7 +843,7 @@ const struct model_config *manifest_find_model(const struct manifest *manifest,
 					       const char *model_name)
 {
 	char *sys_model_name = NULL;
-	const struct model_config *model = NULL;
+	struct model_config *model = NULL;
 	int i;
 
 	/*
@@ -823,8 +851,11 @@ const struct model_config *manifest_find_model(const struct manifest *manifest,
 	 * there are other mechanisms like platform name check to double confirm
 	 * if the firmware is valid.
 	 */
-	if (manifest->num == 1)
-		return &manifest->models[0];
+	if (manifest->num == 1) {
+		model = &manifest->models[0];
+		return model_config_load(model, manifest->archive) ?
+				NULL : model;
+	}
 
 	if (!model_name) {
 		sys_model_name = host_shell("mosys platform model");
@@ -836,7 +867,10 @@ const struct model_config *manifest_find_model(const struct manifest *manifest,
 		if (strcmp(model_name, manifest->models[i].name) == 0)
 			model = &manifest->models[i];
 	}
-	if (!model) {
+	if (model && model_config_load(model, manifest->archive)) {
+		ERROR("Invalid config for model: '%s'.\n", model_name);
+		model = NULL;
+	} else if (!model) {
 		if (!*model_name)
 			ERROR("Cannot get model name.\n");
 		else
@@ -1022,11 +1056,17 @@ void delete_manifest(struct manifest *manifest)
 		free(model->patches.rootkey);
 		free(model->patches.vblock_a);
 		free(model->patches.vblock_b);
+		free(model->setvars);
 	}
 	free(manifest->models);
 	free(manifest);
 }
 
+/*
+ * The digest recorded in the GBB isn't used here: other tools may have
+ * replaced the key without updating it, and checking it costs as much as
+ * computing it.
+ */
 static const char *get_gbb_key_hash(const struct vb2_gbb_header *gbb,
 				    int32_t offset, int32_t size)
 {
@@ -1034,31 +1074,183 @@ static const char *get_gbb_key_hash(const struct vb2_gbb_header *gbb,
 
 	if (!gbb)
 		return "<No GBB>";
+
 	key = (struct vb2_packed_key *)((uint8_t *)gbb + offset);
 	if (vb2_packed_key_looks_ok(key, size))
 		return "<Invalid key>";
 	return packed_key_sha1_string(key);
 }
 
+/*
+ * Images loaded for print_json_manifest. Models often share the same image
+ * file, or have copies of it under different paths, so each image is loaded
+ * once and identified by its content digest.
+ */
+struct image_cache {
+	int num;
+	struct image_cache_entry {
+		const char *path;
+		uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+		struct firmware_image image;
+		/* Index of the entry with the same contents, or -1. */
+		int same;
+	} *entries;
+};
+
+/*
+ * Finds or loads the image from given path.
+ * Returns the shared image, or NULL on failure.
+ */
+static struct firmware_image *image_cache_get(
+		struct image_cache *cache, const char *fpath,
+		struct archive *archive)
+{
+	struct image_cache_entry *entries, *e;
+	int i;
+
+	for (i = 0; i < cache->num; i++) {
+		e = &cache->entries[i];
+		if (strcmp(e->path, fpath))
+			continue;
+		return &cache->entries[e->same < 0 ? i : e->same].image;
+	}
+
+	entries = realloc(cache->entries, (cache->num + 1) * sizeof(*e));
+	if (!entries) {
+		ERROR("Internal error: failed to allocate buffer.\n");
+		return NULL;
+	}
+	cache->entries = entries;
+	e = &entries[cache->num];
+	memset(e, 0, sizeof(*e));
+	e->path = fpath;
+	e->same = -1;
+	if (load_firmware_image(&e->image, fpath, archive))
+		return NULL;
+	if (vb2_digest_buffer(e->image.data, e->image.size, VB2_HASH_SHA256,
+			      e->digest, sizeof(e->digest))) {
+		free_firmware_image(&e->image);
+		return NULL;
+	}
+	cache->num++;
+
+	for (i = 0; i < cache->num - 1; i++) {
+		struct image_cache_entry *other = &entries[i];
+		if (other->same >= 0 || other->image.size != e->image.size ||
+		    memcmp(other->digest, e->digest, sizeof(e->digest)))
+			continue;
+		VB2_DEBUG("%s is the same as %s.\n", fpath, other->path);
+		free_firmware_image(&e->image);
+		e->same = i;
+		return &other->image;
+	}
+	return &e->image;
+}
+
+/* Releases all images in the cache. */
+static void image_cache_free(struct image_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->num; i++)
+		free_firmware_image(&cache->entries[i].image);
+	free(cache->entries);
+}
+
+/* Sections patch_image_by_model() may change. */
+static const char * const patched_sections[] = {
+	FMAP_RO_GBB,
+	FMAP_RW_VBLOCK_A,
+	FMAP_RW_VBLOCK_B,
+};
+
+/* Original contents of a section, to be put back after patching. */
+struct section_backup {
+	uint8_t *where;
+	uint8_t *data;
+	size_t size;
+};
+
+/*
+ * Puts back the sections saved by backup_patched_sections() and frees the
+ * saved copies.
+ */
+static void restore_patched_sections(struct section_backup *backup)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(patched_sections); i++) {
+		if (backup[i].data)
+			memcpy(backup[i].where, backup[i].data,
+			       backup[i].size);
+		free(backup[i].data);
+	}
+	memset(backup, 0, ARRAY_SIZE(patched_sections) * sizeof(*backup));
+}
+
+/*
+ * Saves the sections of a shared image that patching may change, so the
+ * image can be patched in place and restored afterwards instead of copied
+ * whole.
+ * Returns 0 on success, otherwise failure.
+ */
+static int backup_patched_sections(const struct firmware_image *image,
+				   struct section_backup *backup)
+{
+	struct firmware_section section;
+	int i;
+
+	memset(backup, 0, ARRAY_SIZE(patched_sections) * sizeof(*backup));
+	for (i = 0; i < ARRAY_SIZE(patched_sections); i++) {
+		find_firmware_section(&section, image, patched_sections[i]);
+		if (!section.data)
+			continue;
+		backup[i].data = malloc(section.size);
+		if (!backup[i].data) {
+			ERROR("Internal error: failed to allocate buffer.\n");
+			restore_patched_sections(backup);
+			return -1;
+		}
+		memcpy(backup[i].data, section.data, section.size);
+		backup[i].where = section.data;
+		backup[i].size = section.size;
+	}
+	return 0;
+}
+
 /* Prints the information of given image file in JSON format. */
 static void print_json_image(
 		const char *name, const char *fpath, struct model_config *m,
-		struct archive *archive, int indent, int is_host)
+		struct archive *archive, struct image_cache *cache,
+		int indent, int is_host)
 {
-	struct firmware_image image = {0};
+	struct firmware_image *image;
+	struct section_backup backup[ARRAY_SIZE(patched_sections)];
 	const struct vb2_gbb_header *gbb = NULL;
+	int patch;
+
 	if (!fpath)
 		return;
-	if (load_firmware_image(&image, fpath, archive))
+	image = image_cache_get(cache, fpath, archive);
+	if (!image)
+		return;
+
+	/*
+	 * The image is shared with other models, so models with patches
+	 * patch it in place and put the few changed sections back after.
+	 */
+	patch = is_host && (m->patches.rootkey || m->patches.vblock_a ||
+			    m->patches.vblock_b);
+	if (patch && backup_patched_sections(image, backup))
 		return;
 	if (is_host)
-		gbb = find_gbb(&image);
+		gbb = find_gbb(image);
 	else
 		printf(",\n");
 	printf("%*s\"%s\": { \"versions\": { \"ro\": \"%s\", \"rw\": \"%s\" },",
-	       indent, "", name, image.ro_version, image.rw_version_a);
+	       indent, "", name, image->ro_version, image->rw_version_a);
 	indent += 2;
-	if (is_host && patch_image_by_model(&image, m, archive) != 0) {
+	if (patch && patch_image_by_model(image, m, archive) != 0) {
 		ERROR("Failed to patch images by model: %s\n", m->name);
 	} else if (gbb) {
 		printf("\n%*s\"keys\": { \"root\": \"%s\", ",
@@ -1070,23 +1262,28 @@ static void print_json_image(
 					gbb->recovery_key_size));
 	}
 	printf("\n%*s\"image\": \"%s\" }", indent, "", fpath);
-	free_firmware_image(&image);
+	if (patch)
+		restore_patched_sections(backup);
 }
 
 /* Prints the information of objects in manifest (models and images) in JSON. */
 void print_json_manifest(const struct manifest *manifest)
 {
-	int i, indent;
+	int i, indent, count = 0;
 	struct archive *ar = manifest->archive;
+	struct image_cache cache = {0};
 
 	printf("{\n");
 	for (i = 0, indent = 2; i < manifest->num; i++) {
 		struct model_config *m = &manifest->models[i];
-		printf("%s%*s\"%s\": {\n", i ? ",\n" : "", indent, "", m->name);
+		if (model_config_load(m, ar))
+			continue;
+		printf("%s%*s\"%s\": {\n", count++ ? ",\n" : "", indent, "",
+		       m->name);
 		indent += 2;
-		print_json_image("host", m->image, m, ar, indent, 1);
-		print_json_image("ec", m->ec_image, m, ar, indent, 0);
-		print_json_image("pd", m->pd_image, m, ar, indent, 0);
+		print_json_image("host", m->image, m, ar, &cache, indent, 1);
+		print_json_image("ec", m->ec_image, m, ar, &cache, indent, 0);
+		print_json_image("pd", m->pd_image, m, ar, &cache, indent, 0);
 		if (m->patches.rootkey) {
 			struct patch_config *p = &m->patches;
 			printf(",\n%*s\"patches\": { \"rootkey\": \"%s\", "
@@ -1102,4 +1299,5 @@ void print_json_manifest(const struct manifest *manifest)
 		assert(indent == 2);
 	}
 	printf("\n}\n");
+	image_cache_free(&cache);
 }
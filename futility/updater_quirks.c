@@ -98,35 +98,44 @@ static int is_ec_software_sync_enabled(struct updater_config *cfg)
  */
 static int ec_ro_software_sync(struct updater_config *cfg)
 {
-	const char *ec_ro_path;
-	uint8_t *ec_ro_data;
+	const char *ec_ro_path, *tmp_path;
+	uint8_t *ec_ro_data = NULL;
 	uint32_t ec_ro_len;
-	int is_same_ec_ro;
-	struct firmware_section ec_ro_sec;
-	const char *tmp_path = get_firmware_image_temp_file(
-			&cfg->image, &cfg->tempfiles);
+	int is_same_ec_ro, compressed = 0;
+	struct firmware_section ec_ro_sec, ec_ro_file;
 
-	if (!tmp_path)
-		return 1;
 	find_firmware_section(&ec_ro_sec, &cfg->ec_image, "EC_RO");
 	if (!ec_ro_sec.data || !ec_ro_sec.size) {
 		ERROR("EC image has invalid section '%s'.\n", "EC_RO");
 		return 1;
 	}
-	ec_ro_path = cbfs_extract_file(tmp_path, FMAP_RO_SECTION, "ecro",
-				       &cfg->tempfiles);
-	if (!ec_ro_path ||
-	    !cbfs_file_exists(tmp_path, FMAP_RO_SECTION, "ecro.hash")) {
+	if (cbfs_find_file(&ec_ro_file, &cfg->image, FMAP_RO_SECTION, "ecro",
+			   &compressed) ||
+	    !cbfs_file_exists(&cfg->image, FMAP_RO_SECTION, "ecro.hash")) {
 		INFO("No valid EC RO for software sync in AP firmware.\n");
 		return 1;
 	}
-	if (vb2_read_file(ec_ro_path, &ec_ro_data, &ec_ro_len) != VB2_SUCCESS) {
-		ERROR("Failed to read EC RO.\n");
-		return 1;
+
+	/* Only cbfstool can decompress it. */
+	if (compressed) {
+		tmp_path = get_firmware_image_temp_file(&cfg->image,
+							&cfg->tempfiles);
+		if (!tmp_path)
+			return 1;
+		ec_ro_path = cbfs_extract_file(tmp_path, FMAP_RO_SECTION,
+					       "ecro", &cfg->tempfiles);
+		if (!ec_ro_path || vb2_read_file(ec_ro_path, &ec_ro_data,
+						 &ec_ro_len) != VB2_SUCCESS) {
+			ERROR("Failed to read EC RO.\n");
+			return 1;
+		}
+		ec_ro_file.data = ec_ro_data;
+		ec_ro_file.size = ec_ro_len;
 	}
 
-	is_same_ec_ro = (ec_ro_len <= ec_ro_sec.size &&
-			 memcmp(ec_ro_sec.data, ec_ro_data, ec_ro_len) == 0);
+	is_same_ec_ro = (ec_ro_file.size <= ec_ro_sec.size &&
+			 memcmp(ec_ro_sec.data, ec_ro_file.data,
+				ec_ro_file.size) == 0);
 	free(ec_ro_data);
 
 	if (!is_same_ec_ro) {
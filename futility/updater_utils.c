@@ -7,11 +7,13 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "2common.h"
 #include "crossystem.h"
 #include "host_misc.h"
+#include "subprocess.h"
 #include "util_misc.h"
 #include "updater.h"
 
@@ -79,23 +81,110 @@ int save_file_from_stdin(const char *output)
 	return 0;
 }
 
+/* CBFS file headers, as in coreboot's cbfs_serialized.h (big endian). */
+#define CBFS_FILE_MAGIC "LARCHIVE"
+#define CBFS_ALIGNMENT 64
+#define CBFS_FILE_HEADER_SIZE 24
+#define CBFS_FILE_ATTR_TAG_COMPRESSION 0x42435a4c
+#define CBFS_TYPE_DELETED 0x00000000
+#define CBFS_TYPE_NULL 0xffffffff
+
+static uint32_t read_be32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/* Returns true if the attributes of a CBFS file say it is compressed. */
+static int cbfs_attr_compressed(const uint8_t *header, uint32_t attr_offset,
+				uint32_t data_offset)
+{
+	uint32_t tag, len;
+
+	if (!attr_offset)
+		return 0;
+	while (attr_offset < data_offset && data_offset - attr_offset >= 8) {
+		tag = read_be32(header + attr_offset);
+		len = read_be32(header + attr_offset + 4);
+		if (len < 8 || len > data_offset - attr_offset)
+			break;
+		if (tag == CBFS_FILE_ATTR_TAG_COMPRESSION && len >= 12)
+			return read_be32(header + attr_offset + 8) != 0;
+		attr_offset += len;
+	}
+	return 0;
+}
+
+/*
+ * Finds a file in the CBFS of an FMAP section of a loaded firmware image, by
+ * walking the file headers in place.
+ */
+int cbfs_find_file(struct firmware_section *file,
+		   const struct firmware_image *image,
+		   const char *section_name,
+		   const char *cbfs_name,
+		   int *compressed)
+{
+	struct firmware_section cbfs;
+	size_t name_len = strlen(cbfs_name);
+	uint32_t offset = 0;
+
+	file->data = NULL;
+	file->size = 0;
+	if (find_firmware_section(&cbfs, image, section_name))
+		return -1;
+
+	while (offset + CBFS_FILE_HEADER_SIZE <= cbfs.size) {
+		const uint8_t *header = cbfs.data + offset;
+		uint32_t len, type, attr_offset, data_offset, next;
+
+		if (memcmp(header, CBFS_FILE_MAGIC, strlen(CBFS_FILE_MAGIC))) {
+			offset += CBFS_ALIGNMENT;
+			continue;
+		}
+		len = read_be32(header + 8);
+		type = read_be32(header + 12);
+		attr_offset = read_be32(header + 16);
+		data_offset = read_be32(header + 20);
+		if (data_offset < CBFS_FILE_HEADER_SIZE ||
+		    data_offset > cbfs.size - offset ||
+		    len > cbfs.size - offset - data_offset) {
+			VB2_DEBUG("Corrupted CBFS file header at %s+%#x.\n",
+				  section_name, offset);
+			return -1;
+		}
+
+		if (type != CBFS_TYPE_DELETED && type != CBFS_TYPE_NULL &&
+		    data_offset - CBFS_FILE_HEADER_SIZE > name_len &&
+		    !memcmp(header + CBFS_FILE_HEADER_SIZE, cbfs_name,
+			    name_len + 1)) {
+			file->data = (uint8_t *)header + data_offset;
+			file->size = len;
+			if (compressed)
+				*compressed = cbfs_attr_compressed(
+						header, attr_offset,
+						data_offset);
+			return 0;
+		}
+
+		next = offset + data_offset + len;
+		offset = (next + CBFS_ALIGNMENT - 1) / CBFS_ALIGNMENT *
+			 CBFS_ALIGNMENT;
+	}
+	return -1;
+}
+
 /*
  * Returns 1 if a given file (cbfs_entry_name) exists inside a particular CBFS
- * section of an image file, otherwise 0.
+ * section of a loaded firmware image, otherwise 0.
  */
-int cbfs_file_exists(const char *image_file,
+int cbfs_file_exists(const struct firmware_image *image,
 		     const char *section_name,
 		     const char *cbfs_entry_name)
 {
-	char *cmd;
-	int r;
+	struct firmware_section file;
 
-	ASPRINTF(&cmd,
-		 "cbfstool '%s' print -r %s 2>/dev/null | grep -q '^%s '",
-		 image_file, section_name, cbfs_entry_name);
-	r = system(cmd);
-	free(cmd);
-	return !r;
+	return !cbfs_find_file(&file, image, section_name, cbfs_entry_name,
+			       NULL);
 }
 
 /*
@@ -188,6 +277,11 @@ int load_firmware_image(struct firmware_image *image, const char *file_name,
 		ERROR("Invalid image file (missing FMAP): %s\n", file_name);
 		return -1;
 	}
+	if (fmap_index_init(&image->fmap_index, image->data, image->size,
+			    image->fmap_header)) {
+		ERROR("Failed to index FMAP: %s\n", file_name);
+		return -1;
+	}
 
 	if (!firmware_section_exists(image, FMAP_RO_FRID)) {
 		ERROR("Does not look like VBoot firmware image: %s\n",
@@ -247,6 +341,7 @@ void free_firmware_image(struct firmware_image *image)
 	free(image->ro_version);
 	free(image->rw_version_a);
 	free(image->rw_version_b);
+	fmap_index_free(&image->fmap_index);
 	memset(image, 0, sizeof(*image));
 	image->programmer = programmer;
 }
@@ -265,9 +360,13 @@ int find_firmware_section(struct firmware_section *section,
 
 	section->data = NULL;
 	section->size = 0;
-	ptr = fmap_find_by_name(
-			image->data, image->size, image->fmap_header,
-			section_name, &fah);
+	if (image->fmap_index.areas)
+		ptr = fmap_index_find(&image->fmap_index, image->data,
+				      section_name, &fah);
+	else
+		ptr = fmap_find_by_name(
+				image->data, image->size, image->fmap_header,
+				section_name, &fah);
 	if (!ptr)
 		return -1;
 	section->data = (uint8_t *)ptr;
@@ -299,6 +398,7 @@ int preserve_firmware_section(const struct firmware_image *image_from,
 			      const char *section_name)
 {
 	struct firmware_section from, to;
+	uint8_t *fmap_start, *fmap_end;
 
 	find_firmware_section(&from, image_from, section_name);
 	find_firmware_section(&to, image_to, section_name);
@@ -311,8 +411,23 @@ int preserve_firmware_section(const struct firmware_image *image_from,
 		WARN("Section %.*s is truncated after updated.\n",
 		     FMAP_NAMELEN, section_name);
 	}
+	fmap_start = (uint8_t *)image_to->fmap_header;
+	fmap_end = fmap_start + sizeof(FmapHeader) +
+		   image_to->fmap_header->fmap_nareas * sizeof(FmapAreaHeader);
+
 	/* Use memmove in case if we need to deal with sections that overlap. */
 	memmove(to.data, from.data, VB2_MIN(from.size, to.size));
+
+	/* If that overwrote the FMAP, what we knew about it is stale */
+	if (fmap_start < to.data + to.size && fmap_end > to.data) {
+		fmap_index_free(&image_to->fmap_index);
+		image_to->fmap_header = fmap_find(image_to->data,
+						  image_to->size);
+		if (image_to->fmap_header)
+			fmap_index_init(&image_to->fmap_index, image_to->data,
+					image_to->size,
+					image_to->fmap_header);
+	}
 	return 0;
 }
 
@@ -344,22 +459,29 @@ char *host_shell(const char *command)
 	/* Currently all commands we use do not have large output. */
 	char buf[COMMAND_BUFFER_SIZE];
 
+	const char *const argv[] = {"/bin/sh", "-c", command, NULL};
+	struct subprocess_target output = {
+		.type = TARGET_BUFFER_NULL_TERMINATED,
+		.buffer = {
+			.buf = buf,
+			.size = sizeof(buf),
+		},
+	};
+	char *eol;
 	int result;
-	FILE *fp = popen(command, "r");
 
 	VB2_DEBUG("%s\n", command);
 	buf[0] = '\0';
-	if (!fp) {
-		VB2_DEBUG("Execution error for %s.\n", command);
-		return strdup(buf);
-	}
-
-	if (fgets(buf, sizeof(buf), fp))
-		strip_string(buf, NULL);
-	result = pclose(fp);
-	if (!WIFEXITED(result) || WEXITSTATUS(result) != 0) {
+	result = subprocess_run(argv, NULL, &output, NULL);
+
+	/* Only the first line is the result. */
+	eol = strchr(buf, '\n');
+	if (eol)
+		eol[1] = '\0';
+	strip_string(buf, NULL);
+	if (result != 0) {
 		VB2_DEBUG("Execution failure with exit code %d: %s\n",
-			  WEXITSTATUS(result), command);
+			  result, command);
 		/*
 		 * Discard all output if command failed, for example command
 		 * syntax failure may lead to garbage in stdout.
@@ -370,37 +492,50 @@ char *host_shell(const char *command)
 }
 
 
-/* An helper function to return "mainfw_act" system property.  */
-static int host_get_mainfw_act(void)
+/*
+ * Returns the system properties that crossystem can read, all read on first
+ * use so the shared data is only parsed once.
+ */
+static const VbSystemSnapshot *host_get_snapshot(void)
 {
-	char buf[VB_MAX_STRING_PROPERTY];
+	static VbSystemSnapshot snapshot;
+	static int initialized;
 
-	if (!VbGetSystemPropertyString("mainfw_act", buf, sizeof(buf)))
-		return SLOT_UNKNOWN;
+	if (!initialized) {
+		initialized = 1;
+		if (VbGetSystemSnapshot(&snapshot))
+			VB2_DEBUG("Can't read vboot shared data.\n");
+	}
+	return &snapshot;
+}
 
-	if (strcmp(buf, FWACT_A) == 0)
+/* A helper function to return the "mainfw_act" system property. */
+static int host_get_mainfw_act(void)
+{
+	switch (host_get_snapshot()->mainfw_act) {
+	case 0:
 		return SLOT_A;
-	else if (strcmp(buf, FWACT_B) == 0)
+	case 1:
 		return SLOT_B;
-
+	}
 	return SLOT_UNKNOWN;
 }
 
 /* A helper function to return the "tpm_fwver" system property. */
 static int host_get_tpm_fwver(void)
 {
-	return VbGetSystemPropertyInt("tpm_fwver");
+	return host_get_snapshot()->tpm_fwver;
 }
 
 /* A helper function to return the "hardware write protection" status. */
 static int host_get_wp_hw(void)
 {
 	/* wpsw refers to write protection 'switch', not 'software'. */
-	int v = VbGetSystemPropertyInt("wpsw_cur");
+	int v = host_get_snapshot()->wpsw_cur;
 
 	/* wpsw_cur may be not available, especially in recovery mode. */
 	if (v < 0)
-		v = VbGetSystemPropertyInt("wpsw_boot");
+		v = host_get_snapshot()->wpsw_boot;
 
 	return v;
 }
@@ -408,14 +543,24 @@ static int host_get_wp_hw(void)
 /* A helper function to return "fw_vboot2" system property. */
 static int host_get_fw_vboot2(void)
 {
-	return VbGetSystemPropertyInt("fw_vboot2");
+	return host_get_snapshot()->fw_vboot2;
 }
 
-/* A help function to get $(mosys platform version). */
+/*
+ * A help function to get the board revision, as $(mosys platform version).
+ * mosys is only run if it can't be read directly.
+ */
 static int host_get_platform_version(void)
 {
-	char *result = host_shell("mosys platform version");
-	long rev = -1;
+	char *result;
+	long rev = host_get_snapshot()->board_rev;
+
+	if (rev >= 0) {
+		VB2_DEBUG("Board revision is %ld\n", rev);
+		return rev;
+	}
+
+	result = host_shell("mosys platform version");
 
 	/* Result should be 'revN' */
 	if (strncmp(result, STR_REV, strlen(STR_REV)) == 0)
@@ -564,11 +709,32 @@ static int host_flashrom(enum flashrom_ops op, const char *image_path,
 	return r;
 }
 
-/* Helper function to return write protection status via given programmer. */
+/*
+ * Helper function to return write protection status via given programmer.
+ * Each flashrom query probes the chip again, so results are remembered for
+ * the rest of the run; the updater doesn't change write protection.
+ */
 enum wp_state host_get_wp(const char *programmer)
 {
-	return host_flashrom(FLASHROM_WP_STATUS, NULL, programmer, 0, NULL,
-			     NULL);
+	static struct {
+		char *programmer;
+		enum wp_state state;
+	} cache[4];
+	enum wp_state state;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(cache) && cache[i].programmer; i++) {
+		if (!strcmp(cache[i].programmer, programmer))
+			return cache[i].state;
+	}
+
+	state = host_flashrom(FLASHROM_WP_STATUS, NULL, programmer, 0, NULL,
+			      NULL);
+	if (state != WP_ERROR && i < ARRAY_SIZE(cache)) {
+		cache[i].programmer = strdup(programmer);
+		cache[i].state = state;
+	}
+	return state;
 }
 
 /* Helper function to return host software write protection status. */
@@ -577,34 +743,89 @@ static int host_get_wp_sw(void)
 	return host_get_wp(PROG_HOST);
 }
 
+/*
+ * Reads the FMAP of the system firmware into image_path, and then the listed
+ * sections that it has. Returns 0 if success, non-zero if error.
+ */
+static int read_system_sections(const char *image_path,
+				const char *programmer, int verbosity,
+				const char * const *sections)
+{
+	struct firmware_image fmap_image = {0};
+	char *extra, *more;
+	int i, r;
+
+	r = host_flashrom(FLASHROM_READ, image_path, programmer, verbosity,
+			  FMAP_FMAP, NULL);
+	if (r)
+		return r;
+
+	if (vb2_read_file(image_path, &fmap_image.data, &fmap_image.size) !=
+	    VB2_SUCCESS)
+		return -1;
+	fmap_image.fmap_header = fmap_find(fmap_image.data, fmap_image.size);
+	if (!fmap_image.fmap_header) {
+		free(fmap_image.data);
+		return -1;
+	}
+
+	/* Asking flashrom for a section it can't find fails the read. */
+	extra = strdup("");
+	for (i = 0; extra && sections[i]; i++) {
+		if (!firmware_section_exists(&fmap_image, sections[i]))
+			continue;
+		ASPRINTF(&more, "%s -i %s", extra, sections[i]);
+		free(extra);
+		extra = more;
+	}
+	free(fmap_image.data);
+	if (!extra)
+		return -1;
+
+	r = host_flashrom(FLASHROM_READ, image_path, programmer, verbosity,
+			  FMAP_FMAP, extra);
+	free(extra);
+	return r;
+}
+
 /*
  * Loads the active system firmware image (usually from SPI flash chip).
  * Returns 0 if success, non-zero if error.
  */
 int load_system_firmware(struct firmware_image *image,
-			 struct tempfile *tempfiles, int verbosity)
+			 struct tempfile *tempfiles, int verbosity,
+			 const char * const *sections)
 {
-	int r;
+	int r = -1;
 	const char *tmp_path = create_temp_file(tempfiles);
 
 	if (!tmp_path)
 		return -1;
 
-	r = host_flashrom(FLASHROM_READ, tmp_path, image->programmer,
-			  verbosity, NULL, NULL);
+	if (sections) {
+		r = read_system_sections(tmp_path, image->programmer,
+					 verbosity, sections);
+		if (r)
+			WARN("Failed reading some sections, "
+			     "reading the whole flash.\n");
+	}
+	image->partial = !r;
+	if (r)
+		r = host_flashrom(FLASHROM_READ, tmp_path, image->programmer,
+				  verbosity, NULL, NULL);
 	if (!r)
 		r = load_firmware_image(image, tmp_path, NULL);
 	return r;
 }
 
 /*
- * Writes a section from given firmware image to system firmware.
- * If section_name is NULL, write whole image.
+ * Writes sections from given firmware image to system firmware.
+ * If sections is NULL, write whole image.
  * Returns 0 if success, non-zero if error.
  */
 int write_system_firmware(const struct firmware_image *image,
 			  const struct firmware_image *diff_image,
-			  const char *section_name,
+			  const char * const *sections,
 			  struct tempfile *tempfiles,
 			  int verbosity)
 {
@@ -612,8 +833,8 @@ int write_system_firmware(const struct firmware_image *image,
 	const char *tmp_diff = NULL;
 
 	const char *programmer = image->programmer;
-	char *extra = NULL;
-	int r;
+	char *extra, *more;
+	int i, r;
 
 	if (!tmp_path)
 		return -1;
@@ -624,10 +845,67 @@ int write_system_firmware(const struct firmware_image *image,
 		if (!tmp_diff)
 			return -1;
 		ASPRINTF(&extra, "--noverify --diff=%s", tmp_diff);
+	} else {
+		extra = strdup("");
 	}
 
+	/* Programming all sections in one run probes the chip only once. */
+	for (i = 0; extra && sections && sections[i]; i++) {
+		ASPRINTF(&more, "%s -i %s", extra, sections[i]);
+		free(extra);
+		extra = more;
+	}
+	if (!extra)
+		return -1;
+
 	r = host_flashrom(FLASHROM_WRITE, tmp_path, programmer, verbosity,
-			  section_name, extra);
+			  NULL, extra);
+	free(extra);
+	return r;
+}
+
+/*
+ * Writes the given ranges from the firmware image to system firmware, using
+ * a flashrom layout file that names each range as a region.
+ * Returns 0 if success, non-zero if error.
+ */
+int write_system_ranges(const struct firmware_image *image,
+			const struct flash_range *ranges, int count,
+			struct tempfile *tempfiles, int verbosity)
+{
+	const char *tmp_path = get_firmware_image_temp_file(image, tempfiles);
+	const char *layout_path = create_temp_file(tempfiles);
+	char *extra, *more;
+	FILE *fp;
+	int i, r;
+
+	if (!tmp_path || !layout_path)
+		return -1;
+
+	fp = fopen(layout_path, "w");
+	if (!fp) {
+		ERROR("Cannot create layout file %s.\n", layout_path);
+		return -1;
+	}
+	for (i = 0; i < count; i++)
+		fprintf(fp, "%08x:%08x range%d\n", ranges[i].offset,
+			ranges[i].offset + ranges[i].size - 1, i);
+	if (fclose(fp)) {
+		ERROR("Failed writing layout file %s.\n", layout_path);
+		return -1;
+	}
+
+	ASPRINTF(&extra, "-l %s", layout_path);
+	for (i = 0; extra && i < count; i++) {
+		ASPRINTF(&more, "%s -i range%d", extra, i);
+		free(extra);
+		extra = more;
+	}
+	if (!extra)
+		return -1;
+
+	r = host_flashrom(FLASHROM_WRITE, tmp_path, image->programmer,
+			  verbosity, NULL, extra);
 	free(extra);
 	return r;
 }
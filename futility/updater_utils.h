@@ -9,6 +9,7 @@
 #define VBOOT_REFERENCE_FUTILITY_UPDATER_UTILS_H_
 
 #include <stdio.h>
+#include "2sha.h"
 #include "fmap.h"
 
 #define ASPRINTF(strp, ...) do { if (asprintf(strp, __VA_ARGS__) >= 0) break; \
@@ -62,6 +63,15 @@ struct firmware_image {
 	char *file_name;
 	char *ro_version, *rw_version_a, *rw_version_b;
 	FmapHeader *fmap_header;
+	struct fmap_index fmap_index;
+	/* Only some sections were read from the flash */
+	int partial;
+	/* Recent results of verifying keyblocks in the image. */
+	struct keyblock_check {
+		uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+		int result;
+	} keyblock_checks[4];
+	int num_keyblock_checks;
 };
 
 /*
@@ -75,10 +85,14 @@ int load_firmware_image(struct firmware_image *image, const char *file_name,
 
 /*
  * Loads the active system firmware image (usually from SPI flash chip).
+ * If sections is a NULL-terminated list of FMAP section names, only those
+ * (and the FMAP) are read, and image->partial is set. The rest of the image
+ * is then not the flash contents. If that fails, the whole flash is read.
  * Returns 0 if success, non-zero if error.
  */
 int load_system_firmware(struct firmware_image *image,
-			 struct tempfile *tempfiles, int verbosity);
+			 struct tempfile *tempfiles, int verbosity,
+			 const char * const *sections);
 
 /* Frees the allocated resource from a firmware image object. */
 void free_firmware_image(struct firmware_image *image);
@@ -92,16 +106,32 @@ const char *get_firmware_image_temp_file(const struct firmware_image *image,
 					 struct tempfile *tempfiles);
 
 /*
- * Writes a section from given firmware image to system firmware.
- * If section_name is NULL, write whole image.
+ * Writes sections from given firmware image to system firmware, in one
+ * flashrom invocation. If sections is NULL, write whole image; otherwise it is
+ * a NULL-terminated list of FMAP section names.
  * Returns 0 if success, non-zero if error.
  */
 int write_system_firmware(const struct firmware_image *image,
 			  const struct firmware_image *diff_image,
-			  const char *section_name,
+			  const char * const *sections,
 			  struct tempfile *tempfiles,
 			  int verbosity);
 
+/* A range of the flash to write, in bytes from the start of the image. */
+struct flash_range {
+	uint32_t offset;
+	uint32_t size;
+};
+
+/*
+ * Writes only the given ranges of the firmware image to system firmware, in
+ * one flashrom invocation.
+ * Returns 0 if success, non-zero if error.
+ */
+int write_system_ranges(const struct firmware_image *image,
+			const struct flash_range *ranges, int count,
+			struct tempfile *tempfiles, int verbosity);
+
 struct firmware_section {
 	uint8_t *data;
 	size_t size;
@@ -179,12 +209,25 @@ int host_detect_servo(const char **programmer_ptr, int *need_prepare_ptr);
 
 /*
  * Returns 1 if a given file (cbfs_entry_name) exists inside a particular CBFS
- * section of an image file, otherwise 0.
+ * section of a loaded firmware image, otherwise 0.
  */
-int cbfs_file_exists(const char *image_file,
+int cbfs_file_exists(const struct firmware_image *image,
 		     const char *section_name,
 		     const char *cbfs_entry_name);
 
+/*
+ * Finds a file (cbfs_name) in the CBFS of a section of a loaded firmware image.
+ * If successful, return zero and *file points to the file contents inside the
+ * image (not a copy); otherwise failure. If compressed is not NULL, it is set
+ * to whether the contents are compressed, in which case only
+ * cbfs_extract_file() can get the real contents.
+ */
+int cbfs_find_file(struct firmware_section *file,
+		   const struct firmware_image *image,
+		   const char *section_name,
+		   const char *cbfs_name,
+		   int *compressed);
+
 /*
  * Extracts files from a CBFS on given region (section) of image_file.
  * Returns the path to a temporary file on success, otherwise NULL.
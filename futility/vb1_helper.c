@@ -100,29 +100,6 @@ static uint32_t roundup(uint32_t val, uint32_t alignment)
 	return val;
 }
 
-/* Match regexp /\b--\b/ to delimit the start of the kernel commandline. If we
- * don't find one, we'll use the whole thing. */
-static unsigned int find_cmdline_start(uint8_t *buf_ptr, unsigned int max_len)
-{
-	char *input = (char *)buf_ptr;
-	int start = 0;
-	int i;
-	for (i = 0; i < max_len - 1 && input[i]; i++) {
-		if ('-' == input[i] && '-' == input[i + 1]) {
-			if ((i == 0 || ' ' == input[i - 1]) &&
-			    (i + 2 >= max_len || ' ' == input[i + 2])) {
-				/* found "--" with nothing before or after it */
-				start = i + 2;	/* hope for a trailing '\0' */
-				break;
-			}
-		}
-	}
-	while (' ' == input[start])	/* skip leading spaces */
-		start++;
-
-	return start;
-}
-
 /* Offset of kernel command line string from the start of the kernel blob */
 uint64_t kernel_cmd_line_offset(const struct vb2_kernel_preamble *preamble)
 {
@@ -157,82 +134,46 @@ static int KernelSize(uint8_t *kernel_buf,
 	return kernel_size - kernel32_start;
 }
 
-/* This extracts g_kernel_* and g_param_* from a standard vmlinuz file.
- * It returns nonzero on error. */
-static int PickApartVmlinuz(uint8_t *kernel_buf,
-			    uint32_t kernel_size,
-			    enum arch_t arch,
-			    uint64_t kernel_body_load_address)
+/*
+ * Fill in the zeropage params for a standard x86 vmlinuz file, from its header
+ * lh and the size of its 32-bit part.
+ */
+static void FillVmlinuzParams(struct linux_kernel_params *params,
+			      const struct linux_kernel_params *lh,
+			      uint32_t kernel32_size,
+			      uint64_t kernel_body_load_address)
 {
-	uint32_t kernel32_start = 0;
-	uint32_t kernel32_size = kernel_size;
-	struct linux_kernel_params *lh, *params;
+	VB2_DEBUG(" kernel16_start=%#x\n", 0);
+	VB2_DEBUG(" kernel16_size=%#x\n", (lh->setup_sects + 1) << 9);
+
+	/* Copy the original zeropage data from the vmlinuz header into
+	 * params, then tweak a few fields for our purposes */
+	memcpy(&(params->setup_sects), &(lh->setup_sects),
+	       offsetof(struct linux_kernel_params, e820_entries)
+	       - offsetof(struct linux_kernel_params, setup_sects));
+	params->boot_flag = 0;
+	params->ramdisk_image = 0;	/* we don't support initrd */
+	params->ramdisk_size = 0;
+	params->type_of_loader = 0xff;
+	/* We need to point to the kernel commandline arg. On disk, it
+	 * will come right after the 32-bit part of the kernel. */
+	params->cmd_line_ptr = kernel_body_load_address +
+		roundup(kernel32_size, CROS_ALIGN);
+	VB2_DEBUG(" cmdline_addr=%#x\n", params->cmd_line_ptr);
+	VB2_DEBUG(" version=%#x\n", params->version);
+	VB2_DEBUG(" kernel_alignment=%#x\n", params->kernel_alignment);
+	VB2_DEBUG(" relocatable_kernel=%#x\n",
+		  params->relocatable_kernel);
+	/* Add a fake e820 memory map with 2 entries. */
+	params->n_e820_entry = 2;
+	params->e820_entries[0].start_addr = 0x00000000;
+	params->e820_entries[0].segment_size = 0x00001000;
+	params->e820_entries[0].segment_type = E820_TYPE_RAM;
+	params->e820_entries[1].start_addr = 0xfffff000;
+	params->e820_entries[1].segment_size = 0x00001000;
+	params->e820_entries[1].segment_type = E820_TYPE_RESERVED;
 
-	/* Except for x86, the kernel is the kernel. */
-	switch (arch) {
-	case ARCH_X86:
-		/* The first part of the x86 vmlinuz is a header, followed by
-		 * a real-mode boot stub. We only want the 32-bit part. */
-		lh = (struct linux_kernel_params *)kernel_buf;
-		if (lh->header != VMLINUZ_HEADER_SIG) {
-			VB2_DEBUG("Not a linux kernel image\n");
-			break;
-		}
-		kernel32_start = (lh->setup_sects + 1) << 9;
-		if (kernel32_start >= kernel_size) {
-			fprintf(stderr, "Malformed kernel\n");
-			return -1;
-		}
-		kernel32_size = kernel_size - kernel32_start;
-
-		VB2_DEBUG(" kernel16_start=%#x\n", 0);
-		VB2_DEBUG(" kernel16_size=%#x\n", kernel32_start);
-
-		/* Copy the original zeropage data from kernel_buf into
-		 * g_param_data, then tweak a few fields for our purposes */
-		params = (struct linux_kernel_params *)(g_param_data);
-		memcpy(&(params->setup_sects), &(lh->setup_sects),
-		       offsetof(struct linux_kernel_params, e820_entries)
-		       - offsetof(struct linux_kernel_params, setup_sects));
-		params->boot_flag = 0;
-		params->ramdisk_image = 0;	/* we don't support initrd */
-		params->ramdisk_size = 0;
-		params->type_of_loader = 0xff;
-		/* We need to point to the kernel commandline arg. On disk, it
-		 * will come right after the 32-bit part of the kernel. */
-		params->cmd_line_ptr = kernel_body_load_address +
-			roundup(kernel32_size, CROS_ALIGN) +
-			find_cmdline_start(g_config_data, g_config_size);
-		VB2_DEBUG(" cmdline_addr=%#x\n", params->cmd_line_ptr);
-		VB2_DEBUG(" version=%#x\n", params->version);
-		VB2_DEBUG(" kernel_alignment=%#x\n", params->kernel_alignment);
-		VB2_DEBUG(" relocatable_kernel=%#x\n",
-			  params->relocatable_kernel);
-		/* Add a fake e820 memory map with 2 entries. */
-		params->n_e820_entry = 2;
-		params->e820_entries[0].start_addr = 0x00000000;
-		params->e820_entries[0].segment_size = 0x00001000;
-		params->e820_entries[0].segment_type = E820_TYPE_RAM;
-		params->e820_entries[1].start_addr = 0xfffff000;
-		params->e820_entries[1].segment_size = 0x00001000;
-		params->e820_entries[1].segment_type = E820_TYPE_RESERVED;
-		break;
-	default:
-		break;
-	}
-
-	VB2_DEBUG(" kernel32_start=%#x\n", kernel32_start);
 	VB2_DEBUG(" kernel32_size=%#x\n", kernel32_size);
-
-	/* Keep just the 32-bit kernel. */
-	if (kernel32_size) {
-		g_kernel_size = kernel32_size;
-		memcpy(g_kernel_data, kernel_buf + kernel32_start,
-		       g_kernel_size);
-	}
-
-	/* done */
-	return 0;
 }
 
 /* Split a kernel blob into separate g_kernel, g_param, g_config,
@@ -402,29 +343,19 @@ uint8_t *unpack_kernel_partition(uint8_t *kpart_data,
 	return g_kernel_blob_data;
 }
 
-uint8_t *SignKernelBlob(uint8_t *kernel_blob,
-			uint32_t kernel_size,
-			uint32_t padding,
-			int version,
-			uint64_t kernel_body_load_address,
-			struct vb2_keyblock *keyblock,
-			struct vb2_private_key *signpriv_key,
-			uint32_t flags,
-			uint32_t *vblock_size_ptr)
+uint8_t *SignKernelPreamble(const struct vb2_signature *body_sig,
+			    uint32_t padding,
+			    int version,
+			    uint64_t kernel_body_load_address,
+			    struct vb2_keyblock *keyblock,
+			    struct vb2_private_key *signpriv_key,
+			    uint32_t flags,
+			    uint32_t *vblock_size_ptr)
 {
 	/* Make sure the preamble fills up the rest of the required padding */
 	uint32_t min_size = padding > keyblock->keyblock_size
 		? padding - keyblock->keyblock_size : 0;
 
-	/* Sign the kernel data */
-	struct vb2_signature *body_sig = vb2_calculate_signature(kernel_blob,
-								 kernel_size,
-								 signpriv_key);
-	if (!body_sig) {
-		fprintf(stderr, "Error calculating body signature\n");
-		return NULL;
-	}
-
 	/* Create preamble */
 	struct vb2_kernel_preamble *preamble =
 		vb2_create_kernel_preamble(version,
@@ -447,12 +378,65 @@ uint8_t *SignKernelBlob(uint8_t *kernel_blob,
 	memcpy(outbuf, keyblock, keyblock->keyblock_size);
 	memcpy(outbuf + keyblock->keyblock_size,
 	       preamble, preamble->preamble_size);
+	free(preamble);
 
 	if (vblock_size_ptr)
 		*vblock_size_ptr = outsize;
 	return outbuf;
 }
 
+uint8_t *SignKernelBlob(uint8_t *kernel_blob,
+			uint32_t kernel_size,
+			uint32_t padding,
+			int version,
+			uint64_t kernel_body_load_address,
+			struct vb2_keyblock *keyblock,
+			struct vb2_private_key *signpriv_key,
+			uint32_t flags,
+			uint32_t *vblock_size_ptr)
+{
+	/* Sign the kernel data */
+	struct vb2_signature *body_sig = vb2_calculate_signature(kernel_blob,
+								 kernel_size,
+								 signpriv_key);
+	if (!body_sig) {
+		fprintf(stderr, "Error calculating body signature\n");
+		return NULL;
+	}
+
+	uint8_t *vblock = SignKernelPreamble(body_sig, padding, version,
+					     kernel_body_load_address,
+					     keyblock, signpriv_key, flags,
+					     vblock_size_ptr);
+	free(body_sig);
+	return vblock;
+}
+
+uint8_t *SignKernelDigest(const uint8_t *digest,
+			  uint32_t kernel_size,
+			  uint32_t padding,
+			  int version,
+			  uint64_t kernel_body_load_address,
+			  struct vb2_keyblock *keyblock,
+			  struct vb2_private_key *signpriv_key,
+			  uint32_t flags,
+			  uint32_t *vblock_size_ptr)
+{
+	struct vb2_signature *body_sig = vb2_sign_digest(digest, kernel_size,
+							 signpriv_key);
+	if (!body_sig) {
+		fprintf(stderr, "Error calculating body signature\n");
+		return NULL;
+	}
+
+	uint8_t *vblock = SignKernelPreamble(body_sig, padding, version,
+					     kernel_body_load_address,
+					     keyblock, signpriv_key, flags,
+					     vblock_size_ptr);
+	free(body_sig);
+	return vblock;
+}
+
 /* Returns zero on success */
 int WriteSomeParts(const char *outfile,
 		   void *part1_data, uint32_t part1_size,
@@ -644,19 +628,27 @@ done:
 }
 
 
-uint8_t *CreateKernelBlob(uint8_t *vmlinuz_buf, uint32_t vmlinuz_size,
-			  enum arch_t arch, uint64_t kernel_body_load_address,
-			  uint8_t *config_data, uint32_t config_size,
-			  uint8_t *bootloader_data, uint32_t bootloader_size,
-			  uint32_t *blob_size_ptr)
+/*
+ * Work out the layout of the kernel blob for a vmlinuz file, setting the
+ * g_*_size and g_ondisk_* globals. Returns nonzero on error.
+ */
+static int LayoutKernelBlob(uint8_t *vmlinuz_buf, uint32_t vmlinuz_size,
+			    enum arch_t arch, uint64_t kernel_body_load_address,
+			    uint32_t config_size, uint32_t bootloader_size)
 {
 	uint32_t now = 0;
 	int tmp;
 
+	if (config_size > CROS_CONFIG_SIZE) {
+		fprintf(stderr, "Config is too large (> %d bytes)\n",
+			CROS_CONFIG_SIZE);
+		return -1;
+	}
+
 	/* We have all the parts. How much room do we need? */
 	tmp = KernelSize(vmlinuz_buf, vmlinuz_size, arch);
 	if (tmp < 0)
-		return NULL;
+		return -1;
 	g_kernel_size = tmp;
 	g_config_size = CROS_CONFIG_SIZE;
 	g_param_size = CROS_PARAMS_SIZE;
@@ -676,27 +668,18 @@ uint8_t *CreateKernelBlob(uint8_t *vmlinuz_buf, uint32_t vmlinuz_size,
 	g_kernel_blob_size = roundup(g_kernel_blob_size, CROS_ALIGN);
 	VB2_DEBUG("g_kernel_blob_size  %#x\n", g_kernel_blob_size);
 
-	/* Allocate space for the blob. */
-	g_kernel_blob_data = malloc(g_kernel_blob_size);
-	memset(g_kernel_blob_data, 0, g_kernel_blob_size);
-
-	/* Assign the sub-pointers */
-	g_kernel_data = g_kernel_blob_data + now;
 	VB2_DEBUG("g_kernel_size       %#x ofs %#x\n",
 		  g_kernel_size, now);
 	now += roundup(g_kernel_size, CROS_ALIGN);
 
-	g_config_data = g_kernel_blob_data + now;
 	VB2_DEBUG("g_config_size       %#x ofs %#x\n",
 		  g_config_size, now);
 	now += g_config_size;
 
-	g_param_data = g_kernel_blob_data + now;
 	VB2_DEBUG("g_param_size        %#x ofs %#x\n",
 		  g_param_size, now);
 	now += g_param_size;
 
-	g_bootloader_data = g_kernel_blob_data + now;
 	VB2_DEBUG("g_bootloader_size   %#x ofs %#x\n",
 		  g_bootloader_size, now);
 	g_ondisk_bootloader_addr = kernel_body_load_address + now;
@@ -705,7 +688,6 @@ uint8_t *CreateKernelBlob(uint8_t *vmlinuz_buf, uint32_t vmlinuz_size,
 	now += g_bootloader_size;
 
 	if (g_vmlinuz_header_size) {
-		g_vmlinuz_header_data = g_kernel_blob_data + now;
 		VB2_DEBUG("g_vmlinuz_header_size %#x ofs %#x\n",
 			  g_vmlinuz_header_size, now);
 		g_ondisk_vmlinuz_header_addr = kernel_body_load_address + now;
@@ -714,31 +696,170 @@ uint8_t *CreateKernelBlob(uint8_t *vmlinuz_buf, uint32_t vmlinuz_size,
 	}
 
 	VB2_DEBUG("end of kern_blob at kern_blob+%#x\n", now);
+	return 0;
+}
+
+/*
+ * Receives the kernel blob in order, one piece at a time. A NULL data pointer
+ * stands for size bytes of zeros. Returns nonzero on error.
+ */
+typedef int (*kblob_sink_t)(void *arg, const uint8_t *data, uint32_t size);
+
+/*
+ * Pass the kernel blob laid out by LayoutKernelBlob() to sink. The pieces
+ * point into the input buffers, so nothing the size of the kernel is copied.
+ * Returns nonzero on error.
+ */
+static int EmitKernelBlob(uint8_t *vmlinuz_buf, uint32_t vmlinuz_size,
+			  enum arch_t arch, uint64_t kernel_body_load_address,
+			  uint8_t *config_data, uint32_t config_size,
+			  uint8_t *bootloader_data, uint32_t bootloader_size,
+			  kblob_sink_t sink, void *arg)
+{
+	/* The 16-bit part of an x86 vmlinuz is kept as its header */
+	uint32_t kernel32_start = g_vmlinuz_header_size;
+	uint8_t params[CROS_PARAMS_SIZE];
+	uint32_t now;
 
-	/* Copy the kernel and params bits into the correct places */
-	if (0 != PickApartVmlinuz(vmlinuz_buf, vmlinuz_size,
-				  arch, kernel_body_load_address)) {
-		fprintf(stderr, "Error picking apart kernel file.\n");
-		free(g_kernel_blob_data);
-		g_kernel_blob_data = NULL;
+	memset(params, 0, sizeof(params));
+	if (g_vmlinuz_header_size)
+		FillVmlinuzParams((struct linux_kernel_params *)params,
+				  (struct linux_kernel_params *)vmlinuz_buf,
+				  g_kernel_size, kernel_body_load_address);
+
+	now = roundup(g_kernel_size, CROS_ALIGN) + g_config_size +
+		g_param_size + g_bootloader_size + g_vmlinuz_header_size;
+
+	if (sink(arg, vmlinuz_buf + kernel32_start, g_kernel_size) ||
+	    sink(arg, NULL, roundup(g_kernel_size, CROS_ALIGN) -
+		 g_kernel_size) ||
+	    sink(arg, config_data, config_size) ||
+	    sink(arg, NULL, g_config_size - config_size) ||
+	    sink(arg, params, g_param_size) ||
+	    sink(arg, bootloader_data, bootloader_size) ||
+	    sink(arg, NULL, g_bootloader_size - bootloader_size) ||
+	    sink(arg, vmlinuz_buf, g_vmlinuz_header_size) ||
+	    sink(arg, NULL, g_kernel_blob_size - now))
+		return -1;
+
+	return 0;
+}
+
+/* Copies the kernel blob into a buffer */
+static int kblob_copy(void *arg, const uint8_t *data, uint32_t size)
+{
+	uint8_t **dest = arg;
+
+	/* The buffer is already zeroed */
+	if (data)
+		memcpy(*dest, data, size);
+	*dest += size;
+	return 0;
+}
+
+uint8_t *CreateKernelBlob(uint8_t *vmlinuz_buf, uint32_t vmlinuz_size,
+			  enum arch_t arch, uint64_t kernel_body_load_address,
+			  uint8_t *config_data, uint32_t config_size,
+			  uint8_t *bootloader_data, uint32_t bootloader_size,
+			  uint32_t *blob_size_ptr)
+{
+	uint8_t *dest;
+	uint32_t now = 0;
+
+	if (LayoutKernelBlob(vmlinuz_buf, vmlinuz_size, arch,
+			     kernel_body_load_address,
+			     config_size, bootloader_size))
+		return NULL;
+
+	/* Allocate space for the blob. */
+	g_kernel_blob_data = calloc(g_kernel_blob_size, 1);
+	if (!g_kernel_blob_data) {
+		fprintf(stderr, "Unable to allocate kernel blob\n");
 		g_kernel_blob_size = 0;
 		return NULL;
 	}
 
-	/* Copy the other bits too */
-	memcpy(g_config_data, config_data, config_size);
-	memcpy(g_bootloader_data, bootloader_data, bootloader_size);
-	if (g_vmlinuz_header_size) {
-		memcpy(g_vmlinuz_header_data,
-		       vmlinuz_buf,
-		       g_vmlinuz_header_size);
-	}
+	dest = g_kernel_blob_data;
+	EmitKernelBlob(vmlinuz_buf, vmlinuz_size, arch,
+		       kernel_body_load_address, config_data, config_size,
+		       bootloader_data, bootloader_size, kblob_copy, &dest);
+
+	/* Assign the sub-pointers */
+	g_kernel_data = g_kernel_blob_data + now;
+	now += roundup(g_kernel_size, CROS_ALIGN);
+	g_config_data = g_kernel_blob_data + now;
+	now += g_config_size;
+	g_param_data = g_kernel_blob_data + now;
+	now += g_param_size;
+	g_bootloader_data = g_kernel_blob_data + now;
+	now += g_bootloader_size;
+	if (g_vmlinuz_header_size)
+		g_vmlinuz_header_data = g_kernel_blob_data + now;
 
 	if (blob_size_ptr)
 		*blob_size_ptr = g_kernel_blob_size;
 	return g_kernel_blob_data;
 }
 
+struct kblob_stream {
+	FILE *fp;
+	struct vb2_digest_context *dc;
+};
+
+/* Hashes and/or writes the kernel blob */
+static int kblob_stream(void *arg, const uint8_t *data, uint32_t size)
+{
+	static const uint8_t zeros[CROS_ALIGN];
+	struct kblob_stream *stream = arg;
+
+	while (size) {
+		uint32_t len = size;
+
+		if (!data && len > sizeof(zeros))
+			len = sizeof(zeros);
+
+		if (stream->dc && VB2_SUCCESS !=
+		    vb2_digest_extend(stream->dc, data ? data : zeros, len))
+			return -1;
+		if (stream->fp &&
+		    1 != fwrite(data ? data : zeros, len, 1, stream->fp))
+			return -1;
+
+		if (data)
+			data += len;
+		size -= len;
+	}
+	return 0;
+}
+
+int StreamKernelBlob(FILE *fp, struct vb2_digest_context *dc,
+		     uint8_t *vmlinuz_buf, uint32_t vmlinuz_size,
+		     enum arch_t arch, uint64_t kernel_body_load_address,
+		     uint8_t *config_data, uint32_t config_size,
+		     uint8_t *bootloader_data, uint32_t bootloader_size,
+		     uint32_t *blob_size_ptr)
+{
+	struct kblob_stream stream = {
+		.fp = fp,
+		.dc = dc,
+	};
+
+	if (LayoutKernelBlob(vmlinuz_buf, vmlinuz_size, arch,
+			     kernel_body_load_address,
+			     config_size, bootloader_size))
+		return -1;
+
+	if (EmitKernelBlob(vmlinuz_buf, vmlinuz_size, arch,
+			   kernel_body_load_address, config_data, config_size,
+			   bootloader_data, bootloader_size,
+			   kblob_stream, &stream))
+		return -1;
+
+	if (blob_size_ptr)
+		*blob_size_ptr = g_kernel_blob_size;
+	return 0;
+}
+
 enum futil_file_type ft_recognize_vblock1(uint8_t *buf, uint32_t len)
 {
 	uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE]
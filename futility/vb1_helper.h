@@ -5,9 +5,11 @@
 #ifndef VBOOT_REFERENCE_VB1_HELPER_H_
 #define VBOOT_REFERENCE_VB1_HELPER_H_
 
+struct vb2_digest_context;
 struct vb2_kernel_preamble;
 struct vb2_keyblock;
 struct vb2_packed_key;
+struct vb2_signature;
 
 /* Display a public key with variable indentation */
 void show_pubkey(const struct vb2_packed_key *pubkey, const char *sp);
@@ -32,6 +34,51 @@ uint8_t *SignKernelBlob(uint8_t *kernel_blob,
 			uint32_t flags,
 			uint32_t *vblock_size_ptr);
 
+/**
+ * Produce the same kernel blob as CreateKernelBlob(), without holding it in
+ * memory.
+ *
+ * The blob is generated a piece at a time, straight from the input buffers.
+ *
+ * @param fp		File to write the blob to, or NULL
+ * @param dc		Digest context to extend with the blob, or NULL
+ * @param blob_size_ptr	Size of the kernel blob stored here on exit
+ *
+ * The rest of the parameters are as for CreateKernelBlob().
+ *
+ * @return 0 on success, nonzero on error.
+ */
+int StreamKernelBlob(FILE *fp, struct vb2_digest_context *dc,
+		     uint8_t *vmlinuz_buf, uint32_t vmlinuz_size,
+		     enum arch_t arch, uint64_t kernel_body_load_address,
+		     uint8_t *config_data, uint32_t config_size,
+		     uint8_t *bootloader_data, uint32_t bootloader_size,
+		     uint32_t *blob_size_ptr);
+
+/*
+ * Like SignKernelBlob(), but given the body signature to put in the preamble,
+ * such as the one from an existing preamble for the same blob.
+ */
+uint8_t *SignKernelPreamble(const struct vb2_signature *body_sig,
+			    uint32_t padding,
+			    int version,
+			    uint64_t kernel_body_load_address,
+			    struct vb2_keyblock *keyblock,
+			    struct vb2_private_key *signpriv_key,
+			    uint32_t flags,
+			    uint32_t *vblock_size_ptr);
+
+/* Like SignKernelBlob(), but given the digest of the kernel blob. */
+uint8_t *SignKernelDigest(const uint8_t *digest,
+			  uint32_t kernel_size,
+			  uint32_t padding,
+			  int version,
+			  uint64_t kernel_body_load_address,
+			  struct vb2_keyblock *keyblock,
+			  struct vb2_private_key *signpriv_key,
+			  uint32_t flags,
+			  uint32_t *vblock_size_ptr);
+
 int WriteSomeParts(const char *outfile,
 		   void *part1_data, uint32_t part1_size,
 		   void *part2_data, uint32_t part2_size);
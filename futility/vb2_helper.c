@@ -3,7 +3,9 @@
  * found in the LICENSE file.
  */
 
+#include <openssl/ec.h>
 #include <openssl/pem.h>
+#include <unistd.h>
 
 #include "2common.h"
 #include "2id.h"
@@ -17,6 +19,7 @@
 #include "host_common21.h"
 #include "host_key21.h"
 #include "host_misc21.h"
+#include "host_signature21.h"
 #include "openssl_compat.h"
 #include "util_misc.h"
 
@@ -47,6 +50,121 @@ int vb2_lookup_hash_alg(const char *str, enum vb2_hash_algorithm *alg)
 	return 1;
 }
 
+/*
+ * Digest cache entries are named by a cheap fingerprint of the data and hold
+ * the digest followed by a copy of the data itself.  The copy is compared in
+ * full before the digest is trusted, so a fingerprint collision can only
+ * cost a miss, never a signature over the wrong data.
+ */
+static uint64_t digest_cache_fingerprint(const uint8_t *data, uint32_t size)
+{
+	/* 64-bit FNV-1a, a word at a time; it only has to spread names out */
+	uint64_t h = 0xcbf29ce484222325ULL;
+	uint64_t w;
+	uint32_t i;
+
+	for (i = 0; i + sizeof(w) <= size; i += sizeof(w)) {
+		memcpy(&w, data + i, sizeof(w));
+		h = (h ^ w) * 0x100000001b3ULL;
+	}
+	for (; i < size; i++)
+		h = (h ^ data[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+static char *digest_cache_path(const uint8_t *data, uint32_t size,
+			       enum vb2_hash_algorithm hash_alg)
+{
+	char *path;
+
+	if (asprintf(&path, "%s/%s-%08x-%016llx", sign_option.digest_cache,
+		     vb2_get_hash_algorithm_name(hash_alg), size,
+		     (unsigned long long)
+		     digest_cache_fingerprint(data, size)) < 0)
+		return NULL;
+	return path;
+}
+
+static int digest_cache_lookup(const char *path, const uint8_t *data,
+			       uint32_t size, uint8_t *digest,
+			       uint32_t digest_size)
+{
+	uint8_t *entry;
+	uint32_t entry_size;
+	int found = 0;
+
+	if (vb2_read_file(path, &entry, &entry_size))
+		return 0;
+
+	if (entry_size == digest_size + size &&
+	    !memcmp(entry + digest_size, data, size)) {
+		memcpy(digest, entry, digest_size);
+		found = 1;
+	}
+
+	free(entry);
+	return found;
+}
+
+static void digest_cache_store(const char *path, const uint8_t *data,
+			       uint32_t size, const uint8_t *digest,
+			       uint32_t digest_size)
+{
+	uint8_t *entry;
+	char *tmp;
+
+	entry = malloc(digest_size + size);
+	if (!entry)
+		return;
+	memcpy(entry, digest, digest_size);
+	memcpy(entry + digest_size, data, size);
+
+	/* Batch signers may race on the same entry; rename() is atomic */
+	if (asprintf(&tmp, "%s.%d", path, (int)getpid()) >= 0) {
+		if (vb2_write_file(tmp, entry, digest_size + size) ||
+		    rename(tmp, path)) {
+			VB2_DEBUG("Can't save digest to %s\n", path);
+			unlink(tmp);
+		}
+		free(tmp);
+	}
+
+	free(entry);
+}
+
+vb2_error_t vb21_sign_data_cached(struct vb21_signature **sig_ptr,
+				  const uint8_t *data, uint32_t size,
+				  const struct vb2_private_key *key,
+				  const char *desc)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t digest_size = vb2_digest_size(key->hash_alg);
+	char *path;
+	vb2_error_t rv;
+
+	if (!sign_option.digest_cache || !digest_size)
+		return vb21_sign_data(sig_ptr, data, size, key, desc);
+
+	path = digest_cache_path(data, size, key->hash_alg);
+	if (!path)
+		return VB2_SIGN_DATA_DIGEST_SIZE;
+
+	if (digest_cache_lookup(path, data, size, digest, digest_size)) {
+		VB2_DEBUG("Reusing digest from %s\n", path);
+	} else {
+		rv = vb2_digest_buffer(data, size, key->hash_alg,
+				       digest, digest_size);
+		if (rv) {
+			free(path);
+			return rv;
+		}
+		digest_cache_store(path, data, size, digest, digest_size);
+	}
+	free(path);
+
+	return vb21_sign_digest(sig_ptr, digest, size, key, desc);
+}
+
 enum futil_file_type ft_recognize_vb21_key(uint8_t *buf, uint32_t len)
 {
 	struct vb2_public_key pubkey;
@@ -123,7 +241,7 @@ static int vb2_private_key_sha1sum(struct vb2_private_key *key, uint8_t *digest)
 	uint8_t *buf;
 	uint32_t buflen;
 
-	if (vb_keyb_from_rsa(key->rsa_private_key, &buf, &buflen))
+	if (vb_keyb_from_private_key(key, &buf, &buflen))
 		return 0;
 
 	vb2_digest_buffer(buf, buflen, VB2_HASH_SHA1, digest,
@@ -187,18 +305,78 @@ static RSA *rsa_from_buffer(uint8_t *buf, uint32_t len)
 	return rsa_key;
 }
 
+static EC_KEY *ec_from_buffer(uint8_t *buf, uint32_t len)
+{
+	BIO *bp;
+	EC_KEY *ec_key;
+
+	bp = BIO_new_mem_buf(buf, len);
+	if (!bp)
+		return 0;
+
+	ec_key = PEM_read_bio_ECPrivateKey(bp, NULL, NULL, NULL);
+	if (!ec_key) {
+		if (BIO_reset(bp) < 0) {
+			BIO_free(bp);
+			return 0;
+		}
+		ec_key = PEM_read_bio_EC_PUBKEY(bp, NULL, NULL, NULL);
+	}
+
+	BIO_free(bp);
+
+	return ec_key;
+}
+
 enum futil_file_type ft_recognize_pem(uint8_t *buf, uint32_t len)
 {
 	RSA *rsa_key = rsa_from_buffer(buf, len);
+	EC_KEY *ec_key;
 
 	if (rsa_key) {
 		RSA_free(rsa_key);
 		return FILE_TYPE_PEM;
 	}
 
+	ec_key = ec_from_buffer(buf, len);
+	if (ec_key) {
+		EC_KEY_free(ec_key);
+		return FILE_TYPE_PEM;
+	}
+
 	return FILE_TYPE_UNKNOWN;
 }
 
+static int show_ec_pem(const char *name, EC_KEY *ec_key)
+{
+	uint8_t *keyb;
+	uint8_t digest[VB2_SHA1_DIGEST_SIZE];
+	uint32_t keyb_len;
+	int i;
+
+	printf("%s Key file:      %s\n",
+	       EC_KEY_get0_private_key(ec_key) ? "Private" : "Public", name);
+	printf("  Key length:          %d\n",
+	       EC_GROUP_get_degree(EC_KEY_get0_group(ec_key)));
+
+	if (vb_keyb_from_ec(ec_key, &keyb, &keyb_len)) {
+		printf("  Key sha1sum:         <error>");
+		EC_KEY_free(ec_key);
+		return 1;
+	}
+
+	printf("  Key sha1sum:         ");
+	vb2_digest_buffer(keyb, keyb_len, VB2_HASH_SHA1,
+			  digest, sizeof(digest));
+	for (i = 0; i < sizeof(digest); i++)
+		printf("%02x", digest[i]);
+	printf("\n");
+
+	free(keyb);
+	EC_KEY_free(ec_key);
+	return 0;
+}
+
 int ft_show_pem(const char *name, uint8_t *buf, uint32_t len, void *data)
 {
 	RSA *rsa_key;
@@ -210,8 +388,12 @@ int ft_show_pem(const char *name, uint8_t *buf, uint32_t len, void *data)
 
 	/* We're called only after ft_recognize_pem, so this should work. */
 	rsa_key = rsa_from_buffer(buf, len);
-	if (!rsa_key)
-		FATAL("No RSA key found in buffer\n");
+	if (!rsa_key) {
+		EC_KEY *ec_key = ec_from_buffer(buf, len);
+		if (!ec_key)
+			FATAL("No RSA or EC key found in buffer\n");
+		return show_ec_pem(name, ec_key);
+	}
 
 	/* Use to presence of the private exponent to decide if it's public */
 	RSA_get0_key(rsa_key, &rsa_key_n, NULL, &rsa_key_d);
@@ -70,24 +70,121 @@ static int FindEmmcDev(void)
 	return E_FAIL;
 }
 
-static int ReadFdtValue(const char *property, int *value)
+/* A property of the firmware FDT node, read into memory */
+struct FdtProperty {
+	char *name;
+	char *data;		/* Always followed by a terminating nul */
+	size_t size;
+};
+
+static struct FdtProperty *fdt_props;
+static int fdt_prop_count = -1;	/* Not loaded yet */
+
+/* Read a whole FDT property file into a nul-terminated buffer. */
+static int ReadFdtFile(const char *filename, char **block, size_t *size)
+{
+	struct stat file_status;
+	char *data;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return E_FILEOP;
+	if (fstat(fd, &file_status) || !S_ISREG(file_status.st_mode)) {
+		close(fd);
+		return E_FILEOP;
+	}
+
+	data = malloc(file_status.st_size + 1);
+	if (!data) {
+		close(fd);
+		return E_MEM;
+	}
+	if (read(fd, data, file_status.st_size) != file_status.st_size) {
+		close(fd);
+		free(data);
+		return E_FILEOP;
+	}
+	close(fd);
+
+	data[file_status.st_size] = 0;
+	*block = data;
+	*size = file_status.st_size;
+	return 0;
+}
+
+/* Return nonzero for directory entries which may be FDT properties. */
+static int FdtPropertyFilter(const struct dirent *d)
+{
+	return d->d_name[0] != '.' && d->d_type != DT_DIR;
+}
+
+/* Read all the properties of the firmware FDT node, once. Returns the
+ * number of properties. */
+static int LoadFdtNode(void)
 {
+	struct dirent **list;
 	char filename[FNAME_SIZE];
-	FILE *file;
-	int data = 0;
+	int i, max;
+
+	if (fdt_prop_count >= 0)
+		return fdt_prop_count;
+	fdt_prop_count = 0;
+
+	max = scandir(FDT_BASE_PATH, &list, FdtPropertyFilter, alphasort);
+	if (max < 0)
+		return 0;
+
+	fdt_props = calloc(max, sizeof(*fdt_props));
+	for (i = 0; fdt_props && i < max; i++) {
+		struct FdtProperty *prop = fdt_props + fdt_prop_count;
+
+		snprintf(filename, sizeof(filename), FDT_BASE_PATH "/%s",
+			 list[i]->d_name);
+		if (ReadFdtFile(filename, &prop->data, &prop->size))
+			continue;
+		prop->name = strdup(list[i]->d_name);
+		if (prop->name)
+			fdt_prop_count++;
+		else
+			free(prop->data);
+	}
 
-	snprintf(filename, sizeof(filename), FDT_BASE_PATH "/%s", property);
-	file = fopen(filename, "rb");
-	if (!file) {
+	for (i = 0; i < max; i++)
+		free(list[i]);
+	free(list);
+
+	return fdt_prop_count;
+}
+
+/* Find a property of the firmware FDT node, or NULL if it doesn't exist. */
+static const struct FdtProperty *FindFdtProperty(const char *property)
+{
+	int count = LoadFdtNode();
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!strcmp(fdt_props[i].name, property))
+			return &fdt_props[i];
+	}
+	return NULL;
+}
+
+static int ReadFdtValue(const char *property, int *value)
+{
+	const struct FdtProperty *prop = FindFdtProperty(property);
+	int data;
+
+	if (!prop) {
 		fprintf(stderr, "Unable to open FDT property %s\n", property);
 		return E_FILEOP;
 	}
 
-	if (fread(&data, 1, sizeof(data), file) != sizeof(data)) {
+	if (prop->size < sizeof(data)) {
 		fprintf(stderr, "Unable to read FDT property %s\n", property);
 		return E_FILEOP;
 	}
-	fclose(file);
+	memcpy(&data, prop->data, sizeof(data));
 
 	if (value)
 		*value = ntohl(data); /* FDT is network byte order */
@@ -103,21 +200,15 @@ static int ReadFdtInt(const char *property)
 	return value;
 }
 
-static void GetFdtPropertyPath(const char *property, char *path, size_t size)
-{
-	if (property[0] == '/')
-		StrCopy(path, property, size);
-	else
-		snprintf(path, size, FDT_BASE_PATH "/%s", property);
-}
-
 static int FdtPropertyExist(const char *property)
 {
-	char filename[FNAME_SIZE];
 	struct stat file_status;
 
-	GetFdtPropertyPath(property, filename, sizeof(filename));
-	if (!stat(filename, &file_status))
+	/* Properties outside the firmware node aren't loaded. */
+	if (property[0] != '/')
+		return FindFdtProperty(property) != NULL;
+
+	if (!stat(property, &file_status))
 		return 1; // It exists!
 	else
 		return 0; // It does not exist or some error happened.
@@ -125,40 +216,36 @@ static int FdtPropertyExist(const char *property)
 
 static int ReadFdtBlock(const char *property, void **block, size_t *size)
 {
-	char filename[FNAME_SIZE];
-	FILE *file;
-	size_t property_size;
+	const struct FdtProperty *prop;
 	char *data;
+	size_t property_size;
+	int rv;
 
 	if (!block)
 		return E_FAIL;
 
-	GetFdtPropertyPath(property, filename, sizeof(filename));
-	file = fopen(filename, "rb");
-	if (!file) {
-		fprintf(stderr, "Unable to open FDT property %s\n", property);
-		return E_FILEOP;
-	}
-
-	fseek(file, 0, SEEK_END);
-	property_size = ftell(file);
-	rewind(file);
-
-	data = malloc(property_size +1);
-	if (!data) {
-		fclose(file);
-		return E_MEM;
-	}
-	data[property_size] = 0;
-
-	if (1 != fread(data, property_size, 1, file)) {
-		fprintf(stderr, "Unable to read from property %s\n", property);
-		fclose(file);
-		free(data);
-		return E_FILEOP;
+	if (property[0] == '/') {
+		rv = ReadFdtFile(property, &data, &property_size);
+		if (rv == E_FILEOP)
+			fprintf(stderr, "Unable to read from property %s\n",
+				property);
+		if (rv)
+			return rv;
+	} else {
+		prop = FindFdtProperty(property);
+		if (!prop) {
+			fprintf(stderr, "Unable to open FDT property %s\n",
+				property);
+			return E_FILEOP;
+		}
+		/* Callers own the block, so hand out a copy. */
+		property_size = prop->size;
+		data = malloc(property_size + 1);
+		if (!data)
+			return E_MEM;
+		memcpy(data, prop->data, property_size + 1);
 	}
 
-	fclose(file);
 	*block = data;
 	if (size)
 		*size = property_size;
@@ -219,25 +306,25 @@ static int gpioline_read_value(int chip_fd, int idx, bool active_low)
 	return data.values[0];
 }
 
-/* Return 1 if @idx line matches name; 0 if no match; negative if error. */
-static int gpioline_name_match(int chip_fd, int idx, const char *name)
-{
-	struct gpioline_info info = {
-		.line_offset = idx,
-	};
-	int ret;
+/* A named line on one of the /dev/gpiochip* controllers */
+struct gpiod_line {
+	char name[sizeof(((struct gpioline_info *)0)->name)];
+	char chip[30];		/* Path of the chip's device node */
+	int offset;		/* Line offset within the chip */
+};
 
-	ret = ioctl(chip_fd, GPIO_GET_LINEINFO_IOCTL, &info);
-	if (ret < 0) {
-		perror("GPIO_GET_LINEINFO_IOCTL");
-		return -1;
-	}
+static struct gpiod_line *gpiod_lines;
+static int gpiod_line_count = -1;	/* Not scanned yet */
 
-	return strncmp(info.name, name, sizeof(info.name)) == 0;
+/* Return nonzero for entries with a 'gpiochip'-prefixed name. */
+static int gpiochip_scan_filter(const struct dirent *d)
+{
+	const char prefix[] = "gpiochip";
+	return !strncmp(prefix, d->d_name, strlen(prefix));
 }
 
-/* Return value of gpio, if found. Negative for error codes. */
-static int gpiochip_read_value(int chip_fd, const char *name, bool active_low)
+/* Add the named lines of the chip at @path to the line index. */
+static void gpiochip_index_lines(int chip_fd, const char *path)
 {
 	struct gpiochip_info info;
 	int i, ret;
@@ -245,70 +332,108 @@ static int gpiochip_read_value(int chip_fd, const char *name, bool active_low)
 	ret = ioctl(chip_fd, GPIO_GET_CHIPINFO_IOCTL, &info);
 	if (ret < 0) {
 		perror("GPIO_GET_CHIPINFO_IOCTL");
-		return -1;
+		return;
 	}
 
 	for (i = 0; i < info.lines; i++) {
-		if (gpioline_name_match(chip_fd, i, name) != 1)
-			continue;
-		return gpioline_read_value(chip_fd, i, active_low);
-	}
+		struct gpioline_info line = {
+			.line_offset = i,
+		};
+		struct gpiod_line *entry;
 
-	return -1;
-}
+		ret = ioctl(chip_fd, GPIO_GET_LINEINFO_IOCTL, &line);
+		if (ret < 0) {
+			perror("GPIO_GET_LINEINFO_IOCTL");
+			return;
+		}
+		if (!line.name[0])
+			continue;
 
-/* Return nonzero for entries with a 'gpiochip'-prefixed name. */
-static int gpiochip_scan_filter(const struct dirent *d)
-{
-	const char prefix[] = "gpiochip";
-	return !strncmp(prefix, d->d_name, strlen(prefix));
+		entry = realloc(gpiod_lines,
+				(gpiod_line_count + 1) * sizeof(*entry));
+		if (!entry)
+			return;
+		gpiod_lines = entry;
+		entry += gpiod_line_count++;
+		memcpy(entry->name, line.name, sizeof(entry->name));
+		entry->name[sizeof(entry->name) - 1] = '\0';
+		snprintf(entry->chip, sizeof(entry->chip), "%s", path);
+		entry->offset = i;
+	}
 }
 
 /*
- * Read a named GPIO via the Linux /dev/gpiochip* API, supported in recent
- * kernels (e.g., ChromeOS kernel 4.14+). This method is preferred over the
- * downstream chromeos_arm driver.
+ * Build the index of named lines on all /dev/gpiochip* controllers. The
+ * chardev API can only look lines up one offset at a time, so this is done
+ * once per process rather than for each GPIO read.
  *
- * Returns -1 for errors (e.g., API not supported, or @name not found); 1 for
- * active; 0 for inactive.
+ * Returns the number of named lines found.
  */
-static int gpiod_read(const char *name, bool active_low)
+static int gpiod_index_lines(void)
 {
 	struct dirent **list;
-	int i, max, ret;
+	int i, max;
 
-	ret = scandir("/dev", &list, gpiochip_scan_filter, alphasort);
-	if (ret < 0) {
+	if (gpiod_line_count >= 0)
+		return gpiod_line_count;
+	gpiod_line_count = 0;
+
+	max = scandir("/dev", &list, gpiochip_scan_filter, alphasort);
+	if (max < 0) {
 		perror("scandir");
-		return -1;
+		return 0;
 	}
-	max = ret;
-	/* No /dev/gpiochip* -- API not supported. */
-	if (!max)
-		return -1;
 
 	for (i = 0; i < max; i++) {
 		char buf[30];
 		int fd;
 
 		snprintf(buf, sizeof(buf), "/dev/%s", list[i]->d_name);
-		ret = open(buf, O_RDWR);
-		if (ret < 0) {
+		fd = open(buf, O_RDWR);
+		if (fd < 0) {
 			perror("open");
 			break;
 		}
-		fd = ret;
-
-		ret = gpiochip_read_value(fd, name, active_low);
+		gpiochip_index_lines(fd, buf);
 		close(fd);
-		if (ret >= 0)
-			break;
 	}
 
 	for (i = 0; i < max; i++)
 		free(list[i]);
 	free(list);
 
+	return gpiod_line_count;
+}
+
+/*
+ * Read a named GPIO via the Linux /dev/gpiochip* API, supported in recent
+ * kernels (e.g., ChromeOS kernel 4.14+). This method is preferred over the
+ * downstream chromeos_arm driver.
+ *
+ * Returns -1 for errors (e.g., API not supported, or @name not found); 1 for
+ * active; 0 for inactive.
+ */
+static int gpiod_read(const char *name, bool active_low)
+{
+	int count = gpiod_index_lines();
+	int i, fd, ret;
+
+	for (i = 0; i < count; i++) {
+		if (!strcmp(gpiod_lines[i].name, name))
+			break;
+	}
+	/* No /dev/gpiochip*, or no line called @name. */
+	if (i == count)
+		return -1;
+
+	fd = open(gpiod_lines[i].chip, O_RDWR);
+	if (fd < 0) {
+		perror("open");
+		return -1;
+	}
+	ret = gpioline_read_value(fd, gpiod_lines[i].offset, active_low);
+	close(fd);
+
 	return ret >= 0 ? ret : -1;
 }
 #else
@@ -433,8 +558,13 @@ int vb2_read_nv_storage(struct vb2_context *ctx)
 	media = ReadFdtString(FDT_NVSTORAGE_TYPE_PROP);
 	if (!strcmp(media, "disk"))
 		return vb2_read_nv_storage_disk(ctx);
-	if (!strcmp(media, "cros-ec") || !strcmp(media, "mkbp") ||
-	    !strcmp(media, "flash"))
+	/* Talk to the EC directly if the kernel lets us; mosys otherwise. */
+	if (!strcmp(media, "cros-ec") || !strcmp(media, "mkbp")) {
+		if (!vb2_read_nv_storage_ec(ctx))
+			return 0;
+		return vb2_read_nv_storage_mosys(ctx);
+	}
+	if (!strcmp(media, "flash"))
 		return vb2_read_nv_storage_mosys(ctx);
 	return -1;
 }
@@ -449,8 +579,12 @@ int vb2_write_nv_storage(struct vb2_context *ctx)
 	media = ReadFdtString(FDT_NVSTORAGE_TYPE_PROP);
 	if (!strcmp(media, "disk"))
 		return vb2_write_nv_storage_disk(ctx);
-	if (!strcmp(media, "cros-ec") || !strcmp(media, "mkbp") ||
-	    !strcmp(media, "flash"))
+	if (!strcmp(media, "cros-ec") || !strcmp(media, "mkbp")) {
+		if (!vb2_write_nv_storage_ec(ctx))
+			return 0;
+		return vb2_write_nv_storage_mosys(ctx);
+	}
+	if (!strcmp(media, "flash"))
 		return vb2_write_nv_storage_mosys(ctx);
 	return -1;
 }
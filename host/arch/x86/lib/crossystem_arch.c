@@ -194,12 +194,9 @@ int vb2_write_nv_storage(struct vb2_context *ctx)
 		return -1;
 
 	/* Also attempt to write using mosys if using vboot2 */
-	VbSharedDataHeader *sh = VbSharedDataRead();
-	if (sh) {
-		if (sh->flags & VBSD_BOOT_FIRMWARE_VBOOT2)
-			vb2_write_nv_storage_mosys(ctx);
-		free(sh);
-	}
+	const VbSharedDataHeader *sh = VbSharedDataSnapshot();
+	if (sh && (sh->flags & VBSD_BOOT_FIRMWARE_VBOOT2))
+		vb2_write_nv_storage_mosys(ctx);
 
 	return 0;
 }
@@ -329,6 +326,12 @@ VbSharedDataHeader* VbSharedDataRead(void)
 	 * Check supported old versions first. */
 	if (1 == sh->struct_version)
 		expect_size = VB_SHARED_DATA_HEADER_SIZE_V1;
+	else if (2 == sh->struct_version)
+		expect_size = VB_SHARED_DATA_HEADER_SIZE_V2;
+	else if (3 == sh->struct_version)
+		expect_size = VB_SHARED_DATA_HEADER_SIZE_V3;
+	else if (4 == sh->struct_version)
+		expect_size = VB_SHARED_DATA_HEADER_SIZE_V4;
 	else {
 		/* There'd better be enough data for the current header size. */
 		expect_size = sizeof(VbSharedDataHeader);
@@ -480,31 +483,77 @@ static vb2_error_t VbGetRecoveryReason(void)
 	}
 }
 
-/* Physical GPIO number <N> may be accessed through /sys/class/gpio/gpio<M>/,
- * but <N> and <M> may differ by some offset <O>. To determine that constant,
- * we look for a directory named /sys/class/gpio/gpiochip<O>/. If there's not
- * exactly one match for that, we're SOL.
- */
-static int FindGpioChipOffset(unsigned *gpio_num, unsigned *offset,
-			      const char *name)
+/* A GPIO controller found under /sys/class/gpio */
+struct GpioChip {
+	unsigned offset;	/* From the gpiochip<O> directory name */
+	char label[128];	/* Contents of its label file, or "" */
+	int has_uid;		/* Whether it has a firmware node uid... */
+	unsigned uid;		/* ...and its value */
+};
+
+static struct GpioChip *gpio_chips;
+static int gpio_chip_count = -1;	/* Not scanned yet */
+
+/* Scan /sys/class/gpio once for the GPIO controllers, which don't change
+ * while we run, so reading several signals doesn't rescan it for each.
+ * Returns the number of controllers found. */
+static int GetGpioChips(void)
 {
 	DIR *dir;
 	struct dirent *ent;
-	int match = 0;
+	char filename[128];
+	unsigned offset;
+
+	if (gpio_chip_count >= 0)
+		return gpio_chip_count;
+	gpio_chip_count = 0;
 
 	dir = opendir(GPIO_BASE_PATH);
-	if (!dir) {
+	if (!dir)
 		return 0;
-	}
 
 	while(0 != (ent = readdir(dir))) {
-		if (1 == sscanf(ent->d_name, "gpiochip%u", offset)) {
-			match++;
-		}
+		struct GpioChip *chip;
+
+		if (1 != sscanf(ent->d_name, "gpiochip%u", &offset))
+			continue;
+		chip = realloc(gpio_chips,
+			       (gpio_chip_count + 1) * sizeof(*chip));
+		if (!chip)
+			break;
+		gpio_chips = chip;
+		chip += gpio_chip_count++;
+		memset(chip, 0, sizeof(*chip));
+		chip->offset = offset;
+
+		snprintf(filename, sizeof(filename), "%s/gpiochip%u/label",
+			 GPIO_BASE_PATH, offset);
+		if (!ReadFileString(chip->label, sizeof(chip->label),
+				    filename))
+			chip->label[0] = '\0';
+		snprintf(filename, sizeof(filename),
+			 "%s/gpiochip%u/device/firmware_node/uid",
+			 GPIO_BASE_PATH, offset);
+		chip->has_uid = ReadFileInt(filename, &chip->uid) >= 0;
 	}
 
 	closedir(dir);
-	return (1 == match);
+	return gpio_chip_count;
+}
+
+/* Physical GPIO number <N> may be accessed through /sys/class/gpio/gpio<M>/,
+ * but <N> and <M> may differ by some offset <O>. To determine that constant,
+ * we look for a directory named /sys/class/gpio/gpiochip<O>/. If there's not
+ * exactly one match for that, we're SOL.
+ */
+static int FindGpioChipOffset(unsigned *gpio_num, unsigned *offset,
+			      const char *name)
+{
+	if (1 != GetGpioChips())
+		return 0;
+
+	*offset = gpio_chips[0].offset;
+	return 1;
 }
 
 /* Physical GPIO number <N> may be accessed through /sys/class/gpio/gpio<M>/,
@@ -515,53 +564,26 @@ static int FindGpioChipOffset(unsigned *gpio_num, unsigned *offset,
 static int FindGpioChipOffsetByLabel(unsigned *gpio_num, unsigned *offset,
 				     const char *name)
 {
-	DIR *dir;
-	struct dirent *ent;
-	char filename[128];
-	char chiplabel[128];
+	int count = GetGpioChips();
 	int match = 0;
-	unsigned controller_offset = 0;
-
-	dir = opendir(GPIO_BASE_PATH);
-	if (!dir) {
-		return 0;
-	}
+	int i;
 
-	while(0 != (ent = readdir(dir))) {
-		if (1 == sscanf(ent->d_name, "gpiochip%u",
-				&controller_offset)) {
-			/*
-			 * Read the file at gpiochip<O>/label to get the
-			 * identifier for this bank of GPIOs.
-			 */
-			snprintf(filename, sizeof(filename),
-				 "%s/gpiochip%u/label",
-				 GPIO_BASE_PATH, controller_offset);
-			if (ReadFileString(chiplabel, sizeof(chiplabel),
-					   filename)) {
-				if (!strncasecmp(chiplabel, name,
-						 strlen(name))) {
-					/*
-					 * Store offset when chip label is
-					 * matched.
-					 */
-					*offset = controller_offset;
-					match++;
-				}
-			}
+	for (i = 0; i < count; i++) {
+		/* The gpiochip<O>/label file identifies this bank of GPIOs. */
+		if (!strncasecmp(gpio_chips[i].label, name, strlen(name))) {
+			/* Store offset when chip label is matched. */
+			*offset = gpio_chips[i].offset;
+			match++;
 		}
 	}
 
-	closedir(dir);
 	return (1 == match);
 }
 
 static int FindGpioChipOffsetByNumber(unsigned *gpio_num, unsigned *offset,
 				      Basemapping *data)
 {
-	DIR *dir;
-	struct dirent *ent;
-	int match = 0;
+	int count, i;
 
 	/* Obtain relative GPIO number.
 	 * The assumption here is the Basemapping
@@ -583,30 +605,16 @@ static int FindGpioChipOffsetByNumber(unsigned *gpio_num, unsigned *offset,
 		return 0;
 	}
 
-	dir = opendir(GPIO_BASE_PATH);
-	if (!dir) {
-		return 0;
-	}
-
-	while(0 != (ent = readdir(dir))) {
-		/* For every gpiochip entry determine uid. */
-		if (1 == sscanf(ent->d_name, "gpiochip%u", offset)) {
-			char uid_file[128];
-			unsigned uid_value;
-			snprintf(uid_file, sizeof(uid_file),
-				 "%s/gpiochip%u/device/firmware_node/uid",
-				 GPIO_BASE_PATH, *offset);
-			if (ReadFileInt(uid_file, &uid_value) < 0)
-				continue;
-			if (data->uid == uid_value) {
-				match++;
-				break;
-			}
+	/* Find the gpiochip entry with that uid. */
+	count = GetGpioChips();
+	for (i = 0; i < count; i++) {
+		if (gpio_chips[i].has_uid && data->uid == gpio_chips[i].uid) {
+			*offset = gpio_chips[i].offset;
+			return 1;
 		}
 	}
 
-	closedir(dir);
-	return (1 == match);
+	return 0;
 }
 
 
@@ -704,6 +712,66 @@ static const struct GpioChipset *FindChipset(const char *name)
 	return NULL;
 }
 
+/* A GPIO described by the firmware in ACPI */
+struct AcpiGpio {
+	unsigned signal_type;	/* GPIO_SIGNAL_TYPE_* */
+	int valid;		/* All the fields below could be read */
+	unsigned active_high;
+	unsigned controller_num;
+	char controller_name[128];
+};
+
+static struct AcpiGpio *acpi_gpios;
+static int acpi_gpio_count = -1;	/* Not read yet */
+
+/* Read the firmware's list of GPIOs once, for all the signals we read.
+ * Returns the number of GPIOs. */
+static int GetAcpiGpios(void)
+{
+	char name[128];
+	unsigned gpio_type;
+	int index;
+
+	if (acpi_gpio_count >= 0)
+		return acpi_gpio_count;
+	acpi_gpio_count = 0;
+
+	for (index = 0; ; index++) {
+		struct AcpiGpio *gpio;
+
+		snprintf(name, sizeof(name), "%s.%d/GPIO.0", ACPI_GPIO_PATH,
+			 index);
+		if (ReadFileInt(name, &gpio_type) < 0)
+			break;
+		gpio = realloc(acpi_gpios, (index + 1) * sizeof(*gpio));
+		if (!gpio)
+			break;
+		acpi_gpios = gpio;
+		gpio += index;
+		memset(gpio, 0, sizeof(*gpio));
+		gpio->signal_type = gpio_type;
+		acpi_gpio_count = index + 1;
+
+		/* Read attributes and controller info for the GPIO */
+		snprintf(name, sizeof(name), "%s.%d/GPIO.1", ACPI_GPIO_PATH,
+			 index);
+		if (ReadFileInt(name, &gpio->active_high) < 0)
+			continue;
+		snprintf(name, sizeof(name), "%s.%d/GPIO.2", ACPI_GPIO_PATH,
+			 index);
+		if (ReadFileInt(name, &gpio->controller_num) < 0)
+			continue;
+		snprintf(name, sizeof(name), "%s.%d/GPIO.3", ACPI_GPIO_PATH,
+			 index);
+		if (!ReadFileString(gpio->controller_name,
+				    sizeof(gpio->controller_name), name))
+			continue;
+		gpio->valid = 1;
+	}
+
+	return acpi_gpio_count;
+}
+
 /* Read a GPIO of the specified signal type (see ACPI GPIO SignalType).
  *
  * Returns 1 if the signal is asserted, 0 if not asserted, or -1 if error. */
@@ -711,40 +779,31 @@ static int ReadGpio(unsigned signal_type)
 {
 	char name[128];
 	int index = 0;
-	unsigned gpio_type;
-	unsigned active_high;
+	int count = GetAcpiGpios();
+	const struct AcpiGpio *gpio;
 	unsigned controller_num;
 	unsigned controller_offset = 0;
-	char controller_name[128];
 	unsigned value;
 	const struct GpioChipset *chipset;
 
-	/* Scan GPIO.* to find a matching signal type */
-	for (index = 0; ; index++) {
-		snprintf(name, sizeof(name), "%s.%d/GPIO.0", ACPI_GPIO_PATH,
-			 index);
-		if (ReadFileInt(name, &gpio_type) < 0)
-			return -1; /* Ran out of GPIOs before finding a match */
-		if (gpio_type == signal_type)
+	/* Find the first GPIO with a matching signal type */
+	for (index = 0; index < count; index++) {
+		if (acpi_gpios[index].signal_type == signal_type)
 			break;
 	}
-
-	/* Read attributes and controller info for the GPIO */
-	snprintf(name, sizeof(name), "%s.%d/GPIO.1", ACPI_GPIO_PATH, index);
-	if (ReadFileInt(name, &active_high) < 0)
-		return -1;
-	snprintf(name, sizeof(name), "%s.%d/GPIO.2", ACPI_GPIO_PATH, index);
-	if (ReadFileInt(name, &controller_num) < 0)
+	if (index == count)
+		return -1; /* Ran out of GPIOs before finding a match */
+	gpio = &acpi_gpios[index];
+	if (!gpio->valid)
 		return -1;
+
+	controller_num = gpio->controller_num;
 	/* Do not attempt to read GPIO that is set to -1 in ACPI */
 	if (controller_num == 0xFFFFFFFF)
 		return -1;
 
 	/* Check for chipsets we recognize. */
-	snprintf(name, sizeof(name), "%s.%d/GPIO.3", ACPI_GPIO_PATH, index);
-	if (!ReadFileString(controller_name, sizeof(controller_name), name))
-		return -1;
-	chipset = FindChipset(controller_name);
+	chipset = FindChipset(gpio->controller_name);
 	if (chipset == NULL)
 		return -1;
 
@@ -777,7 +836,7 @@ static int ReadGpio(unsigned signal_type)
 
 	/* Compare the GPIO value with the active value and return 1 if
 	 * match. */
-	return (value == active_high ? 1 : 0);
+	return (value == gpio->active_high ? 1 : 0);
 }
 
 
@@ -70,6 +70,7 @@ typedef struct CgptShowParams {
 	int single_item;
 	int debug;
 	int num_partitions;
+	int machine;
 } CgptShowParams;
 
 typedef struct CgptRepairParams {
@@ -95,6 +96,9 @@ typedef struct CgptPrioritizeParams {
 	int orig_priority;
 } CgptPrioritizeParams;
 
+/* Most partition data cgpt find reads at a time, to compare with matchbuf */
+#define CGPT_FIND_COMPARE_SIZE (64 * 1024)
+
 struct CgptFindParams;
 typedef void (*CgptFindShowFn)(struct CgptFindParams *params,
 			       const char *filename, int partnum,
@@ -111,7 +115,7 @@ typedef struct CgptFindParams {
 	uint8_t *matchbuf;
 	uint64_t matchlen;
 	uint64_t matchoffset;
-	uint8_t *comparebuf;
+	uint8_t *comparebuf;	/* min(matchlen, CGPT_FIND_COMPARE_SIZE) */
 	Guid unique_guid;
 	Guid type_guid;
 	const char *label;
@@ -45,6 +45,51 @@ int VbSetSystemPropertyInt(const char* name, int value);
  * Returns 0 if success, -1 if error. */
 int VbSetSystemPropertyString(const char* name, const char* value);
 
+/* Makes VbSetSystemPropertyInt() and VbSetSystemPropertyString() change NV
+ * storage only in memory, until VbCommitNvStorage() is called.  The getters
+ * return the pending values in the meantime.  This lets a caller setting
+ * several NV properties write NV storage (and fix its checksum) only once. */
+void VbDeferNvStorageWrites(void);
+
+/* Writes NV storage changes made since VbDeferNvStorageWrites(), if any,
+ * and goes back to writing each change immediately.
+ *
+ * Returns 0 if success, -1 if error. */
+int VbCommitNvStorage(void);
+
+/* System properties read together by VbGetSystemSnapshot().  Each value is
+ * -1 if not available. */
+typedef struct VbSystemSnapshot {
+	int mainfw_act;  /* Active main firmware: 0=A, 1=B, 0xFF=recovery */
+	int tpm_fwver;
+	int fw_vboot2;
+	int wpsw_cur;
+	int wpsw_boot;
+	int board_rev;   /* N from "revN", as "mosys platform version" */
+} VbSystemSnapshot;
+
+/* Reads all the properties in a VbSystemSnapshot, parsing the shared data
+ * only once.  The board revision is read from SMBIOS or the device tree
+ * instead of running mosys.
+ *
+ * Returns 0 if success, -1 if the shared data can't be read (the fields that
+ * don't need it are still filled in). */
+int VbGetSystemSnapshot(VbSystemSnapshot *snap);
+
+/* Where VbWriteSystemCache() saves properties by default.  /run is cleared
+ * on every boot. */
+#define CROSSYSTEM_CACHE_PATH "/run/crossystem.cache"
+
+/* Saves the properties which can't change until the next boot (VbSharedData,
+ * hwid, fwid and so on) to a cache file at [path], or CROSSYSTEM_CACHE_PATH
+ * if [path] is NULL, atomically replacing any old one.  From then on, the
+ * getters in every process read those properties from the cache at
+ * CROSSYSTEM_CACHE_PATH instead of the firmware.  NV storage and switch
+ * positions are never cached.
+ *
+ * Returns 0 if success, -1 if error. */
+int VbWriteSystemCache(const char *path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,6 +14,23 @@ extern "C" {
 
 struct vb2_context;
 
+/**
+ * Attempt to read non-volatile storage from the EC, through /dev/cros_ec.
+ *
+ * Unlike mosys, this handles both 16-byte and 64-byte records, and doesn't
+ * spawn a process.
+ *
+ * Returns 0 if success, non-zero if error.
+ */
+int vb2_read_nv_storage_ec(struct vb2_context *ctx);
+
+/**
+ * Attempt to write non-volatile storage to the EC, through /dev/cros_ec.
+ *
+ * Returns 0 if success, non-zero if error.
+ */
+int vb2_write_nv_storage_ec(struct vb2_context *ctx);
+
 /**
  * Attempt to read non-volatile storage using mosys.
  *
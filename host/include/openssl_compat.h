@@ -10,6 +10,7 @@
 extern "C" {
 #endif  /* __cplusplus */
 
+#include <openssl/ecdsa.h>
 #include <openssl/rsa.h>
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
@@ -25,6 +26,15 @@ static inline void RSA_get0_key(const RSA *rsa, const BIGNUM **n,
 		*d = rsa->d;
 }
 
+static inline void ECDSA_SIG_get0(const ECDSA_SIG *sig, const BIGNUM **r,
+				  const BIGNUM **s)
+{
+	if (r != NULL)
+		*r = sig->r;
+	if (s != NULL)
+		*s = sig->s;
+}
+
 #endif  /* OPENSSL_VERSION_NUMBER < 0x10100000L */
 
 #ifdef __cplusplus
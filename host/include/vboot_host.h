@@ -73,6 +73,16 @@ char *FindKernelConfig(const char *filename,
 int ExtractVmlinuz(void *kpart_data, size_t kpart_size,
 		   void **vmlinuz_out, size_t *vmlinuz_size);
 
+/* Like ExtractVmlinuz(), but reads the kernel partition from |fd| and
+ * verifies it on the way. The body is hashed as it is read straight into the
+ * vmlinuz buffer, so the partition is only read once. The keyblock is checked
+ * against |sign_key|, or only for self-consistency if |sign_key| is NULL.
+ * Nothing is returned unless the body signature matches.
+ */
+struct vb2_packed_key;
+int ExtractVmlinuzVerified(int fd, const struct vb2_packed_key *sign_key,
+			   void **vmlinuz_out, size_t *vmlinuz_size);
+
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
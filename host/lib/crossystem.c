@@ -3,10 +3,16 @@
  * found in the LICENSE file.
  */
 
+#include <fcntl.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "2api.h"
 #include "2common.h"
@@ -25,12 +31,59 @@
 
 #define MOSYS_PATH "/usr/sbin/mosys"
 
+/* EC character device, and the parts of the kernel's cros_ec_dev.h and the
+ * EC's ec_commands.h needed to reach the vboot context through it */
+#define CROS_EC_DEV_PATH "/dev/cros_ec"
+struct cros_ec_command_v2 {
+	uint32_t version;
+	uint32_t command;
+	uint32_t outsize;
+	uint32_t insize;
+	uint32_t result;
+	uint8_t data[0];
+};
+#define CROS_EC_DEV_IOCXCMD_V2 _IOWR(0xEC, 0, struct cros_ec_command_v2)
+#define EC_CMD_VBNV_CONTEXT 0x0017
+#define EC_VER_VBNV_CONTEXT 1
+#define EC_VBNV_CONTEXT_OP_READ 0
+#define EC_VBNV_CONTEXT_OP_WRITE 1
+#define EC_RES_SUCCESS 0
+
+/* Where the board revision is, on x86 and ARM */
+#define SMBIOS_PRODUCT_VERSION_PATH "/sys/class/dmi/id/product_version"
+#define FDT_BOARD_ID_PATH "/proc/device-tree/firmware/coreboot/board-id"
+
+/* Changes on every boot, so tells whether a property cache is stale */
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+#define BOOT_ID_SIZE 40
+
+/* Layout of the file written by VbWriteSystemCache(): this header, whose size
+ * keeps what follows 8-byte aligned, then vdat_size bytes of VbSharedData,
+ * read in place from the mapping, then strings_size bytes of property
+ * names and values, each null-terminated, alternating. */
+#define CROSSYSTEM_CACHE_MAGIC 0x43535943  /* "CYSC" */
+#define CROSSYSTEM_CACHE_VERSION 1
+struct crossystem_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	char boot_id[BOOT_ID_SIZE];
+	uint32_t vdat_size;
+	uint32_t strings_size;
+};
+
+/* String properties fixed until the next boot, which the cache holds */
+static const char *const cached_strings[] = {
+	"arch", "hwid", "fwid", "ro_fwid", "mainfw_act", "mainfw_type",
+};
+
 /* Fields that GetVdatString() can get */
 typedef enum VdatStringField {
 	VDAT_STRING_DEPRECATED_TIMERS = 0,  /* Timer values */
 	VDAT_STRING_LOAD_FIRMWARE_DEBUG,  /* LoadFirmware() debug information */
 	VDAT_STRING_LOAD_KERNEL_DEBUG,    /* LoadKernel() debug information */
-	VDAT_STRING_MAINFW_ACT            /* Active main firmware */
+	VDAT_STRING_MAINFW_ACT,           /* Active main firmware */
+	VDAT_STRING_BOOT_TIMESTAMPS,      /* Boot-phase timestamps */
+	VDAT_STRING_TPM_STATS             /* TPM command latency */
 } VdatStringField;
 
 
@@ -97,64 +150,222 @@ static struct vb2_context *get_fake_context(void)
 	return fake_ctx;
 }
 
-static int vnc_read;
+/*
+ * Values read from the firmware, shared by every property getter so that
+ * printing all the properties reads each source only once per process.
+ */
+static struct {
+	int vdat_read;
+	const VbSharedDataHeader *vdat;	/* NULL if it couldn't be read */
+
+	int nv_read;			/* Cleared when NV storage changes */
+	uint32_t nv_values[VB2_NV_PARAM_COUNT];
+	int nv_loaded;			/* NV storage is in the fake context */
+	int nv_deferred;		/* See VbDeferNvStorageWrites() */
+	int nv_dirty;			/* Deferred writes are pending */
+
+	int build_option_read;
+	VbBuildOption build_option;	/* From the kernel command line */
+
+	int cache_read;
+	int cache_ignored;		/* Set while writing the cache */
+	const struct crossystem_cache_header *cache;	/* Mapped, or NULL */
+	size_t cache_size;
+} snapshot;
+
+/* Read the current boot ID into [boot_id].  Returns 0 if success. */
+static int ReadBootId(char *boot_id)
+{
+	memset(boot_id, 0, BOOT_ID_SIZE);
+	if (!ReadFileString(boot_id, BOOT_ID_SIZE, BOOT_ID_PATH))
+		return -1;
+	boot_id[strcspn(boot_id, "\n")] = '\0';
+	return boot_id[0] ? 0 : -1;
+}
 
-int vb2_get_nv_storage(enum vb2_nv_param param)
+/* Map the property cache, if there's a valid one for this boot. */
+static const struct crossystem_cache_header *GetSystemCache(void)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
-	struct vb2_context *ctx = get_fake_context();
+	const struct crossystem_cache_header *h;
+	char boot_id[BOOT_ID_SIZE];
+	struct stat sb;
+	void *data;
+	int fd;
+
+	if (snapshot.cache_ignored)
+		return NULL;
+	if (snapshot.cache_read)
+		return snapshot.cache;
+	snapshot.cache_read = 1;
+
+	fd = open(CROSSYSTEM_CACHE_PATH, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &sb) || sb.st_size < sizeof(*h)) {
+		close(fd);
+		return NULL;
+	}
+	data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	h = data;
+	if (h->magic != CROSSYSTEM_CACHE_MAGIC ||
+	    h->version != CROSSYSTEM_CACHE_VERSION ||
+	    (uint64_t)h->vdat_size + h->strings_size >
+	    sb.st_size - sizeof(*h) ||
+	    ReadBootId(boot_id) ||
+	    memcmp(boot_id, h->boot_id, sizeof(boot_id))) {
+		munmap(data, sb.st_size);
+		return NULL;
+	}
+
+	snapshot.cache = h;
+	snapshot.cache_size = sb.st_size;
+	return h;
+}
+
+/* Copy the cached value of string property [name], if there is one, into
+ * [dest].  Returns dest, or NULL if not cached. */
+static const char *GetCachedString(const char *name, char *dest, size_t size)
+{
+	const struct crossystem_cache_header *h = GetSystemCache();
+	const char *p, *end;
+
+	if (!h)
+		return NULL;
+
+	p = (const char *)(h + 1) + h->vdat_size;
+	end = p + h->strings_size;
+	while (p < end) {
+		const char *value = p + strnlen(p, end - p) + 1;
+
+		if (value >= end)
+			break;
+		if (!strcasecmp(p, name))
+			return StrCopy(dest, value, size);
+		p = value + strnlen(value, end - value) + 1;
+	}
+	return NULL;
+}
+
+const VbSharedDataHeader *VbSharedDataSnapshot(void)
+{
+	const struct crossystem_cache_header *h;
+
+	/* Shared data is written by the firmware, so never changes. */
+	if (!snapshot.vdat_read) {
+		h = GetSystemCache();
+		if (h && h->vdat_size >= sizeof(VbSharedDataHeader)) {
+			/*
+			 * The cache stays mapped for the life of the process
+			 * and is only ever replaced by rename, so read the
+			 * struct straight out of it.
+			 */
+			snapshot.vdat = (const VbSharedDataHeader *)(h + 1);
+		} else if (h && h->vdat_size) {
+			/* Pad, so old, shorter structs read as zeroes. */
+			VbSharedDataHeader *vdat = calloc(1, sizeof(*vdat));
+			if (vdat)
+				memcpy(vdat, h + 1, h->vdat_size);
+			snapshot.vdat = vdat;
+		}
+		if (!snapshot.vdat)
+			snapshot.vdat = VbSharedDataRead();
+		snapshot.vdat_read = 1;
+	}
+	return snapshot.vdat;
+}
 
+/* Read NV storage into the fake context, unless deferred writes are pending
+ * there.  Returns 0 if success. */
+static int load_nv_storage(struct vb2_context *ctx)
+{
+	const VbSharedDataHeader *sh;
+
+	if (snapshot.nv_deferred && snapshot.nv_loaded)
+		return 0;
+
+	sh = VbSharedDataSnapshot();
 	if (!sh)
 		return -1;
+	if (sh->flags & VBSD_NVDATA_V2)
+		ctx->flags |= VB2_CONTEXT_NVDATA_V2;
+	if (0 != vb2_read_nv_storage(ctx))
+		return -1;
+	vb2_nv_init(ctx);
 
-	/* TODO: locking around NV access */
-	if (!vnc_read) {
-		if (sh && sh->flags & VBSD_NVDATA_V2)
-			ctx->flags |= VB2_CONTEXT_NVDATA_V2;
-		if (0 != vb2_read_nv_storage(ctx)) {
-			free(sh);
+	snapshot.nv_loaded = 1;
+	return 0;
+}
+
+int vb2_get_nv_storage(enum vb2_nv_param param)
+{
+	struct vb2_context *ctx = get_fake_context();
+
+	/*
+	 * TODO: locking around NV access
+	 *
+	 * Decode every param on the first read, so that printing them all
+	 * doesn't reread nvdata for each one.
+	 */
+	if (!snapshot.nv_read) {
+		if (0 != load_nv_storage(ctx))
 			return -1;
-		}
-		vb2_nv_init(ctx);
+		vb2_nv_get_all(ctx, snapshot.nv_values);
 
 		/* TODO: If vnc.raw_changed, attempt to reopen NVRAM for write
 		 * and save the new defaults.  If we're able to, log. */
 
-		vnc_read = 1;
+		snapshot.nv_read = 1;
 	}
 
-	free(sh);
-	return (int)vb2_nv_get(ctx, param);
+	if ((unsigned)param >= VB2_NV_PARAM_COUNT)
+		return 0;
+	return (int)snapshot.nv_values[param];
 }
 
 int vb2_set_nv_storage(enum vb2_nv_param param, int value)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
 	struct vb2_context *ctx = get_fake_context();
 
-	if (!sh)
-		return -1;
-
 	/* TODO: locking around NV access */
-	if (sh && sh->flags & VBSD_NVDATA_V2)
-		ctx->flags |= VB2_CONTEXT_NVDATA_V2;
-	if (0 != vb2_read_nv_storage(ctx)) {
-		free(sh);
+	if (0 != load_nv_storage(ctx))
 		return -1;
-	}
-	vb2_nv_init(ctx);
 	vb2_nv_set(ctx, param, (uint32_t)value);
 
 	if (ctx->flags & VB2_CONTEXT_NVDATA_CHANGED) {
-		vnc_read = 0;
-		if (0 != vb2_write_nv_storage(ctx)) {
-			free(sh);
+		snapshot.nv_read = 0;
+		if (snapshot.nv_deferred)
+			snapshot.nv_dirty = 1;
+		else if (0 != vb2_write_nv_storage(ctx))
 			return -1;
-		}
 	}
 
 	/* Success */
-	free(sh);
+	return 0;
+}
+
+void VbDeferNvStorageWrites(void)
+{
+	snapshot.nv_deferred = 1;
+}
+
+int VbCommitNvStorage(void)
+{
+	struct vb2_context *ctx = get_fake_context();
+	int dirty = snapshot.nv_dirty;
+
+	snapshot.nv_deferred = 0;
+	snapshot.nv_loaded = 0;
+	snapshot.nv_dirty = 0;
+	if (!dirty)
+		return 0;
+
+	if (0 != vb2_write_nv_storage(ctx))
+		return -1;
+	ctx->flags &= ~VB2_CONTEXT_NVDATA_CHANGED;
 	return 0;
 }
 
@@ -180,6 +391,10 @@ static VbBuildOption VbScanBuildOption(void)
 	char buf[4096] = "";
 	char *t, *saveptr;
 	const char *delimiters = " \r\n";
+	VbBuildOption option = VB_BUILD_OPTION_UNKNOWN;
+
+	if (snapshot.build_option_read)
+		return snapshot.build_option;
 
 	f = fopen(KERNEL_CMDLINE_PATH, "r");
 	if (NULL != f) {
@@ -189,13 +404,18 @@ static VbBuildOption VbScanBuildOption(void)
 	}
 	for (t = strtok_r(buf, delimiters, &saveptr); t;
 	     t = strtok_r(NULL, delimiters, &saveptr)) {
-		if (0 == strcmp(t, "cros_debug"))
-			return VB_BUILD_OPTION_DEBUG;
-		else if (0 == strcmp(t, "cros_nodebug"))
-			return VB_BUILD_OPTION_NODEBUG;
+		if (0 == strcmp(t, "cros_debug")) {
+			option = VB_BUILD_OPTION_DEBUG;
+			break;
+		} else if (0 == strcmp(t, "cros_nodebug")) {
+			option = VB_BUILD_OPTION_NODEBUG;
+			break;
+		}
 	}
 
-	return VB_BUILD_OPTION_UNKNOWN;
+	snapshot.build_option = option;
+	snapshot.build_option_read = 1;
+	return option;
 }
 
 /* Determine whether the running OS image was built for debugging.
@@ -326,6 +546,26 @@ static char *GetVdatLoadKernelDebug(char *dest, int size,
 					 shp->flags);
 			if (used > size)
 				goto LoadKernelDebugExit;
+
+			/* Throughput stats were added in version 4 */
+			if (sh->struct_version < 4)
+				continue;
+			const VbSharedDataKernelPartStats *st =
+				&sh->lk_part_stats
+				[call & (VBSD_MAX_KERNEL_CALLS - 1)]
+				[part & (VBSD_MAX_KERNEL_PARTS - 1)];
+
+			used += snprintf(dest + used, size - used,
+					 "    Bytes read=%u\n"
+					 "    Read usec=%u\n"
+					 "    Hash usec=%u\n"
+					 "    Verify usec=%u\n",
+					 st->bytes_read,
+					 st->read_us,
+					 st->hash_us,
+					 st->verify_us);
+			if (used > size)
+				goto LoadKernelDebugExit;
 		}
 	}
 
@@ -338,9 +578,64 @@ LoadKernelDebugExit:
 	return dest;
 }
 
+static char *GetVdatBootTimestamps(char *dest, int size,
+				   const VbSharedDataHeader *sh)
+{
+	int used = 0;
+	int count;
+	int i;
+
+	/* Timestamps were added in version 3 */
+	if (sh->struct_version < 3)
+		return NULL;
+
+	count = sh->timestamp_count;
+	if (count > VBSD_MAX_TIMESTAMPS)
+		count = VBSD_MAX_TIMESTAMPS;
+
+	dest[0] = '\0';
+	for (i = 0; i < count && used < size; i++) {
+		const VbSharedDataTimestamp *ts = sh->timestamps + i;
+
+		used += snprintf(dest + used, size - used, "%s=%u\n",
+				 vb2_timestamp_event_name(ts->event),
+				 ts->time_us);
+	}
+
+	return dest;
+}
+
+static char *GetVdatTpmStats(char *dest, int size,
+			     const VbSharedDataHeader *sh)
+{
+	int used = 0;
+	int count;
+	int i;
+
+	/* TPM stats were added in version 5 */
+	if (sh->struct_version < 5)
+		return NULL;
+
+	count = sh->tpm_stats_count;
+	if (count > VBSD_MAX_TPM_STATS)
+		count = VBSD_MAX_TPM_STATS;
+
+	dest[0] = '\0';
+	for (i = 0; i < count && used < size; i++) {
+		const VbSharedDataTpmStats *st = sh->tpm_stats + i;
+
+		used += snprintf(dest + used, size - used,
+				 "%#x count=%u total_us=%u max_us=%u\n",
+				 st->command, st->count, st->total_us,
+				 st->max_us);
+	}
+
+	return dest;
+}
+
 static char *GetVdatString(char *dest, int size, VdatStringField field)
 {
-	VbSharedDataHeader *sh = VbSharedDataRead();
+	const VbSharedDataHeader *sh = VbSharedDataSnapshot();
 	char *value = dest;
 
 	if (!sh)
@@ -355,6 +650,14 @@ static char *GetVdatString(char *dest, int size, VdatStringField field)
 			value = GetVdatLoadKernelDebug(dest, size, sh);
 			break;
 
+		case VDAT_STRING_BOOT_TIMESTAMPS:
+			value = GetVdatBootTimestamps(dest, size, sh);
+			break;
+
+		case VDAT_STRING_TPM_STATS:
+			value = GetVdatTpmStats(dest, size, sh);
+			break;
+
 		case VDAT_STRING_MAINFW_ACT:
 			switch(sh->firmware_index) {
 				case 0:
@@ -376,13 +679,12 @@ static char *GetVdatString(char *dest, int size, VdatStringField field)
 			break;
 	}
 
-	free(sh);
 	return value;
 }
 
 static int GetVdatInt(VdatIntField field)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	const VbSharedDataHeader *sh = VbSharedDataSnapshot();
 	int value = -1;
 
 	if (!sh)
@@ -438,7 +740,6 @@ static int GetVdatInt(VdatIntField field)
 		}
 	}
 
-	free(sh);
 	return value;
 }
 
@@ -448,6 +749,172 @@ int VbSharedDataVersion(void)
 	return GetVdatInt(VDAT_INT_HEADER_VERSION);
 }
 
+/* Return the board revision, or -1 if not found. */
+static int VbGetBoardRevision(void)
+{
+	char buf[32];
+	uint8_t id[4];
+	FILE *f;
+	int value = -1;
+
+	if (ReadFileString(buf, sizeof(buf), SMBIOS_PRODUCT_VERSION_PATH) &&
+	    !strncmp(buf, "rev", 3) && isdigit(buf[3]))
+		return (int)strtol(buf + 3, NULL, 10);
+
+	/* The device tree property is a big-endian cell. */
+	f = fopen(FDT_BOARD_ID_PATH, "rb");
+	if (!f)
+		return -1;
+	if (fread(id, sizeof(id), 1, f) == 1)
+		value = (id[0] << 24 | id[1] << 16 | id[2] << 8 | id[3]) &
+			0x7fffffff;
+	fclose(f);
+	return value;
+}
+
+int VbGetSystemSnapshot(VbSystemSnapshot *snap)
+{
+	const VbSharedDataHeader *sh;
+	char buf[VB_MAX_STRING_PROPERTY];
+	const char *fw;
+
+	snap->wpsw_cur = VbGetArchPropertyInt("wpsw_cur");
+	snap->board_rev = VbGetBoardRevision();
+
+	/* Architecture-dependent values take precedence, as for the
+	 * individual properties. */
+	fw = VbGetArchPropertyString("mainfw_act", buf, sizeof(buf));
+	snap->mainfw_act = -1;
+	if (fw && !strcmp(fw, "A"))
+		snap->mainfw_act = 0;
+	else if (fw && !strcmp(fw, "B"))
+		snap->mainfw_act = 1;
+	else if (fw && !strcmp(fw, "recovery"))
+		snap->mainfw_act = 0xFF;
+	snap->wpsw_boot = VbGetArchPropertyInt("wpsw_boot");
+
+	sh = VbSharedDataSnapshot();
+	if (!sh) {
+		snap->tpm_fwver = -1;
+		snap->fw_vboot2 = -1;
+		return -1;
+	}
+
+	if (!fw) {
+		switch (sh->firmware_index) {
+			case 0:
+			case 1:
+			case 0xFF:
+				snap->mainfw_act = sh->firmware_index;
+				break;
+		}
+	}
+	snap->tpm_fwver = (int)sh->fw_version_tpm;
+	snap->fw_vboot2 = (sh->flags & VBSD_BOOT_FIRMWARE_VBOOT2 ? 1 : 0);
+	if (-1 == snap->wpsw_boot && sh->struct_version >= 2)
+		snap->wpsw_boot = (sh->flags &
+				   VBSD_BOOT_FIRMWARE_WP_ENABLED ? 1 : 0);
+
+	return 0;
+}
+
+/* Write all of [size] bytes of [buf] to [fd].  Returns 0 if success. */
+static int WriteAll(int fd, const void *buf, size_t size)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while (size) {
+		n = write(fd, p, size);
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+int VbWriteSystemCache(const char *path)
+{
+	struct crossystem_cache_header h = {
+		.magic = CROSSYSTEM_CACHE_MAGIC,
+		.version = CROSSYSTEM_CACHE_VERSION,
+	};
+	char value[VB_MAX_STRING_PROPERTY];
+	VbSharedDataHeader *sh;
+	char *strings = NULL, *tmp_path = NULL;
+	size_t strings_size = 0;
+	int fd = -1, rv = -1;
+	int i;
+
+	if (!path)
+		path = CROSSYSTEM_CACHE_PATH;
+	if (ReadBootId(h.boot_id))
+		return -1;
+
+	/* Read everything from the firmware, not an old cache. */
+	snapshot.cache_ignored = 1;
+
+	sh = VbSharedDataRead();
+	if (sh)
+		h.vdat_size = sh->data_size < sizeof(*sh) ?
+			sh->data_size : sizeof(*sh);
+
+	for (i = 0; i < ARRAY_SIZE(cached_strings); i++) {
+		const char *name = cached_strings[i];
+		size_t name_len = strlen(name) + 1, value_len;
+		char *grown;
+
+		if (!VbGetSystemPropertyString(name, value, sizeof(value)))
+			continue;
+		value_len = strlen(value) + 1;
+		grown = realloc(strings, strings_size + name_len + value_len);
+		if (!grown)
+			goto out;
+		strings = grown;
+		memcpy(strings + strings_size, name, name_len);
+		memcpy(strings + strings_size + name_len, value, value_len);
+		strings_size += name_len + value_len;
+	}
+	h.strings_size = strings_size;
+
+	/* Write a new file and rename it, so readers never see half of it. */
+	if (asprintf(&tmp_path, "%s.XXXXXX", path) < 0) {
+		tmp_path = NULL;
+		goto out;
+	}
+	fd = mkstemp(tmp_path);
+	if (fd < 0)
+		goto out;
+	if (fchmod(fd, 0644) ||
+	    WriteAll(fd, &h, sizeof(h)) ||
+	    (h.vdat_size && WriteAll(fd, sh, h.vdat_size)) ||
+	    (strings_size && WriteAll(fd, strings, strings_size)) ||
+	    fsync(fd) ||
+	    close(fd)) {
+		fd = -1;
+		unlink(tmp_path);
+		goto out;
+	}
+	fd = -1;
+	if (rename(tmp_path, path)) {
+		unlink(tmp_path);
+		goto out;
+	}
+	rv = 0;
+
+ out:
+	if (fd >= 0) {
+		close(fd);
+		unlink(tmp_path);
+	}
+	snapshot.cache_ignored = 0;
+	free(tmp_path);
+	free(strings);
+	free(sh);
+	return rv;
+}
+
 int VbGetSystemPropertyInt(const char *name)
 {
 	int value = -1;
@@ -571,6 +1038,10 @@ int VbGetSystemPropertyInt(const char *name)
 const char *VbGetSystemPropertyString(const char *name, char *dest,
 				      size_t size)
 {
+	/* Values fixed since boot may be in the cache */
+	if (GetCachedString(name, dest, size))
+		return dest;
+
 	/* Check architecture-dependent properties first */
 	if (VbGetArchPropertyString(name, dest, size))
 		return dest;
@@ -591,6 +1062,10 @@ const char *VbGetSystemPropertyString(const char *name, char *dest,
 				     VDAT_STRING_LOAD_FIRMWARE_DEBUG);
 	} else if (!strcasecmp(name, "vdat_lkdebug")) {
 		return GetVdatString(dest, size, VDAT_STRING_LOAD_KERNEL_DEBUG);
+	} else if (!strcasecmp(name, "vdat_timestamps")) {
+		return GetVdatString(dest, size, VDAT_STRING_BOOT_TIMESTAMPS);
+	} else if (!strcasecmp(name, "vdat_tpm_stats")) {
+		return GetVdatString(dest, size, VDAT_STRING_TPM_STATS);
 	} else if (!strcasecmp(name, "fw_try_next")) {
 		return vb2_get_nv_storage(VB2_NV_TRY_NEXT) ? "B" : "A";
 	} else if (!strcasecmp(name, "fw_tried")) {
@@ -756,6 +1231,62 @@ int VbSetSystemPropertyString(const char* name, const char* value)
 	return -1;
 }
 
+/*
+ * Send a vboot context [op] to the EC, with [size] bytes of [block], and
+ * read [size] bytes back into [block] for a read.  The EC takes both 16-byte
+ * (V1) and 64-byte (V2) records.  Returns 0 if success, -1 if error.
+ */
+static int ec_vbnv_context(uint32_t op, uint8_t *block, uint32_t size)
+{
+	struct {
+		struct cros_ec_command_v2 cmd;
+		uint8_t data[sizeof(uint32_t) + VB2_NVDATA_SIZE_V2];
+	} msg;
+	int fd, rv;
+
+	if (size > VB2_NVDATA_SIZE_V2)
+		return -1;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd.version = EC_VER_VBNV_CONTEXT;
+	msg.cmd.command = EC_CMD_VBNV_CONTEXT;
+	/* The parameters are a little-endian op, then the block. */
+	msg.data[0] = op;
+	if (op == EC_VBNV_CONTEXT_OP_WRITE) {
+		memcpy(msg.data + sizeof(uint32_t), block, size);
+		msg.cmd.outsize = sizeof(uint32_t) + size;
+		msg.cmd.insize = 0;
+	} else {
+		msg.cmd.outsize = sizeof(uint32_t);
+		msg.cmd.insize = size;
+	}
+
+	fd = open(CROS_EC_DEV_PATH, O_RDWR);
+	if (fd < 0)
+		return -1;
+	rv = ioctl(fd, CROS_EC_DEV_IOCXCMD_V2, &msg);
+	close(fd);
+	if (rv < 0 || msg.cmd.result != EC_RES_SUCCESS ||
+	    rv < (int)msg.cmd.insize)
+		return -1;
+
+	if (op == EC_VBNV_CONTEXT_OP_READ)
+		memcpy(block, msg.data, size);
+	return 0;
+}
+
+int vb2_read_nv_storage_ec(struct vb2_context *ctx)
+{
+	return ec_vbnv_context(EC_VBNV_CONTEXT_OP_READ, ctx->nvdata,
+			       vb2_nv_get_size(ctx));
+}
+
+int vb2_write_nv_storage_ec(struct vb2_context *ctx)
+{
+	return ec_vbnv_context(EC_VBNV_CONTEXT_OP_WRITE, ctx->nvdata,
+			       vb2_nv_get_size(ctx));
+}
+
 int vb2_read_nv_storage_mosys(struct vb2_context *ctx)
 {
 	/* Reserve extra 32 bytes */
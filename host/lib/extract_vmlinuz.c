@@ -5,11 +5,16 @@
  * Exports a vmlinuz from a kernel partition in memory.
  */
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "2common.h"
+#include "2rsa.h"
+#include "2sha.h"
 #include "2struct.h"
+#include "vb2_common.h"
 #include "vboot_host.h"
 #include "vboot_struct.h"
 
@@ -74,3 +79,145 @@ int ExtractVmlinuz(void *kpart_data, size_t kpart_size,
 
 	return 0;
 }
+
+/* Largest vblock we'll read; the default kernel partition padding */
+#define MAX_VBLOCK_SIZE (64 * 1024)
+
+/* Read exactly |count| bytes, retrying short reads. Returns 0 on success. */
+static int read_fully(int fd, void *buf, size_t count)
+{
+	uint8_t *p = buf;
+
+	while (count) {
+		ssize_t r = read(fd, p, count);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return 1;
+		p += r;
+		count -= r;
+	}
+	return 0;
+}
+
+int ExtractVmlinuzVerified(int fd, const struct vb2_packed_key *sign_key,
+			   void **vmlinuz_out, size_t *vmlinuz_size)
+{
+	struct vb2_keyblock kb_header;
+	struct vb2_kernel_preamble pre_header;
+	struct vb2_keyblock *keyblock;
+	struct vb2_kernel_preamble *preamble;
+	struct vb2_public_key key, data_key;
+	struct vb2_digest_context dc;
+	struct vb2_workbuf wb;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint8_t *workbuf = NULL;
+	uint8_t *vblock = NULL;
+	uint8_t *vmlinuz = NULL;
+	uint8_t *body;
+	uint64_t vmlinuz_header_address = 0;
+	uint32_t vmlinuz_header_size = 0;
+	uint32_t vmlinuz_header_offset;
+	uint32_t kblob_size, done, chunk;
+	int rv = 1;
+
+	workbuf = malloc(VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE);
+	if (!workbuf)
+		return 1;
+	vb2_workbuf_init(&wb, workbuf, VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE);
+
+	/* Read the keyblock and preamble; the body follows right after */
+	if (read_fully(fd, &kb_header, sizeof(kb_header)) ||
+	    kb_header.keyblock_size < sizeof(kb_header) ||
+	    kb_header.keyblock_size > MAX_VBLOCK_SIZE)
+		goto out;
+	vblock = malloc(kb_header.keyblock_size + sizeof(pre_header));
+	if (!vblock)
+		goto out;
+	memcpy(vblock, &kb_header, sizeof(kb_header));
+	if (read_fully(fd, vblock + sizeof(kb_header),
+		       kb_header.keyblock_size - sizeof(kb_header) +
+		       sizeof(pre_header)))
+		goto out;
+	memcpy(&pre_header, vblock + kb_header.keyblock_size,
+	       sizeof(pre_header));
+	if (pre_header.preamble_size < sizeof(pre_header) ||
+	    pre_header.preamble_size > MAX_VBLOCK_SIZE)
+		goto out;
+	uint8_t *grown = realloc(vblock, kb_header.keyblock_size +
+				 pre_header.preamble_size);
+	if (!grown)
+		goto out;
+	vblock = grown;
+	if (read_fully(fd, vblock + kb_header.keyblock_size + sizeof(pre_header),
+		       pre_header.preamble_size - sizeof(pre_header)))
+		goto out;
+
+	keyblock = (struct vb2_keyblock *)vblock;
+	preamble = (struct vb2_kernel_preamble *)
+		(vblock + keyblock->keyblock_size);
+
+	if (sign_key) {
+		if (VB2_SUCCESS != vb2_unpack_key(&key, sign_key) ||
+		    VB2_SUCCESS != vb2_verify_keyblock(keyblock,
+						       keyblock->keyblock_size,
+						       &key, &wb))
+			goto out;
+	} else if (VB2_SUCCESS != vb2_verify_keyblock_hash(
+			   keyblock, keyblock->keyblock_size, &wb)) {
+		goto out;
+	}
+
+	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key) ||
+	    VB2_SUCCESS != vb2_verify_kernel_preamble(preamble,
+						      preamble->preamble_size,
+						      &data_key, &wb))
+		goto out;
+
+	/* The 16-bit header is inside the body, so it is covered too */
+	kblob_size = preamble->body_signature.data_size;
+	vb2_kernel_get_vmlinuz_header(preamble, &vmlinuz_header_address,
+				      &vmlinuz_header_size);
+	if (vmlinuz_header_size &&
+	    vb2_verify_member_inside((void *)preamble->body_load_address,
+				     kblob_size,
+				     (void *)vmlinuz_header_address,
+				     vmlinuz_header_size, 0, 0))
+		goto out;
+	vmlinuz_header_offset = vmlinuz_header_address -
+		preamble->body_load_address;
+
+	vmlinuz = malloc((size_t)vmlinuz_header_size + kblob_size);
+	if (!vmlinuz)
+		goto out;
+	body = vmlinuz + vmlinuz_header_size;
+
+	/* Hash each chunk while it's still in cache */
+	if (VB2_SUCCESS != vb2_digest_init(&dc, data_key.hash_alg))
+		goto out;
+	for (done = 0; done < kblob_size; done += chunk) {
+		chunk = VB2_MIN(kblob_size - done, 64 * 1024);
+		if (read_fully(fd, body + done, chunk) ||
+		    VB2_SUCCESS != vb2_digest_extend(&dc, body + done, chunk))
+			goto out;
+	}
+	if (VB2_SUCCESS != vb2_digest_finalize(&dc, digest,
+					       vb2_digest_size(data_key.hash_alg)) ||
+	    VB2_SUCCESS != vb2_verify_digest(&data_key,
+					     &preamble->body_signature,
+					     digest, &wb))
+		goto out;
+
+	memcpy(vmlinuz, body + vmlinuz_header_offset, vmlinuz_header_size);
+
+	*vmlinuz_out = vmlinuz;
+	*vmlinuz_size = (size_t)vmlinuz_header_size + kblob_size;
+	vmlinuz = NULL;
+	rv = 0;
+
+out:
+	free(vmlinuz);
+	free(vblock);
+	free(workbuf);
+	return rv;
+}
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -20,23 +21,108 @@
 #include "host_common.h"
 #include "signature_digest.h"
 
+/* Amount of data to hash, or read, at a time */
+#define DIGEST_STRIDE (1024 * 1024)
+/* Amount of a file to map at a time, so memory use doesn't grow with it */
+#define DIGEST_WINDOW (64 * 1024 * 1024)
+
+/* Hash [size] bytes of [data] into [ctx], in strides that fit a uint32_t. */
+static void digest_extend_large(struct vb2_digest_context *ctx,
+				const uint8_t *data, size_t size)
+{
+	while (size) {
+		uint32_t len = size < DIGEST_STRIDE ? size : DIGEST_STRIDE;
+
+		vb2_digest_extend(ctx, data, len);
+		data += len;
+		size -= len;
+	}
+}
+
+/*
+ * Hash a regular file of [size] bytes open on [fd] by mapping a window of it
+ * at a time.  Returns how many bytes were hashed, which is less than [size]
+ * if part of the file can't be mapped.
+ */
+static off_t digest_mapped(int fd, off_t size, struct vb2_digest_context *ctx)
+{
+	off_t offset = 0;
+
+	while (offset < size) {
+		size_t len = size - offset < DIGEST_WINDOW ?
+			size - offset : DIGEST_WINDOW;
+		void *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd,
+				  offset);
+
+		if (data == MAP_FAILED)
+			break;
+		madvise(data, len, MADV_SEQUENTIAL);
+		digest_extend_large(ctx, data, len);
+		munmap(data, len);
+		offset += len;
+	}
+	return offset;
+}
+
+/* Hash everything read from [fd]. Returns VB2_SUCCESS, or non-zero error. */
+static vb2_error_t digest_read(int fd, struct vb2_digest_context *ctx)
+{
+	uint8_t *data = malloc(DIGEST_STRIDE);
+	ssize_t len;
+
+	if (!data)
+		return VB2_ERROR_UNKNOWN;
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	while ((len = read(fd, data, DIGEST_STRIDE)) != 0) {
+		if (len < 0) {
+			free(data);
+			return VB2_ERROR_UNKNOWN;
+		}
+		vb2_digest_extend(ctx, data, len);
+	}
+	free(data);
+	return VB2_SUCCESS;
+}
+
 vb2_error_t DigestFile(char *input_file, enum vb2_hash_algorithm alg,
 		       uint8_t *digest, uint32_t digest_size)
 {
-	int input_fd, len;
-	uint8_t data[VB2_SHA1_BLOCK_SIZE];
 	struct vb2_digest_context ctx;
+	struct stat sb;
+	off_t done = 0;
+	vb2_error_t rv;
+	int input_fd;
 
 	if( (input_fd = open(input_file, O_RDONLY)) == -1 ) {
 		fprintf(stderr, "Couldn't open %s\n", input_file);
 		return VB2_ERROR_UNKNOWN;
 	}
-	vb2_digest_init(&ctx, alg);
-	while ((len = read(input_fd, data, sizeof(data))) == sizeof(data))
-		vb2_digest_extend(&ctx, data, len);
-	if (len != -1)
-		vb2_digest_extend(&ctx, data, len);
+
+	rv = vb2_digest_init(&ctx, alg);
+	if (rv) {
+		close(input_fd);
+		return rv;
+	}
+
+	/*
+	 * Big images hash fastest in place; pipes and such, and whatever
+	 * couldn't be mapped, in big reads.  Either way only a bounded part
+	 * of the file is in memory at once.
+	 */
+	if (!fstat(input_fd, &sb) && S_ISREG(sb.st_mode))
+		done = digest_mapped(input_fd, sb.st_size, &ctx);
+	if (!done)
+		rv = digest_read(input_fd, &ctx);
+	else if (done < sb.st_size)
+		rv = lseek(input_fd, done, SEEK_SET) == done ?
+			digest_read(input_fd, &ctx) : VB2_ERROR_UNKNOWN;
 	close(input_fd);
+	if (rv) {
+		fprintf(stderr, "Couldn't read %s\n", input_file);
+		return rv;
+	}
 
 	return vb2_digest_finalize(&ctx, digest, digest_size);
 }
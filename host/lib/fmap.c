@@ -4,6 +4,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
@@ -27,27 +28,56 @@ static int is_fmap(uint8_t *ptr)
 /* Find and point to the FMAP header within the buffer */
 FmapHeader *fmap_find(uint8_t *ptr, size_t size)
 {
-	ssize_t offset, align;
 	ssize_t lim = size - sizeof(FmapHeader);
+	ssize_t offset, align;
+	ssize_t best = -1, best_align = 0;
+	uint8_t *p, *end;
+
+	if (lim < 0)
+		return NULL;
 
-	if (lim >= 0 && is_fmap(ptr))
+	if (is_fmap(ptr))
 		return (FmapHeader *)ptr;
 
-	/* Search large alignments before small ones to find "right" FMAP. */
-	for (align = FMAP_SEARCH_STRIDE; align <= lim; align *= 2);
-	for (; align >= FMAP_SEARCH_STRIDE; align /= 2)
-		for (offset = align; offset <= lim; offset += align * 2)
-			if (is_fmap(ptr + offset))
-				return (FmapHeader *)(ptr + offset);
+	/*
+	 * Search large alignments before small ones to find "right" FMAP:
+	 * prefer the offset with the most trailing zero bits, and the lowest
+	 * of those.  Rather than probing every aligned offset in that order,
+	 * let memmem() find the signatures and rank them.
+	 */
+	p = ptr + 1;
+	end = ptr + lim + FMAP_SIGNATURE_SIZE;
+	while (p < end &&
+	       (p = memmem(p, end - p, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE))) {
+		offset = p - ptr;
+		align = offset & -offset;
+		if (align >= FMAP_SEARCH_STRIDE && align > best_align &&
+		    is_fmap(p)) {
+			best = offset;
+			best_align = align;
+		}
+		p++;
+	}
 
-	return NULL;
+	return best < 0 ? NULL : (FmapHeader *)(ptr + best);
+}
+
+/* Count the area headers of the FMAP which are really in the buffer */
+static int fmap_buffer_areas(uint8_t *ptr, size_t size, FmapHeader *fmap)
+{
+	uint8_t *ah = (uint8_t *)fmap + sizeof(FmapHeader);
+	size_t room = size - (ah - ptr);
+
+	if (fmap->fmap_nareas > room / sizeof(FmapAreaHeader))
+		return room / sizeof(FmapAreaHeader);
+	return fmap->fmap_nareas;
 }
 
 /* Search for an area by name, return pointer to its beginning */
 uint8_t *fmap_find_by_name(uint8_t *ptr, size_t size, FmapHeader *fmap,
 			   const char *name, FmapAreaHeader **ah_ptr)
 {
-	int i;
+	int i, nareas;
 	FmapAreaHeader *ah;
 
 	if (!fmap)
@@ -56,7 +86,8 @@ uint8_t *fmap_find_by_name(uint8_t *ptr, size_t size, FmapHeader *fmap,
 		return NULL;
 
 	ah = (FmapAreaHeader*)((void *)fmap + sizeof(FmapHeader));
-	for (i = 0; i < fmap->fmap_nareas; i++)
+	nareas = fmap_buffer_areas(ptr, size, fmap);
+	for (i = 0; i < nareas; i++)
 		if (!strncmp(ah[i].area_name, name, FMAP_NAMELEN)) {
 			if (ah_ptr)
 				*ah_ptr = ah + i;
@@ -65,3 +96,75 @@ uint8_t *fmap_find_by_name(uint8_t *ptr, size_t size, FmapHeader *fmap,
 
 	return NULL;
 }
+
+static int compare_areas(const void *a, const void *b)
+{
+	const FmapAreaHeader *ah_a = *(const FmapAreaHeader **)a;
+	const FmapAreaHeader *ah_b = *(const FmapAreaHeader **)b;
+	int r = strncmp(ah_a->area_name, ah_b->area_name, FMAP_NAMELEN);
+
+	/* Keep duplicate names in FMAP order, so the first one wins */
+	if (!r)
+		r = ah_a < ah_b ? -1 : ah_a > ah_b;
+	return r;
+}
+
+int fmap_index_init(struct fmap_index *index, uint8_t *ptr, size_t size,
+		    FmapHeader *fmap)
+{
+	FmapAreaHeader *ah;
+	int i;
+
+	memset(index, 0, sizeof(*index));
+
+	if (!fmap)
+		fmap = fmap_find(ptr, size);
+	if (!fmap)
+		return 1;
+
+	/* Only index the areas which are really in the buffer */
+	ah = (FmapAreaHeader *)((uint8_t *)fmap + sizeof(FmapHeader));
+	index->nareas = fmap_buffer_areas(ptr, size, fmap);
+
+	index->areas = malloc(index->nareas * sizeof(*index->areas) + 1);
+	if (!index->areas)
+		return 1;
+	for (i = 0; i < index->nareas; i++)
+		index->areas[i] = ah + i;
+	qsort(index->areas, index->nareas, sizeof(*index->areas),
+	      compare_areas);
+
+	index->fmap = fmap;
+	return 0;
+}
+
+void fmap_index_free(struct fmap_index *index)
+{
+	free(index->areas);
+	memset(index, 0, sizeof(*index));
+}
+
+uint8_t *fmap_index_find(const struct fmap_index *index, uint8_t *ptr,
+			 const char *name, FmapAreaHeader **ah_ptr)
+{
+	int lo = 0, hi = index->nareas;
+
+	/* Find the first area whose name is not less than name */
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (strncmp(index->areas[mid]->area_name, name,
+			    FMAP_NAMELEN) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == index->nareas ||
+	    strncmp(index->areas[lo]->area_name, name, FMAP_NAMELEN))
+		return NULL;
+
+	if (ah_ptr)
+		*ah_ptr = index->areas[lo];
+	return ptr + index->areas[lo]->area_offset;
+}
@@ -15,24 +15,34 @@
 #include "utility.h"
 #include "vb2_common.h"
 
-struct vb2_fw_preamble *vb2_create_fw_preamble(
+uint32_t vb2_fw_preamble_size(const struct vb2_packed_key *kernel_subkey,
+			     const struct vb2_signature *body_signature,
+			     const struct vb2_private_key *signing_key)
+{
+	return sizeof(struct vb2_fw_preamble) + kernel_subkey->key_size +
+		body_signature->sig_size +
+		vb2_rsa_sig_size(signing_key->sig_alg);
+}
+
+vb2_error_t vb2_create_fw_preamble_in(
+	void *buf, uint32_t buf_size,
 	uint32_t firmware_version,
 	const struct vb2_packed_key *kernel_subkey,
 	const struct vb2_signature *body_signature,
 	const struct vb2_private_key *signing_key,
 	uint32_t flags)
 {
+	struct vb2_fw_preamble *h = buf;
 	uint32_t signed_size = (sizeof(struct vb2_fw_preamble) +
 				kernel_subkey->key_size +
 				body_signature->sig_size);
-	uint32_t block_size = signed_size +
-		vb2_rsa_sig_size(signing_key->sig_alg);
+	uint32_t block_size = vb2_fw_preamble_size(kernel_subkey,
+						   body_signature,
+						   signing_key);
 
-	/* Allocate keyblock */
-	struct vb2_fw_preamble *h =
-		(struct vb2_fw_preamble *)calloc(block_size, 1);
-	if (!h)
-		return NULL;
+	if (buf_size < block_size)
+		return VB2_FW_PREAMBLE_CREATE_BUF_SIZE;
+	memset(h, 0, block_size);
 
 	uint8_t *kernel_subkey_dest = (uint8_t *)(h + 1);
 	uint8_t *body_sig_dest = kernel_subkey_dest + kernel_subkey->key_size;
@@ -48,35 +58,71 @@ struct vb2_fw_preamble *vb2_create_fw_preamble(
 	vb2_init_packed_key(&h->kernel_subkey, kernel_subkey_dest,
 			    kernel_subkey->key_size);
 	if (VB2_SUCCESS !=
-	    vb2_copy_packed_key(&h->kernel_subkey, kernel_subkey)) {
-		free(h);
-		return NULL;
-	}
+	    vb2_copy_packed_key(&h->kernel_subkey, kernel_subkey))
+		return VB2_FW_PREAMBLE_CREATE_SUBKEY;
 
 	/* Copy body signature */
 	vb2_init_signature(&h->body_signature,
 			   body_sig_dest, body_signature->sig_size, 0);
 	if (VB2_SUCCESS !=
-	    vb2_copy_signature(&h->body_signature, body_signature)) {
-		free(h);
-		return NULL;
-	}
+	    vb2_copy_signature(&h->body_signature, body_signature))
+		return VB2_FW_PREAMBLE_CREATE_BODY_SIG;
 
 	/* Set up signature struct so we can calculate the signature */
 	vb2_init_signature(&h->preamble_signature, block_sig_dest,
 			   vb2_rsa_sig_size(signing_key->sig_alg), signed_size);
 
 	/* Calculate signature */
-	struct vb2_signature *sig =
-		vb2_calculate_signature((uint8_t *)h, signed_size, signing_key);
-	vb2_copy_signature(&h->preamble_signature, sig);
-	free(sig);
+	if (VB2_SUCCESS != vb2_sign_data_into(&h->preamble_signature,
+					      (uint8_t *)h, signed_size,
+					      signing_key))
+		return VB2_FW_PREAMBLE_CREATE_SIGN;
+
+	return VB2_SUCCESS;
+}
+
+struct vb2_fw_preamble *vb2_create_fw_preamble(
+	uint32_t firmware_version,
+	const struct vb2_packed_key *kernel_subkey,
+	const struct vb2_signature *body_signature,
+	const struct vb2_private_key *signing_key,
+	uint32_t flags)
+{
+	uint32_t block_size = vb2_fw_preamble_size(kernel_subkey,
+						   body_signature,
+						   signing_key);
+
+	/* Allocate preamble */
+	struct vb2_fw_preamble *h =
+		(struct vb2_fw_preamble *)malloc(block_size);
+	if (!h)
+		return NULL;
+
+	if (VB2_SUCCESS != vb2_create_fw_preamble_in(
+			h, block_size, firmware_version, kernel_subkey,
+			body_signature, signing_key, flags)) {
+		free(h);
+		return NULL;
+	}
 
 	/* Return the header */
 	return h;
 }
 
-struct vb2_kernel_preamble *vb2_create_kernel_preamble(
+uint32_t vb2_kernel_preamble_size(const struct vb2_signature *body_signature,
+				  uint32_t desired_size,
+				  const struct vb2_private_key *signing_key)
+{
+	uint32_t block_size = sizeof(struct vb2_kernel_preamble) +
+		body_signature->sig_size +
+		vb2_rsa_sig_size(signing_key->sig_alg);
+
+	/* If the block size is smaller than the desired size, pad it */
+	return block_size < desired_size ? desired_size : block_size;
+}
+
+vb2_error_t vb2_create_kernel_preamble_in(
+	void *buf, uint32_t buf_size,
 	uint32_t kernel_version,
 	uint64_t body_load_address,
 	uint64_t bootloader_address,
@@ -88,20 +134,17 @@ struct vb2_kernel_preamble *vb2_create_kernel_preamble(
 	uint32_t desired_size,
 	const struct vb2_private_key *signing_key)
 {
-	uint64_t signed_size = (sizeof(struct vb2_kernel_preamble) +
+	struct vb2_kernel_preamble *h = buf;
+	uint32_t signed_size = (sizeof(struct vb2_kernel_preamble) +
 				body_signature->sig_size);
 	uint32_t sig_size = vb2_rsa_sig_size(signing_key->sig_alg);
-	uint32_t block_size = signed_size + sig_size;
+	uint32_t block_size = vb2_kernel_preamble_size(body_signature,
+						       desired_size,
+						       signing_key);
 
-	/* If the block size is smaller than the desired size, pad it */
-	if (block_size < desired_size)
-		block_size = desired_size;
-
-	/* Allocate keyblock */
-	struct vb2_kernel_preamble *h =
-		(struct vb2_kernel_preamble *)calloc(block_size, 1);
-	if (!h)
-		return NULL;
+	if (buf_size < block_size)
+		return VB2_KERNEL_PREAMBLE_CREATE_BUF_SIZE;
+	memset(h, 0, block_size);
 
 	uint8_t *body_sig_dest = (uint8_t *)(h + 1);
 	uint8_t *block_sig_dest = body_sig_dest + body_signature->sig_size;
@@ -120,17 +163,53 @@ struct vb2_kernel_preamble *vb2_create_kernel_preamble(
 	/* Copy body signature */
 	vb2_init_signature(&h->body_signature, body_sig_dest,
 			   body_signature->sig_size, 0);
-	vb2_copy_signature(&h->body_signature, body_signature);
+	if (VB2_SUCCESS !=
+	    vb2_copy_signature(&h->body_signature, body_signature))
+		return VB2_KERNEL_PREAMBLE_CREATE_BODY_SIG;
 
 	/* Set up signature struct so we can calculate the signature */
 	vb2_init_signature(&h->preamble_signature, block_sig_dest,
 			   sig_size, signed_size);
 
 	/* Calculate signature */
-	struct vb2_signature *sigtmp =
-		vb2_calculate_signature((uint8_t *)h, signed_size, signing_key);
-	vb2_copy_signature(&h->preamble_signature, sigtmp);
-	free(sigtmp);
+	if (VB2_SUCCESS != vb2_sign_data_into(&h->preamble_signature,
+					      (uint8_t *)h, signed_size,
+					      signing_key))
+		return VB2_KERNEL_PREAMBLE_CREATE_SIGN;
+
+	return VB2_SUCCESS;
+}
+
+struct vb2_kernel_preamble *vb2_create_kernel_preamble(
+	uint32_t kernel_version,
+	uint64_t body_load_address,
+	uint64_t bootloader_address,
+	uint32_t bootloader_size,
+	const struct vb2_signature *body_signature,
+	uint64_t vmlinuz_header_address,
+	uint32_t vmlinuz_header_size,
+	uint32_t flags,
+	uint32_t desired_size,
+	const struct vb2_private_key *signing_key)
+{
+	uint32_t block_size = vb2_kernel_preamble_size(body_signature,
+						       desired_size,
+						       signing_key);
+
+	/* Allocate preamble */
+	struct vb2_kernel_preamble *h =
+		(struct vb2_kernel_preamble *)malloc(block_size);
+	if (!h)
+		return NULL;
+
+	if (VB2_SUCCESS != vb2_create_kernel_preamble_in(
+			h, block_size, kernel_version, body_load_address,
+			bootloader_address, bootloader_size, body_signature,
+			vmlinuz_header_address, vmlinuz_header_size, flags,
+			desired_size, signing_key)) {
+		free(h);
+		return NULL;
+	}
 
 	/* Return the header */
 	return h;
@@ -7,11 +7,15 @@
 
 #include <openssl/pem.h>
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "2common.h"
+#include "2ecdsa.h"
 #include "2rsa.h"
 #include "2sha.h"
 #include "2sysincludes.h"
@@ -19,6 +23,7 @@
 #include "host_key21.h"
 #include "host_key.h"
 #include "host_misc.h"
+#include "host_p11.h"
 #include "vb2_common.h"
 
 enum vb2_crypto_algorithm vb2_get_crypto_algorithm(
@@ -26,7 +31,7 @@ enum vb2_crypto_algorithm vb2_get_crypto_algorithm(
 	enum vb2_signature_algorithm sig_alg)
 {
 	/* Make sure algorithms are in the range supported by crypto alg */
-	if (sig_alg < VB2_SIG_RSA1024 || sig_alg >= VB2_SIG_ALG_COUNT)
+	if (sig_alg < VB2_SIG_RSA1024 || sig_alg > VB2_SIG_RSA3072_EXP3)
 		return VB2_ALG_COUNT;
 	if (hash_alg < VB2_HASH_SHA1 || hash_alg > VB2_HASH_SHA512)
 		return VB2_ALG_COUNT;
@@ -36,39 +41,343 @@ enum vb2_crypto_algorithm vb2_get_crypto_algorithm(
 		+ (hash_alg - VB2_HASH_SHA1);
 };
 
-struct vb2_private_key *vb2_read_private_key(const char *filename)
+/* Parsed RSA keys, shared by every reader of the same key file */
+struct key_cache_entry {
+	char *path;			/* File the key was read from, if any... */
+	struct stat sb;			/* ...and its state at the time */
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];	/* Digest of the file */
+	int pem;			/* Parsed from PEM, rather than .vbprivk */
+	uint64_t alg;			/* Algorithm from the .vbprivk header */
+	struct rsa_st *rsa;		/* The cache's own reference */
+};
+
+#define KEY_CACHE_SIZE 16
+static struct key_cache_entry key_cache[KEY_CACHE_SIZE];
+static uint32_t key_cache_count;
+static pthread_mutex_t key_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Whether [sb] still describes the file that was cached as [entry]. */
+static int same_file_state(const struct key_cache_entry *entry,
+			   const struct stat *sb)
+{
+	if (entry->sb.st_dev != sb->st_dev || entry->sb.st_ino != sb->st_ino ||
+	    entry->sb.st_size != sb->st_size)
+		return 0;
+#ifdef HAVE_MACOS
+	return !memcmp(&entry->sb.st_mtimespec, &sb->st_mtimespec,
+		       sizeof(sb->st_mtimespec));
+#else
+	return !memcmp(&entry->sb.st_mtim, &sb->st_mtim, sizeof(sb->st_mtim));
+#endif
+}
+
+static int bn_missing(const BIGNUM *bn)
 {
-	uint8_t *buf = NULL;
-	uint32_t bufsize = 0;
-	if (VB2_SUCCESS != vb2_read_file(filename, &buf, &bufsize)) {
+	return !bn || BN_is_zero(bn);
+}
+
+/*
+ * Find the factors [p] and [q] of the modulus of [rsa] from its exponents.
+ * Since e * d - 1 is a multiple of lcm(p-1, q-1), some square root of 1 mod
+ * n other than +/-1 turns up quickly among g^(k / 2^i) for small g, and
+ * shares a factor with n.  Returns 0 on success.
+ */
+static int rsa_recover_factors(const BIGNUM *n, const BIGNUM *e,
+			       const BIGNUM *d, BIGNUM *p, BIGNUM *q,
+			       BN_CTX *ctx)
+{
+	BIGNUM *k = BN_CTX_get(ctx);
+	BIGNUM *n1 = BN_CTX_get(ctx);
+	BIGNUM *g = BN_CTX_get(ctx);
+	BIGNUM *y = BN_CTX_get(ctx);
+	BIGNUM *x = BN_CTX_get(ctx);
+	int t, i, tries;
+
+	if (!x || !BN_mul(k, e, d, ctx) || !BN_sub_word(k, 1) ||
+	    BN_is_zero(k) || !BN_copy(n1, n) || !BN_sub_word(n1, 1))
+		return -1;
+
+	/* k = 2^t * r, with r odd */
+	for (t = 0; !BN_is_odd(k); t++)
+		if (!BN_rshift1(k, k))
+			return -1;
+	if (!t)
+		return -1;
+
+	for (tries = 2; tries < 100; tries++) {
+		if (!BN_set_word(g, tries) || !BN_mod_exp(y, g, k, n, ctx))
+			return -1;
+		if (BN_is_one(y) || !BN_cmp(y, n1))
+			continue;
+
+		for (i = 1; i <= t; i++) {
+			if (!BN_mod_sqr(x, y, n, ctx))
+				return -1;
+			if (BN_is_one(x)) {
+				/* y is a non-trivial square root of 1 */
+				if (!BN_sub_word(y, 1) ||
+				    !BN_gcd(p, y, n, ctx) ||
+				    !BN_div(q, NULL, n, p, ctx))
+					return -1;
+				return 0;
+			}
+			if (!BN_cmp(x, n1))
+				break;
+			if (!BN_copy(y, x))
+				return -1;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Fill in any missing CRT parameters of [rsa], recovering the prime factors
+ * too if need be.  Without them, OpenSSL signs several times slower.
+ * Returns 0 on success, or if there was nothing to do.
+ */
+static int rsa_fill_crt_params(struct rsa_st *rsa)
+{
+	const BIGNUM *n, *e, *d, *p0, *q0, *dmp0, *dmq0, *iqmp0;
+	BIGNUM *p = NULL, *q = NULL, *dmp1 = NULL, *dmq1 = NULL, *iqmp = NULL;
+	BIGNUM *tmp;
+	BN_CTX *ctx;
+	int rv = -1;
+
+	RSA_get0_key(rsa, &n, &e, &d);
+	RSA_get0_factors(rsa, &p0, &q0);
+	RSA_get0_crt_params(rsa, &dmp0, &dmq0, &iqmp0);
+	if (!bn_missing(p0) && !bn_missing(q0) && !bn_missing(dmp0) &&
+	    !bn_missing(dmq0) && !bn_missing(iqmp0))
+		return 0;
+	if (bn_missing(n) || bn_missing(e) || bn_missing(d))
+		return -1;
+
+	ctx = BN_CTX_new();
+	if (!ctx)
+		return -1;
+	BN_CTX_start(ctx);
+	tmp = BN_CTX_get(ctx);
+	p = BN_new();
+	q = BN_new();
+	dmp1 = BN_new();
+	dmq1 = BN_new();
+	iqmp = BN_new();
+	if (!tmp || !p || !q || !dmp1 || !dmq1 || !iqmp)
+		goto out;
+
+	if (bn_missing(p0) || bn_missing(q0)) {
+		if (rsa_recover_factors(n, e, d, p, q, ctx))
+			goto out;
+	} else if (!BN_copy(p, p0) || !BN_copy(q, q0)) {
+		goto out;
+	}
+
+	/* dP = d mod (p - 1), dQ = d mod (q - 1), qInv = q^-1 mod p */
+	if (!BN_sub(tmp, p, BN_value_one()) ||
+	    !BN_mod(dmp1, d, tmp, ctx) ||
+	    !BN_sub(tmp, q, BN_value_one()) ||
+	    !BN_mod(dmq1, d, tmp, ctx) ||
+	    !BN_mod_inverse(iqmp, q, p, ctx))
+		goto out;
+
+	if (!RSA_set0_factors(rsa, p, q))
+		goto out;
+	p = q = NULL;
+	if (!RSA_set0_crt_params(rsa, dmp1, dmq1, iqmp))
+		goto out;
+	dmp1 = dmq1 = iqmp = NULL;
+	rv = 0;
+
+ out:
+	BN_free(p);
+	BN_free(q);
+	BN_free(dmp1);
+	BN_free(dmq1);
+	BN_free(iqmp);
+	BN_CTX_end(ctx);
+	BN_CTX_free(ctx);
+	return rv;
+}
+
+/* Parse an RSA private key from [size] bytes of [data]. */
+static struct rsa_st *parse_rsa_key(const uint8_t *data, uint32_t size,
+				    int pem, uint64_t *alg)
+{
+	struct rsa_st *rsa;
+
+	if (pem) {
+		BIO *bio = BIO_new_mem_buf(data, size);
+
+		if (!bio)
+			return NULL;
+		rsa = PEM_read_bio_RSAPrivateKey(bio, NULL, NULL, NULL);
+		BIO_free(bio);
+	} else {
+		if (size < sizeof(*alg)) {
+			VB2_DEBUG("Too small for a private key\n");
+			return NULL;
+		}
+		memcpy(alg, data, sizeof(*alg));
+		const unsigned char *start = data + sizeof(*alg);
+		rsa = d2i_RSAPrivateKey(0, &start, size - sizeof(*alg));
+	}
+	if (!rsa) {
+		VB2_DEBUG("Unable to parse RSA private key\n");
+		return NULL;
+	}
+
+	if (rsa_fill_crt_params(rsa)) {
+		VB2_DEBUG("Unable to compute CRT parameters of private key\n");
+		RSA_free(rsa);
+		return NULL;
+	}
+	return rsa;
+}
+
+static struct rsa_st *cached_rsa_key_locked(const char *filename, int pem,
+					    uint64_t *alg)
+{
+	struct key_cache_entry *entry;
+	struct vb2_file_view view;
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	uint64_t file_alg = 0;
+	struct rsa_st *rsa;
+	struct stat sb;
+	uint32_t i, count = key_cache_count;
+	int have_stat = !stat(filename, &sb);
+
+	if (count > KEY_CACHE_SIZE)
+		count = KEY_CACHE_SIZE;
+
+	/* The file hasn't changed since it was cached */
+	for (i = 0; have_stat && i < count; i++) {
+		entry = &key_cache[i];
+		if (entry->pem == pem && entry->path &&
+		    !strcmp(entry->path, filename) &&
+		    same_file_state(entry, &sb))
+			goto found;
+	}
+
+	if (vb2_map_file(filename, &view, 0)) {
 		VB2_DEBUG("unable to read from file %s\n", filename);
 		return NULL;
 	}
+	if (vb2_digest_buffer(view.data, view.size, VB2_HASH_SHA256,
+			      digest, sizeof(digest))) {
+		vb2_unmap_file(&view);
+		return NULL;
+	}
+
+	/* Another file, or a rewritten one, with the same key */
+	for (i = 0; i < count; i++) {
+		entry = &key_cache[i];
+		if (entry->pem == pem &&
+		    !memcmp(entry->digest, digest, sizeof(digest))) {
+			vb2_unmap_file(&view);
+			goto found;
+		}
+	}
+
+	rsa = parse_rsa_key(view.data, view.size, pem, &file_alg);
+	vb2_unmap_file(&view);
+	if (!rsa)
+		return NULL;
+
+	/* Replace the oldest entry, if the cache is full */
+	entry = &key_cache[key_cache_count++ % KEY_CACHE_SIZE];
+	if (entry->rsa)
+		RSA_free(entry->rsa);
+	free(entry->path);
+	memset(entry, 0, sizeof(*entry));
+	/* Without a name, it can still be found by its digest */
+	if (have_stat) {
+		entry->path = strdup(filename);
+		entry->sb = sb;
+	}
+	memcpy(entry->digest, digest, sizeof(digest));
+	entry->pem = pem;
+	entry->alg = file_alg;
+	entry->rsa = rsa;
+
+found:
+	if (alg)
+		*alg = entry->alg;
+	RSA_up_ref(entry->rsa);
+	return entry->rsa;
+}
+
+/*
+ * Return a new reference to the RSA key in [filename], in PEM format if [pem]
+ * is set or else .vbprivk format, whose algorithm is then stored in [alg].
+ * Keys are parsed once, and shared by later reads of the same file, or of any
+ * file with the same contents.
+ */
+static struct rsa_st *cached_rsa_key(const char *filename, int pem,
+				     uint64_t *alg)
+{
+	struct rsa_st *rsa;
+
+	pthread_mutex_lock(&key_cache_lock);
+	rsa = cached_rsa_key_locked(filename, pem, alg);
+	pthread_mutex_unlock(&key_cache_lock);
+	return rsa;
+}
+
+void vb2_flush_private_key_cache(void)
+{
+	uint32_t i;
+
+	pthread_mutex_lock(&key_cache_lock);
+	for (i = 0; i < KEY_CACHE_SIZE; i++) {
+		if (key_cache[i].rsa)
+			RSA_free(key_cache[i].rsa);
+		free(key_cache[i].path);
+	}
+	memset(key_cache, 0, sizeof(key_cache));
+	key_cache_count = 0;
+	pthread_mutex_unlock(&key_cache_lock);
+}
+
+struct vb2_private_key *vb2_read_private_key(const char *filename)
+{
+	if (!strncmp(filename, PKCS11_KEY_PREFIX, strlen(PKCS11_KEY_PREFIX))) {
+		const char *spec_start = filename + strlen(PKCS11_KEY_PREFIX);
+		const char *alg = strrchr(spec_start, ':');
+		unsigned long algorithm;
+		char *spec, *end = NULL;
+		struct vb2_private_key *key;
+
+		if (alg)
+			algorithm = strtoul(alg + 1, &end, 0);
+		if (!alg || !alg[1] || *end) {
+			VB2_DEBUG("No algorithm in PKCS#11 key %s\n",
+				  filename);
+			return NULL;
+		}
+		spec = strndup(spec_start, alg - spec_start);
+		if (!spec)
+			return NULL;
+		key = vb2_read_private_key_pkcs11(spec, algorithm);
+		free(spec);
+		return key;
+	}
+
+	uint64_t alg;
+	struct rsa_st *rsa_key = cached_rsa_key(filename, 0, &alg);
+	if (!rsa_key)
+		return NULL;
 
 	struct vb2_private_key *key =
 		(struct vb2_private_key *)calloc(sizeof(*key), 1);
 	if (!key) {
 		VB2_DEBUG("Unable to allocate private key\n");
-		free(buf);
+		RSA_free(rsa_key);
 		return NULL;
 	}
 
-	uint64_t alg = *(uint64_t *)buf;
+	key->rsa_private_key = rsa_key;
 	key->hash_alg = vb2_crypto_to_hash(alg);
 	key->sig_alg = vb2_crypto_to_signature(alg);
-	const unsigned char *start = buf + sizeof(alg);
-
-	key->rsa_private_key =
-		d2i_RSAPrivateKey(0, &start, bufsize - sizeof(alg));
-
-	if (!key->rsa_private_key) {
-		VB2_DEBUG("Unable to parse RSA private key\n");
-		free(buf);
-		free(key);
-		return NULL;
-	}
-
-	free(buf);
 	return key;
 }
 
@@ -83,14 +392,7 @@ struct vb2_private_key *vb2_read_private_key_pem(
 	}
 
 	/* Read private key */
-	FILE *f = fopen(filename, "r");
-	if (!f) {
-		VB2_DEBUG("%s(): Couldn't open key file: %s\n",
-			  __FUNCTION__, filename);
-		return NULL;
-	}
-	struct rsa_st *rsa_key = PEM_read_RSAPrivateKey(f, NULL, NULL, NULL);
-	fclose(f);
+	struct rsa_st *rsa_key = cached_rsa_key(filename, 1, NULL);
 	if (!rsa_key) {
 		VB2_DEBUG("%s(): Couldn't read private key from file: %s\n",
 			 __FUNCTION__, filename);
@@ -112,12 +414,45 @@ struct vb2_private_key *vb2_read_private_key_pem(
 	return key;
 }
 
+struct vb2_private_key *vb2_read_private_key_pkcs11(
+	const char *spec,
+	enum vb2_crypto_algorithm algorithm)
+{
+	if (algorithm >= VB2_ALG_COUNT) {
+		VB2_DEBUG("%s() called with invalid algorithm!\n",
+			  __FUNCTION__);
+		return NULL;
+	}
+
+	struct vb2_private_key *key =
+		(struct vb2_private_key *)calloc(sizeof(*key), 1);
+	if (!key)
+		return NULL;
+	key->hash_alg = vb2_crypto_to_hash(algorithm);
+	key->sig_alg = vb2_crypto_to_signature(algorithm);
+
+	key->p11_key = pkcs11_open_key(spec);
+	if (!key->p11_key) {
+		free(key);
+		return NULL;
+	}
+	if (pkcs11_key_size(key->p11_key) != vb2_rsa_sig_size(key->sig_alg)) {
+		fprintf(stderr, "PKCS#11 key %s doesn't match algorithm %d\n",
+			spec, algorithm);
+		vb2_free_private_key(key);
+		return NULL;
+	}
+
+	return key;
+}
+
 void vb2_free_private_key(struct vb2_private_key *key)
 {
 	if (!key)
 		return;
 	if (key->rsa_private_key)
 		RSA_free(key->rsa_private_key);
+	pkcs11_close_key(key->p11_key);
 	free(key);
 }
 
@@ -232,29 +567,29 @@ struct vb2_packed_key *vb2_read_packed_keyb(const char *filename,
 		return NULL;
 	}
 
-	uint8_t *key_data = NULL;
-	uint32_t key_size = 0;
-	if (VB2_SUCCESS != vb2_read_file(filename, &key_data, &key_size))
+	struct vb2_file_view view;
+	if (VB2_SUCCESS != vb2_map_file(filename, &view, 0))
 		return NULL;
+	uint32_t key_size = view.size;
 
 	uint32_t expected_key_size =
 			vb2_packed_key_size(vb2_crypto_to_signature(algorithm));
 	if (!expected_key_size || expected_key_size != key_size) {
 		fprintf(stderr, "%s() - wrong key size %u for algorithm %u\n",
 			__func__, key_size, algorithm);
-		free(key_data);
+		vb2_unmap_file(&view);
 		return NULL;
 	}
 
 	struct vb2_packed_key *key =
 		vb2_alloc_packed_key(key_size, algorithm, version);
 	if (!key) {
-		free(key_data);
+		vb2_unmap_file(&view);
 		return NULL;
 	}
-	memcpy(vb2_packed_key_data_mutable(key), key_data, key_size);
+	memcpy(vb2_packed_key_data_mutable(key), view.data, key_size);
 
-	free(key_data);
+	vb2_unmap_file(&view);
 	return key;
 }
 
@@ -316,8 +651,13 @@ vb2_error_t vb2_unpack_key_data(struct vb2_public_key *key,
 	key->arrsize = buf32[0];
 
 	/* Sanity check key array size */
-	if (key->arrsize * sizeof(uint32_t) != vb2_rsa_sig_size(key->sig_alg))
+	if (key->sig_alg == VB2_SIG_ECDSA_P256) {
+		if (key->arrsize != VB2_P256_WORDS)
+			return VB2_ERROR_UNPACK_KEY_ARRAY_SIZE;
+	} else if (key->arrsize * sizeof(uint32_t) !=
+		   vb2_rsa_sig_size(key->sig_alg)) {
 		return VB2_ERROR_UNPACK_KEY_ARRAY_SIZE;
+	}
 
 	key->n0inv = buf32[1];
 
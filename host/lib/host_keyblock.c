@@ -19,20 +19,30 @@
 #include "host_key.h"
 #include "vb2_common.h"
 
-struct vb2_keyblock *vb2_create_keyblock(
-		const struct vb2_packed_key *data_key,
-		const struct vb2_private_key *signing_key,
-		uint32_t flags)
+uint32_t vb2_keyblock_size(const struct vb2_packed_key *data_key,
+			   const struct vb2_private_key *signing_key)
 {
-	/* Allocate keyblock */
+	return sizeof(struct vb2_keyblock) + data_key->key_size +
+		VB2_SHA512_DIGEST_SIZE +
+		(signing_key ? vb2_rsa_sig_size(signing_key->sig_alg) : 0);
+}
+
+vb2_error_t vb2_create_keyblock_in(void *buf, uint32_t buf_size,
+				   const struct vb2_packed_key *data_key,
+				   const struct vb2_private_key *signing_key,
+				   uint32_t flags)
+{
+	struct vb2_keyblock *h = buf;
 	uint32_t signed_size = sizeof(struct vb2_keyblock) + data_key->key_size;
 	uint32_t sig_data_size =
 		(signing_key ? vb2_rsa_sig_size(signing_key->sig_alg) : 0);
-	uint32_t block_size =
-		signed_size + VB2_SHA512_DIGEST_SIZE + sig_data_size;
-	struct vb2_keyblock *h = (struct vb2_keyblock *)calloc(block_size, 1);
-	if (!h)
-		return NULL;
+	uint32_t block_size = vb2_keyblock_size(data_key, signing_key);
+
+	if (buf_size < block_size)
+		return VB2_KEYBLOCK_CREATE_BUF_SIZE;
+	if (signing_key && !sig_data_size)
+		return VB2_KEYBLOCK_CREATE_SIG_SIZE;
+	memset(h, 0, block_size);
 
 	uint8_t *data_key_dest = (uint8_t *)(h + 1);
 	uint8_t *block_chk_dest = data_key_dest + data_key->key_size;
@@ -46,33 +56,47 @@ struct vb2_keyblock *vb2_create_keyblock(
 
 	/* Copy data key */
 	vb2_init_packed_key(&h->data_key, data_key_dest, data_key->key_size);
-	vb2_copy_packed_key(&h->data_key, data_key);
+	if (VB2_SUCCESS != vb2_copy_packed_key(&h->data_key, data_key))
+		return VB2_KEYBLOCK_CREATE_DATA_KEY;
 
 	/* Set up signature structs so we can calculate the signatures */
 	vb2_init_signature(&h->keyblock_hash, block_chk_dest,
 			   VB2_SHA512_DIGEST_SIZE, signed_size);
-	if (signing_key) {
+	if (signing_key)
 		vb2_init_signature(&h->keyblock_signature, block_sig_dest,
 				   sig_data_size, signed_size);
-	} else {
-		memset(&h->keyblock_signature, 0,
-		       sizeof(h->keyblock_signature));
-	}
 
 	/* Calculate hash */
-	struct vb2_signature *chk =
-		vb2_sha512_signature((uint8_t*)h, signed_size);
-	vb2_copy_signature(&h->keyblock_hash, chk);
-	free(chk);
+	if (VB2_SUCCESS != vb2_digest_buffer((uint8_t *)h, signed_size,
+					     VB2_HASH_SHA512, block_chk_dest,
+					     VB2_SHA512_DIGEST_SIZE))
+		return VB2_KEYBLOCK_CREATE_HASH;
 
 	/* Calculate signature */
-	if (signing_key) {
-		struct vb2_signature *sigtmp =
-			vb2_calculate_signature((uint8_t*)h,
-						signed_size,
-						signing_key);
-		vb2_copy_signature(&h->keyblock_signature, sigtmp);
-		free(sigtmp);
+	if (signing_key &&
+	    VB2_SUCCESS != vb2_sign_data_into(&h->keyblock_signature,
+					      (uint8_t *)h, signed_size,
+					      signing_key))
+		return VB2_KEYBLOCK_CREATE_SIGN;
+
+	return VB2_SUCCESS;
+}
+
+struct vb2_keyblock *vb2_create_keyblock(
+		const struct vb2_packed_key *data_key,
+		const struct vb2_private_key *signing_key,
+		uint32_t flags)
+{
+	/* Allocate keyblock */
+	uint32_t block_size = vb2_keyblock_size(data_key, signing_key);
+	struct vb2_keyblock *h = (struct vb2_keyblock *)malloc(block_size);
+	if (!h)
+		return NULL;
+
+	if (VB2_SUCCESS != vb2_create_keyblock_in(h, block_size, data_key,
+						  signing_key, flags)) {
+		free(h);
+		return NULL;
 	}
 
 	/* Return the header */
@@ -122,19 +146,16 @@ struct vb2_keyblock *vb2_create_keyblock_external(
 	vb2_init_signature(&h->keyblock_signature, block_sig_dest,
 			   sig_data_size, signed_size);
 
-	/* Calculate checksum */
-	struct vb2_signature *chk =
-		vb2_sha512_signature((uint8_t*)h, signed_size);
-	vb2_copy_signature(&h->keyblock_hash, chk);
-	free(chk);
-
-	/* Calculate signature */
-	struct vb2_signature *sigtmp =
-		vb2_external_signature((uint8_t*)h, signed_size,
-				       signing_key_pem_file, algorithm,
-				       external_signer);
-	vb2_copy_signature(&h->keyblock_signature, sigtmp);
-	free(sigtmp);
+	/* Calculate checksum and signature straight into the keyblock */
+	if (VB2_SUCCESS != vb2_digest_buffer((uint8_t *)h, signed_size,
+					     VB2_HASH_SHA512, block_chk_dest,
+					     VB2_SHA512_DIGEST_SIZE) ||
+	    VB2_SUCCESS != vb2_external_signature_into(
+			&h->keyblock_signature, (uint8_t *)h, signed_size,
+			signing_key_pem_file, algorithm, external_signer)) {
+		free(h);
+		return NULL;
+	}
 
 	/* Return the header */
 	return h;
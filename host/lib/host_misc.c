@@ -12,6 +12,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "2struct.h"
 #include "host_common.h"
 
 char* StrCopy(char* dest, const char* src, int dest_size)
@@ -116,3 +117,35 @@ vb2_error_t WriteFile(const char* filename, const void *data, uint64_t size)
 	fclose(f);
 	return 0;
 }
+
+const char *vb2_timestamp_event_name(uint32_t event)
+{
+	switch (event) {
+	case VB2_TS_FW_PHASE1_START:
+		return "fw_phase1_start";
+	case VB2_TS_FW_PHASE2_START:
+		return "fw_phase2_start";
+	case VB2_TS_FW_PHASE3_START:
+		return "fw_phase3_start";
+	case VB2_TS_FW_KEYBLOCK_VERIFIED:
+		return "fw_keyblock_verified";
+	case VB2_TS_FW_PREAMBLE_VERIFIED:
+		return "fw_preamble_verified";
+	case VB2_TS_HASH_INIT:
+		return "hash_init";
+	case VB2_TS_HASH_EXTEND:
+		return "hash_extend";
+	case VB2_TS_HASH_FINALIZE:
+		return "hash_finalize";
+	case VB2_TS_KERNEL_VBLOCK_VERIFIED:
+		return "kernel_vblock_verified";
+	case VB2_TS_KERNEL_BODY_READ:
+		return "kernel_body_read";
+	case VB2_TS_KERNEL_BODY_VERIFIED:
+		return "kernel_body_verified";
+	case VB2_TS_KERNEL_GPT_READ:
+		return "kernel_gpt_read";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,341 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host functions for signing with keys held in a PKCS#11 token.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "2common.h"
+#include "host_p11.h"
+
+#ifdef HAVE_PKCS11
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <p11-kit/pkcs11.h>
+
+/* A loaded PKCS#11 module, shared by all the keys in it */
+struct pkcs11_module {
+	char *path;
+	void *handle;			/* From dlopen() */
+	CK_FUNCTION_LIST_PTR fn;
+	pid_t pid;			/* Process which initialized it */
+	int refs;
+	struct pkcs11_module *next;
+};
+
+struct pkcs11_key {
+	pthread_mutex_t lock;		/* A session is for one thread at a time */
+	struct pkcs11_module *module;
+	CK_SLOT_ID slot;
+	char *label;
+	CK_SESSION_HANDLE session;
+	CK_OBJECT_HANDLE object;
+	uint32_t size;			/* Modulus size in bytes */
+	pid_t pid;			/* Process which opened the session */
+};
+
+static struct pkcs11_module *modules;
+static pthread_mutex_t modules_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct pkcs11_module *get_module_locked(const char *path)
+{
+	CK_C_INITIALIZE_ARGS args = { .flags = CKF_OS_LOCKING_OK };
+	CK_C_GetFunctionList get_function_list;
+	struct pkcs11_module *module;
+	CK_RV rv;
+
+	for (module = modules; module; module = module->next) {
+		if (!strcmp(module->path, path)) {
+			module->refs++;
+			return module;
+		}
+	}
+
+	module = calloc(1, sizeof(*module));
+	if (!module)
+		return NULL;
+	module->path = strdup(path);
+	module->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!module->path || !module->handle) {
+		fprintf(stderr, "Unable to load PKCS#11 module %s: %s\n",
+			path, module->handle ? "out of memory" : dlerror());
+		goto fail;
+	}
+
+	get_function_list = (CK_C_GetFunctionList)dlsym(module->handle,
+							"C_GetFunctionList");
+	if (!get_function_list || get_function_list(&module->fn) != CKR_OK) {
+		fprintf(stderr, "%s is not a PKCS#11 module\n", path);
+		goto fail;
+	}
+
+	rv = module->fn->C_Initialize(&args);
+	if (rv != CKR_OK && rv != CKR_CRYPTOKI_ALREADY_INITIALIZED) {
+		fprintf(stderr, "Unable to initialize %s: %#lx\n", path, rv);
+		goto fail;
+	}
+
+	module->pid = getpid();
+	module->refs = 1;
+	module->next = modules;
+	modules = module;
+	return module;
+
+fail:
+	if (module->handle)
+		dlclose(module->handle);
+	free(module->path);
+	free(module);
+	return NULL;
+}
+
+/* Load and initialize the module at [path], or reuse it if already loaded. */
+static struct pkcs11_module *get_module(const char *path)
+{
+	struct pkcs11_module *module;
+
+	pthread_mutex_lock(&modules_lock);
+	module = get_module_locked(path);
+	pthread_mutex_unlock(&modules_lock);
+	return module;
+}
+
+static void put_module_locked(struct pkcs11_module *module)
+{
+	struct pkcs11_module **m;
+
+	if (--module->refs)
+		return;
+
+	for (m = &modules; *m; m = &(*m)->next) {
+		if (*m == module) {
+			*m = module->next;
+			break;
+		}
+	}
+	if (module->pid == getpid())
+		module->fn->C_Finalize(NULL);
+	dlclose(module->handle);
+	free(module->path);
+	free(module);
+}
+
+static void put_module(struct pkcs11_module *module)
+{
+	pthread_mutex_lock(&modules_lock);
+	put_module_locked(module);
+	pthread_mutex_unlock(&modules_lock);
+}
+
+/* Open a session to the token and find the key in it. */
+static int open_session(struct pkcs11_key *key)
+{
+	CK_FUNCTION_LIST_PTR fn = key->module->fn;
+	CK_OBJECT_CLASS key_class = CKO_PRIVATE_KEY;
+	CK_ATTRIBUTE template[] = {
+		{ CKA_CLASS, &key_class, sizeof(key_class) },
+		{ CKA_LABEL, key->label, strlen(key->label) },
+	};
+	CK_ATTRIBUTE modulus = { CKA_MODULUS, NULL, 0 };
+	CK_ULONG count = 0;
+	const char *pin;
+	CK_RV rv;
+
+	/* A child has to initialize the module again before using it. */
+	pthread_mutex_lock(&modules_lock);
+	if (key->module->pid != getpid()) {
+		CK_C_INITIALIZE_ARGS args = { .flags = CKF_OS_LOCKING_OK };
+
+		rv = fn->C_Initialize(&args);
+		if (rv != CKR_OK && rv != CKR_CRYPTOKI_ALREADY_INITIALIZED) {
+			pthread_mutex_unlock(&modules_lock);
+			fprintf(stderr, "Unable to initialize %s: %#lx\n",
+				key->module->path, rv);
+			return -1;
+		}
+		key->module->pid = getpid();
+	}
+	pthread_mutex_unlock(&modules_lock);
+
+	rv = fn->C_OpenSession(key->slot, CKF_SERIAL_SESSION, NULL, NULL,
+			       &key->session);
+	if (rv != CKR_OK) {
+		fprintf(stderr, "Unable to open PKCS#11 slot %lu: %#lx\n",
+			key->slot, rv);
+		return -1;
+	}
+	key->pid = getpid();
+
+	/* Logins are shared by every session to the token. */
+	pin = getenv("VBOOT_PKCS11_PIN");
+	if (pin) {
+		rv = fn->C_Login(key->session, CKU_USER, (CK_UTF8CHAR_PTR)pin,
+				 strlen(pin));
+		if (rv != CKR_OK && rv != CKR_USER_ALREADY_LOGGED_IN) {
+			fprintf(stderr, "Unable to log in to PKCS#11 slot "
+				"%lu: %#lx\n", key->slot, rv);
+			goto fail;
+		}
+	}
+
+	if (fn->C_FindObjectsInit(key->session, template,
+				  ARRAY_SIZE(template)) != CKR_OK)
+		goto fail;
+	rv = fn->C_FindObjects(key->session, &key->object, 1, &count);
+	fn->C_FindObjectsFinal(key->session);
+	if (rv != CKR_OK || count != 1) {
+		fprintf(stderr, "Unable to find PKCS#11 key \"%s\"\n",
+			key->label);
+		goto fail;
+	}
+
+	if (fn->C_GetAttributeValue(key->session, key->object, &modulus, 1) !=
+	    CKR_OK || !modulus.ulValueLen ||
+	    modulus.ulValueLen == CK_UNAVAILABLE_INFORMATION) {
+		fprintf(stderr, "PKCS#11 key \"%s\" is not an RSA key\n",
+			key->label);
+		goto fail;
+	}
+	key->size = modulus.ulValueLen;
+	return 0;
+
+fail:
+	fn->C_CloseSession(key->session);
+	key->pid = 0;
+	return -1;
+}
+
+struct pkcs11_key *pkcs11_open_key(const char *spec)
+{
+	struct pkcs11_key *key;
+	char *path, *slot, *label, *end;
+
+	path = strdup(spec);
+	if (!path)
+		return NULL;
+
+	/* Split from the right, in case the module path has colons. */
+	label = strrchr(path, ':');
+	if (label)
+		*label++ = '\0';
+	slot = strrchr(path, ':');
+	if (slot)
+		*slot++ = '\0';
+	if (!label || !slot || !*path || !*label) {
+		fprintf(stderr, "Bad PKCS#11 key \"%s\"; "
+			"expected MODULE:SLOT:LABEL\n", spec);
+		free(path);
+		return NULL;
+	}
+
+	key = calloc(1, sizeof(*key));
+	if (!key) {
+		free(path);
+		return NULL;
+	}
+	pthread_mutex_init(&key->lock, NULL);
+	key->slot = strtoul(slot, &end, 0);
+	if (!*slot || *end) {
+		fprintf(stderr, "Bad PKCS#11 slot \"%s\"\n", slot);
+		goto fail;
+	}
+	key->label = strdup(label);
+	if (!key->label)
+		goto fail;
+
+	key->module = get_module(path);
+	if (!key->module)
+		goto fail;
+	if (open_session(key)) {
+		put_module(key->module);
+		goto fail;
+	}
+
+	free(path);
+	return key;
+
+fail:
+	pthread_mutex_destroy(&key->lock);
+	free(key->label);
+	free(key);
+	free(path);
+	return NULL;
+}
+
+void pkcs11_close_key(struct pkcs11_key *key)
+{
+	if (!key)
+		return;
+
+	/* A child's inherited session is its parent's to close. */
+	if (key->pid == getpid())
+		key->module->fn->C_CloseSession(key->session);
+	put_module(key->module);
+	pthread_mutex_destroy(&key->lock);
+	free(key->label);
+	free(key);
+}
+
+uint32_t pkcs11_key_size(const struct pkcs11_key *key)
+{
+	return key->size;
+}
+
+vb2_error_t pkcs11_sign(struct pkcs11_key *key, const uint8_t *data,
+			uint32_t size, uint8_t *sig, uint32_t sig_size)
+{
+	CK_FUNCTION_LIST_PTR fn = key->module->fn;
+	CK_MECHANISM mechanism = { CKM_RSA_PKCS, NULL, 0 };
+	CK_ULONG len = sig_size;
+	vb2_error_t rv = VB2_SUCCESS;
+
+	if (sig_size != key->size)
+		return VB2_ERROR_PKCS11_SIG_SIZE;
+
+	pthread_mutex_lock(&key->lock);
+	if (key->pid != getpid() && open_session(key)) {
+		rv = VB2_ERROR_PKCS11_SESSION;
+	} else if (fn->C_SignInit(key->session, &mechanism, key->object) !=
+		   CKR_OK ||
+		   fn->C_Sign(key->session, (CK_BYTE_PTR)data, size, sig,
+			      &len) != CKR_OK || len != sig_size) {
+		fprintf(stderr, "PKCS#11 key \"%s\" failed to sign\n",
+			key->label);
+		rv = VB2_ERROR_PKCS11_SIGN;
+	}
+	pthread_mutex_unlock(&key->lock);
+
+	return rv;
+}
+
+#else  /* !HAVE_PKCS11 */
+
+struct pkcs11_key *pkcs11_open_key(const char *spec)
+{
+	fprintf(stderr, "Unable to open PKCS#11 key \"%s\": "
+		"built without PKCS#11 support\n", spec);
+	return NULL;
+}
+
+void pkcs11_close_key(struct pkcs11_key *key)
+{
+}
+
+uint32_t pkcs11_key_size(const struct pkcs11_key *key)
+{
+	return 0;
+}
+
+vb2_error_t pkcs11_sign(struct pkcs11_key *key, const uint8_t *data,
+			uint32_t size, uint8_t *sig, uint32_t sig_size)
+{
+	return VB2_ERROR_PKCS11_SIGN;
+}
+
+#endif  /* HAVE_PKCS11 */
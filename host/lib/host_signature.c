@@ -9,8 +9,10 @@
 
 #include <openssl/rsa.h>
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -21,98 +23,285 @@
 #include "2sysincludes.h"
 #include "host_common.h"
 #include "host_signature21.h"
+#include "subprocess.h"
 #include "vb2_common.h"
 
-/* Invoke [external_signer] command with [pem_file] as an argument, contents of
- * [inbuf] passed redirected to stdin, and the stdout of the command is put
- * back into [outbuf].  Returns -1 on error, 0 on success.
+/* Descriptors of a running external signer */
+struct external_signer {
+	pid_t pid;		/* Signer process, or 0 if none */
+	pid_t owner;		/* Process which started the signer */
+	int to_signer;		/* Its stdin */
+	int from_signer;	/* Its stdout */
+	char *path;		/* Signer command... */
+	char *pem_file;		/* ...and the key it was started with */
+};
+
+/* Run the signer once per signature, or keep one running and reuse it */
+static int keep_signer;
+
+/* The signer kept running, if keep_signer is set */
+static struct external_signer persistent;
+
+/* Requests to the persistent signer go one at a time */
+static pthread_mutex_t persistent_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Write all of [size] bytes of [buf] to [fd].  Returns 0 on success. */
+static int write_all(int fd, const void *buf, uint32_t size)
+{
+	const uint8_t *p = buf;
+	ssize_t n;
+
+	while (size) {
+		n = write(fd, p, size);
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+/* Read all of [size] bytes into [buf] from [fd].  Returns 0 on success. */
+static int read_all(int fd, void *buf, uint32_t size)
+{
+	uint8_t *p = buf;
+	ssize_t n;
+
+	while (size) {
+		n = read(fd, p, size);
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+/* Start [external_signer] as a co-process, with "--persistent" and
+ * [pem_file] as its arguments.  Fills in the pid and pipe descriptors of
+ * [signer].  Returns -1 on error, 0 on success.
  */
-static int sign_external(uint32_t size, const uint8_t *inbuf, uint8_t *outbuf,
-			 uint32_t outbufsize, const char *pem_file,
-			 const char *external_signer)
+static int start_signer(struct external_signer *signer,
+			const char *external_signer, const char *pem_file)
 {
-	int rv = 0, n;
 	int p_to_c[2], c_to_p[2];  /* pipe descriptors */
 	pid_t pid;
 
-	VB2_DEBUG("Will invoke \"%s %s\" to perform signing.\n"
-		 "Input to the signer will be provided on standard in.\n"
-		 "Output of the signer will be read from standard out.\n",
+	VB2_DEBUG("Will invoke \"%s --persistent %s\" to perform signing.\n"
+		  "Input to the signer will be provided on standard in.\n"
+		  "Output of the signer will be read from standard out.\n",
 		  external_signer, pem_file);
 
 	/* Need two pipes since we want to invoke the external_signer as
 	 * a co-process writing to its stdin and reading from its stdout. */
-	if (pipe(p_to_c) < 0 || pipe(c_to_p) < 0) {
+	if (pipe(p_to_c) < 0) {
 		VB2_DEBUG("pipe() error\n");
 		return -1;
 	}
+	if (pipe(c_to_p) < 0) {
+		VB2_DEBUG("pipe() error\n");
+		close(p_to_c[0]);
+		close(p_to_c[1]);
+		return -1;
+	}
 	if ((pid = fork()) < 0) {
 		VB2_DEBUG("fork() error\n");
+		close(p_to_c[0]);
+		close(p_to_c[1]);
+		close(c_to_p[0]);
+		close(c_to_p[1]);
 		return -1;
-	} else if (pid > 0) {  /* Parent. */
-		close(p_to_c[STDIN_FILENO]);
-		close(c_to_p[STDOUT_FILENO]);
-
-		/* We provide input to the child process (external signer). */
-		if (write(p_to_c[STDOUT_FILENO], inbuf, size) != size) {
-			VB2_DEBUG("write() error\n");
-			rv = -1;
-		} else {
-			/* Send EOF to child (signer process). */
-			close(p_to_c[STDOUT_FILENO]);
-
-			do {
-				n = read(c_to_p[STDIN_FILENO], outbuf,
-					 outbufsize);
-				outbuf += n;
-				outbufsize -= n;
-			} while (n > 0 && outbufsize);
-
-			if (n < 0) {
-				VB2_DEBUG("read() error\n");
-				rv = -1;
-			}
-		}
-		if (waitpid(pid, NULL, 0) < 0) {
-			VB2_DEBUG("waitpid() error\n");
-			rv = -1;
-		}
-	} else {  /* Child. */
-		close (p_to_c[STDOUT_FILENO]);
-		close (c_to_p[STDIN_FILENO]);
+	} else if (pid == 0) {  /* Child. */
+		close(p_to_c[STDOUT_FILENO]);
+		close(c_to_p[STDIN_FILENO]);
 		/* Map the stdin to the first pipe (this pipe gets input
-		 * from the parent) */
-		if (STDIN_FILENO != p_to_c[STDIN_FILENO]) {
-			if (dup2(p_to_c[STDIN_FILENO], STDIN_FILENO) !=
-			    STDIN_FILENO) {
-				VB2_DEBUG("stdin dup2() failed\n");
-				close(p_to_c[0]);
-				return -1;
-			}
-		}
-		/* Map the stdout to the second pipe (this pipe sends back
-		 * signer output to the parent) */
-		if (STDOUT_FILENO != c_to_p[STDOUT_FILENO]) {
-			if (dup2(c_to_p[STDOUT_FILENO], STDOUT_FILENO) !=
-			    STDOUT_FILENO) {
-				VB2_DEBUG("stdout dup2() failed\n");
-				close(c_to_p[STDOUT_FILENO]);
-				return -1;
-			}
+		 * from the parent), and the stdout to the second pipe (this
+		 * pipe sends back signer output to the parent) */
+		if (dup2(p_to_c[STDIN_FILENO], STDIN_FILENO) < 0 ||
+		    dup2(c_to_p[STDOUT_FILENO], STDOUT_FILENO) < 0) {
+			VB2_DEBUG("dup2() failed\n");
+			_exit(1);
 		}
 		/* External signer is invoked here. */
-		if (execl(external_signer, external_signer, pem_file,
-			  (char *) 0) < 0) {
-			VB2_DEBUG("execl() of external signer failed\n");
-		}
+		execl(external_signer, external_signer, "--persistent",
+		      pem_file, (char *) 0);
+		VB2_DEBUG("execl() of external signer failed\n");
+		_exit(1);
 	}
+
+	/* Parent. */
+	close(p_to_c[STDIN_FILENO]);
+	close(c_to_p[STDOUT_FILENO]);
+	signer->pid = pid;
+	signer->owner = getpid();
+	signer->to_signer = p_to_c[STDOUT_FILENO];
+	signer->from_signer = c_to_p[STDIN_FILENO];
+	return 0;
+}
+
+/* Close the pipes to [signer] and, if this process started it, wait for it
+ * to exit.  Returns -1 on error, 0 on success.
+ */
+static int stop_signer(struct external_signer *signer)
+{
+	int rv = 0;
+
+	if (!signer->pid)
+		return 0;
+
+	/* Closing its stdin tells the signer we're done. */
+	close(signer->to_signer);
+	close(signer->from_signer);
+	/* A forked child of ours can't wait for the signer it inherited. */
+	if (signer->owner == getpid() && waitpid(signer->pid, NULL, 0) < 0) {
+		VB2_DEBUG("waitpid() error\n");
+		rv = -1;
+	}
+	free(signer->path);
+	free(signer->pem_file);
+	memset(signer, 0, sizeof(*signer));
 	return rv;
 }
 
-struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
-					     const char *key_file,
-					     uint32_t key_algorithm,
-					     const char *external_signer)
+static void stop_persistent_signer(void)
+{
+	pthread_mutex_lock(&persistent_lock);
+	stop_signer(&persistent);
+	pthread_mutex_unlock(&persistent_lock);
+}
+
+void vb2_external_signer_persist(int enable)
+{
+	static int registered;
+
+	keep_signer = enable;
+	if (!enable) {
+		stop_persistent_signer();
+	} else if (!registered) {
+		atexit(stop_persistent_signer);
+		registered = 1;
+	}
+}
+
+/* Write a 32-bit [value] to [buf] in big-endian byte order. */
+static void put_be32(uint8_t *buf, uint32_t value)
+{
+	buf[0] = value >> 24;
+	buf[1] = value >> 16;
+	buf[2] = value >> 8;
+	buf[3] = value;
+}
+
+/* Send [inbuf] to the persistent [external_signer], starting it first if it
+ * isn't already running for [pem_file], and read the signature back into
+ * [outbuf].  Each request and response is a 4-byte big-endian length
+ * followed by that many bytes; a zero-length response means the signer
+ * couldn't sign that request.  Returns -1 on error, 0 on success.
+ */
+static int sign_persistent(uint32_t size, const uint8_t *inbuf,
+			   uint8_t *outbuf, uint32_t outbufsize,
+			   const char *pem_file, const char *external_signer)
+{
+	uint8_t len[4];
+	uint32_t sig_len;
+
+	/* Don't share the pipes with a parent, or with another key. */
+	if (persistent.pid &&
+	    (persistent.owner != getpid() ||
+	     strcmp(persistent.path, external_signer) ||
+	     strcmp(persistent.pem_file, pem_file)))
+		stop_signer(&persistent);
+
+	if (!persistent.pid) {
+		if (start_signer(&persistent, external_signer, pem_file))
+			return -1;
+		persistent.path = strdup(external_signer);
+		persistent.pem_file = strdup(pem_file);
+		if (!persistent.path || !persistent.pem_file) {
+			stop_signer(&persistent);
+			return -1;
+		}
+	}
+
+	put_be32(len, size);
+	if (write_all(persistent.to_signer, len, sizeof(len)) ||
+	    write_all(persistent.to_signer, inbuf, size)) {
+		VB2_DEBUG("write() error\n");
+		stop_signer(&persistent);
+		return -1;
+	}
+
+	if (read_all(persistent.from_signer, len, sizeof(len))) {
+		VB2_DEBUG("read() error\n");
+		stop_signer(&persistent);
+		return -1;
+	}
+	sig_len = ((uint32_t)len[0] << 24) | (len[1] << 16) |
+		  (len[2] << 8) | len[3];
+	if (!sig_len) {
+		VB2_DEBUG("External signer failed to sign.\n");
+		return -1;
+	}
+	if (sig_len > outbufsize ||
+	    read_all(persistent.from_signer, outbuf, sig_len)) {
+		VB2_DEBUG("Bad response from external signer.\n");
+		stop_signer(&persistent);
+		return -1;
+	}
+	return 0;
+}
+
+/* Invoke [external_signer] command with [pem_file] as an argument, contents of
+ * [inbuf] passed redirected to stdin, and the stdout of the command is put
+ * back into [outbuf].  Returns -1 on error, 0 on success.
+ */
+static int sign_external(uint32_t size, const uint8_t *inbuf, uint8_t *outbuf,
+			 uint32_t outbufsize, const char *pem_file,
+			 const char *external_signer)
+{
+	const char *const argv[] = {external_signer, pem_file, NULL};
+	struct subprocess_target input = {
+		.type = TARGET_BUFFER,
+		.buffer = {
+			.buf = (char *)inbuf,
+			.size = size,
+		},
+	};
+	struct subprocess_target output = {
+		.type = TARGET_BUFFER,
+		.buffer = {
+			.buf = (char *)outbuf,
+			.size = outbufsize,
+		},
+	};
+	int rv;
+
+	if (keep_signer) {
+		pthread_mutex_lock(&persistent_lock);
+		rv = sign_persistent(size, inbuf, outbuf, outbufsize,
+				     pem_file, external_signer);
+		pthread_mutex_unlock(&persistent_lock);
+		return rv;
+	}
+
+	VB2_DEBUG("Will invoke \"%s %s\" to perform signing.\n"
+		  "Input to the signer will be provided on standard in.\n"
+		  "Output of the signer will be read from standard out.\n",
+		  external_signer, pem_file);
+
+	rv = subprocess_run(argv, &input, &output, NULL);
+	if (rv) {
+		VB2_DEBUG("External signer failed (%d).\n", rv);
+		return -1;
+	}
+	return 0;
+}
+
+vb2_error_t vb2_external_signature_into(struct vb2_signature *sig,
+					const uint8_t *data, uint32_t size,
+					const char *key_file,
+					uint32_t key_algorithm,
+					const char *external_signer)
 {
 	int vb2_alg = vb2_crypto_to_hash(key_algorithm);
 	uint8_t digest[VB2_MAX_DIGEST_SIZE];
@@ -121,48 +310,59 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
 	uint32_t digest_info_size = 0;
 	const uint8_t *digest_info = NULL;
 	if (VB2_SUCCESS != vb2_digest_info(vb2_alg,
-					   &digest_info, &digest_info_size))
-		return NULL;
-
+					   &digest_info, &digest_info_size) ||
+	    digest_info_size > VB2_MAX_DIGEST_INFO_SIZE)
+		return VB2_SIGN_DATA_DIGEST_INFO;
 
-	uint8_t *signature_digest;
-	uint64_t signature_digest_len = digest_size + digest_info_size;
-
-	int rv;
+	uint32_t sig_size =
+		vb2_rsa_sig_size(vb2_crypto_to_signature(key_algorithm));
+	if (sig->sig_size != sig_size || !sig_size)
+		return VB2_SIGN_DATA_SIG_SIZE;
 
 	/* Calculate the digest */
 	if (VB2_SUCCESS != vb2_digest_buffer(data, size, vb2_alg,
 					     digest, sizeof(digest)))
-		return NULL;
+		return VB2_SIGN_DATA_DIGEST_FINALIZE;
 
 	/* Prepend the digest info to the digest */
-	signature_digest = calloc(signature_digest_len, 1);
-	if (!signature_digest)
-		return NULL;
+	uint8_t signature_digest[VB2_MAX_DIGEST_INFO_SIZE +
+				 VB2_MAX_DIGEST_SIZE];
+	uint32_t signature_digest_len = digest_size + digest_info_size;
 
 	memcpy(signature_digest, digest_info, digest_info_size);
 	memcpy(signature_digest + digest_info_size, digest, digest_size);
 
+	/* Sign the signature_digest into our output buffer */
+	if (-1 == sign_external(signature_digest_len,  /* Input length */
+				signature_digest,      /* Input data */
+				vb2_signature_data_mutable(sig),  /* Output */
+				sig_size,              /* Max Output sig size */
+				key_file,              /* Key file to use */
+				external_signer)) {    /* External cmd */
+		VB2_DEBUG("RSA_private_encrypt() failed.\n");
+		return VB2_SIGN_DATA_RSA_ENCRYPT;
+	}
+
+	sig->data_size = size;
+	return VB2_SUCCESS;
+}
+
+struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
+					     const char *key_file,
+					     uint32_t key_algorithm,
+					     const char *external_signer)
+{
 	/* Allocate output signature */
 	uint32_t sig_size =
 		vb2_rsa_sig_size(vb2_crypto_to_signature(key_algorithm));
 	struct vb2_signature *sig = vb2_alloc_signature(sig_size, size);
-	if (!sig) {
-		free(signature_digest);
+	if (!sig)
 		return NULL;
-	}
 
-	/* Sign the signature_digest into our output buffer */
-	rv = sign_external(signature_digest_len,    /* Input length */
-			   signature_digest,        /* Input data */
-			   vb2_signature_data_mutable(sig),  /* Output sig */
-			   sig_size,                /* Max Output sig size */
-			   key_file,                /* Key file to use */
-			   external_signer);        /* External cmd to invoke */
-	free(signature_digest);
-
-	if (-1 == rv) {
-		VB2_DEBUG("RSA_private_encrypt() failed.\n");
+	if (VB2_SUCCESS != vb2_external_signature_into(sig, data, size,
+						       key_file,
+						       key_algorithm,
+						       external_signer)) {
 		free(sig);
 		return NULL;
 	}
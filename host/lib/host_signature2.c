@@ -7,6 +7,7 @@
 
 #include <openssl/rsa.h>
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
@@ -21,6 +22,7 @@
 #include "file_keys.h"
 #include "host_common.h"
 #include "host_key21.h"
+#include "host_p11.h"
 #include "host_signature21.h"
 #include "vb2_common.h"
 
@@ -80,51 +82,65 @@ struct vb2_signature *vb2_sha512_signature(const uint8_t *data, uint32_t size)
 	return sig;
 }
 
-struct vb2_signature *vb2_calculate_signature(
-		const uint8_t *data, uint32_t size,
-		const struct vb2_private_key *key)
+/* Sign [digest] into the data of [sig], whose size must match [key]. */
+static vb2_error_t sign_digest_into(struct vb2_signature *sig,
+				    const uint8_t *digest,
+				    const struct vb2_private_key *key)
 {
-	uint8_t digest[VB2_MAX_DIGEST_SIZE];
 	uint32_t digest_size = vb2_digest_size(key->hash_alg);
 
+	if (sig->sig_size != vb2_rsa_sig_size(key->sig_alg) || !sig->sig_size)
+		return VB2_SIGN_DATA_SIG_SIZE;
+
 	uint32_t digest_info_size = 0;
 	const uint8_t *digest_info = NULL;
 	if (VB2_SUCCESS != vb2_digest_info(key->hash_alg,
-					   &digest_info, &digest_info_size))
-		return NULL;
-
-	/* Calculate the digest */
-	if (VB2_SUCCESS != vb2_digest_buffer(data, size, key->hash_alg,
-					     digest, digest_size))
-		return NULL;
+					   &digest_info, &digest_info_size) ||
+	    digest_info_size > VB2_MAX_DIGEST_INFO_SIZE)
+		return VB2_SIGN_DATA_DIGEST_INFO;
 
 	/* Prepend the digest info to the digest */
+	uint8_t signature_digest[VB2_MAX_DIGEST_INFO_SIZE +
+				 VB2_MAX_DIGEST_SIZE];
 	int signature_digest_len = digest_size + digest_info_size;
-	uint8_t *signature_digest = malloc(signature_digest_len);
-	if (!signature_digest)
-		return NULL;
 
 	memcpy(signature_digest, digest_info, digest_info_size);
 	memcpy(signature_digest + digest_info_size, digest, digest_size);
 
-	/* Allocate output signature */
-	struct vb2_signature *sig = (struct vb2_signature *)
-		vb2_alloc_signature(vb2_rsa_sig_size(key->sig_alg), size);
-	if (!sig) {
-		free(signature_digest);
-		return NULL;
-	}
-
 	/* Sign the signature_digest into our output buffer */
+	if (key->p11_key) {
+		if (pkcs11_sign(key->p11_key, signature_digest,
+				signature_digest_len,
+				vb2_signature_data_mutable(sig),
+				sig->sig_size))
+			return VB2_SIGN_DATA_RSA_ENCRYPT;
+		return VB2_SUCCESS;
+	}
 	int rv = RSA_private_encrypt(signature_digest_len,    /* Input length */
 				     signature_digest,        /* Input data */
 				     vb2_signature_data_mutable(sig),  /* Output sig */
 				     key->rsa_private_key,    /* Key to use */
 				     RSA_PKCS1_PADDING);      /* Padding */
-	free(signature_digest);
 
 	if (-1 == rv) {
 		fprintf(stderr, "%s: RSA_private_encrypt() failed\n", __func__);
+		return VB2_SIGN_DATA_RSA_ENCRYPT;
+	}
+
+	return VB2_SUCCESS;
+}
+
+struct vb2_signature *vb2_sign_digest(
+		const uint8_t *digest, uint32_t size,
+		const struct vb2_private_key *key)
+{
+	/* Allocate output signature */
+	struct vb2_signature *sig = (struct vb2_signature *)
+		vb2_alloc_signature(vb2_rsa_sig_size(key->sig_alg), size);
+	if (!sig)
+		return NULL;
+
+	if (VB2_SUCCESS != sign_digest_into(sig, digest, key)) {
 		free(sig);
 		return NULL;
 	}
@@ -132,3 +148,119 @@ struct vb2_signature *vb2_calculate_signature(
 	/* Return the signature */
 	return sig;
 }
+
+vb2_error_t vb2_sign_data_into(struct vb2_signature *sig,
+			       const uint8_t *data, uint32_t size,
+			       const struct vb2_private_key *key)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t digest_size = vb2_digest_size(key->hash_alg);
+
+	if (!digest_size)
+		return VB2_SIGN_DATA_DIGEST_SIZE;
+
+	/* Calculate the digest */
+	if (VB2_SUCCESS != vb2_digest_buffer(data, size, key->hash_alg,
+					     digest, digest_size))
+		return VB2_SIGN_DATA_DIGEST_FINALIZE;
+
+	sig->data_size = size;
+	return sign_digest_into(sig, digest, key);
+}
+
+struct vb2_signature *vb2_calculate_signature(
+		const uint8_t *data, uint32_t size,
+		const struct vb2_private_key *key)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t digest_size = vb2_digest_size(key->hash_alg);
+
+	/* Calculate the digest */
+	if (VB2_SUCCESS != vb2_digest_buffer(data, size, key->hash_alg,
+					     digest, digest_size))
+		return NULL;
+
+	return vb2_sign_digest(digest, size, key);
+}
+
+/* Work shared by the threads of vb2_calculate_signatures() */
+struct sign_queue {
+	pthread_mutex_t lock;
+	struct vb2_sign_request *requests;
+	uint32_t count;
+	uint32_t next;			/* Next request to take */
+	int errors;
+};
+
+static void *sign_queue_worker(void *arg)
+{
+	struct sign_queue *q = arg;
+	struct vb2_sign_request *req;
+
+	while (1) {
+		pthread_mutex_lock(&q->lock);
+		req = q->next < q->count ? &q->requests[q->next++] : NULL;
+		pthread_mutex_unlock(&q->lock);
+		if (!req)
+			return NULL;
+
+		req->sig = vb2_calculate_signature(req->data, req->size,
+						   req->key);
+		if (!req->sig) {
+			pthread_mutex_lock(&q->lock);
+			q->errors++;
+			pthread_mutex_unlock(&q->lock);
+		}
+	}
+}
+
+int vb2_calculate_signatures(struct vb2_sign_request *requests,
+			     uint32_t count, int threads)
+{
+	struct sign_queue q = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.requests = requests,
+		.count = count,
+	};
+	pthread_t *tids;
+	int started = 0;
+	int i;
+
+	if (threads <= 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? cpus : 1;
+	}
+	if (threads > count)
+		threads = count;
+
+	/* This thread is a worker too, so start one fewer. */
+	tids = threads > 1 ? calloc(threads - 1, sizeof(*tids)) : NULL;
+	for (i = 0; tids && i < threads - 1; i++) {
+		if (pthread_create(&tids[i], NULL, sign_queue_worker, &q))
+			break;
+		started++;
+	}
+
+	sign_queue_worker(&q);
+
+	for (i = 0; i < started; i++)
+		pthread_join(tids[i], NULL);
+	free(tids);
+
+	return q.errors;
+}
+
+struct vb2_signature *vb2_calculate_tree_signature(
+		const uint8_t *data, uint32_t size,
+		const struct vb2_private_key *key)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t digest_size = vb2_digest_size(key->hash_alg);
+
+	/* Calculate the root digest */
+	if (VB2_SUCCESS != vb2_digest_tree_buffer(data, size, key->hash_alg,
+						  digest, digest_size))
+		return NULL;
+
+	return vb2_sign_digest(digest, size, key);
+}
@@ -70,6 +70,12 @@ int vb2_write_nv_storage(struct vb2_context *ctx);
  * free(), or NULL if error. */
 VbSharedDataHeader* VbSharedDataRead(void);
 
+/* Return the VbSharedData buffer, read with VbSharedDataRead() on first use
+ * and kept for the life of the process.  The caller must not free it.
+ *
+ * Returns NULL if the buffer couldn't be read. */
+const VbSharedDataHeader *VbSharedDataSnapshot(void);
+
 /* Read an architecture-specific system property integer.
  *
  * Returns the property value, or -1 if error. */
@@ -54,4 +54,30 @@ uint8_t *fmap_find_by_name(uint8_t *ptr, size_t size,
 			   /* optional, return pointer to entry if not NULL */
 			   FmapAreaHeader **ah);
 
+/*
+ * Areas of an FMAP sorted by name, for callers which look up many areas in
+ * the same image.  The index points into the image, so it must be rebuilt if
+ * the FMAP itself is rewritten.
+ */
+struct fmap_index {
+	FmapHeader *fmap;
+	int nareas;
+	FmapAreaHeader **areas;
+};
+
+/*
+ * Build an index of the FMAP in the buffer.  If fmap is NULL, calls
+ * fmap_find().  Returns 0 on success, non-zero if there's no FMAP or out of
+ * memory.
+ */
+int fmap_index_init(struct fmap_index *index, uint8_t *ptr, size_t size,
+		    FmapHeader *fmap);
+
+/* Free an index built by fmap_index_init() */
+void fmap_index_free(struct fmap_index *index);
+
+/* Same as fmap_find_by_name(), but using the index */
+uint8_t *fmap_index_find(const struct fmap_index *index, uint8_t *ptr,
+			 const char *name, FmapAreaHeader **ah);
+
 #endif  /* VBOOT_REFERENCE_FMAP_H_ */
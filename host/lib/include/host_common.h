@@ -35,6 +35,33 @@ struct vb2_fw_preamble *vb2_create_fw_preamble(
 	const struct vb2_private_key *signing_key,
 	uint32_t flags);
 
+/**
+ * Return the size of the firmware preamble vb2_create_fw_preamble() would
+ * create from the given keys and body signature.
+ */
+uint32_t vb2_fw_preamble_size(const struct vb2_packed_key *kernel_subkey,
+			     const struct vb2_signature *body_signature,
+			     const struct vb2_private_key *signing_key);
+
+/**
+ * Create a firmware preamble in a caller-supplied buffer.
+ *
+ * Same as vb2_create_fw_preamble(), but builds the preamble in place, so
+ * callers creating many preambles can reuse one buffer.
+ *
+ * @param buf			Destination buffer
+ * @param buf_size		Size of buffer in bytes; must be at least
+ *				vb2_fw_preamble_size()
+ *
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+vb2_error_t vb2_create_fw_preamble_in(
+	void *buf, uint32_t buf_size,
+	uint32_t firmware_version,
+	const struct vb2_packed_key *kernel_subkey,
+	const struct vb2_signature *body_signature,
+	const struct vb2_private_key *signing_key,
+	uint32_t flags);
 
 /**
  * Create a kernel preamble.
@@ -64,4 +91,33 @@ struct vb2_kernel_preamble *vb2_create_kernel_preamble(
 	uint32_t desired_size,
 	const struct vb2_private_key *signing_key);
 
+/**
+ * Return the size of the kernel preamble vb2_create_kernel_preamble() would
+ * create, including any padding up to desired_size.
+ */
+uint32_t vb2_kernel_preamble_size(const struct vb2_signature *body_signature,
+				  uint32_t desired_size,
+				  const struct vb2_private_key *signing_key);
+
+/**
+ * Create a kernel preamble in a caller-supplied buffer.
+ *
+ * Same as vb2_create_kernel_preamble(), but builds the preamble in place.
+ * buf_size must be at least vb2_kernel_preamble_size().
+ *
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+vb2_error_t vb2_create_kernel_preamble_in(
+	void *buf, uint32_t buf_size,
+	uint32_t kernel_version,
+	uint64_t body_load_address,
+	uint64_t bootloader_address,
+	uint32_t bootloader_size,
+	const struct vb2_signature *body_signature,
+	uint64_t vmlinuz_header_address,
+	uint32_t vmlinuz_header_size,
+	uint32_t flags,
+	uint32_t desired_size,
+	const struct vb2_private_key *signing_key);
+
 #endif  /* VBOOT_REFERENCE_HOST_COMMON_H_ */
@@ -40,6 +40,29 @@ struct vb2_private_key *vb2_read_private_key_pem(
 	const char *filename,
 	enum vb2_crypto_algorithm algorithm);
 
+/**
+ * Open a private key held in a PKCS#11 token.
+ *
+ * @param spec		"MODULE:SLOT:LABEL"; see pkcs11_open_key()
+ * @param algorithm	Algorithm of the key (enum vb2_crypto_algorithm)
+ *
+ * @return The private key or NULL if error.  Caller must
+ * vb2_free_private_key() it.
+ */
+struct vb2_private_key *vb2_read_private_key_pkcs11(
+	const char *spec,
+	enum vb2_crypto_algorithm algorithm);
+
+/**
+ * Drop the parsed keys shared by vb2_read_private_key() and
+ * vb2_read_private_key_pem().
+ *
+ * Each key file is parsed once per process, and later reads of it, or of any
+ * file with the same contents, share the parsed key.  Keys already returned
+ * stay valid.
+ */
+void vb2_flush_private_key_cache(void);
+
 /**
  * Free a private key.
  *
@@ -50,6 +73,9 @@ void vb2_free_private_key(struct vb2_private_key *key);
 /**
  * Write a private key to a file in .vbprivk format.
  *
+ * Since keys are read with their CRT parameters filled in, reading a legacy
+ * key and writing it back out upgrades it to a full key.
+ *
  * @param filename	Filename to write to
  * @param key		Key to write
  *
@@ -59,9 +85,19 @@ vb2_error_t vb2_write_private_key(const char *filename,
 				  const struct vb2_private_key *key);
 
 
+/* Prefix of a vb2_read_private_key() filename naming a PKCS#11 key */
+#define PKCS11_KEY_PREFIX "pkcs11:"
+
 /**
  * Read a private key from a .vbprivk file.
  *
+ * A filename of the form "pkcs11:MODULE:SLOT:LABEL:ALGORITHM" instead opens
+ * that key with vb2_read_private_key_pkcs11(), where ALGORITHM is the number
+ * of its enum vb2_crypto_algorithm, as stored in a .vbprivk file.
+ *
+ * Keys lacking the CRT parameters (p, q, dP, dQ, qInv) get them recomputed
+ * from the modulus and exponents, which makes signing several times faster.
+ *
  * @param filename	Filename to read key from.
  *
  * @return The private key or NULL if error.  Caller must free() it.
@@ -13,6 +13,37 @@
 
 struct vb2_keyblock;
 
+/**
+ * Return the size of the keyblock vb2_create_keyblock() would create.
+ *
+ * @param data_key	Data key to store in keyblock
+ * @param signing_key	Key to sign keyblock with, or NULL
+ *
+ * @return The keyblock size in bytes.
+ */
+uint32_t vb2_keyblock_size(const struct vb2_packed_key *data_key,
+			   const struct vb2_private_key *signing_key);
+
+/**
+ * Create a keyblock header in a buffer supplied by the caller.
+ *
+ * The keyblock and its key, hash and signature are built in place, without
+ * allocating anything, so callers can carve many objects out of one buffer.
+ *
+ * @param buf		Buffer for the keyblock, aligned as for malloc()
+ * @param buf_size	Size of buf; at least vb2_keyblock_size()
+ * @param data_key	Data key to store in keyblock
+ * @param signing_key	Key to sign keyblock with.  May be NULL if keyblock
+ *			only needs a hash digest.
+ * @param flags		Keyblock flags
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+vb2_error_t vb2_create_keyblock_in(void *buf, uint32_t buf_size,
+				   const struct vb2_packed_key *data_key,
+				   const struct vb2_private_key *signing_key,
+				   uint32_t flags);
+
 /**
  * Create a keyblock header
  *
@@ -56,6 +56,37 @@ vb2_error_t WriteFile(const char* filename, const void *data, uint64_t size);
 vb2_error_t vb2_read_file(const char *filename, uint8_t **data_ptr,
 			  uint32_t *size_ptr);
 
+/* Contents of a file, mapped in place where possible */
+struct vb2_file_view {
+	uint8_t *data;
+	uint32_t size;
+	int mapped;		/* data is mmap()ed rather than malloc()ed */
+};
+
+/**
+ * Map a file into memory, so it can be parsed without copying it.
+ *
+ * Files which can't be mapped, such as pipes, are read into a buffer
+ * instead, so callers needn't care which they got.  An empty file gives
+ * NULL data of size 0.
+ *
+ * @param filename	Name of file to map
+ * @param view		On success, the file contents; release them with
+ *			vb2_unmap_file().
+ * @param copy_on_write	Non-zero to allow writing to the data.  Changes are
+ *			private, and are never written back to the file.
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+vb2_error_t vb2_map_file(const char *filename, struct vb2_file_view *view,
+			 int copy_on_write);
+
+/**
+ * Release the contents of a file from vb2_map_file().
+ *
+ * @param view		File view to release; ok if it was never mapped.
+ */
+void vb2_unmap_file(struct vb2_file_view *view);
+
 /**
  * Write data to a file from a buffer.
  *
@@ -98,4 +129,12 @@ static inline const uint32_t roundup32(uint32_t v)
  */
 uint32_t vb2_desc_size(const char *desc);
 
+/**
+ * Return the name of a boot-phase timestamp event.
+ *
+ * @param event		Event (enum vb2_timestamp_event)
+ * @return The event name, or "unknown" if not a known event.
+ */
+const char *vb2_timestamp_event_name(uint32_t event);
+
 #endif  /* VBOOT_REFERENCE_HOST_MISC_H_ */
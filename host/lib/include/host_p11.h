@@ -0,0 +1,62 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host functions for signing with keys held in a PKCS#11 token.
+ */
+
+#ifndef VBOOT_REFERENCE_HOST_P11_H_
+#define VBOOT_REFERENCE_HOST_P11_H_
+
+#include "2return_codes.h"
+#include "2sysincludes.h"
+
+/* An RSA private key in a PKCS#11 token, with a session open to it. */
+struct pkcs11_key;
+
+/**
+ * Open a session to a private key in a PKCS#11 token.
+ *
+ * The module is loaded and initialized on first use, and stays loaded while
+ * any key uses it.  Each key has its own session, so different keys may be
+ * used from different threads at once; threads sharing a key take turns.  If
+ * the PIN is set in the VBOOT_PKCS11_PIN environment variable, the session
+ * logs in with it.
+ *
+ * @param spec		"MODULE:SLOT:LABEL"; the path of the PKCS#11 module,
+ *			the slot ID of the token and the label of the key
+ *
+ * @return The key, or NULL if error.  Caller must pkcs11_close_key() it.
+ */
+struct pkcs11_key *pkcs11_open_key(const char *spec);
+
+/**
+ * Close the session to a key, and the module if nothing else uses it.
+ *
+ * @param key		Key to close; ok to pass NULL (ignored).
+ */
+void pkcs11_close_key(struct pkcs11_key *key);
+
+/**
+ * Return the size of the RSA modulus of a key, in bytes.
+ */
+uint32_t pkcs11_key_size(const struct pkcs11_key *key);
+
+/**
+ * Sign with RSA PKCS#1 v1.5 padding, as RSA_private_encrypt() does.
+ *
+ * A process forked after the key was opened gets its own session to it,
+ * since PKCS#11 sessions can't be shared with a child.
+ *
+ * @param key		Key to sign with
+ * @param data		Digest info and digest to sign
+ * @param size		Size of data in bytes
+ * @param sig		Destination for the signature
+ * @param sig_size	Size of sig; must be pkcs11_key_size(key)
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+vb2_error_t pkcs11_sign(struct pkcs11_key *key, const uint8_t *data,
+			uint32_t size, uint8_t *sig, uint32_t sig_size);
+
+#endif  /* VBOOT_REFERENCE_HOST_P11_H_ */
@@ -70,6 +70,74 @@ struct vb2_signature *vb2_sha512_signature(const uint8_t *data, uint32_t size);
 struct vb2_signature *vb2_calculate_signature(
 	const uint8_t *data, uint32_t size, const struct vb2_private_key *key);
 
+/**
+ * Sign a precomputed digest of size bytes of data.
+ *
+ * @param digest	Digest of the data, using key->hash_alg
+ * @param size		Length of the signed data in bytes
+ * @param key		Private key to use to sign data
+ *
+ * @return The signature, or NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_sign_digest(
+	const uint8_t *digest, uint32_t size, const struct vb2_private_key *key);
+
+/**
+ * Calculate a signature for the data into an existing signature.
+ *
+ * @param sig		Signature to fill in, already set up with
+ *			vb2_init_signature() to hold vb2_rsa_sig_size() bytes
+ *			for the key, usually inside the object being signed
+ * @param data		Pointer to data to sign
+ * @param size		Length of data in bytes
+ * @param key		Private key to use to sign data
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+vb2_error_t vb2_sign_data_into(struct vb2_signature *sig,
+			       const uint8_t *data, uint32_t size,
+			       const struct vb2_private_key *key);
+
+/* One signature for vb2_calculate_signatures() to calculate */
+struct vb2_sign_request {
+	const uint8_t *data;		/* Data to sign */
+	uint32_t size;			/* Length of data in bytes */
+	const struct vb2_private_key *key;	/* Key to sign it with */
+	struct vb2_signature *sig;	/* The signature, or NULL if error.
+					 * Caller must free() it. */
+};
+
+/**
+ * Calculate signatures for many requests at once, using several threads.
+ *
+ * Signing is thread-safe, so requests may share keys.  They are taken in
+ * order from a queue, which keeps threads busy when signatures take different
+ * times.
+ *
+ * @param requests	Requests to sign; each gets its sig filled in
+ * @param count		Number of requests
+ * @param threads	Number of threads to use, or 0 for one per CPU
+ *
+ * @return The number of requests which failed.
+ */
+int vb2_calculate_signatures(struct vb2_sign_request *requests,
+			     uint32_t count, int threads);
+
+/**
+ * Calculate a signature for the tree hash root digest of the data.
+ *
+ * This is the signature format used for firmware bodies when the preamble has
+ * VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH set.
+ *
+ * @param data		Pointer to data to sign
+ * @param size		Length of data in bytes
+ * @param key		Private key to use to sign data
+ *
+ * @return The signature, or NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_calculate_tree_signature(
+	const uint8_t *data, uint32_t size, const struct vb2_private_key *key);
+
 /**
  * Calculate a signature for the data using an external signer.
  *
@@ -86,4 +154,43 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
 					     uint32_t key_algorithm,
 					     const char *external_signer);
 
+/**
+ * Calculate a signature for the data into an existing signature, using an
+ * external signer.
+ *
+ * @param sig			Signature to fill in, already set up with
+ *				vb2_init_signature() to hold
+ *				vb2_rsa_sig_size() bytes for the algorithm
+ * @param data			Pointer to data to sign
+ * @param size			Length of data in bytes
+ * @param key_file		Name of file containing private key
+ * @param key_algorithm		Key algorithm
+ * @param external_signer	Path to external signer program
+ *
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+vb2_error_t vb2_external_signature_into(struct vb2_signature *sig,
+					const uint8_t *data, uint32_t size,
+					const char *key_file,
+					uint32_t key_algorithm,
+					const char *external_signer);
+
+/**
+ * Choose how vb2_external_signature() runs the external signer.
+ *
+ * By default the signer is run once per signature, as "SIGNER KEY_FILE",
+ * with the data to sign on its stdin and the signature read from its stdout.
+ *
+ * Once enabled, the signer is instead started once, as
+ * "SIGNER --persistent KEY_FILE", and reused for every signature with the
+ * same signer and key until this is disabled again or the process exits.
+ * Each request it reads from stdin is a 4-byte big-endian length followed by
+ * the data to sign, and it must answer each on stdout the same way with the
+ * signature, or with a zero length if it can't sign that data.  It should
+ * exit when it reads EOF.
+ *
+ * @param enable		Non-zero to keep the signer running
+ */
+void vb2_external_signer_persist(int enable);
+
 #endif  /* VBOOT_REFERENCE_HOST_SIGNATURE_H_ */
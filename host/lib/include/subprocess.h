@@ -115,6 +115,9 @@ struct subprocess_target subprocess_stderr;
  * &subprocess_stdin, &subprocess_stdout, or &subprocess_stderr
  * respectively.
  *
+ * Input is written and output read concurrently, so the process may
+ * produce any amount of output before it has read all of its input.
+ *
  * @return The exit status on success, or negative values on error.
  */
 int subprocess_run(const char *const argv[],
@@ -122,4 +125,44 @@ int subprocess_run(const char *const argv[],
 		   struct subprocess_target *output,
 		   struct subprocess_target *error);
 
+/**
+ * Same as subprocess_run(), but give up after timeout_ms milliseconds.
+ *
+ * A process still running at the timeout is killed, and -1 is returned
+ * with errno set to ETIMEDOUT.  A negative timeout_ms waits forever.
+ */
+int subprocess_run_timeout(const char *const argv[],
+			   struct subprocess_target *input,
+			   struct subprocess_target *output,
+			   struct subprocess_target *error,
+			   int timeout_ms);
+
+/**
+ * A process for subprocess_run_parallel() to run.  The argv, input,
+ * output and error fields are as for subprocess_run(); status is set
+ * to the exit status of the process, or a negative value on error.
+ */
+struct subprocess_job {
+	const char *const *argv;
+	struct subprocess_target *input;
+	struct subprocess_target *output;
+	struct subprocess_target *error;
+	int status;
+};
+
+/**
+ * Run several processes at once, until all of them complete.
+ *
+ * @param jobs          The processes to run.  Their targets must all be
+ *                      distinct.
+ * @param count         Number of jobs.
+ * @param timeout_ms    Milliseconds to wait for all of the jobs before
+ *                      killing the ones left, or negative to wait forever.
+ *
+ * @return 0 if every job exited with status 0, or -1 otherwise.  Check the
+ * status of each job for details.
+ */
+int subprocess_run_parallel(struct subprocess_job *jobs, size_t count,
+			    int timeout_ms);
+
 #endif  /* VBOOT_REFERENCE_SUBPROCESS_H_ */
@@ -11,6 +11,7 @@
 #include "host_key.h"
 #include "vboot_struct.h"
 
+struct ec_key_st;
 struct rsa_st;
 struct vb2_packed_key;
 struct vb2_private_key;
@@ -65,4 +66,31 @@ const char *private_key_sha1_string(const struct vb2_private_key *key);
 int vb_keyb_from_rsa(struct rsa_st *rsa_private_key,
 		     uint8_t **keyb_data, uint32_t *keyb_size);
 
+/*
+ * ECDSA P-256 keys use the same layout, with nwords = 8, N0inv = 0, and the X
+ * and Y coordinates of the public point in place of the modulus and R^2.
+ *
+ * @param ec_key	      EC key, private or public-only
+ * @param keyb_data	      Pointer to newly allocated binary blob
+ * @param keyb_size	      Size of newly allocated binary blob
+ *
+ * @return 0 on success, non-zero if the key isn't on a supported curve or
+ * memory can't be allocated.
+ */
+int vb_keyb_from_ec(struct ec_key_st *ec_key,
+		    uint8_t **keyb_data, uint32_t *keyb_size);
+
+/*
+ * Extract the binary structure from whichever RSA or EC key a private key
+ * holds.
+ *
+ * @param key		      Private key
+ * @param keyb_data	      Pointer to newly allocated binary blob
+ * @param keyb_size	      Size of newly allocated binary blob
+ *
+ * @return 0 on success, non-zero if error.
+ */
+int vb_keyb_from_private_key(const struct vb2_private_key *key,
+			     uint8_t **keyb_data, uint32_t *keyb_size);
+
 #endif  /* VBOOT_REFERENCE_UTIL_MISC_H_ */
@@ -17,19 +17,35 @@
 #include "host_signature21.h"
 #include "signature_digest.h"
 
-uint8_t* PrependDigestInfo(enum vb2_hash_algorithm hash_alg, uint8_t* digest)
+/* Write DigestInfo || digest into [out]. Returns its length, or 0 on error. */
+static uint32_t PrependDigestInfoInto(enum vb2_hash_algorithm hash_alg,
+				      const uint8_t* digest, uint8_t* out)
 {
 	const int digest_size = vb2_digest_size(hash_alg);
 	uint32_t digestinfo_size = 0;
 	const uint8_t* digestinfo = NULL;
 
 	if (VB2_SUCCESS != vb2_digest_info(hash_alg, &digestinfo,
-					   &digestinfo_size))
+					   &digestinfo_size) ||
+	    digestinfo_size > VB2_MAX_DIGEST_INFO_SIZE)
+		return 0;
+
+	memcpy(out, digestinfo, digestinfo_size);
+	memcpy(out + digestinfo_size, digest, digest_size);
+	return digestinfo_size + digest_size;
+}
+
+uint8_t* PrependDigestInfo(enum vb2_hash_algorithm hash_alg, uint8_t* digest)
+{
+	uint8_t info_digest[VB2_MAX_DIGEST_INFO_SIZE + VB2_MAX_DIGEST_SIZE];
+	uint32_t len = PrependDigestInfoInto(hash_alg, digest, info_digest);
+
+	if (!len)
 		return NULL;
 
-	uint8_t* p = malloc(digestinfo_size + digest_size);
-	memcpy(p, digestinfo, digestinfo_size);
-	memcpy(p + digestinfo_size, digest, digest_size);
+	uint8_t* p = malloc(len);
+	if (p)
+		memcpy(p, info_digest, len);
 	return p;
 }
 
@@ -59,35 +75,34 @@ uint8_t* SignatureDigest(const uint8_t* buf, uint64_t len,
 uint8_t* SignatureBuf(const uint8_t* buf, uint64_t len, const char* key_file,
 		      unsigned int algorithm)
 {
-	const enum vb2_hash_algorithm hash_alg = vb2_crypto_to_hash(algorithm);
 	FILE* key_fp = NULL;
 	RSA* key = NULL;
 	uint8_t* signature = NULL;
-	uint8_t* signature_digest = SignatureDigest(buf, len, algorithm);
-	if (!signature_digest) {
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint8_t signature_digest[VB2_MAX_DIGEST_INFO_SIZE +
+				 VB2_MAX_DIGEST_SIZE];
+	uint32_t signature_digest_len = 0;
+
+	/* Build DigestInfo || Digest on the stack; no need for a copy */
+	if (algorithm < VB2_ALG_COUNT) {
+		const enum vb2_hash_algorithm hash_alg =
+			vb2_crypto_to_hash(algorithm);
+
+		if (VB2_SUCCESS == vb2_digest_buffer(buf, len, hash_alg,
+						     digest, sizeof(digest)))
+			signature_digest_len = PrependDigestInfoInto(
+				hash_alg, digest, signature_digest);
+	}
+	if (!signature_digest_len) {
 		fprintf(stderr, "SignatureBuf(): "
 			"Couldn't get signature digest\n");
 		return NULL;
 	}
 
-	const int digest_size = vb2_digest_size(hash_alg);
-
-	uint32_t digestinfo_size = 0;
-	const uint8_t* digestinfo = NULL;
-	if (VB2_SUCCESS != vb2_digest_info(hash_alg, &digestinfo,
-					   &digestinfo_size)) {
-		fprintf(stderr, "SignatureBuf(): Couldn't get digest info\n");
-		free(signature_digest);
-		return NULL;
-	}
-
-	int signature_digest_len = digest_size + digestinfo_size;
-
 	key_fp  = fopen(key_file, "r");
 	if (!key_fp) {
 		fprintf(stderr, "SignatureBuf(): Couldn't open key file: %s\n",
 			key_file);
-		free(signature_digest);
 		return NULL;
 	}
 	if ((key = PEM_read_RSAPrivateKey(key_fp, NULL, NULL, NULL)))
@@ -109,6 +124,5 @@ uint8_t* SignatureBuf(const uint8_t* buf, uint64_t len, const char* key_file,
 	fclose(key_fp);
 	if (key)
 		RSA_free(key);
-	free(signature_digest);
 	return signature;
 }
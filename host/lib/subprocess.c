@@ -3,10 +3,14 @@
  * found in the LICENSE file.
  */
 
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "subprocess.h"
@@ -85,173 +89,360 @@ static int connect_process_target(struct subprocess_target *target, int fd)
 	return dup2(target_fd, fd);
 }
 
-static int process_target_input_buffer(struct subprocess_target *target)
-{
-	ssize_t write_rv;
-	size_t bytes_to_write;
-	char *buf;
+/* Parent side of a pipe to a process, serviced by the event loop */
+struct stream {
+	struct subprocess_target *target;
+	size_t job;		/* Index of the job the process belongs to */
+	int fd;			/* Parent end of the pipe, or -1 if closed */
+	int is_input;		/* Data flows from us to the process */
+
+	/* Pending input: data [pos, len) of buf still needs writing */
+	const char *data;
+	size_t pos;
+	size_t len;
+	char buf[MAX_CB_BUF_SIZE];
+};
+
+/* State of one process started by run_jobs() */
+struct running {
+	pid_t pid;		/* 0 once reaped */
+	int failed;
+	int status;
+	struct stream streams[3];
+};
 
+static int has_pipe(const struct subprocess_target *target)
+{
 	switch (target->type) {
 	case TARGET_BUFFER:
-		bytes_to_write = target->buffer.size;
-		break;
 	case TARGET_BUFFER_NULL_TERMINATED:
-		bytes_to_write = strlen(target->buffer.buf);
-		break;
+	case TARGET_CALLBACK:
+		return 1;
 	default:
-		return -1;
-	}
-
-	buf = target->buffer.buf;
-	while (bytes_to_write) {
-		write_rv = write(target->priv.pipefd[1], buf, bytes_to_write);
-		if (write_rv <= 0)
-			return -1;
-		buf += write_rv;
-		bytes_to_write -= write_rv;
+		return 0;
 	}
-
-	return 0;
 }
 
-static int process_target_input_cb(struct subprocess_target *target)
+static void close_stream(struct stream *stream)
 {
-	ssize_t write_rv, bytes_to_write;
-	char buf[MAX_CB_BUF_SIZE];
-	char *bufptr;
-
-	for (;;) {
-		bytes_to_write = target->callback.cb(buf, MAX_CB_BUF_SIZE,
-						     target->callback.data);
-		if (bytes_to_write < 0 || bytes_to_write > MAX_CB_BUF_SIZE)
-			return -1;
-		if (bytes_to_write == 0)
-			return 0;
-
-		bufptr = buf;
-		while (bytes_to_write) {
-			write_rv = write(target->priv.pipefd[1], bufptr,
-					 bytes_to_write);
-			if (write_rv <= 0)
-				return -1;
-			bufptr += write_rv;
-			bytes_to_write -= write_rv;
-		}
-	}
+	if (stream->fd >= 0)
+		close(stream->fd);
+	stream->fd = -1;
 }
 
-static int process_target_input(struct subprocess_target *target)
+/*
+ * Take the parent end of the pipe for [target], and prepare to service it.
+ * Returns 0 on success, -1 on error.
+ */
+static int open_stream(struct stream *stream, struct subprocess_target *target,
+		       int is_input)
 {
-	int rv;
-
-	switch (target->type) {
-	case TARGET_BUFFER:
-	case TARGET_BUFFER_NULL_TERMINATED:
-	case TARGET_CALLBACK:
-		break;
-	default:
+	stream->target = target;
+	stream->is_input = is_input;
+	stream->fd = -1;
+	if (!has_pipe(target))
 		return 0;
-	}
 
-	close(target->priv.pipefd[0]);
-	switch (target->type) {
-	case TARGET_BUFFER:
-	case TARGET_BUFFER_NULL_TERMINATED:
-		rv = process_target_input_buffer(target);
-		break;
-	case TARGET_CALLBACK:
-		rv = process_target_input_cb(target);
-		break;
-	default:
-		return -1;
+	if (is_input) {
+		stream->fd = target->priv.pipefd[1];
+		close(target->priv.pipefd[0]);
+		if (target->type == TARGET_BUFFER) {
+			stream->data = target->buffer.buf;
+			stream->len = target->buffer.size;
+		} else if (target->type == TARGET_BUFFER_NULL_TERMINATED) {
+			stream->data = target->buffer.buf;
+			stream->len = strlen(target->buffer.buf);
+		}
+	} else {
+		stream->fd = target->priv.pipefd[0];
+		close(target->priv.pipefd[1]);
+		if (target->type == TARGET_BUFFER_NULL_TERMINATED) {
+			if (target->buffer.size == 0)
+				return -1;
+			target->buffer.buf[0] = '\0';
+		}
+		if (target->type != TARGET_CALLBACK)
+			target->buffer.bytes_consumed = 0;
 	}
 
-	close(target->priv.pipefd[1]);
-	return rv;
+	/*
+	 * Never block on one pipe while another one is full, and don't leak
+	 * our ends into processes started after this one.
+	 */
+	if (fcntl(stream->fd, F_SETFL,
+		  fcntl(stream->fd, F_GETFL) | O_NONBLOCK) < 0 ||
+	    fcntl(stream->fd, F_SETFD, FD_CLOEXEC) < 0)
+		return -1;
+	return 0;
 }
 
-static int process_target_output_buffer(struct subprocess_target *target)
+/* Write what we can to the process.  Returns 0 on success, -1 on error. */
+static int service_input(struct stream *stream)
 {
-	ssize_t read_rv;
-	size_t bytes_remaining;
+	struct subprocess_target *target = stream->target;
+	ssize_t rv;
 
-	switch (target->type) {
-	case TARGET_BUFFER:
-		bytes_remaining = target->buffer.size;
-		break;
-	case TARGET_BUFFER_NULL_TERMINATED:
-		if (target->buffer.size == 0)
-			return -1;
-		bytes_remaining = target->buffer.size - 1;
-		break;
-	default:
-		return 0;
-	}
+	for (;;) {
+		if (stream->pos == stream->len) {
+			if (target->type != TARGET_CALLBACK)
+				break;
+			rv = target->callback.cb(stream->buf, MAX_CB_BUF_SIZE,
+						 target->callback.data);
+			if (rv < 0 || rv > MAX_CB_BUF_SIZE)
+				return -1;
+			if (rv == 0)
+				break;
+			stream->data = stream->buf;
+			stream->pos = 0;
+			stream->len = rv;
+		}
 
-	target->buffer.bytes_consumed = 0;
-	while (bytes_remaining) {
-		read_rv = read(
-			target->priv.pipefd[0],
-			target->buffer.buf + target->buffer.bytes_consumed,
-			bytes_remaining);
-		if (read_rv < 0)
+		rv = write(stream->fd, stream->data + stream->pos,
+			   stream->len - stream->pos);
+		if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		if (rv <= 0)
 			return -1;
-		if (read_rv == 0)
-			break;
-		target->buffer.bytes_consumed += read_rv;
-		bytes_remaining -= read_rv;
+		stream->pos += rv;
 	}
 
-	if (target->type == TARGET_BUFFER_NULL_TERMINATED)
-		target->buffer.buf[target->buffer.bytes_consumed] = '\0';
+	/* All written; send EOF to the process. */
+	close_stream(stream);
 	return 0;
 }
 
-static int process_target_output_cb(struct subprocess_target *target)
+/* Read what we can from the process.  Returns 0 on success, -1 on error. */
+static int service_output(struct stream *stream)
 {
-	char buf[MAX_CB_BUF_SIZE];
+	struct subprocess_target *target = stream->target;
+	size_t space;
 	ssize_t rv;
 
 	for (;;) {
-		rv = read(target->priv.pipefd[0], buf, MAX_CB_BUF_SIZE);
+		if (target->type == TARGET_CALLBACK) {
+			rv = read(stream->fd, stream->buf, MAX_CB_BUF_SIZE);
+		} else {
+			space = target->buffer.size -
+				target->buffer.bytes_consumed;
+			if (target->type == TARGET_BUFFER_NULL_TERMINATED)
+				space--;
+			/* Full; whatever else the process writes is lost. */
+			if (!space)
+				break;
+			rv = read(stream->fd, target->buffer.buf +
+				  target->buffer.bytes_consumed, space);
+		}
+		if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
 		if (rv < 0)
 			return -1;
 		if (rv == 0)
 			break;
-		if (target->callback.cb(buf, rv, target->callback.data) < 0)
-			return -1;
+
+		if (target->type == TARGET_CALLBACK) {
+			if (target->callback.cb(stream->buf, rv,
+						target->callback.data) < 0)
+				return -1;
+			continue;
+		}
+		target->buffer.bytes_consumed += rv;
+		if (target->type == TARGET_BUFFER_NULL_TERMINATED)
+			target->buffer.buf[target->buffer.bytes_consumed] =
+				'\0';
 	}
 
+	close_stream(stream);
 	return 0;
 }
 
-static int process_target_output(struct subprocess_target *target)
+/* Start [job]'s process and fill in [run].  Returns 0 on success. */
+static int start_job(struct subprocess_job *job, struct running *run)
 {
-	int rv;
+	struct subprocess_target *input = job->input;
+	struct subprocess_target *output = job->output;
+	struct subprocess_target *error = job->error;
+	pid_t pid;
+	int i;
 
-	switch (target->type) {
-	case TARGET_BUFFER:
-	case TARGET_BUFFER_NULL_TERMINATED:
-	case TARGET_CALLBACK:
-		break;
-	default:
-		return 0;
+	for (i = 0; i < 3; i++)
+		run->streams[i].fd = -1;
+
+	if (!input)
+		input = &subprocess_stdin;
+	if (!output)
+		output = &subprocess_stdout;
+	if (!error)
+		error = &subprocess_stderr;
+
+	if (init_target_private(input) < 0)
+		return -1;
+	if (init_target_private(output) < 0)
+		return -1;
+	if (init_target_private(error) < 0)
+		return -1;
+
+	if ((pid = fork()) < 0)
+		return -1;
+	if (pid == 0) {
+		/* Child process */
+		if (connect_process_target(input, STDIN_FILENO) < 0 ||
+		    connect_process_target(output, STDOUT_FILENO) < 0 ||
+		    connect_process_target(error, STDERR_FILENO) < 0) {
+			perror(program_name ? program_name : "subprocess");
+			exit(127);
+		}
+		execvp(*job->argv, (char *const *)job->argv);
+		perror(program_name ? program_name : "subprocess");
+		exit(127);
 	}
 
-	close(target->priv.pipefd[1]);
-	switch (target->type) {
-	case TARGET_BUFFER:
-	case TARGET_BUFFER_NULL_TERMINATED:
-		rv = process_target_output_buffer(target);
-		break;
-	case TARGET_CALLBACK:
-		rv = process_target_output_cb(target);
-		break;
-	default:
+	/* Parent process */
+	run->pid = pid;
+	if (open_stream(&run->streams[0], input, 1) < 0 ||
+	    open_stream(&run->streams[1], output, 0) < 0 ||
+	    open_stream(&run->streams[2], error, 0) < 0)
 		return -1;
+	return 0;
+}
+
+/* Milliseconds since an arbitrary fixed point */
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* How often to check on processes which closed their pipes but still run */
+#define REAP_POLL_MS 10
+
+/*
+ * Run [count] jobs to completion, servicing all their pipes concurrently.
+ * Fills in the status of each job.  Returns 0 if every job exited with
+ * status 0, -1 otherwise.
+ */
+static int run_jobs(struct subprocess_job *jobs, size_t count, int timeout_ms)
+{
+	struct running *runs = calloc(count, sizeof(*runs));
+	struct pollfd *fds = calloc(count * 3 + 1, sizeof(*fds));
+	struct stream **fd_streams = calloc(count * 3 + 1, sizeof(*fd_streams));
+	long long deadline = timeout_ms < 0 ? 0 : now_ms() + timeout_ms;
+	int saved_errno = 0;
+	size_t i, nfds;
+	int j, rv = 0, active;
+
+	if (!runs || !fds || !fd_streams) {
+		free(runs);
+		free(fds);
+		free(fd_streams);
+		for (i = 0; i < count; i++)
+			jobs[i].status = -1;
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < 3; j++)
+			runs[i].streams[j].job = i;
+		if (start_job(&jobs[i], &runs[i]) < 0) {
+			saved_errno = errno;
+			runs[i].failed = 1;
+			for (j = 0; j < 3; j++)
+				close_stream(&runs[i].streams[j]);
+		}
 	}
 
-	close(target->priv.pipefd[0]);
+	for (;;) {
+		int wait_ms = -1;
+
+		/* Collect the pipes still open, and reap finished processes */
+		nfds = 0;
+		active = 0;
+		for (i = 0; i < count; i++) {
+			struct running *run = &runs[i];
+			int status;
+
+			for (j = 0; j < 3; j++) {
+				struct stream *stream = &run->streams[j];
+
+				if (stream->fd < 0)
+					continue;
+				fds[nfds].fd = stream->fd;
+				fds[nfds].events =
+					stream->is_input ? POLLOUT : POLLIN;
+				fds[nfds].revents = 0;
+				fd_streams[nfds++] = stream;
+			}
+
+			if (run->pid &&
+			    waitpid(run->pid, &status, WNOHANG) == run->pid) {
+				run->pid = 0;
+				run->status = status;
+			}
+			if (run->pid)
+				active = 1;
+		}
+		if (!nfds && !active)
+			break;
+
+		if (timeout_ms >= 0) {
+			wait_ms = deadline - now_ms();
+			if (wait_ms <= 0) {
+				saved_errno = ETIMEDOUT;
+				break;
+			}
+		}
+		if (!nfds && (wait_ms < 0 || wait_ms > REAP_POLL_MS))
+			wait_ms = REAP_POLL_MS;
+
+		if (poll(fds, nfds, wait_ms) < 0) {
+			if (errno == EINTR)
+				continue;
+			saved_errno = errno;
+			break;
+		}
+
+		for (i = 0; i < nfds; i++) {
+			struct stream *stream = fd_streams[i];
+
+			if (!fds[i].revents)
+				continue;
+			if ((stream->is_input ? service_input(stream) :
+			     service_output(stream)) == 0)
+				continue;
+
+			/* Give up on this process, but let it finish. */
+			saved_errno = errno;
+			runs[stream->job].failed = 1;
+			close_stream(stream);
+		}
+	}
+
+	/* Stop anything left over on timeout or error */
+	for (i = 0; i < count; i++) {
+		struct running *run = &runs[i];
+
+		for (j = 0; j < 3; j++)
+			close_stream(&run->streams[j]);
+		if (run->pid) {
+			kill(run->pid, SIGKILL);
+			waitpid(run->pid, NULL, 0);
+			run->failed = 1;
+		}
+
+		if (!run->failed && WIFEXITED(run->status))
+			jobs[i].status = WEXITSTATUS(run->status);
+		else
+			jobs[i].status = -1;
+		if (jobs[i].status)
+			rv = -1;
+	}
+
+	free(runs);
+	free(fds);
+	free(fd_streams);
+	if (saved_errno)
+		errno = saved_errno;
 	return rv;
 }
 
@@ -274,62 +465,38 @@ struct subprocess_target subprocess_stderr = {
 	.fd = STDERR_FILENO,
 };
 
+int subprocess_run_parallel(struct subprocess_job *jobs, size_t count,
+			    int timeout_ms)
+{
+	return run_jobs(jobs, count, timeout_ms);
+}
+
+int subprocess_run_timeout(const char *const argv[],
+			   struct subprocess_target *input,
+			   struct subprocess_target *output,
+			   struct subprocess_target *error,
+			   int timeout_ms)
+{
+	struct subprocess_job job = {
+		.argv = argv,
+		.input = input,
+		.output = output,
+		.error = error,
+	};
+
+	if (run_jobs(&job, 1, timeout_ms) < 0 && job.status < 0) {
+		if (program_name)
+			perror(program_name);
+		else
+			perror("subprocess");
+	}
+	return job.status;
+}
+
 int subprocess_run(const char *const argv[],
 		   struct subprocess_target *input,
 		   struct subprocess_target *output,
 		   struct subprocess_target *error)
 {
-	int status;
-	pid_t pid = -1;
-
-	if (!input)
-		input = &subprocess_stdin;
-	if (!output)
-		output = &subprocess_stdout;
-	if (!error)
-		error = &subprocess_stderr;
-
-	if (init_target_private(input) < 0)
-		goto fail;
-	if (init_target_private(output) < 0)
-		goto fail;
-	if (init_target_private(error) < 0)
-		goto fail;
-
-	if ((pid = fork()) < 0)
-		goto fail;
-	if (pid == 0) {
-		/* Child process */
-		if (connect_process_target(input, STDIN_FILENO) < 0)
-			goto fail;
-		if (connect_process_target(output, STDOUT_FILENO) < 0)
-			goto fail;
-		if (connect_process_target(error, STDERR_FILENO) < 0)
-			goto fail;
-		execvp(*argv, (char *const *)argv);
-		goto fail;
-	}
-
-	/* Parent process */
-	if (process_target_input(input) < 0)
-		goto fail;
-	if (process_target_output(output) < 0)
-		goto fail;
-	if (process_target_output(error) < 0)
-		goto fail;
-
-	if (waitpid(pid, &status, 0) < 0)
-		goto fail;
-
-	if (WIFEXITED(status))
-		return WEXITSTATUS(status);
-
- fail:
-	if (program_name)
-		perror(program_name);
-	else
-		perror("subprocess");
-	if (pid == 0)
-		exit(127);
-	return -1;
+	return subprocess_run_timeout(argv, input, output, error, -1);
 }
@@ -6,6 +6,8 @@
  */
 
 #include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
 #include <openssl/rsa.h>
 
 #include <stdio.h>
@@ -14,6 +16,7 @@
 #include <unistd.h>
 
 #include "2common.h"
+#include "2ecdsa.h"
 #include "2sha.h"
 #include "2sysincludes.h"
 #include "host_common.h"
@@ -46,10 +49,8 @@ const char *private_key_sha1_string(const struct vb2_private_key *key)
 	uint8_t digest[VB2_SHA1_DIGEST_SIZE];
 	static char dest[VB2_SHA1_DIGEST_SIZE * 2 + 1];
 
-	if (!key->rsa_private_key ||
-	    vb_keyb_from_rsa(key->rsa_private_key, &buf, &buflen)) {
+	if (vb_keyb_from_private_key(key, &buf, &buflen))
 		return "<error>";
-	}
 
 	vb2_digest_buffer(buf, buflen, VB2_HASH_SHA1, digest, sizeof(digest));
 
@@ -176,3 +177,57 @@ done:
 
 	return retval;
 }
+
+int vb_keyb_from_ec(struct ec_key_st *ec_key,
+		    uint8_t **keyb_data, uint32_t *keyb_size)
+{
+	const EC_POINT *point = EC_KEY_get0_public_key(ec_key);
+	const EC_GROUP *group = EC_KEY_get0_group(ec_key);
+	uint8_t bytes[1 + 2 * VB2_P256_BYTES];
+	uint32_t bufsize = (2 + 2 * VB2_P256_WORDS) * sizeof(uint32_t);
+	uint32_t *outbuf;
+	const uint8_t *p;
+	int i;
+
+	if (!point || !group ||
+	    EC_GROUP_get_curve_name(group) != NID_X9_62_prime256v1)
+		return 1;
+
+	/* Uncompressed encoding is 0x04, then big endian X and Y */
+	if (EC_POINT_point2oct(group, point, POINT_CONVERSION_UNCOMPRESSED,
+			       bytes, sizeof(bytes), NULL) != sizeof(bytes))
+		return 1;
+
+	outbuf = malloc(bufsize);
+	if (!outbuf)
+		return 1;
+
+	outbuf[0] = VB2_P256_WORDS;
+	outbuf[1] = 0;
+
+	/* Write X and Y as little endian arrays of integers. */
+	for (i = 0; i < 2 * VB2_P256_WORDS; i++) {
+		int word = i % VB2_P256_WORDS;
+
+		p = bytes + 1 + (i / VB2_P256_WORDS) * VB2_P256_BYTES +
+			(VB2_P256_WORDS - 1 - word) * sizeof(uint32_t);
+		outbuf[2 + i] = ((uint32_t)p[0] << 24) |
+			((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	}
+
+	*keyb_data = (uint8_t *)outbuf;
+	*keyb_size = bufsize;
+	return 0;
+}
+
+int vb_keyb_from_private_key(const struct vb2_private_key *key,
+			     uint8_t **keyb_data, uint32_t *keyb_size)
+{
+	if (key->ec_private_key)
+		return vb_keyb_from_ec(key->ec_private_key,
+				       keyb_data, keyb_size);
+	if (key->rsa_private_key)
+		return vb_keyb_from_rsa(key->rsa_private_key,
+					keyb_data, keyb_size);
+	return 1;
+}
@@ -6,6 +6,7 @@
  */
 
 #include "2common.h"
+#include "2ecdsa.h"
 #include "2rsa.h"
 #include "2sha.h"
 #include "2sysincludes.h"
@@ -125,6 +126,55 @@ vb2_error_t vb21_verify_common_subobject(const void *parent,
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb21_verify_members(const void *parent,
+				struct vb21_member *members, uint32_t count)
+{
+	const uint8_t *base = parent;
+	const struct vb21_member *prev = NULL;
+	uint32_t min_offset = 0;
+	uint32_t i, done;
+	vb2_error_t rv;
+
+	/*
+	 * Walk the members in offset order (ties broken by position in the
+	 * array), so each one only has to start past the end of the last.
+	 * Member lists are a handful of entries, so a selection walk is
+	 * cheaper than sorting a copy.
+	 */
+	for (done = 0; done < count; done++) {
+		struct vb21_member *m = NULL;
+
+		for (i = 0; i < count; i++) {
+			struct vb21_member *t = &members[i];
+
+			if (prev && (t->offset < prev->offset ||
+				     (t->offset == prev->offset && t <= prev)))
+				continue;
+			if (!m || t->offset < m->offset)
+				m = t;
+		}
+
+		if (m->subobject) {
+			rv = vb21_verify_common_subobject(parent, &min_offset,
+							  m->offset);
+			if (rv)
+				return rv;
+			m->size = ((const struct vb21_struct_common *)
+				   (base + m->offset))->total_size;
+		} else {
+			rv = vb21_verify_common_member(parent, &min_offset,
+						       m->offset, m->size);
+			if (rv)
+				return rv;
+		}
+
+		m->data = base + m->offset;
+		prev = m;
+	}
+
+	return VB2_SUCCESS;
+}
+
 uint32_t vb2_sig_size(enum vb2_signature_algorithm sig_alg,
 		      enum vb2_hash_algorithm hash_alg)
 {
@@ -138,6 +188,9 @@ uint32_t vb2_sig_size(enum vb2_signature_algorithm sig_alg,
 	if (sig_alg == VB2_SIG_NONE)
 		return digest_size;
 
+	if (sig_alg == VB2_SIG_ECDSA_P256)
+		return vb2_ecdsa_sig_size(sig_alg);
+
 	return vb2_rsa_sig_size(sig_alg);
 }
 
@@ -173,7 +226,10 @@ const struct vb2_id *vb2_hash_id(enum vb2_hash_algorithm hash_alg)
 vb2_error_t vb21_verify_signature(const struct vb21_signature *sig,
 				  uint32_t size)
 {
-	uint32_t min_offset = 0;
+	struct vb21_member data = {
+		.offset = sig->sig_offset,
+		.size = sig->sig_size,
+	};
 	uint32_t expect_sig_size;
 	vb2_error_t rv;
 
@@ -199,8 +255,7 @@ vb2_error_t vb21_verify_signature(const struct vb21_signature *sig,
 		return VB2_ERROR_SIG_HEADER_SIZE;
 
 	/* Make sure signature data is inside */
-	rv = vb21_verify_common_member(sig, &min_offset,
-				      sig->sig_offset, sig->sig_size);
+	rv = vb21_verify_members(sig, &data, 1);
 	if (rv)
 		return rv;
 
@@ -247,6 +302,11 @@ vb2_error_t vb21_verify_digest(const struct vb2_public_key *key,
 			return VB2_ERROR_VDATA_VERIFY_DIGEST;
 
 		return VB2_SUCCESS;
+	} else if (key->sig_alg == VB2_SIG_ECDSA_P256) {
+		/* ECDSA-signed digest */
+		return vb2_ecdsa_verify_digest(key,
+					       vb21_signature_data(sig),
+					       digest);
 	} else {
 		/* RSA-signed digest */
 		return vb2_rsa_verify_digest(key,
@@ -301,3 +361,132 @@ vb2_error_t vb21_verify_data(const void *data, uint32_t size,
 
 	return vb21_verify_digest(key, sig, digest, &wblocal);
 }
+
+vb2_error_t vb21_verify_object_multiple(uint8_t *buf, uint32_t sig_offset,
+					const struct vb2_public_key **key_list,
+					uint32_t key_count,
+					const struct vb2_workbuf *wb)
+{
+	/* Digests of the object, calculated once for each hash algorithm */
+	uint8_t digests[VB2_HASH_ALG_COUNT][VB2_MAX_DIGEST_SIZE];
+	uint8_t have_digest[VB2_HASH_ALG_COUNT] = {0};
+	uint32_t sig_next = sig_offset;
+	uint32_t i;
+	vb2_error_t rv;
+
+	for (i = 0; i < key_count; i++) {
+		const struct vb2_public_key *key = key_list[i];
+		struct vb21_member m = {
+			.offset = sig_next,
+			.subobject = 1,
+		};
+		struct vb21_signature *sig;
+
+		/* Signatures are packed one after another past the data */
+		rv = vb21_verify_members(buf, &m, 1);
+		if (rv)
+			return rv;
+
+		sig = (struct vb21_signature *)(buf + sig_next);
+		rv = vb21_verify_signature(sig, m.size);
+		if (rv)
+			return rv;
+
+		if (sig->data_size != sig_offset)
+			return VB2_ERROR_VDATA_SIZE;
+
+		if (key->hash_alg >= VB2_HASH_ALG_COUNT ||
+		    !vb2_digest_size(key->hash_alg))
+			return VB2_ERROR_VDATA_DIGEST_SIZE;
+
+		if (!have_digest[key->hash_alg]) {
+			rv = vb2_digest_buffer(buf, sig_offset, key->hash_alg,
+					       digests[key->hash_alg],
+					       VB2_MAX_DIGEST_SIZE);
+			if (rv)
+				return rv;
+			have_digest[key->hash_alg] = 1;
+		}
+
+		rv = vb21_verify_digest(key, sig, digests[key->hash_alg], wb);
+		if (rv)
+			return rv;
+
+		sig_next += m.size;
+	}
+
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb21_verify_hashes(const void *data, uint32_t size,
+			       const struct vb21_signature *const *hashes,
+			       uint32_t count,
+			       enum vb2_hash_algorithm hash_alg,
+			       const struct vb2_workbuf *wb)
+{
+	struct vb2_workbuf wblocal = *wb;
+	struct vb2_digest_context *dc;
+	const struct vb21_signature **todo;
+	const uint8_t *buf = data;
+	uint8_t *digest;
+	uint32_t used = 0;
+	uint32_t len, i;
+	vb2_error_t rv;
+
+	todo = vb2_workbuf_alloc(&wblocal, count * sizeof(*todo));
+	digest = vb2_workbuf_alloc(&wblocal, VB2_MAX_DIGEST_SIZE);
+	if (!todo || !digest)
+		return VB2_ERROR_VDATA_WORKBUF_DIGEST;
+
+	/* Check each hash entry before reading any data */
+	for (i = 0; i < count; i++) {
+		const struct vb21_signature *sig = hashes[i];
+
+		if (hash_alg != VB2_HASH_INVALID && sig->hash_alg != hash_alg)
+			continue;
+		if (sig->sig_alg != VB2_SIG_NONE)
+			return VB2_ERROR_VDATA_ALGORITHM;
+		if (sig->data_size != size)
+			return VB2_ERROR_VDATA_SIZE;
+		if (!vb2_digest_size(sig->hash_alg))
+			return VB2_ERROR_VDATA_DIGEST_SIZE;
+		if (sig->sig_size != vb2_digest_size(sig->hash_alg))
+			return VB2_ERROR_VDATA_SIG_SIZE;
+		todo[used++] = sig;
+	}
+	if (!used)
+		return VB2_ERROR_VDATA_NO_HASHES;
+
+	dc = vb2_workbuf_alloc(&wblocal, used * sizeof(*dc));
+	if (!dc)
+		return VB2_ERROR_VDATA_WORKBUF_HASHING;
+
+	for (i = 0; i < used; i++) {
+		rv = vb2_digest_init(&dc[i], todo[i]->hash_alg);
+		if (rv)
+			return rv;
+	}
+
+	while (size) {
+		len = VB2_MIN(size, VB21_VERIFY_HASHES_STRIDE);
+		for (i = 0; i < used; i++) {
+			rv = vb2_digest_extend(&dc[i], buf, len);
+			if (rv)
+				return rv;
+		}
+		buf += len;
+		size -= len;
+	}
+
+	for (i = 0; i < used; i++) {
+		rv = vb2_digest_finalize(&dc[i], digest, todo[i]->sig_size);
+		if (rv)
+			return rv;
+		if (vb2_safe_memcmp((const uint8_t *)todo[i] +
+				    todo[i]->sig_offset,
+				    digest, todo[i]->sig_size))
+			return VB2_ERROR_VDATA_VERIFY_DIGEST;
+	}
+
+	return VB2_SUCCESS;
+}
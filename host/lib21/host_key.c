@@ -7,6 +7,8 @@
 
 #include <stdio.h>
 
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
 #include <openssl/pem.h>
 
 #include "2common.h"
@@ -17,6 +19,7 @@
 #include "host_common21.h"
 #include "host_key21.h"
 #include "host_misc.h"
+#include "host_p11.h"
 #include "openssl_compat.h"
 
 const struct vb2_text_vs_enum vb2_text_vs_sig[] = {
@@ -26,6 +29,7 @@ const struct vb2_text_vs_enum vb2_text_vs_sig[] = {
 	{"RSA8192", VB2_SIG_RSA8192},
 	{"RSA2048EXP3", VB2_SIG_RSA2048_EXP3},
 	{"RSA3072EXP3", VB2_SIG_RSA3072_EXP3},
+	{"ECDSA-P256", VB2_SIG_ECDSA_P256},
 	{0, 0}
 };
 
@@ -132,6 +136,11 @@ void vb2_private_key_free(struct vb2_private_key *key)
 	if (key->rsa_private_key)
 		RSA_free(key->rsa_private_key);
 
+	if (key->ec_private_key)
+		EC_KEY_free(key->ec_private_key);
+
+	pkcs11_close_key(key->p11_key);
+
 	if (key->desc)
 		free(key->desc);
 
@@ -143,9 +152,12 @@ vb2_error_t vb21_private_key_unpack(struct vb2_private_key **key_ptr,
 {
 	const struct vb21_packed_private_key *pkey =
 		(const struct vb21_packed_private_key *)buf;
+	struct vb21_member data = {
+		.offset = pkey->key_offset,
+		.size = pkey->key_size,
+	};
 	struct vb2_private_key *key;
 	const unsigned char *start;
-	uint32_t min_offset = 0;
 
 	*key_ptr = NULL;
 
@@ -161,8 +173,7 @@ vb2_error_t vb21_private_key_unpack(struct vb2_private_key **key_ptr,
 		return VB2_ERROR_UNPACK_PRIVATE_KEY_HEADER;
 
 	/* Make sure key data is inside */
-	if (vb21_verify_common_member(pkey, &min_offset,
-				     pkey->key_offset, pkey->key_size))
+	if (vb21_verify_members(pkey, &data, 1))
 		return VB2_ERROR_UNPACK_PRIVATE_KEY_DATA;
 
 	/*
@@ -184,14 +195,22 @@ vb2_error_t vb21_private_key_unpack(struct vb2_private_key **key_ptr,
 	key->hash_alg = pkey->hash_alg;
 	key->id = pkey->id;
 
-	/* Unpack RSA key */
+	/* Unpack RSA or EC key */
 	if (pkey->sig_alg == VB2_SIG_NONE) {
 		if (pkey->key_size != 0) {
 			free(key);
 			return VB2_ERROR_UNPACK_PRIVATE_KEY_HASH;
 		}
+	} else if (pkey->sig_alg == VB2_SIG_ECDSA_P256) {
+		start = data.data;
+		key->ec_private_key = d2i_ECPrivateKey(0, &start,
+						       pkey->key_size);
+		if (!key->ec_private_key) {
+			free(key);
+			return VB2_ERROR_UNPACK_PRIVATE_KEY_EC;
+		}
 	} else {
-		start = (const unsigned char *)(buf + pkey->key_offset);
+		start = data.data;
 		key->rsa_private_key = d2i_RSAPrivateKey(0, &start,
 							 pkey->key_size);
 		if (!key->rsa_private_key) {
@@ -216,19 +235,18 @@ vb2_error_t vb21_private_key_unpack(struct vb2_private_key **key_ptr,
 vb2_error_t vb21_private_key_read(struct vb2_private_key **key_ptr,
 				  const char *filename)
 {
-	uint32_t size = 0;
-	uint8_t *buf = NULL;
+	struct vb2_file_view view;
 	vb2_error_t rv;
 
 	*key_ptr = NULL;
 
-	rv = vb2_read_file(filename, &buf, &size);
+	rv = vb2_map_file(filename, &view, 0);
 	if (rv)
 		return rv;
 
-	rv = vb21_private_key_unpack(key_ptr, buf, size);
+	rv = vb21_private_key_unpack(key_ptr, view.data, view.size);
 
-	free(buf);
+	vb2_unmap_file(&view);
 
 	return rv;
 }
@@ -254,9 +272,17 @@ vb2_error_t vb2_private_key_read_pem(struct vb2_private_key **key_ptr,
 	}
 
 	key->rsa_private_key = PEM_read_RSAPrivateKey(f, NULL, NULL, NULL);
+
+	/* Callers pick the RSA algorithm; EC keys only come in one size */
+	if (!key->rsa_private_key && !fseek(f, 0, SEEK_SET)) {
+		key->ec_private_key = PEM_read_ECPrivateKey(f, NULL, NULL,
+							    NULL);
+		if (key->ec_private_key)
+			key->sig_alg = vb2_ec_sig_alg(key->ec_private_key);
+	}
 	fclose(f);
 
-	if (!key->rsa_private_key) {
+	if (!key->rsa_private_key && !key->ec_private_key) {
 		free(key);
 		return VB2_ERROR_READ_PEM_RSA;
 	}
@@ -295,29 +321,34 @@ vb2_error_t vb21_private_key_write(const struct vb2_private_key *key,
 		.id = key->id,
 	};
 	uint8_t *buf;
-	uint8_t *rsabuf = NULL;
-	int rsalen = 0;
+	uint8_t *keybuf = NULL;
+	int keylen = 0;
 	vb2_error_t rv;
 
 	memcpy(&pkey.id, &key->id, sizeof(pkey.id));
 
 	pkey.c.desc_size = vb2_desc_size(key->desc);
 
-	if (key->sig_alg != VB2_SIG_NONE) {
+	if (key->sig_alg == VB2_SIG_ECDSA_P256) {
+		/* Pack EC key */
+		keylen = i2d_ECPrivateKey(key->ec_private_key, &keybuf);
+		if (keylen <= 0 || !keybuf)
+			return VB2_ERROR_PRIVATE_KEY_WRITE_EC;
+	} else if (key->sig_alg != VB2_SIG_NONE) {
 		/* Pack RSA key */
-		rsalen = i2d_RSAPrivateKey(key->rsa_private_key, &rsabuf);
-		if (rsalen <= 0 || !rsabuf)
+		keylen = i2d_RSAPrivateKey(key->rsa_private_key, &keybuf);
+		if (keylen <= 0 || !keybuf)
 			return VB2_ERROR_PRIVATE_KEY_WRITE_RSA;
 	}
 
 	pkey.key_offset = pkey.c.fixed_size + pkey.c.desc_size;
-	pkey.key_size = roundup32(rsalen);
+	pkey.key_size = roundup32(keylen);
 	pkey.c.total_size = pkey.key_offset + pkey.key_size;
 
 	/* Pack private key */
 	buf = calloc(1, pkey.c.total_size);
 	if (!buf) {
-		free(rsabuf);
+		free(keybuf);
 		return VB2_ERROR_PRIVATE_KEY_WRITE_ALLOC;
 	}
 
@@ -327,9 +358,9 @@ vb2_error_t vb21_private_key_write(const struct vb2_private_key *key,
 	if (pkey.c.desc_size)
 		strcpy((char *)buf + pkey.c.fixed_size, key->desc);
 
-	if (rsabuf) {
-		memcpy(buf + pkey.key_offset, rsabuf, rsalen);
-		free(rsabuf);
+	if (keybuf) {
+		memcpy(buf + pkey.key_offset, keybuf, keylen);
+		free(keybuf);
 	}
 
 	rv = vb21_write_object(filename, buf);
@@ -433,14 +464,16 @@ vb2_error_t vb2_public_key_read_keyb(struct vb2_public_key **key_ptr,
 				     const char *filename)
 {
 	struct vb2_public_key *key = NULL;
-	uint8_t *key_data, *key_buf;
+	struct vb2_file_view view;
+	uint8_t *key_buf;
 	uint32_t key_size;
 	enum vb2_signature_algorithm sig_alg;
 
 	*key_ptr = NULL;
 
-	if (vb2_read_file(filename, &key_data, &key_size))
+	if (vb2_map_file(filename, &view, 0))
 		return VB2_ERROR_READ_KEYB_DATA;
+	key_size = view.size;
 
 	/* Guess the signature algorithm from the key size
 	 * Note: This only considers exponent F4 keys, as there is no way to
@@ -451,19 +484,23 @@ vb2_error_t vb2_public_key_read_keyb(struct vb2_public_key **key_ptr,
 			break;
 	}
 	if (sig_alg > VB2_SIG_RSA8192) {
-		free(key_data);
-		return VB2_ERROR_READ_KEYB_SIZE;
+		/* ECDSA keys are smaller than any RSA key */
+		if (key_size != vb2_packed_key_size(VB2_SIG_ECDSA_P256)) {
+			vb2_unmap_file(&view);
+			return VB2_ERROR_READ_KEYB_SIZE;
+		}
+		sig_alg = VB2_SIG_ECDSA_P256;
 	}
 
 	if (vb2_public_key_alloc(&key, sig_alg)) {
-		free(key_data);
+		vb2_unmap_file(&view);
 		return VB2_ERROR_READ_KEYB_ALLOC;
 	}
 
 	/* Copy data from the file buffer to the public key buffer */
 	key_buf = vb2_public_key_packed_data(key);
-	memcpy(key_buf, key_data, key_size);
-	free(key_data);
+	memcpy(key_buf, view.data, key_size);
+	vb2_unmap_file(&view);
 
 	if (vb2_unpack_key_data(key, key_buf, key_size)) {
 		vb2_public_key_free(key);
@@ -636,6 +673,16 @@ enum vb2_signature_algorithm vb2_rsa_sig_alg(struct rsa_st *rsa)
 	return VB2_SIG_INVALID;
 }
 
+enum vb2_signature_algorithm vb2_ec_sig_alg(struct ec_key_st *ec)
+{
+	const EC_GROUP *group = EC_KEY_get0_group(ec);
+
+	if (group && EC_GROUP_get_curve_name(group) == NID_X9_62_prime256v1)
+		return VB2_SIG_ECDSA_P256;
+
+	return VB2_SIG_INVALID;
+}
+
 vb2_error_t vb21_public_key_write(const struct vb2_public_key *key,
 				  const char *filename)
 {
@@ -657,8 +704,11 @@ vb2_error_t vb21_unpack_key(struct vb2_public_key *key, const uint8_t *buf,
 {
 	const struct vb21_packed_key *pkey =
 		(const struct vb21_packed_key *)buf;
+	struct vb21_member data = {
+		.offset = pkey->key_offset,
+		.size = pkey->key_size,
+	};
 	uint32_t sig_size;
-	uint32_t min_offset = 0;
 	vb2_error_t rv;
 
 	/* Check magic number */
@@ -670,8 +720,7 @@ vb2_error_t vb21_unpack_key(struct vb2_public_key *key, const uint8_t *buf,
 		return rv;
 
 	/* Make sure key data is inside */
-	rv = vb21_verify_common_member(pkey, &min_offset,
-				       pkey->key_offset, pkey->key_size);
+	rv = vb21_verify_members(pkey, &data, 1);
 	if (rv)
 		return rv;
 
@@ -690,13 +739,10 @@ vb2_error_t vb21_unpack_key(struct vb2_public_key *key, const uint8_t *buf,
 
 	key->sig_alg = pkey->sig_alg;
 	if (key->sig_alg != VB2_SIG_NONE) {
-		sig_size = vb2_rsa_sig_size(key->sig_alg);
+		sig_size = vb2_sig_size(key->sig_alg, key->hash_alg);
 		if (!sig_size)
 			return VB2_ERROR_UNPACK_KEY_SIG_ALGORITHM;
-		rv = vb2_unpack_key_data(
-				key,
-				(const uint8_t *)pkey + pkey->key_offset,
-				pkey->key_size);
+		rv = vb2_unpack_key_data(key, data.data, data.size);
 		if (rv)
 			return rv;
 	}
@@ -6,8 +6,11 @@
  */
 
 #include <ctype.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "2common.h"
@@ -62,6 +65,60 @@ vb2_error_t vb2_read_file(const char *filename, uint8_t **data_ptr,
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2_map_file(const char *filename, struct vb2_file_view *view,
+			 int copy_on_write)
+{
+	struct stat sb;
+	void *data;
+	int fd;
+
+	memset(view, 0, sizeof(*view));
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		VB2_DEBUG("Unable to open file %s\n", filename);
+		return VB2_ERROR_READ_FILE_OPEN;
+	}
+
+	/* mmap() can't map anything but regular files. */
+	if (fstat(fd, &sb) || !S_ISREG(sb.st_mode)) {
+		close(fd);
+		return vb2_read_file(filename, &view->data, &view->size);
+	}
+
+	/* Nor empty ones, but there's nothing to read from them either. */
+	if (!sb.st_size) {
+		close(fd);
+		return VB2_SUCCESS;
+	}
+
+	if (sb.st_size > UINT32_MAX) {
+		close(fd);
+		return VB2_ERROR_READ_FILE_SIZE;
+	}
+
+	data = mmap(NULL, sb.st_size,
+		    copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ,
+		    MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return vb2_read_file(filename, &view->data, &view->size);
+
+	view->data = data;
+	view->size = sb.st_size;
+	view->mapped = 1;
+	return VB2_SUCCESS;
+}
+
+void vb2_unmap_file(struct vb2_file_view *view)
+{
+	if (view->mapped)
+		munmap(view->data, view->size);
+	else
+		free(view->data);
+	memset(view, 0, sizeof(*view));
+}
+
 vb2_error_t vb2_write_file(const char *filename, const void *buf, uint32_t size)
 {
 	FILE *f = fopen(filename, "wb");
@@ -5,9 +5,11 @@
  * Host functions for signatures.
  */
 
+#include <openssl/ecdsa.h>
 #include <openssl/rsa.h>
 
 #include "2common.h"
+#include "2ecdsa.h"
 #include "2rsa.h"
 #include "2sha.h"
 #include "2sysincludes.h"
@@ -15,7 +17,9 @@
 #include "host_common21.h"
 #include "host_key21.h"
 #include "host_misc.h"
+#include "host_p11.h"
 #include "host_signature21.h"
+#include "openssl_compat.h"
 
 vb2_error_t vb2_digest_info(enum vb2_hash_algorithm hash_alg,
 			    const uint8_t **buf_ptr, uint32_t *size_ptr)
@@ -67,9 +71,48 @@ vb2_error_t vb2_digest_info(enum vb2_hash_algorithm hash_alg,
 	}
 }
 
-vb2_error_t vb21_sign_data(struct vb21_signature **sig_ptr, const uint8_t *data,
-			   uint32_t size, const struct vb2_private_key *key,
-			   const char *desc)
+/**
+ * Write a bignum as a fixed-size big endian number.
+ */
+static int vb2_bn_to_bytes(const BIGNUM *bn, uint8_t *buf, int size)
+{
+	int len = BN_num_bytes(bn);
+
+	if (len > size)
+		return -1;
+
+	memset(buf, 0, size - len);
+	BN_bn2bin(bn, buf + size - len);
+	return 0;
+}
+
+/**
+ * ECDSA-sign a digest, writing the big endian r and s values.
+ */
+static int vb2_ecdsa_sign_digest(uint8_t *sig, const uint8_t *digest,
+				 uint32_t digest_size, struct ec_key_st *ec)
+{
+	ECDSA_SIG *esig;
+	const BIGNUM *r, *s;
+	int ret = -1;
+
+	esig = ECDSA_do_sign(digest, digest_size, ec);
+	if (!esig)
+		return -1;
+
+	ECDSA_SIG_get0(esig, &r, &s);
+	if (!vb2_bn_to_bytes(r, sig, VB2_P256_BYTES) &&
+	    !vb2_bn_to_bytes(s, sig + VB2_P256_BYTES, VB2_P256_BYTES))
+		ret = 0;
+
+	ECDSA_SIG_free(esig);
+	return ret;
+}
+
+vb2_error_t vb21_sign_digest(struct vb21_signature **sig_ptr,
+			     const uint8_t *digest, uint32_t size,
+			     const struct vb2_private_key *key,
+			     const char *desc)
 {
 	struct vb21_signature s = {
 		.c.magic = VB21_MAGIC_SIGNATURE,
@@ -82,12 +125,11 @@ vb2_error_t vb21_sign_data(struct vb21_signature **sig_ptr, const uint8_t *data,
 		.id = key->id,
 	};
 
-	struct vb2_digest_context dc;
 	uint32_t digest_size;
 	const uint8_t *info = NULL;
 	uint32_t info_size = 0;
 	uint32_t sig_digest_size;
-	uint8_t *sig_digest;
+	uint8_t sig_digest[VB2_MAX_DIGEST_INFO_SIZE + VB2_MAX_DIGEST_SIZE];
 	uint8_t *buf;
 
 	*sig_ptr = NULL;
@@ -105,9 +147,10 @@ vb2_error_t vb21_sign_data(struct vb21_signature **sig_ptr, const uint8_t *data,
 
 	s.c.total_size = s.sig_offset + s.sig_size;
 
-	/* Determine digest size and allocate buffer */
-	if (s.sig_alg != VB2_SIG_NONE) {
-		if (vb2_digest_info(s.hash_alg, &info, &info_size))
+	/* Determine digest size */
+	if (s.sig_alg != VB2_SIG_NONE && s.sig_alg != VB2_SIG_ECDSA_P256) {
+		if (vb2_digest_info(s.hash_alg, &info, &info_size) ||
+		    info_size > VB2_MAX_DIGEST_INFO_SIZE)
 			return VB2_SIGN_DATA_DIGEST_INFO;
 	}
 
@@ -115,33 +158,16 @@ vb2_error_t vb21_sign_data(struct vb21_signature **sig_ptr, const uint8_t *data,
 	if (!digest_size)
 		return VB2_SIGN_DATA_DIGEST_SIZE;
 
-	sig_digest_size = info_size + digest_size;
-	sig_digest = malloc(sig_digest_size);
-	if (!sig_digest)
-		return VB2_SIGN_DATA_DIGEST_ALLOC;
-
 	/* Prepend digest info, if any */
+	sig_digest_size = info_size + digest_size;
 	if (info_size)
 		memcpy(sig_digest, info, info_size);
-
-	/* Calculate hash digest */
-	if (vb2_digest_init(&dc, s.hash_alg)) {
-		free(sig_digest);
-		return VB2_SIGN_DATA_DIGEST_INIT;
-	}
-
-	if (vb2_digest_extend(&dc, data, size)) {
-		free(sig_digest);
-		return VB2_SIGN_DATA_DIGEST_EXTEND;
-	}
-
-	if (vb2_digest_finalize(&dc, sig_digest + info_size, digest_size)) {
-		free(sig_digest);
-		return VB2_SIGN_DATA_DIGEST_FINALIZE;
-	}
+	memcpy(sig_digest + info_size, digest, digest_size);
 
 	/* Allocate signature buffer and copy header */
 	buf = calloc(1, s.c.total_size);
+	if (!buf)
+		return VB2_SIGN_DATA_DIGEST_ALLOC;
 	memcpy(buf, &s, sizeof(s));
 
 	/* strcpy() is ok because we allocated buffer based on desc length */
@@ -151,6 +177,21 @@ vb2_error_t vb21_sign_data(struct vb21_signature **sig_ptr, const uint8_t *data,
 	if (s.sig_alg == VB2_SIG_NONE) {
 		/* Bare hash signature is just the digest */
 		memcpy(buf + s.sig_offset, sig_digest, sig_digest_size);
+	} else if (s.sig_alg == VB2_SIG_ECDSA_P256) {
+		/* ECDSA signs the bare digest */
+		if (vb2_ecdsa_sign_digest(buf + s.sig_offset, sig_digest,
+					  sig_digest_size,
+					  key->ec_private_key)) {
+			free(buf);
+			return VB2_SIGN_DATA_ECDSA_SIGN;
+		}
+	} else if (key->p11_key) {
+		/* The token pads and signs it */
+		if (pkcs11_sign(key->p11_key, sig_digest, sig_digest_size,
+				buf + s.sig_offset, s.sig_size)) {
+			free(buf);
+			return VB2_SIGN_DATA_RSA_ENCRYPT;
+		}
 	} else {
 		/* RSA-encrypt the signature */
 		if (RSA_private_encrypt(sig_digest_size,
@@ -158,17 +199,57 @@ vb2_error_t vb21_sign_data(struct vb21_signature **sig_ptr, const uint8_t *data,
 					buf + s.sig_offset,
 					key->rsa_private_key,
 					RSA_PKCS1_PADDING) == -1) {
-			free(sig_digest);
 			free(buf);
 			return VB2_SIGN_DATA_RSA_ENCRYPT;
 		}
 	}
 
-	free(sig_digest);
 	*sig_ptr = (struct vb21_signature *)buf;
 	return VB2_SUCCESS;
 }
 
+/* Calculate the [hash_alg] digest of [size] bytes of [data]. */
+static vb2_error_t hash_data(const uint8_t *data, uint32_t size,
+			     enum vb2_hash_algorithm hash_alg,
+			     uint8_t *digest)
+{
+	struct vb2_digest_context dc;
+	uint32_t digest_size = vb2_digest_size(hash_alg);
+
+	if (!digest_size)
+		return VB2_SIGN_DATA_DIGEST_SIZE;
+
+	if (vb2_digest_init(&dc, hash_alg))
+		return VB2_SIGN_DATA_DIGEST_INIT;
+
+	if (vb2_digest_extend(&dc, data, size))
+		return VB2_SIGN_DATA_DIGEST_EXTEND;
+
+	if (vb2_digest_finalize(&dc, digest, digest_size))
+		return VB2_SIGN_DATA_DIGEST_FINALIZE;
+
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb21_sign_data(struct vb21_signature **sig_ptr, const uint8_t *data,
+			   uint32_t size, const struct vb2_private_key *key,
+			   const char *desc)
+{
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	vb2_error_t rv;
+
+	*sig_ptr = NULL;
+
+	if (!vb2_sig_size(key->sig_alg, key->hash_alg))
+		return VB2_SIGN_DATA_SIG_SIZE;
+
+	rv = hash_data(data, size, key->hash_alg, digest);
+	if (rv)
+		return rv;
+
+	return vb21_sign_digest(sig_ptr, digest, size, key, desc);
+}
+
 vb2_error_t vb21_sig_size_for_key(uint32_t *size_ptr,
 				  const struct vb2_private_key *key,
 				  const char *desc)
@@ -234,12 +315,28 @@ vb2_error_t vb21_sign_object_multiple(uint8_t *buf, uint32_t sig_offset,
 {
 	struct vb21_struct_common *c = (struct vb21_struct_common *)buf;
 	uint32_t sig_next = sig_offset;
+	/* Digests of the object, calculated once for each hash algorithm */
+	uint8_t digests[VB2_HASH_ALG_COUNT][VB2_MAX_DIGEST_SIZE];
+	uint8_t have_digest[VB2_HASH_ALG_COUNT] = {0};
 	vb2_error_t rv, i;
 
 	for (i = 0; i < key_count; i++)	{
+		const struct vb2_private_key *key = key_list[i];
 		struct vb21_signature *sig = NULL;
 
-		rv = vb21_sign_data(&sig, buf, sig_offset, key_list[i], NULL);
+		if (key->hash_alg >= VB2_HASH_ALG_COUNT)
+			return VB2_SIGN_DATA_DIGEST_SIZE;
+
+		if (!have_digest[key->hash_alg]) {
+			rv = hash_data(buf, sig_offset, key->hash_alg,
+				       digests[key->hash_alg]);
+			if (rv)
+				return rv;
+			have_digest[key->hash_alg] = 1;
+		}
+
+		rv = vb21_sign_digest(&sig, digests[key->hash_alg], sig_offset,
+				      key, NULL);
 		if (rv)
 			return rv;
 
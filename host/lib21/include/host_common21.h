@@ -78,6 +78,39 @@ vb2_error_t vb21_verify_common_subobject(const void *parent,
 					 uint32_t *min_offset,
 					 uint32_t member_offset);
 
+/* One member of a vb21 object, for vb21_verify_members() */
+struct vb21_member {
+	/* Offset of member data from start of parent, in bytes */
+	uint32_t offset;
+	/*
+	 * Size of member data, in bytes.  For a subobject this is filled in
+	 * from the subobject's common header.
+	 */
+	uint32_t size;
+	/* Non-zero if the member starts with its own common header */
+	int subobject;
+	/* Set on success to the start of the member data */
+	const uint8_t *data;
+};
+
+/**
+ * Verify all members of an object are within its data, in one pass
+ *
+ * Members are checked in order of offset regardless of their order in the
+ * array, so they must not overlap each other or the fixed header and
+ * description.  This replaces a chain of vb21_verify_common_member() and
+ * vb21_verify_common_subobject() calls sharing a min_offset.  The caller
+ * must already have checked the parent with vb21_verify_common_header().
+ *
+ * @param parent	Parent data (starts with struct vb21_struct_common)
+ * @param members	Members to check; data (and size, for subobjects) is
+ *			filled in on success.
+ * @param count		Number of entries in members
+ * @return VB2_SUCCESS, or non-zero if error.
+ */
+vb2_error_t vb21_verify_members(const void *parent,
+				struct vb21_member *members, uint32_t count);
+
 /**
  * Verify the integrity of a signature struct
  * @param sig		Signature struct
@@ -117,6 +150,55 @@ vb2_error_t vb21_verify_data(const void *data, uint32_t size,
 			     const struct vb2_public_key *key,
 			     const struct vb2_workbuf *wb);
 
+/**
+ * Verify an object signed by vb21_sign_object_multiple().
+ *
+ * The signatures start at sig_offset and follow one another, in the same
+ * order as key_list.  The object is hashed once for each distinct hash
+ * algorithm in key_list, rather than once per signature.
+ *
+ * @param buf		Object to verify (starts with struct
+ *			vb21_struct_common).  Signatures may be destroyed
+ *			in the process.
+ * @param sig_offset	Offset of first signature; data before this is signed
+ * @param key_list	Keys to verify the signatures with, one per signature
+ * @param key_count	Number of keys in key_list
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS, or non-zero error code if any signature fails.
+ */
+vb2_error_t vb21_verify_object_multiple(uint8_t *buf, uint32_t sig_offset,
+					const struct vb2_public_key **key_list,
+					uint32_t key_count,
+					const struct vb2_workbuf *wb);
+
+/* Bytes fed to every hash in turn by vb21_verify_hashes() */
+#define VB21_VERIFY_HASHES_STRIDE 4096
+
+/**
+ * Verify data against several bare hashes in one pass.
+ *
+ * Each entry must be a hash (sig_alg VB2_SIG_NONE) of all of the data, such as
+ * the SHA-256 and SHA-512 hashes of a body.  The data is walked once, with
+ * each VB21_VERIFY_HASHES_STRIDE piece fed to every hash while it's still in
+ * cache, so it only needs to be read once.  Pass a hash_alg to check only
+ * the entries using that algorithm (for example, whichever one the hardware
+ * accelerates), or VB2_HASH_INVALID to check them all.
+ *
+ * @param data		Data to verify
+ * @param size		Size of data in bytes
+ * @param hashes	Hash entries to check data against
+ * @param count		Number of entries in hashes
+ * @param hash_alg	Only check entries with this algorithm, or
+ *			VB2_HASH_INVALID for all of them.
+ * @param wb		Work buffer, for one hash context per checked entry
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+vb2_error_t vb21_verify_hashes(const void *data, uint32_t size,
+			       const struct vb21_signature *const *hashes,
+			       uint32_t count,
+			       enum vb2_hash_algorithm hash_alg,
+			       const struct vb2_workbuf *wb);
+
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
@@ -18,6 +18,8 @@ struct vb21_packed_key;
 /* Private key data, in-memory format for use in signing calls. */
 struct vb2_private_key {
 	struct rsa_st *rsa_private_key;		/* Private key data */
+	struct ec_key_st *ec_private_key;	/* EC private key data */
+	struct pkcs11_key *p11_key;		/* Key in a PKCS#11 token */
 	enum vb2_hash_algorithm hash_alg;	/* Hash algorithm */
 	enum vb2_signature_algorithm sig_alg;	/* Signature algorithm */
 	char *desc;				/* Description */
@@ -257,6 +259,14 @@ vb2_error_t vb2_public_key_hash(struct vb2_public_key *key,
  */
 enum vb2_signature_algorithm vb2_rsa_sig_alg(struct rsa_st *rsa);
 
+/**
+ * Return the signature algorithm implied by the curve of an EC key
+ *
+ * @param ec		EC key
+ * @return vb2 signature algorithm, or VB2_SIG_INVALID if unsupported curve
+ */
+enum vb2_signature_algorithm vb2_ec_sig_alg(struct ec_key_st *ec);
+
 /**
  * Write a public key to the vb21_packed_key format.
  *
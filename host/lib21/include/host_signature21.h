@@ -13,6 +13,9 @@
 struct vb2_private_key;
 struct vb21_signature;
 
+/* Size of the largest digest info from vb2_digest_info() */
+#define VB2_MAX_DIGEST_INFO_SIZE 19
+
 /**
  * Get the digest info for a hash algorithm
  *
@@ -24,6 +27,23 @@ struct vb21_signature;
 vb2_error_t vb2_digest_info(enum vb2_hash_algorithm hash_alg,
 			    const uint8_t **buf_ptr, uint32_t *size_ptr);
 
+/**
+ * Sign a precomputed digest
+ *
+ * @param sig_ptr	On success, points to a newly allocated signature.
+ *			Caller is responsible for calling free() on this.
+ * @param digest	Digest of the data, using key->hash_alg
+ * @param size		Size of the signed data in bytes
+ * @param key		Private key to use to sign data
+ * @param desc		Optional description for signature.  If NULL, the
+ *			key description will be used.
+ * @return VB2_SUCCESS, or non-zero error code on failure.
+ */
+vb2_error_t vb21_sign_digest(struct vb21_signature **sig_ptr,
+			     const uint8_t *digest, uint32_t size,
+			     const struct vb2_private_key *key,
+			     const char *desc);
+
 /**
  * Sign data buffer
  *
@@ -82,6 +102,8 @@ vb2_error_t vb21_sign_object(uint8_t *buf, uint32_t sig_offset,
 /**
  * Sign object with list of keys.
  *
+ * The object is hashed once for each hash algorithm used by the keys.
+ *
  * @param buf		Buffer containing object to sign, starting with
  *			common header
  * @param sig_offset	Offset to start signatures.  All data before this
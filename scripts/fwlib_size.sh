@@ -0,0 +1,136 @@
+#!/bin/bash
+#
+# Copyright 2020 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Report the memory footprint of the firmware library: the code, data and bss
+# of each object, the biggest functions and stack frames, and the work buffer
+# sizes for the algorithms it was built with.  The report goes to stderr, and
+# name:value lines go to stdout so they can be kept and compared between
+# builds.  Objects must have been compiled with -fstack-usage for the stack
+# sizes; each one's .su file sits next to it.
+
+set -e
+
+SIZE=${SIZE:-size}
+NM=${NM:-nm}
+COUNT=10
+BASELINE=
+WORKBUF=
+ROOT=
+
+usage() {
+	cat 1>&2 <<EOF
+Usage: $0 [options] <object>...
+
+Options:
+  -b BASELINE  Earlier output to compare the sizes with
+  -n COUNT     Biggest functions and stack frames to list (default ${COUNT})
+  -r DIR       Directory the object names are relative to
+  -w ASM       Assembly compiled from scripts/fwlib_workbuf.c
+EOF
+	exit 1
+}
+
+while getopts "b:n:r:w:" opt; do
+	case "${opt}" in
+	b) BASELINE=${OPTARG} ;;
+	n) COUNT=${OPTARG} ;;
+	r) ROOT=${OPTARG%/}/ ;;
+	w) WORKBUF=${OPTARG} ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -gt 0 ] || usage
+
+# Module name for an object: its path without the build directory or .o
+module() {
+	local m=${1#${ROOT}}
+	echo "${m%.o}"
+}
+
+RESULTS=$(mktemp)
+trap 'rm -f "${RESULTS}"' EXIT
+
+echo "# Module                                   text     data      bss    stack" \
+	1>&2
+for obj in "$@"; do
+	m=$(module "${obj}")
+	read -r text data bss _ < <("${SIZE}" "${obj}" | tail -1)
+	stack=0
+	if [ -f "${obj%.o}.su" ]; then
+		stack=$(awk -F'\t' '$2 > max { max = $2 } END { print max + 0 }' \
+			"${obj%.o}.su")
+	fi
+	printf "# %-36s %8d %8d %8d %8d\n" "${m}" "${text}" "${data}" \
+		"${bss}" "${stack}" 1>&2
+	cat >> "${RESULTS}" <<EOF
+bytes_text_${m}:${text}
+bytes_data_${m}:${data}
+bytes_bss_${m}:${bss}
+bytes_stack_max_${m}:${stack}
+EOF
+done
+
+TOTALS=$(awk -F: '
+	/^bytes_(text|data|bss)_/ {
+		split($1, k, "_")
+		total[k[2]] += $2
+	}
+	/^bytes_stack_max_/ && $2 > stack { stack = $2 }
+	END {
+		printf("# %-36s %8d %8d %8d %8d\n", "total", total["text"],
+		       total["data"], total["bss"], stack) > "/dev/stderr"
+		printf("bytes_text_total:%d\nbytes_data_total:%d\n",
+		       total["text"], total["data"])
+		printf("bytes_bss_total:%d\nbytes_stack_max_total:%d\n",
+		       total["bss"], stack)
+	}' "${RESULTS}")
+echo "${TOTALS}" >> "${RESULTS}"
+
+echo "#" 1>&2
+echo "# Biggest functions" 1>&2
+for obj in "$@"; do
+	m=$(module "${obj}")
+	"${NM}" -S -t d "${obj}" | \
+		awk -v m="${m}" '$3 ~ /^[tT]$/ { print $2 + 0, m ": " $4 }'
+done | sort -rn | head -n "${COUNT}" | \
+	awk '{ printf("# %8d  %s %s\n", $1, $2, $3) }' 1>&2
+
+echo "#" 1>&2
+echo "# Biggest stack frames" 1>&2
+for obj in "$@"; do
+	su=${obj%.o}.su
+	[ -f "${su}" ] || continue
+	m=$(module "${obj}")
+	awk -F'\t' -v m="${m}" '{ n = split($1, f, ":"); print $2, m ": " f[n] }' \
+		"${su}"
+done | sort -rn | head -n "${COUNT}" | \
+	awk '{ printf("# %8d  %s %s\n", $1, $2, $3) }' 1>&2
+
+if [ -n "${WORKBUF}" ]; then
+	echo "#" 1>&2
+	echo "# Work buffer sizes" 1>&2
+	sed -n 's/.*->\([a-z_]*\) [$#]*\([0-9]*\).*/\1 \2/p' "${WORKBUF}" | \
+		while read -r name value; do
+			printf "# %-32s %8d\n" "${name}" "${value}" 1>&2
+			echo "bytes_workbuf_${name}:${value}" >> "${RESULTS}"
+		done
+fi
+
+cat "${RESULTS}"
+
+# Sizes which changed since the baseline
+if [ -n "${BASELINE}" ] && [ -f "${BASELINE}" ]; then
+	echo "#" 1>&2
+	echo "# Changes from ${BASELINE}" 1>&2
+	awk -F: '
+		NR == FNR { base[$1] = $2; next }
+		!($1 in base) { printf("# %-48s %8s %8d\n", $1, "new", $2); next }
+		$2 != base[$1] {
+			printf("# %-48s %8d %8d %+8d\n", $1, base[$1], $2,
+			       $2 - base[$1])
+		}' "${BASELINE}" "${RESULTS}" 1>&2
+fi
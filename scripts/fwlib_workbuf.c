@@ -0,0 +1,28 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Work buffer sizes for the firmware library as configured.  Compiled to
+ * assembly with the firmware flags, so the sizes come out right for a cross
+ * build too; fwlib_size.sh picks out the "->NAME VALUE" lines.
+ */
+
+#include "2common.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "2struct.h"
+
+#define SIZE(name, value) \
+	__asm__ volatile("\n.ascii \"->" name " %0\"" : : "i" (value))
+
+void fwlib_workbuf(void);
+void fwlib_workbuf(void)
+{
+	SIZE("firmware_recommended", VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE);
+	SIZE("kernel_recommended", VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE);
+	SIZE("shared_data", sizeof(struct vb2_shared_data));
+	SIZE("digest_context", sizeof(struct vb2_digest_context));
+	SIZE("max_digest", VB2_MAX_DIGEST_SIZE);
+	SIZE("verify_rsa_digest", VB2_VERIFY_RSA_DIGEST_WORKBUF_BYTES);
+	SIZE("verify_data", VB2_VERIFY_DATA_WORKBUF_BYTES);
+}
@@ -35,6 +35,7 @@ GBBFLAGS_LIST="
   VB2_GBB_FLAG_FORCE_MANUAL_RECOVERY             0x00004000
   VB2_GBB_FLAG_DISABLE_FWMP                      0x00008000
   VB2_GBB_FLAG_ENABLE_UDC                        0x00010000
+  VB2_GBB_FLAG_HEADLESS_DIAGNOSTICS              0x00020000
   "
 
 GBBFLAGS_DESCRIPTION_SUFFIX="
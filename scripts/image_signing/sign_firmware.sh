@@ -27,43 +27,49 @@ EOF
   exit 1
 }
 
-gbb_update() {
-  local in_firmware="$1"
-  local key_dir="$2"
-  local out_firmware="$3"
+# Sign a single firmware image. The new root and recovery keys are put in the
+# GBB by the same futility run, after the vblocks are signed.
+# ARGS: <output_firmware> [loem_key] [loemid] [rootkey]
+sign_one() {
+  local out_fw="$1"
+  local loem_key="$2"
+  local loemid="$3"
   local rootkey="$4"
+  local datakey="${key_dir}/firmware_data_key${loem_key}.vbprivk"
+  local keyblock="${key_dir}/firmware${loem_key}.keyblock"
+  local dev_datakey="${key_dir}/dev_firmware_data_key${loem_key}.vbprivk"
+  local dev_keyblock="${key_dir}/dev_firmware${loem_key}.keyblock"
+  local args=()
+
+  if [[ ! -e ${dev_keyblock} || ! -e ${dev_datakey} ]]; then
+    echo "No dev firmware keyblock/datakey found. Reusing normal keys."
+    dev_datakey="${datakey}"
+    dev_keyblock="${keyblock}"
+  fi
+  if [[ -n ${loemid} ]]; then
+    args+=( --loemdir "${loem_output_dir}" --loemid "${loemid}" )
+  fi
+  if [[ -n ${rootkey} ]]; then
+    args+=(
+      --rootkey "${rootkey}"
+      --recoverykey "${key_dir}/recovery_key.vbpubk"
+    )
+  fi
 
-  # Replace the root and recovery key in the Google Binary Block of the
-  # firmware.  Note: This needs to happen after calling resign_firmwarefd.sh
-  # since it needs to be able to verify the firmware using the root key to
-  # determine the preamble flags.
-  futility gbb \
-    -s \
-    --recoverykey="${key_dir}/recovery_key.vbpubk" \
-    --rootkey="${rootkey}" \
-    "${in_firmware}" \
-    "${out_firmware}"
-}
+  # Sign in place when the output is the input.
+  args+=( "${in_firmware}" )
+  if [[ ! ${in_firmware} -ef ${out_fw} ]]; then
+    args+=( "${out_fw}" )
+  fi
 
-# Sign a single firmware image.
-# ARGS: [loem_key] [loemid]
-sign_one() {
-  local loem_key="$1"
-  local loemid="$2"
-
-  # Resign the firmware with new keys.
-  "${SCRIPT_DIR}/resign_firmwarefd.sh" \
-    "${in_firmware}" \
-    "${temp_fw}" \
-    "${key_dir}/firmware_data_key${loem_key}.vbprivk" \
-    "${key_dir}/firmware${loem_key}.keyblock" \
-    "${key_dir}/dev_firmware_data_key${loem_key}.vbprivk" \
-    "${key_dir}/dev_firmware${loem_key}.keyblock" \
-    "${key_dir}/kernel_subkey.vbpubk" \
-    "${firmware_version}" \
-    "" \
-    "${loem_output_dir}" \
-    "${loemid}"
+  futility sign \
+    --signprivate "${datakey}" \
+    --keyblock "${keyblock}" \
+    --devsign "${dev_datakey}" \
+    --devkeyblock "${dev_keyblock}" \
+    --kernelkey "${key_dir}/kernel_subkey.vbpubk" \
+    --version "${firmware_version}" \
+    "${args[@]}"
 }
 
 # Process all the keysets in the loem.ini file.
@@ -94,14 +100,17 @@ sign_loems() {
     loemid=$(cut -d= -f2 <<<"${line}" | sed 's:^ *::')
 
     echo "### Processing LOEM ${loem_index} ${loemid}"
-    sign_one ".loem${loem_index}" "${loemid}"
-
     rootkey="${key_dir}/root_key.loem${loem_index}.vbpubk"
-    cp "${rootkey}" "${loem_output_dir}/rootkey.${loemid}"
 
+    # Only the first keyset goes in the output image's GBB.
     if [[ ${loem_index} == "1" ]]; then
-      gbb_update "${temp_fw}" "${key_dir}" "${out_firmware}" "${rootkey}"
+      sign_one "${out_firmware}" ".loem${loem_index}" "${loemid}" \
+        "${rootkey}"
+    else
+      sign_one "${temp_fw}" ".loem${loem_index}" "${loemid}"
     fi
+
+    cp "${rootkey}" "${loem_output_dir}/rootkey.${loemid}"
     echo
   done <"${key_dir}/loem.ini"
 }
@@ -125,9 +134,7 @@ main() {
     fi
     sign_loems
   else
-    sign_one
-    gbb_update "${temp_fw}" "${key_dir}" "${out_firmware}" \
-      "${key_dir}/root_key.vbpubk"
+    sign_one "${out_firmware}" "" "" "${key_dir}/root_key.vbpubk"
 
     # Additional signing step for nVidia T210 SoC.
     # Currently, cbootimage is unable to handle path with double slash.
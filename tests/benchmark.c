@@ -0,0 +1,312 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Common harness for vboot microbenchmarks.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "2trace.h"
+#include "benchmark.h"
+
+/* Shortest sample worth timing; faster calls are batched up to this. */
+#define MIN_SAMPLE_NS 10000
+
+/* Throughput is in units of 10^6 bytes per second */
+#define NS_PER_SEC 1000000000.0
+#define BYTES_PER_MB 1000000.0
+
+static const struct option long_opts[] = {
+	BENCH_LONG_OPTS,
+	{NULL, 0, NULL, 0}
+};
+
+/* Number of results printed so far, for JSON separators */
+static int reported;
+
+static void print_usage(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s [options] [args...]\n\n"
+		BENCH_USAGE, progname);
+}
+
+void bench_init_options(struct bench_options *opts)
+{
+	opts->warmup = 2;
+	opts->reps = 11;
+	opts->format = BENCH_FORMAT_TEXT;
+	opts->min_size = 64;
+	opts->max_size = 64 * 1024 * 1024;
+}
+
+/* Parse a size with an optional K, M or G suffix. Returns 0 if bad. */
+static size_t parse_size(const char *str)
+{
+	char *e;
+	unsigned long long size = strtoull(str, &e, 0);
+
+	switch (*e) {
+	case 'G':
+		size *= 1024;
+		/* fall through */
+	case 'M':
+		size *= 1024;
+		/* fall through */
+	case 'K':
+		size *= 1024;
+		e++;
+	}
+	if (*e || e == str)
+		return 0;
+	return size;
+}
+
+int bench_parse_option(struct bench_options *opts, int opt, const char *arg)
+{
+	char *e;
+
+	switch (opt) {
+	case BENCH_OPT_WARMUP:
+		opts->warmup = strtol(arg, &e, 0);
+		if (*e || e == arg || opts->warmup < 0)
+			goto bad;
+		return 0;
+	case BENCH_OPT_REPS:
+		opts->reps = strtol(arg, &e, 0);
+		if (*e || e == arg || opts->reps < 1)
+			goto bad;
+		return 0;
+	case BENCH_OPT_FORMAT:
+		if (!strcmp(arg, "text"))
+			opts->format = BENCH_FORMAT_TEXT;
+		else if (!strcmp(arg, "csv"))
+			opts->format = BENCH_FORMAT_CSV;
+		else if (!strcmp(arg, "json"))
+			opts->format = BENCH_FORMAT_JSON;
+		else
+			goto bad;
+		return 0;
+	case BENCH_OPT_MIN_SIZE:
+		opts->min_size = parse_size(arg);
+		if (!opts->min_size)
+			goto bad;
+		return 0;
+	case BENCH_OPT_MAX_SIZE:
+		opts->max_size = parse_size(arg);
+		if (!opts->max_size)
+			goto bad;
+		return 0;
+	default:
+		return 1;
+	}
+
+ bad:
+	fprintf(stderr, "Bad value for --%s: %s\n",
+		long_opts[opt - BENCH_OPT_WARMUP].name, arg);
+	return -1;
+}
+
+int bench_check_options(const struct bench_options *opts)
+{
+	if (opts->min_size > opts->max_size) {
+		fprintf(stderr, "--min-size is larger than --max-size\n");
+		return -1;
+	}
+	return 0;
+}
+
+int bench_parse_args(struct bench_options *opts, int argc, char *argv[])
+{
+	int i;
+
+	while ((i = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		if (bench_parse_option(opts, i, optarg)) {
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (bench_check_options(opts))
+		return -1;
+	return optind;
+}
+
+uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Cycle counter for VB2_TRACE builds: the TSC on x86, else nanoseconds */
+uint64_t vb2ex_cycle_counter(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return bench_now_ns();
+#endif
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Time 'batch' back-to-back calls to func. */
+static uint64_t time_batch(bench_func_t func, void *arg, size_t size,
+			   uint64_t batch)
+{
+	uint64_t start = bench_now_ns();
+	uint64_t i;
+
+	for (i = 0; i < batch; i++)
+		func(arg, size);
+	return bench_now_ns() - start;
+}
+
+void bench_run(const struct bench_options *opts, bench_func_t func,
+	       void *arg, size_t size, struct bench_result *result)
+{
+	uint64_t *samples = malloc(opts->reps * sizeof(*samples));
+	uint64_t batch = 1;
+	int i;
+
+	/* Double the batch until a sample is long enough to time reliably */
+	while (time_batch(func, arg, size, batch) < MIN_SAMPLE_NS)
+		batch *= 2;
+
+	for (i = 0; i < opts->warmup; i++)
+		time_batch(func, arg, size, batch);
+
+	for (i = 0; i < opts->reps; i++)
+		samples[i] = time_batch(func, arg, size, batch) / batch;
+
+	bench_summarize(samples, opts->reps, result);
+	result->batch = batch;
+	free(samples);
+}
+
+void bench_summarize(uint64_t *samples, int count,
+		     struct bench_result *result)
+{
+	qsort(samples, count, sizeof(*samples), compare_u64);
+	result->min_ns = samples[0];
+	result->median_ns = samples[count / 2];
+	/* Nearest-rank percentile; with few samples this is the maximum */
+	result->p99_ns = samples[(count * 99 + 99) / 100 - 1];
+	result->batch = 1;
+	result->cpu_median_ns = 0;
+	result->peak_rss_kb = 0;
+}
+
+static double mbytes_per_sec(size_t size, uint64_t ns)
+{
+	if (!ns)
+		return 0;
+	return (size / BYTES_PER_MB) / (ns / NS_PER_SEC);
+}
+
+void bench_report_begin(const struct bench_options *opts)
+{
+	reported = 0;
+	switch (opts->format) {
+	case BENCH_FORMAT_TEXT:
+		break;
+	case BENCH_FORMAT_CSV:
+		printf("name,size,reps,min_ns,median_ns,p99_ns,"
+		       "mbytes_per_sec,cpu_median_ns,peak_rss_kb\n");
+		break;
+	case BENCH_FORMAT_JSON:
+		printf("[");
+		break;
+	}
+}
+
+void bench_report(const struct bench_options *opts, const char *name,
+		  size_t size, const struct bench_result *result)
+{
+	double speed = mbytes_per_sec(size, result->median_ns);
+
+	switch (opts->format) {
+	case BENCH_FORMAT_TEXT:
+		fprintf(stderr, "# %-24s", name);
+		if (size)
+			fprintf(stderr, " %10zu bytes", size);
+		fprintf(stderr, ": min %" PRIu64 " ns, median %" PRIu64
+			" ns, p99 %" PRIu64 " ns", result->min_ns,
+			result->median_ns, result->p99_ns);
+		if (size)
+			fprintf(stderr, ", %.3f Mbytes/sec", speed);
+		if (result->cpu_median_ns)
+			fprintf(stderr, ", cpu %" PRIu64 " ns",
+				result->cpu_median_ns);
+		if (result->peak_rss_kb)
+			fprintf(stderr, ", peak RSS %" PRIu64 " KiB",
+				result->peak_rss_kb);
+		fprintf(stderr, "\n");
+		if (size)
+			printf("mbytes_per_sec_%s_%zu:%f\n", name, size, speed);
+		else
+			printf("ns_per_call_%s:%" PRIu64 "\n",
+			       name, result->median_ns);
+		if (result->cpu_median_ns)
+			printf("cpu_ns_per_call_%s:%" PRIu64 "\n",
+			       name, result->cpu_median_ns);
+		if (result->peak_rss_kb)
+			printf("peak_rss_kb_%s:%" PRIu64 "\n",
+			       name, result->peak_rss_kb);
+		break;
+	case BENCH_FORMAT_CSV:
+		printf("%s,%zu,%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%f,%"
+		       PRIu64 ",%" PRIu64 "\n",
+		       name, size, opts->reps, result->min_ns,
+		       result->median_ns, result->p99_ns, speed,
+		       result->cpu_median_ns, result->peak_rss_kb);
+		break;
+	case BENCH_FORMAT_JSON:
+		printf("%s\n  {\"name\": \"%s\", \"size\": %zu, \"reps\": %d, "
+		       "\"min_ns\": %" PRIu64 ", \"median_ns\": %" PRIu64 ", "
+		       "\"p99_ns\": %" PRIu64 ", \"mbytes_per_sec\": %f, "
+		       "\"cpu_median_ns\": %" PRIu64 ", "
+		       "\"peak_rss_kb\": %" PRIu64 "}",
+		       reported ? "," : "", name, size, opts->reps,
+		       result->min_ns, result->median_ns, result->p99_ns,
+		       speed, result->cpu_median_ns, result->peak_rss_kb);
+		break;
+	}
+	reported++;
+}
+
+void bench_report_end(const struct bench_options *opts)
+{
+	const struct vb2_trace_counter *t;
+	int i;
+
+	if (opts->format == BENCH_FORMAT_JSON)
+		printf("\n]\n");
+	fflush(stdout);
+
+	/* In VB2_TRACE builds, show where the cycles of the whole run went */
+	for (i = 0; i < VB2_TRACE_POINT_COUNT; i++) {
+		t = vb2_trace_get(i);
+		if (!t || !t->calls)
+			continue;
+		fprintf(stderr, "# trace %s: %u calls, %" PRIu64 " cycles, "
+			"%" PRIu64 " cycles/call\n", t->name, t->calls,
+			t->cycles, t->cycles / t->calls);
+	}
+}
@@ -0,0 +1,132 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Common harness for vboot microbenchmarks.
+ */
+
+#ifndef VBOOT_REFERENCE_BENCHMARK_H_
+#define VBOOT_REFERENCE_BENCHMARK_H_
+
+#include <getopt.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum bench_format {
+	/* Human-readable lines on stderr, name:value lines on stdout */
+	BENCH_FORMAT_TEXT,
+	BENCH_FORMAT_CSV,
+	BENCH_FORMAT_JSON,
+};
+
+struct bench_options {
+	/* Untimed runs before sampling starts */
+	int warmup;
+	/* Number of timed samples */
+	int reps;
+	enum bench_format format;
+	/* Size range for benchmarks that sweep the input size */
+	size_t min_size;
+	size_t max_size;
+};
+
+struct bench_result {
+	uint64_t min_ns;
+	uint64_t median_ns;
+	uint64_t p99_ns;
+	/* Calls to the benchmark function per sample */
+	uint64_t batch;
+	/*
+	 * Only measured by benchmarks which run commands; 0 if not.  Median
+	 * user+system time, and the largest resident set of any run.
+	 */
+	uint64_t cpu_median_ns;
+	uint64_t peak_rss_kb;
+};
+
+/*
+ * Function under test. Called with the argument passed to bench_run() and
+ * the size of the input to process.
+ */
+typedef void (*bench_func_t)(void *arg, size_t size);
+
+/* Values returned by getopt_long() for the harness options */
+enum bench_option {
+	BENCH_OPT_WARMUP = 1000,
+	BENCH_OPT_REPS,
+	BENCH_OPT_FORMAT,
+	BENCH_OPT_MIN_SIZE,
+	BENCH_OPT_MAX_SIZE,
+	/* Benchmarks can number their own long options from here */
+	BENCH_OPT_USER,
+};
+
+/* Harness entries for a benchmark's struct option array */
+#define BENCH_LONG_OPTS \
+	{"warmup",   1, NULL, BENCH_OPT_WARMUP}, \
+	{"reps",     1, NULL, BENCH_OPT_REPS}, \
+	{"format",   1, NULL, BENCH_OPT_FORMAT}, \
+	{"min-size", 1, NULL, BENCH_OPT_MIN_SIZE}, \
+	{"max-size", 1, NULL, BENCH_OPT_MAX_SIZE}
+
+/* Usage text for the harness options */
+#define BENCH_USAGE \
+	"  --warmup N          Untimed runs before sampling\n" \
+	"  --reps N            Number of timed samples\n" \
+	"  --format FMT        text (default), csv or json\n" \
+	"  --min-size BYTES    Smallest size in a sweep (K/M/G suffixes ok)\n" \
+	"  --max-size BYTES    Largest size in a sweep\n"
+
+/* Fill in default options: 2 warmup runs, 11 samples, 64 B to 64 MB. */
+void bench_init_options(struct bench_options *opts);
+
+/*
+ * Parse the harness options (--warmup, --reps, --format, --min-size,
+ * --max-size) from the command line. Returns the index of the first
+ * non-option argument, or -1 on error after printing a usage message.
+ */
+int bench_parse_args(struct bench_options *opts, int argc, char *argv[]);
+
+/*
+ * Handle one option returned by getopt_long(), for benchmarks which parse
+ * their own options as well as BENCH_LONG_OPTS. Returns 0 if handled, 1 if
+ * 'opt' isn't a harness option, or -1 if 'arg' is bad.
+ */
+int bench_parse_option(struct bench_options *opts, int opt, const char *arg);
+
+/*
+ * Check the options once they're all parsed. Returns 0 if they're
+ * consistent, or -1 after printing an error.
+ */
+int bench_check_options(const struct bench_options *opts);
+
+/* Current time from a monotonic clock, in nanoseconds. */
+uint64_t bench_now_ns(void);
+
+/*
+ * Time func(arg, size). Calls that finish faster than the timer can
+ * usefully resolve are batched, so each sample covers at least a few
+ * microseconds; the durations reported are per call.
+ */
+void bench_run(const struct bench_options *opts, bench_func_t func,
+	       void *arg, size_t size, struct bench_result *result);
+
+/*
+ * Summarize 'count' samples timed by the caller, for benchmarks which split
+ * each run into phases. Sorts 'samples' in place.
+ */
+void bench_summarize(uint64_t *samples, int count,
+		     struct bench_result *result);
+
+/*
+ * Output helpers. bench_report() prints one result; 'size' is the number of
+ * bytes processed per call and is used to compute throughput, or 0 if
+ * throughput doesn't apply. Results must be bracketed by bench_report_begin()
+ * and bench_report_end().
+ */
+void bench_report_begin(const struct bench_options *opts);
+void bench_report(const struct bench_options *opts, const char *name,
+		  size_t size, const struct bench_result *result);
+void bench_report_end(const struct bench_options *opts);
+
+#endif  /* VBOOT_REFERENCE_BENCHMARK_H_ */
@@ -0,0 +1,67 @@
+// Copyright 2020 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "2common.h"
+#include "fmap.h"
+#include "updater_utils.h"
+
+#define CBFS_SECTION "COREBOOT"
+
+// The FMAP which puts the CBFS section around the input
+struct image_header {
+	FmapHeader fmap;
+	FmapAreaHeader area;
+} __attribute__((packed));
+
+// Files the updater looks for
+static const char *const cbfs_names[] = {
+	"ecro",
+	"ecro.hash",
+	"cros_allow_auto_update",
+};
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	struct firmware_image image;
+	struct firmware_section file;
+	struct image_header *h;
+	int compressed;
+	int i;
+
+	// Build an image of exactly the size needed, so that reads past the
+	// end of the section are caught.
+	memset(&image, 0, sizeof(image));
+	image.size = sizeof(*h) + size;
+	image.data = malloc(image.size);
+	if (!image.data)
+		abort();
+
+	h = (struct image_header *)image.data;
+	memset(h, 0, sizeof(*h));
+	memcpy(h->fmap.fmap_signature, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE);
+	h->fmap.fmap_ver_major = FMAP_VER_MAJOR;
+	h->fmap.fmap_size = image.size;
+	h->fmap.fmap_nareas = 1;
+	h->area.area_offset = sizeof(*h);
+	h->area.area_size = size;
+	strcpy(h->area.area_name, CBFS_SECTION);
+	memcpy(image.data + sizeof(*h), data, size);
+	image.fmap_header = &h->fmap;
+
+	for (i = 0; i < ARRAY_SIZE(cbfs_names); i++) {
+		if (cbfs_find_file(&file, &image, CBFS_SECTION, cbfs_names[i],
+				   &compressed))
+			continue;
+		// The file must be inside the section
+		if (file.data < image.data + sizeof(*h) ||
+		    file.data + file.size > image.data + image.size)
+			abort();
+	}
+
+	free(image.data);
+	return 0;
+}
@@ -0,0 +1,342 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Scaling benchmark for cgptlib and cgpt find, over synthetic drives with
+ * partition tables of different sizes and layouts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../cgpt/cgpt.h"
+#include "2common.h"
+#include "benchmark.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "gpt.h"
+#include "vboot_host.h"
+
+#define SECTOR_BYTES 512
+#define ENTRIES_SECTORS (GPT_ENTRIES_ALLOC_SIZE / SECTOR_BYTES)
+#define FIRST_USABLE_LBA (GPT_PMBR_SECTORS + GPT_HEADER_SECTORS + \
+			  ENTRIES_SECTORS)
+#define PARTITION_SECTORS 8
+
+/* cgpt_common.c requires these be defined if linked in. */
+const char *progname = "cgpt_bench";
+const char *command = "bench";
+
+enum layout {
+	/* Kernel and rootfs pairs, in LBA order */
+	LAYOUT_SORTED,
+	/* The same, with the entries in reverse LBA order */
+	LAYOUT_REVERSED,
+	/* The same, with the entries shuffled */
+	LAYOUT_SHUFFLED,
+	/* Every entry is a kernel, in LBA order */
+	LAYOUT_KERNELS,
+	LAYOUT_COUNT
+};
+
+static const char *const layout_names[LAYOUT_COUNT] = {
+	[LAYOUT_SORTED] = "sorted",
+	[LAYOUT_REVERSED] = "reversed",
+	[LAYOUT_SHUFFLED] = "shuffled",
+	[LAYOUT_KERNELS] = "kernels",
+};
+
+/* A synthetic drive, with the GPT pointing into its image */
+struct bench_drive {
+	uint8_t *image;
+	uint64_t sectors;
+	GptData gpt;
+	/* Image file and searches for cgpt find */
+	char filename[64];
+	char label[16];
+	CgptFindParams find_label;
+	CgptFindParams find_type;
+};
+
+static void find_show(struct CgptFindParams *params, const char *filename,
+		      int partnum, GptEntry *entry);
+
+static const Guid guid_kernel = GPT_ENT_TYPE_CHROMEOS_KERNEL;
+static const Guid guid_rootfs = GPT_ENT_TYPE_CHROMEOS_ROOTFS;
+
+/*
+ * Fill in entry 'index' of a table with 'used' entries, as partition number
+ * 'part' in LBA order.
+ */
+static void fill_entry(GptEntry *e, enum layout layout, uint32_t index,
+		       uint32_t part)
+{
+	Guid unique = {{{index, 0xd450, 0x44bc, 0xa6, 0x93,
+			 {0xb8, 0xac, 0x75, 0x5f, 0xcd, 0x48}}}};
+	char label[16];
+	int i;
+
+	if (layout == LAYOUT_KERNELS || !(index % 2)) {
+		e->type = guid_kernel;
+		SetEntryPriority(e, 1 + index % 15);
+		SetEntryTries(e, 15);
+	} else {
+		e->type = guid_rootfs;
+	}
+	e->unique = unique;
+	e->starting_lba = FIRST_USABLE_LBA + part * PARTITION_SECTORS;
+	e->ending_lba = e->starting_lba + PARTITION_SECTORS - 1;
+
+	snprintf(label, sizeof(label), "part-%u", index);
+	for (i = 0; label[i]; i++)
+		e->name[i] = label[i];
+}
+
+/* Build a drive with 'used' partitions.  Returns 0 if success. */
+static int build_drive(struct bench_drive *d, enum layout layout,
+		       uint32_t used)
+{
+	GptHeader *h1, *h2;
+	GptEntry *e1, *e2;
+	uint32_t order[MAX_NUMBER_OF_ENTRIES];
+	uint32_t seed = 12345;
+	uint32_t i;
+	int fd;
+
+	memset(d, 0, sizeof(*d));
+	d->sectors = FIRST_USABLE_LBA + used * PARTITION_SECTORS +
+		ENTRIES_SECTORS + GPT_HEADER_SECTORS;
+	d->image = calloc(d->sectors, SECTOR_BYTES);
+	if (!d->image)
+		return 1;
+
+	d->gpt.sector_bytes = SECTOR_BYTES;
+	d->gpt.streaming_drive_sectors = d->sectors;
+	d->gpt.gpt_drive_sectors = d->sectors;
+	d->gpt.primary_header = d->image + GPT_PMBR_SECTORS * SECTOR_BYTES;
+	d->gpt.primary_entries = d->gpt.primary_header + SECTOR_BYTES;
+	d->gpt.secondary_header =
+		d->image + (d->sectors - GPT_HEADER_SECTORS) * SECTOR_BYTES;
+	d->gpt.secondary_entries =
+		d->gpt.secondary_header - ENTRIES_SECTORS * SECTOR_BYTES;
+	h1 = (GptHeader *)d->gpt.primary_header;
+	h2 = (GptHeader *)d->gpt.secondary_header;
+	e1 = (GptEntry *)d->gpt.primary_entries;
+	e2 = (GptEntry *)d->gpt.secondary_entries;
+
+	/* Partition number in LBA order for each entry */
+	for (i = 0; i < used; i++)
+		order[i] = layout == LAYOUT_REVERSED ? used - 1 - i : i;
+	if (layout == LAYOUT_SHUFFLED) {
+		for (i = used - 1; i > 0; i--) {
+			uint32_t j, tmp;
+
+			seed = seed * 1103515245 + 12345;
+			j = (seed >> 16) % (i + 1);
+			tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+	}
+	for (i = 0; i < used; i++)
+		fill_entry(e1 + i, layout, i, order[i]);
+	snprintf(d->label, sizeof(d->label), "part-%u", used - 1);
+
+	memcpy(h1->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
+	h1->revision = GPT_HEADER_REVISION;
+	h1->size = sizeof(GptHeader);
+	h1->my_lba = GPT_PMBR_SECTORS;
+	h1->alternate_lba = d->sectors - GPT_HEADER_SECTORS;
+	h1->first_usable_lba = FIRST_USABLE_LBA;
+	h1->last_usable_lba = d->sectors - GPT_HEADER_SECTORS -
+		ENTRIES_SECTORS - 1;
+	h1->entries_lba = GPT_PMBR_SECTORS + GPT_HEADER_SECTORS;
+	h1->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+	h1->size_of_entry = sizeof(GptEntry);
+	h1->entries_crc32 = Crc32(e1, GPT_ENTRIES_ALLOC_SIZE);
+	h1->header_crc32 = HeaderCrc(h1);
+
+	memcpy(e2, e1, GPT_ENTRIES_ALLOC_SIZE);
+	memcpy(h2, h1, sizeof(GptHeader));
+	h2->my_lba = h1->alternate_lba;
+	h2->alternate_lba = h1->my_lba;
+	h2->entries_lba = h2->my_lba - ENTRIES_SECTORS;
+	h2->header_crc32 = HeaderCrc(h2);
+
+	/* cgpt find opens the drive by name */
+	snprintf(d->filename, sizeof(d->filename), "%s/cgpt_bench.XXXXXX",
+		 getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+	fd = mkstemp(d->filename);
+	if (fd < 0)
+		return 1;
+	if (write(fd, d->image, d->sectors * SECTOR_BYTES) !=
+	    d->sectors * SECTOR_BYTES) {
+		close(fd);
+		return 1;
+	}
+	close(fd);
+
+	/* Find the last entry by label, and all the kernels by type */
+	d->find_label.drive_name = d->filename;
+	d->find_label.show_fn = find_show;
+	d->find_label.set_label = 1;
+	d->find_label.label = d->label;
+	d->find_type.drive_name = d->filename;
+	d->find_type.show_fn = find_show;
+	d->find_type.set_type = 1;
+	d->find_type.type_guid = guid_kernel;
+
+	return GptInit(&d->gpt) != GPT_SUCCESS;
+}
+
+static void free_drive(struct bench_drive *d)
+{
+	if (d->filename[0])
+		unlink(d->filename);
+	free(d->image);
+}
+
+static void bench_gpt_init(void *arg, size_t size)
+{
+	struct bench_drive *d = arg;
+
+	GptInit(&d->gpt);
+}
+
+static void bench_sanity_check(void *arg, size_t size)
+{
+	struct bench_drive *d = arg;
+
+	GptSanityCheck(&d->gpt);
+}
+
+static void bench_check_entries(void *arg, size_t size)
+{
+	struct bench_drive *d = arg;
+
+	CheckEntries((GptEntry *)d->gpt.primary_entries,
+		     (GptHeader *)d->gpt.primary_header);
+}
+
+/* Walk all the kernels, as LoadKernel() does when none of them boot */
+static void bench_next_kernel(void *arg, size_t size)
+{
+	struct bench_drive *d = arg;
+	uint64_t start, sectors;
+
+	d->gpt.current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+	d->gpt.current_priority = 999;
+	d->gpt.kernel_order_next = 0;
+	while (GptNextKernelEntry(&d->gpt, &start, &sectors) == GPT_SUCCESS)
+		;
+}
+
+/* Mark the first kernel active; this rewrites the entry and its CRCs */
+static void bench_update_kernel(void *arg, size_t size)
+{
+	struct bench_drive *d = arg;
+
+	d->gpt.current_kernel = 0;
+	d->gpt.current_priority = 999;
+	GptUpdateKernelEntry(&d->gpt, GPT_UPDATE_ENTRY_ACTIVE);
+}
+
+/* Rebuild the secondary GPT from the primary */
+static void bench_repair(void *arg, size_t size)
+{
+	struct bench_drive *d = arg;
+
+	d->gpt.valid_headers = MASK_PRIMARY;
+	d->gpt.valid_entries = MASK_PRIMARY;
+	GptRepair(&d->gpt);
+}
+
+static void bench_find_label(void *arg, size_t size)
+{
+	struct bench_drive *d = arg;
+
+	CgptFind(&d->find_label);
+}
+
+static void bench_find_type(void *arg, size_t size)
+{
+	struct bench_drive *d = arg;
+
+	CgptFind(&d->find_type);
+}
+
+static void find_show(struct CgptFindParams *params, const char *filename,
+		      int partnum, GptEntry *entry)
+{
+	/* Count matches without printing them */
+}
+
+static const struct {
+	const char *name;
+	bench_func_t func;
+} funcs[] = {
+	{"GptInit", bench_gpt_init},
+	{"GptSanityCheck", bench_sanity_check},
+	{"CheckEntries", bench_check_entries},
+	{"GptNextKernelEntry_all", bench_next_kernel},
+	{"GptUpdateKernelEntry", bench_update_kernel},
+	{"GptRepair", bench_repair},
+	{"cgpt_find_label", bench_find_label},
+	{"cgpt_find_type", bench_find_type},
+};
+
+int main(int argc, char *argv[])
+{
+	struct bench_options opts;
+	struct bench_result result;
+	struct bench_drive drive;
+	char name[64];
+	uint32_t used;
+	int layout;
+	int i;
+
+	bench_init_options(&opts);
+	if (bench_parse_args(&opts, argc, argv) < 0)
+		return 1;
+
+	bench_report_begin(&opts);
+	for (layout = 0; layout < LAYOUT_COUNT; layout++) {
+		/*
+		 * Tables always have MAX_NUMBER_OF_ENTRIES slots, unless the
+		 * GPT is external, so scale the number of them in use.
+		 */
+		for (used = 4; used <= MAX_NUMBER_OF_ENTRIES; used *= 2) {
+			if (build_drive(&drive, layout, used)) {
+				fprintf(stderr, "Unable to build %s drive "
+					"with %u entries\n",
+					layout_names[layout], used);
+				free_drive(&drive);
+				return 1;
+			}
+
+			for (i = 0; i < ARRAY_SIZE(funcs); i++) {
+				bench_run(&opts, funcs[i].func, &drive, 0,
+					  &result);
+				snprintf(name, sizeof(name), "%s_%s_%u",
+					 funcs[i].name, layout_names[layout],
+					 used);
+				bench_report(&opts, name, 0, &result);
+			}
+
+			if (!drive.find_label.hits || !drive.find_type.hits) {
+				fprintf(stderr, "cgpt find failed on %s drive "
+					"with %u entries\n",
+					layout_names[layout], used);
+				free_drive(&drive);
+				return 1;
+			}
+			free_drive(&drive);
+		}
+	}
+	bench_report_end(&opts);
+
+	return 0;
+}
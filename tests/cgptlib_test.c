@@ -848,6 +848,32 @@ static int OverlappedPartitionTest(void) {
 
 		EXPECT(cases[i].overlapped == CheckEntries(e, h));
 	}
+
+	/* A full table, with the partitions in reverse order on the disk */
+	BuildTestGptData(gpt);
+	for (j = 0; j < MAX_NUMBER_OF_ENTRIES; j++) {
+		memcpy(&e[j].type, &guid_kernel, sizeof(Guid));
+		SetGuid(&e[j].unique, j);
+		e[j].starting_lba = 34 + (MAX_NUMBER_OF_ENTRIES - 1 - j) * 3;
+		e[j].ending_lba = e[j].starting_lba + 2;
+	}
+	RefreshCrc32(gpt);
+	EXPECT(0 == CheckEntries(e, h));
+
+	e[1].ending_lba++;
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_START_LBA_OVERLAP == CheckEntries(e, h));
+	e[1].ending_lba--;
+
+	SetGuid(&e[100].unique, 7);
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_DUP_GUID == CheckEntries(e, h));
+	SetGuid(&e[100].unique, 100);
+
+	e[MAX_NUMBER_OF_ENTRIES - 1].starting_lba--;
+	RefreshCrc32(gpt);
+	EXPECT(GPT_ERROR_OUT_OF_REGION == CheckEntries(e, h));
+
 	return TEST_OK;
 }
 
@@ -1212,6 +1238,54 @@ static int EntryTypeTest(void)
 	return TEST_OK;
 }
 
+static int ClassifyEntriesTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptEntry *e = (GptEntry *)(gpt->primary_entries);
+	uint32_t used[GPT_ENTRY_MASK_WORDS];
+	uint32_t kernel[GPT_ENTRY_MASK_WORDS];
+	int i;
+
+	ZeroEntries(gpt);
+	memcpy(&e[0].type, &guid_kernel, sizeof(Guid));
+	memcpy(&e[1].type, &guid_rootfs, sizeof(Guid));
+	memcpy(&e[33].type, &guid_kernel, sizeof(Guid));
+	memcpy(&e[127].type, &guid_rootfs, sizeof(Guid));
+	/* One byte off from the kernel GUID */
+	memcpy(&e[64].type, &guid_kernel, sizeof(Guid));
+	e[64].type.u.raw[0] ^= 1;
+
+	ClassifyEntries(e, MAX_NUMBER_OF_ENTRIES, used, kernel);
+	EXPECT(used[0] == 0x00000003);
+	EXPECT(used[1] == 0x00000002);
+	EXPECT(used[2] == 0x00000001);
+	EXPECT(used[3] == 0x80000000);
+	EXPECT(kernel[0] == 0x00000001);
+	EXPECT(kernel[1] == 0x00000002);
+	EXPECT(kernel[2] == 0);
+	EXPECT(kernel[3] == 0);
+	for (i = 0; i < MAX_NUMBER_OF_ENTRIES; i++)
+		EXPECT(!!(used[i / 32] & (1U << (i % 32))) ==
+		       !IsUnusedEntry(e + i));
+
+	/* Entries past count aren't classified */
+	ClassifyEntries(e, 34, used, NULL);
+	EXPECT(used[1] == 0x00000002);
+	EXPECT(used[3] == 0);
+
+	EXPECT(0 == NextEntryInMask(kernel, MAX_NUMBER_OF_ENTRIES, 0));
+	EXPECT(33 == NextEntryInMask(kernel, MAX_NUMBER_OF_ENTRIES, 1));
+	EXPECT(MAX_NUMBER_OF_ENTRIES ==
+	       NextEntryInMask(kernel, MAX_NUMBER_OF_ENTRIES, 34));
+	ClassifyEntries(e, MAX_NUMBER_OF_ENTRIES, used, NULL);
+	EXPECT(127 == NextEntryInMask(used, MAX_NUMBER_OF_ENTRIES, 65));
+	EXPECT(100 == NextEntryInMask(used, 100, 65));
+	EXPECT(MAX_NUMBER_OF_ENTRIES ==
+	       NextEntryInMask(used, MAX_NUMBER_OF_ENTRIES, 128));
+
+	return TEST_OK;
+}
+
 /* Make an entry unused by clearing its type. */
 static void FreeEntry(GptEntry *e)
 {
@@ -1334,6 +1408,43 @@ static int GetNextTriesTest(void)
 	return TEST_OK;
 }
 
+static int GetNextUpdatedTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptEntry *e1 = (GptEntry *)(gpt->primary_entries);
+	uint64_t start, size;
+
+	/* Changing a kernel we haven't reached yet changes the boot order */
+	BuildTestGptData(gpt);
+	FillEntry(e1 + KERNEL_A, 1, 4, 1, 0);
+	FillEntry(e1 + KERNEL_B, 1, 3, 0, 2);
+	FillEntry(e1 + KERNEL_X, 1, 2, 0, 2);
+	FillEntry(e1 + KERNEL_Y, 1, 0, 0, 0);
+	RefreshCrc32(gpt);
+	GptInit(gpt);
+
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_A == gpt->current_kernel);
+	EXPECT(GPT_SUCCESS == GptUpdateKernelWithEntry(gpt, e1 + KERNEL_B,
+						       GPT_UPDATE_ENTRY_BAD));
+	EXPECT(GPT_SUCCESS == GptUpdateKernelWithEntry(
+		       gpt, e1 + KERNEL_Y, GPT_UPDATE_ENTRY_ACTIVE));
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_X == gpt->current_kernel);
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_Y == gpt->current_kernel);
+	EXPECT(GPT_ERROR_NO_VALID_KERNEL ==
+	       GptNextKernelEntry(gpt, &start, &size));
+
+	/* Nor does an update after the walk bring back earlier kernels */
+	EXPECT(GPT_SUCCESS == GptUpdateKernelWithEntry(gpt, e1 + KERNEL_B,
+						       GPT_UPDATE_ENTRY_ACTIVE));
+	EXPECT(GPT_ERROR_NO_VALID_KERNEL ==
+	       GptNextKernelEntry(gpt, &start, &size));
+
+	return TEST_OK;
+}
+
 static int GptUpdateTest(void)
 {
 	GptData *gpt = GetEmptyGptData();
@@ -1410,6 +1521,11 @@ static int GptUpdateTest(void)
 	EXPECT(0 == GetEntryPriority(e + KERNEL_X));
 	EXPECT(0 == GetEntryTries(e + KERNEL_X));
 
+	/* Incrementally updated CRCs still match both copies */
+	EXPECT(GPT_SUCCESS == GptSanityCheck(gpt));
+	EXPECT(MASK_BOTH == gpt->valid_headers);
+	EXPECT(MASK_BOTH == gpt->valid_entries);
+
 	/* Can't update if entry isn't a kernel, or there isn't an entry */
 	memcpy(&e[KERNEL_X].type, &guid_rootfs, sizeof(guid_rootfs));
 	EXPECT(GPT_ERROR_INVALID_UPDATE_TYPE ==
@@ -1625,13 +1741,17 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(NoValidKernelEntryTest), },
 		{ TEST_CASE(EntryAttributeGetSetTest), },
 		{ TEST_CASE(EntryTypeTest), },
+		{ TEST_CASE(ClassifyEntriesTest), },
 		{ TEST_CASE(GetNextNormalTest), },
 		{ TEST_CASE(GetNextPrioTest), },
 		{ TEST_CASE(GetNextTriesTest), },
+		{ TEST_CASE(GetNextUpdatedTest), },
 		{ TEST_CASE(GptUpdateTest), },
 		{ TEST_CASE(UpdateInvalidKernelTypeTest), },
 		{ TEST_CASE(DuplicateUniqueGuidTest), },
 		{ TEST_CASE(TestCrc32TestVectors), },
+		{ TEST_CASE(TestCrc32Lengths), },
+		{ TEST_CASE(TestCrc32CombineUpdate), },
 		{ TEST_CASE(GetKernelGuidTest), },
 		{ TEST_CASE(ErrorTextTest), },
 		{ TEST_CASE(CheckHeaderOffDevice), },
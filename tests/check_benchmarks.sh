@@ -0,0 +1,63 @@
+#!/bin/bash
+
+# Copyright 2020 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Compare benchmark results with a baseline. Both files hold the name:value
+# lines the benchmarks print on stdout. Throughputs (*_per_sec_* keys) which
+# drop more than THRESHOLD percent below the baseline, or are missing from the
+# results, fail the check; other values are informational and vary too much
+# between runs to gate on.
+
+# Load common constants and variables.
+. "$(dirname "$0")/common.sh"
+
+if [ $# -lt 2 ]; then
+  echo "Usage: $0 <results> <baseline> [threshold_percent]" 1>&2
+  exit 1
+fi
+
+RESULTS=$1
+BASELINE=$2
+THRESHOLD=${3:-20}
+
+if [ ! -f "${BASELINE}" ]; then
+  echo -e "${COL_YELLOW}No baseline ${BASELINE}; not checking results." \
+    "Run 'make updatebenchmarks' to create one.${COL_STOP}" 1>&2
+  exit 0
+fi
+
+awk -F: -v threshold="${THRESHOLD}" '
+  NR == FNR { base[$1] = $2; next }
+  $1 !~ /_per_sec_/ || !($1 in base) || base[$1] <= 0 { next }
+  {
+    change = ($2 - base[$1]) * 100 / base[$1]
+    bad = change < -threshold
+    printf("%-48s %14.2f %14.2f %+7.1f%%%s\n", $1, base[$1], $2, change,
+           bad ? "  REGRESSION" : "")
+    seen[$1] = 1
+    checked++
+    failed += bad
+  }
+  END {
+    # A benchmark which stopped reporting can hide any regression
+    for (key in base) {
+      if (key !~ /_per_sec_/ || base[key] <= 0 || key in seen)
+        continue
+      printf("%-48s %14.2f %14s %8s\n", key, base[key], "-", "MISSING")
+      checked++
+      failed++
+    }
+    printf("%d of %d throughputs dropped more than %s%% or are missing\n",
+           failed, checked, threshold)
+    exit failed != 0
+  }' "${BASELINE}" "${RESULTS}"
+status=$?
+
+if [ ${status} -eq 0 ]; then
+  happy "No benchmark regressions against ${BASELINE}"
+else
+  echo -e "${COL_RED}Benchmarks regressed against ${BASELINE}${COL_STOP}" 1>&2
+fi
+exit ${status}
@@ -46,3 +46,80 @@ int TestCrc32TestVectors(void) {
 	}
 	return TEST_OK;
 }
+
+/* Bit-at-a-time reference implementation */
+static uint32_t Crc32Bitwise(const uint8_t *buf, uint32_t len)
+{
+	uint32_t value = ~0U;
+	int bit;
+
+	while (len--) {
+		value ^= *buf++;
+		for (bit = 0; bit < 8; bit++)
+			value = (value >> 1) ^ (0xedb88320U & -(value & 1));
+	}
+	return ~value;
+}
+
+/*
+ * Lengths and alignments around the slice-by-8 and CPU-accelerated block
+ * boundaries, up to the size of a full GPT entries array.
+ */
+int TestCrc32Lengths(void) {
+	static const uint32_t lengths[] = {
+		0, 1, 7, 8, 9, 15, 16, 17, 63, 64, 65, 79, 80, 127, 128,
+		129, 255, 256, 1000, 16383, 16384
+	};
+	static uint8_t buf[16384 + 8];
+	int i, offset;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (uint8_t)(i * 37 + (i >> 8));
+
+	for (offset = 0; offset < 8; offset += 3) {
+		for (i = 0; i < ARRAY_SIZE(lengths); ++i) {
+			const uint8_t *p = buf + offset;
+
+			EXPECT(Crc32(p, lengths[i]) ==
+			       Crc32Bitwise(p, lengths[i]));
+		}
+	}
+	return TEST_OK;
+}
+
+int TestCrc32CombineUpdate(void) {
+	static const uint32_t splits[] = {0, 1, 100, 16383, 16384};
+	static uint8_t buf[16384];
+	uint8_t old[128], new[128];
+	uint32_t crc, offset;
+	int i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (uint8_t)(i * 13 + (i >> 7));
+	crc = Crc32(buf, sizeof(buf));
+
+	for (i = 0; i < ARRAY_SIZE(splits); ++i) {
+		uint32_t a = splits[i];
+
+		EXPECT(Crc32Combine(Crc32(buf, a), Crc32(buf + a,
+							 sizeof(buf) - a),
+				    sizeof(buf) - a) == crc);
+	}
+
+	/* Rewrite a 128-byte entry at the start, middle and end */
+	for (offset = 0; offset < sizeof(buf); offset += 8128) {
+		memcpy(old, buf + offset, sizeof(old));
+		for (i = 0; i < sizeof(new); i++)
+			new[i] = old[i] ^ (uint8_t)(i + offset);
+		memcpy(buf + offset, new, sizeof(new));
+		crc = Crc32Update(crc, sizeof(buf), offset, old, new,
+				  sizeof(new));
+		EXPECT(crc == Crc32(buf, sizeof(buf)));
+	}
+
+	/* Unchanged data leaves the CRC alone */
+	EXPECT(Crc32Update(crc, sizeof(buf), 0, buf, buf, 0) == crc);
+	EXPECT(Crc32Update(crc, sizeof(buf), 64, buf + 64, buf + 64, 64) ==
+	       crc);
+	return TEST_OK;
+}
@@ -0,0 +1,76 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Throughput of the CRCs on the boot path: CRC-8 over nvdata and secdata,
+ * CRC-32 over GPT headers and entries.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "2common.h"
+#include "2crc8.h"
+#include "2sysincludes.h"
+#include "benchmark.h"
+#include "crc32.h"
+
+static void crc8_buffer(void *arg, size_t size)
+{
+	volatile uint8_t crc = vb2_crc8(arg, size);
+
+	(void)crc;
+}
+
+static void crc32_buffer(void *arg, size_t size)
+{
+	volatile uint32_t crc = Crc32(arg, size);
+
+	(void)crc;
+}
+
+static const struct {
+	const char *name;
+	bench_func_t func;
+} crcs[] = {
+	{"CRC8", crc8_buffer},
+	{"CRC32", crc32_buffer},
+};
+
+int main(int argc, char *argv[])
+{
+	struct bench_options opts;
+	struct bench_result result;
+	uint8_t *buffer;
+	size_t size;
+	size_t i;
+
+	bench_init_options(&opts);
+	/* Firmware never checksums anything near the default 64 MB */
+	opts.min_size = 16;
+	opts.max_size = 1024 * 1024;
+	if (bench_parse_args(&opts, argc, argv) < 0)
+		return 1;
+
+	buffer = malloc(opts.max_size);
+	if (!buffer) {
+		fprintf(stderr, "Unable to allocate %zu bytes\n",
+			opts.max_size);
+		return 1;
+	}
+	for (i = 0; i < opts.max_size; i++)
+		buffer[i] = i * 7;
+
+	bench_report_begin(&opts);
+	for (i = 0; i < ARRAY_SIZE(crcs); i++) {
+		for (size = opts.min_size; size <= opts.max_size; size *= 4) {
+			bench_run(&opts, crcs[i].func, buffer, size, &result);
+			bench_report(&opts, crcs[i].name, size, &result);
+		}
+	}
+	bench_report_end(&opts);
+
+	free(buffer);
+	return 0;
+}
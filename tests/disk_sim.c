@@ -0,0 +1,244 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Deterministic block device simulator for kernel loading tests and
+ * benchmarks.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "2common.h"
+#include "disk_sim.h"
+
+/* A stream over part of a simulated disk */
+struct disk_sim_stream {
+	struct disk_sim *sim;
+	/* Next sector to read, and sectors left in the partition */
+	uint64_t sector;
+	uint64_t sectors_left;
+	/* Reads queued on this stream and not yet waited for */
+	uint32_t queued;
+};
+
+static uint32_t queue_depth(const struct disk_sim *sim)
+{
+	if (!sim->config.queue_depth)
+		return 1;
+	return VB2_MIN(sim->config.queue_depth, DISK_SIM_MAX_QUEUED);
+}
+
+static uint64_t transfer_ns(const struct disk_sim *sim, uint64_t bytes)
+{
+	if (!sim->config.bytes_per_sec)
+		return 0;
+	return bytes * 1000000000ULL / sim->config.bytes_per_sec;
+}
+
+static int injected_error(const struct disk_sim *sim, uint64_t lba_start,
+			  uint64_t lba_count)
+{
+	const struct disk_sim_config *c = &sim->config;
+
+	if (c->fail_request && sim->stats.requests == c->fail_request)
+		return 1;
+
+	return c->fail_lba_count &&
+	       lba_start < c->fail_lba + c->fail_lba_count &&
+	       c->fail_lba < lba_start + lba_count;
+}
+
+void disk_sim_init(struct disk_sim *sim, const struct disk_sim_config *config,
+		   disk_sim_read_func read, void *arg)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->config = *config;
+	if (!sim->config.bytes_per_lba)
+		sim->config.bytes_per_lba = 512;
+	sim->read = read;
+	sim->read_arg = arg;
+}
+
+void disk_sim_reset(struct disk_sim *sim)
+{
+	memset(&sim->stats, 0, sizeof(sim->stats));
+	memset(sim->slot_free_ns, 0, sizeof(sim->slot_free_ns));
+	sim->link_free_ns = 0;
+	sim->queued_first = 0;
+	sim->queued_count = 0;
+}
+
+uint64_t disk_sim_now(const struct disk_sim *sim)
+{
+	return (sim->clock_ns ? sim->clock_ns() : 0) + sim->stats.stall_ns;
+}
+
+vb2_error_t disk_sim_submit(struct disk_sim *sim, uint64_t lba_start,
+			    uint64_t lba_count, void *buffer)
+{
+	struct disk_sim_request *r;
+	uint64_t *slot;
+	uint64_t t;
+
+	if (sim->queued_count >= DISK_SIM_MAX_QUEUED)
+		return VB2_ERROR_UNKNOWN;
+
+	r = &sim->queue[(sim->queued_first + sim->queued_count) %
+			DISK_SIM_MAX_QUEUED];
+	slot = &sim->slot_free_ns[sim->stats.requests % queue_depth(sim)];
+	sim->stats.requests++;
+	sim->queued_count++;
+	sim->stats.max_queued = VB2_MAX(sim->stats.max_queued,
+					sim->queued_count);
+
+	r->lba_start = lba_start;
+	r->lba_count = lba_count;
+	r->buffer = buffer;
+	r->rv = injected_error(sim, lba_start, lba_count) ?
+		VB2_ERROR_MOCK : VB2_SUCCESS;
+
+	/* Wait for a device slot, then the latency, then the link */
+	t = VB2_MAX(disk_sim_now(sim), *slot) + sim->config.latency_ns;
+	t = VB2_MAX(t, sim->link_free_ns) +
+	    transfer_ns(sim, lba_count * sim->config.bytes_per_lba);
+	r->done_ns = sim->link_free_ns = *slot = t;
+
+	return VB2_SUCCESS;
+}
+
+vb2_error_t disk_sim_wait(struct disk_sim *sim)
+{
+	struct disk_sim_request *r;
+	uint64_t now = disk_sim_now(sim);
+
+	if (!sim->queued_count)
+		return VB2_ERROR_UNKNOWN;
+
+	r = &sim->queue[sim->queued_first];
+	sim->queued_first = (sim->queued_first + 1) % DISK_SIM_MAX_QUEUED;
+	sim->queued_count--;
+
+	if (r->done_ns > now)
+		sim->stats.stall_ns += r->done_ns - now;
+
+	if (r->rv)
+		return r->rv;
+
+	sim->stats.bytes += r->lba_count * sim->config.bytes_per_lba;
+	return sim->read(sim->read_arg, r->lba_start, r->lba_count, r->buffer);
+}
+
+vb2_error_t disk_sim_read(struct disk_sim *sim, uint64_t lba_start,
+			  uint64_t lba_count, void *buffer)
+{
+	vb2_error_t rv;
+
+	if (sim->queued_count)
+		return VB2_ERROR_UNKNOWN;
+
+	rv = disk_sim_submit(sim, lba_start, lba_count, buffer);
+	if (rv)
+		return rv;
+
+	return disk_sim_wait(sim);
+}
+
+vb2_error_t disk_sim_stream_open(struct disk_sim *sim, uint64_t lba_start,
+				 uint64_t lba_count, VbExStream_t *stream)
+{
+	struct disk_sim_stream *s = calloc(1, sizeof(*s));
+
+	if (!s) {
+		*stream = NULL;
+		return VB2_ERROR_UNKNOWN;
+	}
+
+	s->sim = sim;
+	s->sector = lba_start;
+	s->sectors_left = lba_count;
+	*stream = s;
+	return VB2_SUCCESS;
+}
+
+/* Move the stream past the next 'bytes', which must be whole sectors */
+static vb2_error_t stream_advance(struct disk_sim_stream *s, uint32_t bytes,
+				  uint64_t *sector, uint64_t *sectors)
+{
+	uint32_t lba_bytes = s->sim->config.bytes_per_lba;
+
+	if (bytes % lba_bytes || bytes / lba_bytes > s->sectors_left)
+		return VB2_ERROR_UNKNOWN;
+
+	*sector = s->sector;
+	*sectors = bytes / lba_bytes;
+	s->sector += *sectors;
+	s->sectors_left -= *sectors;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t disk_sim_stream_read(VbExStream_t stream, uint32_t bytes,
+				 void *buffer)
+{
+	struct disk_sim_stream *s = stream;
+	uint64_t sector, sectors;
+
+	if (!s || s->queued || stream_advance(s, bytes, &sector, &sectors))
+		return VB2_ERROR_UNKNOWN;
+
+	return disk_sim_read(s->sim, sector, sectors, buffer);
+}
+
+vb2_error_t disk_sim_stream_skip(VbExStream_t stream, uint32_t bytes)
+{
+	struct disk_sim_stream *s = stream;
+	uint64_t sector, sectors;
+
+	if (!s || s->queued)
+		return VB2_ERROR_UNKNOWN;
+
+	return stream_advance(s, bytes, &sector, &sectors);
+}
+
+vb2_error_t disk_sim_stream_submit(VbExStream_t stream, uint32_t bytes,
+				   void *buffer)
+{
+	struct disk_sim_stream *s = stream;
+	uint64_t sector, sectors;
+	vb2_error_t rv;
+
+	if (!s || s->queued >= VB_STREAM_MAX_READS ||
+	    stream_advance(s, bytes, &sector, &sectors))
+		return VB2_ERROR_UNKNOWN;
+
+	rv = disk_sim_submit(s->sim, sector, sectors, buffer);
+	if (rv)
+		return rv;
+
+	s->queued++;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t disk_sim_stream_wait(VbExStream_t stream)
+{
+	struct disk_sim_stream *s = stream;
+
+	if (!s || !s->queued)
+		return VB2_ERROR_UNKNOWN;
+
+	s->queued--;
+	return disk_sim_wait(s->sim);
+}
+
+void disk_sim_stream_close(VbExStream_t stream)
+{
+	struct disk_sim_stream *s = stream;
+
+	if (!s)
+		return;
+
+	/* Finish the reads still queued, so their buffers are free to reuse */
+	while (s->queued--)
+		disk_sim_wait(s->sim);
+	free(s);
+}
@@ -0,0 +1,148 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Deterministic block device simulator for kernel loading tests and
+ * benchmarks.
+ */
+
+#ifndef VBOOT_REFERENCE_DISK_SIM_H_
+#define VBOOT_REFERENCE_DISK_SIM_H_
+
+#include <stdint.h>
+
+#include "2return_codes.h"
+#include "vboot_api.h"
+
+/*
+ * Timing model: each request waits for one of the device's queue_depth slots,
+ * then spends latency_ns in the device before its data starts to move.  The
+ * data moves over one link at bytes_per_sec, so the latencies of queued
+ * requests overlap but their transfers don't.  Requests complete in the order
+ * they were submitted.
+ *
+ * Simulated time is the caller's clock, if it has one, plus the time the
+ * caller has spent waiting for the disk.  With no clock, computation is free
+ * and every run with the same requests takes exactly the same time.
+ */
+struct disk_sim_config {
+	/* Time from starting a request until its data starts to move */
+	uint64_t latency_ns;
+	/* Transfer rate, in bytes per second; 0 for instant */
+	uint64_t bytes_per_sec;
+	/* Requests the device works on at once; 0 means 1 */
+	uint32_t queue_depth;
+	/* Sector size, in bytes; 0 means 512 */
+	uint32_t bytes_per_lba;
+	/* Reads touching any of the fail_lba_count sectors at fail_lba fail */
+	uint64_t fail_lba;
+	uint64_t fail_lba_count;
+	/* The request with this number, counting from 1, fails; 0 for none */
+	uint32_t fail_request;
+};
+
+struct disk_sim_stats {
+	uint32_t requests;
+	uint64_t bytes;
+	/* Time the caller spent waiting for requests to complete */
+	uint64_t stall_ns;
+	/* Most requests outstanding at once */
+	uint32_t max_queued;
+};
+
+/* Most requests which may be outstanding, and the deepest device queue */
+#define DISK_SIM_MAX_QUEUED 16
+
+/*
+ * Backing store for the simulated disk.  Called when a request completes, to
+ * fill its buffer.
+ */
+typedef vb2_error_t (*disk_sim_read_func)(void *arg, uint64_t lba_start,
+					  uint64_t lba_count, void *buffer);
+
+struct disk_sim_request {
+	uint64_t lba_start;
+	uint64_t lba_count;
+	void *buffer;
+	uint64_t done_ns;
+	vb2_error_t rv;
+};
+
+struct disk_sim {
+	struct disk_sim_config config;
+	disk_sim_read_func read;
+	void *read_arg;
+	/* Caller's clock in ns, or NULL for none; may be set after init */
+	uint64_t (*clock_ns)(void);
+	struct disk_sim_stats stats;
+
+	/* When the link is next free, and each device slot */
+	uint64_t link_free_ns;
+	uint64_t slot_free_ns[DISK_SIM_MAX_QUEUED];
+
+	/* Outstanding requests, oldest first */
+	struct disk_sim_request queue[DISK_SIM_MAX_QUEUED];
+	uint32_t queued_first;
+	uint32_t queued_count;
+};
+
+/**
+ * Set up a simulated disk with no requests outstanding.
+ *
+ * @param sim		Simulator to set up
+ * @param config	Device timing and errors; copied
+ * @param read		Backing store
+ * @param arg		Passed to read()
+ */
+void disk_sim_init(struct disk_sim *sim, const struct disk_sim_config *config,
+		   disk_sim_read_func read, void *arg);
+
+/**
+ * Start the simulated time and stats over, and drop outstanding requests.
+ */
+void disk_sim_reset(struct disk_sim *sim);
+
+/**
+ * Return the simulated time, in ns.
+ */
+uint64_t disk_sim_now(const struct disk_sim *sim);
+
+/**
+ * Queue a read.  The buffer is filled when the read is waited for.
+ *
+ * @return VB2_SUCCESS, or VB2_ERROR_UNKNOWN if DISK_SIM_MAX_QUEUED reads are
+ * already outstanding.  Injected errors are returned by disk_sim_wait().
+ */
+vb2_error_t disk_sim_submit(struct disk_sim *sim, uint64_t lba_start,
+			    uint64_t lba_count, void *buffer);
+
+/**
+ * Wait for the oldest outstanding read to complete.
+ *
+ * @return The read's error, VB2_ERROR_MOCK if one was injected, or
+ * VB2_ERROR_UNKNOWN if no reads are outstanding.
+ */
+vb2_error_t disk_sim_wait(struct disk_sim *sim);
+
+/**
+ * Read and wait for the data.  No reads may be outstanding.
+ */
+vb2_error_t disk_sim_read(struct disk_sim *sim, uint64_t lba_start,
+			  uint64_t lba_count, void *buffer);
+
+/*
+ * Streams over the simulated disk, with the same restrictions as the stub
+ * streams in firmware/stub.  Tests and benchmarks call these from their own
+ * VbExStream*() functions.
+ */
+vb2_error_t disk_sim_stream_open(struct disk_sim *sim, uint64_t lba_start,
+				 uint64_t lba_count, VbExStream_t *stream);
+vb2_error_t disk_sim_stream_read(VbExStream_t stream, uint32_t bytes,
+				 void *buffer);
+vb2_error_t disk_sim_stream_skip(VbExStream_t stream, uint32_t bytes);
+vb2_error_t disk_sim_stream_submit(VbExStream_t stream, uint32_t bytes,
+				   void *buffer);
+vb2_error_t disk_sim_stream_wait(VbExStream_t stream);
+void disk_sim_stream_close(VbExStream_t stream);
+
+#endif  /* VBOOT_REFERENCE_DISK_SIM_H_ */
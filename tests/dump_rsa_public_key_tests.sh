@@ -0,0 +1,47 @@
+#!/bin/bash
+
+# Copyright 2020 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Run tests for dumpRSAPublicKey batch mode.
+
+# Load common constants and variables.
+. "$(dirname "$0")/common.sh"
+
+set -e
+
+check_test_keys
+echo "Testing dumpRSAPublicKey -batch..."
+
+OUT="${TESTKEY_SCRATCH_DIR}/dump_rsa"
+rm -rf "${OUT}"
+mkdir -p "${OUT}"
+
+# Each line names a certificate and the .keyb to write for it
+cat > "${OUT}/manifest" <<EOF
+# comments and blank lines are skipped
+
+${TESTKEY_DIR}/key_rsa1024.crt ${OUT}/key_rsa1024.keyb
+${TESTKEY_DIR}/key_rsa2048.crt ${OUT}/key_rsa2048.keyb
+EOF
+${BIN_DIR}/dumpRSAPublicKey -batch -cert "${OUT}/manifest"
+cmp "${TESTKEY_DIR}/key_rsa1024.keyb" "${OUT}/key_rsa1024.keyb"
+cmp "${TESTKEY_DIR}/key_rsa2048.keyb" "${OUT}/key_rsa2048.keyb"
+
+# A line with an extra word fails, but the other lines are still converted
+cat > "${OUT}/manifest" <<EOF
+${TESTKEY_DIR}/key_rsa1024.crt ${OUT}/extra.keyb ${OUT}/extra2.keyb
+${TESTKEY_DIR}/key_rsa4096.crt ${OUT}/key_rsa4096.keyb
+EOF
+if ${BIN_DIR}/dumpRSAPublicKey -batch -cert - < "${OUT}/manifest" \
+    2> "${OUT}/err"; then
+  error "Line with an extra word was accepted"
+fi
+grep -q -- "-:1: expected <input file> <output file>" "${OUT}/err"
+[ ! -e "${OUT}/extra.keyb" ]
+cmp "${TESTKEY_DIR}/key_rsa4096.keyb" "${OUT}/key_rsa4096.keyb"
+
+rm -rf "${OUT}"
+happy "dumpRSAPublicKey -batch tests passed"
+exit 0
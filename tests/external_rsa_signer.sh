@@ -1,8 +1,33 @@
 #!/bin/bash
 
+if [ $# -eq 2 ] && [ "$1" = "--persistent" ]; then
+  # Each request is a 4-byte big-endian length and that much data to sign;
+  # answer each the same way with the signature, until EOF.
+  pem=$2
+  sig=$(mktemp)
+  trap 'rm -f "${sig}"' EXIT
+  while len=$(dd bs=1 count=4 2>/dev/null | od -An -tu1) && [ -n "${len}" ]
+  do
+    read -r b0 b1 b2 b3 <<<"${len}"
+    len=$(( (b0 << 24) | (b1 << 16) | (b2 << 8) | b3 ))
+    if ! dd bs=1 count=${len} 2>/dev/null |
+         openssl rsautl -sign -inkey "${pem}" > "${sig}"; then
+      : > "${sig}"
+    fi
+    len=$(stat -c %s "${sig}")
+    printf "$(printf '\\%03o\\%03o\\%03o\\%03o' \
+      $(( len >> 24 & 255 )) $(( len >> 16 & 255 )) \
+      $(( len >> 8 & 255 )) $(( len & 255 )))"
+    cat "${sig}"
+  done
+  exit 0
+fi
+
 if [ $# -ne 1 ]; then
-  echo "Usage: $0 <private_key_pem_file>"
+  echo "Usage: $0 [--persistent] <private_key_pem_file>"
   echo "Reads data to sign from stdin, encrypted data is output to stdout"
+  echo "With --persistent, each signature request and response is prefixed"
+  echo "with its 4-byte big-endian length, until EOF"
   exit 1
 fi
 
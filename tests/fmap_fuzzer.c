@@ -0,0 +1,55 @@
+// Copyright 2020 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fmap.h"
+
+// Look up each area of the FMAP in the input both through the name index and
+// by walking the FMAP, and insist that they find the same area.
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	struct fmap_index index;
+	FmapHeader *fmap;
+	uint8_t *image;
+	int i;
+
+	if (size < sizeof(FmapHeader))
+		return 0;
+
+	// The FMAP functions take a writable image. Copy the input to a buffer
+	// of exactly its size, so reads past its end are caught.
+	image = malloc(size);
+	if (!image)
+		abort();
+	memcpy(image, data, size);
+
+	fmap = fmap_find(image, size);
+	if (!fmap || fmap_index_init(&index, image, size, fmap)) {
+		free(image);
+		return 0;
+	}
+
+	for (i = 0; i < index.nareas; i++) {
+		char name[FMAP_NAMELEN + 1] = {0};
+		FmapAreaHeader *ah = NULL, *index_ah = NULL;
+		uint8_t *area, *index_area;
+
+		memcpy(name, index.areas[i]->area_name, FMAP_NAMELEN);
+		area = fmap_find_by_name(image, size, fmap, name, &ah);
+		index_area = fmap_index_find(&index, image, name, &index_ah);
+		if (area != index_area || ah != index_ah)
+			abort();
+	}
+
+	// So must a name which is unlikely to be in the FMAP
+	if (fmap_index_find(&index, image, "", NULL) !=
+	    fmap_find_by_name(image, size, fmap, "", NULL))
+		abort();
+
+	fmap_index_free(&index);
+	free(image);
+	return 0;
+}
@@ -0,0 +1,62 @@
+#!/bin/bash -eu
+# Copyright 2020 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Benchmark futility sign and verify end to end, on a bios.bin and a kernel
+# partition, with each of the test key sizes. Results are name:value lines
+# on stdout, as for the other benchmarks. Extra arguments are passed to
+# futility_bench (e.g. --reps 10).
+
+# Load common constants and variables.
+. "$(dirname "$0")/../common.sh"
+
+BENCH="${BUILD_RUN}/tests/futility/futility_bench"
+KEYDIR="${SCRIPT_DIR}/devkeys"
+DATADIR="${SCRIPT_DIR}/futility/data"
+
+# Work in scratch directory
+DIR="${TEST_DIR}/futility_bench_dir"
+[ -d "$DIR" ] || mkdir -p "$DIR"
+cd "$DIR"
+
+# Firmware is signed against the dev root key, so verify can use its GBB.
+cp "${DATADIR}/bios_peppy_mp.bin" bios.bin
+"${FUTILITY}" gbb -s --rootkey="${KEYDIR}/root_key.vbpubk" bios.bin >/dev/null
+
+echo "console=tty0 root=/dev/dm-0" > config.txt
+"${FUTILITY}" vbutil_kernel --pack kernel.bin \
+  --keyblock "${KEYDIR}/kernel.keyblock" \
+  --signprivate "${KEYDIR}/kernel_data_key.vbprivk" \
+  --version 1 --arch x86 \
+  --vmlinuz "${DATADIR}/vmlinuz-amd64.bin" \
+  --bootloader config.txt --config config.txt >/dev/null
+
+bios_bytes=$(stat -c %s bios.bin)
+kernel_bytes=$(stat -c %s kernel.bin)
+
+for len in "${key_lengths[@]}"; do
+  key="${TESTKEY_DIR}/key_rsa${len}.sha256"
+
+  "${FUTILITY}" vbutil_keyblock --pack "fw_${len}.keyblock" \
+    --datapubkey "${key}.vbpubk" \
+    --signprivate "${KEYDIR}/root_key.vbprivk" >/dev/null
+  "${FUTILITY}" vbutil_keyblock --pack "kernel_${len}.keyblock" \
+    --datapubkey "${key}.vbpubk" \
+    --signprivate "${KEYDIR}/kernel_subkey.vbprivk" >/dev/null
+
+  "${BENCH}" --bytes "${bios_bytes}" "$@" "sign_bios_rsa${len}" \
+    "${FUTILITY}" sign -s "${key}.vbprivk" -b "fw_${len}.keyblock" \
+    -k "${KEYDIR}/kernel_subkey.vbpubk" bios.bin "bios_${len}.bin"
+  "${BENCH}" --bytes "${bios_bytes}" "$@" "verify_bios_rsa${len}" \
+    "${FUTILITY}" verify "bios_${len}.bin"
+
+  "${BENCH}" --bytes "${kernel_bytes}" "$@" "sign_kernel_rsa${len}" \
+    "${FUTILITY}" sign -s "${key}.vbprivk" -b "kernel_${len}.keyblock" \
+    kernel.bin "kernel_${len}.bin"
+  "${BENCH}" --bytes "${kernel_bytes}" "$@" "verify_kernel_rsa${len}" \
+    "${FUTILITY}" verify --publickey "${KEYDIR}/kernel_subkey.vbpubk" \
+    "kernel_${len}.bin"
+done
+
+rm -f bios*.bin kernel*.bin
@@ -0,0 +1,158 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Run a command repeatedly and report its wall time, CPU time and peak RSS,
+ * for benchmarking futility end to end.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+
+enum {
+	OPT_BYTES = BENCH_OPT_USER,
+};
+
+static const struct option long_opts[] = {
+	BENCH_LONG_OPTS,
+	{"bytes", 1, NULL, OPT_BYTES},
+	{NULL, 0, NULL, 0}
+};
+
+static void print_usage(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s [options] NAME COMMAND [ARGS...]\n\n"
+		"Runs COMMAND, discarding its output, and reports the time\n"
+		"and memory each run takes under NAME.\n\n"
+		"Options:\n"
+		BENCH_USAGE
+		"  --bytes N           Bytes each run processes, to report\n"
+		"                        throughput\n",
+		progname);
+}
+
+static uint64_t timeval_ns(const struct timeval *tv)
+{
+	return (uint64_t)tv->tv_sec * 1000000000 + tv->tv_usec * 1000;
+}
+
+/*
+ * Run the command once, storing its wall and CPU time.  Returns its peak
+ * RSS in KiB, or 0 if it couldn't be run or failed.
+ */
+static uint64_t run_once(char *argv[], uint64_t *wall_ns, uint64_t *cpu_ns)
+{
+	struct rusage ru;
+	uint64_t start;
+	pid_t pid;
+	int status;
+
+	start = bench_now_ns();
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 0;
+	}
+	if (!pid) {
+		int fd = open("/dev/null", O_WRONLY);
+
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+
+	if (wait4(pid, &status, 0, &ru) != pid) {
+		perror("wait4");
+		return 0;
+	}
+	*wall_ns = bench_now_ns() - start;
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "%s failed with status %#x\n", argv[0], status);
+		return 0;
+	}
+
+	*cpu_ns = timeval_ns(&ru.ru_utime) + timeval_ns(&ru.ru_stime);
+	/* Linux reports this in KiB */
+	return ru.ru_maxrss;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_options opts;
+	struct bench_result result, cpu;
+	uint64_t *wall_ns, *cpu_ns;
+	uint64_t bytes = 0;
+	uint64_t rss, peak_rss = 0;
+	const char *name;
+	char *e;
+	int errorcnt = 0;
+	int i, c;
+
+	bench_init_options(&opts);
+	opts.warmup = 1;
+	opts.reps = 5;
+	/* Stop at the command, so its options are left for it */
+	while ((c = getopt_long(argc, argv, "+", long_opts, NULL)) != -1) {
+		switch (c) {
+		case OPT_BYTES:
+			bytes = strtoull(optarg, &e, 0);
+			if (*e || e == optarg) {
+				fprintf(stderr, "Bad size: %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		default:
+			if (bench_parse_option(&opts, c, optarg))
+				errorcnt++;
+			break;
+		}
+	}
+
+	if (errorcnt || argc - optind < 2) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	name = argv[optind];
+	argv += optind + 1;
+
+	wall_ns = calloc(opts.reps, sizeof(*wall_ns));
+	cpu_ns = calloc(opts.reps, sizeof(*cpu_ns));
+	if (!wall_ns || !cpu_ns) {
+		fprintf(stderr, "Unable to allocate samples\n");
+		return 1;
+	}
+
+	for (i = 0; i < opts.warmup + opts.reps; i++) {
+		/* Warmup runs land in sample 0, which is overwritten */
+		int sample = i < opts.warmup ? 0 : i - opts.warmup;
+
+		rss = run_once(argv, &wall_ns[sample], &cpu_ns[sample]);
+		if (!rss)
+			return 1;
+		if (rss > peak_rss)
+			peak_rss = rss;
+	}
+
+	bench_summarize(wall_ns, opts.reps, &result);
+	bench_summarize(cpu_ns, opts.reps, &cpu);
+	result.cpu_median_ns = cpu.median_ns;
+	result.peak_rss_kb = peak_rss;
+
+	bench_report_begin(&opts);
+	bench_report(&opts, name, bytes, &result);
+	bench_report_end(&opts);
+
+	free(wall_ns);
+	free(cpu_ns);
+	return 0;
+}
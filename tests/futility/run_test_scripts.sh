@@ -24,6 +24,7 @@ ${SCRIPT_DIR}/futility/test_dump_fmap.sh
 ${SCRIPT_DIR}/futility/test_gbb_utility.sh
 ${SCRIPT_DIR}/futility/test_load_fmap.sh
 ${SCRIPT_DIR}/futility/test_main.sh
+${SCRIPT_DIR}/futility/test_pcr.sh
 ${SCRIPT_DIR}/futility/test_rwsig.sh
 ${SCRIPT_DIR}/futility/test_show_contents.sh
 ${SCRIPT_DIR}/futility/test_show_kernel.sh
@@ -33,6 +34,7 @@ ${SCRIPT_DIR}/futility/test_sign_firmware.sh
 ${SCRIPT_DIR}/futility/test_sign_fw_main.sh
 ${SCRIPT_DIR}/futility/test_sign_kernel.sh
 ${SCRIPT_DIR}/futility/test_sign_keyblocks.sh
+${SCRIPT_DIR}/futility/test_sign_serve.sh
 ${SCRIPT_DIR}/futility/test_sign_usbpd1.sh
 ${SCRIPT_DIR}/futility/test_update.sh
 ${SCRIPT_DIR}/futility/test_file_types.sh
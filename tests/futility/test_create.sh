@@ -64,6 +64,42 @@ for sig in rsa1024 rsa2048 rsa4096 rsa8192; do
   done
 done
 
+# ECDSA keys are vb21 only. Check that the public and private halves agree
+# with the .pem they came from.
+${FUTILITY} --vb21 create --hash_alg sha256 \
+  "${TESTKEYS}/key_ecdsa_p256.pem" "${TMP}_key_ecdsa_p256"
+pem_sum=$(${FUTILITY} show "${TESTKEYS}/key_ecdsa_p256.pem" |
+  awk '/sha1sum/ {print $3}')
+key_sums=$(${FUTILITY} show ${TMP}_key_ecdsa_p256.* |
+  awk '/ID:/ {print $NF}' | uniq)
+[ "$pem_sum" = "$key_sums" ]
+${FUTILITY} show "${TMP}_key_ecdsa_p256.vbpubk2" | grep -q ECDSA-P256
+
+# A generated key comes with its .pem and every keypair format, and they all
+# agree with each other and with what create makes from that .pem.
+${FUTILITY} create --generate rsa2048_exp3 --hash_alg sha512 "${TMP}_gen"
+${FUTILITY} show "${TMP}_gen.vbpubk" | grep -q "RSA2048 EXP3 SHA512"
+${FUTILITY} --vb1 create --hash_alg sha512 "${TMP}_gen.pem" "${TMP}_gen_pem"
+cmp "${TMP}_gen.vbpubk" "${TMP}_gen_pem.vbpubk"
+cmp "${TMP}_gen.vbprivk" "${TMP}_gen_pem.vbprivk"
+${FUTILITY} --vb21 create --hash_alg sha512 "${TMP}_gen.pem" "${TMP}_gen_pem"
+cmp "${TMP}_gen.vbpubk2" "${TMP}_gen_pem.vbpubk2"
+cmp "${TMP}_gen.vbprik2" "${TMP}_gen_pem.vbprik2"
+tail -c $(stat -c %s "${TMP}_gen.keyb") "${TMP}_gen.vbpubk" |
+  cmp - "${TMP}_gen.keyb"
+
+${FUTILITY} create --generate ecp256 "${TMP}_genec"
+[ ! -e "${TMP}_genec.vbpubk" ]
+${FUTILITY} show "${TMP}_genec.vbpubk2" | grep -q ECDSA-P256
+tail -c 72 "${TMP}_genec.vbpubk2" | cmp - "${TMP}_genec.keyb"
+
+${FUTILITY} create --generate rsa100 "${TMP}_bad" && false
+# Sizes vboot can't verify are rejected before anything is written
+${FUTILITY} create --generate rsa3072 "${TMP}_bad" && false
+${FUTILITY} create --generate rsa2048_exp5 "${TMP}_bad" && false
+[ -z "$(ls ${TMP}_bad* 2>/dev/null)" ]
+${FUTILITY} create --generate rsa2048 && false
+
 # cleanup
 rm -rf ${TMP}*
 exit 0
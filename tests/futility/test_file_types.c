@@ -38,6 +38,7 @@ static struct {
 	{FILE_TYPE_PEM,             "tests/testkeys/key_rsa2048.pem"},
 	{FILE_TYPE_USBPD1,          "tests/futility/data/zinger_mp_image.bin"},
 	{FILE_TYPE_RWSIG,           },		/* need a test for this */
+	{FILE_TYPE_VBSD,            "tests/futility/data/vbsd_v3.bin"},
 };
 _Static_assert(ARRAY_SIZE(test_case) == NUM_FILE_TYPES,
 	       "Need a test case for each file type (total NUM_FILE_TYPES)");
@@ -204,6 +204,23 @@ ${FUTILITY} gbb -g --digest ${TMP}.blob.bad | grep 'invalid'
 cat ${TMP}.blob | ${REPLACE} 0x84 0x70 0x71 0x72 > ${TMP}.blob.bad
 ${FUTILITY} gbb -g --digest ${TMP}.blob.bad | grep 'invalid'
 
+# Setting real keys records their digests, which show checks.
+${FUTILITY} gbb -c 0x100,0x1000,0,0x1000 ${TMP}.blob.keys
+${FUTILITY} gbb -s -k ${SRCDIR}/tests/devkeys/root_key.vbpubk \
+  -r ${SRCDIR}/tests/devkeys/recovery_key.vbpubk ${TMP}.blob.keys
+root_sha1=$(${FUTILITY} show ${SRCDIR}/tests/devkeys/root_key.vbpubk | \
+  awk '/Key sha1sum/ {print $3}')
+${FUTILITY} show ${TMP}.blob.keys | \
+  grep "Recorded sha1sum: *${root_sha1}   valid"
+[ "$(${FUTILITY} show ${TMP}.blob.keys | grep -c 'Recorded.*valid')" = 2 ]
+
+# In-place edits of a full image only touch the GBB flags.
+cp ${SCRIPT_DIR}/futility/data/bios_link_mp.bin ${TMP}.image
+${FUTILITY} gbb -s --flags=0x39 ${TMP}.image
+${FUTILITY} gbb -g --flags ${TMP}.image | grep 'flags: 0x00000039'
+[ "$(cmp -l ${SCRIPT_DIR}/futility/data/bios_link_mp.bin ${TMP}.image | \
+  wc -l)" -le 4 ]
+
 # cleanup
 rm -f ${TMP}*
 exit 0
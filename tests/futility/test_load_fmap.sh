@@ -38,6 +38,21 @@ for a in ${AREAS}; do
   cmp $a $a.rand
 done
 
+# A bogus argument anywhere leaves the image untouched
+cp ${BIOS} ${TMP}.before
+if ${FUTILITY} load_fmap ${BIOS} VBLOCK_B:/dev/zero NO_SUCH_AREA:/dev/zero;
+then
+  false
+fi
+cmp ${BIOS} ${TMP}.before
+
+# Short files only replace the start of the area
+printf 'short' > short.bin
+${FUTILITY} load_fmap ${BIOS} VBLOCK_B:short.bin
+${FUTILITY} dump_fmap -x ${BIOS} VBLOCK_B
+head -c 5 VBLOCK_B | cmp - short.bin
+tail -c +6 VBLOCK_B | cmp - <(tail -c +6 VBLOCK_B.rand)
+
 # cleanup
-rm -f ${TMP}* ${AREAS} *.rand *.good
+rm -f ${TMP}* ${AREAS} *.rand *.good short.bin
 exit 0
@@ -0,0 +1,43 @@
+#!/bin/bash -eux
+# Copyright 2020 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+# Extend one PCR by hand
+"$FUTILITY" pcr b52791126f96a21a8ba4d511c6f25a1c1eb6dc9e > "$TMP"
+grep "PCR: ff49aa6c7242cafe1321458ae06767fd24619b8c" "$TMP"
+
+# Text event log, hashed for both banks
+cat > "$TMP.log" <<END
+# sample
+0 6669726d77617265
+
+1 63 6f 6e 66 69 67
+0
+END
+"$FUTILITY" pcr --log < "$TMP.log" > "$TMP"
+grep "Events: 3" "$TMP"
+grep "PCR  0 SHA1   c65bfc66deca712f9d01319c28e7b30185bac50d" "$TMP"
+grep "PCR  0 SHA256 c7c994385d367c2e43dc6ef4cdb13aefc73929658ba1859de9cc92153d04249c" "$TMP"
+grep "PCR  1 SHA256 82849956c36ce316c8fc2b43b48588f462683082c0edb1fcc4d0d6a9143eabe3" "$TMP"
+
+# Crypto-agile binary log, starting in locality 3
+"$FUTILITY" pcr --log < "${SCRIPT_DIR}/futility/data/event_log.bin" > "$TMP"
+cmp "${SCRIPT_DIR}/futility/data_pcr_log_expect.txt" "$TMP"
+
+# Bad logs are rejected
+echo "24 00" | "$FUTILITY" pcr --log && false
+echo "0 xyz" | "$FUTILITY" pcr --log && false
+head -c 100 "${SCRIPT_DIR}/futility/data/event_log.bin" | \
+  "$FUTILITY" pcr --log && false
+"$FUTILITY" pcr --log 00 && false
+
+# cleanup
+rm -f ${TMP}*
+exit 0
@@ -59,6 +59,19 @@ for s in $SIGS; do
     done
 done
 
+# Signing with a digest cache gives the same signature, cold or warm
+cache=${TMP}.digest_cache
+mkdir -p ${cache}
+cp ${infile} ${TMP}.uncached.bin
+${FUTILITY} sign --type rwsig --prikey ${outkeys}.vbprik2 ${TMP}.uncached.bin
+for pass in cold warm; do
+    cp ${infile} ${TMP}.${pass}.bin
+    ${FUTILITY} sign --type rwsig --prikey ${outkeys}.vbprik2 \
+            --digest_cache ${cache} ${TMP}.${pass}.bin
+    cmp ${TMP}.uncached.bin ${TMP}.${pass}.bin
+done
+[[ $(ls ${cache} | wc -l) -eq 1 ]]
+
 # cleanup
 rm -rf ${TMP}*
 exit 0
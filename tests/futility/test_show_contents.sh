@@ -23,6 +23,7 @@ SHOW_FILES="
   tests/futility/data/sample.vbprik2
   tests/testkeys/key_rsa2048.pem
   tests/testkeys/key_rsa8192.pub.pem
+  tests/futility/data/vbsd_v3.bin
 "
 
 for file in $SHOW_FILES; do
@@ -71,6 +71,60 @@ ${FUTILITY} verify ${SCRIPT_DIR}/futility/data/rec_kernel_part.bin \
   --publickey ${DEVKEYS}/recovery_key.vbpubk
 
 
+#### header-only checks and JSON output
+
+# A bad body fails full verification, but not a check of just the headers
+cp ${TMP}.fw_main_a ${TMP}.fw_main_a.bad
+printf '\xff' | dd of=${TMP}.fw_main_a.bad bs=1 seek=16 conv=notrunc
+if ${FUTILITY} verify ${TMP}.vblock_a \
+  --publickey ${TMP}.rootkey \
+  --fv ${TMP}.fw_main_a.bad ; then false ; fi
+${FUTILITY} verify --verify=headers ${TMP}.vblock_a \
+  --publickey ${TMP}.rootkey \
+  --fv ${TMP}.fw_main_a.bad
+
+${FUTILITY} show --format=json ${TMP}.vblock_a \
+  --publickey ${TMP}.rootkey \
+  --fv ${TMP}.fw_main_a > ${TMP}.json
+grep -q '"signature": "valid"' ${TMP}.json
+grep -q '"firmware_version": ' ${TMP}.json
+grep -q '"body": "verified"' ${TMP}.json
+
+${FUTILITY} verify --format=json --verify=headers \
+  ${SCRIPT_DIR}/futility/data/rec_kernel_part.bin \
+  --publickey ${DEVKEYS}/recovery_key.vbpubk > ${TMP}.json
+grep -q '"kernel_version": ' ${TMP}.json
+grep -q '"body": "skipped"' ${TMP}.json
+
+# JSON is only for vblocks and kernel partitions
+if ${FUTILITY} show --format=json ${DEVKEYS}/firmware.keyblock ; \
+  then false ; fi
+if ${FUTILITY} show --verify=some ${TMP}.vblock_a ; then false ; fi
+
+
+#### several files at once
+
+files="${DEVKEYS}/firmware.keyblock ${TMP}.vblock_a \
+  ${SCRIPT_DIR}/futility/data/rec_kernel_part.bin"
+
+${FUTILITY} show ${files} > ${TMP}.serial
+${FUTILITY} show --jobs 2 ${files} > ${TMP}.parallel
+cmp ${TMP}.serial ${TMP}.parallel
+
+${FUTILITY} show -t ${files} > ${TMP}.serial
+${FUTILITY} show -t -j 2 ${files} > ${TMP}.parallel
+cmp ${TMP}.serial ${TMP}.parallel
+
+# One bad file fails the whole run
+if ${FUTILITY} verify -j 3 ${files} \
+  --publickey ${DEVKEYS}/recovery_key.vbpubk ; then false ; fi
+${FUTILITY} verify -j 3 ${SCRIPT_DIR}/futility/data/rec_kernel_part.bin \
+  ${SCRIPT_DIR}/futility/data/rec_kernel_part.bin \
+  --publickey ${DEVKEYS}/recovery_key.vbpubk
+
+if ${FUTILITY} show --jobs 0 ${files} ; then false ; fi
+
+
 # cleanup
 rm -rf ${TMP}*
 exit 0
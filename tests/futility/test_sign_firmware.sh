@@ -182,6 +182,37 @@ m=$(${FUTILITY} verify --publickey ${KEYDIR}/root_key.vbpubk ${MORE_OUT}.3 \
 [ "$m" = "4" ]
 
 
+# The GBB keys can be replaced in the same run, so the result verifies with
+# just the GBB's own root key.
+: $(( count++ ))
+echo -n "$count " 1>&3
+
+${FUTILITY} sign \
+  -s ${KEYDIR}/firmware_data_key.vbprivk \
+  -b ${KEYDIR}/firmware.keyblock \
+  ${DEV_FIRMWARE_PARAMS} \
+  -k ${KEYDIR}/kernel_subkey.vbpubk \
+  --rootkey ${KEYDIR}/root_key.vbpubk \
+  --recoverykey ${KEYDIR}/recovery_key.vbpubk \
+  ${MORE_OUT} ${MORE_OUT}.4
+
+${FUTILITY} gbb -g --rootkey=${TMP}.rootkey \
+  --recoverykey=${TMP}.recoverykey ${MORE_OUT}.4
+cmp -n $(stat -c %s ${KEYDIR}/root_key.vbpubk) \
+  ${TMP}.rootkey ${KEYDIR}/root_key.vbpubk
+cmp -n $(stat -c %s ${KEYDIR}/recovery_key.vbpubk) \
+  ${TMP}.recoverykey ${KEYDIR}/recovery_key.vbpubk
+${FUTILITY} verify --strict ${MORE_OUT}.4
+
+# and their digests are recorded to match
+for key in root_key recovery_key; do
+  sha1=$(${FUTILITY} show ${KEYDIR}/${key}.vbpubk | \
+    awk '/Key sha1sum/ {print $3}')
+  ${FUTILITY} show ${MORE_OUT}.4 | \
+    grep "Recorded sha1sum: *${sha1}   valid"
+done
+
+
 # cleanup
 rm -rf ${TMP}* ${ONEMORE}
 exit 0
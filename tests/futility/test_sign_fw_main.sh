@@ -41,6 +41,49 @@ ${FUTILITY} --debug sign \
 # They should match
 cmp ${TMP}.vblock.old ${TMP}.vblock.new
 
+# and in a batch, along with a second blob
+dd bs=1024 count=16 if=/dev/urandom of=${TMP}.fw_main2
+cat > ${TMP}.manifest <<EOF
+# comments and blank lines are skipped
+
+${TMP}.fw_main ${TMP}.vblock.batch
+${TMP}.fw_main2 ${TMP}.vblock.batch2
+EOF
+${FUTILITY} sign \
+  --signprivate ${KEYDIR}/firmware_data_key.vbprivk \
+  --keyblock ${KEYDIR}/firmware.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --version 12 \
+  --flags 42 \
+  --jobs 2 \
+  --batch ${TMP}.manifest
+cmp ${TMP}.vblock.old ${TMP}.vblock.batch
+${FUTILITY} vbutil_firmware --verify ${TMP}.vblock.batch2 \
+  --signpubkey ${KEYDIR}/root_key.vbpubk \
+  --fv ${TMP}.fw_main2
+
+# a failing line fails the batch
+echo "${TMP}.missing ${TMP}.vblock.missing" >> ${TMP}.manifest
+if ${FUTILITY} sign \
+  --signprivate ${KEYDIR}/firmware_data_key.vbprivk \
+  --keyblock ${KEYDIR}/firmware.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --version 12 \
+  --batch ${TMP}.manifest; then false; fi
+
+# so does a line with an extra word
+cat > ${TMP}.manifest <<EOF
+${TMP}.fw_main ${TMP}.vblock.extra ${TMP}.extra ${TMP}.extra2
+EOF
+if ${FUTILITY} sign \
+  --signprivate ${KEYDIR}/firmware_data_key.vbprivk \
+  --keyblock ${KEYDIR}/firmware.keyblock \
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk \
+  --version 12 \
+  --batch ${TMP}.manifest 2>${TMP}.extra.err; then false; fi
+grep -q "expected INFILE \[OUTFILE\]" ${TMP}.extra.err
+[ ! -e ${TMP}.vblock.extra ]
+
 # cleanup
 rm -rf ${TMP}*
 exit 0
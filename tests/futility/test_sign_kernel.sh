@@ -43,6 +43,18 @@ try_arch () {
     --pad ${padding} \
     --signpubkey ${DEVKEYS}/recovery_key.vbpubk > ${TMP}.verify1
 
+  # extracting while verifying should give the same vmlinuz
+  ${FUTILITY} vbutil_kernel --get-vmlinuz ${TMP}.blob1.${arch} \
+    --pad ${padding} \
+    --vmlinuz-out ${TMP}.vmlinuz1.${arch}
+  ${FUTILITY} vbutil_kernel --get-vmlinuz ${TMP}.blob1.${arch} \
+    --signpubkey ${DEVKEYS}/recovery_key.vbpubk \
+    --vmlinuz-out ${TMP}.vmlinuz2.${arch}
+  cmp ${TMP}.vmlinuz1.${arch} ${TMP}.vmlinuz2.${arch}
+  if ${FUTILITY} vbutil_kernel --get-vmlinuz ${TMP}.blob1.${arch} \
+    --signpubkey ${DEVKEYS}/kernel_subkey.vbpubk \
+    --vmlinuz-out ${TMP}.vmlinuz3.${arch}; then false; fi
+
   # pack it up the new way
   ${FUTILITY} --debug sign \
     --keyblock ${DEVKEYS}/recovery_kernel.keyblock \
@@ -294,6 +306,42 @@ try_arch () {
   # And creating a new output file should only emit a blob's worth
   cmp ${TMP}.part6.${arch} ${TMP}.part6.${arch}.new2
 
+  # resign with just a new version, which keeps the body signature
+  ${FUTILITY} vbutil_kernel \
+    --repack ${TMP}.part7.${arch} \
+    --oldblob ${TMP}.part6.${arch}.new2 \
+    --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+    --version 3 \
+    --pad ${padding}
+  cp ${TMP}.part6.${arch}.new2 ${TMP}.part7.${arch}.new1
+  ${FUTILITY} --debug sign \
+    --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+    --version 3 \
+    --pad ${padding} \
+    ${TMP}.part7.${arch}.new1 2>&1 | grep "Keeping the existing body signature"
+  cmp ${TMP}.part7.${arch} ${TMP}.part7.${arch}.new1
+  cp ${TMP}.part6.${arch}.new2 ${TMP}.part7.${arch}.new2
+  ${FUTILITY} sign \
+    --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+    --version 3 \
+    --pad ${padding} \
+    --trust_body \
+    ${TMP}.part7.${arch}.new2
+  cmp ${TMP}.part7.${arch} ${TMP}.part7.${arch}.new2
+
+  # but a body that doesn't match its signature is signed again
+  cp ${TMP}.part6.${arch}.new2 ${TMP}.part7.${arch}.new3
+  printf '\xff' | dd of=${TMP}.part7.${arch}.new3 bs=1 seek=$((padding + 16)) \
+    conv=notrunc
+  ${FUTILITY} sign \
+    --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+    --version 3 \
+    --pad ${padding} \
+    ${TMP}.part7.${arch}.new3
+  ${FUTILITY} vbutil_kernel --verify ${TMP}.part7.${arch}.new3 \
+    --pad ${padding} \
+    --signpubkey ${DEVKEYS}/kernel_subkey.vbpubk > /dev/null
+
   # Note: We specifically do not test repacking with a different --kloadaddr,
   # because the old way has a bug and does not update params->cmd_line_ptr to
   # point at the new on-disk location. Apparently (and not surprisingly), no
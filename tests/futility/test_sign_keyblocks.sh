@@ -104,6 +104,26 @@ ${FUTILITY} --debug sign \
 
 cmp ${TMP}.keyblock4 ${TMP}.keyblock5
 
+# with the signer kept running
+${FUTILITY} --debug sign \
+  --pem_signpriv ${TESTKEYS}/key_rsa4096.pem \
+  --pem_algo 8 \
+  --pem_external ${SIGNER} \
+  --pem_persistent \
+  --flags 19 \
+  ${DEVKEYS}/firmware_data_key.vbpubk \
+  ${TMP}.keyblock6
+
+cmp ${TMP}.keyblock4 ${TMP}.keyblock6
+
+# and one that can't sign fails
+if ${FUTILITY} sign \
+  --pem_signpriv ${TESTKEYS}/key_rsa4096.pem \
+  --pem_algo 8 \
+  --pem_external /bin/false \
+  --pem_persistent \
+  ${DEVKEYS}/firmware_data_key.vbpubk \
+  ${TMP}.keyblock7; then false; fi
 
 # cleanup
 rm -rf ${TMP}*
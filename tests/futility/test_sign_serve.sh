@@ -0,0 +1,105 @@
+#!/bin/bash -eux
+# Copyright 2020 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+KEYDIR=${SRCDIR}/tests/devkeys
+SOCK=${TMP}.sock
+
+SIGN_ARGS=(
+  --signprivate ${KEYDIR}/firmware_data_key.vbprivk
+  --keyblock ${KEYDIR}/firmware.keyblock
+  --kernelkey ${KEYDIR}/kernel_subkey.vbpubk
+  --version 12
+  --flags 42
+)
+
+# Send one request line (or nothing, with no args) and print the reply
+request() {
+  python3 - "${SOCK}" "$@" <<'EOF'
+import socket, sys
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+s.connect(sys.argv[1])
+if len(sys.argv) > 2:
+    s.sendall(sys.argv[2].encode() + b"\n")
+print(s.makefile().readline().strip())
+EOF
+}
+
+start_server() {
+  ${FUTILITY} sign "${SIGN_ARGS[@]}" --jobs 2 --serve ${SOCK} &
+  server=$!
+  # An empty request fails, but shows the server is answering
+  for i in $(seq 50); do
+    [ "$(request "" 2>/dev/null)" = "FAIL" ] && return 0
+    sleep 0.1
+  done
+  return 1
+}
+
+# Sign a blob directly, to compare with what the server signs
+dd bs=1024 count=16 if=/dev/urandom of=${TMP}.fw_main
+${FUTILITY} sign "${SIGN_ARGS[@]}" --fv ${TMP}.fw_main ${TMP}.vblock.direct
+
+start_server
+
+# Sign the same blob through the socket
+[ "$(request "${TMP}.fw_main ${TMP}.vblock.serve")" = "OK" ]
+cmp ${TMP}.vblock.direct ${TMP}.vblock.serve
+
+# Missing files and malformed lines fail, and the server keeps going
+[ "$(request "${TMP}.missing ${TMP}.vblock.missing")" = "FAIL" ]
+[ "$(request "${TMP}.fw_main ${TMP}.vblock.extra ${TMP}.extra")" = "FAIL" ]
+[ ! -e ${TMP}.vblock.extra ]
+[ "$(request "")" = "FAIL" ]
+
+# A client which hangs up before the reply doesn't kill the server
+python3 - "${SOCK}" <<'EOF'
+import socket, sys
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+s.connect(sys.argv[1])
+s.sendall(b"\n")
+s.close()
+EOF
+sleep 0.5
+kill -0 ${server}
+
+# A client which never sends its request doesn't block the others for good
+python3 - "${SOCK}" <<'EOF' &
+import socket, sys, time
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+s.connect(sys.argv[1])
+time.sleep(15)
+EOF
+idle=$!
+sleep 0.5
+[ "$(request "${TMP}.fw_main ${TMP}.vblock.serve2")" = "OK" ]
+cmp ${TMP}.vblock.direct ${TMP}.vblock.serve2
+kill ${idle} || true
+wait ${idle} || true
+
+# quit stops the server and removes the socket
+[ "$(request quit)" = "OK" ]
+wait ${server}
+[ ! -e ${SOCK} ]
+
+# A socket left behind by a killed server doesn't stop a new one
+start_server
+kill -9 ${server}
+wait ${server} || true
+[ -S ${SOCK} ]
+start_server
+[ "$(request "${TMP}.fw_main ${TMP}.vblock.serve3")" = "OK" ]
+cmp ${TMP}.vblock.direct ${TMP}.vblock.serve3
+[ "$(request quit)" = "OK" ]
+wait ${server}
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
@@ -177,6 +177,13 @@ test_update "Full update" \
 	"${FROM_IMAGE}" "${TMP}.expected.full" \
 	-i "${TO_IMAGE}" --wp=0 --sys_props 0,0x10001,1
 
+# Only erase blocks that changed should be written.
+cp -f "${TMP}.expected.full" "${TMP}.emu"
+msg="$("${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 2>&1)"
+grep -qF "Writing 0 bytes in 0 range(s) that changed." <<<"${msg}"
+cmp "${TMP}.emu" "${TMP}.expected.full"
+
 test_update "Full update (incompatible platform)" \
 	"${FROM_IMAGE}" "!platform is not compatible" \
 	-i "${LINK_BIOS}" --wp=0 --sys_props 0,0x10001,1
@@ -249,6 +256,22 @@ test_update "RW update (A->B)" \
 	"${FROM_IMAGE}" "${TMP}.expected.b" \
 	-i "${TO_IMAGE}" -t --wp=1 --sys_props 0,0x10001,1
 
+# Tag RW_LEGACY for auto update, in place of the empty CBFS entry.
+CBFS_TAG="LARCHIVE\x00\x00\x00\x00\x00\x00\x00\x50\x00\x00\x00\x00"
+CBFS_TAG="${CBFS_TAG}\x00\x00\x00\x40cros_allow_auto_update\x00"
+cp -f "${FROM_IMAGE}" "${FROM_IMAGE}.legacy_tag"
+cp -f "${TO_IMAGE}" "${TO_IMAGE}.legacy_tag"
+patch_file "${FROM_IMAGE}.legacy_tag" RW_LEGACY 0x1b040 "${CBFS_TAG}"
+patch_file "${TO_IMAGE}.legacy_tag" RW_LEGACY 0x1ae80 "${CBFS_TAG}"
+cp -f "${TMP}.expected.b" "${TMP}.expected.b.legacy"
+"${FUTILITY}" dump_fmap -x "${TO_IMAGE}.legacy_tag" \
+	RW_LEGACY:"${TMP}.to.legacy_tag"
+"${FUTILITY}" load_fmap "${TMP}.expected.b.legacy" \
+	RW_LEGACY:"${TMP}.to.legacy_tag"
+test_update "RW update (A->B, tagged legacy)" \
+	"${FROM_IMAGE}.legacy_tag" "${TMP}.expected.b.legacy" \
+	-i "${TO_IMAGE}.legacy_tag" -t --wp=1 --sys_props 0,0x10001,1
+
 test_update "RW update (B->A)" \
 	"${FROM_IMAGE}" "${TMP}.expected.a" \
 	-i "${TO_IMAGE}" -t --wp=1 --sys_props 1,0x10001,1
@@ -423,6 +446,16 @@ test_update "Full update (--archive, model=peppy)" \
 test_update "Full update (--archive, model=unknown)" \
 	"${FROM_IMAGE}.ap" "!Unsupported model: 'unknown'" \
 	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=unknown
+# A broken model doesn't stop updating the others.
+mkdir -p "${A}/models/broken"
+echo "junk" >"${A}/models/broken/setvars.sh"
+test_update "Full update (--archive, model=peppy, broken model)" \
+	"${FROM_IMAGE}.ap" "${PEPPY_BIOS}" \
+	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=peppy
+test_update "Full update (--archive, model=broken)" \
+	"${FROM_IMAGE}.ap" "!Invalid config for model: 'broken'" \
+	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=broken
+rm -rf "${A}/models/broken"
 test_update "Full update (--archive, model=whitetip, signature_id=WL)" \
 	"${FROM_IMAGE}.al" "${LINK_BIOS}" \
 	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=whitetip \
@@ -64,6 +64,55 @@ function generate_fuzzing_images {
     ${TESTCASE_DIR}/firmware_key.vbpubk
 }
 
+# Pad a key to the fixed size the fuzzers expect in front of their input
+function padded_key {
+  head -c 4096 <(cat "$1" /dev/zero)
+}
+
+# Seed corpora for the fuzzers, each in the input format its fuzzer expects.
+function generate_fuzzing_corpora {
+  local corpus=${TESTCASE_DIR}/corpus
+  local bios=${SCRIPT_DIR}/futility/data/bios_peppy_mp.bin
+  local keyblock_size
+  local disk
+
+  echo "Generating fuzzer seed corpora..."
+  rm -rf ${corpus}
+  mkdir -p ${corpus}/cbfs_fuzzer ${corpus}/cgpt_fuzzer ${corpus}/fmap_fuzzer \
+    ${corpus}/vb2_kernel_fuzzer ${corpus}/vb2_keyblock_fuzzer \
+    ${corpus}/vb2_preamble_fuzzer
+
+  # Rootkey, then the firmware vblock
+  cat <(padded_key ${TESTKEY_DIR}/key_rsa8192.sha1.vbpubk) \
+    ${TESTCASE_DIR}/firmware.vblock > ${corpus}/vb2_keyblock_fuzzer/vblock
+
+  # Firmware data key, then the preamble which follows the keyblock
+  keyblock_size=$(stat -c %s ${TESTCASE_DIR}/firmware.keyblock)
+  cat <(padded_key ${TESTKEY_DIR}/key_rsa4096.sha256.vbpubk) \
+    <(tail -c +$((keyblock_size + 1)) ${TESTCASE_DIR}/firmware.vblock) \
+    > ${corpus}/vb2_preamble_fuzzer/preamble
+
+  # Kernel subkey, then the kernel partition
+  cat <(padded_key ${TESTKEY_DIR}/key_rsa4096.sha1.vbpubk) \
+    ${TESTCASE_DIR}/kernel.vblock.image > ${corpus}/vb2_kernel_fuzzer/kernel
+
+  # Disk parameters (512-byte sectors, no flags, 256 sectors), then the disk
+  disk=${TESTCASE_DIR}/cgpt_disk
+  dd if=/dev/zero of=${disk} bs=512 count=256 status=none
+  ${BIN_DIR}/cgpt create ${disk}
+  ${BIN_DIR}/cgpt add -b 64 -s 64 -t kernel -P 1 -S 1 -l KERN-A ${disk}
+  ${BIN_DIR}/cgpt add -b 128 -s 64 -t rootfs -l ROOT-A ${disk}
+  cat <(printf '\x09\0\0\0\0\0\0\0\0\1\0\0\0\0\0\0\0\1\0\0\0\0\0\0') \
+    ${disk} > ${corpus}/cgpt_fuzzer/disk
+  rm -f ${disk}
+
+  # An FMAP on its own, and the start of a CBFS
+  (cd ${corpus}/fmap_fuzzer && ${FUTILITY} dump_fmap -x ${bios} FMAP >/dev/null)
+  ${FUTILITY} dump_fmap -x ${bios} BOOT_STUB:${TESTCASE_DIR}/coreboot >/dev/null
+  head -c 65536 ${TESTCASE_DIR}/coreboot > ${corpus}/cbfs_fuzzer/coreboot
+  rm -f ${TESTCASE_DIR}/coreboot
+}
+
 function pre_work {
   # Generate a file to serve as random bytes for firmware/kernel contents.
   # NOTE: The kernel and config file can't really be random, but the bootloader
@@ -83,4 +132,5 @@ mkdir -p ${TESTCASE_DIR}
 pre_work
 check_test_keys
 generate_fuzzing_images ${TEST_IMAGE_FILE}
+generate_fuzzing_corpora
 
@@ -15,32 +15,40 @@ sha_types=( 1 256 512 )
 
 # Generate RSA test keys of various lengths.
 function generate_keys {
-  key_index=0
   key_name_base="${TESTKEY_DIR}/key_rsa"
+  pids=()
+  new_keys=()
+
+  # Generating the keys is the slow part, so do them all at once.
   for i in ${key_lengths[@]}
   do
     key_base="${key_name_base}${i}"
     if [ -f "${key_base}.keyb" ]; then
-      key_index=$((${key_index} + 1))
       continue
     fi
 
-    # Extract exponent from key_length name, if necessary
-    exp="F4"
-    bits=$i
-    if [ "${i##*_exp}" != "${i}" ]; then
-        exp="${i##*_exp}"
-        bits="${i%%_exp${exp}}"
-    fi
+    # This also writes the pre-processed key (.keyb) for use by RSA
+    # signature verification code.
+    ${FUTILITY} create --generate "rsa${i}" "${key_base}" > /dev/null &
+    pids+=($!)
+    new_keys+=(${i})
+  done
+  for pid in ${pids[@]}
+  do
+    wait ${pid}
+  done
 
-    openssl genrsa -${exp} -out ${key_base}.pem ${bits}
-    # Generate self-signed certificate from key.
-    openssl req -batch -new -x509 -key ${key_base}.pem \
-      -out ${key_base}.crt
+  for i in ${new_keys[@]}
+  do
+    key_base="${key_name_base}${i}"
+    rm -f "${key_base}".vbpubk* "${key_base}".vbpri*
 
-    # Generate pre-processed key for use by RSA signature verification code.
-    ${BIN_DIR}/dumpRSAPublicKey -cert ${key_base}.crt \
-      > ${key_base}.keyb
+    # The vb1 algorithm number depends on where the key is in the list.
+    key_index=0
+    while [ "${key_lengths[${key_index}]}" != "${i}" ]
+    do
+      key_index=$((${key_index} + 1))
+    done
 
     alg_index=0
     for sha_type in ${sha_types[@]}
@@ -60,9 +68,20 @@ function generate_keys {
         --algorithm ${alg}
       alg_index=$((${alg_index} + 1))
     done
-    key_index=$((${key_index} + 1))
   done
 }
 
+# Generate an ECDSA P-256 test key, for vboot 2.1 only.
+function generate_ec_key {
+  key_base="${TESTKEY_DIR}/key_ecdsa_p256"
+  if [ -f "${key_base}.keyb" ]; then
+    return
+  fi
+
+  ${FUTILITY} create --generate ecp256 "${key_base}" > /dev/null
+  rm -f "${key_base}.vbprik2" "${key_base}.vbpubk2"
+}
+
 mkdir -p ${TESTKEY_DIR}
 generate_keys
+generate_ec_key
@@ -89,10 +89,61 @@ static void test_hmac(void)
 	}
 }
 
+static void test_hmac_context(void)
+{
+	struct vb2_hmac_context ctx;
+	uint8_t mac[VB2_MAX_DIGEST_SIZE];
+	uint8_t expect[VB2_MAX_DIGEST_SIZE];
+	uint32_t msg_size = strlen(message);
+	int alg, i;
+
+	for (alg = 1; alg < VB2_HASH_ALG_COUNT; alg++) {
+		uint32_t digest_size = vb2_digest_size(alg);
+
+		TEST_SUCC(vb2_hmac_init_key(&ctx, alg, long_key,
+					    strlen(long_key)),
+			  "vb2_hmac_init_key()");
+
+		/* Same key, several messages, split across updates */
+		for (i = 0; i < 3; i++) {
+			TEST_SUCC(vb2_hmac_update(&ctx, message, i),
+				  "  update head");
+			TEST_SUCC(vb2_hmac_update(&ctx, message + i,
+						  msg_size - i),
+				  "  update tail");
+			TEST_SUCC(vb2_hmac_final(&ctx, mac, sizeof(mac)),
+				  "  final");
+			hmac(alg, long_key, strlen(long_key), message,
+			     msg_size, expect, sizeof(expect));
+			TEST_SUCC(memcmp(mac, expect, digest_size),
+				  "  matches hmac()");
+		}
+
+		/* Context resets after final, even for an empty message */
+		TEST_SUCC(vb2_hmac_final(&ctx, mac, sizeof(mac)),
+			  "  final empty");
+		hmac(alg, long_key, strlen(long_key), "", 0, expect,
+		     sizeof(expect));
+		TEST_SUCC(memcmp(mac, expect, digest_size),
+			  "  empty matches hmac()");
+	}
+
+	TEST_TRUE(vb2_hmac_init_key(&ctx, -1, short_key, strlen(short_key)),
+		  "init invalid algorithm");
+	TEST_TRUE(vb2_hmac_init_key(&ctx, VB2_HASH_SHA256, NULL, 0),
+		  "init key = NULL");
+	vb2_hmac_init_key(&ctx, VB2_HASH_SHA256, short_key, strlen(short_key));
+	TEST_TRUE(vb2_hmac_update(&ctx, NULL, 0), "update msg = NULL");
+	TEST_TRUE(vb2_hmac_final(&ctx, mac, VB2_SHA256_DIGEST_SIZE - 1),
+		  "final buffer too small");
+	TEST_TRUE(vb2_hmac_final(&ctx, NULL, sizeof(mac)), "final mac = NULL");
+}
+
 int main(void)
 {
 	test_hmac();
 	test_hmac_error();
+	test_hmac_context();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -0,0 +1,177 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Timing for RSA signature verification and its helpers, for every test key
+ * and hash algorithm.  Human-readable results go to stderr, key:value lines
+ * to stdout.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "2common.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "2sysincludes.h"
+#include "host_common.h"
+#include "host_key21.h"
+#include "timer_utils.h"
+#include "vb2_common.h"
+#include "vboot_test.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER
+static uint64_t read_cycles(void)
+{
+	return __rdtsc();
+}
+#endif
+
+#define DEFAULT_ITERATIONS 200
+
+static const uint8_t test_data[] = "This is some test data to sign.";
+
+static uint8_t workbuf[VB2_VERIFY_RSA_DIGEST_WORKBUF_BYTES]
+	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+
+/* Algorithm name with the space replaced, for use in a key:value key */
+static void result_key(enum vb2_crypto_algorithm alg, char *buf, int size)
+{
+	char *c;
+
+	snprintf(buf, size, "%s", vb2_get_crypto_algorithm_name(alg));
+	for (c = buf; *c; c++)
+		if (*c == ' ')
+			*c = '_';
+}
+
+static int benchmark_algorithm(enum vb2_crypto_algorithm alg,
+			       const char *keys_dir, int iterations)
+{
+	char filename[1024];
+	char name[64];
+	struct vb2_private_key *private_key = NULL;
+	struct vb2_packed_key *packed_key = NULL;
+	struct vb2_signature *sig = NULL;
+	struct vb2_public_key key;
+	struct vb2_workbuf wb;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint8_t *sig_copy = NULL;
+	ClockTimerState ct;
+	uint64_t nsecs, cycles = 0;
+	int ge_count = 0;
+	int retval = 1;
+	int i;
+
+	result_key(alg, name, sizeof(name));
+
+	snprintf(filename, sizeof(filename), "%s/key_%s.pem",
+		 keys_dir, vb2_get_crypto_algorithm_file(alg));
+	private_key = vb2_read_private_key_pem(filename, alg);
+	if (!private_key) {
+		fprintf(stderr, "Error reading private key: %s\n", filename);
+		goto done;
+	}
+
+	snprintf(filename, sizeof(filename), "%s/key_%s.keyb",
+		 keys_dir, vb2_get_crypto_algorithm_file(alg));
+	packed_key = vb2_read_packed_keyb(filename, alg, 1);
+	if (!packed_key || vb2_unpack_key(&key, packed_key)) {
+		fprintf(stderr, "Error reading public key: %s\n", filename);
+		goto done;
+	}
+
+	sig = vb2_calculate_signature(test_data, sizeof(test_data),
+				      private_key);
+	if (sig)
+		sig_copy = malloc(sig->sig_size);
+	if (!sig_copy ||
+	    vb2_digest_buffer(test_data, sizeof(test_data), key.hash_alg,
+			      digest, sizeof(digest))) {
+		fprintf(stderr, "Error signing test data for %s\n", name);
+		goto done;
+	}
+
+	/* Whole signature verification, including the copy it destroys */
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	StartTimer(&ct);
+#ifdef HAVE_CYCLE_COUNTER
+	cycles = read_cycles();
+#endif
+	for (i = 0; i < iterations; i++) {
+		memcpy(sig_copy, vb2_signature_data(sig), sig->sig_size);
+		if (vb2_rsa_verify_digest(&key, sig_copy, digest, &wb)) {
+			fprintf(stderr, "Verify failed for %s\n", name);
+			goto done;
+		}
+	}
+#ifdef HAVE_CYCLE_COUNTER
+	cycles = read_cycles() - cycles;
+#endif
+	StopTimer(&ct);
+	nsecs = GetDurationNsecs(&ct);
+
+	fprintf(stderr, "# %s verify: %.1f us, %.1f verifies/sec\n", name,
+		nsecs / 1e3 / iterations, iterations * 1e9 / nsecs);
+	fprintf(stdout, "verifies_per_sec_%s:%f\n", name,
+		iterations * 1e9 / nsecs);
+#ifdef HAVE_CYCLE_COUNTER
+	fprintf(stdout, "cycles_per_verify_%s:%" PRIu64 "\n", name,
+		cycles / iterations);
+#endif
+
+	/* sig_copy now holds the padded digest, which is what this checks */
+	StartTimer(&ct);
+	for (i = 0; i < iterations; i++) {
+		if (vb2_check_padding(sig_copy, &key)) {
+			fprintf(stderr, "Padding check failed for %s\n", name);
+			goto done;
+		}
+	}
+	StopTimer(&ct);
+	fprintf(stdout, "ns_per_check_padding_%s:%f\n", name,
+		(double)GetDurationNsecs(&ct) / iterations);
+
+	/* Comparing n against itself walks the whole array */
+	StartTimer(&ct);
+	for (i = 0; i < iterations; i++)
+		ge_count += vb2_mont_ge(&key, (uint32_t *)key.n);
+	StopTimer(&ct);
+	if (ge_count != iterations)
+		goto done;
+	fprintf(stdout, "ns_per_mont_ge_%s:%f\n", name,
+		(double)GetDurationNsecs(&ct) / iterations);
+
+	retval = 0;
+
+done:
+	free(sig_copy);
+	free(sig);
+	free(packed_key);
+	free(private_key);
+	return retval;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = DEFAULT_ITERATIONS;
+	int retval = 0;
+	int alg;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <keys_dir> [iterations]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 2)
+		iterations = atoi(argv[2]);
+	if (iterations <= 0)
+		iterations = DEFAULT_ITERATIONS;
+
+	for (alg = 0; alg < VB2_ALG_COUNT; alg++)
+		retval |= benchmark_algorithm(alg, argv[1], iterations);
+
+	return retval;
+}
@@ -181,6 +181,30 @@ X=$($CGPT boot $MTD ${DEV})
 Y=$($CGPT show $MTD -u -i $KERN_NUM $DEV)
 [ "$X" = "$Y" ] || error
 
+echo "Show partitions for scripts..."
+X=$($CGPT show $MTD -m -i ${KERN_NUM} ${DEV} | cut -f 1-5 | tr 'A-Z' 'a-z')
+Y=$(printf '%s\t%s\t%s\t%s\t%s' ${DEV} ${KERN_NUM} ${KERN_START} \
+  ${KERN_SIZE} ${KERN_GUID})
+[ "$X" = "$Y" ] || error
+X=$($CGPT show $MTD -m -i ${KERN_NUM} ${DEV} | cut -f 6)
+Y=$($CGPT show $MTD -u -i ${KERN_NUM} ${DEV})
+[ "$X" = "$Y" ] || error
+X=$($CGPT show $MTD -m -i ${KERN_NUM} ${DEV} | cut -f 8)
+[ "$X" = "${KERN_LABEL}" ] || error
+X=$($CGPT show $MTD -m ${DEV} ${DEV} | wc -l)
+[ "$X" = "12" ] || error
+# Tabs and newlines in a label don't break up the line
+$CGPT add $MTD -i ${KERN_NUM} -l "$(printf 'tab\there\nnewline')" ${DEV}
+X=$($CGPT show $MTD -m -i ${KERN_NUM} ${DEV} | wc -l)
+[ "$X" = "1" ] || error
+X=$($CGPT show $MTD -m -i ${KERN_NUM} ${DEV} | cut -f 8)
+[ "$X" = "tab?here?newline" ] || error
+$CGPT add $MTD -i ${KERN_NUM} -l "${KERN_LABEL}" ${DEV}
+X=$($CGPT show $MTD -q ${DEV} ${DEV} | grep -c "^${DEV}:")
+[ "$X" = "2" ] || error
+assert_fail $CGPT show $MTD -m -b -i ${KERN_NUM} ${DEV}
+assert_fail $CGPT show $MTD -m ${DEV} blah_404_haha
+
 # Input: sequence of priorities
 # Output: ${DEV} has kernel partitions with the given priorities
 make_pri() {
@@ -316,6 +340,53 @@ $CGPT show $MTD ${DEV} | grep -q INVALID
 $CGPT repair $MTD ${DEV}
 ($CGPT show $MTD ${DEV} | grep -q INVALID) && error
 
+echo "Test cgpt batch command..."
+$CGPT create $MTD ${DEV}
+$CGPT batch $MTD ${DEV} <<EOF
+add -b ${DATA_START} -s ${DATA_SIZE} -t ${DATA_GUID} -l "${DATA_LABEL}"
+# Comments and blank lines are skipped
+
+add -b ${KERN_START} -s ${KERN_SIZE} -t ${KERN_GUID} -l "${KERN_LABEL}"
+add -i ${KERN_NUM} -T 5
+EOF
+X=$($CGPT show $MTD -l -i ${KERN_NUM} ${DEV})
+[ "$X" = "$KERN_LABEL" ] || error
+X=$($CGPT show $MTD -T -i ${KERN_NUM} ${DEV})
+[ "$X" = "5" ] || error
+X=$($CGPT find $MTD -n -l "${KERN_LABEL}" ${DEV})
+[ "$X" = "${KERN_NUM}" ] || error
+assert_fail $CGPT find $MTD -l "${KERN_LABEL% *}" ${DEV}
+printf 'needle' > needle.bin
+dd if=needle.bin of=${DEV} bs=1 seek=$((KERN_START * 512 + 16)) \
+  conv=notrunc 2>/dev/null
+X=$($CGPT find $MTD -n -l "${KERN_LABEL}" -M needle.bin -O 16 ${DEV})
+[ "$X" = "${KERN_NUM}" ] || error
+assert_fail $CGPT find $MTD -l "${KERN_LABEL}" -M needle.bin -O 17 ${DEV}
+# Nothing is written if any command fails
+assert_fail $CGPT batch $MTD ${DEV} <<EOF
+add -i ${KERN_NUM} -T 7
+add -i ${ROOTFS_NUM} -T 7
+EOF
+X=$($CGPT show $MTD -T -i ${KERN_NUM} ${DEV})
+[ "$X" = "5" ] || error
+# PMBR changes are held back until the end too
+X=$($CGPT boot $MTD ${DEV})
+assert_fail $CGPT batch $MTD ${DEV} <<EOF >/dev/null
+boot -i ${KERN_NUM}
+add -i ${ROOTFS_NUM} -T 7
+EOF
+Y=$($CGPT boot $MTD ${DEV})
+[ "$X" = "$Y" ] || error
+X=$($CGPT batch $MTD ${DEV} <<EOF | tail -n 1
+boot -i ${KERN_NUM}
+boot
+EOF
+)
+Y=$($CGPT show $MTD -u -i ${KERN_NUM} ${DEV})
+[ "$X" = "$Y" ] || error
+X=$($CGPT boot $MTD ${DEV})
+[ "$X" = "$Y" ] || error
+
 echo "Test with IGNOREME primary GPT..."
 $CGPT create $MTD ${DEV}
 $CGPT legacy $MTD -p ${DEV}
@@ -0,0 +1,113 @@
+#!/bin/bash
+
+# Copyright 2020 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Run unit test binaries in parallel. Each argument is one test command line,
+# which is run through the shell. Each test's output is kept in its own log,
+# and is shown if the test fails. At the end, the slowest tests are listed.
+
+# Load common constants and variables.
+. "$(dirname "$0")/common.sh"
+
+usage() {
+  cat 1>&2 <<EOF
+Usage: $0 [options] "TEST [ARGS...]" ...
+
+Options:
+  -j JOBS       Number of tests to run at once (default: number of CPUs)
+  -o DIR        Directory for test logs (default: \${BUILD}/unit_test_logs)
+  -s COUNT      Number of slowest tests to list (default: 10; 0 for none)
+  -w WRAPPER    Command to run each test under, such as an emulator
+EOF
+  exit 1
+}
+
+JOBS=$(nproc 2>/dev/null || echo 1)
+LOGDIR="${BUILD}/unit_test_logs"
+SLOWEST=10
+WRAPPER=
+
+while getopts "j:o:s:w:" opt; do
+  case "${opt}" in
+    j) JOBS=${OPTARG} ;;
+    o) LOGDIR=${OPTARG} ;;
+    s) SLOWEST=${OPTARG} ;;
+    w) WRAPPER=${OPTARG} ;;
+    *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+[ $# -gt 0 ] || usage
+[ "${JOBS}" -ge 1 ] 2>/dev/null || usage
+
+rm -rf "${LOGDIR}"
+mkdir -p "${LOGDIR}"
+
+now_ms() {
+  echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# Run one test, leaving its output in LOG and "STATUS MSECS" in LOG.result.
+run_one() {
+  local cmd=$1
+  local log=$2
+  local start
+  local rc
+
+  start=$(now_ms)
+  ${WRAPPER} ${cmd} >"${log}" 2>&1
+  rc=$?
+  echo "${rc} $(( $(now_ms) - start ))" > "${log}.result"
+}
+
+# Logs are numbered, since the same test may be run with different arguments.
+start=$(now_ms)
+running=0
+n=0
+for cmd in "$@"; do
+  : $(( n++ ))
+  name=${cmd%% *}
+  log=$(printf "%s/%03d_%s.log" "${LOGDIR}" "${n}" "${name##*/}")
+  echo "${cmd}" > "${log}.cmd"
+
+  if [ "${running}" -ge "${JOBS}" ]; then
+    wait -n
+    : $(( running-- ))
+  fi
+  run_one "${cmd}" "${log}" &
+  : $(( running++ ))
+done
+wait
+elapsed=$(( $(now_ms) - start ))
+
+passed=0
+failed=0
+for result in "${LOGDIR}"/*.log.result; do
+  log=${result%.result}
+  read -r rc msecs < "${result}"
+  printf "%d %s\n" "${msecs}" "$(cat "${log}.cmd")" >> "${LOGDIR}/times"
+  if [ "${rc}" = "0" ]; then
+    : $(( passed++ ))
+    continue
+  fi
+  : $(( failed++ ))
+  echo -e "${COL_RED}FAILED (${rc}): $(cat "${log}.cmd")${COL_STOP}"
+  cat "${log}"
+  echo
+done
+
+if [ "${SLOWEST}" -gt 0 ]; then
+  echo "Slowest tests (ms):"
+  sort -rn "${LOGDIR}/times" | head -n "${SLOWEST}" | \
+    awk '{ printf("%8d  %s\n", $1, substr($0, length($1) + 2)) }'
+fi
+
+if [ "${failed}" -gt 0 ]; then
+  echo -e "${COL_RED}${failed} of $(( passed + failed )) tests failed" \
+    "in ${elapsed} ms; logs are in ${LOGDIR}${COL_STOP}"
+  exit 1
+fi
+echo -e "${COL_GREEN}All ${passed} tests passed in ${elapsed} ms${COL_STOP}"
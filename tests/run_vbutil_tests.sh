@@ -36,6 +36,20 @@ function test_vbutil_key_single {
     then
         return_code=255
     fi
+
+    # Same again without R^2
+    ${FUTILITY} vbutil_key \
+        --pack ${TESTKEY_SCRATCH_DIR}/key_alg${algonum}.compact.vbpubk \
+        --key ${TESTKEY_DIR}/key_rsa${keylen}.keyb \
+        --version 1 \
+        --algorithm $algonum \
+        --compact && \
+    ${FUTILITY} vbutil_key \
+        --unpack ${TESTKEY_SCRATCH_DIR}/key_alg${algonum}.compact.vbpubk
+    if [ $? -ne 0 ]
+    then
+        return_code=255
+    fi
 }
 
 function test_vbutil_key_all {
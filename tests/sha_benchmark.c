@@ -9,37 +9,60 @@
 
 #include "2common.h"
 #include "2sha.h"
+#include "2sha_private.h"
 #include "2sysincludes.h"
+#include "benchmark.h"
 #include "host_common.h"
-#include "timer_utils.h"
 
-#define TEST_BUFFER_SIZE 4000000
+struct sha_bench {
+	const uint8_t *buffer;
+	enum vb2_hash_algorithm alg;
+};
 
-int main(int argc, char *argv[]) {
-	int i;
-	double speed;
-	uint32_t msecs;
-	uint8_t *buffer = malloc(TEST_BUFFER_SIZE);
+static void digest_buffer(void *arg, size_t size)
+{
+	struct sha_bench *b = arg;
 	uint8_t digest[VB2_MAX_DIGEST_SIZE];
-	ClockTimerState ct;
-
-	/* Iterate through all the hash functions. */
-	for(i = VB2_HASH_SHA1; i < VB2_HASH_ALG_COUNT; i++) {
-		StartTimer(&ct);
-		vb2_digest_buffer(buffer, TEST_BUFFER_SIZE, i,
-				  digest, sizeof(digest));
-		StopTimer(&ct);
-
-		msecs = GetDurationMsecs(&ct);
-		speed = ((TEST_BUFFER_SIZE / 10e6)
-			 / (msecs / 10e3)); /* Mbytes/sec */
-
-		fprintf(stderr,
-			"# %s Time taken = %u ms, Speed = %f Mbytes/sec\n",
-			vb2_get_hash_algorithm_name(i), msecs, speed);
-		fprintf(stdout, "mbytes_per_sec_%s:%f\n",
-			vb2_get_hash_algorithm_name(i), speed);
+
+	vb2_digest_buffer(b->buffer, size, b->alg, digest, sizeof(digest));
+}
+
+int main(int argc, char *argv[]) {
+	struct bench_options opts;
+	struct bench_result result;
+	struct sha_bench b;
+	uint8_t *buffer;
+	size_t size;
+	size_t i;
+
+	bench_init_options(&opts);
+	if (bench_parse_args(&opts, argc, argv) < 0)
+		return 1;
+
+	buffer = malloc(opts.max_size);
+	if (!buffer) {
+		fprintf(stderr, "Unable to allocate %zu bytes\n",
+			opts.max_size);
+		return 1;
+	}
+	for (i = 0; i < opts.max_size; i++)
+		buffer[i] = i * 7;
+	b.buffer = buffer;
+
+	/* Compare builds with and without the accelerated transforms */
+	fprintf(stderr, "# SHA256 transform: %s\n", VB2_SHA256_BACKEND_NAME);
+	fprintf(stderr, "# SHA512 transform: %s\n", VB2_SHA512_BACKEND_NAME);
+
+	bench_report_begin(&opts);
+	/* Iterate through all the hash functions and sizes, 4x per step. */
+	for (b.alg = VB2_HASH_SHA1; b.alg < VB2_HASH_ALG_COUNT; b.alg++) {
+		for (size = opts.min_size; size <= opts.max_size; size *= 4) {
+			bench_run(&opts, digest_buffer, &b, size, &result);
+			bench_report(&opts, vb2_get_hash_algorithm_name(b.alg),
+				     size, &result);
+		}
 	}
+	bench_report_end(&opts);
 
 	free(buffer);
 	return 0;
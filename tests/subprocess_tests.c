@@ -3,6 +3,7 @@
  * found in the LICENSE file.
  */
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -277,6 +278,94 @@ static void test_subprocess_output_to_cb(void)
 		0, "Both output buffers are equivalent.");
 }
 
+/* More than fits in the pipes, so input and output must overlap. */
+#define LARGE_SIZE (1024 * 1024)
+
+static void test_subprocess_large_output(void)
+{
+	char *input_buffer = malloc(LARGE_SIZE);
+	char *output_buffer = malloc(LARGE_SIZE);
+	const char *const argv[] = {"cat", NULL};
+
+	for (size_t i = 0; i < LARGE_SIZE; i++)
+		input_buffer[i] = (char)(i * 7);
+
+	struct subprocess_target input = {
+		.type = TARGET_BUFFER,
+		.buffer = {
+			.buf = input_buffer,
+			.size = LARGE_SIZE,
+		},
+	};
+	struct subprocess_target output = {
+		.type = TARGET_BUFFER,
+		.buffer = {
+			.buf = output_buffer,
+			.size = LARGE_SIZE,
+		},
+	};
+
+	TEST_EQ(subprocess_run(argv, &input, &output, NULL), 0,
+		"Return value of \"cat\" with large input is zero.");
+	TEST_EQ(output.buffer.bytes_consumed, LARGE_SIZE,
+		"All of the large output was read.");
+	TEST_EQ(memcmp(input_buffer, output_buffer, LARGE_SIZE), 0,
+		"Large output matches input.");
+
+	free(input_buffer);
+	free(output_buffer);
+}
+
+static void test_subprocess_timeout(void)
+{
+	const char *const argv[] = {"sleep", "10", NULL};
+
+	errno = 0;
+	TEST_EQ(subprocess_run_timeout(argv, &subprocess_null,
+				       &subprocess_null, NULL, 100), -1,
+		"\"sleep 10\" is killed at the timeout");
+	TEST_EQ(errno, ETIMEDOUT, "  errno is ETIMEDOUT");
+
+	const char *const argv2[] = {"true", NULL};
+	TEST_EQ(subprocess_run_timeout(argv2, &subprocess_null,
+				       &subprocess_null, NULL, 10000), 0,
+		"\"true\" finishes before the timeout");
+}
+
+static void test_subprocess_parallel(void)
+{
+	char output_buffer[3][20];
+	struct subprocess_target output[3];
+	const char *const argv_a[] = {"echo", "a", NULL};
+	const char *const argv_b[] = {"echo", "b", NULL};
+	const char *const argv_false[] = {"false", NULL};
+	struct subprocess_job jobs[3] = {
+		{ .argv = argv_a, .input = &subprocess_null, },
+		{ .argv = argv_b, .input = &subprocess_null, },
+		{ .argv = argv_false, .input = &subprocess_null, },
+	};
+
+	for (int i = 0; i < 3; i++) {
+		memset(&output[i], 0, sizeof(output[i]));
+		output[i].type = TARGET_BUFFER_NULL_TERMINATED;
+		output[i].buffer.buf = output_buffer[i];
+		output[i].buffer.size = sizeof(output_buffer[i]);
+		jobs[i].output = &output[i];
+	}
+
+	TEST_EQ(subprocess_run_parallel(jobs, 2, -1), 0,
+		"Two jobs in parallel succeed");
+	TEST_STR_EQ(output_buffer[0], "a\n", "  first output");
+	TEST_STR_EQ(output_buffer[1], "b\n", "  second output");
+	TEST_EQ(jobs[0].status, 0, "  first status");
+	TEST_EQ(jobs[1].status, 0, "  second status");
+
+	TEST_EQ(subprocess_run_parallel(jobs, 3, -1), -1,
+		"One failing job fails the set");
+	TEST_EQ(jobs[0].status, 0, "  first status");
+	TEST_NEQ(jobs[2].status, 0, "  failing status");
+}
+
 int main(int argc, char *argv[])
 {
 	test_subprocess_output_to_buffer();
@@ -287,6 +376,9 @@ int main(int argc, char *argv[])
 	test_subprocess_return_code_failure();
 	test_subprocess_input_from_cb();
 	test_subprocess_output_to_cb();
+	test_subprocess_large_output();
+	test_subprocess_timeout();
+	test_subprocess_parallel();
 
 	return gTestSuccess ? 0 : 255;
 }
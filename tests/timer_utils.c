@@ -6,11 +6,11 @@
 #include "timer_utils.h"
 
 void StartTimer(ClockTimerState* ct) {
-	clock_gettime(CLOCK_REALTIME, &ct->start_time);
+	clock_gettime(CLOCK_MONOTONIC, &ct->start_time);
 }
 
 void StopTimer(ClockTimerState* ct) {
-	clock_gettime(CLOCK_REALTIME, &ct->end_time);
+	clock_gettime(CLOCK_MONOTONIC, &ct->end_time);
 }
 
 uint32_t GetDurationMsecs(ClockTimerState* ct) {
@@ -22,3 +22,11 @@ uint32_t GetDurationMsecs(ClockTimerState* ct) {
 							      * Milliseconds. */
 	return (uint32_t) duration_msecs;
 }
+
+uint64_t GetDurationNsecs(ClockTimerState* ct) {
+	uint64_t start = ((uint64_t) ct->start_time.tv_sec * 1000000000 +
+			  (uint64_t) ct->start_time.tv_nsec);
+	uint64_t end = ((uint64_t) ct->end_time.tv_sec * 1000000000 +
+			(uint64_t) ct->end_time.tv_nsec);
+	return end - start;
+}
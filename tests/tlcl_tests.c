@@ -31,10 +31,15 @@ struct srcall
 	vb2_error_t retval;  /* Value to return */
 };
 
-#define MAXCALLS 8
+#define MAXCALLS 128
 static struct srcall calls[MAXCALLS];
 static int ncalls;
 
+static uint64_t mock_time_us;
+static uint32_t mock_send_us;
+static uint32_t mock_sleep_ms[MAXCALLS];
+static int mock_sleeps;
+
 /**
  * Reset mock data (for use before each test)
  */
@@ -49,6 +54,14 @@ static void ResetMocks(void)
 	for (i = 0; i < MAXCALLS; i++)
 		calls[i].rsp = calls[i].rsp_buf;
 	ncalls = 0;
+
+	mock_time_us = 12345;
+	mock_send_us = 0;
+	memset(mock_sleep_ms, 0, sizeof(mock_sleep_ms));
+	mock_sleeps = 0;
+
+	/* Forget anything cached by earlier tests */
+	TlclLibInit();
 }
 
 /**
@@ -93,10 +106,23 @@ uint32_t VbExTpmSendReceive(const uint8_t *request, uint32_t request_length,
 	if (c->rsp_size)
 		memcpy(response, c->rsp, c->rsp_size);
 	*response_length = c->rsp_size;
+	mock_time_us += mock_send_us;
 
 	return c->retval;
 }
 
+uint64_t VbExGetTimer(void)
+{
+	return mock_time_us;
+}
+
+void VbExSleepMs(uint32_t msec)
+{
+	if (mock_sleeps < MAXCALLS)
+		mock_sleep_ms[mock_sleeps++] = msec;
+	mock_time_us += msec * VB_USEC_PER_MSEC;
+}
+
 vb2_error_t VbExTpmGetRandom(uint8_t *buf, uint32_t length)
 {
 	memset(buf, 0xa5, length);
@@ -147,10 +173,131 @@ static void TlclTest(void)
 		"SendReceive error response");
 
 	// TODO: continue self test (if needed or doing)
-	// TODO: then retry doing self test
+}
 
+/**
+ * Test retrying commands while the self test is running
+ */
+static void SelfTestWaitTest(void)
+{
+	const struct tlcl_selftest_wait *wait = TlclGetSelfTestWait();
+	uint8_t buf[32], buf2[32];
+	uint32_t total_ms = 0;
+	int i;
+
+	ResetMocks();
+	TlclLibInit();
+	ToTpmUint32(buf + 2, 10);
+	for (i = 0; i < 3; i++)
+		SetResponse(i, TPM_E_DOING_SELFTEST, 10);
+	TEST_EQ(TlclSendReceiveDuringSelfTest(buf, buf2, sizeof(buf2)), 0,
+		"Self test wait");
+	TEST_EQ(ncalls, 4, "  tries");
+	TEST_EQ(mock_sleeps, 3, "  sleeps");
+	TEST_EQ(mock_sleep_ms[0], TPM_SELFTEST_POLL_MIN_MS, "  first delay");
+	TEST_EQ(mock_sleep_ms[1], 2 * TPM_SELFTEST_POLL_MIN_MS,
+		"  second delay");
+	TEST_EQ(mock_sleep_ms[2], 4 * TPM_SELFTEST_POLL_MIN_MS,
+		"  third delay");
+	TEST_EQ(wait->retries, 3, "  retries counted");
+	TEST_EQ(wait->sleep_ms, 7 * TPM_SELFTEST_POLL_MIN_MS,
+		"  delay counted");
+
+	/* Other errors aren't retried */
+	ResetMocks();
+	TlclLibInit();
+	SetResponse(0, TPM_E_DOING_SELFTEST, 10);
+	SetResponse(1, TPM_E_IOERROR, 10);
+	TEST_EQ(TlclSendReceiveDuringSelfTest(buf, buf2, sizeof(buf2)),
+		TPM_E_IOERROR, "Self test wait error");
+	TEST_EQ(ncalls, 2, "  tries");
+	TEST_EQ(wait->retries, 1, "  retries counted");
+
+	/* Give up at the deadline */
+	ResetMocks();
+	TlclLibInit();
+	for (i = 0; i < MAXCALLS; i++)
+		SetResponse(i, TPM_E_DOING_SELFTEST, 10);
+	TEST_EQ(TlclSendReceiveDuringSelfTest(buf, buf2, sizeof(buf2)),
+		TPM_E_DOING_SELFTEST, "Self test wait timeout");
+	TEST_TRUE(ncalls < MAXCALLS, "  bounded tries");
+	for (i = 0; i < mock_sleeps; i++) {
+		if (mock_sleep_ms[i] > TPM_SELFTEST_POLL_MAX_MS)
+			break;
+		total_ms += mock_sleep_ms[i];
+	}
+	TEST_EQ(i, mock_sleeps, "  delays capped");
+	TEST_EQ(total_ms, TPM_SELFTEST_TIMEOUT_MS, "  waited until deadline");
+	TEST_EQ(wait->sleep_ms, TPM_SELFTEST_TIMEOUT_MS, "  delay counted");
+	TEST_EQ(wait->retries, ncalls - 1, "  retries counted");
+
+	/* Starting the self test is remembered */
+	ResetMocks();
+	TlclLibInit();
+	TEST_EQ(wait->started, 0, "Self test not started");
+	SetResponse(0, TPM_E_IOERROR, 10);
+	TEST_EQ(TlclContinueSelfTest(), TPM_E_IOERROR, "Self test start fail");
+	TEST_EQ(wait->started, 0, "  not started");
+	TEST_EQ(TlclContinueSelfTest(), TPM_SUCCESS, "Self test start");
+	TEST_EQ(wait->started, 1, "  started");
+
+	/* TlclLibInit() resets the counters */
+	TlclLibInit();
+	TEST_EQ(wait->started, 0, "Self test wait reset");
+	TEST_EQ(wait->retries, 0, "  retries reset");
+	TEST_EQ(wait->sleep_ms, 0, "  delay reset");
 }
 
+/**
+ * Test per-command latency stats
+ */
+static void CommandStatsTest(void)
+{
+	const struct tlcl_command_stats *stats;
+	uint8_t buf[32], buf2[32];
+	int count;
+	int i;
+
+	ResetMocks();
+	TlclLibInit();
+	stats = TlclGetCommandStats(&count);
+	TEST_EQ(count, 0, "Stats empty");
+
+	mock_send_us = 100;
+	TEST_SUCC(TlclStartup(), "Stats startup");
+	mock_send_us = 300;
+	TEST_SUCC(TlclStartup(), "Stats startup again");
+	mock_send_us = 50;
+	TEST_SUCC(TlclSaveState(), "Stats save state");
+
+	stats = TlclGetCommandStats(&count);
+	TEST_EQ(count, 2, "  commands");
+	TEST_EQ(stats[0].command, TPM_ORD_Startup, "  first command");
+	TEST_EQ(stats[0].count, 2, "  count");
+	TEST_EQ(stats[0].total_us, 400, "  total");
+	TEST_EQ(stats[0].max_us, 300, "  max");
+	TEST_EQ(stats[1].command, TPM_ORD_SaveState, "  second command");
+	TEST_EQ(stats[1].count, 1, "  count");
+	TEST_EQ(stats[1].total_us, 50, "  total");
+
+	/* Codes beyond the table size are dropped */
+	ResetMocks();
+	TlclLibInit();
+	ToTpmUint32(buf + 2, 10);
+	for (i = 0; i < TLCL_MAX_COMMAND_STATS + 4; i++) {
+		ToTpmUint32(buf + 6, 0x1000 + i);
+		TlclSendReceive(buf, buf2, sizeof(buf2));
+	}
+	stats = TlclGetCommandStats(&count);
+	TEST_EQ(count, TLCL_MAX_COMMAND_STATS, "Stats table full");
+	TEST_EQ(stats[TLCL_MAX_COMMAND_STATS - 1].command,
+		0x1000 + TLCL_MAX_COMMAND_STATS - 1, "  last tracked");
+
+	/* TlclLibInit() resets them */
+	TlclLibInit();
+	TlclGetCommandStats(&count);
+	TEST_EQ(count, 0, "Stats reset");
+}
 
 /**
  * Test send-command functions
@@ -234,6 +381,7 @@ static void SendCommandTest(void)
 static void ReadWriteTest(void)
 {
 	uint8_t buf[32];
+	uint32_t perms;
 
 	ResetMocks();
 	TEST_EQ(TlclDefineSpace(1, 2, 3), 0, "DefineSpace");
@@ -251,10 +399,38 @@ static void ReadWriteTest(void)
 	ResetMocks();
 	TEST_EQ(TlclWrite(1, buf, 3), 0, "Write");
 	TEST_EQ(calls[0].req_cmd, TPM_ORD_NV_WriteValue, "  cmd");
+	TEST_EQ(calls[0].req_size, 25, "  size");
 
 	ResetMocks();
 	TEST_EQ(TlclRead(1, buf, 3), 0, "Read");
 	TEST_EQ(calls[0].req_cmd, TPM_ORD_NV_ReadValue, "  cmd");
+	TEST_EQ(calls[0].req_size, 22, "  size");
+
+	ResetMocks();
+	struct tlcl_nv_read reads[] = {
+		{ .index = 1, .data = buf, .length = 3 },
+		{ .index = 2, .data = buf + 3, .length = 4,
+		  .permissions = &perms },
+	};
+	TEST_EQ(TlclReadSpaces(reads, 1), 0, "ReadSpaces");
+	TEST_EQ(ncalls, 1, "  calls");
+	TEST_EQ(calls[0].req_cmd, TPM_ORD_NV_ReadValue, "  cmd");
+	TEST_EQ(reads[0].result, 0, "  result");
+
+	ResetMocks();
+	calls[0].retval = VB2_ERROR_MOCK;
+	reads[1].permissions = NULL;
+	TEST_EQ(TlclReadSpaces(reads, 2), VB2_ERROR_MOCK, "ReadSpaces fail");
+	TEST_EQ(ncalls, 2, "  later spaces still read");
+	TEST_EQ(reads[0].result, VB2_ERROR_MOCK, "  first result");
+	TEST_EQ(reads[1].result, 0, "  second result");
+
+	ResetMocks();
+	reads[1].permissions = &perms;
+	TlclReadSpaces(reads, 2);
+	TEST_EQ(ncalls, 3, "ReadSpaces permissions");
+	TEST_EQ(calls[1].req_cmd, TPM_ORD_NV_ReadValue, "  read");
+	TEST_EQ(calls[2].req_cmd, TPM_ORD_GetCapability, "  permissions");
 
 	ResetMocks();
 	TEST_EQ(TlclWriteLock(1), 0, "WriteLock");
@@ -467,6 +643,7 @@ static void PcrTest(void)
 	ResetMocks();
 	TEST_EQ(TlclExtend(1, buf, buf2), 0, "Extend");
 	TEST_EQ(calls[0].req_cmd, TPM_ORD_Extend, "  cmd");
+	TEST_EQ(calls[0].req_size, 34, "  size");
 }
 
 /**
@@ -575,6 +752,38 @@ static void FlagsTest(void)
 	ResetMocks();
 	TEST_EQ(TlclGetOwnership(buf), 0, "GetOwnership");
 	TEST_EQ(calls[0].req_cmd, TPM_ORD_GetCapability, "  cmd");
+
+	/* Repeated queries are answered from the cache */
+	ResetMocks();
+	calls[0].rsp_buf[14] = 0x42;
+	SetResponse(0, 0, 32);
+	TEST_SUCC(TlclGetPermanentFlags(&pflags), "Cached flags");
+	TEST_SUCC(TlclGetFlags(&disable, &deactivated, &nvlocked),
+		  "  get flags");
+	TEST_SUCC(TlclGetPermanentFlags(&pflags), "  again");
+	TEST_EQ(ncalls, 1, "  one command");
+	TEST_EQ(*(uint8_t *)&pflags, 0x42, "  same flags");
+	TEST_SUCC(TlclRead(1, buf, 0), "  read");
+	TEST_SUCC(TlclGetPermanentFlags(&pflags), "  after read");
+	TEST_EQ(ncalls, 2, "  reads don't invalidate");
+
+	/* State-changing commands do */
+	TEST_SUCC(TlclForceClear(), "  force clear");
+	TEST_SUCC(TlclGetPermanentFlags(&pflags), "  after force clear");
+	TEST_SUCC(TlclGetOwnership(buf), "  ownership");
+	TEST_SUCC(TlclGetOwnership(buf), "  ownership again");
+	TEST_EQ(ncalls, 5, "  queried again");
+	TEST_SUCC(TlclSetEnable(), "  enable");
+	TEST_SUCC(TlclGetOwnership(buf), "  ownership after enable");
+	TEST_EQ(ncalls, 7, "  queried again");
+
+	/* Failed queries aren't cached */
+	ResetMocks();
+	SetResponse(0, TPM_E_IOERROR, 10);
+	TEST_EQ(TlclGetSTClearFlags(&vflags), TPM_E_IOERROR, "Query fails");
+	TEST_SUCC(TlclGetSTClearFlags(&vflags), "  then succeeds");
+	TEST_SUCC(TlclGetSTClearFlags(&vflags), "  then cached");
+	TEST_EQ(ncalls, 2, "  commands");
 }
 
 /**
@@ -1155,6 +1364,8 @@ static void ReadDelegationFamilyTableTest(void) {
 int main(void)
 {
 	TlclTest();
+	SelfTestWaitTest();
+	CommandStatsTest();
 	SendCommandTest();
 	ReadWriteTest();
 	DefineSpaceExTest();
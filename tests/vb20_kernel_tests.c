@@ -48,8 +48,11 @@ static struct {
 } mock_vblock;
 
 static int mock_read_res_fail_on_call;
+static int mock_prefetch_count;
+static enum vb2_resource_index mock_prefetch_index;
 static int mock_unpack_key_retval;
 static int mock_verify_keyblock_retval;
+static int mock_verify_keyblock_calls;
 static int mock_verify_preamble_retval;
 
 /* Type of test to reset for */
@@ -92,8 +95,10 @@ static void reset_common_data(enum reset_type t)
 	vb2_secdata_kernel_init(ctx);
 
 	mock_read_res_fail_on_call = 0;
+	mock_prefetch_count = 0;
 	mock_unpack_key_retval = VB2_SUCCESS;
 	mock_verify_keyblock_retval = VB2_SUCCESS;
+	mock_verify_keyblock_calls = 0;
 	mock_verify_preamble_retval = VB2_SUCCESS;
 
 	/* Set up mock data for verifying keyblock */
@@ -133,6 +138,17 @@ static void reset_common_data(enum reset_type t)
 
 /* Mocked functions */
 
+vb2_error_t vb2ex_prefetch_resource(struct vb2_context *c,
+				    enum vb2_resource_index index,
+				    uint32_t offset, uint32_t size)
+{
+	/* Only whole-vblock hints are expected */
+	if (!offset && !size)
+		mock_prefetch_count++;
+	mock_prefetch_index = index;
+	return VB2_SUCCESS;
+}
+
 vb2_error_t vb2ex_read_resource(struct vb2_context *c,
 				enum vb2_resource_index index, uint32_t offset,
 				void *buf, uint32_t size)
@@ -174,6 +190,7 @@ vb2_error_t vb2_verify_keyblock(struct vb2_keyblock *block, uint32_t size,
 				const struct vb2_public_key *key,
 				const struct vb2_workbuf *w)
 {
+	mock_verify_keyblock_calls++;
 	return mock_verify_keyblock_retval;
 }
 
@@ -242,6 +259,8 @@ static void load_kernel_keyblock_tests(void)
 	reset_common_data(FOR_KEYBLOCK);
 	expected_offset = sd->workbuf_used;
 	TEST_SUCC(vb2_load_kernel_keyblock(ctx), "Kernel keyblock good");
+	TEST_EQ(mock_prefetch_count, 1, "  vblock prefetched");
+	TEST_EQ(mock_prefetch_index, VB2_RES_KERNEL_VBLOCK, "  prefetch index");
 	TEST_NEQ(sd->flags & VB2_SD_FLAG_KERNEL_SIGNED, 0, "  Kernel signed");
 	TEST_EQ(sd->kernel_version, 0x20000, "keyblock version");
 	TEST_EQ(sd->vblock_preamble_offset, sizeof(mock_vblock.k),
@@ -310,6 +329,34 @@ static void load_kernel_keyblock_tests(void)
 	mock_verify_keyblock_retval = VB2_ERROR_MOCK;
 	TEST_SUCC(vb2_load_kernel_keyblock(ctx), "Kernel keyblock hash good");
 	TEST_EQ(sd->flags & VB2_SD_FLAG_KERNEL_SIGNED, 0, "  Kernel signed");
+	TEST_EQ(mock_verify_keyblock_calls, 0, "  Signature not checked");
+
+	/* Dev mode still checks the signature if it could roll forward */
+	reset_common_data(FOR_KEYBLOCK);
+	ctx->flags |= VB2_CONTEXT_DEVELOPER_MODE |
+		VB2_CONTEXT_ALLOW_KERNEL_ROLL_FORWARD;
+	TEST_SUCC(vb2_load_kernel_keyblock(ctx),
+		  "Kernel keyblock dev roll forward");
+	TEST_NEQ(sd->flags & VB2_SD_FLAG_KERNEL_SIGNED, 0, "  Kernel signed");
+	TEST_EQ(mock_verify_keyblock_calls, 1, "  Signature checked");
+
+	/* A signed keyblock with a bad hash is still fine in dev mode */
+	reset_common_data(FOR_KEYBLOCK);
+	ctx->flags |= VB2_CONTEXT_DEVELOPER_MODE;
+	mock_vblock.k.hash[0] ^= 0x01;
+	TEST_SUCC(vb2_load_kernel_keyblock(ctx),
+		  "Kernel keyblock dev bad hash");
+	TEST_EQ(mock_verify_keyblock_calls, 1, "  Signature checked");
+
+	/* A keyblock with a bad hash and a bad signature fails in dev mode */
+	reset_common_data(FOR_KEYBLOCK);
+	ctx->flags |= VB2_CONTEXT_DEVELOPER_MODE;
+	mock_verify_keyblock_retval = VB2_ERROR_MOCK;
+	mock_vblock.k.hash[0] ^= 0x01;
+	TEST_EQ(vb2_load_kernel_keyblock(ctx),
+		VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"Kernel keyblock dev bad hash and signature");
+	TEST_EQ(mock_verify_keyblock_calls, 1, "  Signature checked");
 
 	/* But we do in dev+rec mode */
 	reset_common_data(FOR_KEYBLOCK);
@@ -48,9 +48,18 @@ static struct {
 } mock_vblock;
 
 static int mock_read_res_fail_on_call;
+static int mock_prefetch_count;
+static enum vb2_resource_index mock_prefetch_index;
 static int mock_unpack_key_retval;
 static int mock_verify_keyblock_retval;
 static int mock_verify_preamble_retval;
+static int mock_verify_keyblock_calls;
+static int mock_verify_preamble_calls;
+static int mock_check_calls;
+static int mock_cache_enabled;
+static int mock_cache_valid;
+static int mock_cache_writes;
+static uint8_t mock_cache[VB2_VBLOCK_CACHE_DIGEST_SIZE];
 
 /* Type of test to reset for */
 enum reset_type {
@@ -77,9 +86,14 @@ static void reset_common_data(enum reset_type t)
 	vb2_secdata_firmware_init(ctx);
 
 	mock_read_res_fail_on_call = 0;
+	mock_prefetch_count = 0;
 	mock_unpack_key_retval = VB2_SUCCESS;
 	mock_verify_keyblock_retval = VB2_SUCCESS;
 	mock_verify_preamble_retval = VB2_SUCCESS;
+	mock_verify_keyblock_calls = 0;
+	mock_verify_preamble_calls = 0;
+	mock_check_calls = 0;
+	mock_cache_writes = 0;
 
 	/* Set up mock data for verifying keyblock */
 	sd->fw_version_secdata = 0x20002;
@@ -87,7 +101,8 @@ static void reset_common_data(enum reset_type t)
 				 sd->fw_version_secdata);
 
 	gbb.rootkey_offset = vb2_offset_of(&mock_gbb, &mock_gbb.rootkey);
-	gbb.rootkey_size = sizeof(mock_gbb.rootkey_data);
+	gbb.rootkey_size = sizeof(mock_gbb.rootkey) +
+		sizeof(mock_gbb.rootkey_data);
 	sd->last_fw_result = VB2_FW_RESULT_SUCCESS;
 
 	mock_gbb.rootkey.algorithm = 11;
@@ -119,6 +134,17 @@ struct vb2_gbb_header *vb2_get_gbb(struct vb2_context *c)
 	return &gbb;
 }
 
+vb2_error_t vb2ex_prefetch_resource(struct vb2_context *c,
+				    enum vb2_resource_index index,
+				    uint32_t offset, uint32_t size)
+{
+	/* Only whole-vblock hints are expected */
+	if (!offset && !size)
+		mock_prefetch_count++;
+	mock_prefetch_index = index;
+	return VB2_SUCCESS;
+}
+
 vb2_error_t vb2ex_read_resource(struct vb2_context *c,
 				enum vb2_resource_index index, uint32_t offset,
 				void *buf, uint32_t size)
@@ -160,17 +186,57 @@ vb2_error_t vb2_verify_keyblock(struct vb2_keyblock *block, uint32_t size,
 				const struct vb2_public_key *key,
 				const struct vb2_workbuf *wb)
 {
+	mock_verify_keyblock_calls++;
 	return mock_verify_keyblock_retval;
 }
 
+vb2_error_t vb2_check_keyblock(const struct vb2_keyblock *block, uint32_t size,
+			       const struct vb2_signature *sig)
+{
+	mock_check_calls++;
+	return VB2_SUCCESS;
+}
+
 vb2_error_t vb2_verify_fw_preamble(struct vb2_fw_preamble *preamble,
 				   uint32_t size,
 				   const struct vb2_public_key *key,
 				   const struct vb2_workbuf *wb)
 {
+	mock_verify_preamble_calls++;
 	return mock_verify_preamble_retval;
 }
 
+vb2_error_t vb2_check_fw_preamble(const struct vb2_fw_preamble *preamble,
+				  uint32_t size)
+{
+	mock_check_calls++;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_read_vblock_cache(struct vb2_context *c, uint8_t *digest,
+				    uint32_t size)
+{
+	if (!mock_cache_enabled)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+	if (!mock_cache_valid)
+		return VB2_ERROR_UNKNOWN;
+
+	memcpy(digest, mock_cache, size);
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_write_vblock_cache(struct vb2_context *c,
+				     const uint8_t *digest, uint32_t size)
+{
+	if (!mock_cache_enabled)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+
+	mock_cache_writes++;
+	memcpy(mock_cache, digest, size);
+	mock_cache_valid = 1;
+	return VB2_SUCCESS;
+}
+
 /* Tests */
 
 static void verify_keyblock_tests(void)
@@ -183,6 +249,8 @@ static void verify_keyblock_tests(void)
 	reset_common_data(FOR_KEYBLOCK);
 	expected_offset = sd->workbuf_used;
 	TEST_SUCC(vb2_load_fw_keyblock(ctx), "keyblock verify");
+	TEST_EQ(mock_prefetch_count, 1, "  vblock prefetched");
+	TEST_EQ(mock_prefetch_index, VB2_RES_FW_VBLOCK, "  prefetch index");
 	TEST_EQ(sd->fw_version, 0x20000, "keyblock version");
 	TEST_EQ(sd->vblock_preamble_offset, sizeof(mock_vblock.k),
 		"preamble offset");
@@ -211,13 +279,13 @@ static void verify_keyblock_tests(void)
 	/* Test failures */
 	reset_common_data(FOR_KEYBLOCK);
 	sd->workbuf_used = sd->workbuf_size + VB2_WORKBUF_ALIGN -
-			   vb2_wb_round_up(gbb.rootkey_size);
+			   vb2_wb_round_up(sizeof(struct vb2_packed_key));
 	TEST_EQ(vb2_load_fw_keyblock(ctx),
-		VB2_ERROR_FW_KEYBLOCK_WORKBUF_ROOT_KEY,
+		VB2_ERROR_GBB_WORKBUF,
 		"keyblock not enough workbuf for root key");
 
 	reset_common_data(FOR_KEYBLOCK);
-	gbb.rootkey_size = sizeof(mock_gbb);
+	gbb.rootkey_size = sizeof(mock_gbb) + 1;
 	TEST_EQ(vb2_load_fw_keyblock(ctx),
 		VB2_ERROR_EX_READ_RESOURCE_SIZE,
 		"keyblock read root key");
@@ -386,10 +454,102 @@ static void verify_preamble_tests(void)
 	TEST_EQ(v, 0x20002, "no roll forward");
 }
 
+static void load_vblock(const char *desc)
+{
+	TEST_SUCC(vb2_load_fw_keyblock(ctx), desc);
+	TEST_SUCC(vb2_load_fw_preamble(ctx), "  load preamble");
+}
+
+static void vblock_cache_tests(void)
+{
+	const uint8_t zero[VB2_VBLOCK_CACHE_DIGEST_SIZE] = {0};
+
+	/* No cache support; nothing is hashed */
+	mock_cache_enabled = 0;
+	reset_common_data(FOR_KEYBLOCK);
+	load_vblock("vblock cache: unimplemented");
+	TEST_EQ(mock_verify_keyblock_calls, 1, "  keyblock verified");
+	TEST_EQ(mock_verify_preamble_calls, 1, "  preamble verified");
+	TEST_EQ(sd->flags & VB2_SD_FLAG_VBLOCK_CACHE_ENABLED, 0,
+		"  cache disabled");
+	TEST_SUCC(memcmp(sd->vblock_keyblock_digest, zero, sizeof(zero)),
+		  "  keyblock not hashed");
+
+	/* No cache yet; verify and fill it */
+	mock_cache_enabled = 1;
+	mock_cache_valid = 0;
+	reset_common_data(FOR_KEYBLOCK);
+	load_vblock("vblock cache: empty");
+	TEST_EQ(mock_verify_keyblock_calls, 1, "  keyblock verified");
+	TEST_EQ(mock_verify_preamble_calls, 1, "  preamble verified");
+	TEST_EQ(mock_cache_writes, 1, "  cache written");
+	TEST_EQ(sd->flags & VB2_SD_FLAG_VBLOCK_CACHED, 0, "  not cached");
+	TEST_NEQ(sd->flags & VB2_SD_FLAG_VBLOCK_CACHE_ENABLED, 0,
+		 "  cache enabled");
+
+	/* Same vblock skips both signatures, but not the sanity checks */
+	reset_common_data(FOR_KEYBLOCK);
+	load_vblock("vblock cache: hit");
+	TEST_EQ(mock_verify_keyblock_calls, 0, "  keyblock not verified");
+	TEST_EQ(mock_verify_preamble_calls, 0, "  preamble not verified");
+	TEST_EQ(mock_check_calls, 2, "  sanity checked");
+	TEST_EQ(mock_cache_writes, 0, "  cache not rewritten");
+	TEST_NEQ(sd->flags & VB2_SD_FLAG_VBLOCK_CACHED, 0, "  cached");
+
+	/* Anything that changes the vblock or root key misses */
+	reset_common_data(FOR_KEYBLOCK);
+	sd->fw_slot = 1;
+	load_vblock("vblock cache: other slot");
+	TEST_EQ(mock_verify_keyblock_calls, 1, "  keyblock verified");
+	TEST_EQ(mock_verify_preamble_calls, 1, "  preamble verified");
+	sd->fw_slot = 0;
+
+	reset_common_data(FOR_KEYBLOCK);
+	load_vblock("vblock cache: refill slot A");
+	mock_gbb.rootkey.key_version ^= 1;
+	reset_common_data(FOR_KEYBLOCK);
+	load_vblock("vblock cache: other root key");
+	TEST_EQ(mock_verify_keyblock_calls, 1, "  keyblock verified");
+	mock_gbb.rootkey.key_version ^= 1;
+
+	reset_common_data(FOR_KEYBLOCK);
+	load_vblock("vblock cache: refill root key");
+	reset_common_data(FOR_KEYBLOCK);
+	mock_vblock.p.predata[5] ^= 1;
+	load_vblock("vblock cache: other preamble");
+	TEST_EQ(mock_verify_keyblock_calls, 1, "  keyblock verified");
+	TEST_EQ(mock_verify_preamble_calls, 1, "  preamble verified");
+	TEST_EQ(mock_cache_writes, 1, "  cache rewritten");
+	mock_vblock.p.predata[5] ^= 1;
+
+	/* Preamble changing between the two reads isn't trusted */
+	reset_common_data(FOR_KEYBLOCK);
+	load_vblock("vblock cache: refill preamble");
+	reset_common_data(FOR_KEYBLOCK);
+	TEST_SUCC(vb2_load_fw_keyblock(ctx), "vblock cache: keyblock hit");
+	TEST_EQ(mock_verify_keyblock_calls, 0, "  keyblock not verified");
+	mock_vblock.p.predata[5] ^= 1;
+	TEST_SUCC(vb2_load_fw_preamble(ctx), "  preamble changed");
+	TEST_EQ(mock_verify_preamble_calls, 1, "  preamble verified");
+	mock_vblock.p.predata[5] ^= 1;
+
+	/* Bad signature with no cache still fails */
+	reset_common_data(FOR_KEYBLOCK);
+	mock_cache_valid = 0;
+	mock_verify_preamble_retval = VB2_ERROR_PREAMBLE_SIG_INVALID;
+	TEST_SUCC(vb2_load_fw_keyblock(ctx), "vblock cache: bad sig");
+	TEST_EQ(vb2_load_fw_preamble(ctx), VB2_ERROR_PREAMBLE_SIG_INVALID,
+		"  preamble fails");
+	TEST_EQ(mock_cache_writes, 0, "  cache not written");
+
+	mock_cache_enabled = 0;
+}
+
 int main(int argc, char* argv[])
 {
 	verify_keyblock_tests();
 	verify_preamble_tests();
+	vblock_cache_tests();
 
 	return gTestSuccess ? 0 : 255;
 }
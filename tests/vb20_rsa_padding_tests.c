@@ -101,6 +101,46 @@ static void test_verify_digest(struct vb2_public_key *key) {
 		VB2_ERROR_RSA_PADDING, "vb2_rsa_verify_digest() bad sig end");
 }
 
+/**
+ * Test vb2_rsa_verify_digest_scratch().
+ */
+static void test_verify_digest_scratch(const struct vb2_public_key *key)
+{
+	uint8_t scratch[VB2_RSA_VERIFY_SCRATCH_BYTES(RSA1024NUMBYTES) + 8]
+		 __attribute__((aligned(VB2_WORKBUF_ALIGN)));
+	uint8_t sig[RSA1024NUMBYTES];
+
+	memcpy(sig, signatures[0], sizeof(sig));
+	TEST_SUCC(vb2_rsa_verify_digest_scratch(key, sig,
+						test_message_sha1_hash,
+						scratch, sizeof(scratch) - 8),
+		  "vb2_rsa_verify_digest_scratch() good");
+
+	memcpy(sig, signatures[1], sizeof(sig));
+	TEST_NEQ(vb2_rsa_verify_digest_scratch(key, sig,
+					       test_message_sha1_hash,
+					       scratch, sizeof(scratch) - 8),
+		 VB2_SUCCESS, "vb2_rsa_verify_digest_scratch() bad sig");
+
+	memcpy(sig, signatures[0], sizeof(sig));
+	TEST_EQ(vb2_rsa_verify_digest_scratch(key, sig, test_message_sha1_hash,
+					      scratch, sizeof(scratch) - 9),
+		VB2_ERROR_RSA_VERIFY_WORKBUF,
+		"vb2_rsa_verify_digest_scratch() small scratch");
+
+	memcpy(sig, signatures[0], sizeof(sig));
+	TEST_EQ(vb2_rsa_verify_digest_scratch(key, sig, test_message_sha1_hash,
+					      scratch + 4, sizeof(scratch) - 8),
+		VB2_ERROR_RSA_VERIFY_WORKBUF,
+		"vb2_rsa_verify_digest_scratch() misaligned scratch");
+
+	memcpy(sig, signatures[0], sizeof(sig));
+	TEST_EQ(vb2_rsa_verify_digest_scratch(key, sig, test_message_sha1_hash,
+					      NULL, sizeof(scratch)),
+		VB2_ERROR_RSA_VERIFY_WORKBUF,
+		"vb2_rsa_verify_digest_scratch() no scratch");
+}
+
 int main(int argc, char *argv[])
 {
 	struct vb2_public_key k2;
@@ -125,6 +165,7 @@ int main(int argc, char *argv[])
 	/* Run tests */
 	test_signatures(&k2);
 	test_verify_digest(&k2);
+	test_verify_digest_scratch(&k2);
 
 	/* Clean up and exit */
 	free(pk);
@@ -17,6 +17,9 @@ const char *gbb_fname;
 const char *vblock_fname;
 const char *body_fname;
 
+/* Largest workbuf peak of any one call */
+static uint32_t max_call_peak;
+
 /**
  * Local implementation which reads resources from individual files.  Could be
  * more elegant and read from bios.bin, if we understood the fmap.
@@ -139,6 +142,19 @@ static vb2_error_t hash_body(struct vb2_context *c)
 	return VB2_SUCCESS;
 }
 
+/**
+ * Print the workbuf used by the call just made, and restart tracking.
+ */
+static void report_workbuf_peak(struct vb2_context *c, const char *call)
+{
+	uint32_t peak = vb2api_get_workbuf_peak(c);
+
+	printf("  %s workbuf peak = %u bytes\n", call, peak);
+	if (peak > max_call_peak)
+		max_call_peak = peak;
+	vb2api_reset_workbuf_peak(c);
+}
+
 static void print_help(const char *progname)
 {
 	printf("Usage: %s <gbb> <vblock> <body>\n", progname);
@@ -182,6 +198,7 @@ int main(int argc, char *argv[])
 	/* Do early init */
 	printf("Phase 1...\n");
 	rv = vb2api_fw_phase1(ctx);
+	report_workbuf_peak(ctx, "vb2api_fw_phase1()");
 	if (rv) {
 		printf("Phase 1 wants recovery mode.\n");
 		save_if_needed(ctx);
@@ -191,6 +208,7 @@ int main(int argc, char *argv[])
 	/* Determine which firmware slot to boot */
 	printf("Phase 2...\n");
 	rv = vb2api_fw_phase2(ctx);
+	report_workbuf_peak(ctx, "vb2api_fw_phase2()");
 	if (rv) {
 		printf("Phase 2 wants reboot.\n");
 		save_if_needed(ctx);
@@ -200,6 +218,7 @@ int main(int argc, char *argv[])
 	/* Try that slot */
 	printf("Phase 3...\n");
 	rv = vb2api_fw_phase3(ctx);
+	report_workbuf_peak(ctx, "vb2api_fw_phase3()");
 	if (rv) {
 		printf("Phase 3 wants reboot.\n");
 		save_if_needed(ctx);
@@ -209,6 +228,7 @@ int main(int argc, char *argv[])
 	/* Verify body */
 	printf("Hash body...\n");
 	rv = hash_body(ctx);
+	report_workbuf_peak(ctx, "body hash");
 	save_if_needed(ctx);
 	if (rv) {
 		printf("Phase 4 wants reboot.\n");
@@ -221,6 +241,7 @@ int main(int argc, char *argv[])
 		/* find last used workbuf offset */;
 	printf("Workbuf used = %d bytes, high watermark = %zu bytes\n",
 		sd->workbuf_used, (uint8_t *)ptr + sizeof(*ptr) - workbuf);
+	printf("Tracked workbuf peak = %u bytes\n", max_call_peak);
 
 	return 0;
 }
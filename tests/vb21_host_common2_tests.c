@@ -305,6 +305,78 @@ static int test_algorithm(int key_algorithm, const char *keys_dir)
 	return 0;
 }
 
+static void test_verify_hashes(void)
+{
+	static uint8_t data[3 * VB21_VERIFY_HASHES_STRIDE + 100];
+	static const enum vb2_hash_algorithm algs[] = {
+		VB2_HASH_SHA256,
+		VB2_HASH_SHA512,
+	};
+	uint8_t workbuf[VB2_VERIFY_DATA_WORKBUF_BYTES]
+		 __attribute__((aligned(VB2_WORKBUF_ALIGN)));
+	struct vb21_signature *sigs[ARRAY_SIZE(algs)];
+	const struct vb21_signature *hashes[ARRAY_SIZE(algs)];
+	const struct vb2_private_key *prihash;
+	struct vb2_workbuf wb;
+	int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = (uint8_t)(i * 7);
+
+	for (i = 0; i < ARRAY_SIZE(algs); i++) {
+		TEST_SUCC(vb2_private_key_hash(&prihash, algs[i]),
+			  "Make hash key");
+		TEST_SUCC(vb21_sign_data(&sigs[i], data, sizeof(data),
+					 prihash, NULL), "Make hash");
+		hashes[i] = sigs[i];
+		/* Hash keys are static, so there's nothing to free */
+	}
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	TEST_SUCC(vb21_verify_hashes(data, sizeof(data), hashes, 2,
+				     VB2_HASH_INVALID, &wb),
+		  "vb21_verify_hashes() all");
+	TEST_SUCC(vb21_verify_hashes(data, sizeof(data), hashes, 2,
+				     VB2_HASH_SHA512, &wb),
+		  "vb21_verify_hashes() SHA-512 only");
+	TEST_EQ(vb21_verify_hashes(data, sizeof(data), hashes, 2,
+				   VB2_HASH_SHA1, &wb),
+		VB2_ERROR_VDATA_NO_HASHES, "vb21_verify_hashes() none match");
+	TEST_EQ(vb21_verify_hashes(data, sizeof(data) - 1, hashes, 2,
+				   VB2_HASH_INVALID, &wb),
+		VB2_ERROR_VDATA_SIZE, "vb21_verify_hashes() wrong size");
+
+	/* A bad hash is caught even when it isn't the first */
+	data[2 * VB21_VERIFY_HASHES_STRIDE + 5] ^= 0x10;
+	TEST_EQ(vb21_verify_hashes(data, sizeof(data), hashes, 2,
+				   VB2_HASH_INVALID, &wb),
+		VB2_ERROR_VDATA_VERIFY_DIGEST, "vb21_verify_hashes() bad data");
+	data[2 * VB21_VERIFY_HASHES_STRIDE + 5] ^= 0x10;
+	((uint8_t *)sigs[1])[sigs[1]->sig_offset] ^= 0x01;
+	TEST_EQ(vb21_verify_hashes(data, sizeof(data), hashes, 2,
+				   VB2_HASH_INVALID, &wb),
+		VB2_ERROR_VDATA_VERIFY_DIGEST,
+		"vb21_verify_hashes() bad second hash");
+	TEST_SUCC(vb21_verify_hashes(data, sizeof(data), hashes, 2,
+				     VB2_HASH_SHA256, &wb),
+		  "  other hash alone still ok");
+
+	sigs[0]->sig_alg = VB2_SIG_RSA2048;
+	TEST_EQ(vb21_verify_hashes(data, sizeof(data), hashes, 1,
+				   VB2_HASH_INVALID, &wb),
+		VB2_ERROR_VDATA_ALGORITHM, "vb21_verify_hashes() not a hash");
+	sigs[0]->sig_alg = VB2_SIG_NONE;
+
+	vb2_workbuf_init(&wb, workbuf, 2 * sizeof(struct vb2_digest_context));
+	TEST_EQ(vb21_verify_hashes(data, sizeof(data), hashes, 2,
+				   VB2_HASH_INVALID, &wb),
+		VB2_ERROR_VDATA_WORKBUF_HASHING,
+		"vb21_verify_hashes() workbuf too small");
+
+	for (i = 0; i < ARRAY_SIZE(algs); i++)
+		free(sigs[i]);
+}
+
 /* Test only the algorithms we use */
 const int key_algs[] = {
 	VB2_ALG_RSA2048_SHA256,
@@ -336,5 +408,7 @@ int main(int argc, char *argv[]) {
 		return -1;
 	}
 
+	test_verify_hashes();
+
 	return gTestSuccess ? 0 : 255;
 }
@@ -175,6 +175,57 @@ static void test_common_header_functions(void)
 		"vb21_verify_common_subobject() size");
 }
 
+/**
+ * Member walk
+ */
+static void test_verify_members(void)
+{
+	uint8_t cbuf[sizeof(struct vb21_struct_common) + 128];
+	struct vb21_struct_common *c = (struct vb21_struct_common *)cbuf;
+	struct vb21_struct_common *c2;
+	struct vb21_member m[3];
+	uint32_t hdr_end;
+
+	memset(cbuf, 0, sizeof(cbuf));
+	c->total_size = sizeof(cbuf);
+	c->fixed_size = sizeof(*c);
+	hdr_end = c->fixed_size;
+
+	c2 = (struct vb21_struct_common *)(cbuf + hdr_end + 16);
+	c2->total_size = 32;
+	c2->fixed_size = sizeof(*c2);
+
+	/* Members listed out of offset order */
+	memset(m, 0, sizeof(m));
+	m[0].offset = hdr_end + 48;
+	m[0].size = 8;
+	m[1].offset = hdr_end;
+	m[1].size = 16;
+	m[2].offset = hdr_end + 16;
+	m[2].subobject = 1;
+	TEST_SUCC(vb21_verify_members(cbuf, m, 3), "vb21_verify_members()");
+	TEST_PTR_EQ(m[0].data, cbuf + hdr_end + 48, "  data 0");
+	TEST_PTR_EQ(m[1].data, cbuf + hdr_end, "  data 1");
+	TEST_PTR_EQ(m[2].data, c2, "  subobject data");
+	TEST_EQ(m[2].size, 32, "  subobject size");
+
+	m[0].offset = hdr_end + 44;
+	TEST_EQ(vb21_verify_members(cbuf, m, 3),
+		VB2_ERROR_COMMON_MEMBER_OVERLAP,
+		"vb21_verify_members() overlap");
+
+	m[0].offset = c->total_size - 4;
+	TEST_EQ(vb21_verify_members(cbuf, m, 3),
+		VB2_ERROR_COMMON_MEMBER_SIZE,
+		"vb21_verify_members() size");
+
+	m[0].offset = hdr_end + 48;
+	c2->total_size = c->total_size;
+	TEST_EQ(vb21_verify_members(cbuf, m, 3),
+		VB2_ERROR_COMMON_TOTAL_SIZE,
+		"vb21_verify_members() subobject size");
+}
+
 /**
  * Signature size
  */
@@ -240,6 +291,7 @@ int main(int argc, char* argv[])
 {
 	test_struct_packing();
 	test_common_header_functions();
+	test_verify_members();
 	test_sig_size();
 	test_verify_hash();
 
@@ -27,6 +27,7 @@ static const struct alg_combo test_algs[] = {
 	{"RSA2048/SHA-256", VB2_SIG_RSA2048, VB2_HASH_SHA256},
 	{"RSA4096/SHA-256", VB2_SIG_RSA4096, VB2_HASH_SHA256},
 	{"RSA8192/SHA-512", VB2_SIG_RSA8192, VB2_HASH_SHA512},
+	{"ECDSA-P256/SHA-256", VB2_SIG_ECDSA_P256, VB2_HASH_SHA256},
 };
 
 static void private_key_tests(const struct alg_combo *combo,
@@ -46,7 +47,12 @@ static void private_key_tests(const struct alg_combo *combo,
 
 	TEST_SUCC(vb2_private_key_read_pem(&key, pemfile), "Read pem - good");
 	TEST_PTR_NEQ(key, NULL, "  key_ptr");
-	TEST_PTR_NEQ(key->rsa_private_key, NULL, "  rsa_private_key");
+	if (combo->sig_alg == VB2_SIG_ECDSA_P256) {
+		TEST_PTR_NEQ(key->ec_private_key, NULL, "  ec_private_key");
+		TEST_EQ(key->sig_alg, VB2_SIG_ECDSA_P256, "  sig_alg");
+	} else {
+		TEST_PTR_NEQ(key->rsa_private_key, NULL, "  rsa_private_key");
+	}
 	TEST_PTR_EQ(key->desc, NULL, "  desc");
 	vb2_private_key_free(key);
 
@@ -136,8 +142,10 @@ static void private_key_tests(const struct alg_combo *combo,
 	memcpy(buf, buf2, bufsize);
 	pkey->key_size -= 32;
 	TEST_EQ(vb21_private_key_unpack(&k2, buf, bufsize),
+		combo->sig_alg == VB2_SIG_ECDSA_P256 ?
+		VB2_ERROR_UNPACK_PRIVATE_KEY_EC :
 		VB2_ERROR_UNPACK_PRIVATE_KEY_RSA,
-		"Unpack private key bad rsa data");
+		"Unpack private key bad key data");
 
 	memcpy(buf, buf2, bufsize);
 	pkey->sig_alg = VB2_SIG_NONE;
@@ -288,8 +296,13 @@ static int test_algorithm(const struct alg_combo *combo, const char *keys_dir,
 
 	printf("***Testing algorithm: %s\n", combo->name);
 
-	xasprintf(&pemfile, "%s/key_rsa%d.pem", keys_dir, rsa_bits);
-	xasprintf(&keybfile, "%s/key_rsa%d.keyb", keys_dir, rsa_bits);
+	if (combo->sig_alg == VB2_SIG_ECDSA_P256) {
+		xasprintf(&pemfile, "%s/key_ecdsa_p256.pem", keys_dir);
+		xasprintf(&keybfile, "%s/key_ecdsa_p256.keyb", keys_dir);
+	} else {
+		xasprintf(&pemfile, "%s/key_rsa%d.pem", keys_dir, rsa_bits);
+		xasprintf(&keybfile, "%s/key_rsa%d.keyb", keys_dir, rsa_bits);
+	}
 
 	private_key_tests(combo, pemfile, temp_dir);
 	public_key_tests(combo, keybfile, temp_dir);
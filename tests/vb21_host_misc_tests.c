@@ -33,6 +33,7 @@ static void file_tests(const char *temp_dir)
 	const uint8_t test_data[] = "Some test data";
 	uint8_t *read_data;
 	uint32_t read_size;
+	struct vb2_file_view view;
 
 	uint8_t cbuf[sizeof(struct vb21_struct_common) + 12];
 	struct vb21_struct_common *c = (struct vb21_struct_common *)cbuf;
@@ -53,6 +54,31 @@ static void file_tests(const char *temp_dir)
 	TEST_EQ(read_size, sizeof(test_data), "  data size");
 	TEST_EQ(memcmp(read_data, test_data, read_size), 0, "  data");
 	free(read_data);
+
+	TEST_SUCC(vb2_map_file(testfile, &view, 0), "vb2_map_file() good");
+	TEST_EQ(view.mapped, 1, "  mapped");
+	TEST_EQ(view.size, sizeof(test_data), "  data size");
+	TEST_EQ(memcmp(view.data, test_data, view.size), 0, "  data");
+	vb2_unmap_file(&view);
+	TEST_PTR_EQ(view.data, NULL, "  unmapped");
+
+	TEST_SUCC(vb2_map_file(testfile, &view, 1),
+		  "vb2_map_file() copy-on-write");
+	view.data[0] ^= 0xff;
+	vb2_unmap_file(&view);
+	TEST_SUCC(vb2_read_file(testfile, &read_data, &read_size),
+		  "  reread");
+	TEST_EQ(memcmp(read_data, test_data, read_size), 0, "  file unchanged");
+	free(read_data);
+	unlink(testfile);
+
+	TEST_EQ(vb2_map_file(testfile, &view, 0), VB2_ERROR_READ_FILE_OPEN,
+		"vb2_map_file() missing");
+	fclose(fopen(testfile, "wb"));
+	TEST_SUCC(vb2_map_file(testfile, &view, 0), "vb2_map_file() empty");
+	TEST_EQ(view.mapped, 0, "  not mapped");
+	TEST_EQ(view.size, 0, "  data size");
+	vb2_unmap_file(&view);
 	unlink(testfile);
 
 	memset(cbuf, 0, sizeof(cbuf));
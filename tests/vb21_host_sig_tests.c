@@ -28,6 +28,8 @@ static const struct alg_combo test_algs[] = {
 	{"RSA2048/SHA-256", VB2_SIG_RSA2048, VB2_HASH_SHA256},
 	{"RSA4096/SHA-256", VB2_SIG_RSA4096, VB2_HASH_SHA256},
 	{"RSA8192/SHA-512", VB2_SIG_RSA8192, VB2_HASH_SHA512},
+	{"ECDSA-P256/SHA-256", VB2_SIG_ECDSA_P256, VB2_HASH_SHA256},
+	{"ECDSA-P256/SHA-512", VB2_SIG_ECDSA_P256, VB2_HASH_SHA512},
 };
 
 const struct vb2_id test_id = {.raw = {0xaa}};
@@ -43,7 +45,9 @@ static void sig_tests(const struct alg_combo *combo,
 	struct vb2_private_key *prik, prik2;
 	const struct vb2_private_key *prihash, *priks[2];
 	struct vb2_public_key *pubk, pubhash;
+	const struct vb2_public_key *pubks[2];
 	struct vb21_signature *sig, *sig2;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
 	uint32_t size;
 
 	uint8_t workbuf[VB2_VERIFY_DATA_WORKBUF_BYTES]
@@ -77,6 +81,8 @@ static void sig_tests(const struct alg_combo *combo,
 
 	priks[0] = prik;
 	priks[1] = prihash;
+	pubks[0] = pubk;
+	pubks[1] = &pubhash;
 
 	/* Sign test data */
 	TEST_SUCC(vb21_sign_data(&sig, test_data, test_size, prik, NULL),
@@ -89,6 +95,9 @@ static void sig_tests(const struct alg_combo *combo,
 	TEST_EQ(size, sig->c.total_size, "  size");
 	TEST_SUCC(vb21_verify_data(test_data, test_size, sig, pubk, &wb),
 		  "Verify good");
+	((uint8_t *)sig + sig->sig_offset)[2] ^= 0x5a;
+	TEST_NEQ(vb21_verify_data(test_data, test_size, sig, pubk, &wb),
+		 VB2_SUCCESS, "Verify bad sig");
 	free(sig);
 
 	TEST_SUCC(vb21_sign_data(&sig, test_data, test_size, prik,
@@ -110,6 +119,16 @@ static void sig_tests(const struct alg_combo *combo,
 		  "Verify with hash");
 	free(sig);
 
+	/* Sign a digest calculated by the caller */
+	TEST_SUCC(vb2_digest_buffer(test_data, test_size, combo->hash_alg,
+				    digest, sizeof(digest)), "Digest data");
+	TEST_SUCC(vb21_sign_digest(&sig, digest, test_size, prik, NULL),
+		  "Sign digest");
+	TEST_EQ(sig->data_size, test_size, "  data_size");
+	TEST_SUCC(vb21_verify_data(test_data, test_size, sig, pubk, &wb),
+		  "Verify digest");
+	free(sig);
+
 	prik2 = *prik;
 	prik2.sig_alg = VB2_SIG_INVALID;
 	TEST_EQ(vb21_sign_data(&sig, test_data, test_size, &prik2, NULL),
@@ -150,6 +169,19 @@ static void sig_tests(const struct alg_combo *combo,
 	TEST_SUCC(vb21_verify_data(buf, c_sig_offs, sig2, &pubhash, &wb),
 		  "Verify object with sig 2");
 
+	/* Verification destroys the signatures, so sign again */
+	TEST_SUCC(vb21_sign_object_multiple(buf, c_sig_offs, priks, 2),
+		  "Sign multiple again");
+	TEST_SUCC(vb21_verify_object_multiple(buf, c_sig_offs, pubks, 2, &wb),
+		  "Verify multiple");
+	TEST_EQ(vb21_verify_object_multiple(buf, c_sig_offs, pubks + 1, 1,
+					    &wb),
+		VB2_ERROR_VDATA_ALGORITHM_MISMATCH,
+		"Verify multiple wrong key");
+	TEST_NEQ(vb21_verify_object_multiple(buf, c_sig_offs + 4, pubks, 2,
+					     &wb),
+		 VB2_SUCCESS, "Verify multiple bad offset");
+
 	c->total_size -= 4;
 	TEST_EQ(vb21_sign_object_multiple(buf, c_sig_offs, priks, 2),
 		VB2_SIGN_OBJECT_OVERFLOW, "Sign multple overflow");
@@ -171,10 +203,17 @@ static int test_algorithm(const struct alg_combo *combo, const char *keys_dir)
 
 	printf("***Testing algorithm: %s\n", combo->name);
 
-	snprintf(pemfile, sizeof(pemfile),
-		 "%s/key_rsa%d.pem", keys_dir, rsa_bits);
-	snprintf(keybfile, sizeof(keybfile),
-		 "%s/key_rsa%d.keyb", keys_dir, rsa_bits);
+	if (combo->sig_alg == VB2_SIG_ECDSA_P256) {
+		snprintf(pemfile, sizeof(pemfile),
+			 "%s/key_ecdsa_p256.pem", keys_dir);
+		snprintf(keybfile, sizeof(keybfile),
+			 "%s/key_ecdsa_p256.keyb", keys_dir);
+	} else {
+		snprintf(pemfile, sizeof(pemfile),
+			 "%s/key_rsa%d.pem", keys_dir, rsa_bits);
+		snprintf(keybfile, sizeof(keybfile),
+			 "%s/key_rsa%d.keyb", keys_dir, rsa_bits);
+	}
 
 	sig_tests(combo, pemfile, keybfile);
 
@@ -21,6 +21,8 @@
 
 static uint8_t workbuf[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE]
 	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+static uint8_t workbuf2[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE]
+	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
 static struct vb2_context *ctx;
 static struct vb2_shared_data *sd;
 static struct vb2_gbb_header gbb;
@@ -56,6 +58,16 @@ static vb2_error_t retval_vb2_load_fw_keyblock;
 static vb2_error_t retval_vb2_load_fw_preamble;
 static vb2_error_t retval_vb2_digest_finalize;
 static vb2_error_t retval_vb2_verify_digest;
+static int digest_finalize_calls;
+static int hwcrypto_async_pending;
+static int hwcrypto_wait_calls;
+static vb2_error_t retval_hwcrypto_wait;
+static int prefetch_mapped_calls;
+static const void *prefetch_mapped_buf;
+static uint32_t prefetch_mapped_size;
+
+static uint8_t mapped_body[3 * VB2_MAPPED_HASH_STRIDE]
+	__attribute__((aligned(VB2_MAPPED_HASH_STRIDE)));
 
 /* Type of test to reset for */
 
@@ -90,6 +102,11 @@ static void reset_common_data(enum reset_type t)
 	retval_vb2_load_fw_preamble = VB2_SUCCESS;
 	retval_vb2_digest_finalize = VB2_SUCCESS;
 	retval_vb2_verify_digest = VB2_SUCCESS;
+	digest_finalize_calls = 0;
+	hwcrypto_async_pending = 0;
+	hwcrypto_wait_calls = 0;
+	prefetch_mapped_calls = 0;
+	retval_hwcrypto_wait = VB2_SUCCESS;
 
 	memcpy(&gbb.hwid_digest, mock_hwid_digest,
 	       sizeof(gbb.hwid_digest));
@@ -190,15 +207,43 @@ vb2_error_t vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
 	}
 }
 
+vb2_error_t vb2ex_prefetch_mapped(const void *buf, uint32_t size)
+{
+	prefetch_mapped_calls++;
+	prefetch_mapped_buf = buf;
+	prefetch_mapped_size = size;
+	return VB2_SUCCESS;
+}
+
 vb2_error_t vb2ex_hwcrypto_digest_extend(const uint8_t *buf,
 					 uint32_t size)
 {
-	if (hwcrypto_state != HWCRYPTO_ENABLED)
+	if (hwcrypto_state != HWCRYPTO_ENABLED || hwcrypto_async_pending)
 		return VB2_ERROR_UNKNOWN;
 
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2ex_hwcrypto_digest_extend_async(const uint8_t *buf,
+					       uint32_t size)
+{
+	if (hwcrypto_state != HWCRYPTO_ENABLED || hwcrypto_async_pending)
+		return VB2_ERROR_UNKNOWN;
+
+	hwcrypto_async_pending = 1;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_hwcrypto_digest_wait(void)
+{
+	if (!hwcrypto_async_pending)
+		return VB2_ERROR_UNKNOWN;
+
+	hwcrypto_async_pending = 0;
+	hwcrypto_wait_calls++;
+	return retval_hwcrypto_wait;
+}
+
 static void fill_digest(uint8_t *digest, uint32_t digest_size)
 {
 	/* Set the result to a known value. */
@@ -208,7 +253,7 @@ static void fill_digest(uint8_t *digest, uint32_t digest_size)
 vb2_error_t vb2ex_hwcrypto_digest_finalize(uint8_t *digest,
 				   uint32_t digest_size)
 {
-	if (hwcrypto_state != HWCRYPTO_ENABLED)
+	if (hwcrypto_state != HWCRYPTO_ENABLED || hwcrypto_async_pending)
 		return VB2_ERROR_UNKNOWN;
 
 	if (retval_vb2_digest_finalize == VB2_SUCCESS)
@@ -227,6 +272,7 @@ vb2_error_t vb2_digest_init(struct vb2_digest_context *dc,
 
 	dc->hash_alg = hash_alg;
 	dc->using_hwcrypto = 0;
+	dc->hwcrypto_pending = 0;
 
 	return VB2_SUCCESS;
 }
@@ -248,6 +294,7 @@ vb2_error_t vb2_digest_finalize(struct vb2_digest_context *dc, uint8_t *digest,
 	if (hwcrypto_state == HWCRYPTO_ENABLED)
 		return VB2_ERROR_UNKNOWN;
 
+	digest_finalize_calls++;
 	if (retval_vb2_digest_finalize == VB2_SUCCESS)
 		fill_digest(digest, digest_size);
 
@@ -497,6 +544,76 @@ static void phase2_tests(void)
 	TEST_NEQ(ctx->flags & VB2_CONTEXT_FW_SLOT_B, 0, "  slot b flag");
 }
 
+static void prepare_other_slot_tests(void)
+{
+	struct vb2_context *other;
+	struct vb2_shared_data *other_sd;
+
+	reset_common_data(FOR_MISC);
+	sd->status |= VB2_SD_STATUS_CHOSE_SLOT;
+	sd->fw_slot = 0;
+	sd->last_fw_slot = 0;
+	sd->last_fw_result = VB2_FW_RESULT_SUCCESS;
+	vb2_nv_set(ctx, VB2_NV_TRY_COUNT, 3);
+	vb2_nv_set(ctx, VB2_NV_FW_TRIED, 0);
+	TEST_SUCC(vb2api_fw_prepare_other_slot(ctx, workbuf2, sizeof(workbuf2),
+					       &other), "other slot good");
+	other_sd = vb2_get_sd(other);
+	TEST_PTR_EQ(other_sd, workbuf2, "  copy in new workbuf");
+	TEST_EQ(other_sd->fw_slot, 1, "  copy slot");
+	TEST_NEQ(other->flags & VB2_CONTEXT_FW_SLOT_B, 0, "  copy slot b flag");
+	TEST_EQ(other_sd->last_fw_slot, 0, "  copy last slot");
+	TEST_EQ(other_sd->last_fw_result, VB2_FW_RESULT_FAILURE,
+		"  copy last result");
+	TEST_EQ(vb2_nv_get(other, VB2_NV_FW_TRIED), 1, "  copy tried");
+	TEST_EQ(vb2_nv_get(other, VB2_NV_TRY_NEXT), 1, "  copy try next");
+	TEST_EQ(vb2_nv_get(other, VB2_NV_TRY_COUNT), 0, "  copy try count");
+	TEST_EQ(vb2_nv_get(other, VB2_NV_FW_PREV_RESULT),
+		VB2_FW_RESULT_FAILURE, "  copy prev result");
+	TEST_EQ(sd->fw_slot, 0, "  original slot");
+	TEST_EQ(ctx->flags & VB2_CONTEXT_FW_SLOT_B, 0,
+		"  original slot b flag");
+	TEST_EQ(vb2_nv_get(ctx, VB2_NV_TRY_COUNT), 3,
+		"  original try count");
+
+	/* Preparing slot A from slot B clears the slot B flag */
+	reset_common_data(FOR_MISC);
+	sd->status |= VB2_SD_STATUS_CHOSE_SLOT;
+	sd->fw_slot = 1;
+	ctx->flags |= VB2_CONTEXT_FW_SLOT_B;
+	TEST_SUCC(vb2api_fw_prepare_other_slot(ctx, workbuf2, sizeof(workbuf2),
+					       &other), "other slot A");
+	TEST_EQ(vb2_get_sd(other)->fw_slot, 0, "  copy slot");
+	TEST_EQ(other->flags & VB2_CONTEXT_FW_SLOT_B, 0, "  copy slot b flag");
+
+	reset_common_data(FOR_MISC);
+	TEST_EQ(vb2api_fw_prepare_other_slot(ctx, workbuf2, sizeof(workbuf2),
+					     &other),
+		VB2_ERROR_API_PREPARE_OTHER_SLOT, "other slot before phase 2");
+
+	reset_common_data(FOR_MISC);
+	sd->status |= VB2_SD_STATUS_CHOSE_SLOT;
+	ctx->flags |= VB2_CONTEXT_RECOVERY_MODE;
+	TEST_EQ(vb2api_fw_prepare_other_slot(ctx, workbuf2, sizeof(workbuf2),
+					     &other),
+		VB2_ERROR_API_PREPARE_OTHER_SLOT, "other slot in recovery");
+
+	reset_common_data(FOR_MISC);
+	sd->status |= VB2_SD_STATUS_CHOSE_SLOT;
+	sd->fw_slot = 0;
+	sd->last_fw_slot = 1;
+	sd->last_fw_result = VB2_FW_RESULT_FAILURE;
+	TEST_EQ(vb2api_fw_prepare_other_slot(ctx, workbuf2, sizeof(workbuf2),
+					     &other),
+		VB2_ERROR_API_PREPARE_OTHER_SLOT, "other slot failed last boot");
+
+	reset_common_data(FOR_MISC);
+	sd->status |= VB2_SD_STATUS_CHOSE_SLOT;
+	TEST_EQ(vb2api_fw_prepare_other_slot(ctx, workbuf2, sd->workbuf_used - 1,
+					     &other),
+		VB2_ERROR_WORKBUF_SMALL, "other slot workbuf too small");
+}
+
 static void get_pcr_digest_tests(void)
 {
 	uint8_t digest[VB2_PCR_DIGEST_RECOMMENDED_SIZE];
@@ -536,6 +653,39 @@ static void get_pcr_digest_tests(void)
 		"invalid enum vb2_pcr_digest");
 }
 
+static void get_pcr_events_tests(void)
+{
+	struct vb2_pcr_event events[VB2_PCR_DIGEST_COUNT + 1];
+	uint8_t digest[VB2_PCR_DIGEST_RECOMMENDED_SIZE];
+	uint32_t digest_size;
+	uint32_t count;
+
+	reset_common_data(FOR_MISC);
+
+	count = VB2_PCR_DIGEST_COUNT + 1;
+	memset(events, 0xaa, sizeof(events));
+	TEST_SUCC(vb2api_get_pcr_events(ctx, events, &count), "events");
+	TEST_EQ(count, VB2_PCR_DIGEST_COUNT, "  count");
+
+	TEST_EQ(events[0].pcr, BOOT_MODE_PCR, "  boot mode pcr");
+	TEST_EQ(events[0].digest_size, VB2_SHA1_DIGEST_SIZE,
+		"  boot mode digest size");
+	digest_size = sizeof(digest);
+	vb2api_get_pcr_digest(ctx, BOOT_MODE_PCR, digest, &digest_size);
+	TEST_SUCC(memcmp(events[0].digest, digest, sizeof(digest)),
+		  "  boot mode digest, zero-padded");
+
+	TEST_EQ(events[1].pcr, HWID_DIGEST_PCR, "  hwid pcr");
+	TEST_EQ(events[1].digest_size, VB2_GBB_HWID_DIGEST_SIZE,
+		"  hwid digest size");
+	TEST_SUCC(memcmp(events[1].digest, mock_hwid_digest,
+			 VB2_GBB_HWID_DIGEST_SIZE), "  hwid digest");
+
+	count = VB2_PCR_DIGEST_COUNT - 1;
+	TEST_EQ(vb2api_get_pcr_events(ctx, events, &count),
+		VB2_ERROR_API_PCR_DIGEST_BUF, "events buffer too small");
+}
+
 static void phase3_tests(void)
 {
 	reset_common_data(FOR_MISC);
@@ -650,6 +800,111 @@ static void extend_hash_tests(void)
 	}
 }
 
+static void extend_hash_mapped_tests(void)
+{
+	struct vb2_mapped_region region = {
+		.base = mapped_body + 16,
+		.size = 2 * VB2_MAPPED_HASH_STRIDE,
+		.flags = VB2_MAPPED_REGION_CACHED,
+	};
+
+	/* Strides end on stride boundaries; prefetch runs one stride ahead */
+	reset_common_data(FOR_EXTEND_HASH);
+	sd->hash_remaining_size = sizeof(mapped_body);
+	TEST_SUCC(vb2api_extend_hash_mapped(ctx, &region),
+		  "hash extend mapped good");
+	TEST_EQ(sd->hash_remaining_size,
+		sizeof(mapped_body) - 2 * VB2_MAPPED_HASH_STRIDE,
+		"  remaining");
+	TEST_EQ(prefetch_mapped_calls, 2, "  prefetch calls");
+	TEST_PTR_EQ(prefetch_mapped_buf,
+		    mapped_body + 2 * VB2_MAPPED_HASH_STRIDE,
+		    "  last prefetch buf");
+	TEST_EQ(prefetch_mapped_size, 16, "  last prefetch size");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	sd->hash_remaining_size = sizeof(mapped_body);
+	region.flags = 0;
+	TEST_SUCC(vb2api_extend_hash_mapped(ctx, &region),
+		  "hash extend mapped uncached");
+	TEST_EQ(prefetch_mapped_calls, 0, "  no prefetch");
+
+	/* Oversized regions don't hash anything */
+	reset_common_data(FOR_EXTEND_HASH);
+	sd->hash_remaining_size = VB2_MAPPED_HASH_STRIDE;
+	TEST_EQ(vb2api_extend_hash_mapped(ctx, &region),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash extend mapped too much");
+	TEST_EQ(sd->hash_remaining_size, VB2_MAPPED_HASH_STRIDE,
+		"  remaining unchanged");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	region.size = 0;
+	TEST_EQ(vb2api_extend_hash_mapped(ctx, &region),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash extend mapped empty");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	sd->hash_size = 0;
+	region.size = 32;
+	TEST_EQ(vb2api_extend_hash_mapped(ctx, &region),
+		VB2_ERROR_API_EXTEND_HASH_WORKBUF,
+		"hash extend mapped no workbuf");
+}
+
+static void extend_hash_async_tests(void)
+{
+	int expect_waits = hwcrypto_state == HWCRYPTO_ENABLED;
+
+	/* Double buffered: each call waits for the one before it */
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_SUCC(vb2api_extend_hash_async(ctx, mock_body, 32),
+		  "hash extend async");
+	TEST_EQ(hwcrypto_wait_calls, 0, "  no wait yet");
+	TEST_EQ(sd->hash_remaining_size, mock_body_size - 32,
+		"  remaining");
+	TEST_SUCC(vb2api_extend_hash_async(ctx, mock_body + 32, 32),
+		  "hash extend async again");
+	TEST_EQ(hwcrypto_wait_calls, expect_waits, "  waited for first");
+	TEST_SUCC(vb2api_extend_hash(ctx, mock_body + 64,
+				     mock_body_size - 64),
+		  "hash extend sync after async");
+	TEST_EQ(hwcrypto_wait_calls, 2 * expect_waits, "  waited for second");
+	TEST_SUCC(vb2api_check_hash(ctx), "check hash after async");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_SUCC(vb2api_extend_hash_async(ctx, mock_body, mock_body_size),
+		  "hash extend async all");
+	TEST_SUCC(vb2api_check_hash(ctx), "check hash waits");
+	TEST_EQ(hwcrypto_wait_calls, expect_waits, "  waited");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	sd->hash_size = 0;
+	TEST_EQ(vb2api_extend_hash_async(ctx, mock_body, mock_body_size),
+		VB2_ERROR_API_EXTEND_HASH_WORKBUF,
+		"hash extend async no workbuf");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_EQ(vb2api_extend_hash_async(ctx, mock_body, mock_body_size + 1),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash extend async too much");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_EQ(vb2api_extend_hash_async(ctx, mock_body, 0),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash extend async empty");
+
+	if (hwcrypto_state == HWCRYPTO_ENABLED) {
+		reset_common_data(FOR_EXTEND_HASH);
+		retval_hwcrypto_wait = VB2_ERROR_MOCK;
+		vb2api_extend_hash_async(ctx, mock_body, 32);
+		TEST_EQ(vb2api_extend_hash_async(ctx, mock_body + 32, 32),
+			VB2_ERROR_MOCK, "hash extend async engine error");
+
+		reset_common_data(FOR_EXTEND_HASH);
+		retval_hwcrypto_wait = VB2_ERROR_MOCK;
+		vb2api_extend_hash_async(ctx, mock_body, mock_body_size);
+		TEST_EQ(vb2api_check_hash(ctx), VB2_ERROR_MOCK,
+			"check hash async engine error");
+	}
+}
+
 static void check_hash_tests(void)
 {
 	struct vb2_fw_preamble *pre;
@@ -723,32 +978,130 @@ static void check_hash_tests(void)
 		VB2_ERROR_RSA_VERIFY_DIGEST, "check hash finalize");
 }
 
+static void tree_hash_tests(void)
+{
+	struct vb2_fw_preamble *pre;
+	uint8_t chunk_digest[VB2_SHA256_DIGEST_SIZE];
+	const uint32_t body_size = 2 * VB2_TREE_HASH_CHUNK_SIZE + 100;
+	uint32_t size;
+
+	/* Body passed in, chunked by vboot */
+	reset_common_data(FOR_MISC);
+	pre = vb2_member_of(sd, sd->preamble_offset);
+	pre->flags |= VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH;
+	pre->body_signature.data_size = body_size;
+	TEST_SUCC(vb2api_init_hash(ctx, VB2_HASH_TAG_FW_BODY),
+		  "tree init hash");
+	TEST_TRUE(sd->hash_size > sizeof(struct vb2_digest_context),
+		  "  room for chunk context");
+	TEST_EQ(sd->hash_remaining_size, body_size, "  hash remaining");
+	while (sd->hash_remaining_size) {
+		size = VB2_MIN(sd->hash_remaining_size, mock_body_size);
+		if (vb2api_extend_hash(ctx, mock_body, size))
+			break;
+	}
+	TEST_EQ(sd->hash_remaining_size, 0, "tree extend hash");
+	TEST_EQ(digest_finalize_calls, 3, "  chunks finalized");
+	TEST_SUCC(vb2api_check_hash(ctx), "tree check hash");
+	TEST_EQ(digest_finalize_calls, 4, "  root finalized");
+
+	/* Body smaller than one chunk */
+	reset_common_data(FOR_MISC);
+	pre = vb2_member_of(sd, sd->preamble_offset);
+	pre->flags |= VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH;
+	TEST_SUCC(vb2api_init_hash(ctx, VB2_HASH_TAG_FW_BODY),
+		  "tree init hash short");
+	TEST_SUCC(vb2api_extend_hash(ctx, mock_body, mock_body_size),
+		  "tree extend hash short");
+	TEST_EQ(digest_finalize_calls, 1, "  one chunk");
+	TEST_SUCC(vb2api_check_hash(ctx), "tree check hash short");
+
+	/* Chunk digests passed in by the caller */
+	reset_common_data(FOR_MISC);
+	TEST_EQ(vb2api_init_hash(ctx, VB2_HASH_TAG_FW_BODY_TREE),
+		VB2_ERROR_API_INIT_HASH_TAG, "tree tag needs preamble flag");
+
+	reset_common_data(FOR_MISC);
+	TEST_EQ(vb2api_get_hash_alg(ctx), VB2_HASH_INVALID,
+		"hash alg before init");
+	pre = vb2_member_of(sd, sd->preamble_offset);
+	pre->flags |= VB2_FIRMWARE_PREAMBLE_BODY_TREE_HASH;
+	pre->body_signature.data_size = body_size;
+	TEST_SUCC(vb2api_init_hash(ctx, VB2_HASH_TAG_FW_BODY_TREE),
+		  "tree tag init hash");
+	TEST_EQ(sd->hash_size, sizeof(struct vb2_digest_context),
+		"  hash context size");
+	TEST_EQ(sd->hash_remaining_size, 3 * sizeof(chunk_digest),
+		"  hash remaining");
+	TEST_EQ(vb2api_get_hash_alg(ctx), mock_hash_alg, "  hash alg");
+	TEST_EQ(vb2api_extend_hash(ctx, mock_body, mock_body_size),
+		VB2_ERROR_API_EXTEND_HASH_TAG, "  extend hash with data");
+	TEST_EQ(vb2api_extend_hash_chunk_digest(ctx, chunk_digest,
+						sizeof(chunk_digest) - 1),
+		VB2_ERROR_API_EXTEND_HASH_DIGEST_SIZE, "  digest size");
+	TEST_SUCC(vb2api_extend_hash_chunk_digest(ctx, chunk_digest,
+						  sizeof(chunk_digest)),
+		  "  chunk 0");
+	TEST_SUCC(vb2api_extend_hash_chunk_digest(ctx, chunk_digest,
+						  sizeof(chunk_digest)),
+		  "  chunk 1");
+	TEST_EQ(vb2api_check_hash(ctx), VB2_ERROR_API_CHECK_HASH_SIZE,
+		"  check hash missing chunk");
+	TEST_SUCC(vb2api_extend_hash_chunk_digest(ctx, chunk_digest,
+						  sizeof(chunk_digest)),
+		  "  chunk 2");
+	TEST_EQ(vb2api_extend_hash_chunk_digest(ctx, chunk_digest,
+						sizeof(chunk_digest)),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "  too many chunks");
+	TEST_SUCC(vb2api_check_hash(ctx), "  check hash");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_EQ(vb2api_extend_hash_chunk_digest(ctx, chunk_digest,
+						sizeof(chunk_digest)),
+		VB2_ERROR_API_EXTEND_HASH_TAG, "chunk digest needs tree tag");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	sd->hash_size = 0;
+	TEST_EQ(vb2api_extend_hash_chunk_digest(ctx, chunk_digest,
+						sizeof(chunk_digest)),
+		VB2_ERROR_API_EXTEND_HASH_WORKBUF, "chunk digest no workbuf");
+}
+
 int main(int argc, char* argv[])
 {
 	misc_tests();
 	phase1_tests();
 	phase2_tests();
+	prepare_other_slot_tests();
 	phase3_tests();
 
 	fprintf(stderr, "Running hash API tests without hwcrypto support...\n");
 	hwcrypto_state = HWCRYPTO_DISABLED;
 	init_hash_tests();
 	extend_hash_tests();
+	extend_hash_mapped_tests();
+	extend_hash_async_tests();
 	check_hash_tests();
 
 	fprintf(stderr, "Running hash API tests with hwcrypto support...\n");
 	hwcrypto_state = HWCRYPTO_ENABLED;
 	init_hash_tests();
 	extend_hash_tests();
+	extend_hash_mapped_tests();
+	extend_hash_async_tests();
 	check_hash_tests();
 
 	fprintf(stderr, "Running hash API tests with forbidden hwcrypto...\n");
 	hwcrypto_state = HWCRYPTO_FORBIDDEN;
 	init_hash_tests();
 	extend_hash_tests();
+	extend_hash_mapped_tests();
+	extend_hash_async_tests();
 	check_hash_tests();
+	tree_hash_tests();
 
 	get_pcr_digest_tests();
+	get_pcr_events_tests();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -38,6 +38,19 @@ static enum vb2_auxfw_update_severity auxfw_update_severity;
 static int auxfw_protected;
 static vb2_error_t auxfw_done_retval;
 
+/* Devices which can be updated on their own; none means unsupported */
+static struct vb2_auxfw_device mock_devices[4];
+static uint32_t mock_device_count;
+/* Polls each device takes to update, and how many it has had */
+static int device_polls_needed[4];
+static int device_polls[4];
+static int device_started[4];
+static vb2_error_t device_start_retval[4];
+static vb2_error_t device_poll_retval[4];
+static int devices_updating;
+static int max_devices_updating;
+static int bus_conflicts;
+
 /* Reset mock data (for use before each test) */
 static void ResetMocks(void)
 {
@@ -61,6 +74,33 @@ static void ResetMocks(void)
 	auxfw_update_req = 0;
 	auxfw_protected = 0;
 	auxfw_done_retval = VB2_SUCCESS;
+
+	memset(mock_devices, 0, sizeof(mock_devices));
+	mock_device_count = 0;
+	memset(device_polls_needed, 0, sizeof(device_polls_needed));
+	memset(device_polls, 0, sizeof(device_polls));
+	memset(device_started, 0, sizeof(device_started));
+	memset(device_start_retval, 0, sizeof(device_start_retval));
+	memset(device_poll_retval, 0, sizeof(device_poll_retval));
+	devices_updating = 0;
+	max_devices_updating = 0;
+	bus_conflicts = 0;
+}
+
+/* Set up four slow devices, two on bus 0 and one each on buses 1 and 2 */
+static void ResetDeviceMocks(void)
+{
+	static const uint32_t buses[] = {0, 1, 0, 2};
+	int i;
+
+	ResetMocks();
+	auxfw_mock_severity = VB_AUX_FW_SLOW_UPDATE;
+	mock_device_count = ARRAY_SIZE(mock_devices);
+	for (i = 0; i < ARRAY_SIZE(mock_devices); i++) {
+		mock_devices[i].bus = buses[i];
+		mock_devices[i].severity = VB_AUX_FW_SLOW_UPDATE;
+		device_polls_needed[i] = 3;
+	}
 }
 
 /* Mock functions */
@@ -93,6 +133,46 @@ vb2_error_t vb2ex_auxfw_update(void)
 	return auxfw_retval;
 }
 
+vb2_error_t vb2ex_auxfw_get_devices(struct vb2_auxfw_device *devices,
+				    uint32_t *count)
+{
+	if (!mock_device_count)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+
+	memcpy(devices, mock_devices, mock_device_count * sizeof(*devices));
+	*count = mock_device_count;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_auxfw_update_start(uint32_t device)
+{
+	int i;
+
+	if (device_start_retval[device])
+		return device_start_retval[device];
+
+	for (i = 0; i < mock_device_count; i++) {
+		if (device_started[i] && device_polls[i] < device_polls_needed[i]
+		    && mock_devices[i].bus == mock_devices[device].bus)
+			bus_conflicts++;
+	}
+
+	device_started[device]++;
+	devices_updating++;
+	if (devices_updating > max_devices_updating)
+		max_devices_updating = devices_updating;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_auxfw_update_poll(uint32_t device)
+{
+	if (++device_polls[device] < device_polls_needed[device])
+		return VB2_ERROR_EX_AUXFW_BUSY;
+
+	devices_updating--;
+	return device_poll_retval[device];
+}
+
 vb2_error_t vb2ex_auxfw_finalize(struct vb2_context *c)
 {
 	auxfw_protected = auxfw_update_severity != VB_AUX_FW_NO_DEVICE;
@@ -178,9 +258,62 @@ static void VbSoftwareSyncTest(void)
 		     "Error updating AUX firmware");
 }
 
+static void AuxfwDeviceUpdateTest(void)
+{
+	ResetDeviceMocks();
+	test_auxsync(VBERROR_EC_REBOOT_TO_RO_REQUIRED, 0,
+		     "Update devices separately");
+	TEST_EQ(auxfw_update_req, 0, "  whole update skipped");
+	TEST_EQ(device_started[0] + device_started[1] + device_started[2] +
+		device_started[3], 4, "  each device updated once");
+	TEST_EQ(max_devices_updating, 3, "  one device per bus at a time");
+	TEST_EQ(bus_conflicts, 0, "  no bus shared");
+	TEST_EQ(device_polls[2], 3, "  second device on bus waited");
+	TEST_EQ(screens_displayed[0], VB_SCREEN_WAIT, "  wait screen shown");
+
+	ResetDeviceMocks();
+	mock_devices[1].severity = VB_AUX_FW_NO_UPDATE;
+	mock_devices[3].severity = VB_AUX_FW_NO_DEVICE;
+	test_auxsync(VBERROR_EC_REBOOT_TO_RO_REQUIRED, 0,
+		     "Update only devices which need it");
+	TEST_EQ(device_started[1] + device_started[3], 0,
+		"  up to date devices skipped");
+	TEST_EQ(device_started[0] + device_started[2], 2,
+		"  out of date devices updated");
+	TEST_EQ(max_devices_updating, 1, "  shared bus updated in turn");
+
+	ResetDeviceMocks();
+	device_poll_retval[1] = VB2_ERROR_MOCK;
+	device_polls_needed[1] = 1;
+	test_auxsync(VB2_ERROR_MOCK, VB2_RECOVERY_AUX_FW_UPDATE,
+		     "Device update failed");
+	TEST_EQ(device_polls[0], 3, "  update in progress finished");
+	TEST_EQ(device_polls[3], 3, "  other update in progress finished");
+	TEST_EQ(device_started[2], 0, "  no more updates started");
+
+	ResetDeviceMocks();
+	device_start_retval[0] = VB2_ERROR_MOCK;
+	test_auxsync(VB2_ERROR_MOCK, VB2_RECOVERY_AUX_FW_UPDATE,
+		     "Device update failed to start");
+	TEST_EQ(device_started[1] + device_started[2] + device_started[3], 0,
+		"  no more updates started");
+
+	ResetDeviceMocks();
+	device_poll_retval[3] = VBERROR_EC_REBOOT_TO_RO_REQUIRED;
+	test_auxsync(VBERROR_EC_REBOOT_TO_RO_REQUIRED, 0,
+		     "Device needs reboot to update");
+
+	ResetDeviceMocks();
+	mock_device_count = 0;
+	test_auxsync(VBERROR_EC_REBOOT_TO_RO_REQUIRED, 0,
+		     "Update all devices together");
+	TEST_EQ(auxfw_update_req, 1, "  whole update requested");
+}
+
 int main(void)
 {
 	VbSoftwareSyncTest();
+	AuxfwDeviceUpdateTest();
 
 	return gTestSuccess ? 0 : 255;
 }
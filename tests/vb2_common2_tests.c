@@ -136,6 +136,98 @@ static void test_verify_data(const struct vb2_packed_key *key1,
 	free(sig2);
 }
 
+static void test_verify_compact(const struct vb2_packed_key *key1,
+				const struct vb2_signature *sig)
+{
+	uint8_t workbuf[VB2_VERIFY_DATA_WORKBUF_BYTES]
+		 __attribute__((aligned(VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+
+	struct vb2_public_key pubk;
+	uint32_t size = key1->key_offset + key1->key_size;
+	uint32_t sig_total_size = sig->sig_offset + sig->sig_size;
+	uint32_t sig_size;
+	struct vb2_packed_key *key;
+	struct vb2_signature *sig2;
+	uint32_t *n;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+
+	/* A compact key is the full key with rr cut off the end */
+	key = (struct vb2_packed_key *)malloc(size);
+	memcpy(key, key1, size);
+	sig_size = vb2_rsa_sig_size(vb2_crypto_to_signature(key->algorithm));
+	key->key_size = vb2_packed_key_compact_size(
+			vb2_crypto_to_signature(key->algorithm));
+	TEST_EQ(key->key_size, key1->key_size - sig_size,
+		"Compact key size");
+	sig2 = (struct vb2_signature *)malloc(sig_total_size);
+
+	TEST_SUCC(vb2_unpack_key(&pubk, key), "Unpack compact key");
+	TEST_PTR_EQ(pubk.rr, NULL, "  no rr");
+
+	memcpy(sig2, sig, sig_total_size);
+	TEST_SUCC(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		  "Verify compact key");
+
+	memcpy(sig2, sig, sig_total_size);
+	vb2_signature_data_mutable(sig2)[0] ^= 0x5A;
+	TEST_NEQ(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		 0, "Verify compact key wrong sig");
+
+	/* Room for the full key but not to rebuild rr */
+	vb2_workbuf_init(&wb, workbuf,
+			 VB2_RSA_VERIFY_COMPACT_SCRATCH_BYTES(sig_size) -
+			 VB2_WORKBUF_ALIGN);
+	memcpy(sig2, sig, sig_total_size);
+	TEST_EQ(vb2_rsa_verify_digest(&pubk, vb2_signature_data_mutable(sig2),
+				      test_data, &wb),
+		VB2_ERROR_RSA_VERIFY_WORKBUF, "Compact key workbuf too small");
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+
+	/* rr can only be derived if n fills its top word */
+	n = (uint32_t *)pubk.n;
+	n[pubk.arrsize - 1] ^= 0x80000000;
+	memcpy(sig2, sig, sig_total_size);
+	TEST_EQ(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		VB2_ERROR_RSA_VERIFY_KEY, "Compact key short modulus");
+
+	free(sig2);
+	free(key);
+}
+
+static void test_sign_queue(const struct vb2_private_key *private_key,
+			    const struct vb2_signature *sig)
+{
+	struct vb2_sign_request req[9];
+	struct vb2_private_key bad_key = *private_key;
+	uint32_t sig_total_size = sig->sig_offset + sig->sig_size;
+	int i, same = 1;
+
+	memset(req, 0, sizeof(req));
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		req[i].data = test_data;
+		req[i].size = sizeof(test_data);
+		req[i].key = private_key;
+	}
+	bad_key.hash_alg = VB2_HASH_INVALID;
+	req[4].key = &bad_key;
+
+	TEST_EQ(vb2_calculate_signatures(req, ARRAY_SIZE(req), 4), 1,
+		"vb2_calculate_signatures() one failure");
+	TEST_PTR_EQ(req[4].sig, NULL, "  bad key has no signature");
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		if (i == 4)
+			continue;
+		if (!req[i].sig || memcmp(req[i].sig, sig, sig_total_size))
+			same = 0;
+		free(req[i].sig);
+	}
+	TEST_TRUE(same, "  others match vb2_calculate_signature()");
+
+	TEST_EQ(vb2_calculate_signatures(req, 0, 0), 0,
+		"vb2_calculate_signatures() empty");
+}
 
 static int test_algorithm(int key_algorithm, const char *keys_dir)
 {
@@ -176,6 +268,8 @@ static int test_algorithm(int key_algorithm, const char *keys_dir)
 
 	test_unpack_key(key1);
 	test_verify_data(key1, sig);
+	test_verify_compact(key1, sig);
+	test_sign_queue(private_key, sig);
 
 	retval = 0;
 
@@ -507,6 +507,76 @@ static void test_verify_kernel_preamble(
 	free(body_sig);
 }
 
+static void test_create_in_buffer(const struct vb2_private_key *private_key,
+				  const struct vb2_packed_key *data_key)
+{
+	struct vb2_signature *body_sig = vb2_alloc_signature(56, 78);
+	struct vb2_keyblock *kb;
+	struct vb2_fw_preamble *fw;
+	struct vb2_kernel_preamble *kern;
+	uint32_t kb_size, fw_size, kern_size;
+	uint8_t *buf;
+
+	kb = vb2_create_keyblock(data_key, private_key, 0x1234);
+	fw = vb2_create_fw_preamble(0x1234, data_key, body_sig, private_key,
+				    0x5678);
+	kern = vb2_create_kernel_preamble(0x1234, 0x100000, 0x300000, 0x4000,
+					  body_sig, 0x304000, 0x10000, 0,
+					  0x2000, private_key);
+	TEST_TRUE(kb && fw && kern, "create in buffer prereqs");
+	if (!kb || !fw || !kern)
+		goto out;
+
+	kb_size = vb2_keyblock_size(data_key, private_key);
+	fw_size = vb2_fw_preamble_size(data_key, body_sig, private_key);
+	kern_size = vb2_kernel_preamble_size(body_sig, 0x2000, private_key);
+	TEST_EQ(kb_size, kb->keyblock_size, "vb2_keyblock_size()");
+	TEST_EQ(fw_size, fw->preamble_size, "vb2_fw_preamble_size()");
+	TEST_EQ(kern_size, kern->preamble_size,
+		"vb2_kernel_preamble_size()");
+
+	/* Build all three back to back in one (dirty) buffer */
+	buf = malloc(kb_size + fw_size + kern_size);
+	memset(buf, 0xa5, kb_size + fw_size + kern_size);
+	TEST_SUCC(vb2_create_keyblock_in(buf, kb_size, data_key, private_key,
+					 0x1234),
+		  "vb2_create_keyblock_in()");
+	TEST_SUCC(memcmp(buf, kb, kb_size), "  matches vb2_create_keyblock()");
+	TEST_SUCC(vb2_create_fw_preamble_in(buf + kb_size, fw_size, 0x1234,
+					    data_key, body_sig, private_key,
+					    0x5678),
+		  "vb2_create_fw_preamble_in()");
+	TEST_SUCC(memcmp(buf + kb_size, fw, fw_size),
+		  "  matches vb2_create_fw_preamble()");
+	TEST_SUCC(vb2_create_kernel_preamble_in(
+			buf + kb_size + fw_size, kern_size, 0x1234, 0x100000,
+			0x300000, 0x4000, body_sig, 0x304000, 0x10000, 0,
+			0x2000, private_key),
+		  "vb2_create_kernel_preamble_in()");
+	TEST_SUCC(memcmp(buf + kb_size + fw_size, kern, kern_size),
+		  "  matches vb2_create_kernel_preamble()");
+
+	TEST_EQ(vb2_create_keyblock_in(buf, kb_size - 1, data_key,
+				       private_key, 0),
+		VB2_KEYBLOCK_CREATE_BUF_SIZE, "keyblock buffer too small");
+	TEST_EQ(vb2_create_fw_preamble_in(buf, fw_size - 1, 0, data_key,
+					  body_sig, private_key, 0),
+		VB2_FW_PREAMBLE_CREATE_BUF_SIZE,
+		"fw preamble buffer too small");
+	TEST_EQ(vb2_create_kernel_preamble_in(buf, kern_size - 1, 0, 0, 0, 0,
+					      body_sig, 0, 0, 0, 0x2000,
+					      private_key),
+		VB2_KERNEL_PREAMBLE_CREATE_BUF_SIZE,
+		"kernel preamble buffer too small");
+	free(buf);
+
+ out:
+	free(kb);
+	free(fw);
+	free(kern);
+	free(body_sig);
+}
+
 static int test_permutation(int signing_key_algorithm, int data_key_algorithm,
 			    const char *keys_dir)
 {
@@ -574,6 +644,7 @@ static int test_permutation(int signing_key_algorithm, int data_key_algorithm,
 	test_verify_fw_preamble(signing_public_key, signing_private_key,
 				data_public_key);
 	test_verify_kernel_preamble(signing_public_key, signing_private_key);
+	test_create_in_buffer(signing_private_key, data_public_key);
 
 	retval = 0;
 
@@ -0,0 +1,69 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for CRC-8, in whichever form (table or bitwise) it was built.
+ */
+
+#include <stdio.h>
+
+#include "2common.h"
+#include "2crc8.h"
+#include "2sysincludes.h"
+#include "test_common.h"
+
+/* Bit-at-a-time reference for x^8 + x^2 + x + 1, MSB first */
+static uint8_t crc8_reference(const uint8_t *data, uint32_t size)
+{
+	uint8_t crc = 0;
+	int i;
+
+	while (size--) {
+		crc ^= *data++;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+	}
+	return crc;
+}
+
+static void known_value_tests(void)
+{
+	const uint8_t zeroes[16] = {0};
+
+	TEST_EQ(vb2_crc8("123456789", 9), 0xf4, "check value");
+	TEST_EQ(vb2_crc8(zeroes, sizeof(zeroes)), 0, "all zeroes");
+	TEST_EQ(vb2_crc8(zeroes, 0), 0, "empty");
+}
+
+static void reference_tests(void)
+{
+	uint8_t buf[256];
+	uint32_t i;
+	int mismatch = 0;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (uint8_t)(i * 7 + 3);
+
+	for (i = 0; i <= sizeof(buf); i++) {
+		if (vb2_crc8(buf, i) != crc8_reference(buf, i))
+			mismatch++;
+	}
+	TEST_EQ(mismatch, 0, "matches reference for all lengths");
+
+	/* Every single byte value */
+	mismatch = 0;
+	for (i = 0; i < 256; i++) {
+		uint8_t b = i;
+		if (vb2_crc8(&b, 1) != crc8_reference(&b, 1))
+			mismatch++;
+	}
+	TEST_EQ(mismatch, 0, "matches reference for all bytes");
+}
+
+int main(int argc, char *argv[])
+{
+	known_value_tests();
+	reference_tests();
+
+	return gTestSuccess ? 0 : 255;
+}
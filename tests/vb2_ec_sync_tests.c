@@ -32,6 +32,19 @@ static int get_expected_retval;
 static int shutdown_request_calls_left;
 static vb2_error_t ec_vboot_done_retval;
 static int ec_vboot_done_calls;
+static int hash_start_calls;
+static int hash_calls;
+
+/* Block hashes for updating part of an image; no blocks means unsupported */
+#define MOCK_BLOCKS 8
+static uint8_t want_block_hashes[MOCK_BLOCKS][VB2_SHA256_DIGEST_SIZE];
+static uint8_t ec_block_hashes[MOCK_BLOCKS][VB2_SHA256_DIGEST_SIZE];
+static uint32_t mock_block_count;
+static vb2_error_t hash_blocks_retval;
+static vb2_error_t update_blocks_retval;
+static char blocks_updated[64];
+static enum vb2_firmware_selection hash_start_select;
+static vb2_error_t hash_start_retval;
 
 static uint32_t screens_displayed[8];
 static uint32_t screens_count = 0;
@@ -77,6 +90,17 @@ static void ResetMocks(void)
 	shutdown_request_calls_left = -1;
 	ec_vboot_done_retval = VB2_SUCCESS;
 	ec_vboot_done_calls = 0;
+	hash_start_calls = 0;
+	hash_calls = 0;
+
+	memset(want_block_hashes, 0, sizeof(want_block_hashes));
+	memset(ec_block_hashes, 0, sizeof(ec_block_hashes));
+	mock_block_count = 0;
+	hash_blocks_retval = VB2_SUCCESS;
+	update_blocks_retval = VB2_SUCCESS;
+	blocks_updated[0] = '\0';
+	hash_start_select = VB_SELECT_FIRMWARE_COUNT;
+	hash_start_retval = VB2_SUCCESS;
 
 	memset(mock_ec_ro_hash, 0, sizeof(mock_ec_ro_hash));
 	mock_ec_ro_hash[0] = 42;
@@ -149,9 +173,17 @@ vb2_error_t vb2ex_ec_jump_to_rw(void)
 	return jump_retval;
 }
 
+vb2_error_t vb2ex_ec_hash_image_start(enum vb2_firmware_selection select)
+{
+	hash_start_calls++;
+	hash_start_select = select;
+	return hash_start_retval;
+}
+
 vb2_error_t vb2ex_ec_hash_image(enum vb2_firmware_selection select,
 				const uint8_t **hash, int *hash_size)
 {
+	hash_calls++;
 	*hash = select == VB_SELECT_FIRMWARE_READONLY ?
 		mock_ec_ro_hash : mock_ec_rw_hash;
 	*hash_size = select == VB_SELECT_FIRMWARE_READONLY ?
@@ -183,6 +215,42 @@ vb2_error_t vb2ex_ec_update_image(enum vb2_firmware_selection select)
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2ex_ec_get_expected_block_hashes(
+	enum vb2_firmware_selection select, const uint8_t **hashes,
+	uint32_t *count)
+{
+	if (!mock_block_count)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+
+	*hashes = want_block_hashes[0];
+	*count = mock_block_count;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_ec_hash_blocks(enum vb2_firmware_selection select,
+				 uint8_t *hashes, uint32_t count)
+{
+	memcpy(hashes, ec_block_hashes, count * VB2_SHA256_DIGEST_SIZE);
+	return hash_blocks_retval;
+}
+
+vb2_error_t vb2ex_ec_update_blocks(enum vb2_firmware_selection select,
+				   uint32_t first, uint32_t count)
+{
+	if (update_blocks_retval)
+		return update_blocks_retval;
+
+	sprintf(blocks_updated + strlen(blocks_updated), "%u+%u ", first,
+		count);
+	memcpy(ec_block_hashes[first], want_block_hashes[first],
+	       count * VB2_SHA256_DIGEST_SIZE);
+	if (select == VB_SELECT_FIRMWARE_READONLY)
+		mock_ec_ro_hash[0] = update_hash;
+	else
+		mock_ec_rw_hash[0] = update_hash;
+	return VB2_SUCCESS;
+}
+
 vb2_error_t VbDisplayScreen(struct vb2_context *c, uint32_t screen, int force,
 			    const VbScreenData *data)
 {
@@ -378,16 +446,25 @@ static void VbSoftwareSyncTest(void)
 	TEST_EQ(ec_rw_protected, 1, "  ec rw protected");
 	TEST_EQ(ec_run_image, 1, "  ec run image");
 
+	/* An EC which verifies its updates isn't asked to hash them again */
 	ResetMocks();
 	mock_ec_rw_hash[0]++;
-	update_hash++;
-	test_ssync(VBERROR_EC_REBOOT_TO_RO_REQUIRED,
-		   VB2_RECOVERY_EC_UPDATE, "Updated hash mismatch");
-	TEST_EQ(ec_ro_updated, 0, "  ec ro updated");
+	test_ssync(0, 0, "Hash after update");
 	TEST_EQ(ec_rw_updated, 1, "  ec rw updated");
-	TEST_EQ(ec_ro_protected, 0, "  ec ro protected");
-	TEST_EQ(ec_rw_protected, 0, "  ec rw protected");
-	TEST_EQ(ec_run_image, 0, "  ec run image");
+	TEST_EQ(hash_calls, EC_VERIFIED_UPDATE ? 1 : 2, "  hash calls");
+
+	if (!EC_VERIFIED_UPDATE) {
+		ResetMocks();
+		mock_ec_rw_hash[0]++;
+		update_hash++;
+		test_ssync(VBERROR_EC_REBOOT_TO_RO_REQUIRED,
+			   VB2_RECOVERY_EC_UPDATE, "Updated hash mismatch");
+		TEST_EQ(ec_ro_updated, 0, "  ec ro updated");
+		TEST_EQ(ec_rw_updated, 1, "  ec rw updated");
+		TEST_EQ(ec_ro_protected, 0, "  ec ro protected");
+		TEST_EQ(ec_rw_protected, 0, "  ec rw protected");
+		TEST_EQ(ec_run_image, 0, "  ec run image");
+	}
 
 	ResetMocks();
 	mock_ec_rw_hash[0]++;
@@ -542,9 +619,108 @@ static void VbSoftwareSyncTest(void)
 	TEST_EQ(ec_run_image, 0, "ec run image");
 }
 
+/* Set up an RW image with blocks 2, 3 and 6 out of date */
+static void ResetBlockMocks(void)
+{
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	mock_block_count = MOCK_BLOCKS;
+	want_block_hashes[2][0] = 1;
+	want_block_hashes[3][0] = 1;
+	want_block_hashes[6][0] = 1;
+}
+
+static void EcBlockUpdateTest(void)
+{
+	ResetBlockMocks();
+	test_ssync(0, 0, "Update changed blocks");
+	TEST_STR_EQ(blocks_updated, "2+2 6+1 ", "  blocks written");
+	TEST_EQ(ec_rw_updated, 0, "  whole image not rewritten");
+	TEST_EQ(hash_calls, 2, "  image hashed after update");
+	TEST_EQ(ec_rw_protected, 1, "  ec rw protected");
+
+	ResetBlockMocks();
+	want_block_hashes[0][0] = 1;
+	want_block_hashes[7][0] = 1;
+	test_ssync(0, 0, "Update first and last blocks");
+	TEST_STR_EQ(blocks_updated, "0+1 2+2 6+2 ", "  blocks written");
+
+	ResetBlockMocks();
+	update_hash++;
+	test_ssync(VBERROR_EC_REBOOT_TO_RO_REQUIRED, VB2_RECOVERY_EC_UPDATE,
+		   "Block update hash mismatch");
+
+	ResetBlockMocks();
+	update_blocks_retval = VB2_ERROR_MOCK;
+	test_ssync(VBERROR_EC_REBOOT_TO_RO_REQUIRED, VB2_RECOVERY_EC_UPDATE,
+		   "Block update failed");
+	TEST_EQ(ec_rw_updated, 0, "  whole image not rewritten");
+
+	ResetBlockMocks();
+	update_blocks_retval = VBERROR_EC_REBOOT_TO_RO_REQUIRED;
+	test_ssync(VBERROR_EC_REBOOT_TO_RO_REQUIRED, 0,
+		   "Reboot for block update");
+
+	/* Otherwise the whole image is rewritten */
+	ResetBlockMocks();
+	update_blocks_retval = VB2_ERROR_EX_UNIMPLEMENTED;
+	test_ssync(0, 0, "Block update unsupported");
+	TEST_EQ(ec_rw_updated, 1, "  whole image rewritten");
+
+	ResetBlockMocks();
+	hash_blocks_retval = VB2_ERROR_MOCK;
+	test_ssync(0, 0, "Block hashes unavailable");
+	TEST_STR_EQ(blocks_updated, "", "  no blocks written");
+	TEST_EQ(ec_rw_updated, 1, "  whole image rewritten");
+
+	ResetBlockMocks();
+	memset(want_block_hashes, 0, sizeof(want_block_hashes));
+	test_ssync(0, 0, "No blocks differ");
+	TEST_STR_EQ(blocks_updated, "", "  no blocks written");
+	TEST_EQ(ec_rw_updated, 1, "  whole image rewritten");
+}
+
+static void EcHashStartTest(void)
+{
+	ResetMocks();
+	vb2api_ec_sync_start(ctx);
+	TEST_EQ(hash_start_calls, 1, "Start EC hash");
+	TEST_EQ(hash_start_select, VB_SELECT_FIRMWARE_EC_ACTIVE, "  active RW");
+	test_ssync(VB2_SUCCESS, 0, "  then sync");
+
+	ResetMocks();
+	hash_start_retval = VB2_ERROR_MOCK;
+	vb2api_ec_sync_start(ctx);
+	test_ssync(VB2_SUCCESS, 0, "Sync after EC hash failed to start");
+	TEST_NEQ(sd->flags & VB2_SD_STATUS_EC_SYNC_COMPLETE, 0,
+		 "  EC sync complete");
+
+	ResetMocks();
+	sd->flags |= VB2_SD_STATUS_EC_SYNC_COMPLETE;
+	vb2api_ec_sync_start(ctx);
+	TEST_EQ(hash_start_calls, 0, "No EC hash after sync complete");
+
+	ResetMocks();
+	ctx->flags &= ~VB2_CONTEXT_EC_SYNC_SUPPORTED;
+	vb2api_ec_sync_start(ctx);
+	TEST_EQ(hash_start_calls, 0, "No EC hash if sync not supported");
+
+	ResetMocks();
+	gbb.flags |= VB2_GBB_FLAG_DISABLE_EC_SOFTWARE_SYNC;
+	vb2api_ec_sync_start(ctx);
+	TEST_EQ(hash_start_calls, 0, "No EC hash if sync disabled by GBB");
+
+	ResetMocks();
+	ctx->flags |= VB2_CONTEXT_RECOVERY_MODE;
+	vb2api_ec_sync_start(ctx);
+	TEST_EQ(hash_start_calls, 0, "No EC hash in recovery mode");
+}
+
 int main(void)
 {
 	VbSoftwareSyncTest();
+	EcBlockUpdateTest();
+	EcHashStartTest();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -0,0 +1,208 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for ECDSA P-256 signature verification.
+ */
+
+#include "2common.h"
+#include "2ecdsa.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "2sysincludes.h"
+#include "test_common.h"
+
+/*
+ * Test vectors made with:
+ *   openssl ecparam -name prime256v1 -genkey -noout -out key.pem
+ *   openssl dgst -sha256 -sign key.pem (and -sha512) on test_message
+ */
+static const char test_message[] = "vboot ECDSA test message";
+
+static const uint32_t test_key_x[VB2_P256_WORDS] = {
+	0x43cc2d59, 0x1ffb43ce, 0xda2f0b4e, 0x0072752a,
+	0x2d80366c, 0x310b7831, 0x7f2e855b, 0x29de91d5
+};
+
+static const uint32_t test_key_y[VB2_P256_WORDS] = {
+	0x8b195443, 0x14e68c88, 0x5a3e9b2e, 0xcaf72123,
+	0x38984924, 0x7907621e, 0x7b664dcb, 0xffb07856
+};
+
+static const uint8_t test_sig_sha256[2 * VB2_P256_BYTES] = {
+	0x43, 0x13, 0x86, 0x2c, 0xe1, 0xe3, 0x5d, 0x56,
+	0xac, 0xf7, 0x9d, 0x75, 0xbc, 0xcc, 0x06, 0x48,
+	0xc5, 0x26, 0x27, 0x64, 0x62, 0x6d, 0xfa, 0x02,
+	0xec, 0x56, 0x56, 0x86, 0x98, 0x0e, 0x6e, 0x9a,
+	0xd4, 0x43, 0xfa, 0x6e, 0x67, 0x96, 0x8d, 0x5a,
+	0x94, 0xe4, 0xd6, 0xe3, 0x67, 0x53, 0xb6, 0x0b,
+	0x70, 0xa5, 0x99, 0x38, 0x73, 0x03, 0x52, 0x10,
+	0x1a, 0xe7, 0xe6, 0x56, 0xe8, 0xd3, 0xa5, 0xef,
+};
+
+static const uint8_t test_sig_sha512[2 * VB2_P256_BYTES] = {
+	0x6e, 0xd5, 0x20, 0x5e, 0xcb, 0x09, 0xd1, 0x7d,
+	0x5a, 0x9d, 0xb9, 0xa0, 0xbe, 0xae, 0x11, 0x78,
+	0x0e, 0xa2, 0x5c, 0xb2, 0x04, 0x7b, 0xe6, 0x1c,
+	0x76, 0xf3, 0xb7, 0x31, 0xba, 0x26, 0x9f, 0x80,
+	0xed, 0x6a, 0xf9, 0x8c, 0x98, 0xa5, 0x14, 0xa4,
+	0x40, 0xbe, 0x0c, 0x75, 0xd9, 0xf6, 0x4b, 0xa4,
+	0x5a, 0x42, 0xff, 0x32, 0x61, 0x57, 0x51, 0x5b,
+	0xb8, 0x19, 0x3c, 0xf6, 0x18, 0xcb, 0x94, 0x00,
+};
+
+/* Group order n, big endian */
+static const uint8_t p256_order[VB2_P256_BYTES] = {
+	0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84,
+	0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51,
+};
+
+static void init_key(struct vb2_public_key *key, uint32_t *x, uint32_t *y,
+		     enum vb2_hash_algorithm hash_alg)
+{
+	memcpy(x, test_key_x, sizeof(test_key_x));
+	memcpy(y, test_key_y, sizeof(test_key_y));
+
+	memset(key, 0, sizeof(*key));
+	key->arrsize = VB2_P256_WORDS;
+	key->n = x;
+	key->rr = y;
+	key->sig_alg = VB2_SIG_ECDSA_P256;
+	key->hash_alg = hash_alg;
+}
+
+static void digest_message(enum vb2_hash_algorithm hash_alg, uint8_t *digest)
+{
+	vb2_digest_buffer((const uint8_t *)test_message,
+			  strlen(test_message), hash_alg, digest,
+			  vb2_digest_size(hash_alg));
+}
+
+static void test_sizes(void)
+{
+	TEST_EQ(vb2_ecdsa_sig_size(VB2_SIG_ECDSA_P256), 64, "Sig size P-256");
+	TEST_EQ(vb2_ecdsa_sig_size(VB2_SIG_RSA2048), 0, "Sig size RSA");
+	TEST_EQ(vb2_rsa_sig_size(VB2_SIG_ECDSA_P256), 0, "RSA sig size P-256");
+	TEST_EQ(vb2_packed_key_size(VB2_SIG_ECDSA_P256), 72,
+		"Packed key size P-256");
+}
+
+static void test_verify(void)
+{
+	struct vb2_public_key key;
+	uint32_t x[VB2_P256_WORDS], y[VB2_P256_WORDS];
+	uint8_t digest[VB2_SHA512_DIGEST_SIZE];
+	uint8_t sig[2 * VB2_P256_BYTES];
+
+	init_key(&key, x, y, VB2_HASH_SHA256);
+	digest_message(VB2_HASH_SHA256, digest);
+	memcpy(sig, test_sig_sha256, sizeof(sig));
+	TEST_SUCC(vb2_ecdsa_verify_digest(&key, sig, digest), "Verify good");
+	TEST_SUCC(memcmp(sig, test_sig_sha256, sizeof(sig)),
+		  "  sig unmodified");
+
+	/* Digests longer than the curve are truncated */
+	init_key(&key, x, y, VB2_HASH_SHA512);
+	digest_message(VB2_HASH_SHA512, digest);
+	TEST_SUCC(vb2_ecdsa_verify_digest(&key, test_sig_sha512, digest),
+		  "Verify good SHA-512");
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, test_sig_sha256, digest),
+		VB2_ERROR_ECDSA_VERIFY_DIGEST, "Verify wrong hash sig");
+
+	/* Only the leftmost 256 bits of a SHA-512 digest count */
+	digest[VB2_SHA512_DIGEST_SIZE - 1] ^= 0x01;
+	TEST_SUCC(vb2_ecdsa_verify_digest(&key, test_sig_sha512, digest),
+		  "Verify ignores digest tail");
+	digest[0] ^= 0x01;
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, test_sig_sha512, digest),
+		VB2_ERROR_ECDSA_VERIFY_DIGEST, "Verify bad digest head");
+
+	init_key(&key, x, y, VB2_HASH_SHA256);
+	digest_message(VB2_HASH_SHA256, digest);
+	digest[5] ^= 0x20;
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, test_sig_sha256, digest),
+		VB2_ERROR_ECDSA_VERIFY_DIGEST, "Verify bad digest");
+	digest[5] ^= 0x20;
+
+	/* Corrupt r and s */
+	memcpy(sig, test_sig_sha256, sizeof(sig));
+	sig[3] ^= 0x42;
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, sig, digest),
+		VB2_ERROR_ECDSA_VERIFY_DIGEST, "Verify bad r");
+
+	memcpy(sig, test_sig_sha256, sizeof(sig));
+	sig[sizeof(sig) - 3] ^= 0x56;
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, sig, digest),
+		VB2_ERROR_ECDSA_VERIFY_DIGEST, "Verify bad s");
+
+	/* Corrupt the key */
+	x[2] ^= 1;
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, test_sig_sha256, digest),
+		VB2_ERROR_ECDSA_VERIFY_KEY, "Verify key off curve");
+}
+
+static void test_verify_errors(void)
+{
+	struct vb2_public_key key;
+	uint32_t x[VB2_P256_WORDS], y[VB2_P256_WORDS];
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	uint8_t sig[2 * VB2_P256_BYTES];
+
+	init_key(&key, x, y, VB2_HASH_SHA256);
+	digest_message(VB2_HASH_SHA256, digest);
+
+	TEST_EQ(vb2_ecdsa_verify_digest(NULL, test_sig_sha256, digest),
+		VB2_ERROR_ECDSA_VERIFY_PARAM, "Verify null key");
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, NULL, digest),
+		VB2_ERROR_ECDSA_VERIFY_PARAM, "Verify null sig");
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, test_sig_sha256, NULL),
+		VB2_ERROR_ECDSA_VERIFY_PARAM, "Verify null digest");
+
+	key.sig_alg = VB2_SIG_RSA2048;
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, test_sig_sha256, digest),
+		VB2_ERROR_ECDSA_VERIFY_ALGORITHM, "Verify RSA key");
+	key.sig_alg = VB2_SIG_ECDSA_P256;
+
+	key.hash_alg = VB2_HASH_INVALID;
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, test_sig_sha256, digest),
+		VB2_ERROR_ECDSA_VERIFY_ALGORITHM, "Verify bad hash alg");
+	key.hash_alg = VB2_HASH_SHA256;
+
+	key.arrsize--;
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, test_sig_sha256, digest),
+		VB2_ERROR_ECDSA_VERIFY_ALGORITHM, "Verify bad arrsize");
+	key.arrsize++;
+
+	/* r and s must be in [1, n - 1] */
+	memcpy(sig, test_sig_sha256, sizeof(sig));
+	memset(sig, 0, VB2_P256_BYTES);
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, sig, digest),
+		VB2_ERROR_ECDSA_VERIFY_SIG, "Verify r = 0");
+	memcpy(sig, p256_order, VB2_P256_BYTES);
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, sig, digest),
+		VB2_ERROR_ECDSA_VERIFY_SIG, "Verify r = n");
+
+	memcpy(sig, test_sig_sha256, sizeof(sig));
+	memset(sig + VB2_P256_BYTES, 0, VB2_P256_BYTES);
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, sig, digest),
+		VB2_ERROR_ECDSA_VERIFY_SIG, "Verify s = 0");
+	memset(sig + VB2_P256_BYTES, 0xff, VB2_P256_BYTES);
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, sig, digest),
+		VB2_ERROR_ECDSA_VERIFY_SIG, "Verify s > n");
+
+	/* Key coordinates must be below p */
+	memset(y, 0xff, sizeof(y));
+	TEST_EQ(vb2_ecdsa_verify_digest(&key, test_sig_sha256, digest),
+		VB2_ERROR_ECDSA_VERIFY_KEY, "Verify key y > p");
+}
+
+int main(int argc, char* argv[])
+{
+	test_sizes();
+	test_verify();
+	test_verify_errors();
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -17,6 +17,7 @@ static struct vb2_context *ctx;
 static struct vb2_workbuf wb;
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE]
 	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+static int mock_read_count;
 
 static void set_gbb_hwid(const char *hwid, size_t size)
 {
@@ -52,6 +53,7 @@ static void reset_common_data(void)
 	TEST_SUCC(vb2api_init(workbuf, sizeof(workbuf), &ctx),
 		  "vb2api_init failed");
 	vb2_workbuf_from_ctx(ctx, &wb);
+	mock_read_count = 0;
 }
 
 /* Mocks */
@@ -67,6 +69,8 @@ vb2_error_t vb2ex_read_resource(struct vb2_context *c,
 	uint8_t *rptr;
 	uint32_t rsize;
 
+	mock_read_count++;
+
 	switch(index) {
 	case VB2_RES_GBB:
 		rptr = (uint8_t *)&gbb_data;
@@ -201,6 +205,23 @@ static void key_tests(void)
 		0, "  copied key data successfully");
 	TEST_EQ(size, rootkey->key_offset + rootkey->key_size,
 		"  correct size returned");
+	TEST_EQ(mock_read_count, 1, "  read in one piece");
+
+	/* Key area too big for the workbuf, but the key itself fits */
+	reset_common_data();
+	wborig = wb;
+	rootkey->key_size = sizeof(key_data);
+	memcpy((void *)rootkey + rootkey->key_offset,
+	       key_data, sizeof(key_data));
+	gbb->rootkey_size = rootkey->key_offset + rootkey->key_size + 64;
+	wb.size = gbb->rootkey_size - 1;
+	TEST_SUCC(vb2_gbb_read_root_key(ctx, &keyp, &size, &wb),
+		  "succeeds when padded gbb.rootkey doesn't fit workbuf");
+	TEST_EQ(memcmp(rootkey, keyp, rootkey->key_offset + rootkey->key_size),
+		0, "  copied key data successfully");
+	TEST_EQ(size, rootkey->key_offset + rootkey->key_size,
+		"  correct size returned");
+	TEST_EQ(mock_read_count, 2, "  read header first");
 
 	/* gbb.size > sizeof(vb2_packed_key) + packed_key.size
 	   packed_key.offset = +0 */
@@ -5,8 +5,14 @@
  * Tests for host library vboot2 key functions
  */
 
+#include <openssl/rsa.h>
+
+#include <unistd.h>
+
 #include "2common.h"
 #include "host_common.h"
+#include "host_key21.h"
+#include "host_misc.h"
 #include "test_common.h"
 
 /* Public key utility functions */
@@ -60,9 +66,165 @@ static void public_key_tests(void)
 		"vb2_copy_packed_key data");
 }
 
+/* PKCS#11 key names which can't be opened */
+static void pkcs11_key_tests(void)
+{
+	TEST_PTR_EQ(vb2_read_private_key("pkcs11:"), NULL,
+		    "pkcs11 empty");
+	TEST_PTR_EQ(vb2_read_private_key("pkcs11:mod.so:0:key"), NULL,
+		    "pkcs11 no algorithm");
+	TEST_PTR_EQ(vb2_read_private_key("pkcs11:mod.so:0:key:x"), NULL,
+		    "pkcs11 bad algorithm");
+	TEST_PTR_EQ(vb2_read_private_key("pkcs11:0:key:4"), NULL,
+		    "pkcs11 no module");
+	TEST_PTR_EQ(vb2_read_private_key("pkcs11:mod.so:x:key:4"), NULL,
+		    "pkcs11 bad slot");
+	TEST_PTR_EQ(vb2_read_private_key_pkcs11("mod.so:0:key",
+						VB2_ALG_COUNT), NULL,
+		    "pkcs11 invalid algorithm");
+	TEST_PTR_EQ(vb2_read_private_key_pkcs11("/nonexistent.so:0:key", 4),
+		    NULL, "pkcs11 missing module");
+}
+
+/* Private keys are parsed once and shared */
+static void key_cache_tests(const char *keys_dir, const char *temp_dir)
+{
+	struct vb2_private_key *k1, *k2, *k3, *k4;
+	char *pemfile, *privfile, *copyfile;
+	uint8_t *buf;
+	uint32_t size;
+
+	xasprintf(&pemfile, "%s/key_rsa2048.pem", keys_dir);
+	xasprintf(&privfile, "%s/key_rsa2048.sha256.vbprivk", keys_dir);
+	xasprintf(&copyfile, "%s/key_cache_tests.vbprivk", temp_dir);
+
+	k1 = vb2_read_private_key_pem(pemfile, VB2_ALG_RSA2048_SHA256);
+	k2 = vb2_read_private_key_pem(pemfile, VB2_ALG_RSA2048_SHA512);
+	TEST_PTR_NEQ(k1, NULL, "Read pem key");
+	TEST_PTR_NEQ(k2, NULL, "Read pem key again");
+	TEST_PTR_EQ(k1->rsa_private_key, k2->rsa_private_key,
+		    "  shares the parsed key");
+	TEST_EQ(k2->hash_alg, VB2_HASH_SHA512, "  with its own algorithm");
+	vb2_free_private_key(k1);
+	vb2_free_private_key(k2);
+
+	/* A .vbprivk copied elsewhere is recognized by its contents */
+	TEST_SUCC(vb2_read_file(privfile, &buf, &size), "Read vbprivk file");
+	TEST_SUCC(vb2_write_file(copyfile, buf, size), "Copy vbprivk file");
+	k1 = vb2_read_private_key(privfile);
+	k2 = vb2_read_private_key(copyfile);
+	TEST_PTR_NEQ(k1, NULL, "Read vbprivk");
+	TEST_PTR_NEQ(k2, NULL, "Read copied vbprivk");
+	TEST_PTR_EQ(k1->rsa_private_key, k2->rsa_private_key,
+		    "  shares the parsed key");
+	TEST_EQ(k2->hash_alg, VB2_HASH_SHA256, "  hash_alg");
+	TEST_EQ(k2->sig_alg, VB2_SIG_RSA2048, "  sig_alg");
+
+	/* Rewriting the copy with another key isn't missed */
+	free(buf);
+	free(privfile);
+	xasprintf(&privfile, "%s/key_rsa4096.sha512.vbprivk", keys_dir);
+	TEST_SUCC(vb2_read_file(privfile, &buf, &size), "Read other vbprivk");
+	TEST_SUCC(vb2_write_file(copyfile, buf, size), "Rewrite copy");
+	k3 = vb2_read_private_key(copyfile);
+	TEST_PTR_NEQ(k3, NULL, "Read rewritten vbprivk");
+	TEST_PTR_NEQ(k3->rsa_private_key, k1->rsa_private_key,
+		     "  gets the new key");
+	TEST_EQ(k3->sig_alg, VB2_SIG_RSA4096, "  sig_alg");
+
+	/* Flushing doesn't affect keys in use */
+	vb2_flush_private_key_cache();
+	k4 = vb2_read_private_key(copyfile);
+	TEST_PTR_NEQ(k4, NULL, "Read after flush");
+	TEST_PTR_NEQ(k4->rsa_private_key, k3->rsa_private_key,
+		     "  parses it again");
+	TEST_EQ(RSA_size(k3->rsa_private_key), RSA_size(k4->rsa_private_key),
+		"  old key still valid");
+
+	vb2_free_private_key(k1);
+	vb2_free_private_key(k2);
+	vb2_free_private_key(k3);
+	vb2_free_private_key(k4);
+	free(buf);
+	unlink(copyfile);
+}
+
+/* Keys without CRT parameters get them back when loaded */
+static void crt_params_tests(const char *keys_dir, const char *temp_dir)
+{
+	struct vb2_private_key *full, *stripped;
+	const BIGNUM *p, *q, *dmp1, *dmq1, *iqmp;
+	const BIGNUM *p2, *q2, *dmp2, *dmq2, *iqmp2;
+	char *privfile, *strippedfile;
+	uint8_t data[] = "crt_params_tests";
+	struct vb2_signature *sig1, *sig2;
+	RSA *rsa;
+
+	xasprintf(&privfile, "%s/key_rsa2048.sha256.vbprivk", keys_dir);
+	xasprintf(&strippedfile, "%s/crt_params_tests.vbprivk", temp_dir);
+
+	full = vb2_read_private_key(privfile);
+	TEST_PTR_NEQ(full, NULL, "Read vbprivk");
+	if (!full)
+		return;
+
+	/* Write a copy with only n, e and d */
+	rsa = RSAPrivateKey_dup(full->rsa_private_key);
+	RSA_set0_factors(rsa, BN_new(), BN_new());
+	RSA_set0_crt_params(rsa, BN_new(), BN_new(), BN_new());
+	stripped = calloc(1, sizeof(*stripped));
+	stripped->rsa_private_key = rsa;
+	stripped->hash_alg = full->hash_alg;
+	stripped->sig_alg = full->sig_alg;
+	TEST_SUCC(vb2_write_private_key(strippedfile, stripped),
+		  "Write key without CRT parameters");
+	vb2_free_private_key(stripped);
+
+	stripped = vb2_read_private_key(strippedfile);
+	TEST_PTR_NEQ(stripped, NULL, "Read key without CRT parameters");
+	if (!stripped)
+		goto out;
+
+	RSA_get0_factors(full->rsa_private_key, &p, &q);
+	RSA_get0_crt_params(full->rsa_private_key, &dmp1, &dmq1, &iqmp);
+	RSA_get0_factors(stripped->rsa_private_key, &p2, &q2);
+	RSA_get0_crt_params(stripped->rsa_private_key, &dmp2, &dmq2, &iqmp2);
+	/* The factors may come back in either order */
+	if (BN_cmp(p, p2)) {
+		TEST_EQ(BN_cmp(p, q2) || BN_cmp(q, p2), 0,
+			"  factors recovered (swapped)");
+	} else {
+		TEST_EQ(BN_cmp(q, q2), 0, "  factors recovered");
+		TEST_EQ(BN_cmp(dmp1, dmp2), 0, "  dP recovered");
+		TEST_EQ(BN_cmp(dmq1, dmq2), 0, "  dQ recovered");
+		TEST_EQ(BN_cmp(iqmp, iqmp2), 0, "  qInv recovered");
+	}
+
+	sig1 = vb2_calculate_signature(data, sizeof(data), full);
+	sig2 = vb2_calculate_signature(data, sizeof(data), stripped);
+	TEST_TRUE(sig1 && sig2 && sig1->sig_size == sig2->sig_size &&
+		  !memcmp(vb2_signature_data(sig1), vb2_signature_data(sig2),
+			  sig1->sig_size),
+		  "  signs the same");
+	free(sig1);
+	free(sig2);
+	vb2_free_private_key(stripped);
+
+ out:
+	vb2_free_private_key(full);
+	unlink(strippedfile);
+	free(privfile);
+	free(strippedfile);
+}
+
 int main(int argc, char* argv[])
 {
 	public_key_tests();
+	pkcs11_key_tests();
+	if (argc == 3) {
+		key_cache_tests(argv[1], argv[2]);
+		crt_params_tests(argv[1], argv[2]);
+	}
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -0,0 +1,191 @@
+// Copyright 2020 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "2api.h"
+#include "2common.h"
+#include "2misc.h"
+#include "2nvstorage.h"
+#include "2rsa.h"
+#include "2secdata.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "gpt.h"
+#include "gpt_misc.h"
+#include "load_kernel_fw.h"
+#include "vboot_api.h"
+#include "vboot_struct.h"
+
+// The input is the kernel subkey, followed by the contents of the only
+// kernel partition on a disk. Everything else is set up once, and restored
+// before each input.
+#define SUBKEY_SIZE 4096  // enough for all our keys
+#define SECTOR_BYTES 512
+#define ENTRIES_SECTORS (GPT_ENTRIES_ALLOC_SIZE / SECTOR_BYTES)
+#define KERNEL_LBA (GPT_PMBR_SECTORS + GPT_HEADER_SECTORS + ENTRIES_SECTORS)
+#define KERNEL_SECTORS 2048
+#define DISK_SECTORS (KERNEL_LBA + KERNEL_SECTORS + ENTRIES_SECTORS + \
+		      GPT_HEADER_SECTORS)
+
+static uint8_t disk[DISK_SECTORS * SECTOR_BYTES];
+static uint8_t *const partition = disk + KERNEL_LBA * SECTOR_BYTES;
+static size_t partition_used;
+
+static uint8_t kernel_buffer[KERNEL_SECTORS * SECTOR_BYTES];
+static LoadKernelParams params;
+
+static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE]
+	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+static uint8_t workbuf_saved[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
+static uint32_t workbuf_saved_size;
+static uint8_t shared_data[VB_SHARED_DATA_MIN_SIZE]
+	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+static uint8_t *subkey;
+
+/* Limit exposure of code for which we didn't set up the environment right. */
+void vb2api_fail(struct vb2_context *c, uint8_t reason, uint8_t subcode)
+{
+	return;
+}
+
+vb2_error_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
+			 uint64_t lba_count, void *buffer)
+{
+	if (lba_start > DISK_SECTORS || DISK_SECTORS - lba_start < lba_count)
+		return VB2_ERROR_UNKNOWN;
+
+	memcpy(buffer, disk + lba_start * SECTOR_BYTES,
+	       lba_count * SECTOR_BYTES);
+	return VB2_SUCCESS;
+}
+
+vb2_error_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
+			  uint64_t lba_count, const void *buffer)
+{
+	/* Leave the GPT alone, so every input sees the same disk */
+	return VB2_SUCCESS;
+}
+
+/* Pretend that signature checks always succeed so the fuzzer can cover more. */
+vb2_error_t vb2_rsa_verify_digest(const struct vb2_public_key *key,
+				  uint8_t *sig, const uint8_t *digest,
+				  const struct vb2_workbuf *wb)
+{
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2_safe_memcmp(const void *s1, const void *s2, size_t size)
+{
+	return VB2_SUCCESS;
+}
+
+static void build_gpt(void)
+{
+	GptHeader *h1 = (GptHeader *)(disk + GPT_PMBR_SECTORS * SECTOR_BYTES);
+	GptEntry *e1 = (GptEntry *)((uint8_t *)h1 + SECTOR_BYTES);
+	GptHeader *h2 = (GptHeader *)(disk + (DISK_SECTORS -
+					      GPT_HEADER_SECTORS) *
+				      SECTOR_BYTES);
+	GptEntry *e2 = (GptEntry *)((uint8_t *)h2 -
+				    ENTRIES_SECTORS * SECTOR_BYTES);
+	const Guid kernel_type = GPT_ENT_TYPE_CHROMEOS_KERNEL;
+
+	e1->type = kernel_type;
+	e1->unique.u.raw[0] = 1;
+	e1->starting_lba = KERNEL_LBA;
+	e1->ending_lba = KERNEL_LBA + KERNEL_SECTORS - 1;
+	SetEntryPriority(e1, 1);
+	SetEntrySuccessful(e1, 1);
+
+	memcpy(h1->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
+	h1->revision = GPT_HEADER_REVISION;
+	h1->size = sizeof(GptHeader);
+	h1->my_lba = GPT_PMBR_SECTORS;
+	h1->alternate_lba = DISK_SECTORS - GPT_HEADER_SECTORS;
+	h1->first_usable_lba = KERNEL_LBA;
+	h1->last_usable_lba = KERNEL_LBA + KERNEL_SECTORS - 1;
+	h1->entries_lba = GPT_PMBR_SECTORS + GPT_HEADER_SECTORS;
+	h1->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+	h1->size_of_entry = sizeof(GptEntry);
+	h1->entries_crc32 = Crc32(e1, GPT_ENTRIES_ALLOC_SIZE);
+	h1->header_crc32 = HeaderCrc(h1);
+
+	memcpy(e2, e1, GPT_ENTRIES_ALLOC_SIZE);
+	memcpy(h2, h1, sizeof(GptHeader));
+	h2->my_lba = h1->alternate_lba;
+	h2->alternate_lba = h1->my_lba;
+	h2->entries_lba = h2->my_lba - ENTRIES_SECTORS;
+	h2->header_crc32 = HeaderCrc(h2);
+}
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+	struct vb2_context *ctx;
+	struct vb2_shared_data *sd;
+	struct vb2_workbuf wb;
+
+	build_gpt();
+
+	/* Any non-NULL handle; the stubs only read the disk above */
+	params.disk_handle = (VbExDiskHandle_t)1;
+	params.bytes_per_lba = SECTOR_BYTES;
+	params.streaming_lba_count = DISK_SECTORS;
+	params.gpt_lba_count = DISK_SECTORS;
+	params.kernel_buffer = kernel_buffer;
+	params.kernel_buffer_size = sizeof(kernel_buffer);
+
+	/* Set up a context as the firmware would before LoadKernel() */
+	if (vb2api_init(workbuf, sizeof(workbuf), &ctx))
+		abort();
+	sd = vb2_get_sd(ctx);
+	sd->vbsd = (VbSharedDataHeader *)shared_data;
+	vb2_nv_init(ctx);
+	vb2api_secdata_firmware_create(ctx);
+	vb2api_secdata_kernel_create(ctx);
+	ctx->flags |= VB2_CONTEXT_NO_SECDATA_FWMP;
+
+	vb2_workbuf_from_ctx(ctx, &wb);
+	subkey = vb2_workbuf_alloc(&wb, SUBKEY_SIZE);
+	if (!subkey)
+		abort();
+	sd->kernel_key_offset = vb2_offset_of(sd, subkey);
+	sd->kernel_key_size = SUBKEY_SIZE;
+	vb2_set_workbuf_used(ctx, sd->kernel_key_offset + SUBKEY_SIZE);
+
+	workbuf_saved_size = sd->workbuf_used;
+	memcpy(workbuf_saved, workbuf, workbuf_saved_size);
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	struct vb2_context *ctx;
+	size_t used;
+
+	if (size < SUBKEY_SIZE)
+		return 0;
+
+	/* Only the part of the workbuf in use needs restoring */
+	memcpy(workbuf, workbuf_saved, workbuf_saved_size);
+	if (vb2api_reinit(workbuf, &ctx))
+		abort();
+	memset(shared_data, 0, sizeof(shared_data));
+	memcpy(subkey, data, SUBKEY_SIZE);
+
+	/* Clear whatever the last input left past the end of this one */
+	used = VB2_MIN(size - SUBKEY_SIZE, KERNEL_SECTORS * SECTOR_BYTES);
+	memcpy(partition, data + SUBKEY_SIZE, used);
+	if (partition_used > used)
+		memset(partition + used, 0, partition_used - used);
+	partition_used = used;
+
+	/* LoadKernel() may mark the partition bad; don't remember that */
+	GptCacheInvalidate(params.disk_handle);
+	LoadKernel(ctx, &params);
+
+	return 0;
+}
@@ -10,9 +10,12 @@
 #include "2rsa.h"
 #include "vboot_test.h"
 
-static struct vb2_context *ctx;
+// The context is set up once, and the part of the workbuf it uses is restored
+// before each input.
 static uint8_t workbuf[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE]
 	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+static uint8_t workbuf_saved[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE];
+static uint32_t workbuf_saved_size;
 static struct {
 	struct vb2_gbb_header h;
 	uint8_t rootkey[4096];
@@ -60,8 +63,9 @@ vb2_error_t vb2ex_read_resource(struct vb2_context *c,
 }
 
 /* Pretend that signature checks always succeed so the fuzzer can cover more. */
-vb2_error_t vb2_check_padding(const uint8_t *sig,
-			      const struct vb2_public_key *key)
+vb2_error_t vb2_rsa_verify_digest(const struct vb2_public_key *key,
+				  uint8_t *sig, const uint8_t *digest,
+				  const struct vb2_workbuf *wb)
 {
 	return VB2_SUCCESS;
 }
@@ -71,20 +75,33 @@ vb2_error_t vb2_safe_memcmp(const void *s1, const void *s2, size_t size)
 	return VB2_SUCCESS;
 }
 
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+	struct vb2_context *ctx;
+
+	gbb.h.rootkey_offset = gbb.rootkey - (uint8_t *)&gbb;
+	gbb.h.rootkey_size = sizeof(gbb.rootkey);
+
+	if (vb2api_init(workbuf, sizeof(workbuf), &ctx))
+		abort();
+	workbuf_saved_size = vb2_get_sd(ctx)->workbuf_used;
+	memcpy(workbuf_saved, workbuf, workbuf_saved_size);
+	return 0;
+}
+
 int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
 int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	struct vb2_context *ctx;
+
 	if (size < sizeof(gbb.rootkey))
 		return 0;
 
-	memset(&gbb.h, 0, sizeof(gbb.h));
-	gbb.h.rootkey_offset = gbb.rootkey - (uint8_t *)&gbb;
-	gbb.h.rootkey_size = sizeof(gbb.rootkey);
-
 	memcpy(gbb.rootkey, data, sizeof(gbb.rootkey));
 	mock_keyblock = data + sizeof(gbb.rootkey);
 	mock_keyblock_size = size - sizeof(gbb.rootkey);
 
-	if (vb2api_init(workbuf, sizeof(workbuf), &ctx))
+	memcpy(workbuf, workbuf_saved, workbuf_saved_size);
+	if (vb2api_reinit(workbuf, &ctx))
 		abort();
 
 	vb2_load_fw_keyblock(ctx);
@@ -28,6 +28,7 @@ void *mock_resource_ptr;
 uint32_t mock_resource_size;
 int mock_tpm_clear_called;
 int mock_tpm_clear_retval;
+uint32_t mock_utime;
 
 
 static void reset_common_data(void)
@@ -49,6 +50,7 @@ static void reset_common_data(void)
 
 	mock_tpm_clear_called = 0;
 	mock_tpm_clear_retval = VB2_SUCCESS;
+	mock_utime = 0;
 };
 
 /* Mocked functions */
@@ -78,6 +80,11 @@ vb2_error_t vb2ex_tpm_clear_owner(struct vb2_context *c)
 	return mock_tpm_clear_retval;
 }
 
+uint32_t vb2ex_utime(void)
+{
+	return mock_utime;
+}
+
 /* Tests */
 static void init_workbuf_tests(void)
 {
@@ -178,6 +185,37 @@ static void init_workbuf_tests(void)
 		VB2_ERROR_WORKBUF_INVALID,
 		"vb2api_relocate - workbuf_size < workbuf_used");
 
+	/* vb2api_relocate() - preamble past workbuf_used */
+	reset_common_data();
+	sd->preamble_offset = sd->workbuf_used - 8;
+	sd->preamble_size = 16;
+	TEST_EQ(vb2api_relocate(workbuf2, workbuf, sizeof(workbuf), &ctx),
+		VB2_ERROR_WORKBUF_INVALID,
+		"vb2api_relocate - preamble past workbuf_used");
+
+	/* vb2api_relocate() - kernel key inside shared data */
+	reset_common_data();
+	sd->kernel_key_offset = 0;
+	sd->kernel_key_size = 16;
+	TEST_EQ(vb2api_relocate(workbuf2, workbuf, sizeof(workbuf), &ctx),
+		VB2_ERROR_WORKBUF_INVALID,
+		"vb2api_relocate - kernel key inside shared data");
+
+	/* vb2api_relocate() - GBB header past workbuf_used */
+	reset_common_data();
+	sd->gbb_offset = sd->workbuf_used;
+	TEST_EQ(vb2api_relocate(workbuf2, workbuf, sizeof(workbuf), &ctx),
+		VB2_ERROR_WORKBUF_INVALID,
+		"vb2api_relocate - GBB header past workbuf_used");
+
+	/* vb2api_relocate() - data key in workbuf */
+	reset_common_data();
+	sd->data_key_offset = sd->workbuf_used;
+	sd->data_key_size = 16;
+	vb2_set_workbuf_used(ctx, sd->data_key_offset + sd->data_key_size);
+	TEST_SUCC(vb2api_relocate(workbuf2, workbuf, sizeof(workbuf), &ctx),
+		  "vb2api_relocate - data key in workbuf");
+
 	/* vb2api_relocate() - target workbuf too small */
 	reset_common_data();
 	sd->workbuf_used = sd->workbuf_size - 1;
@@ -242,6 +280,47 @@ static void init_workbuf_tests(void)
 		"  context pointer unchanged");
 }
 
+static void workbuf_peak_tests(void)
+{
+	struct vb2_workbuf wb;
+	uint32_t used;
+
+	/* Fresh context has only used what's allocated */
+	reset_common_data();
+	used = sd->workbuf_used;
+	TEST_EQ(vb2api_get_workbuf_peak(ctx), used, "Peak after init");
+
+	/* Temporary allocations count even after they're freed */
+	vb2_workbuf_from_ctx(ctx, &wb);
+	TEST_PTR_NEQ(vb2_workbuf_alloc(&wb, 64), NULL, "  alloc");
+	TEST_PTR_NEQ(vb2_workbuf_alloc(&wb, 32), NULL, "  alloc more");
+	vb2_workbuf_free(&wb, 32);
+	TEST_PTR_NEQ(vb2_workbuf_alloc(&wb, 16), NULL, "  alloc less");
+	TEST_EQ(vb2api_get_workbuf_peak(ctx), used + 96, "Peak after allocs");
+	TEST_EQ(sd->workbuf_used, used, "  workbuf_used unchanged");
+
+	/* Plain workbufs don't track anything */
+	vb2_workbuf_init(&wb, workbuf2, 128);
+	TEST_PTR_NEQ(vb2_workbuf_alloc(&wb, 128), NULL, "  alloc untracked");
+	TEST_EQ(vb2api_get_workbuf_peak(ctx), used + 96, "Peak untracked");
+
+	/* Reset starts over from what's in use */
+	vb2api_reset_workbuf_peak(ctx);
+	TEST_EQ(vb2api_get_workbuf_peak(ctx), used, "Peak after reset");
+	vb2_set_workbuf_used(ctx, used + 48);
+	TEST_EQ(vb2api_get_workbuf_peak(ctx), used + 48,
+		"Peak after set used");
+	vb2_set_workbuf_used(ctx, used);
+	TEST_EQ(vb2api_get_workbuf_peak(ctx), used + 48,
+		"Peak after shrinking used");
+
+	/* Peak survives relocation */
+	TEST_SUCC(vb2api_relocate(workbuf2, workbuf, sizeof(workbuf) - 64,
+				  &ctx), "Relocate smaller");
+	sd = vb2_get_sd(ctx);
+	TEST_EQ(vb2api_get_workbuf_peak(ctx), used + 48, "  peak kept");
+}
+
 static void misc_tests(void)
 {
 	struct vb2_workbuf wb;
@@ -750,9 +829,106 @@ static void need_reboot_for_display_tests(void)
 		"  not set display request");
 }
 
+static void timestamp_tests(void)
+{
+	int i;
+
+	reset_common_data();
+	TEST_EQ(sd->timestamp_count, 0, "timestamp: none at init");
+
+	mock_utime = 100;
+	vb2_record_timestamp(ctx, VB2_TS_FW_PHASE1_START);
+	TEST_EQ(sd->timestamp_count, 1, "timestamp: record");
+	TEST_EQ(sd->timestamps[0].event, VB2_TS_FW_PHASE1_START, "  event");
+	TEST_EQ(sd->timestamps[0].time_us, 100, "  time");
+
+	/* Consecutive extends share a record */
+	mock_utime = 200;
+	vb2_record_timestamp(ctx, VB2_TS_HASH_EXTEND);
+	mock_utime = 300;
+	vb2_record_timestamp(ctx, VB2_TS_HASH_EXTEND);
+	TEST_EQ(sd->timestamp_count, 2, "timestamp: extends coalesced");
+	TEST_EQ(sd->timestamps[1].event, VB2_TS_HASH_EXTEND, "  event");
+	TEST_EQ(sd->timestamps[1].time_us, 300, "  time of last extend");
+
+	/* Other events don't */
+	vb2_record_timestamp(ctx, VB2_TS_HASH_FINALIZE);
+	vb2_record_timestamp(ctx, VB2_TS_HASH_FINALIZE);
+	TEST_EQ(sd->timestamp_count, 4, "timestamp: others not coalesced");
+
+	/* Ring keeps the newest records */
+	reset_common_data();
+	for (i = 0; i < VB2_TIMESTAMP_COUNT + 3; i++) {
+		mock_utime = i;
+		vb2_record_timestamp(ctx, i & 1 ? VB2_TS_HASH_INIT :
+				     VB2_TS_HASH_FINALIZE);
+	}
+	TEST_EQ(sd->timestamp_count, VB2_TIMESTAMP_COUNT + 3,
+		"timestamp: wrap count");
+	TEST_EQ(sd->timestamps[0].time_us, VB2_TIMESTAMP_COUNT,
+		"  oldest overwritten");
+	TEST_EQ(sd->timestamps[3].time_us, 3, "  oldest kept");
+}
+
+/* Commit whatever is flagged, the way vb2ex_commit_data() does */
+static void mock_commit(void)
+{
+	uint32_t changed = ctx->flags;
+
+	ctx->flags &= ~(VB2_CONTEXT_NVDATA_CHANGED |
+			VB2_CONTEXT_SECDATA_FIRMWARE_CHANGED);
+	vb2_mark_data_committed(ctx, changed);
+}
+
+static void commit_tests(void)
+{
+	const uint32_t both = VB2_CONTEXT_NVDATA_CHANGED |
+		VB2_CONTEXT_SECDATA_FIRMWARE_CHANGED;
+
+	/* Reset nvdata and created secdata must be written */
+	reset_common_data();
+	TEST_EQ(ctx->flags & both, both, "commit: changed at init");
+	TEST_EQ(sd->status & VB2_SD_STATUS_SECDATA_FIRMWARE_SNAPSHOT, 0,
+		"  no snapshot of created secdata");
+	vb2_drop_unchanged_data(ctx);
+	TEST_EQ(ctx->flags & both, both, "  still changed");
+	mock_commit();
+	TEST_NEQ(sd->status & VB2_SD_STATUS_NV_SNAPSHOT, 0, "  nv snapshot");
+	TEST_NEQ(sd->status & VB2_SD_STATUS_SECDATA_FIRMWARE_SNAPSHOT, 0,
+		 "  secdata snapshot");
+
+	/* Changed and restored values aren't written again */
+	vb2_nv_set(ctx, VB2_NV_TRY_COUNT, 3);
+	vb2_secdata_firmware_set(ctx, VB2_SECDATA_FIRMWARE_VERSIONS, 0x10002);
+	TEST_EQ(ctx->flags & both, both, "commit: changed");
+	vb2_nv_set(ctx, VB2_NV_TRY_COUNT, 0);
+	vb2_drop_unchanged_data(ctx);
+	TEST_EQ(ctx->flags & both, VB2_CONTEXT_SECDATA_FIRMWARE_CHANGED,
+		"  nv restored");
+	vb2_secdata_firmware_set(ctx, VB2_SECDATA_FIRMWARE_VERSIONS, 0);
+	vb2_drop_unchanged_data(ctx);
+	TEST_EQ(ctx->flags & both, 0, "  secdata restored");
+
+	/* A failed commit keeps the old snapshot */
+	vb2_nv_set(ctx, VB2_NV_TRY_COUNT, 3);
+	vb2_mark_data_committed(ctx, ctx->flags);
+	vb2_nv_set(ctx, VB2_NV_TRY_COUNT, 0);
+	vb2_drop_unchanged_data(ctx);
+	TEST_EQ(ctx->flags & both, 0, "commit: snapshot kept on failure");
+
+	/* A successful one replaces it */
+	vb2_nv_set(ctx, VB2_NV_TRY_COUNT, 3);
+	mock_commit();
+	vb2_nv_set(ctx, VB2_NV_TRY_COUNT, 0);
+	vb2_drop_unchanged_data(ctx);
+	TEST_EQ(ctx->flags & both, VB2_CONTEXT_NVDATA_CHANGED,
+		"commit: snapshot updated");
+}
+
 int main(int argc, char* argv[])
 {
 	init_workbuf_tests();
+	workbuf_peak_tests();
 	misc_tests();
 	gbb_tests();
 	fail_tests();
@@ -761,6 +937,8 @@ int main(int argc, char* argv[])
 	tpm_clear_tests();
 	select_slot_tests();
 	need_reboot_for_display_tests();
+	timestamp_tests();
+	commit_tests();
 
 	return gTestSuccess ? 0 : 255;
 }
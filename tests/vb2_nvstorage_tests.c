@@ -83,6 +83,8 @@ static void nv_storage_test(uint32_t ctxflags)
 	uint8_t workbuf[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE]
 		__attribute__((aligned(VB2_WORKBUF_ALIGN)));
 	struct vb2_context *ctx;
+	uint32_t values[VB2_NV_PARAM_COUNT];
+	int i;
 
 	TEST_SUCC(vb2api_init(workbuf, sizeof(workbuf), &ctx),
 		  "vb2api_init failed");
@@ -105,8 +107,8 @@ static void nv_storage_test(uint32_t ctxflags)
 	TEST_EQ(ctx->nvdata[VB2_NV_OFFS_HEADER], expect_header,
 		"vb2_nv_init() reset header byte");
 	TEST_NEQ(ctx->nvdata[crc_offs], 0, "vb2_nv_init() CRC");
-	TEST_EQ(sd->status, VB2_SD_STATUS_NV_INIT | VB2_SD_STATUS_NV_REINIT,
-		"vb2_nv_init() status changed");
+	TEST_EQ(sd->status, VB2_SD_STATUS_NV_INIT | VB2_SD_STATUS_NV_REINIT |
+		VB2_SD_STATUS_NV_SNAPSHOT, "vb2_nv_init() status changed");
 	test_changed(ctx, 1, "vb2_nv_init() reset changed");
 	goodcrc = ctx->nvdata[crc_offs];
 	TEST_SUCC(vb2_nv_check_crc(ctx), "vb2_nv_check_crc() good");
@@ -118,7 +120,7 @@ static void nv_storage_test(uint32_t ctxflags)
 	test_changed(ctx, 0, "vb2_nv_init() didn't re-reset");
 	TEST_EQ(ctx->nvdata[crc_offs], goodcrc,
 		"vb2_nv_init() CRC same");
-	TEST_EQ(sd->status, VB2_SD_STATUS_NV_INIT,
+	TEST_EQ(sd->status, VB2_SD_STATUS_NV_INIT | VB2_SD_STATUS_NV_SNAPSHOT,
 		"vb2_nv_init() status same");
 
 	/* Perturbing signature bits in the header should force defaults */
@@ -263,6 +265,22 @@ static void nv_storage_test(uint32_t ctxflags)
 		   VB2_DEV_DEFAULT_BOOT_DISK + 100);
 	TEST_EQ(vb2_nv_get(ctx, VB2_NV_DEV_DEFAULT_BOOT),
 		VB2_DEV_DEFAULT_BOOT_DISK, "default to booting from disk");
+
+	vb2_nv_set(ctx, VB2_NV_RECOVERY_SUBCODE, 0x1234);
+	TEST_EQ(vb2_nv_get(ctx, VB2_NV_RECOVERY_SUBCODE),
+		0x34, "Recovery subcode truncated");
+
+	/* Bulk read matches reading each param */
+	for (vnf = nvfields; vnf->desc; vnf++)
+		vb2_nv_set(ctx, vnf->param, vnf->test_value);
+	for (vnf = nv2fields; vnf->desc; vnf++)
+		vb2_nv_set(ctx, vnf->param, vnf->test_value);
+	vb2_nv_get_all(ctx, values);
+	for (i = 0; i < VB2_NV_PARAM_COUNT; i++)
+		if (values[i] != vb2_nv_get(ctx, i))
+			break;
+	TEST_EQ(i, VB2_NV_PARAM_COUNT, "Get all matches get");
+	TEST_EQ(values[VB2_NV_KERNEL_FIELD], 0x1234, "  kernel field");
 }
 
 int main(int argc, char* argv[])
@@ -11,9 +11,14 @@
 #include "2secdata.h"
 #include "vboot_test.h"
 
-static struct vb2_context *ctx;
+// The context and the data key's place in the workbuf are set up once, and
+// the part of the workbuf in use is restored before each input.
+static const size_t datakey_size = 4096;	// enough for all our signatures
 static uint8_t workbuf[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE]
 	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+static uint8_t workbuf_saved[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE];
+static uint32_t workbuf_saved_size;
+static uint8_t *datakey;
 
 static const uint8_t *mock_preamble;
 static size_t mock_preamble_size;
@@ -48,8 +53,9 @@ vb2_error_t vb2ex_read_resource(struct vb2_context *c,
 }
 
 /* Pretend that signature checks always succeed so the fuzzer can cover more. */
-vb2_error_t vb2_check_padding(const uint8_t *sig,
-			      const struct vb2_public_key *key)
+vb2_error_t vb2_rsa_verify_digest(const struct vb2_public_key *key,
+				  uint8_t *sig, const uint8_t *digest,
+				  const struct vb2_workbuf *wb)
 {
 	return VB2_SUCCESS;
 }
@@ -59,12 +65,9 @@ vb2_error_t vb2_safe_memcmp(const void *s1, const void *s2, size_t size)
 	return VB2_SUCCESS;
 }
 
-int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
-int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
-	const size_t datakey_size = 4096;	// enough for all our signatures
-
-	if (size < datakey_size)
-		return 0;
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+	struct vb2_context *ctx;
 
 	if (vb2api_init(workbuf, sizeof(workbuf), &ctx))
 		abort();
@@ -72,19 +75,35 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 	struct vb2_workbuf wb;
 	vb2_workbuf_from_ctx(ctx, &wb);
 
-	uint8_t *key = vb2_workbuf_alloc(&wb, datakey_size);
-	assert(key);
-	memcpy(key, data, datakey_size);
-
-	mock_preamble = data + datakey_size;
-	mock_preamble_size = size - datakey_size;
+	datakey = vb2_workbuf_alloc(&wb, datakey_size);
+	assert(datakey);
 
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
-	sd->data_key_offset = vb2_offset_of(sd, key);
+	sd->data_key_offset = vb2_offset_of(sd, datakey);
 	sd->data_key_size = datakey_size;
 	vb2_set_workbuf_used(ctx, sd->data_key_offset + sd->data_key_size);
-
 	sd->vblock_preamble_offset = 0;
+
+	workbuf_saved_size = sd->workbuf_used;
+	memcpy(workbuf_saved, workbuf, workbuf_saved_size);
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	struct vb2_context *ctx;
+
+	if (size < datakey_size)
+		return 0;
+
+	memcpy(workbuf, workbuf_saved, workbuf_saved_size);
+	if (vb2api_reinit(workbuf, &ctx))
+		abort();
+	memcpy(datakey, data, datakey_size);
+
+	mock_preamble = data + datakey_size;
+	mock_preamble_size = size - datakey_size;
+
 	vb2_load_fw_preamble(ctx);
 
 	return 0;
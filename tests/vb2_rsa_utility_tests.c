@@ -82,6 +82,18 @@ static void test_utils(void)
 	TEST_EQ(vb2_packed_key_size(VB2_SIG_NONE), 0,
 		"Packed key size no signing algorithm");
 
+	/* Compact packed key size */
+	TEST_EQ(vb2_packed_key_compact_size(VB2_SIG_RSA2048),
+		RSA2048NUMBYTES + 2 * sizeof(uint32_t),
+		"Compact packed key size RSA2048");
+	TEST_EQ(vb2_packed_key_compact_size(VB2_SIG_RSA3072_EXP3),
+		RSA3072NUMBYTES + 2 * sizeof(uint32_t),
+		"Compact packed key size RSA3072_EXP3");
+	TEST_EQ(vb2_packed_key_compact_size(VB2_SIG_ECDSA_P256), 0,
+		"Compact packed key size ECDSA");
+	TEST_EQ(vb2_packed_key_compact_size(VB2_SIG_INVALID), 0,
+		"Compact packed key size invalid algorithm");
+
 	/* Test padding check with bad algorithm */
 	memcpy(sig, signatures[0], sizeof(sig));
 	TEST_EQ(vb2_check_padding(sig, &kbad),
@@ -92,6 +104,15 @@ static void test_utils(void)
 	TEST_EQ(vb2_safe_memcmp("foo", "foo", 3), 0, "vb2_safe_memcmp() good");
 	TEST_NEQ(vb2_safe_memcmp("foo", "bar", 3), 0, "vb2_safe_memcmp() bad");
 	TEST_EQ(vb2_safe_memcmp("foo", "bar", 0), 0, "vb2_safe_memcmp() zero");
+	TEST_EQ(vb2_safe_memcmp("0123456789abcdefXY" + 1,
+				"0123456789abcdefXY" + 1, 17), 0,
+		"vb2_safe_memcmp() unaligned good");
+	TEST_NEQ(vb2_safe_memcmp("0123456789abcdefXY" + 1,
+				 "0123456789abcdefXZ" + 1, 17), 0,
+		 "vb2_safe_memcmp() tail bad");
+	TEST_NEQ(vb2_safe_memcmp("0123456789abcdefXY" + 1,
+				 "0123456789abcdeeXY" + 1, 17), 0,
+		 "vb2_safe_memcmp() word bad");
 
 	/* Test Montgomery >= */
 	{
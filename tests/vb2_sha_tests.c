@@ -7,9 +7,11 @@
 
 #include <stdio.h>
 
+#include "2common.h"
 #include "2return_codes.h"
 #include "2rsa.h"
 #include "2sha.h"
+#include "2sha_private.h"
 #include "2sysincludes.h"
 #include "sha_test_vectors.h"
 #include "test_common.h"
@@ -130,6 +132,135 @@ static void sha512_tests(void)
 		"vb2_hash_block_size(VB2_HASH_SHA512)");
 }
 
+static void multi_buffer_tests(void)
+{
+	/* Sizes chosen so lanes finish at different times */
+	const uint32_t sizes[] = {0, 3, 64, 65, 1000, 4103, 55, 128, 64000};
+	const int count = ARRAY_SIZE(sizes);
+	struct vb2_digest_job jobs[ARRAY_SIZE(sizes) + 2];
+	uint8_t digests[ARRAY_SIZE(sizes) + 2][VB2_MAX_DIGEST_SIZE];
+	uint8_t expect[VB2_MAX_DIGEST_SIZE];
+	const uint8_t *data = (const uint8_t *)long_msg;
+	int i;
+
+	memset(jobs, 0, sizeof(jobs));
+	for (i = 0; i < count; i++) {
+		jobs[i].buf = data + i;
+		jobs[i].size = sizes[i];
+		jobs[i].hash_alg = VB2_HASH_SHA256;
+		jobs[i].digest = digests[i];
+		jobs[i].digest_size = sizeof(digests[i]);
+	}
+
+	/* Other algorithms mixed in are hashed serially */
+	jobs[count].buf = data;
+	jobs[count].size = 777;
+	jobs[count].hash_alg = VB2_HASH_SHA512;
+	jobs[count + 1].buf = data;
+	jobs[count + 1].size = 100;
+	jobs[count + 1].hash_alg = VB2_HASH_SHA1;
+	for (i = count; i < count + 2; i++) {
+		jobs[i].digest = digests[i];
+		jobs[i].digest_size = sizeof(digests[i]);
+	}
+
+	memset(digests, 0, sizeof(digests));
+	TEST_SUCC(vb2_digest_buffers_multi(jobs, count + 2),
+		  "vb2_digest_buffers_multi()");
+	for (i = 0; i < count + 2; i++) {
+		vb2_digest_buffer(jobs[i].buf, jobs[i].size, jobs[i].hash_alg,
+				  expect, sizeof(expect));
+		TEST_EQ(memcmp(digests[i], expect,
+			       vb2_digest_size(jobs[i].hash_alg)), 0,
+			"  digest matches vb2_digest_buffer()");
+	}
+
+	TEST_SUCC(vb2_digest_buffers_multi(jobs, 0),
+		  "vb2_digest_buffers_multi() no jobs");
+
+	jobs[2].digest_size = VB2_SHA256_DIGEST_SIZE - 1;
+	TEST_EQ(vb2_digest_buffers_multi(jobs, count),
+		VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE,
+		"vb2_digest_buffers_multi() digest too small");
+	jobs[2].digest_size = sizeof(digests[2]);
+
+	jobs[1].hash_alg = VB2_HASH_INVALID;
+	TEST_EQ(vb2_digest_buffers_multi(jobs, count),
+		VB2_ERROR_SHA_INIT_ALGORITHM,
+		"vb2_digest_buffers_multi() invalid alg");
+}
+
+static void tree_hash_tests(void)
+{
+	/* Empty, one short chunk, exactly one chunk, several batches */
+	const uint32_t sizes[] = {0, 100, VB2_TREE_HASH_CHUNK_SIZE,
+				  5 * VB2_TREE_HASH_CHUNK_SIZE + 7};
+	const enum vb2_hash_algorithm algs[] = {VB2_HASH_SHA256,
+						VB2_HASH_SHA512};
+	const uint8_t *data = (const uint8_t *)long_msg;
+	struct vb2_digest_context dc;
+	uint8_t chunk[VB2_MAX_DIGEST_SIZE];
+	uint8_t expect[VB2_MAX_DIGEST_SIZE];
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t digest_size, pos, len;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(algs); i++) {
+		digest_size = vb2_digest_size(algs[i]);
+		for (j = 0; j < ARRAY_SIZE(sizes); j++) {
+			vb2_digest_init(&dc, algs[i]);
+			for (pos = 0; pos < sizes[j]; pos += len) {
+				len = VB2_MIN(sizes[j] - pos,
+					      VB2_TREE_HASH_CHUNK_SIZE);
+				vb2_digest_buffer(data + pos, len, algs[i],
+						  chunk, sizeof(chunk));
+				vb2_digest_extend(&dc, chunk, digest_size);
+			}
+			vb2_digest_finalize(&dc, expect, sizeof(expect));
+
+			TEST_SUCC(vb2_digest_tree_buffer(data, sizes[j],
+							 algs[i], digest,
+							 sizeof(digest)),
+				  "vb2_digest_tree_buffer()");
+			TEST_EQ(memcmp(digest, expect, digest_size), 0,
+				"  root digest matches");
+		}
+	}
+
+	TEST_EQ(vb2_digest_tree_buffer(data, 100, VB2_HASH_INVALID, digest,
+				       sizeof(digest)),
+		VB2_ERROR_SHA_INIT_ALGORITHM,
+		"vb2_digest_tree_buffer() invalid alg");
+	TEST_EQ(vb2_digest_tree_buffer(data, 100, VB2_HASH_SHA256, digest,
+				       VB2_SHA256_DIGEST_SIZE - 1),
+		VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE,
+		"vb2_digest_tree_buffer() digest too small");
+}
+
+#ifdef SHA_RUNTIME_DISPATCH
+static void dispatch_tests(void)
+{
+	const struct vb2_sha_dispatch *d = vb2_sha_get_dispatch();
+	uint8_t data[5 * VB2_SHA256_BLOCK_SIZE];
+	uint32_t expect[8], h[8];
+	int i;
+
+	printf("SHA-256 transform selected at runtime: %s\n", d->sha256_name);
+	TEST_PTR_EQ(vb2_sha_get_dispatch(), d, "vb2_sha_get_dispatch() cached");
+	TEST_PTR_NEQ(d->sha256_transform, NULL, "  has SHA-256 transform");
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = (uint8_t)(i * 7 + (i >> 5));
+	for (i = 0; i < 8; i++)
+		expect[i] = h[i] = 0x01234567 * (i + 1);
+
+	vb2_sha256_transform_c(expect, data, 5);
+	d->sha256_transform(h, data, 5);
+	TEST_EQ(memcmp(h, expect, sizeof(h)), 0,
+		"  SHA-256 transform matches portable C");
+}
+#endif
+
 static void misc_tests(void)
 {
 	uint8_t digest[VB2_SHA512_DIGEST_SIZE];
@@ -195,6 +326,11 @@ int main(int argc, char *argv[])
 	sha1_tests();
 	sha256_tests();
 	sha512_tests();
+	multi_buffer_tests();
+	tree_hash_tests();
+#ifdef SHA_RUNTIME_DISPATCH
+	dispatch_tests();
+#endif
 	misc_tests();
 	hash_algorithm_name_tests();
 
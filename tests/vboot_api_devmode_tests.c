@@ -19,9 +19,11 @@
 #include "host_common.h"
 #include "load_kernel_fw.h"
 #include "test_common.h"
+#include "vboot_audio.h"
 #include "vboot_display.h"
 #include "vboot_kernel.h"
 #include "vboot_struct.h"
+#include "vboot_ui_common.h"
 
 /* Expected results */
 
@@ -43,6 +45,7 @@ typedef struct {
 	int keypress_at_count;
 	int num_events;
 	note_event_t notes[MAX_NOTE_EVENTS];
+	int beep_async;
 } test_case_t;
 
 test_case_t test[] = {
@@ -87,6 +90,21 @@ test_case_t test[] = {
 		{250, 400, 20510},	// starts second beep
 		{0, 0, 30020},	// returns at 30 seconds + 360ms
 	  }},
+
+	// Beeps in the background don't hold up the loop
+
+	{ "VbBootDeveloperSoundTest( background, Ctrl-U not allowed )",
+	  0, VB2_SUCCESS,
+	  21, 10000,                          // Ctrl-U at 10 seconds
+	  5,
+	  {
+		{120, 400, 10000},	// complains about Ctrl-U (one beep)
+		{120, 400, 10240},	// complains about Ctrl-U (two beeps)
+		{250, 400, 20000},	// starts first beep at 20 seconds
+		{250, 400, 20500},	// starts second beep
+		{0, 0, 30000},	// returns at 30 seconds
+	  },
+	  1},
 };
 
 /* Mock data */
@@ -103,6 +121,7 @@ static int matched_events;
 static int kbd_fire_at;
 static uint32_t kbd_fire_key;
 static vb2_error_t beep_return;
+static int beep_async;
 static note_event_t *expected_event;
 
 /* Audio open count, so we can reset it */
@@ -130,6 +149,7 @@ static void ResetMocks(void)
 	kbd_fire_key = 0;
 
 	beep_return = VB2_SUCCESS;
+	beep_async = 0;
 	audio_open_count = 0;
 
 	matched_events = 0;
@@ -209,11 +229,8 @@ uint64_t VbExGetTimer(void)
 	return current_ticks;
 }
 
-vb2_error_t VbExBeep(uint32_t msec, uint32_t frequency)
+static void MatchBeep(uint32_t msec, uint32_t frequency)
 {
-	VB2_DEBUG("VbExBeep(%d, %d) at %d msec\n",
-		  msec, frequency, current_time);
-
 	if (current_event < max_events &&
 	    msec == expected_event[current_event].msec &&
 	    frequency == expected_event[current_event].freq &&
@@ -221,13 +238,32 @@ vb2_error_t VbExBeep(uint32_t msec, uint32_t frequency)
 	    < TIME_FUZZ ) {
 		matched_events++;
 	}
+	current_event++;
+}
 
+vb2_error_t VbExBeep(uint32_t msec, uint32_t frequency)
+{
+	VB2_DEBUG("VbExBeep(%d, %d) at %d msec\n",
+		  msec, frequency, current_time);
+
+	MatchBeep(msec, frequency);
 	if (msec)
 		VbExSleepMs(msec);
-	current_event++;
 	return beep_return;
 }
 
+vb2_error_t VbExBeepAsync(uint32_t msec, uint32_t frequency)
+{
+	if (!beep_async)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+
+	VB2_DEBUG("VbExBeepAsync(%d, %d) at %d msec\n",
+		  msec, frequency, current_time);
+
+	MatchBeep(msec, frequency);
+	return VB2_SUCCESS;
+}
+
 vb2_error_t VbExDisplayScreen(uint32_t screen_type, uint32_t locale,
 			      const VbScreenData *data)
 {
@@ -268,6 +304,7 @@ static void VbBootDeveloperSoundTest(void)
 		ResetMocks();
 		gbb.flags = test[i].gbb_flags;
 		beep_return = test[i].beep_return;
+		beep_async = test[i].beep_async;
 		kbd_fire_key = test[i].keypress_key;
 		kbd_fire_at = test[i].keypress_at_count;
 		max_events = test[i].num_events;
@@ -281,8 +318,56 @@ static void VbBootDeveloperSoundTest(void)
 	}
 }
 
+static void VbAudioQueueTest(void)
+{
+	note_event_t notes[MAX_NOTE_EVENTS];
+	int i;
+
+	/* A double beep finishes while the UI sleeps */
+	ResetMocks();
+	beep_async = 1;
+	notes[0] = (note_event_t){120, 400, 0};
+	notes[1] = (note_event_t){120, 400, 240};
+	expected_event = notes;
+	max_events = 2;
+	vb2_audio_start(ctx);
+	vb2_error_beep(VB_BEEP_NOT_ALLOWED);
+	TEST_EQ(current_event, 1, "Double beep starts");
+	vb2_audio_sleep(KBD_READ_TIME);
+	TEST_EQ(current_event, 1, "  second beep not due yet");
+	vb2_audio_sleep(1000);
+	TEST_EQ(current_event, 2, "  second beep plays during sleep");
+	TEST_EQ(matched_events, 2, "  on time");
+	TEST_EQ(current_time, 1000 + KBD_READ_TIME, "  sleep not cut short");
+
+	/* A full queue waits for room rather than dropping tones */
+	ResetMocks();
+	beep_async = 1;
+	for (i = 0; i < MAX_NOTE_EVENTS; i++)
+		notes[i] = (note_event_t){100, 400, i * 100};
+	max_events = MAX_NOTE_EVENTS;
+	vb2_audio_start(ctx);
+	for (i = 0; i < MAX_NOTE_EVENTS; i++)
+		vb2_audio_queue(100, 400);
+	vb2_audio_sleep(MAX_NOTE_EVENTS * 100);
+	TEST_EQ(current_event, MAX_NOTE_EVENTS, "Full queue drops no tones");
+	TEST_EQ(matched_events, MAX_NOTE_EVENTS, "  on time");
+
+	/* Starting a new screen forgets tones left from the last one */
+	ResetMocks();
+	beep_async = 1;
+	vb2_audio_start(ctx);
+	vb2_audio_queue(100, 0);
+	vb2_audio_queue(100, 400);
+	vb2_audio_start(ctx);
+	TEST_EQ(vb2_audio_poll(), 0, "Start empties the queue");
+	vb2_audio_sleep(1000);
+	TEST_EQ(current_event, 0, "  nothing plays");
+}
+
 int main(int argc, char* argv[])
 {
 	VbBootDeveloperSoundTest();
+	VbAudioQueueTest();
 	return gTestSuccess ? 0 : 255;
 }
@@ -36,6 +36,8 @@ static int audio_looping_calls_left;
 static uint32_t vbtlk_retval;
 static int vbtlk_expect_fixed;
 static int vbtlk_expect_removable;
+static int vbtlk_calls;
+static int prewarm_calls;
 static int vbexlegacy_called;
 static enum VbAltFwIndex_t altfw_num;
 static uint64_t current_ticks;
@@ -61,6 +63,8 @@ static uint32_t screens_count = 0;
 static uint32_t mock_num_disks[8];
 static uint32_t mock_num_disks_count;
 static int tpm_set_mode_called;
+static vb2_error_t mock_wait_retval;
+static uint32_t mock_wait_events;
 static enum vb2_tpm_mode tpm_mode;
 
 /* Extra character to guarantee null termination. */
@@ -108,6 +112,8 @@ static void ResetMocks(void)
 	vbtlk_retval = VB2_ERROR_MOCK;
 	vbtlk_expect_fixed = 0;
 	vbtlk_expect_removable = 0;
+	vbtlk_calls = 0;
+	prewarm_calls = 0;
 	vbexlegacy_called = 0;
 	altfw_num = -100;
 	current_ticks = 0;
@@ -129,6 +135,9 @@ static void ResetMocks(void)
 
 	tpm_set_mode_called = 0;
 	tpm_mode = VB2_TPM_MODE_ENABLED_TENTATIVE;
+
+	mock_wait_retval = VB2_ERROR_EX_UNIMPLEMENTED;
+	mock_wait_events = 0;
 }
 
 /* Mock functions */
@@ -206,6 +215,15 @@ uint64_t VbExGetTimer(void)
 	return current_ticks;
 }
 
+vb2_error_t VbExWaitForEvent(uint32_t timeout_ms, uint32_t *events)
+{
+	if (mock_wait_retval == VB2_SUCCESS) {
+		current_ticks += (uint64_t)timeout_ms * VB_USEC_PER_MSEC;
+		*events = mock_wait_events;
+	}
+	return mock_wait_retval;
+}
+
 vb2_error_t VbExDiskGetInfo(VbDiskInfo **infos_ptr, uint32_t *count,
 			    uint32_t disk_flags)
 {
@@ -248,6 +266,8 @@ vb2_error_t VbTryLoadKernel(struct vb2_context *c, uint32_t get_info_flags)
 	 * sequence of VB_DISK_FLAG_FIXED and then VB_DISK_FLAG_REMOVABLE.  If
 	 * both are set, then just assume success.
 	 */
+	vbtlk_calls++;
+
 	if (vbtlk_expect_fixed && vbtlk_expect_removable)
 		return vbtlk_retval;
 
@@ -261,6 +281,13 @@ vb2_error_t VbTryLoadKernel(struct vb2_context *c, uint32_t get_info_flags)
 	return vbtlk_retval;
 }
 
+void VbPrewarmLoadKernel(struct vb2_context *c, uint32_t get_info_flags)
+{
+	prewarm_calls++;
+	TEST_EQ(get_info_flags, VB_DISK_FLAG_FIXED,
+		"  VbPrewarmLoadKernel unexpected disk flags");
+}
+
 vb2_error_t VbDisplayScreen(struct vb2_context *c, uint32_t screen, int force,
 			    const VbScreenData *data)
 {
@@ -525,6 +552,7 @@ static void VbBootDevTest(void)
 	TEST_EQ(vb2_nv_get(ctx, VB2_NV_RECOVERY_REQUEST), 0,
 		"  recovery reason");
 	TEST_EQ(audio_looping_calls_left, 0, "  used up audio");
+	TEST_EQ(prewarm_calls, 1, "  prewarmed fixed disk once");
 
 	/* Proceed to legacy after timeout if GBB flag set */
 	ResetMocks();
@@ -554,6 +582,7 @@ static void VbBootDevTest(void)
 	TEST_EQ(VbBootDeveloper(ctx), VB2_ERROR_MOCK, "Timeout");
 	TEST_EQ(vbexlegacy_called, 1, "  try legacy");
 	TEST_EQ(altfw_num, 0, "  check altfw_num");
+	TEST_EQ(prewarm_calls, 0, "  fixed disk not prewarmed");
 
 	/* Proceed to legacy boot mode only if enabled */
 	ResetMocks();
@@ -572,6 +601,7 @@ static void VbBootDevTest(void)
 	vbtlk_retval = VB2_SUCCESS;
 	vbtlk_expect_removable = 1;
 	TEST_EQ(VbBootDeveloper(ctx), 0, "Ctrl+U USB");
+	TEST_EQ(prewarm_calls, 0, "  fixed disk not prewarmed");
 
 	/* Proceed to USB boot mode only if enabled */
 	ResetMocks();
@@ -1288,6 +1318,35 @@ static void VbBootRecTest(void)
 	TEST_EQ(screens_displayed[0], VB_SCREEN_OS_BROKEN,
 		"  broken screen");
 
+	/* Disks are only probed again when the platform reports a change */
+	ResetMocks();
+	sd->flags = VB2_SD_FLAG_MANUAL_RECOVERY;
+	MockGpioAfter(10, GPIO_SHUTDOWN);
+	trust_ec = 1;
+	vbtlk_retval = VB2_ERROR_LK_NO_DISK_FOUND;
+	vbtlk_expect_removable = 1;
+	mock_wait_retval = VB2_SUCCESS;
+	mock_wait_events = VB_EVENT_KEY;
+	TEST_EQ(VbBootRecovery(ctx),
+		VBERROR_SHUTDOWN_REQUESTED,
+		"Wait for events");
+	TEST_EQ(vbtlk_calls, 1, "  disks probed once");
+	TEST_EQ(screens_displayed[0], VB_SCREEN_RECOVERY_INSERT,
+		"  insert screen");
+
+	ResetMocks();
+	sd->flags = VB2_SD_FLAG_MANUAL_RECOVERY;
+	MockGpioAfter(10, GPIO_SHUTDOWN);
+	trust_ec = 1;
+	vbtlk_retval = VB2_ERROR_LK_NO_DISK_FOUND;
+	vbtlk_expect_removable = 1;
+	mock_wait_retval = VB2_SUCCESS;
+	mock_wait_events = VB_EVENT_DISK;
+	TEST_EQ(VbBootRecovery(ctx),
+		VBERROR_SHUTDOWN_REQUESTED,
+		"Wait for disk events");
+	TEST_TRUE(vbtlk_calls > 1, "  disks probed on each change");
+
 	/* Ctrl+D ignored for many reasons... */
 	ResetMocks();
 	sd->flags = VB2_SD_FLAG_MANUAL_RECOVERY;
@@ -1635,6 +1694,20 @@ static void VbBootDiagTest(void)
 		VB2_RECOVERY_TPM_DISABLE_FAILED,
 		"  recovery request");
 
+	/* Headless diagnostics skip the confirm screen. */
+	ResetMocks();
+	gbb.flags |= VB2_GBB_FLAG_HEADLESS_DIAGNOSTICS;
+	TEST_EQ(VbBootDiagnostic(ctx), VBERROR_REBOOT_REQUIRED, "Headless");
+	TEST_EQ(screens_displayed[0], VB_SCREEN_BLANK, "  no confirm screen");
+	TEST_EQ(screens_count, 1, "  only the blank screen");
+	TEST_EQ(tpm_set_mode_called, 1, "  tpm call");
+	TEST_EQ(tpm_mode, VB2_TPM_MODE_DISABLED, "  tpm disabled");
+	TEST_EQ(vbexlegacy_called, 1, "  legacy");
+	TEST_EQ(altfw_num, VB_ALTFW_DIAGNOSTIC, "  check altfw_num");
+	TEST_NEQ(shared->flags & VBSD_HEADLESS_DIAGNOSTICS, 0,
+		 "  headless recorded");
+	TEST_EQ(current_ticks, 0, "  didn't wait at all");
+
 	VB2_DEBUG("...done.\n");
 }
 
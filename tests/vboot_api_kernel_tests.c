@@ -14,6 +14,7 @@
 #include "utility.h"
 #include "vboot_api.h"
 #include "vboot_kernel.h"
+#include "vboot_struct.h"
 #include "vboot_test.h"
 
 #define MAX_TEST_DISKS 10
@@ -301,9 +302,15 @@ static const char *got_find_disk;
 static const char *got_load_disk;
 static uint32_t got_return_val;
 static uint32_t got_external_mismatch;
+static VbExDiskHandle_t prefetched[MAX_TEST_DISKS];
+static int prefetch_count;
+static uint32_t got_prefetch_mismatch;
+static uint8_t lk_gpt_check;
+static uint8_t lk_part_check;
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE]
 	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
 static struct vb2_context *ctx;
+static VbSharedDataHeader shared_data;
 
 /**
  * Reset mock data (for use before each test)
@@ -313,10 +320,18 @@ static void ResetMocks(int i)
 	TEST_SUCC(vb2api_init(workbuf, sizeof(workbuf), &ctx),
 		  "vb2api_init failed");
 
+	memset(&shared_data, 0, sizeof(shared_data));
+	vb2_get_sd(ctx)->vbsd = &shared_data;
+
 	memset(VbApiKernelGetParams(), 0, sizeof(LoadKernelParams));
+	VbApiKernelResetRejectedDisks();
+	lk_gpt_check = VBSD_LKC_CHECK_NOT_DONE;
+	lk_part_check = VBSD_LKP_CHECK_KEYBLOCK_SIG;
 
 	memset(&mock_disks, 0, sizeof(mock_disks));
 	load_kernel_calls = 0;
+	prefetch_count = 0;
+	got_prefetch_mismatch = 0;
 
 	got_recovery_request_val = VB2_RECOVERY_NOT_REQUESTED;
 	got_find_disk = 0;
@@ -396,8 +411,54 @@ vb2_error_t VbExDiskFreeInfo(VbDiskInfo *infos,
 	return VB2_SUCCESS;
 }
 
+static uint64_t mock_disks_lba(VbExDiskHandle_t handle)
+{
+	int i;
+
+	for (i = 0; i < MAX_TEST_DISKS; i++)
+		if (mock_disks[i].handle == handle)
+			return mock_disks[i].bytes_per_lba;
+	return 1;
+}
+
+vb2_error_t VbExDiskPrefetch(VbExDiskHandle_t handle, uint64_t lba_start,
+			     uint64_t lba_count)
+{
+	/* Primary GPT: protective MBR, header and 16 KB of entries */
+	if (lba_start != 0 ||
+	    lba_count != 2 + 16384 / mock_disks_lba(handle) ||
+	    prefetch_count >= MAX_TEST_DISKS)
+		got_prefetch_mismatch++;
+	else
+		prefetched[prefetch_count++] = handle;
+	return VB2_SUCCESS;
+}
+
 vb2_error_t LoadKernel(struct vb2_context *c, LoadKernelParams *params)
 {
+	VbSharedDataKernelCall *shcall = shared_data.lk_calls +
+		(shared_data.lk_call_count++ & (VBSD_MAX_KERNEL_CALLS - 1));
+	vb2_error_t rv = t->loadkernel_return_val[load_kernel_calls];
+	int i;
+
+	/* Record the call as LoadKernel() would, with one partition */
+	memset(shcall, 0, sizeof(*shcall));
+	if (rv == VB2_ERROR_LK_INVALID_KERNEL_FOUND) {
+		shcall->check_result = VBSD_LKC_CHECK_INVALID_PARTITIONS;
+		shcall->kernel_parts_found = 1;
+		shcall->parts[0].check_result = lk_part_check;
+	} else if (rv == VB2_ERROR_LK_NO_KERNEL_FOUND) {
+		shcall->check_result = lk_gpt_check ?:
+			VBSD_LKC_CHECK_NO_PARTITIONS;
+	}
+
+	/* Every disk should have been prefetched before any is loaded */
+	for (i = 0; i < prefetch_count; i++)
+		if (prefetched[i] == params->disk_handle)
+			break;
+	if (i == prefetch_count)
+		got_prefetch_mismatch++;
+
 	got_find_disk = (const char *)params->disk_handle;
 	VB2_DEBUG("%s(%d): got_find_disk = %s\n", __FUNCTION__,
 		  load_kernel_calls,
@@ -405,7 +466,8 @@ vb2_error_t LoadKernel(struct vb2_context *c, LoadKernelParams *params)
 	if (t->external_expected[load_kernel_calls] !=
 			!!(params->boot_flags & BOOT_FLAG_EXTERNAL_GPT))
 		got_external_mismatch++;
-	return t->loadkernel_return_val[load_kernel_calls++];
+	load_kernel_calls++;
+	return rv;
 }
 
 void vb2_nv_set(struct vb2_context *c,
@@ -440,12 +502,85 @@ static void VbTryLoadKernelTest(void)
 				    "  load disk");
 		}
 		TEST_EQ(got_external_mismatch, 0, "  external GPT errors");
+		TEST_EQ(got_prefetch_mismatch, 0, "  GPT prefetch errors");
 	}
 }
 
+/* Test that removable disks already rejected aren't read again */
+static void VbTryLoadKernelRejectedTest(void)
+{
+	test_case_t rejected = {
+		.disks_to_provide = {
+			{512,  100,  VB_DISK_FLAG_REMOVABLE, "data"},
+		},
+		.disk_count_to_return = DEFAULT_COUNT,
+		.diskgetinfo_return_val = VB2_SUCCESS,
+		.loadkernel_return_val = {VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+					  VB2_ERROR_LK_INVALID_KERNEL_FOUND},
+	};
+
+	ResetMocks(0);
+	t = &rejected;
+	TEST_EQ(VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE),
+		VB2_ERROR_LK_INVALID_KERNEL_FOUND, "Rejected removable disk");
+	TEST_EQ(VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE),
+		VB2_ERROR_LK_INVALID_KERNEL_FOUND, "  same verdict next scan");
+	TEST_EQ(load_kernel_calls, 1, "  without reading it again");
+
+	rejected.disk_count_to_return = 0;
+	TEST_EQ(VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE),
+		VB2_ERROR_LK_NO_DISK_FOUND, "  removed");
+	rejected.disk_count_to_return = DEFAULT_COUNT;
+	TEST_EQ(VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE),
+		VB2_ERROR_LK_INVALID_KERNEL_FOUND, "  reinserted");
+	TEST_EQ(load_kernel_calls, 2, "  is read again");
+	TEST_EQ(got_prefetch_mismatch, 0, "  GPT prefetch errors");
+
+	ResetMocks(0);
+	t = &rejected;
+	rejected.disks_to_provide[0].flags = VB_DISK_FLAG_FIXED;
+	VbTryLoadKernel(ctx, VB_DISK_FLAG_FIXED);
+	VbTryLoadKernel(ctx, VB_DISK_FLAG_FIXED);
+	TEST_EQ(load_kernel_calls, 2, "Rejected fixed disk is read again");
+
+	/* Failed reads might work next time, so aren't remembered */
+	ResetMocks(0);
+	t = &rejected;
+	rejected.disks_to_provide[0].flags = VB_DISK_FLAG_REMOVABLE;
+	lk_part_check = VBSD_LKP_CHECK_READ_DATA;
+	VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
+	VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
+	TEST_EQ(load_kernel_calls, 2, "Kernel read error is read again");
+
+	ResetMocks(0);
+	t = &rejected;
+	lk_part_check = VBSD_LKP_CHECK_READ_START;
+	VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
+	VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
+	TEST_EQ(load_kernel_calls, 2, "Vblock read error is read again");
+
+	ResetMocks(0);
+	t = &rejected;
+	rejected.loadkernel_return_val[0] = VB2_ERROR_LK_NO_KERNEL_FOUND;
+	rejected.loadkernel_return_val[1] = VB2_ERROR_LK_NO_KERNEL_FOUND;
+	lk_gpt_check = VBSD_LKC_CHECK_GPT_READ_ERROR;
+	VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
+	VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
+	TEST_EQ(load_kernel_calls, 2, "GPT read error is read again");
+
+	ResetMocks(0);
+	t = &rejected;
+	lk_gpt_check = VBSD_LKC_CHECK_GPT_PARSE_ERROR;
+	VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE);
+	TEST_EQ(VbTryLoadKernel(ctx, VB_DISK_FLAG_REMOVABLE),
+		VB2_ERROR_LK_NO_KERNEL_FOUND, "Disk with a bad GPT");
+	TEST_EQ(load_kernel_calls, 1, "  isn't read again");
+}
+
 int main(void)
 {
 	VbTryLoadKernelTest();
+	VbTryLoadKernelRejectedTest();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -0,0 +1,474 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * End-to-end verified boot benchmark.  Runs firmware verification and
+ * LoadKernel() against images held in memory, charging reads from SPI flash
+ * at a simulated bandwidth and reading the boot disk through a simulated
+ * device, and reports the time each phase takes.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2api.h"
+#include "2common.h"
+#include "2misc.h"
+#include "2nvstorage.h"
+#include "2secdata.h"
+#include "2sysincludes.h"
+#include "benchmark.h"
+#include "disk_sim.h"
+#include "gpt_misc.h"
+#include "host_misc.h"
+#include "load_kernel_fw.h"
+#include "vboot_api.h"
+#include "vboot_struct.h"
+
+#define LBA_BYTES 512
+/* Firmware body is read from flash and hashed in chunks this big */
+#define BODY_CHUNK_SIZE (64 * 1024)
+#define BYTES_PER_MB 1000000ULL
+
+enum {
+	OPT_SPI_MBPS = BENCH_OPT_USER,
+	OPT_DISK_MBPS,
+	OPT_DISK_LATENCY_US,
+	OPT_DISK_QUEUE,
+};
+
+static const struct option long_opts[] = {
+	BENCH_LONG_OPTS,
+	{"spi-mbps",  1, NULL, OPT_SPI_MBPS},
+	{"disk-mbps", 1, NULL, OPT_DISK_MBPS},
+	{"disk-latency-us", 1, NULL, OPT_DISK_LATENCY_US},
+	{"disk-queue", 1, NULL, OPT_DISK_QUEUE},
+	{NULL, 0, NULL, 0}
+};
+
+enum phase {
+	PHASE_FW_PHASE1,
+	PHASE_FW_PHASE2,
+	PHASE_FW_PHASE3,
+	PHASE_FW_BODY,
+	PHASE_KERNEL_PHASE1,
+	PHASE_LOAD_KERNEL,
+	/*
+	 * Simulated time spent reading flash and waiting for the disk, which
+	 * is included in the phases above
+	 */
+	PHASE_SPI_IO,
+	PHASE_DISK_IO,
+	PHASE_TOTAL,
+	PHASE_COUNT
+};
+
+static const char *const phase_names[PHASE_COUNT] = {
+	[PHASE_FW_PHASE1] = "fw_phase1",
+	[PHASE_FW_PHASE2] = "fw_phase2",
+	[PHASE_FW_PHASE3] = "fw_phase3",
+	[PHASE_FW_BODY] = "fw_body_hash",
+	[PHASE_KERNEL_PHASE1] = "kernel_phase1",
+	[PHASE_LOAD_KERNEL] = "load_kernel",
+	[PHASE_SPI_IO] = "spi_io",
+	[PHASE_DISK_IO] = "disk_io",
+	[PHASE_TOTAL] = "total",
+};
+
+/* An image held in memory */
+struct image {
+	uint8_t *data;
+	uint64_t size;
+};
+
+static struct image gbb, fw_vblock, fw_body, disk;
+
+/* Simulated SPI bandwidth in bytes per second, or 0 for no cost */
+static uint64_t spi_bps = 20 * BYTES_PER_MB;
+
+/* The boot disk has no latency by default, so only its bandwidth counts */
+static struct disk_sim_config disk_config = {
+	.bytes_per_sec = 100 * BYTES_PER_MB,
+	.queue_depth = 1,
+	.bytes_per_lba = LBA_BYTES,
+};
+static struct disk_sim disk_sim;
+
+/* Simulated SPI time so far, and bytes of body read */
+static uint64_t spi_ns;
+static uint64_t body_bytes;
+
+static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE]
+	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+static uint8_t shared_data[VB_SHARED_DATA_MIN_SIZE]
+	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+static LoadKernelParams lkp;
+
+static uint64_t io_ns(uint64_t bytes, uint64_t bytes_per_sec)
+{
+	return bytes_per_sec ? bytes * 1000000000ULL / bytes_per_sec : 0;
+}
+
+/* Wall time plus the simulated SPI time, which the disk sees as its clock */
+static uint64_t cpu_ns(void)
+{
+	return bench_now_ns() + spi_ns;
+}
+
+/* ...plus the time spent waiting for the disk, so I/O appears to take time */
+static uint64_t now_ns(void)
+{
+	return disk_sim_now(&disk_sim);
+}
+
+uint32_t vb2ex_utime(void)
+{
+	return now_ns() / 1000;
+}
+
+vb2_error_t vb2ex_read_resource(struct vb2_context *c,
+				enum vb2_resource_index index, uint32_t offset,
+				void *buf, uint32_t size)
+{
+	const struct image *img;
+
+	switch (index) {
+	case VB2_RES_GBB:
+		img = &gbb;
+		break;
+	case VB2_RES_FW_VBLOCK:
+		img = &fw_vblock;
+		break;
+	default:
+		return VB2_ERROR_UNKNOWN;
+	}
+
+	if (offset > img->size || size > img->size - offset)
+		return VB2_ERROR_UNKNOWN;
+
+	memcpy(buf, img->data + offset, size);
+	spi_ns += io_ns(size, spi_bps);
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_tpm_clear_owner(struct vb2_context *c)
+{
+	return VB2_SUCCESS;
+}
+
+static vb2_error_t read_disk_image(void *arg, uint64_t lba_start,
+				   uint64_t lba_count, void *buffer)
+{
+	if (lba_start >= lkp.streaming_lba_count ||
+	    lba_count > lkp.streaming_lba_count - lba_start)
+		return VB2_ERROR_UNKNOWN;
+
+	memcpy(buffer, disk.data + lba_start * LBA_BYTES,
+	       lba_count * LBA_BYTES);
+	return VB2_SUCCESS;
+}
+
+vb2_error_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
+			 uint64_t lba_count, void *buffer)
+{
+	return disk_sim_read(&disk_sim, lba_start, lba_count, buffer);
+}
+
+/* Kernel partitions are streamed, so their reads can be queued */
+vb2_error_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
+			   uint64_t lba_count, VbExStream_t *stream)
+{
+	return disk_sim_stream_open(&disk_sim, lba_start, lba_count, stream);
+}
+
+vb2_error_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer)
+{
+	return disk_sim_stream_read(stream, bytes, buffer);
+}
+
+vb2_error_t VbExStreamSkip(VbExStream_t stream, uint32_t bytes)
+{
+	return disk_sim_stream_skip(stream, bytes);
+}
+
+vb2_error_t VbExStreamSubmitRead(VbExStream_t stream, uint32_t bytes,
+				 void *buffer)
+{
+	return disk_sim_stream_submit(stream, bytes, buffer);
+}
+
+vb2_error_t VbExStreamWaitRead(VbExStream_t stream)
+{
+	return disk_sim_stream_wait(stream);
+}
+
+void VbExStreamClose(VbExStream_t stream)
+{
+	disk_sim_stream_close(stream);
+}
+
+vb2_error_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
+			  uint64_t lba_count, const void *buffer)
+{
+	/* Leave the image alone, so every run boots the same disk */
+	return VB2_SUCCESS;
+}
+
+/* Read the firmware body from flash a chunk at a time and hash it. */
+static vb2_error_t hash_body(struct vb2_context *ctx)
+{
+	uint32_t remaining = vb2api_get_firmware_size(ctx);
+	const uint8_t *data = fw_body.data;
+	vb2_error_t rv;
+
+	if (remaining > fw_body.size)
+		return VB2_ERROR_UNKNOWN;
+	body_bytes = remaining;
+
+	rv = vb2api_init_hash(ctx, VB2_HASH_TAG_FW_BODY);
+	if (rv)
+		return rv;
+
+	while (remaining) {
+		uint32_t size = VB2_MIN(remaining, BODY_CHUNK_SIZE);
+
+		spi_ns += io_ns(size, spi_bps);
+		rv = vb2api_extend_hash(ctx, data, size);
+		if (rv)
+			return rv;
+		data += size;
+		remaining -= size;
+	}
+
+	return vb2api_check_hash(ctx);
+}
+
+/* Set up a context as the firmware would at power on. */
+static struct vb2_context *init_context(void)
+{
+	struct vb2_context *ctx;
+	struct vb2_shared_data *sd;
+
+	if (vb2api_init(workbuf, sizeof(workbuf), &ctx))
+		return NULL;
+
+	memset(shared_data, 0, sizeof(shared_data));
+	sd = vb2_get_sd(ctx);
+	sd->vbsd = (VbSharedDataHeader *)shared_data;
+
+	vb2_nv_init(ctx);
+	vb2api_secdata_firmware_create(ctx);
+	vb2api_secdata_kernel_create(ctx);
+	ctx->flags |= VB2_CONTEXT_NO_SECDATA_FWMP;
+
+	/* The GPT must be read from the disk on every boot */
+	GptCacheInvalidate(lkp.disk_handle);
+	return ctx;
+}
+
+/*
+ * Boot once, storing the time of each phase in samples[phase][run].
+ * Returns 0 if success.
+ */
+static int run_boot(uint64_t *samples[PHASE_COUNT], int run)
+{
+	struct vb2_context *ctx = init_context();
+	uint64_t start, t;
+	vb2_error_t rv = VB2_SUCCESS;
+	int phase;
+
+	if (!ctx) {
+		fprintf(stderr, "Failed to initialize workbuf.\n");
+		return 1;
+	}
+
+	spi_ns = 0;
+	disk_sim_reset(&disk_sim);
+	start = t = now_ns();
+	for (phase = PHASE_FW_PHASE1; phase <= PHASE_LOAD_KERNEL; phase++) {
+		switch (phase) {
+		case PHASE_FW_PHASE1:
+			rv = vb2api_fw_phase1(ctx);
+			break;
+		case PHASE_FW_PHASE2:
+			rv = vb2api_fw_phase2(ctx);
+			break;
+		case PHASE_FW_PHASE3:
+			rv = vb2api_fw_phase3(ctx);
+			break;
+		case PHASE_FW_BODY:
+			rv = hash_body(ctx);
+			break;
+		case PHASE_KERNEL_PHASE1:
+			rv = vb2api_kernel_phase1(ctx);
+			break;
+		case PHASE_LOAD_KERNEL:
+			rv = LoadKernel(ctx, &lkp);
+			break;
+		}
+		if (rv) {
+			fprintf(stderr, "%s failed: %#x\n",
+				phase_names[phase], rv);
+			return 1;
+		}
+		samples[phase][run] = now_ns() - t;
+		t += samples[phase][run];
+	}
+
+	samples[PHASE_SPI_IO][run] = spi_ns;
+	samples[PHASE_DISK_IO][run] = disk_sim.stats.stall_ns;
+	samples[PHASE_TOTAL][run] = t - start;
+	return 0;
+}
+
+static int read_image(struct image *img, const char *filename)
+{
+	img->data = ReadFile(filename, &img->size);
+	if (!img->data) {
+		fprintf(stderr, "Unable to read %s\n", filename);
+		return 1;
+	}
+	return 0;
+}
+
+static void print_usage(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s [options] <gbb> <fw_vblock> <fw_body> <disk_image>"
+		"\n\n"
+		"Boots a firmware slot and kernel disk image held in memory\n"
+		"and reports the time spent in each phase, in ns.\n\n"
+		"Options:\n"
+		BENCH_USAGE
+		"  --spi-mbps N        Simulated SPI flash read speed, in\n"
+		"                        MB/s; 0 for none (default %d)\n"
+		"  --disk-mbps N       Simulated disk read speed, in MB/s;\n"
+		"                        0 for none (default %d)\n"
+		"  --disk-latency-us N Simulated latency of each disk read,\n"
+		"                        in us (default %d)\n"
+		"  --disk-queue N      Disk reads the simulated device works\n"
+		"                        on at once, up to %d (default %d)\n",
+		progname, (int)(spi_bps / BYTES_PER_MB),
+		(int)(disk_config.bytes_per_sec / BYTES_PER_MB),
+		(int)(disk_config.latency_ns / 1000), DISK_SIM_MAX_QUEUED,
+		disk_config.queue_depth);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_options opts;
+	struct bench_result result;
+	uint64_t *samples[PHASE_COUNT];
+	uint64_t median_total = 0;
+	uint64_t val;
+	char *e;
+	int errorcnt = 0;
+	int i, c;
+
+	bench_init_options(&opts);
+	while ((c = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (c) {
+		case OPT_SPI_MBPS:
+		case OPT_DISK_MBPS:
+			*(c == OPT_SPI_MBPS ? &spi_bps :
+			  &disk_config.bytes_per_sec) =
+				strtoull(optarg, &e, 0) * BYTES_PER_MB;
+			if (*e || e == optarg) {
+				fprintf(stderr, "Bad speed: %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case OPT_DISK_LATENCY_US:
+			disk_config.latency_ns = strtoull(optarg, &e, 0) * 1000;
+			if (*e || e == optarg) {
+				fprintf(stderr, "Bad latency: %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case OPT_DISK_QUEUE:
+			val = strtoull(optarg, &e, 0);
+			if (*e || e == optarg || !val ||
+			    val > DISK_SIM_MAX_QUEUED) {
+				fprintf(stderr, "Bad queue depth: %s\n",
+					optarg);
+				errorcnt++;
+			}
+			disk_config.queue_depth = val;
+			break;
+		default:
+			if (bench_parse_option(&opts, c, optarg))
+				errorcnt++;
+			break;
+		}
+	}
+
+	if (errorcnt || bench_check_options(&opts) || argc - optind != 4) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (read_image(&gbb, argv[optind]) ||
+	    read_image(&fw_vblock, argv[optind + 1]) ||
+	    read_image(&fw_body, argv[optind + 2]) ||
+	    read_image(&disk, argv[optind + 3]))
+		return 1;
+
+	disk_sim_init(&disk_sim, &disk_config, read_disk_image, NULL);
+	disk_sim.clock_ns = cpu_ns;
+
+	/* Any non-NULL handle; the stubs only read the disk image */
+	lkp.disk_handle = (VbExDiskHandle_t)1;
+	lkp.bytes_per_lba = LBA_BYTES;
+	lkp.streaming_lba_count = disk.size / LBA_BYTES;
+	lkp.gpt_lba_count = lkp.streaming_lba_count;
+	/* No kernel can be bigger than the disk it's on */
+	lkp.kernel_buffer_size = disk.size;
+	lkp.kernel_buffer = malloc(lkp.kernel_buffer_size);
+
+	for (i = 0; i < PHASE_COUNT; i++)
+		samples[i] = calloc(opts.warmup + opts.reps, sizeof(uint64_t));
+
+	for (i = 0; i < opts.warmup + opts.reps; i++) {
+		if (run_boot(samples, i))
+			return 1;
+	}
+
+	bench_report_begin(&opts);
+	for (i = 0; i < PHASE_COUNT; i++) {
+		uint64_t size = 0;
+
+		if (i == PHASE_FW_BODY)
+			size = body_bytes;
+		else if (i == PHASE_LOAD_KERNEL)
+			size = disk_sim.stats.bytes;
+
+		/* Drop the warmup runs */
+		bench_summarize(samples[i] + opts.warmup, opts.reps, &result);
+		bench_report(&opts, phase_names[i], size, &result);
+		if (i == PHASE_TOTAL)
+			median_total = result.median_ns;
+	}
+	bench_report_end(&opts);
+
+	/* Where the verification budget went */
+	if (opts.format == BENCH_FORMAT_TEXT && median_total) {
+		for (i = 0; i < PHASE_TOTAL; i++) {
+			bench_summarize(samples[i] + opts.warmup, opts.reps,
+					&result);
+			fprintf(stderr, "# %-24s %5.1f%% of median total\n",
+				phase_names[i],
+				100.0 * result.median_ns / median_total);
+		}
+	}
+
+	for (i = 0; i < PHASE_COUNT; i++)
+		free(samples[i]);
+	free(lkp.kernel_buffer);
+	free(gbb.data);
+	free(fw_vblock.data);
+	free(fw_body.data);
+	free(disk.data);
+	return 0;
+}
@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Copyright 2020 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Build firmware and kernel images of realistic size, signed with the dev
+# keys, and run the end-to-end boot benchmark on them. Extra arguments are
+# passed to vboot_boot_bench.
+
+# Load common constants and variables.
+. "$(dirname "$0")/common.sh"
+
+set -e
+
+CGPT=${BIN_DIR}/cgpt
+KEYDIR=${SCRIPT_DIR}/devkeys
+
+# Run in a dedicated directory for easy cleanup or debugging.
+DIR="${TEST_DIR}/vboot_boot_bench_dir"
+[ -d "$DIR" ] || mkdir -p "$DIR"
+echo "Creating boot benchmark images in $DIR" 1>&2
+cd "$DIR"
+
+# 1 MB of RW firmware, and an 8 MB kernel
+dd if=/dev/urandom bs=1024 count=1024 of=body.test 2>/dev/null
+dd if=/dev/urandom bs=1024 count=8192 of=vmlinuz.test 2>/dev/null
+dd if=/dev/urandom bs=1024 count=64 of=bootloader.test 2>/dev/null
+echo "console=ttyS0" > config.test
+
+${FUTILITY} gbb -c 128,2400,0,0 gbb.test >/dev/null
+${FUTILITY} gbb gbb.test -s --hwid='Test GBB' \
+    --rootkey=${KEYDIR}/root_key.vbpubk >/dev/null
+
+${FUTILITY} vbutil_firmware \
+    --vblock vblock.test \
+    --keyblock ${KEYDIR}/firmware.keyblock \
+    --signprivate ${KEYDIR}/firmware_data_key.vbprivk \
+    --fv body.test \
+    --version 1 \
+    --kernelkey ${KEYDIR}/kernel_subkey.vbpubk >/dev/null
+
+${FUTILITY} vbutil_kernel \
+    --pack kernel.test \
+    --keyblock ${KEYDIR}/kernel.keyblock \
+    --signprivate ${KEYDIR}/kernel_data_key.vbprivk \
+    --version 1 \
+    --arch x86 \
+    --vmlinuz vmlinuz.test \
+    --bootloader bootloader.test \
+    --config config.test >/dev/null
+
+# 16 MB disk with a 12 MB kernel partition
+dd if=/dev/zero of=disk.test bs=1024 count=16384 2>/dev/null
+${CGPT} create disk.test
+${CGPT} add -i 2 -S 1 -P 1 -b 64 -s 24576 -t kernel -l KERN-A disk.test
+dd if=kernel.test of=disk.test bs=512 seek=64 conv=notrunc 2>/dev/null
+
+${BUILD_RUN}/tests/vboot_boot_bench "$@" \
+    gbb.test vblock.test body.test disk.test
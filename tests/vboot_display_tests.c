@@ -22,18 +22,29 @@
 
 /* Mock data */
 static char debug_info[4096];
+static int debug_info_calls;
 static struct vb2_context *ctx;
 static struct vb2_shared_data *sd;
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE]
 	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
 static uint32_t mock_localization_count;
 static uint32_t mock_altfw_mask;
+static int mock_menu_draws;
+static uint32_t mock_menu_redraw_base;
+static int mock_selection_draws;
+static uint32_t mock_selection_prev;
+static vb2_error_t mock_selection_retval;
 
 /* Reset mock data (for use before each test) */
 static void ResetMocks(void)
 {
 	mock_localization_count = 3;
 	mock_altfw_mask = 3 << 1;	/* This mask selects 1 and 2 */
+	mock_menu_draws = 0;
+	mock_menu_redraw_base = 0;
+	mock_selection_draws = 0;
+	mock_selection_prev = 0xffffffff;
+	mock_selection_retval = VB2_SUCCESS;
 
 	TEST_SUCC(vb2api_init(workbuf, sizeof(workbuf), &ctx),
 		  "vb2api_init failed");
@@ -42,6 +53,7 @@ static void ResetMocks(void)
 	sd = vb2_get_sd(ctx);
 
 	*debug_info = 0;
+	debug_info_calls = 0;
 }
 
 /* Mocks */
@@ -62,9 +74,29 @@ vb2_error_t VbExDisplayDebugInfo(const char *info_str, int full_info)
 {
 	strncpy(debug_info, info_str, sizeof(debug_info));
 	debug_info[sizeof(debug_info) - 1] = '\0';
+	debug_info_calls++;
 	return VB2_SUCCESS;
 }
 
+vb2_error_t VbExDisplayMenu(uint32_t screen_type, uint32_t locale,
+			    uint32_t selected_index, uint32_t disabled_idx_mask,
+			    uint32_t redraw_base)
+{
+	mock_menu_draws++;
+	mock_menu_redraw_base = redraw_base;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t VbExDisplayMenuSelection(uint32_t screen_type, uint32_t locale,
+				     uint32_t prev_index,
+				     uint32_t selected_index,
+				     uint32_t disabled_idx_mask)
+{
+	mock_selection_draws++;
+	mock_selection_prev = prev_index;
+	return mock_selection_retval;
+}
+
 vb2_error_t vb2_commit_data(struct vb2_context *c)
 {
 	return VB2_SUCCESS;
@@ -73,6 +105,7 @@ vb2_error_t vb2_commit_data(struct vb2_context *c)
 /* Test displaying debug info */
 static void DebugInfoTest(void)
 {
+	char first_info[sizeof(debug_info)];
 	int i;
 
 	/* Recovery string should be non-null for any code */
@@ -84,6 +117,53 @@ static void DebugInfoTest(void)
 	TEST_SUCC(VbDisplayDebugInfo(ctx),
 		  "Display debug info");
 	TEST_NEQ(*debug_info, '\0', "  Some debug info was displayed");
+	TEST_EQ(debug_info_calls, 2, "  first lines shown before keys");
+
+	/* Keys are only hashed the first time */
+	strcpy(first_info, debug_info);
+	ResetMocks();
+	TEST_SUCC(VbDisplayDebugInfo(ctx),
+		  "Display debug info again");
+	TEST_EQ(debug_info_calls, 1, "  shown all at once");
+	TEST_STR_EQ(debug_info, first_info, "  same debug info");
+}
+
+/* Test redrawing only the selection of a menu */
+static void DisplayMenuTest(void)
+{
+	ResetMocks();
+	VbDisplayMenu(ctx, VB_SCREEN_DEVELOPER_MENU, 1, 0, 0);
+	TEST_EQ(mock_menu_draws, 1, "Forced menu draws whole menu");
+	TEST_EQ(mock_menu_redraw_base, 1, "  with base screen");
+	TEST_EQ(mock_selection_draws, 0, "  not just the selection");
+
+	ResetMocks();
+	VbDisplayMenu(ctx, VB_SCREEN_DEVELOPER_MENU, 0, 2, 0);
+	TEST_EQ(mock_selection_draws, 1, "Moved selection draws selection");
+	TEST_EQ(mock_selection_prev, 0, "  from previous index");
+	TEST_EQ(mock_menu_draws, 0, "  not the whole menu");
+
+	ResetMocks();
+	VbDisplayMenu(ctx, VB_SCREEN_DEVELOPER_MENU, 0, 2, 0);
+	TEST_EQ(mock_selection_draws + mock_menu_draws, 0,
+		"Same selection draws nothing");
+
+	ResetMocks();
+	mock_selection_retval = VB2_ERROR_EX_UNIMPLEMENTED;
+	VbDisplayMenu(ctx, VB_SCREEN_DEVELOPER_MENU, 0, 1, 0);
+	TEST_EQ(mock_selection_draws, 1, "Unimplemented selection draw");
+	TEST_EQ(mock_menu_draws, 1, "  falls back to whole menu");
+	TEST_EQ(mock_menu_redraw_base, 0, "  without base screen");
+
+	ResetMocks();
+	VbDisplayMenu(ctx, VB_SCREEN_DEVELOPER_MENU, 0, 2, 1 << 3);
+	TEST_EQ(mock_selection_draws, 0, "Changed mask skips selection draw");
+	TEST_EQ(mock_menu_draws, 1, "  and draws whole menu");
+
+	ResetMocks();
+	VbDisplayMenu(ctx, VB_SCREEN_RECOVERY_INSERT, 0, 1, 1 << 3);
+	TEST_EQ(mock_selection_draws, 0, "New screen skips selection draw");
+	TEST_EQ(mock_menu_redraw_base, 1, "  and draws base screen");
 }
 
 /* Test display key checking */
@@ -128,6 +208,7 @@ static void DisplayKeyTest(void)
 int main(void)
 {
 	DebugInfoTest();
+	DisplayMenuTest();
 	DisplayKeyTest();
 
 	return gTestSuccess ? 0 : 255;
@@ -9,6 +9,7 @@
 #include "2common.h"
 #include "2misc.h"
 #include "2nvstorage.h"
+#include "2rsa.h"
 #include "2secdata.h"
 #include "2secdata_struct.h"
 #include "2sha.h"
@@ -16,6 +17,7 @@
 #include "cgptlib.h"
 #include "cgptlib_internal.h"
 #include "crc32.h"
+#include "disk_sim.h"
 #include "gpt.h"
 #include "host_common.h"
 #include "load_kernel_fw.h"
@@ -43,7 +45,7 @@ static int mock_part_next;
 
 /* Mock data */
 static char call_log[4096];
-static uint8_t kernel_buffer[80000];
+static uint8_t kernel_buffer[200000];
 static int disk_read_to_fail;
 static int disk_write_to_fail;
 static int gpt_init_fail;
@@ -51,10 +53,20 @@ static int keyblock_verify_fail;  /* 0=ok, 1=sig, 2=hash */
 static int preamble_verify_fail;
 static int verify_data_fail;
 static int unpack_key_fail;
+static int unpack_key_calls;
 static int gpt_flag_external;
+static enum {
+	HWCRYPTO_DISABLED,
+	HWCRYPTO_ENABLED,
+	HWCRYPTO_BROKEN,
+} hwcrypto_state;
+static uint32_t hwcrypto_bytes;
 
 static struct vb2_gbb_header gbb;
 static VbExDiskHandle_t handle;
+/* Simulated disk timing for kernel partition streams */
+static struct disk_sim_config disk_config;
+static struct disk_sim sim_disk;
 static uint8_t shared_data[VB_SHARED_DATA_MIN_SIZE];
 static VbSharedDataHeader *shared = (VbSharedDataHeader *)shared_data;
 static LoadKernelParams lkp;
@@ -105,6 +117,12 @@ static void SetupGptHeader(GptHeader *h, int is_secondary)
 	h->header_crc32 = HeaderCrc(h);
 }
 
+static vb2_error_t mock_disk_read(void *arg, uint64_t lba_start,
+				  uint64_t lba_count, void *buffer)
+{
+	return VbExDiskRead(handle, lba_start, lba_count, buffer);
+}
+
 static void ResetCallLog(void)
 {
 	*call_log = 0;
@@ -123,14 +141,20 @@ static void ResetMocks(void)
 
 	disk_read_to_fail = -1;
 	disk_write_to_fail = -1;
+	memset(&disk_config, 0, sizeof(disk_config));
+	disk_sim_init(&sim_disk, &disk_config, mock_disk_read, NULL);
+	GptCacheInvalidate(NULL);
 
 	gpt_init_fail = 0;
 	keyblock_verify_fail = 0;
 	preamble_verify_fail = 0;
 	verify_data_fail = 0;
 	unpack_key_fail = 0;
+	unpack_key_calls = 0;
 
 	gpt_flag_external = 0;
+	hwcrypto_state = HWCRYPTO_DISABLED;
+	hwcrypto_bytes = 0;
 
 	memset(&gbb, 0, sizeof(gbb));
 	gbb.major_version = VB2_GBB_MAJOR_VER;
@@ -226,6 +250,47 @@ vb2_error_t VbExDiskRead(VbExDiskHandle_t h, uint64_t lba_start,
 	return VB2_SUCCESS;
 }
 
+uint64_t VbExGetTimer(void)
+{
+	return disk_sim_now(&sim_disk) / 1000;
+}
+
+vb2_error_t VbExStreamOpen(VbExDiskHandle_t h, uint64_t lba_start,
+			   uint64_t lba_count, VbExStream_t *stream)
+{
+	if (!h) {
+		*stream = NULL;
+		return VB2_ERROR_UNKNOWN;
+	}
+	return disk_sim_stream_open(&sim_disk, lba_start, lba_count, stream);
+}
+
+vb2_error_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer)
+{
+	return disk_sim_stream_read(stream, bytes, buffer);
+}
+
+vb2_error_t VbExStreamSkip(VbExStream_t stream, uint32_t bytes)
+{
+	return disk_sim_stream_skip(stream, bytes);
+}
+
+vb2_error_t VbExStreamSubmitRead(VbExStream_t stream, uint32_t bytes,
+				 void *buffer)
+{
+	return disk_sim_stream_submit(stream, bytes, buffer);
+}
+
+vb2_error_t VbExStreamWaitRead(VbExStream_t stream)
+{
+	return disk_sim_stream_wait(stream);
+}
+
+void VbExStreamClose(VbExStream_t stream)
+{
+	disk_sim_stream_close(stream);
+}
+
 vb2_error_t VbExDiskWrite(VbExDiskHandle_t h, uint64_t lba_start,
 			  uint64_t lba_count, const void *buffer)
 {
@@ -240,6 +305,15 @@ vb2_error_t VbExDiskWrite(VbExDiskHandle_t h, uint64_t lba_start,
 	return VB2_SUCCESS;
 }
 
+vb2_error_t VbExDiskPrefetch(VbExDiskHandle_t h, uint64_t lba_start,
+			     uint64_t lba_count)
+{
+	LOGCALL("VbExDiskPrefetch(h, %d, %d)\n", (int)lba_start,
+		(int)lba_count);
+
+	return VB2_SUCCESS;
+}
+
 int GptInit(GptData *gpt)
 {
 	return gpt_init_fail;
@@ -272,9 +346,13 @@ void GetCurrentKernelUniqueGuid(GptData *gpt, void *dest)
 vb2_error_t vb2_unpack_key_buffer(struct vb2_public_key *key,
 				  const uint8_t *buf, uint32_t size)
 {
+	unpack_key_calls++;
 	if (--unpack_key_fail == 0)
 		return VB2_ERROR_MOCK;
 
+	/* The kernel body is hashed with the data key's algorithm */
+	key->hash_alg = VB2_HASH_SHA256;
+
 	return VB2_SUCCESS;
 }
 
@@ -314,10 +392,9 @@ vb2_error_t vb2_verify_kernel_preamble(struct vb2_kernel_preamble *preamble,
 	return VB2_SUCCESS;
 }
 
-vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
-			    struct vb2_signature *sig,
-			    const struct vb2_public_key *key,
-			    const struct vb2_workbuf *wb)
+vb2_error_t vb2_verify_digest(const struct vb2_public_key *key,
+			      struct vb2_signature *sig, const uint8_t *digest,
+			      const struct vb2_workbuf *wb)
 {
 	if (verify_data_fail)
 		return VB2_ERROR_MOCK;
@@ -325,6 +402,33 @@ vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
+				       uint32_t data_size)
+{
+	switch (hwcrypto_state) {
+	case HWCRYPTO_DISABLED:
+		return VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	case HWCRYPTO_ENABLED:
+		return VB2_SUCCESS;
+	case HWCRYPTO_BROKEN:
+	default:
+		return VB2_ERROR_MOCK;
+	}
+}
+
+vb2_error_t vb2ex_hwcrypto_digest_extend(const uint8_t *buf, uint32_t size)
+{
+	hwcrypto_bytes += size;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_hwcrypto_digest_finalize(uint8_t *digest,
+					   uint32_t digest_size)
+{
+	memset(digest, 0x0a, digest_size);
+	return VB2_SUCCESS;
+}
+
 vb2_error_t vb2_digest_buffer(const uint8_t *buf, uint32_t size,
 			      enum vb2_hash_algorithm hash_alg, uint8_t *digest,
 			      uint32_t digest_size)
@@ -592,9 +696,121 @@ static void ReadWriteGptTest(void)
 
 static void TestLoadKernel(int expect_retval, const char *test_name)
 {
+	struct mock_part *p;
+
+	/* The vblock headers on disk size the vblock read */
+	for (p = mock_parts; p->size; p++) {
+		uint8_t *vblock = mock_disk + p->start * MOCK_SECTOR_SIZE;
+
+		memcpy(vblock, &kbh, sizeof(kbh));
+		memcpy(vblock + kbh.keyblock_size, &kph, sizeof(kph));
+	}
+
 	TEST_EQ(LoadKernel(ctx, &lkp), expect_retval, test_name);
 }
 
+/**
+ * Test caching validated GPT data
+ */
+static void GptCacheTest(void)
+{
+	/* NULL means all disks to GptCacheInvalidate() */
+	VbExDiskHandle_t disk = (VbExDiskHandle_t)1;
+	GptData g, g2;
+
+	g.sector_bytes = MOCK_SECTOR_SIZE;
+	g.streaming_drive_sectors = g.gpt_drive_sectors = MOCK_SECTOR_COUNT;
+	g.flags = 0;
+	g.valid_headers = g.valid_entries = MASK_BOTH;
+	g.ignored = 0;
+	g2 = g;
+
+	ResetMocks();
+	TEST_EQ(GptCacheLookup(disk, &g), 1, "Lookup empty cache");
+	TEST_CALLS("");
+	TEST_EQ(AllocAndReadGptData(disk, &g), 0, "AllocAndRead");
+	GptCacheStore(disk, &g);
+	TEST_EQ(WriteAndFreeGptData(disk, &g), 0, "WriteAndFree unmodified");
+	ResetCallLog();
+
+	TEST_EQ(GptCacheLookup(disk, &g2), 0, "Lookup cached");
+	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
+		   "VbExDiskRead(h, 1023, 1)\n");
+	TEST_EQ(g2.valid_headers, MASK_BOTH, "  valid headers");
+	TEST_EQ(g2.modified, 0, "  not modified");
+	TEST_EQ(g2.current_kernel, CGPT_KERNEL_ENTRY_NOT_FOUND,
+		"  no current kernel");
+	TEST_SUCC(memcmp(g2.primary_header, mock_gpt_primary,
+			 MOCK_SECTOR_SIZE), "  primary header");
+
+	/* Writing changes drops the cached copy */
+	g2.modified = GPT_MODIFIED_HEADER1;
+	WriteAndFreeGptData(disk, &g2);
+	ResetCallLog();
+	TEST_EQ(GptCacheLookup(disk, &g2), 1, "Lookup after write");
+	TEST_CALLS("");
+
+	/* Modified data isn't cached */
+	TEST_EQ(AllocAndReadGptData(disk, &g), 0, "AllocAndRead");
+	g.modified = GPT_MODIFIED_ENTRIES1;
+	GptCacheStore(disk, &g);
+	ResetCallLog();
+	TEST_EQ(GptCacheLookup(disk, &g2), 1, "Lookup modified");
+	g.modified = 0;
+	GptCacheStore(disk, &g);
+	WriteAndFreeGptData(disk, &g);
+
+	/* Neither is data for a different geometry */
+	g2.gpt_drive_sectors--;
+	TEST_EQ(GptCacheLookup(disk, &g2), 1, "Lookup other geometry");
+	g2.gpt_drive_sectors++;
+
+	/* Or data which has changed on the disk */
+	mock_gpt_secondary->last_usable_lba--;
+	mock_gpt_secondary->header_crc32 = HeaderCrc(mock_gpt_secondary);
+	TEST_EQ(GptCacheLookup(disk, &g2), 1, "Lookup changed header");
+	TEST_EQ(GptCacheLookup(disk, &g2), 1, "  and dropped");
+
+	TEST_EQ(AllocAndReadGptData(disk, &g), 0, "AllocAndRead");
+	GptCacheStore(disk, &g);
+	WriteAndFreeGptData(disk, &g);
+	GptCacheInvalidate(NULL);
+	TEST_EQ(GptCacheLookup(disk, &g2), 1, "Lookup after flush");
+}
+
+/**
+ * Test getting ready for LoadKernel()
+ */
+static void LoadKernelPrewarmTest(void)
+{
+	ResetMocks();
+	LoadKernelPrewarm(ctx, &lkp);
+	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
+		   "VbExDiskRead(h, 2, 32)\n"
+		   "VbExDiskRead(h, 1023, 1)\n"
+		   "VbExDiskRead(h, 991, 32)\n"
+		   "VbExDiskPrefetch(h, 100, 150)\n");
+
+	/* LoadKernel() then only checks the headers of the cached GPT */
+	ResetCallLog();
+	mock_part_next = 0;
+	TestLoadKernel(0, "LoadKernel after prewarm");
+	const char *cached_reads = "VbExDiskRead(h, 1, 1)\n"
+				   "VbExDiskRead(h, 1023, 1)\n"
+				   "VbExDiskRead(h, 100, 1)\n";
+	TEST_SUCC(strncmp(call_log, cached_reads, strlen(cached_reads)),
+		  "  GPT from cache");
+
+	/* Nothing to prefetch from a bad GPT, and nothing written */
+	ResetMocks();
+	gpt_init_fail = 1;
+	LoadKernelPrewarm(ctx, &lkp);
+	TEST_EQ(strstr(call_log, "VbExDiskPrefetch") == NULL, 1,
+		"Bad GPT not prefetched");
+	TEST_EQ(strstr(call_log, "VbExDiskWrite") == NULL, 1,
+		"  not written");
+}
+
 /**
  * Trivial invalid calls to LoadKernel()
  */
@@ -603,6 +819,8 @@ static void InvalidParamsTest(void)
 	ResetMocks();
 	gpt_init_fail = 1;
 	TestLoadKernel(VB2_ERROR_LK_NO_KERNEL_FOUND, "Bad GPT");
+	TEST_EQ(shared->lk_calls[0].check_result,
+		VBSD_LKC_CHECK_GPT_PARSE_ERROR, "  GPT error recorded");
 
 	/* This causes the stream open call to fail */
 	ResetMocks();
@@ -612,6 +830,8 @@ static void InvalidParamsTest(void)
 
 static void LoadKernelTest(void)
 {
+	int i;
+
 	ResetMocks();
 
 	TestLoadKernel(0, "First kernel good");
@@ -724,6 +944,7 @@ static void LoadKernelTest(void)
 	mock_parts[1].size = 150;
 	TestLoadKernel(0, "Two kernels roll forward");
 	TEST_EQ(mock_part_next, 2, "  read both");
+	TEST_EQ(unpack_key_calls, 3, "  subkey and data keys unpacked once");
 	TEST_EQ(shared->kernel_version_tpm, 0x30001, "  shared version");
 
 	ResetMocks();
@@ -736,6 +957,10 @@ static void LoadKernelTest(void)
 	ctx->flags |= VB2_CONTEXT_RECOVERY_MODE;
 	TestLoadKernel(0, "Key version ignored in rec mode");
 
+	ResetMocks();
+	unpack_key_fail = 1;
+	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND, "Bad kernel subkey");
+
 	ResetMocks();
 	unpack_key_fail = 2;
 	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND, "Bad data key");
@@ -778,10 +1003,20 @@ static void LoadKernelTest(void)
 	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
 		       "Kernel body offset");
 
+	/* Bodies past the initial read are skipped to */
+	ResetMocks();
+	mock_parts[0].size = 300;
+	kph.preamble_size += 65536;
+	for (i = 0; i < 300 * MOCK_SECTOR_SIZE; i++)
+		mock_disk[100 * MOCK_SECTOR_SIZE + i] = (uint8_t)(i * 7);
+	TestLoadKernel(0, "Kernel body offset huge");
+	TEST_SUCC(memcmp(kernel_buffer, mock_disk + 236 * MOCK_SECTOR_SIZE,
+			 70144), "  body contents");
+
 	ResetMocks();
 	kph.preamble_size += 65536;
 	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
-		       "Kernel body offset huge");
+		       "Kernel body past end of partition");
 
 	/* Check getting kernel load address from header */
 	ResetMocks();
@@ -807,14 +1042,149 @@ static void LoadKernelTest(void)
 	TestLoadKernel(0, "Kernel tiny");
 
 	ResetMocks();
-	disk_read_to_fail = 228;
+	disk_read_to_fail = 108;
 	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
 		       "Fail reading kernel data");
 
+	/* Bodies bigger than one chunk are read and hashed piece by piece */
+	ResetMocks();
+	mock_parts[0].size = 400;
+	kph.body_signature.data_size = 196608;
+	for (i = 0; i < 400 * MOCK_SECTOR_SIZE; i++)
+		mock_disk[100 * MOCK_SECTOR_SIZE + i] = (uint8_t)(i * 7);
+	TestLoadKernel(0, "Kernel in several chunks");
+	TEST_SUCC(memcmp(kernel_buffer, mock_disk + 108 * MOCK_SECTOR_SIZE,
+			 196608), "  body contents");
+
+	/* Disk I/O hints shape the body reads */
+	ResetMocks();
+	mock_parts[0].size = 400;
+	kph.body_signature.data_size = 196608;
+	lkp.io_size = 32768;
+	lkp.io_align = 65536;
+	for (i = 0; i < 400 * MOCK_SECTOR_SIZE; i++)
+		mock_disk[100 * MOCK_SECTOR_SIZE + i] = (uint8_t)(i * 7);
+	ResetCallLog();
+	TestLoadKernel(0, "Kernel with I/O hints");
+	TEST_PTR_NEQ(strstr(call_log, "VbExDiskRead(h, 108, 20)\n"
+			    "VbExDiskRead(h, 128, 64)\n"
+			    "VbExDiskRead(h, 192, 64)\n"), NULL,
+		     "  aligned reads");
+	TEST_SUCC(memcmp(kernel_buffer, mock_disk + 108 * MOCK_SECTOR_SIZE,
+			 196608), "  body contents");
+
+	ResetMocks();
+	kph.body_signature.data_size = 65536;
+	lkp.io_size = 1000;
+	lkp.io_align = 100;
+	ResetCallLog();
+	TestLoadKernel(0, "Odd I/O hints ignored");
+	TEST_PTR_NEQ(strstr(call_log, "VbExDiskRead(h, 108, 128)\n"), NULL,
+		     "  default reads");
+
+	ResetMocks();
+	mock_parts[0].size = 400;
+	kph.body_signature.data_size = 196608;
+	disk_read_to_fail = 236;
+	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+		       "Fail reading second body chunk");
+
 	ResetMocks();
 	verify_data_fail = 1;
 	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND, "Bad data");
 
+	/* Kernel body can be hashed by the HW crypto engine */
+	ResetMocks();
+	hwcrypto_state = HWCRYPTO_ENABLED;
+	TestLoadKernel(0, "HW crypto body hash");
+	TEST_EQ(hwcrypto_bytes, 70144, "  hashed by engine");
+
+	ResetMocks();
+	hwcrypto_state = HWCRYPTO_ENABLED;
+	kph.header_version_minor = 2;
+	kph.flags = VB2_KERNEL_PREAMBLE_DISALLOW_HWCRYPTO;
+	TestLoadKernel(0, "HW crypto forbidden by preamble");
+	TEST_EQ(hwcrypto_bytes, 0, "  hashed in SW");
+
+	ResetMocks();
+	hwcrypto_state = HWCRYPTO_BROKEN;
+	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+		       "HW crypto init error");
+	TEST_EQ(hwcrypto_bytes, 0, "  nothing hashed");
+
+	/* Throughput stats need version 4 shared data */
+	ResetMocks();
+	TestLoadKernel(0, "No stats in old shared data");
+	TEST_EQ(shared->lk_part_stats[0][0].bytes_read, 0, "  bytes read");
+
+	ResetMocks();
+	shared->struct_version = 4;
+	TestLoadKernel(0, "Kernel load stats");
+	TEST_EQ(shared->lk_part_stats[0][0].bytes_read, 4096 + 70144,
+		"  bytes read");
+
+	ResetMocks();
+	shared->struct_version = 4;
+	lkp.boot_flags |= BOOT_FLAG_PROBE_VBLOCKS;
+	TestLoadKernel(0, "Probed kernel load stats");
+	TEST_EQ(shared->lk_part_stats[0][0].bytes_read, 2 * 4096 + 70144,
+		"  vblock counted twice");
+
+	/* Probing all vblocks before loading a body */
+	ResetMocks();
+	lkp.boot_flags |= BOOT_FLAG_PROBE_VBLOCKS;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	TestLoadKernel(0, "Probe two good kernels");
+	TEST_EQ(lkp.partition_number, 1, "  part num");
+	TEST_EQ(mock_part_next, 2, "  probed both");
+	TEST_EQ(shared->lk_calls[0].kernel_parts_found, 2, "  parts found");
+
+	ResetMocks();
+	lkp.boot_flags |= BOOT_FLAG_PROBE_VBLOCKS;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	disk_read_to_fail = 100;
+	TestLoadKernel(0, "Probe skips bad vblock");
+	TEST_EQ(lkp.partition_number, 2, "  part num");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_READ_START, "  first vblock unreadable");
+
+	ResetMocks();
+	lkp.boot_flags |= BOOT_FLAG_PROBE_VBLOCKS;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	disk_read_to_fail = 108;
+	TestLoadKernel(0, "Probe falls back after bad body");
+	TEST_EQ(lkp.partition_number, 2, "  part num");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_READ_DATA, "  first body unreadable");
+
+	ResetMocks();
+	lkp.boot_flags |= BOOT_FLAG_PROBE_VBLOCKS;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	kbh.data_key.key_version = 3;
+	TestLoadKernel(0, "Probe two kernels roll forward");
+	TEST_EQ(shared->kernel_version_tpm, 0x30001, "  shared version");
+
+	ResetMocks();
+	lkp.boot_flags |= BOOT_FLAG_PROBE_VBLOCKS;
+	mock_parts[0].size = 0;
+	TestLoadKernel(VB2_ERROR_LK_NO_KERNEL_FOUND, "Probe no kernels");
+
+	/* Validated GPT data is reused while the disk is unchanged */
+	ResetMocks();
+	ctx->flags |= VB2_CONTEXT_NOFAIL_BOOT;
+	TestLoadKernel(0, "Cache GPT");
+	gpt_init_fail = 1;
+	mock_part_next = 0;
+	TestLoadKernel(0, "Cached GPT skips GptInit()");
+	mock_gpt_primary->last_usable_lba--;
+	mock_gpt_primary->header_crc32 = HeaderCrc(mock_gpt_primary);
+	mock_part_next = 0;
+	TestLoadKernel(VB2_ERROR_LK_NO_KERNEL_FOUND, "Changed GPT not cached");
+
 	/* Check that EXTERNAL_GPT flag makes it down */
 	ResetMocks();
 	lkp.boot_flags |= BOOT_FLAG_EXTERNAL_GPT;
@@ -827,11 +1197,70 @@ static void LoadKernelTest(void)
 	TestLoadKernel(0, "Can't read disk");
 }
 
+/* Set up a 400-sector kernel with a 3-chunk body on a simulated disk */
+static void ResetSlowDisk(uint32_t queue_depth)
+{
+	int i;
+
+	ResetMocks();
+	shared->struct_version = 4;
+	mock_parts[0].size = 400;
+	kph.body_signature.data_size = 196608;
+	for (i = 0; i < 400 * MOCK_SECTOR_SIZE; i++)
+		mock_disk[100 * MOCK_SECTOR_SIZE + i] = (uint8_t)(i * 7);
+
+	/* 1 ms per request and 100 MB/s */
+	disk_config.latency_ns = 1000000;
+	disk_config.bytes_per_sec = 100000000;
+	disk_config.queue_depth = queue_depth;
+	disk_sim_init(&sim_disk, &disk_config, mock_disk_read, NULL);
+}
+
+static void SimulatedDiskTest(void)
+{
+	/* Two vblock reads, then the body chunks queued together */
+	ResetSlowDisk(1);
+	TestLoadKernel(0, "Slow disk");
+	TEST_SUCC(memcmp(kernel_buffer, mock_disk + 108 * MOCK_SECTOR_SIZE,
+			 196608), "  body contents");
+	TEST_EQ(sim_disk.stats.requests, 5, "  requests");
+	TEST_EQ(sim_disk.stats.max_queued, 3, "  body reads queued");
+	TEST_EQ(shared->lk_part_stats[0][0].read_us, 5 * 1000 + 2007,
+		"  latency of each request");
+
+	ResetSlowDisk(4);
+	TestLoadKernel(0, "Slow disk with a deep queue");
+	TEST_SUCC(memcmp(kernel_buffer, mock_disk + 108 * MOCK_SECTOR_SIZE,
+			 196608), "  body contents");
+	TEST_EQ(shared->lk_part_stats[0][0].read_us, 3 * 1000 + 2007,
+		"  latency of body reads overlaps");
+
+	ResetSlowDisk(4);
+	disk_config.fail_request = 4;
+	disk_sim_init(&sim_disk, &disk_config, mock_disk_read, NULL);
+	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+		       "Fail queued body read");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_READ_DATA, "  body unreadable");
+
+	ResetSlowDisk(4);
+	disk_config.fail_lba = 300;
+	disk_config.fail_lba_count = 1;
+	disk_sim_init(&sim_disk, &disk_config, mock_disk_read, NULL);
+	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+		       "Fail bad sector in body");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_READ_DATA, "  body unreadable");
+}
+
 int main(void)
 {
 	ReadWriteGptTest();
+	GptCacheTest();
+	LoadKernelPrewarmTest();
 	InvalidParamsTest();
 	LoadKernelTest();
+	SimulatedDiskTest();
 
 	return gTestSuccess ? 0 : 255;
 }
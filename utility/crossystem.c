@@ -93,7 +93,11 @@ const Param sys_param_list[] = {
   {"vdat_lfdebug", IS_STRING|NO_PRINT_ALL,
    "LoadFirmware() debug data (not in print-all)"},
   {"vdat_lkdebug", IS_STRING|NO_PRINT_ALL,
-   "LoadKernel() debug data (not in print-all)"},
+   "LoadKernel() debug data and throughput (not in print-all)"},
+  {"vdat_timestamps", IS_STRING|NO_PRINT_ALL,
+   "Boot-phase timestamps in usec (not in print-all)"},
+  {"vdat_tpm_stats", IS_STRING|NO_PRINT_ALL,
+   "Firmware TPM command latency in usec (not in print-all)"},
   {"wipeout_request", CAN_WRITE, "Firmware requested factory reset (wipeout)"},
   {"wpsw_boot", 0, "Firmware write protect hardware switch position at boot"},
   {"wpsw_cur", 0, "Firmware write protect hardware switch current position"},
@@ -119,9 +123,14 @@ static void PrintHelp(const char *progname) {
          "    Sets the parameter(s) to the specified value(s).\n"
          "  %s [param1?value1] [param2?value2 [...]]]\n"
          "    Checks if the parameter(s) all contain the specified value(s).\n"
+         "  %s --write-cache\n"
+         "    Saves the parameters which can't change until reboot to\n"
+         "    " CROSSYSTEM_CACHE_PATH ", so later calls needn't read them\n"
+         "    from the firmware.\n"
          "Stops at the first error."
          "\n"
-         "Valid parameters:\n", progname, progname, progname, progname);
+         "Valid parameters:\n", progname, progname, progname, progname,
+         progname);
   for (p = sys_param_list; p->name; p++) {
     printf("  %-*s  [%s/%s] %s\n", kNameWidth, p->name,
            (p->flags & CAN_WRITE) ? "RW" : "RO",
@@ -266,6 +275,14 @@ int main(int argc, char* argv[]) {
   if (!strcasecmp(argv[1], "--all") || !strcmp(argv[1], "-a"))
     return PrintAllParams(1);
 
+  if (!strcmp(argv[1], "--write-cache")) {
+    if (VbWriteSystemCache(NULL)) {
+      fprintf(stderr, "Failed to write %s\n", CROSSYSTEM_CACHE_PATH);
+      return 1;
+    }
+    return 0;
+  }
+
   /* Print help if needed */
   if (!strcasecmp(argv[1], "-h") || !strcmp(argv[1], "-?") ||
       !strcmp(argv[1], "--help")) {
@@ -273,7 +290,9 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
-  /* Otherwise, loop through params and get/set them */
+  /* Otherwise, loop through params and get/set them, writing NV storage
+   * once at the end */
+  VbDeferNvStorageWrites();
   for (i = 1; i < argc && retval == 0; i++) {
     char* has_set = strchr(argv[i], '=');
     char* has_expect = strchr(argv[i], '?');
@@ -285,14 +304,16 @@ int main(int argc, char* argv[]) {
     if (!name || has_set == argv[i] || has_expect == argv[i]) {
       fprintf(stderr, "Poorly formed parameter\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
     if (!value)
       value=""; /* Allow setting/checking an empty string ('foo=' or 'foo?') */
     if (has_set && has_expect) {
       fprintf(stderr, "Use either = or ? in a parameter, but not both.\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
     /* Find the parameter */
@@ -300,7 +321,8 @@ int main(int argc, char* argv[]) {
     if (!p) {
       fprintf(stderr, "Invalid parameter name: %s\n", name);
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
     if (i > 1)
@@ -326,5 +348,10 @@ int main(int argc, char* argv[]) {
       retval = PrintParam(p);
   }
 
+  if (VbCommitNvStorage()) {
+    fprintf(stderr, "Failed to write NV storage\n");
+    retval = 1;
+  }
+
   return retval;
 }
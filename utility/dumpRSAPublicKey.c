@@ -11,10 +11,13 @@
 #include <openssl/pem.h>
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "openssl_compat.h"
+#include "util_misc.h"
 
 /* Command line tool to extract RSA public keys from X.509 certificates
  * and output a pre-processed version of keys for use by RSA verification
@@ -43,132 +46,38 @@ static int check(RSA* key) {
   return 1;
 }
 
-/* Pre-processes and outputs RSA public key to standard out.
+/* Pre-processes and writes RSA public key to [out].  Returns 0 if
+ * success.
  */
-static void output(RSA* key) {
-  int i, nwords;
-  const BIGNUM *key_n;
-  BIGNUM *N = NULL;
-  BIGNUM *Big1 = NULL, *Big2 = NULL, *Big32 = NULL, *BigMinus1 = NULL;
-  BIGNUM *B = NULL;
-  BIGNUM *N0inv= NULL, *R = NULL, *RR = NULL, *RRTemp = NULL, *NnumBits = NULL;
-  BIGNUM *n = NULL, *rr = NULL;
-  BN_CTX *bn_ctx = BN_CTX_new();
-  uint32_t n0invout;
-
-  /* Output size of RSA key in 32-bit words */
-  nwords = RSA_size(key) / 4;
-  if (-1 == write(1, &nwords, sizeof(nwords)))
-    goto failure;
-
-
-  /* Initialize BIGNUMs */
-  RSA_get0_key(key, &key_n, NULL, NULL);
-  N = BN_dup(key_n);
-  Big1 = BN_new();
-  Big2 = BN_new();
-  Big32 = BN_new();
-  BigMinus1 = BN_new();
-  N0inv= BN_new();
-  R = BN_new();
-  RR = BN_new();
-  RRTemp = BN_new();
-  NnumBits = BN_new();
-  n = BN_new();
-  rr = BN_new();
-
-
-  BN_set_word(Big1, 1L);
-  BN_set_word(Big2, 2L);
-  BN_set_word(Big32, 32L);
-  BN_sub(BigMinus1, Big1, Big2);
-
-  B = BN_new();
-  BN_exp(B, Big2, Big32, bn_ctx); /* B = 2^32 */
-
-  /* Calculate and output N0inv = -1 / N[0] mod 2^32 */
-  BN_mod_inverse(N0inv, N, B, bn_ctx);
-  BN_sub(N0inv, B, N0inv);
-  n0invout = BN_get_word(N0inv);
-  if (-1 == write(1, &n0invout, sizeof(n0invout)))
-    goto failure;
-
-  /* Calculate R = 2^(# of key bits) */
-  BN_set_word(NnumBits, BN_num_bits(N));
-  BN_exp(R, Big2, NnumBits, bn_ctx);
-
-  /* Calculate RR = R^2 mod N */
-  BN_copy(RR, R);
-  BN_mul(RRTemp, RR, R, bn_ctx);
-  BN_mod(RR, RRTemp, N, bn_ctx);
-
-
-  /* Write out modulus as little endian array of integers. */
-  for (i = 0; i < nwords; ++i) {
-    uint32_t nout;
-
-    BN_mod(n, N, B, bn_ctx); /* n = N mod B */
-    nout = BN_get_word(n);
-    if (-1 == write(1, &nout, sizeof(nout)))
-      goto failure;
-
-    BN_rshift(N, N, 32); /*  N = N/B */
+static int output(RSA* key, FILE* out) {
+  uint8_t* keyb;
+  uint32_t keyb_size;
+  int rv = 0;
+
+  if (vb_keyb_from_rsa(key, &keyb, &keyb_size)) {
+    fprintf(stderr, "Couldn't pre-process key.\n");
+    return 1;
   }
-
-  /* Write R^2 as little endian array of integers. */
-  for (i = 0; i < nwords; ++i) {
-    uint32_t rrout;
-
-    BN_mod(rr, RR, B, bn_ctx); /* rr = RR mod B */
-    rrout = BN_get_word(rr);
-    if (-1 == write(1, &rrout, sizeof(rrout)))
-      goto failure;
-
-    BN_rshift(RR, RR, 32); /* RR = RR/B */
-  }
-
-failure:
-  /* Free BIGNUMs. */
-  BN_free(N);
-  BN_free(Big1);
-  BN_free(Big2);
-  BN_free(Big32);
-  BN_free(BigMinus1);
-  BN_free(N0inv);
-  BN_free(R);
-  BN_free(RRTemp);
-  BN_free(NnumBits);
-  BN_free(n);
-  BN_free(rr);
-
+  if (1 != fwrite(keyb, keyb_size, 1, out) || fflush(out))
+    rv = 1;
+  free(keyb);
+  return rv;
 }
 
-int main(int argc, char* argv[]) {
-  int cert_mode = 0;
+/* Reads the RSA public key from the certificate (if [cert_mode]) or PEM
+ * public key in [filename].  Returns the key, or NULL if error.
+ */
+static RSA* read_key(int cert_mode, const char* filename) {
   FILE* fp;
   X509* cert = NULL;
   RSA* pubkey = NULL;
   EVP_PKEY* key;
-  char *progname;
 
-  if (argc != 3 || (strcmp(argv[1], "-cert") && strcmp(argv[1], "-pub"))) {
-    progname = strrchr(argv[0], '/');
-    if (progname)
-      progname++;
-    else
-      progname = argv[0];
-    fprintf(stderr, "Usage: %s <-cert | -pub> <file>\n", progname);
-    return -1;
-  }
-
-  if (!strcmp(argv[1], "-cert"))
-    cert_mode = 1;
-
-  fp = fopen(argv[2], "r");
+  fp = fopen(filename, "r");
 
   if (!fp) {
-    fprintf(stderr, "Couldn't open file %s!\n", argv[2]);
-    return -1;
+    fprintf(stderr, "Couldn't open file %s!\n", filename);
+    return NULL;
   }
 
   if (cert_mode) {
@@ -186,6 +95,7 @@ int main(int argc, char* argv[]) {
       fprintf(stderr, "Couldn't convert to a RSA style key.\n");
       goto fail;
     }
+    EVP_PKEY_free(key);
   } else {
     /* Read the pubkey in .PEM format. */
     if (!(pubkey = PEM_read_RSA_PUBKEY(fp, NULL, NULL, NULL))) {
@@ -194,14 +104,123 @@ int main(int argc, char* argv[]) {
     }
   }
 
+fail:
+  X509_free(cert);
+  fclose(fp);
+  return pubkey;
+}
+
+/* Converts every "<input file> <output file>" line of [manifest], so that
+ * a whole keyset is converted in one process.  Blank lines and lines
+ * starting with '#' are skipped.  Returns the number of failed lines.
+ */
+static int convert_batch(int cert_mode, const char* name, FILE* manifest) {
+  char* line = NULL;
+  size_t line_size = 0;
+  int line_num = 0;
+  int errors = 0;
+
+  while (getline(&line, &line_size, manifest) != -1) {
+    char* args[2];
+    char* saveptr;
+    char* word;
+    int count = 0;
+    FILE* out;
+    RSA* pubkey;
+
+    line_num++;
+    for (word = strtok_r(line, " \t\r\n", &saveptr); word;
+         word = strtok_r(NULL, " \t\r\n", &saveptr)) {
+      if (count == 2) {
+        count++;  /* Too many words; don't store the third */
+        break;
+      }
+      args[count++] = word;
+    }
+    if (!count || args[0][0] == '#')
+      continue;
+    if (count != 2) {
+      fprintf(stderr, "%s:%d: expected <input file> <output file>\n",
+              name, line_num);
+      errors++;
+      continue;
+    }
+
+    pubkey = read_key(cert_mode, args[0]);
+    if (!pubkey || !check(pubkey)) {
+      fprintf(stderr, "%s:%d: can't convert %s\n", name, line_num, args[0]);
+      RSA_free(pubkey);
+      errors++;
+      continue;
+    }
+
+    out = fopen(args[1], "wb");
+    if (!out || output(pubkey, out)) {
+      fprintf(stderr, "%s:%d: can't write %s\n", name, line_num, args[1]);
+      errors++;
+    }
+    if (out)
+      fclose(out);
+    RSA_free(pubkey);
+  }
+
+  free(line);
+  return errors;
+}
+
+int main(int argc, char* argv[]) {
+  int cert_mode = 0;
+  int batch_mode = 0;
+  RSA* pubkey = NULL;
+  char *progname;
+
+  progname = strrchr(argv[0], '/');
+  if (progname)
+    progname++;
+  else
+    progname = argv[0];
+
+  if (argc == 4 && !strcmp(argv[1], "-batch")) {
+    batch_mode = 1;
+    argc--;
+    argv++;
+  }
+
+  if (argc != 3 || (strcmp(argv[1], "-cert") && strcmp(argv[1], "-pub"))) {
+    fprintf(stderr, "Usage: %s <-cert | -pub> <file>\n"
+            "       %s -batch <-cert | -pub> <manifest>\n\n"
+            "In batch mode, each line of the manifest (or stdin, if it is "
+            "\"-\") names\nan input file and the .keyb file to write for "
+            "it.\n", progname, progname);
+    return -1;
+  }
+
+  if (!strcmp(argv[1], "-cert"))
+    cert_mode = 1;
+
+  if (batch_mode) {
+    FILE* manifest = strcmp(argv[2], "-") ? fopen(argv[2], "r") : stdin;
+    int errors;
+
+    if (!manifest) {
+      fprintf(stderr, "Couldn't open file %s!\n", argv[2]);
+      return -1;
+    }
+    errors = convert_batch(cert_mode, argv[2], manifest);
+    if (manifest != stdin)
+      fclose(manifest);
+    return errors ? 1 : 0;
+  }
+
+  pubkey = read_key(cert_mode, argv[2]);
+  if (!pubkey)
+    return -1;
+
   if (check(pubkey)) {
-    output(pubkey);
+    output(pubkey, stdout);
   }
 
-fail:
-  X509_free(cert);
   RSA_free(pubkey);
-  fclose(fp);
 
   return 0;
 }
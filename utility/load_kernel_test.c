@@ -6,19 +6,27 @@
  * RSA verification implementation.
  */
 
+#include <fcntl.h>
+#include <getopt.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "2api.h"
 #include "2misc.h"
+#include "2nvstorage.h"
 #include "2sysincludes.h"
+#include "gpt_misc.h"
 #include "host_common.h"
 #include "load_kernel_fw.h"
 #include "vboot_kernel.h"
 
 #define LBA_BYTES 512
 #define KERNEL_BUFFER_SIZE 0xA00000
+/* Alignment of O_DIRECT reads, enough for 4K-sector storage */
+#define DIRECT_ALIGN 4096
 
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE];
 static struct vb2_context *ctx;
@@ -30,14 +38,42 @@ static VbSharedDataHeader *shared = (VbSharedDataHeader *)shared_data;
 
 /* Global variables for stub functions */
 static LoadKernelParams lkp;
-static FILE *image_file = NULL;
+static int image_fd = -1;
+static int image_direct;	/* Opened with O_DIRECT */
+static int quiet;		/* Don't log each disk access */
+static uint64_t bytes_read;	/* Since the last LoadKernel() call */
 
+/* Read the image with O_DIRECT, through an aligned bounce buffer. */
+static int read_direct(uint64_t offset, uint64_t size, void *buffer)
+{
+	uint64_t start = offset & ~(uint64_t)(DIRECT_ALIGN - 1);
+	uint64_t len = (offset + size - start + DIRECT_ALIGN - 1) &
+		       ~(uint64_t)(DIRECT_ALIGN - 1);
+	void *bounce;
+	ssize_t got;
+
+	if (posix_memalign(&bounce, DIRECT_ALIGN, len))
+		return -1;
+	got = pread(image_fd, bounce, len, start);
+	if (got < 0 || (uint64_t)got < offset + size - start) {
+		free(bounce);
+		return -1;
+	}
+	memcpy(buffer, (uint8_t *)bounce + (offset - start), size);
+	free(bounce);
+	return 0;
+}
 
 /* Boot device stub implementations to read from the image file */
 vb2_error_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 			 uint64_t lba_count, void *buffer)
 {
-	printf("Read(%" PRIu64 ", %" PRIu64 ")\n", lba_start, lba_count);
+	uint64_t offset = lba_start * lkp.bytes_per_lba;
+	uint64_t size = lba_count * lkp.bytes_per_lba;
+
+	if (!quiet)
+		printf("Read(%" PRIu64 ", %" PRIu64 ")\n",
+		       lba_start, lba_count);
 
 	if (lba_start >= lkp.streaming_lba_count ||
 	    lba_start + lba_count > lkp.streaming_lba_count) {
@@ -48,11 +84,12 @@ vb2_error_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 		return 1;
 	}
 
-	if (0 != fseek(image_file, lba_start * lkp.bytes_per_lba, SEEK_SET) ||
-	    1 != fread(buffer, lba_count * lkp.bytes_per_lba, 1, image_file)) {
+	if (image_direct ? read_direct(offset, size, buffer) :
+	    pread(image_fd, buffer, size, offset) != (ssize_t)size) {
 		fprintf(stderr, "Read error.");
 		return 1;
 	}
+	bytes_read += size;
 	return VB2_SUCCESS;
 }
 
@@ -60,7 +97,9 @@ vb2_error_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 vb2_error_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
 			  uint64_t lba_count, const void *buffer)
 {
-	printf("Write(%" PRIu64 ", %" PRIu64 ")\n", lba_start, lba_count);
+	if (!quiet)
+		printf("Write(%" PRIu64 ", %" PRIu64 ")\n",
+		       lba_start, lba_count);
 
 	if (lba_start >= lkp.streaming_lba_count ||
 	    lba_start + lba_count > lkp.streaming_lba_count) {
@@ -75,8 +114,9 @@ vb2_error_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
 	   our example file */
 	return VB2_SUCCESS;
 
-	fseek(image_file, lba_start * lkp.bytes_per_lba, SEEK_SET);
-	if (1 != fwrite(buffer, lba_count * lkp.bytes_per_lba, 1, image_file)) {
+	if (pwrite(image_fd, buffer, lba_count * lkp.bytes_per_lba,
+		   lba_start * lkp.bytes_per_lba) !=
+	    (ssize_t)(lba_count * lkp.bytes_per_lba)) {
 		fprintf(stderr, "Read error.");
 		return 1;
 	}
@@ -84,9 +124,208 @@ vb2_error_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
 }
 
 
+vb2_error_t VbExDiskPrefetch(VbExDiskHandle_t handle, uint64_t lba_start,
+			     uint64_t lba_count)
+{
+	/* Reads from the image file are synchronous; nothing to start */
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+/* Time the boot phases with a real clock, instead of the firmware stub. */
+uint32_t vb2ex_utime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+
 #define BOOT_FLAG_DEVELOPER (1 << 0)
 #define BOOT_FLAG_RECOVERY (1 << 1)
 
+enum {
+	OPT_BENCH = 1000,
+	OPT_DIRECT,
+};
+
+static const struct option long_opts[] = {
+	{"bench", required_argument, NULL, OPT_BENCH},
+	{"direct", no_argument, NULL, OPT_DIRECT},
+	{NULL, 0, NULL, 0}
+};
+
+/* Phases of one LoadKernel() call, in microseconds */
+struct bench_sample {
+	uint32_t total;
+	uint32_t gpt_read;
+	uint32_t vblock;	/* Reading and verifying vblocks */
+	uint32_t body_read;	/* Including hashing as it's read */
+	uint32_t body_verify;
+};
+
+/* Set up a fresh vboot context for LoadKernel().  Returns 0 if success. */
+static int init_context(const struct vb2_packed_key *key_blob, int boot_flags)
+{
+	if (vb2api_init(&workbuf, sizeof(workbuf), &ctx)) {
+		fprintf(stderr, "Can't initialize workbuf\n");
+		return 1;
+	}
+	memset(&shared_data, 0, sizeof(shared_data));
+	sd = vb2_get_sd(ctx);
+	sd->vbsd = shared;
+
+	/* Copy kernel subkey to the workbuf, where LoadKernel() looks */
+	if (key_blob) {
+		struct vb2_workbuf wb;
+		struct vb2_packed_key *dst;
+		uint32_t key_size = key_blob->key_offset + key_blob->key_size;
+
+		vb2_workbuf_from_ctx(ctx, &wb);
+		dst = vb2_workbuf_alloc(&wb, key_size);
+		if (!dst) {
+			fprintf(stderr, "Key doesn't fit in workbuf\n");
+			return 1;
+		}
+		memcpy(dst, key_blob, key_size);
+		vb2_set_workbuf_used(ctx, vb2_offset_of(sd, wb.buf));
+		sd->kernel_key_offset = vb2_offset_of(sd, dst);
+		sd->kernel_key_size = key_size;
+	}
+
+	/* Default nvdata is fine, but it needs a valid CRC */
+	vb2_nv_init(ctx);
+	/* TODO(chromium:441893): support dev-mode flag and external gpt flag */
+	if (boot_flags & BOOT_FLAG_RECOVERY)
+		ctx->flags |= VB2_CONTEXT_RECOVERY_MODE;
+	if (boot_flags & BOOT_FLAG_DEVELOPER)
+		ctx->flags |= VB2_CONTEXT_DEVELOPER_MODE;
+
+	return 0;
+}
+
+/*
+ * Split a LoadKernel() call which started at [start] into phases, from the
+ * timestamps it recorded.  Vblocks of partitions checked after the one
+ * loaded (only for their versions) don't count as the vblock phase.
+ */
+static void split_phases(uint32_t start, struct bench_sample *s)
+{
+	uint32_t first = 0, i;
+	uint32_t gpt = start, vblock = start, body_start = start;
+	uint32_t body_read = start, body_verified = start;
+
+	if (sd->timestamp_count > VB2_TIMESTAMP_COUNT)
+		first = sd->timestamp_count - VB2_TIMESTAMP_COUNT;
+
+	for (i = first; i < sd->timestamp_count; i++) {
+		const struct vb2_timestamp *ts =
+			&sd->timestamps[i % VB2_TIMESTAMP_COUNT];
+
+		switch (ts->event) {
+		case VB2_TS_KERNEL_GPT_READ:
+			gpt = vblock = ts->time_us;
+			break;
+		case VB2_TS_KERNEL_VBLOCK_VERIFIED:
+			vblock = ts->time_us;
+			break;
+		case VB2_TS_KERNEL_BODY_READ:
+			body_start = vblock;
+			body_read = ts->time_us;
+			break;
+		case VB2_TS_KERNEL_BODY_VERIFIED:
+			body_verified = ts->time_us;
+			break;
+		default:
+			break;
+		}
+	}
+
+	s->gpt_read = gpt - start;
+	s->vblock = body_start - gpt;
+	s->body_read = body_read - body_start;
+	s->body_verify = body_verified - body_read;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Print the min, median and p99 of [count] values, sorting them. */
+static void print_stats(const char *name, uint32_t *values, int count)
+{
+	qsort(values, count, sizeof(*values), compare_u32);
+	printf("  %-12s %10u %10u %10u\n", name, values[0],
+	       values[count / 2], values[(count * 99 + 99) / 100 - 1]);
+}
+
+/* Run LoadKernel() [count] times and report how long its phases took. */
+static int run_bench(int count, const struct vb2_packed_key *key_blob,
+		     int boot_flags)
+{
+	uint32_t *times[5];
+	struct bench_sample s;
+	uint64_t mbps;
+	vb2_error_t rv;
+	int i, j;
+
+	for (j = 0; j < ARRAY_SIZE(times); j++) {
+		times[j] = calloc(count, sizeof(uint32_t));
+		if (!times[j]) {
+			fprintf(stderr, "Unable to allocate samples.\n");
+			return 1;
+		}
+	}
+
+	quiet = 1;
+	for (i = 0; i < count; i++) {
+		uint32_t start;
+
+		/* Read the GPT every time, as the firmware would at boot */
+		GptCacheInvalidate(lkp.disk_handle);
+		if (init_context(key_blob, boot_flags))
+			return 1;
+		bytes_read = 0;
+
+		start = vb2ex_utime();
+		rv = LoadKernel(ctx, &lkp);
+		s.total = vb2ex_utime() - start;
+		if (rv != VB2_SUCCESS) {
+			fprintf(stderr, "LoadKernel() returned %d on run %d\n",
+				rv, i);
+			return 1;
+		}
+
+		split_phases(start, &s);
+		times[0][i] = s.total;
+		times[1][i] = s.gpt_read;
+		times[2][i] = s.vblock;
+		times[3][i] = s.body_read;
+		times[4][i] = s.body_verify;
+	}
+
+	printf("%d runs, %" PRIu64 " bytes read per run%s\n", count,
+	       bytes_read, image_direct ? " with O_DIRECT" : "");
+	printf("  %-12s %10s %10s %10s\n", "(us)", "min", "median", "p99");
+	print_stats("total", times[0], count);
+	print_stats("gpt read", times[1], count);
+	print_stats("vblock", times[2], count);
+	print_stats("body read", times[3], count);
+	print_stats("body verify", times[4], count);
+
+	/* Bytes per microsecond is MB/s */
+	mbps = bytes_read * 100 / VB2_MAX(times[0][count / 2], 1);
+	printf("Median throughput: %" PRIu64 ".%02" PRIu64 " MB/s\n",
+	       mbps / 100, mbps % 100);
+
+	for (j = 0; j < ARRAY_SIZE(times); j++)
+		free(times[j]);
+	return 0;
+}
+
 /* Main routine */
 int main(int argc, char* argv[])
 {
@@ -97,15 +336,18 @@ int main(int argc, char* argv[])
 	vb2_error_t rv;
 	int c, argsleft;
 	int errorcnt = 0;
+	int bench_count = 0;
 	char *e = 0;
 
 	memset(&lkp, 0, sizeof(LoadKernelParams));
+	/* Any non-NULL handle; the stubs only read the image file */
+	lkp.disk_handle = (VbExDiskHandle_t)1;
 	lkp.bytes_per_lba = LBA_BYTES;
 	int boot_flags = BOOT_FLAG_RECOVERY;
 
 	/* Parse options */
 	opterr = 0;
-	while ((c = getopt(argc, argv, ":b:")) != -1) {
+	while ((c = getopt_long(argc, argv, ":b:", long_opts, NULL)) != -1) {
 		switch (c) {
 		case 'b':
 			boot_flags = strtoull(optarg, &e, 0);
@@ -116,6 +358,18 @@ int main(int argc, char* argv[])
 				errorcnt++;
 			}
 			break;
+		case OPT_BENCH:
+			bench_count = strtol(optarg, &e, 0);
+			if (!*optarg || (e && *e) || bench_count < 1) {
+				fprintf(stderr,
+					"Invalid argument to --bench: \"%s\"\n",
+					optarg);
+				errorcnt++;
+			}
+			break;
+		case OPT_DIRECT:
+			image_direct = 1;
+			break;
 		case '?':
 			fprintf(stderr, "Unrecognized switch: -%c\n", optopt);
 			errorcnt++;
@@ -146,6 +400,10 @@ int main(int argc, char* argv[])
 			BOOT_FLAG_DEVELOPER);
 		fprintf(stderr, "               %d = recovery mode on\n",
 			BOOT_FLAG_RECOVERY);
+		fprintf(stderr, "  --bench N  load the kernel N times and "
+			"report the time of each phase\n");
+		fprintf(stderr, "  --direct   read the image with O_DIRECT, "
+			"bypassing the page cache\n");
 		return 1;
 	}
 
@@ -193,15 +451,13 @@ int main(int argc, char* argv[])
 
 	/* Get image size */
 	printf("Reading from image: %s\n", image_name);
-	image_file = fopen(image_name, "rb");
-	if (!image_file) {
+	image_fd = open(image_name, O_RDONLY | (image_direct ? O_DIRECT : 0));
+	if (image_fd < 0) {
 		fprintf(stderr, "Unable to open image file %s\n", image_name);
 		return 1;
 	}
-	fseek(image_file, 0, SEEK_END);
-	lkp.streaming_lba_count = (ftell(image_file) / LBA_BYTES);
+	lkp.streaming_lba_count = lseek(image_fd, 0, SEEK_END) / LBA_BYTES;
 	lkp.gpt_lba_count = lkp.streaming_lba_count;
-	rewind(image_file);
 	printf("Streaming LBA count: %" PRIu64 "\n", lkp.streaming_lba_count);
 
 	/* Allocate a buffer for the kernel */
@@ -212,39 +468,21 @@ int main(int argc, char* argv[])
 	}
 	lkp.kernel_buffer_size = KERNEL_BUFFER_SIZE;
 
-	/* Set up vboot context. */
-	if (vb2api_init(&workbuf, sizeof(workbuf), &ctx)) {
-		fprintf(stderr, "Can't initialize workbuf\n");
-		return 1;
+	if (bench_count) {
+		rv = run_bench(bench_count, key_blob, boot_flags);
+		close(image_fd);
+		free(lkp.kernel_buffer);
+		free(key_blob);
+		return rv;
 	}
-	memset(&shared_data, 0, sizeof(shared_data));
-	sd = vb2_get_sd(ctx);
-	sd->vbsd = shared;
 
-	/* Copy kernel subkey to VBSD, if any */
-	if (key_blob) {
-		struct vb2_packed_key *dst = (struct vb2_packed_key *)
-			(shared_data +
-			 vb2_wb_round_up(sizeof(VbSharedDataHeader)));
-		shared->kernel_subkey.key_offset =
-			(uintptr_t)dst - (uintptr_t)&shared->kernel_subkey;
-		shared->kernel_subkey.key_size = key_blob->key_size;
-		shared->kernel_subkey.algorithm = key_blob->algorithm;
-		shared->kernel_subkey.key_version = key_blob->key_version;
-		memcpy(vb2_packed_key_data_mutable(dst),
-		       vb2_packed_key_data(key_blob), key_blob->key_size);
-	}
+	/* Set up vboot context. */
+	if (init_context(key_blob, boot_flags))
+		return 1;
 
 	/* Free the key blob, now that we're done with it */
 	free(key_blob);
 
-	/* No need to initialize ctx->nvdata[]; defaults are fine */
-	/* TODO(chromium:441893): support dev-mode flag and external gpt flag */
-	if (boot_flags & BOOT_FLAG_RECOVERY)
-		ctx->flags |= VB2_CONTEXT_RECOVERY_MODE;
-	if (boot_flags & BOOT_FLAG_DEVELOPER)
-		ctx->flags |= VB2_CONTEXT_DEVELOPER_MODE;
-
 	/* Call LoadKernel() */
 	rv = LoadKernel(ctx, &lkp);
 	printf("LoadKernel() returned %d\n", rv);
@@ -275,7 +513,7 @@ int main(int argc, char* argv[])
 		       lkp.partition_guid[15]);
 	}
 
-	fclose(image_file);
+	close(image_fd);
 	free(lkp.kernel_buffer);
 	return rv != VB2_SUCCESS;
 }
@@ -13,6 +13,7 @@
 
 #include "2common.h"
 #include "2sysincludes.h"
+#include "file_keys.h"
 #include "host_common.h"
 #include "host_signature21.h"
 #include "signature_digest.h"
@@ -20,9 +21,8 @@
 int main(int argc, char* argv[])
 {
 	int error_code = -1;
-	uint8_t *buf = NULL;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
 	uint8_t *signature_digest = NULL;
-	uint32_t len;
 
 	if (argc != 3) {
 		fprintf(stderr, "Usage: %s <alg_id> <file>", argv[0]);
@@ -35,11 +35,6 @@ int main(int argc, char* argv[])
 		goto cleanup;
 	}
 
-	if (VB2_SUCCESS != vb2_read_file(argv[2], &buf, &len)) {
-		fprintf(stderr, "Could not read file: %s\n", argv[2]);
-		goto cleanup;
-	}
-
 	enum vb2_hash_algorithm hash_alg = vb2_crypto_to_hash(algorithm);
 	uint32_t digest_size = vb2_digest_size(hash_alg);
 	uint32_t digestinfo_size = 0;
@@ -48,14 +43,20 @@ int main(int argc, char* argv[])
 					   &digestinfo_size))
 		goto cleanup;
 
+	/* Stream the file; rootfs images can be too big to read in whole. */
+	if (VB2_SUCCESS != DigestFile(argv[2], hash_alg, digest,
+				      sizeof(digest))) {
+		fprintf(stderr, "Could not read file: %s\n", argv[2]);
+		goto cleanup;
+	}
+
 	uint32_t signature_digest_len = digest_size + digestinfo_size;
-	signature_digest = SignatureDigest(buf, len, algorithm);
+	signature_digest = PrependDigestInfo(hash_alg, digest);
 	if(signature_digest &&
 	   fwrite(signature_digest, signature_digest_len, 1, stdout) == 1)
 		error_code = 0;
 
 cleanup:
 	free(signature_digest);
-	free(buf);
 	return error_code;
 }
@@ -23,7 +23,9 @@
  * command.  [name] is the field name.  [visible] is 1 if the field is
  * modified by the run-time.  Non-visible fields are initialized at build time
  * and remain constant.  [size] is the field size in bytes.  [value] is the
- * fixed value of non-visible fields.
+ * fixed value of non-visible fields.  Visible fields only need a [size] in
+ * commands with a builder (see AddBuilderField), where it is VARIABLE_SIZE
+ * for a trailing field whose size is given by the "length" field.
  */
 typedef struct Field {
   const char* name;
@@ -34,16 +36,21 @@ typedef struct Field {
   struct Field* next;
 } Field;
 
+#define VARIABLE_SIZE (-1)
+
 /* This structure is used to build (at build time) and manipulate (at firmware
  * or emulation run time) buffers containing TPM datagrams.  [name] is the name
  * of a TPM command.  [size] is the size of the command buffer in bytes, when
  * known.  [max_size] is the maximum size allowed for variable-length commands
  * (such as Read and Write).  [fields] is a link-list of command fields.
+ * [builder] is the name of a function generated to write the whole command
+ * into a caller's buffer, or NULL to only generate the structure.
  */
 typedef struct Command {
   const char* name;
   int size;
   int max_size;
+  const char* builder;
   Field* fields;
   struct Command* next;
 } Command;
@@ -54,7 +61,7 @@ typedef struct Command {
 static void AddVisibleField(Command* cmd, const char* name, int offset) {
   Field* fld = (Field*) calloc(1, sizeof(Field));
   if (cmd->fields != NULL) {
-    assert(offset > fn->offset);
+    assert(offset > cmd->fields->offset);
   }
   fld->next = cmd->fields;
   cmd->fields = fld;
@@ -63,6 +70,15 @@ static void AddVisibleField(Command* cmd, const char* name, int offset) {
   fld->offset = offset;
 }
 
+/* Adds a visible field which is also an argument of the command's builder,
+ * [size] bytes long.
+ */
+static void AddBuilderField(Command* cmd, const char* name, int offset,
+                            int size) {
+  AddVisibleField(cmd, name, offset);
+  cmd->fields->size = size;
+}
+
 /* Adds a constant field with its value.  The fields must be added at
  * increasing offsets.
  */
@@ -146,9 +162,11 @@ Command* BuildWriteCommand(void) {
   Command* cmd = newCommand(TPM_ORD_NV_WriteValue, 0);
   cmd->name = "tpm_nv_write_cmd";
   cmd->max_size = TPM_LARGE_ENOUGH_COMMAND_SIZE;
-  AddVisibleField(cmd, "index", kTpmRequestHeaderLength);
-  AddVisibleField(cmd, "length", kTpmRequestHeaderLength + 8);
-  AddVisibleField(cmd, "data", kTpmRequestHeaderLength + 12);
+  cmd->builder = "TpmBuildNvWrite";
+  AddBuilderField(cmd, "index", kTpmRequestHeaderLength, sizeof(uint32_t));
+  AddBuilderField(cmd, "length", kTpmRequestHeaderLength + 8,
+                  sizeof(uint32_t));
+  AddBuilderField(cmd, "data", kTpmRequestHeaderLength + 12, VARIABLE_SIZE);
   return cmd;
 }
 
@@ -156,8 +174,10 @@ Command* BuildReadCommand(void) {
   int size = kTpmRequestHeaderLength + kTpmReadInfoLength;
   Command* cmd = newCommand(TPM_ORD_NV_ReadValue, size);
   cmd->name = "tpm_nv_read_cmd";
-  AddVisibleField(cmd, "index", kTpmRequestHeaderLength);
-  AddVisibleField(cmd, "length", kTpmRequestHeaderLength + 8);
+  cmd->builder = "TpmBuildNvRead";
+  AddBuilderField(cmd, "index", kTpmRequestHeaderLength, sizeof(uint32_t));
+  AddBuilderField(cmd, "length", kTpmRequestHeaderLength + 8,
+                  sizeof(uint32_t));
   return cmd;
 }
 
@@ -293,8 +313,10 @@ Command* BuildExtendCommand(void) {
   int size = kTpmRequestHeaderLength + sizeof(uint32_t) + kPcrDigestLength;
   Command* cmd = newCommand(TPM_ORD_Extend, size);
   cmd->name = "tpm_extend_cmd";
-  AddVisibleField(cmd, "pcrNum", kTpmRequestHeaderLength);
-  AddVisibleField(cmd, "inDigest", kTpmRequestHeaderLength + sizeof(uint32_t));
+  cmd->builder = "TpmBuildExtend";
+  AddBuilderField(cmd, "pcrNum", kTpmRequestHeaderLength, sizeof(uint32_t));
+  AddBuilderField(cmd, "inDigest", kTpmRequestHeaderLength + sizeof(uint32_t),
+                  kPcrDigestLength);
   return cmd;
 }
 
@@ -611,6 +633,104 @@ void OutputCommands(Command* cmd) {
   OutputCommands(cmd->next);
 }
 
+/* Outputs the fields of a command in offset order, by recursion.  The last
+ * argument separator is printed by the caller.
+ */
+void OutputBuilderArguments(Field* fld) {
+  if (fld == NULL) {
+    return;
+  }
+  OutputBuilderArguments(fld->next);
+  if (!fld->visible) {
+    return;
+  }
+  if (fld->size == sizeof(uint32_t)) {
+    printf(",\n\t\tuint32_t %s", fld->name);
+  } else if (fld->size == VARIABLE_SIZE) {
+    printf(",\n\t\tconst void *%s", fld->name);
+  } else {
+    printf(",\n\t\tconst uint8_t *%s", fld->name);
+  }
+}
+
+/* Outputs the statements writing the fields of a command in offset order,
+ * zeroing the gaps between them.  Returns the offset after the last field.
+ */
+int OutputBuilderStores(Command* cmd, Field* fld) {
+  int cursor;
+  int i;
+
+  if (fld == NULL) {
+    return 0;
+  }
+  cursor = OutputBuilderStores(cmd, fld->next);
+  assert(fld->offset >= cursor);
+  if (fld->offset > cursor) {
+    printf("\tmemset(buffer + %d, 0, %d);\n", cursor, fld->offset - cursor);
+  }
+
+  if (fld->visible) {
+    if (fld->size == sizeof(uint32_t)) {
+      printf("\tToTpmUint32(buffer + %d, %s);\n", fld->offset, fld->name);
+    } else if (fld->size == VARIABLE_SIZE) {
+      printf("\tmemcpy(buffer + %d, %s, length);\n", fld->offset, fld->name);
+    } else if (fld->size > 0) {
+      printf("\tmemcpy(buffer + %d, %s, %d);\n", fld->offset, fld->name,
+             fld->size);
+    } else {
+      fprintf(stderr, "%s: field %s has no size\n", cmd->name, fld->name);
+      exit(1);
+    }
+    return fld->offset + (fld->size == VARIABLE_SIZE ? 0 : fld->size);
+  }
+
+  if (fld->offset == sizeof(TPM_TAG) && cmd->size == 0) {
+    /* The size of variable-length commands is only known at run time. */
+    printf("\tToTpmUint32(buffer + %d, size);\n", fld->offset);
+  } else if (fld->size == sizeof(uint32_t)) {
+    printf("\tToTpmUint32(buffer + %d, 0x%x);\n", fld->offset, fld->value);
+  } else {
+    for (i = 0; i < fld->size; i++) {
+      printf("\tbuffer[%d] = 0x%x;\n", fld->offset + i,
+             (fld->value >> (8 * (fld->size - 1 - i))) & 0xff);
+    }
+  }
+  return fld->offset + fld->size;
+}
+
+/* Outputs the builder functions, which write whole commands straight into
+ * the caller's buffer with their offsets and sizes fixed at compile time.
+ */
+void OutputBuilders(Command* cmd) {
+  int end;
+
+  if (cmd == NULL) {
+    return;
+  }
+  OutputBuilders(cmd->next);
+  if (cmd->builder == NULL) {
+    return;
+  }
+
+  printf("/* Writes a %s into [buffer], which must be large enough for it.\n"
+         " * Returns the size of the command. */\n", cmd->name);
+  printf("__attribute__((unused))\n");
+  printf("static inline uint32_t %s(uint8_t *buffer", cmd->builder);
+  OutputBuilderArguments(cmd->fields);
+  printf(")\n{\n");
+  if (cmd->size == 0) {
+    printf("\tconst uint32_t size = %d + length;\n\n",
+           cmd->fields->offset);
+  } else {
+    printf("\tconst uint32_t size = %d;\n\n", cmd->size);
+  }
+  end = OutputBuilderStores(cmd, cmd->fields);
+  if (cmd->size > end) {
+    printf("\tmemset(buffer + %d, 0, %d);\n", end, cmd->size - end);
+  }
+  printf("\treturn size;\n}\n\n");
+}
+
 Command* (*builders[])(void) = {
   BuildDefineSpaceCommand,
   BuildWriteCommand,
@@ -673,6 +793,7 @@ int main(void) {
 
   printf("/* This file is automatically generated */\n\n");
   OutputCommands(commands);
+  OutputBuilders(commands);
   printf("const int kWriteInfoLength = %d;\n", (int) sizeof(TPM_WRITE_INFO));
 
   FreeCommands(commands);
@@ -575,6 +575,39 @@ static uint32_t HandlerNotImplementedForTPM2(void) {
 }
 #endif
 
+static command_record* FindCommand(const char* cmd);
+
+static uint32_t HandlerTime(void) {
+  const struct tlcl_command_stats* stats;
+  command_record* c;
+  uint32_t result;
+  int count;
+  int i;
+
+  if (nargs < 3) {
+    fprintf(stderr, "usage: tpmc time <command> [args]\n");
+    exit(OTHER_ERROR);
+  }
+  /* The timed command sees its own arguments where it expects them */
+  nargs--;
+  args++;
+  c = FindCommand(args[1]);
+  if (!c || c->handler == HandlerTime) {
+    fprintf(stderr, "time: unknown command: %s\n", args[1]);
+    exit(OTHER_ERROR);
+  }
+  result = c->handler();
+
+  /* To stderr, like time(1), so the command's own output is unchanged */
+  stats = TlclGetCommandStats(&count);
+  for (i = 0; i < count; i++) {
+    fprintf(stderr, "TPM command %#x: count=%u total_us=%u max_us=%u\n",
+            stats[i].command, stats[i].count, stats[i].total_us,
+            stats[i].max_us);
+  }
+  return result;
+}
+
 /* Table of TPM commands.
  */
 command_record command_table[] = {
@@ -657,10 +690,84 @@ command_record command_table[] = {
   { "checkownerauth", "chko",
     TPM20_NOT_IMPLEMENTED("Check owner authorization with well-known secret",
       HandlerCheckOwnerAuth) },
+  { "time", "time",
+    "run a command and print the latency of each TPM command it sent "
+    "(time <command> [args])",
+    HandlerTime },
 };
 
 static int n_commands = sizeof(command_table) / sizeof(command_table[0]);
 
+static command_record* FindCommand(const char* cmd) {
+  command_record* c;
+  for (c = command_table; c < command_table + n_commands; c++) {
+    if (strcmp(cmd, c->name) == 0 || strcmp(cmd, c->abbr) == 0) {
+      return c;
+    }
+  }
+  return NULL;
+}
+
+#define MAX_BATCH_ARGS 256
+
+/* Runs commands read from stdin, one per line, over the connection main()
+ * has opened.  After each command prints "result <line> <command> <code>"
+ * so a caller can match output to commands.  Stops at the first failing
+ * command and returns its exit code.
+ */
+static int RunBatch(char* progname) {
+  char* batch_args[MAX_BATCH_ARGS + 1];
+  char* line = NULL;
+  size_t line_size = 0;
+  int line_num = 0;
+  int exit_code = 0;
+
+  while (!exit_code && getline(&line, &line_size, stdin) != -1) {
+    command_record* c;
+    uint32_t result;
+    char* saveptr;
+    char* word;
+    int count = 1;
+
+    line_num++;
+    batch_args[0] = progname;
+    for (word = strtok_r(line, " \t\n", &saveptr); word;
+         word = strtok_r(NULL, " \t\n", &saveptr)) {
+      if (count == MAX_BATCH_ARGS) {
+        fprintf(stderr, "line %d: too many arguments\n", line_num);
+        exit_code = OTHER_ERROR;
+        break;
+      }
+      batch_args[count++] = word;
+    }
+    if (exit_code)
+      break;
+    /* Skip blank lines and comments */
+    if (count == 1 || batch_args[1][0] == '#')
+      continue;
+    batch_args[count] = NULL;
+
+    c = FindCommand(batch_args[1]);
+    if (!c) {
+      fprintf(stderr, "line %d: unknown command: %s\n", line_num,
+              batch_args[1]);
+      exit_code = OTHER_ERROR;
+      break;
+    }
+
+    nargs = count;
+    args = batch_args;
+    result = c->handler();
+    fflush(stdout);
+    printf("result %d %s %#x\n", line_num, args[1], result);
+    fflush(stdout);
+    exit_code = ErrorCheck(result, args[1]);
+  }
+  free(line);
+
+  return exit_code;
+}
+
 int main(int argc, char* argv[]) {
   char *progname;
   uint32_t result;
@@ -672,8 +779,9 @@ int main(int argc, char* argv[]) {
     progname = argv[0];
 
   if (argc < 2) {
-    fprintf(stderr, "usage: %s <TPM command> [args]\n   or: %s help\n",
-            progname, progname);
+    fprintf(stderr, "usage: %s <TPM command> [args]\n"
+            "   or: %s --batch < commands\n   or: %s help\n",
+            progname, progname, progname);
     return OTHER_ERROR;
   } else {
     command_record* c;
@@ -683,6 +791,9 @@ int main(int argc, char* argv[]) {
 
     if (strcmp(cmd, "help") == 0) {
       printf("tpmc mode: TPM%s\n", TPM_MODE_STRING);
+      printf("--batch reads commands from stdin, one per line, and runs "
+             "them over one\nTPM connection, printing "
+             "\"result <line> <command> <code>\" after each.\n");
       printf("%26s %7s  %s\n\n", "command", "abbr.", "description");
       for (c = command_table; c < command_table + n_commands; c++) {
         printf("%26s %7s  %s\n", c->name, c->abbr, c->description);
@@ -699,10 +810,15 @@ int main(int argc, char* argv[]) {
       return result > OTHER_ERROR ? OTHER_ERROR : result;
     }
 
-    for (c = command_table; c < command_table + n_commands; c++) {
-      if (strcmp(cmd, c->name) == 0 || strcmp(cmd, c->abbr) == 0) {
-        return ErrorCheck(c->handler(), cmd);
-      }
+    if (!strcmp(cmd, "--batch")) {
+      return RunBatch(progname);
+    }
+
+    c = FindCommand(cmd);
+    if (c) {
+      /* "time" shifts args, so report the command it ran */
+      result = c->handler();
+      return ErrorCheck(result, args[1]);
     }
 
     /* No command matched. */